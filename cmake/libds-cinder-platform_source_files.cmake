@@ -10,17 +10,23 @@ list( APPEND DS_CINDER_SRC_FILES
 	${ROOT_PATH}/src/ds/util/idle_timer.cpp
 	${ROOT_PATH}/src/ds/util/exif.cpp
 	${ROOT_PATH}/src/ds/util/bit_mask.cpp
+	${ROOT_PATH}/src/ds/util/fnv_hash.cpp
+	${ROOT_PATH}/src/ds/util/slab_pool.cpp
+	${ROOT_PATH}/src/ds/util/scaled_jpeg.cpp
 	${ROOT_PATH}/src/ds/arc/arc_input.cpp
 	${ROOT_PATH}/src/ds/arc/arc.cpp
 	${ROOT_PATH}/src/ds/arc/arc_color_array.cpp
 	${ROOT_PATH}/src/ds/arc/arc_chain.cpp
+	${ROOT_PATH}/src/ds/arc/arc_circle_program.cpp
 	${ROOT_PATH}/src/ds/arc/arc_render_circle.cpp
 	${ROOT_PATH}/src/ds/arc/arc_pow.cpp
 	${ROOT_PATH}/src/ds/arc/arc_map.cpp
 	${ROOT_PATH}/src/ds/arc/arc_layer.cpp
 	${ROOT_PATH}/src/ds/arc/arc_io.cpp
 	${ROOT_PATH}/src/ds/gl/uniform.cpp
+	${ROOT_PATH}/src/ds/gl/draw_list.cpp
 	${ROOT_PATH}/src/ds/network/http_client.cpp		# error: invalid initialization of non-const reference of type ‘std::unique_ptr<ds::WorkRequest>&’ from an rvalue of type ‘std::unique_ptr<ds::WorkRequest>’
+	${ROOT_PATH}/src/ds/network/io_reactor.cpp
 	${ROOT_PATH}/src/ds/network/node_watcher.cpp
 	${ROOT_PATH}/src/ds/network/packet_chunker.cpp
 	${ROOT_PATH}/src/ds/network/tcp_client.cpp
@@ -30,6 +36,7 @@ list( APPEND DS_CINDER_SRC_FILES
 	${ROOT_PATH}/src/ds/network/single_udp_receiver.cpp
 	${ROOT_PATH}/src/ds/network/network_info.cpp		# Uses winsock2 apis
 	${ROOT_PATH}/src/ds/time/timer.cpp
+	${ROOT_PATH}/src/ds/time/timer_wheel.cpp
 	${ROOT_PATH}/src/ds/thread/work_request.cpp
 	${ROOT_PATH}/src/ds/thread/work_manager.cpp
 	${ROOT_PATH}/src/ds/thread/gl_thread.cpp			# Uses win32 and WGL APIs
@@ -47,6 +54,7 @@ list( APPEND DS_CINDER_SRC_FILES
 	${ROOT_PATH}/src/ds/app/event_client.cpp
 	${ROOT_PATH}/src/ds/app/event_registry.cpp
 	${ROOT_PATH}/src/ds/app/engine/engine_io.cpp
+	${ROOT_PATH}/src/ds/app/engine/engine_replay.cpp
 	${ROOT_PATH}/src/ds/app/engine/engine_server.cpp
 	${ROOT_PATH}/src/ds/app/engine/engine_client_list.cpp
 	${ROOT_PATH}/src/ds/app/engine/engine_roots.cpp
@@ -60,6 +68,7 @@ list( APPEND DS_CINDER_SRC_FILES
 	${ROOT_PATH}/src/ds/app/engine/engine_io_defs.cpp
 	${ROOT_PATH}/src/ds/app/engine/engine_standalone.cpp
 	${ROOT_PATH}/src/ds/app/engine/engine_clientserver.cpp
+	${ROOT_PATH}/src/ds/app/engine/sprite_id_table.cpp
 	${ROOT_PATH}/src/ds/app/error.cpp
 	${ROOT_PATH}/src/ds/app/blob_reader.cpp
 	${ROOT_PATH}/src/ds/app/camera_utils.cpp
@@ -84,13 +93,19 @@ list( APPEND DS_CINDER_SRC_FILES
 	${ROOT_PATH}/src/ds/ui/touch/select_picking.cpp
 	${ROOT_PATH}/src/ds/ui/touch/touch_translator.cpp
 	${ROOT_PATH}/src/ds/ui/touch/touch_mode.cpp
+	${ROOT_PATH}/src/ds/ui/touch/tuio_ingest.cpp
 	${ROOT_PATH}/src/ds/ui/tween/tweenline.cpp
+	${ROOT_PATH}/src/ds/ui/tween/sprite_tweens.cpp
 	${ROOT_PATH}/src/ds/ui/tween/sprite_anim.cpp
 	${ROOT_PATH}/src/ds/ui/service/glsl_image_service.cpp
 	${ROOT_PATH}/src/ds/ui/service/pango_font_service.cpp
 	${ROOT_PATH}/src/ds/ui/service/load_image_service.cpp
+	${ROOT_PATH}/src/ds/ui/service/thumbnail_service.cpp
+	${ROOT_PATH}/src/ds/ui/service/shader_service.cpp
 	${ROOT_PATH}/src/ds/ui/sprite/util/blend.cpp
 	${ROOT_PATH}/src/ds/ui/sprite/util/clip_plane.cpp
+	${ROOT_PATH}/src/ds/ui/sprite/util/sprite_draw_list.cpp
+	${ROOT_PATH}/src/ds/ui/sprite/util/sprite_transforms.cpp
 	${ROOT_PATH}/src/ds/ui/sprite/sprite_engine.cpp
 	${ROOT_PATH}/src/ds/ui/sprite/border.cpp
 	${ROOT_PATH}/src/ds/ui/sprite/sprite.cpp
@@ -98,6 +113,7 @@ list( APPEND DS_CINDER_SRC_FILES
 	${ROOT_PATH}/src/ds/ui/sprite/dirty_state.cpp
 	${ROOT_PATH}/src/ds/ui/sprite/circle.cpp
 	${ROOT_PATH}/src/ds/ui/sprite/shader/sprite_shader.cpp
+	${ROOT_PATH}/src/ds/ui/sprite/shader/shader_source.cpp
 	${ROOT_PATH}/src/ds/ui/sprite/gradient_sprite.cpp
 	${ROOT_PATH}/src/ds/ui/sprite/mesh.cpp
 	${ROOT_PATH}/src/ds/ui/sprite/nine_patch.cpp
@@ -106,9 +122,11 @@ list( APPEND DS_CINDER_SRC_FILES
 	${ROOT_PATH}/src/ds/ui/sprite/circle_border.cpp
 	${ROOT_PATH}/src/ds/ui/sprite/text_defs.cpp
 	${ROOT_PATH}/src/ds/ui/ip/functions/ip_circle_mask.cpp
+	${ROOT_PATH}/src/ds/ui/ip/functions/ip_kernels.cpp
 	${ROOT_PATH}/src/ds/ui/ip/ip_function.cpp
 	${ROOT_PATH}/src/ds/ui/ip/ip_defs.cpp
 	${ROOT_PATH}/src/ds/ui/ip/ip_function_list.cpp
+	${ROOT_PATH}/src/ds/ui/ip/ip_kernel.cpp
 	${ROOT_PATH}/src/ds/ui/image_source/image_client.cpp
 	${ROOT_PATH}/src/ds/ui/image_source/image_glsl.cpp
 	${ROOT_PATH}/src/ds/ui/image_source/image_drop_shadow.cpp
@@ -130,6 +148,7 @@ list( APPEND DS_CINDER_SRC_FILES
 	${ROOT_PATH}/src/ds/params/update_params.cpp
 	${ROOT_PATH}/src/ds/debug/computer_info.cpp
 	${ROOT_PATH}/src/ds/debug/debug_defines.cpp
+	${ROOT_PATH}/src/ds/debug/frame_profiler.cpp
 	${ROOT_PATH}/src/ds/debug/logger.cpp
 	${ROOT_PATH}/src/ds/math/math_func.cpp
 	${ROOT_PATH}/src/ds/cfg/cfg_nine_patch.cpp
@@ -122,6 +122,14 @@ find_package( Sqlite3 REQUIRED )
 list( APPEND DS_CINDER_LIBS_DEPENDS ${Sqlite3_LIBRARIES} )
 list( APPEND DS_CINDER_INCLUDE_SYSTEM_PRIVATE ${Sqlite3_INCLUDE_DIRS} )
 
+# libjpeg, for decoding JPEGs at a fraction of their size (ds/util/scaled_jpeg). Optional.
+find_package( JPEG )
+if( JPEG_FOUND )
+	list( APPEND DS_CINDER_LIBS_DEPENDS ${JPEG_LIBRARIES} )
+	list( APPEND DS_CINDER_INCLUDE_SYSTEM_PRIVATE ${JPEG_INCLUDE_DIR} )
+	list( APPEND DS_CINDER_DEFINES "-DDS_CINDER_HAVE_LIBJPEG" )
+endif()
+
 # GStreamer and its dependencies.
 # GStreamer
 find_package( GStreamer REQUIRED )
@@ -10,6 +10,7 @@ if( NOT TARGET essentials )
 		${ESSENTIALS_SRC_PATH}/ds/network/smtp_request.cpp
 		${ESSENTIALS_SRC_PATH}/ds/network/helper/delayed_node_watcher.cpp
 		${ESSENTIALS_SRC_PATH}/ds/network/https_client.cpp
+		${ESSENTIALS_SRC_PATH}/ds/network/http_service.cpp
 		${ESSENTIALS_SRC_PATH}/ds/query/content/generic_content_model.cpp
 		${ESSENTIALS_SRC_PATH}/ds/query/content/xml_content_loader.cpp
 		${ESSENTIALS_SRC_PATH}/ds/ui/interface_xml/interface_xml_importer.cpp
@@ -18,7 +19,9 @@ if( NOT TARGET essentials )
 		${ESSENTIALS_SRC_PATH}/ds/ui/button/sprite_button.cpp
 		${ESSENTIALS_SRC_PATH}/ds/ui/button/image_button.cpp
 		#${ESSENTIALS_SRC_PATH}/ds/ui/layout/layout_sprite.cpp
+		${ESSENTIALS_SRC_PATH}/ds/ui/sprite/png_sequence_pack.cpp
 		${ESSENTIALS_SRC_PATH}/ds/ui/sprite/png_sequence_sprite.cpp
+		${ESSENTIALS_SRC_PATH}/ds/ui/sprite/png_sequence_stream.cpp
 		${ESSENTIALS_SRC_PATH}/ds/ui/menu/component/menu_item.cpp
 		${ESSENTIALS_SRC_PATH}/ds/ui/menu/component/cluster_view.cpp
 		${ESSENTIALS_SRC_PATH}/ds/ui/menu/touch_menu.cpp
@@ -40,6 +43,8 @@ if( NOT TARGET essentials )
 		${ESSENTIALS_SRC_PATH}/ds/debug/automator/actions/base_action.cpp
 		${ESSENTIALS_SRC_PATH}/ds/debug/automator/actions/drag_action.cpp
 		${ESSENTIALS_SRC_PATH}/ds/debug/automator/actions/tap_action.cpp
+		${ESSENTIALS_SRC_PATH}/ds/debug/automator/scenario.cpp
+		${ESSENTIALS_SRC_PATH}/ds/debug/automator/soak_test.cpp
 	)
 
 	add_library( essentials ${ESSENTIALS_SRC_FILES} )
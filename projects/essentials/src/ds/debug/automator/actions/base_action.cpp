@@ -2,18 +2,36 @@
 
 #include "base_action.h"
 
+#include <cinder/Rand.h>
+
 namespace ds {
 namespace debug {
 
 /**
  * \class ds::debug::BaseActionFactory
  */
-BaseActionFactory::BaseActionFactory(){
+BaseActionFactory::BaseActionFactory()
+	: mRand(nullptr)
+{
 }
 
 BaseActionFactory::~BaseActionFactory(){
 }
 
+void BaseActionFactory::setRandom(ci::Rand* r){
+	mRand = r;
+}
+
+float BaseActionFactory::randFloat(const float min, const float max) const {
+	if(mRand) return mRand->nextFloat(min, max);
+	return ci::randFloat(min, max);
+}
+
+int BaseActionFactory::randInt(const int min, const int max) const {
+	if(mRand) return mRand->nextInt(min, max);
+	return ci::randInt(min, max);
+}
+
 /**
  * \class ds::debug::BaseAction
  */
@@ -22,6 +40,7 @@ BaseAction::BaseAction(std::vector<int> &freeList, ds::ui::SpriteEngine& engine,
 	, mEngine(engine)
 	, mFrame(frame)
 	, mTotal(0.0f)
+	, mRand(nullptr)
 {
 
 }
@@ -52,6 +71,20 @@ void BaseAction::setup(float limit, int numberOfFingers){
 	}
 }
 
+void BaseAction::setRandom(ci::Rand* r){
+	mRand = r;
+}
+
+float BaseAction::randFloat(const float min, const float max) const {
+	if(mRand) return mRand->nextFloat(min, max);
+	return ci::randFloat(min, max);
+}
+
+int BaseAction::randInt(const int min, const int max) const {
+	if(mRand) return mRand->nextInt(min, max);
+	return ci::randInt(min, max);
+}
+
 void BaseAction::release(){
 
 	if(!mInUseList.empty())	{
@@ -6,6 +6,10 @@
 #include <cinder/Rect.h>
 #include <ds/ui/sprite/sprite_engine.h>
 
+namespace cinder {
+class Rand;
+}
+
 namespace ds{
 namespace debug{
 class BaseAction;
@@ -21,6 +25,16 @@ public:
 	virtual float			getLimit() const = 0;
 	virtual int				getNumberOfFingers() const = 0;
 	virtual BaseAction*		build(std::vector<int> &freeList, ds::ui::SpriteEngine& engine, const ci::Rectf& frame) const = 0;
+
+	/// The generator used for limits and finger counts. Null (the default) uses cinder's global one.
+	void					setRandom(ci::Rand*);
+
+protected:
+	float					randFloat(const float min, const float max) const;
+	int						randInt(const int min, const int max) const;
+
+private:
+	ci::Rand*				mRand;
 };
 
 /**
@@ -35,7 +49,13 @@ public:
 	virtual bool			update(float dt);
 	void					release();
 
+	/// The generator used for positions and directions. Null (the default) uses cinder's global one.
+	void					setRandom(ci::Rand*);
+
 protected:
+	float					randFloat(const float min, const float max) const;
+	int						randInt(const int min, const int max) const;
+
 	float					mLimit;
 	float					mTotal;
 	int						mNumberOfFingers;
@@ -43,6 +63,7 @@ protected:
 	std::vector<int>&		mFreeList;
 	ds::ui::SpriteEngine&	mEngine;
 	const ci::Rectf			mFrame;
+	ci::Rand*				mRand;
 };
 
 } // namespace debug
@@ -12,7 +12,7 @@ namespace debug {
 * \class ds::CallbackActionFactory
 */
 float CallbackActionFactory::getLimit() const {
-	return ci::randFloat(mMinFrequency, mMaxFrequency);
+	return randFloat(mMinFrequency, mMaxFrequency);
 }
 
 int CallbackActionFactory::getNumberOfFingers() const {
@@ -40,7 +40,7 @@ bool CallbackAction::update(float dt){
 	if(mTotal >= mLimit){
 		if(mCallback) mCallback();
 		mTotal = 0.0f;
-		mLimit = ci::randFloat(mMinTime, mMaxTime);
+		mLimit = randFloat(mMinTime, mMaxTime);
 		return true;
 
 	}
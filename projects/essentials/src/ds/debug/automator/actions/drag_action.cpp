@@ -13,11 +13,11 @@ namespace debug {
  * \class ds::DragActionFactory
  */
 float DragActionFactory::getLimit() const {
-	return ci::randFloat(0.1f, 1.0f);
+	return randFloat(0.1f, 1.0f);
 }
 
 int DragActionFactory::getNumberOfFingers() const {
-	return ci::randInt(1, 5);
+	return randInt(1, 5);
 }
 
 BaseAction* DragActionFactory::build(std::vector<int> &freeList, ds::ui::SpriteEngine& engine, const ci::Rectf& frame) const {
@@ -74,7 +74,7 @@ void DragAction::setup(float limit, int numberOfFingers){
 
 	mTouchPos.reserve(mInUseList.size());
 	float radius = 20.0f;
-	ci::vec2 touchPos = ci::vec2(mFrame.getX1() + ci::randFloat(0.0f, mFrame.getWidth()), mFrame.getY1() + ci::randFloat(0.0f, mFrame.getHeight()) );
+	ci::vec2 touchPos = ci::vec2(mFrame.getX1() + randFloat(0.0f, mFrame.getWidth()), mFrame.getY1() + randFloat(0.0f, mFrame.getHeight()) );
 
 	float step = (2.0f*(float)M_PI) / mNumberOfFingers;
 	float angle = (float)M_PI;
@@ -91,8 +91,8 @@ void DragAction::setup(float limit, int numberOfFingers){
 
 	mEngine.injectTouchesBegin(ds::ui::TouchEvent(mEngine.getWindow(), touches, true));
 
-	mMagnitude = ci::randFloat (10.0f, 1500.0f);
-	mDirection = glm::normalize(ci::vec2(ci::randFloat(-1.0f, 1.0f), ci::randFloat(-1.0f, 1.0f)));
+	mMagnitude = randFloat(10.0f, 1500.0f);
+	mDirection = glm::normalize(ci::vec2(randFloat(-1.0f, 1.0f), randFloat(-1.0f, 1.0f)));
 }
 
 } // namespace debug
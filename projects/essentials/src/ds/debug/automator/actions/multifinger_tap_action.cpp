@@ -13,11 +13,11 @@ namespace debug{
  * \class ds::MultiTapActionFactory
  */
 float MultiTapActionFactory::getLimit() const {
-	return ci::randFloat(0.01f, 0.5f);
+	return randFloat(0.01f, 0.5f);
 }
 
 int MultiTapActionFactory::getNumberOfFingers() const {
-	return ci::randInt(1, 10);
+	return randInt(1, 10);
 }
 
 BaseAction* MultiTapActionFactory::build(std::vector<int> &freeList, ds::ui::SpriteEngine& engine, const ci::Rectf& frame) const {
@@ -56,7 +56,7 @@ void MultiTapAction::setup(float limit, int numberOfFingers){
 
 	mTouchPos.reserve(mInUseList.size());
 	float radius = 20.0f;
-	ci::vec2 touchPos = ci::vec2(mFrame.getX1() + ci::randFloat(0.0f, mFrame.getWidth()), mFrame.getY1() + ci::randFloat(0.0f, mFrame.getHeight()));
+	ci::vec2 touchPos = ci::vec2(mFrame.getX1() + randFloat(0.0f, mFrame.getWidth()), mFrame.getY1() + randFloat(0.0f, mFrame.getHeight()));
 
 	float step = (2.0f*(float)M_PI) / mNumberOfFingers;
 	float angle = (float)M_PI;
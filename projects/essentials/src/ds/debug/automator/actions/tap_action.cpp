@@ -15,7 +15,7 @@ namespace debug {
  * \class ds::TapActionFactory
  */
 float TapActionFactory::getLimit() const {
-	return ci::randFloat(0.01f, 0.5f);
+	return randFloat(0.01f, 0.5f);
 }
 
 int TapActionFactory::getNumberOfFingers() const {
@@ -63,7 +63,7 @@ void TapAction::setup(float limit, int numberOfFingers)
 
 	mTouchPos.reserve(mInUseList.size());
 	for(auto it = mInUseList.begin(), it2 = mInUseList.end(); it != it2; ++it){
-		ci::vec2 touchPos = ci::vec2(mFrame.getX1() + ci::randFloat(0.0f, mFrame.getWidth()), mFrame.getY1() + ci::randFloat(0.0f, mFrame.getHeight()));
+		ci::vec2 touchPos = ci::vec2(mFrame.getX1() + randFloat(0.0f, mFrame.getWidth()), mFrame.getY1() + randFloat(0.0f, mFrame.getHeight()));
 		mTouchPos.push_back(touchPos);
 		touches.push_back(ci::app::TouchEvent::Touch(touchPos, touchPos, *it, 0.0, nullptr));
 	}
@@ -23,8 +23,11 @@ Automator::Automator(ds::ui::SpriteEngine& engine, const std::string& watermarkT
 	, mFrame(0.0f, 0.0f, mEngine.getWorldWidth(), mEngine.getWorldHeight())
 	, mPeriod(0.016f)
 	, mTotal(0.0f)
+	, mFixedStep(0.0f)
+	, mSeed(ci::randUint())
 	, mFingerMax(128)
-{		
+{
+	mRand.seed(mSeed);		
 	setFrame(ci::Rectf(0.0f, 0.0f, mEngine.getWorldWidth(), mEngine.getWorldHeight()));
 
 	addFactory(std::shared_ptr<BaseActionFactory>(new DragActionFactory()));
@@ -42,12 +45,22 @@ void Automator::setPeriod(const float period){
 	mPeriod = period;
 }
 
+void Automator::setSeed(const uint32_t seed){
+	mSeed = seed;
+	mRand.seed(mSeed);
+}
+
+void Automator::setFixedStep(const float seconds){
+	mFixedStep = seconds;
+}
+
 void Automator::addFactory(const std::shared_ptr<BaseActionFactory>& fac){
 	if(fac.get() == nullptr) return;
 
 	try {
 		mFactory.push_back(Factory());
 		mFactory.back().mFactory = fac;
+		fac->setRandom(&mRand);
 		// Assign everyone to a bucket for random selection.
 		const size_t		size = mFactory.size();
 		float				min = 0;
@@ -66,7 +79,8 @@ void Automator::addSingletonFactory(const std::shared_ptr<BaseActionFactory>& fa
 
 	Factory factory;
 	factory.mFactory = fact;
-	std::shared_ptr<BaseAction>		a = factory.addAction(mFreeList, mEngine, mFrame);
+	fact->setRandom(&mRand);
+	std::shared_ptr<BaseAction>		a = factory.addAction(mFreeList, mEngine, mFrame, mRand);
 	if(a != nullptr) mSingletonList.push_back(a);
 }
 
@@ -82,19 +96,20 @@ void Automator::update(const ds::UpdateParams& up){
 	// Probably, the defaults should be actions that are installed at construction,
 	// and then removed if the client installs their own.
 	if(!mFactory.empty()){
-		mActioner.update(up.getDeltaTime());
+		const float		dt = (mFixedStep > 0.0f ? mFixedStep : up.getDeltaTime());
+		mActioner.update(dt);
 
-		mTotal += up.getDeltaTime();
+		mTotal += dt;
 
 		if(mTotal >= mPeriod){
 			mTotal = 0.0f;
 
 			if(!mFreeList.empty()){
-				float percent = ci::randFloat(0.0f, 1.0f);
+				float percent = mRand.nextFloat(0.0f, 1.0f);
 				for(auto it = mFactory.begin(), end = mFactory.end(); it != end; ++it) {
 					Factory&	f = *it;
 					if(percent >= f.mMin && percent <= f.mMax && f.mFactory.get() != nullptr) {
-						std::shared_ptr<BaseAction>		a = f.addAction(mFreeList, mEngine, mFrame);
+						std::shared_ptr<BaseAction>		a = f.addAction(mFreeList, mEngine, mFrame, mRand);
 						if(a != nullptr) mActioner.add(a);
 						break;
 					}
@@ -103,7 +118,7 @@ void Automator::update(const ds::UpdateParams& up){
 		}
 
 		for(auto it = mSingletonList.begin(); it < mSingletonList.end(); ++it){
-			(*it).get()->update(up.getDeltaTime());
+			(*it).get()->update(dt);
 		}
 	}
 }
@@ -171,7 +186,7 @@ Automator::Factory::Factory()
 {
 }
 
-std::shared_ptr<BaseAction> Automator::Factory::addAction(std::vector<int> &freeList, ds::ui::SpriteEngine& engine, const ci::Rectf& frame)
+std::shared_ptr<BaseAction> Automator::Factory::addAction(std::vector<int> &freeList, ds::ui::SpriteEngine& engine, const ci::Rectf& frame, ci::Rand& rand)
 {
 	BaseActionFactory*			factory = mFactory.get();
 	if(factory == nullptr) return nullptr;
@@ -179,12 +194,14 @@ std::shared_ptr<BaseAction> Automator::Factory::addAction(std::vector<int> &free
 	for(int i = 0; i < mAction.size(); ++i)	{
 		auto ptr = mAction[i];
 		if(ptr.unique())		{
+			ptr.get()->setRandom(&rand);
 			ptr.get()->setup(factory->getLimit(), factory->getNumberOfFingers());
 			return ptr;
 		}
 	}
 
 	mAction.push_back(std::shared_ptr<BaseAction>(factory->build(freeList, engine, frame)));
+	mAction.back().get()->setRandom(&rand);
 	mAction.back().get()->setup(factory->getLimit(), factory->getNumberOfFingers());
 	return mAction.back();
 }
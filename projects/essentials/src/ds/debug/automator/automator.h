@@ -5,6 +5,7 @@
 #include <vector>
 #include <cinder/Vector.h>
 #include <cinder/Rect.h>
+#include <cinder/Rand.h>
 #include <Poco/Timestamp.h>
 #include <ds/app/auto_update.h>
 #include <ds/ui/sprite/text.h>
@@ -41,6 +42,14 @@ public:
 	void						setFrame(const ci::Rectf&);
 	void						setPeriod(const float period);
 
+	// Every action is picked and placed from one generator. Seeding it makes a run repeatable,
+	// as long as the frames are repeatable too (see setFixedStep()).
+	void						setSeed(const uint32_t seed);
+	uint32_t					getSeed() const { return mSeed; }
+	// Advance the actions by this many seconds each update instead of the real frame time.
+	// 0 (the default) uses the real frame time.
+	void						setFixedStep(const float seconds);
+
 	// Supply factories for any actions you would like this automator to perform.
 	void						addFactory(const std::shared_ptr<BaseActionFactory>&);
 	void						clearFactories();
@@ -61,7 +70,7 @@ private:
 		std::shared_ptr<BaseActionFactory>			mFactory;
 		std::vector<std::shared_ptr<BaseAction>>	mAction;
 
-		std::shared_ptr<BaseAction>					addAction(std::vector<int> &freeList, ds::ui::SpriteEngine& engine, const ci::Rectf& frame);
+		std::shared_ptr<BaseAction>					addAction(std::vector<int> &freeList, ds::ui::SpriteEngine& engine, const ci::Rectf& frame, ci::Rand&);
 	};
 
 
@@ -84,6 +93,9 @@ private:
 	ci::Rectf					mFrame;
 	float						mPeriod;
 	float						mTotal;
+	float						mFixedStep;
+	uint32_t					mSeed;
+	ci::Rand					mRand;
 
 	ds::ui::Text*				mWatermark;
 	std::string					mWatermarkConfig;
@@ -0,0 +1,198 @@
+#include "stdafx.h"
+
+#include "scenario.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <ds/ui/sprite/sprite_engine.h>
+#include <ds/ui/touch/touch_event.h>
+
+#include <cinder/app/TouchEvent.h>
+
+namespace ds {
+namespace debug {
+
+namespace {
+// Same spread the Automator's multi-finger actions use
+const float				MULTI_TAP_RADIUS = 20.0f;
+}
+
+/**
+* \class ds::debug::Scenario
+*/
+Scenario::Scenario()
+	: mFirstTouchId(1000)
+	, mCurrent(0)
+	, mElapsed(0.0f)
+	, mStarted(false)
+{
+}
+
+Scenario& Scenario::tap(const ci::vec2& pos, const float holdSeconds){
+	mSteps.push_back(Step(Step::kTap));
+	mSteps.back().mFrom = pos;
+	mSteps.back().mTo = pos;
+	mSteps.back().mSeconds = holdSeconds;
+	return *this;
+}
+
+Scenario& Scenario::drag(const ci::vec2& from, const ci::vec2& to, const float seconds){
+	mSteps.push_back(Step(Step::kDrag));
+	mSteps.back().mFrom = from;
+	mSteps.back().mTo = to;
+	mSteps.back().mSeconds = seconds;
+	return *this;
+}
+
+Scenario& Scenario::multiTap(const ci::vec2& center, const int fingers, const float holdSeconds){
+	mSteps.push_back(Step(Step::kMultiTap));
+	mSteps.back().mFrom = center;
+	mSteps.back().mTo = center;
+	mSteps.back().mFingers = std::max(1, fingers);
+	mSteps.back().mSeconds = holdSeconds;
+	return *this;
+}
+
+Scenario& Scenario::wait(const float seconds){
+	mSteps.push_back(Step(Step::kWait));
+	mSteps.back().mSeconds = seconds;
+	return *this;
+}
+
+Scenario& Scenario::call(const std::function<void(void)>& fn){
+	mSteps.push_back(Step(Step::kCall));
+	mSteps.back().mCallback = fn;
+	return *this;
+}
+
+Scenario& Scenario::repeat(const int count, const Scenario& s){
+	// Copy first, so a scenario can repeat itself
+	const std::vector<Step>		steps(s.mSteps);
+	for(int k = 0; k < count; ++k){
+		mSteps.insert(mSteps.end(), steps.begin(), steps.end());
+	}
+	return *this;
+}
+
+void Scenario::setFirstTouchId(const int id){
+	mFirstTouchId = id;
+}
+
+bool Scenario::update(ds::ui::SpriteEngine& engine, const float dt){
+	// Steps that finish immediately (calls, finished waits) run back to back in the same frame,
+	// the step after them starts with no time elapsed.
+	float			stepDt = dt;
+	while(mCurrent < mSteps.size()){
+		if(!runStep(engine, mSteps[mCurrent], stepDt)) return false;
+		++mCurrent;
+		mStarted = false;
+		mElapsed = 0.0f;
+		stepDt = 0.0f;
+	}
+	return true;
+}
+
+bool Scenario::isDone() const {
+	return mCurrent >= mSteps.size();
+}
+
+void Scenario::restart(ds::ui::SpriteEngine& engine){
+	if(!mTouchPos.empty()) endTouches(engine, 0.0f);
+	mCurrent = 0;
+	mStarted = false;
+	mElapsed = 0.0f;
+}
+
+bool Scenario::runStep(ds::ui::SpriteEngine& engine, const Step& step, const float dt){
+	const bool		first = !mStarted;
+	if(first){
+		mStarted = true;
+		mElapsed = 0.0f;
+	} else {
+		mElapsed += dt;
+	}
+
+	switch(step.mType){
+	case Step::kCall:
+		if(step.mCallback) step.mCallback();
+		return true;
+
+	case Step::kWait:
+		return mElapsed >= step.mSeconds;
+
+	case Step::kTap:
+	case Step::kMultiTap:
+		if(first) beginTouches(engine, step);
+		if(mElapsed < step.mSeconds) return false;
+		endTouches(engine, dt);
+		return true;
+
+	case Step::kDrag:
+		if(first){
+			beginTouches(engine, step);
+			return false;
+		} else {
+			const float		t = (step.mSeconds > 0.0f ? std::min(1.0f, mElapsed / step.mSeconds) : 1.0f);
+			moveTouches(engine, (step.mTo - step.mFrom) * t, dt);
+			if(t < 1.0f) return false;
+			endTouches(engine, dt);
+			return true;
+		}
+	}
+	return true;
+}
+
+void Scenario::beginTouches(ds::ui::SpriteEngine& engine, const Step& step){
+	mTouchStart.clear();
+	if(step.mType == Step::kMultiTap){
+		const float		angleStep = (2.0f*(float)M_PI) / step.mFingers;
+		float			angle = (float)M_PI;
+		for(int k = 0; k < step.mFingers; ++k){
+			mTouchStart.push_back(step.mFrom + ci::vec2(cos(angle), sin(angle)) * MULTI_TAP_RADIUS);
+			angle += angleStep;
+		}
+	} else {
+		mTouchStart.push_back(step.mFrom);
+	}
+	mTouchPos = mTouchStart;
+
+	std::vector<ci::app::TouchEvent::Touch> touches;
+	for(size_t k = 0; k < mTouchPos.size(); ++k){
+		touches.push_back(ci::app::TouchEvent::Touch(mTouchPos[k], mTouchPos[k], mFirstTouchId + (int)k, 0.0, nullptr));
+	}
+	engine.injectTouchesBegin(ds::ui::TouchEvent(engine.getWindow(), touches, true));
+}
+
+void Scenario::moveTouches(ds::ui::SpriteEngine& engine, const ci::vec2& offset, const float dt){
+	std::vector<ci::app::TouchEvent::Touch> touches;
+	for(size_t k = 0; k < mTouchPos.size(); ++k){
+		const ci::vec2	prev = mTouchPos[k];
+		mTouchPos[k] = mTouchStart[k] + offset;
+		touches.push_back(ci::app::TouchEvent::Touch(mTouchPos[k], prev, mFirstTouchId + (int)k, dt, nullptr));
+	}
+	engine.injectTouchesMoved(ds::ui::TouchEvent(engine.getWindow(), touches, true));
+}
+
+void Scenario::endTouches(ds::ui::SpriteEngine& engine, const float dt){
+	std::vector<ci::app::TouchEvent::Touch> touches;
+	for(size_t k = 0; k < mTouchPos.size(); ++k){
+		touches.push_back(ci::app::TouchEvent::Touch(mTouchPos[k], mTouchPos[k], mFirstTouchId + (int)k, dt, nullptr));
+	}
+	engine.injectTouchesEnded(ds::ui::TouchEvent(engine.getWindow(), touches, true));
+	mTouchStart.clear();
+	mTouchPos.clear();
+}
+
+/**
+* \class ds::debug::Scenario::Step
+*/
+Scenario::Step::Step(const Type t)
+	: mType(t)
+	, mSeconds(0.0f)
+	, mFingers(1)
+{
+}
+
+} // namespace debug
+} // namespace ds
@@ -0,0 +1,90 @@
+#pragma once
+#ifndef ESSENTIALS_DS_DEBUG_AUTOMATOR_SCENARIO_H_
+#define ESSENTIALS_DS_DEBUG_AUTOMATOR_SCENARIO_H_
+
+#include <functional>
+#include <vector>
+#include <cinder/Vector.h>
+
+namespace ds {
+namespace ui {
+class SpriteEngine;
+} // namespace ui
+
+namespace debug {
+
+/**
+* \class ds::debug::Scenario
+*  A scripted run of fake input, for when random touches won't reach the part of
+*  the app you want to exercise. Steps are chained and run in order, one frame at a time:
+*
+*	ds::debug::Scenario		flick;
+*	flick.call([this]{ openViewer(); }).wait(0.5f).drag(ci::vec2(400, 500), ci::vec2(1400, 500), 0.2f)
+*		 .wait(0.5f).call([this]{ closeViewer(); });
+*	ds::debug::Scenario		scenario;
+*	scenario.repeat(20, flick);
+*
+*  Call steps are how a scenario reaches app code (open a viewer, load a page). Touch ids
+*  start at 1000 so they don't collide with the Automator's.
+*/
+class Scenario {
+public:
+	Scenario();
+
+	/// Press at pos and release after holdSeconds
+	Scenario&					tap(const ci::vec2& pos, const float holdSeconds = 0.1f);
+	/// Press at from, move in a straight line to to over seconds, release
+	Scenario&					drag(const ci::vec2& from, const ci::vec2& to, const float seconds = 0.25f);
+	/// Press fingers points in a small circle around center and release them together
+	Scenario&					multiTap(const ci::vec2& center, const int fingers, const float holdSeconds = 0.1f);
+	Scenario&					wait(const float seconds);
+	Scenario&					call(const std::function<void(void)>&);
+	/// Append another scenario's steps count times
+	Scenario&					repeat(const int count, const Scenario&);
+
+	void						setFirstTouchId(const int id);
+
+	/// Run with the frame's delta time. Answers true once the last step has finished.
+	bool						update(ds::ui::SpriteEngine&, const float dt);
+	bool						isDone() const;
+	/// Go back to the first step. Any touches still down are released.
+	void						restart(ds::ui::SpriteEngine&);
+
+	size_t						getStepCount() const { return mSteps.size(); }
+
+private:
+	class Step {
+	public:
+		enum Type { kTap, kDrag, kMultiTap, kWait, kCall };
+		Step(const Type);
+
+		Type					mType;
+		ci::vec2				mFrom,
+								mTo;
+		float					mSeconds;
+		int						mFingers;
+		std::function<void(void)>
+								mCallback;
+	};
+
+	// Answer true when the current step is finished
+	bool						runStep(ds::ui::SpriteEngine&, const Step&, const float dt);
+	void						beginTouches(ds::ui::SpriteEngine&, const Step&);
+	void						moveTouches(ds::ui::SpriteEngine&, const ci::vec2& offset, const float dt);
+	void						endTouches(ds::ui::SpriteEngine&, const float dt);
+
+	std::vector<Step>			mSteps;
+	int							mFirstTouchId;
+
+	size_t						mCurrent;
+	float						mElapsed;
+	bool						mStarted;
+	// Touches down for the current step
+	std::vector<ci::vec2>		mTouchStart,
+								mTouchPos;
+};
+
+} // namespace debug
+} // namespace ds
+
+#endif // ESSENTIALS_DS_DEBUG_AUTOMATOR_SCENARIO_H_
@@ -0,0 +1,337 @@
+#include "stdafx.h"
+
+#include "soak_test.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include <ds/app/app.h>
+#include <ds/app/engine/engine.h>
+#include <ds/cfg/settings.h>
+#include <ds/debug/computer_info.h>
+#include <ds/debug/logger.h>
+#include <ds/params/update_params.h>
+#include <ds/thread/work_manager.h>
+#include <ds/ui/service/load_image_service.h>
+#include <ds/ui/sprite/sprite_engine.h>
+
+#include "ds/debug/automator/automator.h"
+
+#ifndef CINDER_MSW
+#include <unistd.h>
+#endif
+
+namespace ds {
+namespace debug {
+
+namespace {
+// Bits for SoakTest::mFailed
+const int				FAILED_FRAME_TIME = (1<<0);
+const int				FAILED_SPRITES = (1<<1);
+const int				FAILED_MEMORY = (1<<2);
+const int				FAILED_IMAGE_CACHE = (1<<3);
+const int				FAILED_WORK_QUEUE = (1<<4);
+const int				FAILED_FRAME_SPIKE = (1<<5);
+
+double					resident_memory_mb(ds::ui::SpriteEngine& engine) {
+#ifdef CINDER_MSW
+	// The engine updates its computer info every frame, in megabytes
+	return engine.getComputerInfo().getPhysicalMemoryUsedByProcess();
+#else
+	// ComputerInfo is Windows only
+	std::ifstream		statm("/proc/self/statm");
+	long				pages = 0,
+						resident = 0;
+	if(!(statm >> pages >> resident)) return 0.0;
+	return static_cast<double>(resident) * static_cast<double>(sysconf(_SC_PAGESIZE)) / (1024.0 * 1024.0);
+#endif
+}
+}
+
+/**
+* \class ds::debug::SoakTest::Limits
+*/
+SoakTest::Limits::Limits()
+	: mMaxFrameMs(0.0f)
+	, mMaxFrameSpikeMs(0.0f)
+	, mMaxSpriteGrowth(0)
+	, mMaxMemoryGrowthMb(0.0)
+	, mMaxImageCache(0)
+	, mMaxWorkQueue(0)
+{
+}
+
+/**
+* \class ds::debug::SoakTest::Sample
+*/
+SoakTest::Sample::Sample()
+	: mSeconds(0.0)
+	, mFrameAvgMs(0.0f)
+	, mFrameMaxMs(0.0f)
+	, mSprites(0)
+	, mImageCache(0)
+	, mImageQueue(0)
+	, mWorkQueue(0)
+	, mMemoryMb(0.0)
+{
+}
+
+/**
+* \class ds::debug::SoakTest
+*/
+SoakTest::SoakTest(ds::ui::SpriteEngine& engine, Automator* automator)
+	: inherited(engine)
+	, mAutomator(automator)
+	, mScenario(0)
+	, mDuration(0.0f)
+	, mWarmup(10.0f)
+	, mSampleInterval(1.0f)
+	, mFixedStep(0.0f)
+	, mExitWhenDone(false)
+	, mRunning(false)
+	, mElapsed(0.0)
+	, mSinceSample(0.0)
+	, mFrameTotal(0.0)
+	, mFrameMax(0.0f)
+	, mFrameCount(0)
+	, mHasBaseline(false)
+	, mFailed(0)
+{
+}
+
+void SoakTest::loadSettings(ds::cfg::Settings& settings){
+	mDuration = settings.getFloat("soak:duration", 0, mDuration);
+	mWarmup = settings.getFloat("soak:warmup", 0, mWarmup);
+	mSampleInterval = settings.getFloat("soak:sample_interval", 0, mSampleInterval);
+	mReportPath = settings.getString("soak:report", 0, mReportPath);
+	mExitWhenDone = settings.getBool("soak:exit_when_done", 0, mExitWhenDone);
+	setFixedStep(settings.getFloat("soak:fixed_step", 0, mFixedStep));
+
+	const int		seed = settings.getInt("soak:seed", 0, -1);
+	if(seed >= 0 && mAutomator) mAutomator->setSeed(static_cast<uint32_t>(seed));
+
+	mLimits.mMaxFrameMs = settings.getFloat("soak:max_frame_ms", 0, mLimits.mMaxFrameMs);
+	mLimits.mMaxFrameSpikeMs = settings.getFloat("soak:max_frame_spike_ms", 0, mLimits.mMaxFrameSpikeMs);
+	mLimits.mMaxSpriteGrowth = static_cast<size_t>(settings.getInt("soak:max_sprite_growth", 0, static_cast<int>(mLimits.mMaxSpriteGrowth)));
+	mLimits.mMaxMemoryGrowthMb = settings.getDouble("soak:max_memory_growth_mb", 0, mLimits.mMaxMemoryGrowthMb);
+	mLimits.mMaxImageCache = static_cast<size_t>(settings.getInt("soak:max_image_cache", 0, static_cast<int>(mLimits.mMaxImageCache)));
+	mLimits.mMaxWorkQueue = static_cast<size_t>(settings.getInt("soak:max_work_queue", 0, static_cast<int>(mLimits.mMaxWorkQueue)));
+}
+
+void SoakTest::setDuration(const float seconds){
+	mDuration = seconds;
+}
+
+void SoakTest::setWarmup(const float seconds){
+	mWarmup = seconds;
+}
+
+void SoakTest::setSampleInterval(const float seconds){
+	mSampleInterval = seconds;
+}
+
+void SoakTest::setReportPath(const std::string& path){
+	mReportPath = path;
+}
+
+void SoakTest::setExitWhenDone(const bool exit){
+	mExitWhenDone = exit;
+}
+
+void SoakTest::setLimits(const Limits& limits){
+	mLimits = limits;
+}
+
+void SoakTest::setFixedStep(const float seconds){
+	mFixedStep = seconds;
+	if(mAutomator) mAutomator->setFixedStep(seconds);
+}
+
+void SoakTest::addScenario(const Scenario& s){
+	mScenarios.push_back(s);
+}
+
+void SoakTest::start(){
+	if(mRunning) return;
+
+	mRunning = true;
+	mElapsed = 0.0;
+	mSinceSample = 0.0;
+	mFrameTotal = 0.0;
+	mFrameMax = 0.0f;
+	mFrameCount = 0;
+	mSamples.clear();
+	mHasBaseline = false;
+	mFailed = 0;
+	mFailures.clear();
+
+	mScenario = 0;
+	for(auto it = mScenarios.begin(), end = mScenarios.end(); it != end; ++it){
+		it->restart(mEngine);
+	}
+	if(mAutomator) mAutomator->activate();
+
+	DS_LOG_INFO("SoakTest started, duration=" << mDuration << " warmup=" << mWarmup << " seed=" << (mAutomator ? mAutomator->getSeed() : 0));
+}
+
+void SoakTest::stop(){
+	if(!mRunning) return;
+	finish();
+}
+
+void SoakTest::update(const ds::UpdateParams& up){
+	if(!mRunning) return;
+
+	const float		dt = up.getDeltaTime();
+	mElapsed += dt;
+	mSinceSample += dt;
+	mFrameTotal += dt;
+	mFrameMax = std::max(mFrameMax, dt);
+	++mFrameCount;
+
+	if(!mScenarios.empty()){
+		Scenario&	s = mScenarios[mScenario];
+		if(s.update(mEngine, mFixedStep > 0.0f ? mFixedStep : dt)){
+			mScenario = (mScenario + 1) % mScenarios.size();
+			mScenarios[mScenario].restart(mEngine);
+		}
+	}
+
+	if(mSinceSample >= mSampleInterval){
+		const Sample	sample = takeSample();
+		mSamples.push_back(sample);
+		if(mElapsed >= mWarmup){
+			if(!mHasBaseline){
+				mBaseline = sample;
+				mHasBaseline = true;
+			}
+			checkLimits(sample);
+		}
+	}
+
+	if(mDuration > 0.0f && mElapsed >= mDuration){
+		finish();
+	}
+}
+
+SoakTest::Sample SoakTest::takeSample(){
+	Sample			s;
+	s.mSeconds = mElapsed;
+	if(mFrameCount > 0){
+		s.mFrameAvgMs = static_cast<float>(mFrameTotal / mFrameCount * 1000.0);
+		s.mFrameMaxMs = mFrameMax * 1000.0f;
+	}
+	ds::Engine*		engine = dynamic_cast<ds::Engine*>(&mEngine);
+	if(engine) s.mSprites = engine->getNumberOfSprites();
+	s.mImageCache = mEngine.getLoadImageService().getCacheSize();
+	s.mImageQueue = mEngine.getLoadImageService().getQueueSize();
+	s.mWorkQueue = mEngine.getWorkManager().getInputSize();
+	s.mMemoryMb = resident_memory_mb(mEngine);
+
+	mSinceSample = 0.0;
+	mFrameTotal = 0.0;
+	mFrameMax = 0.0f;
+	mFrameCount = 0;
+	return s;
+}
+
+void SoakTest::checkLimits(const Sample& s){
+	std::stringstream	ss;
+	if(mLimits.mMaxFrameMs > 0.0f && s.mFrameAvgMs > mLimits.mMaxFrameMs){
+		ss << "average frame time " << s.mFrameAvgMs << "ms is over " << mLimits.mMaxFrameMs << "ms";
+		fail(FAILED_FRAME_TIME, ss.str());
+		ss.str("");
+	}
+	if(mLimits.mMaxFrameSpikeMs > 0.0f && s.mFrameMaxMs > mLimits.mMaxFrameSpikeMs){
+		ss << "a frame took " << s.mFrameMaxMs << "ms, over " << mLimits.mMaxFrameSpikeMs << "ms";
+		fail(FAILED_FRAME_SPIKE, ss.str());
+		ss.str("");
+	}
+	if(mLimits.mMaxSpriteGrowth > 0 && s.mSprites > mBaseline.mSprites + mLimits.mMaxSpriteGrowth){
+		ss << "sprites grew from " << mBaseline.mSprites << " to " << s.mSprites;
+		fail(FAILED_SPRITES, ss.str());
+		ss.str("");
+	}
+	if(mLimits.mMaxMemoryGrowthMb > 0.0 && s.mMemoryMb > mBaseline.mMemoryMb + mLimits.mMaxMemoryGrowthMb){
+		ss << "memory grew from " << mBaseline.mMemoryMb << "MB to " << s.mMemoryMb << "MB";
+		fail(FAILED_MEMORY, ss.str());
+		ss.str("");
+	}
+	if(mLimits.mMaxImageCache > 0 && s.mImageCache > mLimits.mMaxImageCache){
+		ss << "image cache holds " << s.mImageCache << " images, the limit is " << mLimits.mMaxImageCache;
+		fail(FAILED_IMAGE_CACHE, ss.str());
+		ss.str("");
+	}
+	if(mLimits.mMaxWorkQueue > 0 && s.mWorkQueue > mLimits.mMaxWorkQueue){
+		ss << "work queue has " << s.mWorkQueue << " requests waiting, the limit is " << mLimits.mMaxWorkQueue;
+		fail(FAILED_WORK_QUEUE, ss.str());
+	}
+}
+
+void SoakTest::fail(const int limit, const std::string& msg){
+	if((mFailed&limit) != 0) return;
+	mFailed |= limit;
+
+	std::stringstream	ss;
+	ss << mElapsed << "s: " << msg;
+	mFailures.push_back(ss.str());
+	DS_LOG_WARNING("SoakTest failed at " << ss.str());
+}
+
+void SoakTest::finish(){
+	mRunning = false;
+	if(mAutomator) mAutomator->deactivate();
+	if(!mScenarios.empty()) mScenarios[mScenario].restart(mEngine);
+
+	writeReport();
+
+	if(hasFailed()){
+		DS_LOG_WARNING("SoakTest FAILED after " << mElapsed << "s with " << mFailures.size() << " limit(s) crossed");
+	} else {
+		DS_LOG_INFO("SoakTest passed after " << mElapsed << "s");
+	}
+
+	if(mExitWhenDone){
+		// The app shuts down as usual, flushing the log, then the process exits with the result
+		ds::App*	app = dynamic_cast<ds::App*>(ci::app::App::get());
+		if(app){
+			DS_LOG_INFO("SoakTest quitting with exit code " << (hasFailed() ? 1 : 0));
+			app->quitWithExitCode(hasFailed() ? 1 : 0);
+		} else {
+			DS_LOG_WARNING("SoakTest can't exit when done, the app isn't a ds::App");
+		}
+	}
+}
+
+void SoakTest::writeReport() const {
+	if(mReportPath.empty()) return;
+
+	std::ofstream		f(mReportPath.c_str(), std::ios::out | std::ios::trunc);
+	if(!f.is_open()){
+		DS_LOG_WARNING("SoakTest can't write report to " << mReportPath);
+		return;
+	}
+
+	f << "seconds,frame_avg_ms,frame_max_ms,sprites,image_cache,image_queue,work_queue,memory_mb" << std::endl;
+	for(auto it = mSamples.begin(), end = mSamples.end(); it != end; ++it){
+		f << it->mSeconds << "," << it->mFrameAvgMs << "," << it->mFrameMaxMs << "," << it->mSprites << "," << it->mImageCache
+		  << "," << it->mImageQueue << "," << it->mWorkQueue << "," << it->mMemoryMb << std::endl;
+	}
+
+	// Summary goes after the samples as comments, so the file still loads as a csv
+	f << "# result," << (hasFailed() ? "failed" : "passed") << std::endl;
+	f << "# seconds," << mElapsed << std::endl;
+	f << "# seed," << (mAutomator ? mAutomator->getSeed() : 0) << std::endl;
+	if(mHasBaseline && !mSamples.empty()){
+		const Sample&	last = mSamples.back();
+		f << "# sprite_growth," << (static_cast<double>(last.mSprites) - static_cast<double>(mBaseline.mSprites)) << std::endl;
+		f << "# memory_growth_mb," << (last.mMemoryMb - mBaseline.mMemoryMb) << std::endl;
+	}
+	for(auto it = mFailures.begin(), end = mFailures.end(); it != end; ++it){
+		f << "# failure," << *it << std::endl;
+	}
+}
+
+} // namespace debug
+} // namespace ds
@@ -0,0 +1,141 @@
+#pragma once
+#ifndef ESSENTIALS_DS_DEBUG_AUTOMATOR_SOAK_TEST_H_
+#define ESSENTIALS_DS_DEBUG_AUTOMATOR_SOAK_TEST_H_
+
+#include <string>
+#include <vector>
+#include <ds/app/auto_update.h>
+#include "ds/debug/automator/scenario.h"
+
+namespace ds {
+namespace cfg {
+class Settings;
+} // namespace cfg
+
+namespace debug {
+class Automator;
+
+/**
+* \class ds::debug::SoakTest
+*  Drives an app with an Automator and/or scripted Scenarios for a while, samples how
+*  the engine is holding up, writes a report and fails if anything crossed a limit.
+*  Meant for finding leaks and slowdowns in a long unattended run, like on a CI box.
+*
+* Use:
+*  - Make one on your app after the engine is set up, hand it your Automator if you have one
+*  - Add any scenarios, call loadSettings() to pick up the soak: settings, then start()
+*  - With exit_when_done the app quits when the test is over, and the process exits 0 if it
+*    passed, 1 if not, after the normal shutdown
+*
+*  Every sample is the frame time (average and worst since the last sample), sprite count,
+*  image cache and queue size, WorkManager queue and the process's resident memory. Growth
+*  limits are measured from the first sample after the warmup, so startup loading doesn't count.
+*
+*  There's no no-window mode: the engine, its roots and Cinder's app loop all need a window
+*  and a GL context, and running without them is out of scope. On a machine without a
+*  display, run the app under a virtual one (Xvfb on Linux).
+*/
+class SoakTest : public ds::AutoUpdate {
+public:
+	/// 0 turns a limit off
+	class Limits {
+	public:
+		Limits();
+		/// The average frame time over a sample
+		float					mMaxFrameMs;
+		/// The worst single frame in a sample
+		float					mMaxFrameSpikeMs;
+		size_t					mMaxSpriteGrowth;
+		double					mMaxMemoryGrowthMb;
+		size_t					mMaxImageCache;
+		size_t					mMaxWorkQueue;
+	};
+
+	class Sample {
+	public:
+		Sample();
+		double					mSeconds;
+		float					mFrameAvgMs;
+		float					mFrameMaxMs;
+		size_t					mSprites;
+		size_t					mImageCache;
+		size_t					mImageQueue;
+		size_t					mWorkQueue;
+		double					mMemoryMb;
+	};
+
+	SoakTest(ds::ui::SpriteEngine&, Automator* = nullptr);
+
+	/// Reads the soak: settings (duration, warmup, sample_interval, report, exit_when_done,
+	/// seed, fixed_step and the max_ limits). Anything missing keeps its current value.
+	void						loadSettings(ds::cfg::Settings&);
+
+	/// Seconds to run. 0 runs until stop() is called.
+	void						setDuration(const float seconds);
+	void						setWarmup(const float seconds);
+	void						setSampleInterval(const float seconds);
+	/// The csv report is written here when the test finishes. Empty writes no report.
+	void						setReportPath(const std::string&);
+	void						setExitWhenDone(const bool);
+	void						setLimits(const Limits&);
+	/// Scenarios and the automator step by this instead of the frame time. 0 uses the frame time.
+	void						setFixedStep(const float seconds);
+
+	/// Scenarios run one after another, starting over after the last, for the whole test
+	void						addScenario(const Scenario&);
+
+	void						start();
+	/// Finishes the test early. The report is still written.
+	void						stop();
+
+	bool						isRunning() const { return mRunning; }
+	bool						hasFailed() const { return !mFailures.empty(); }
+	const std::vector<Sample>&	getSamples() const { return mSamples; }
+	const std::vector<std::string>&
+								getFailures() const { return mFailures; }
+
+protected:
+	virtual void				update(const ds::UpdateParams&);
+
+private:
+	typedef ds::AutoUpdate		inherited;
+
+	Sample						takeSample();
+	void						checkLimits(const Sample&);
+	void						fail(const int limit, const std::string& msg);
+	void						finish();
+	void						writeReport() const;
+
+	Automator*					mAutomator;
+	std::vector<Scenario>		mScenarios;
+	size_t						mScenario;
+
+	float						mDuration;
+	float						mWarmup;
+	float						mSampleInterval;
+	float						mFixedStep;
+	std::string					mReportPath;
+	bool						mExitWhenDone;
+	Limits						mLimits;
+
+	bool						mRunning;
+	double						mElapsed;
+	double						mSinceSample;
+	// Frame times since the last sample
+	double						mFrameTotal;
+	float						mFrameMax;
+	int							mFrameCount;
+
+	std::vector<Sample>			mSamples;
+	// The first sample after the warmup, growth is measured from here
+	bool						mHasBaseline;
+	Sample						mBaseline;
+	// One bit per limit, so each one is only reported the first time it's crossed
+	int							mFailed;
+	std::vector<std::string>	mFailures;
+};
+
+} // namespace debug
+} // namespace ds
+
+#endif // ESSENTIALS_DS_DEBUG_AUTOMATOR_SOAK_TEST_H_
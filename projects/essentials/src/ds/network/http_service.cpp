@@ -0,0 +1,866 @@
+#include "stdafx.h"
+
+#include "http_service.h"
+
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <Poco/DirectoryIterator.h>
+#include <Poco/File.h>
+#include <Poco/Net/DatagramSocket.h>
+#include <Poco/Net/SocketImpl.h>
+#include <Poco/Path.h>
+#include <Poco/Timestamp.h>
+
+#define CURL_STATICLIB
+#include "ds/network/curl/curl.h"
+
+#include <ds/app/app.h>
+#include <ds/app/engine/engine.h>
+#include <ds/app/environment.h>
+#include <ds/cfg/settings.h>
+#include <ds/debug/logger.h>
+#include <ds/ui/service/load_image_service.h>
+#include <ds/util/fnv_hash.h>
+
+namespace {
+const std::string			HTTP_SERVICE_NAME("http");
+const ds::BitMask			HTTP_LOG_M = ds::Logger::newModule("http");
+
+// Statically initialize the service. Done here because get() is
+// guaranteed to be referenced by anything that uses it.
+class Init {
+public:
+	Init() {
+		ds::App::AddStartup([](ds::Engine& e) {
+			ds::net::HttpService*		w = new ds::net::HttpService(e);
+			if(!w) {
+				DS_LOG_WARNING("Couldn't create the http service!");
+				return;
+			}
+			e.addService(HTTP_SERVICE_NAME, *w);
+		});
+	}
+	void					doNothing() { }
+};
+Init						INIT;
+
+// Longest curl_multi_wait, anything new wakes it sooner
+const int					MAX_WAIT_MS = 1000;
+// Trim to this much of the budget once it's over, so it isn't trimmed again on every write
+const double				CACHE_TRIM = 0.9;
+
+bool						ends_with(const std::string& s, const std::string& end) {
+	return s.size() >= end.size() && s.compare(s.size() - end.size(), end.size(), end) == 0;
+}
+
+// The value of a header line if it's the named header, without the line ending
+bool						header_value(const char* line, const size_t size, const char* name, std::string& out) {
+	const size_t			nameSize = strlen(name);
+	if(size <= nameSize || line[nameSize] != ':') return false;
+	for(size_t i = 0; i < nameSize; ++i) {
+		if(tolower(static_cast<unsigned char>(line[i])) != tolower(static_cast<unsigned char>(name[i]))) return false;
+	}
+	size_t					first = nameSize + 1,
+							last = size;
+	while(first < last && (line[first] == ' ' || line[first] == '\t')) ++first;
+	while(last > first && (line[last - 1] == '\r' || line[last - 1] == '\n' || line[last - 1] == ' ')) --last;
+	out.assign(line + first, last - first);
+	return true;
+}
+
+// Cache-Control that says not to keep the reply. Private is taken at its word too, a kiosk's
+// cache outlives whoever the reply was for.
+bool						forbids_storing(const std::string& cacheControl) {
+	std::string				v(cacheControl);
+	std::transform(v.begin(), v.end(), v.begin(), [](unsigned char c) { return static_cast<char>(tolower(c)); });
+	return v.find("no-store") != std::string::npos || v.find("private") != std::string::npos;
+}
+
+bool						read_file(const std::string& path, std::string& out) {
+	std::ifstream			in(path.c_str(), std::ios::in | std::ios::binary);
+	if(!in) return false;
+	std::ostringstream		ss;
+	ss << in.rdbuf();
+	out = ss.str();
+	return !in.bad();
+}
+
+// Written next to the destination then renamed, so a half written file is never read
+bool						write_file(const std::string& path, const std::string& data) {
+	const std::string		tmp(path + ".tmp");
+	{
+		std::ofstream		out(tmp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if(!out) return false;
+		out.write(data.data(), data.size());
+		if(!out) return false;
+	}
+	try {
+		Poco::File(tmp).renameTo(path);
+		return true;
+	} catch(std::exception const&) {
+	}
+	return false;
+}
+
+/**
+ * DiskCache
+ * Each key is a url and the header lines the request added, since those can change the reply.
+ * A key is two files named by its hash, the body and a .meta with the number of lines in the
+ * key, the key, then the ETag and Last-Modified on a line each. Only used on the worker thread.
+ */
+class DiskCache {
+public:
+	struct Entry {
+		std::string			mEtag;
+		std::string			mLastModified;
+	};
+
+	DiskCache()
+		: mBudget(0)
+		, mBytes(0)
+	{}
+
+	void					setup(const std::string& folder, const uint64_t budget) {
+		mBudget = budget;
+		if(folder.empty()) return;
+
+		try {
+			Poco::Path		p(ds::Environment::expand(folder));
+			p.makeDirectory();
+			Poco::File		dir(p.toString());
+			if(!dir.exists()) dir.createDirectories();
+			mFolder = p.toString();
+		} catch(std::exception const& ex) {
+			DS_LOG_WARNING_M("HttpService could not create the cache folder, caching is off. error=" << ex.what(), HTTP_LOG_M);
+			return;
+		}
+
+		// Leftover .tmp files are from a run that quit mid-write
+		try {
+			Poco::DirectoryIterator		end;
+			for(Poco::DirectoryIterator it(mFolder); it != end; ++it) {
+				if(!it->isFile()) continue;
+				if(ends_with(it.name(), ".tmp")) {
+					it->remove();
+					continue;
+				}
+				mBytes += static_cast<uint64_t>(it->getSize());
+			}
+		} catch(std::exception const& ex) {
+			DS_LOG_WARNING_M("HttpService error scanning the cache folder error=" << ex.what(), HTTP_LOG_M);
+		}
+		enforceBudget();
+	}
+
+	bool					isEnabled() const { return !mFolder.empty(); }
+
+	bool					find(const std::string& key, Entry& out) const {
+		if(!isEnabled()) return false;
+
+		std::string			meta;
+		if(!read_file(metaPath(key), meta)) return false;
+		std::istringstream	ss(meta);
+		size_t				lines = 0;
+		std::string			line, storedKey;
+		if(!(ss >> lines) || lines < 1 || !std::getline(ss, line)) return false;
+		for(size_t i = 0; i < lines; ++i) {
+			if(!std::getline(ss, line)) return false;
+			if(i > 0) storedKey += "\n";
+			storedKey += line;
+		}
+		if(storedKey != key) return false;
+		std::getline(ss, out.mEtag);
+		std::getline(ss, out.mLastModified);
+		return !out.mEtag.empty() || !out.mLastModified.empty();
+	}
+
+	bool					readBody(const std::string& key, std::string& out) {
+		if(!isEnabled() || !read_file(bodyPath(key), out)) return false;
+
+		// Oldest are dropped first when it's over budget
+		try {
+			Poco::File(bodyPath(key)).setLastModified(Poco::Timestamp());
+		} catch(std::exception const&) {
+		}
+		return true;
+	}
+
+	void					write(const std::string& key, const Entry& e, const std::string& body) {
+		if(!isEnabled()) return;
+
+		remove(key);
+		if(mBudget > 0 && body.size() > mBudget) return;
+
+		std::ostringstream	meta;
+		meta << std::count(key.begin(), key.end(), '\n') + 1 << "\n" << key << "\n" << e.mEtag << "\n" << e.mLastModified << "\n";
+		if(!write_file(bodyPath(key), body) || !write_file(metaPath(key), meta.str())) {
+			remove(key);
+			return;
+		}
+		mBytes += body.size() + meta.str().size();
+		enforceBudget();
+	}
+
+	void					remove(const std::string& key) {
+		if(!isEnabled()) return;
+		removeFile(bodyPath(key));
+		removeFile(metaPath(key));
+	}
+
+private:
+	std::string				bodyPath(const std::string& key) const { return mFolder + ds::fnv_hash_string(key); }
+	std::string				metaPath(const std::string& key) const { return bodyPath(key) + ".meta"; }
+
+	void					removeFile(const std::string& path) {
+		try {
+			Poco::File		f(path);
+			if(!f.exists()) return;
+			const uint64_t	size = static_cast<uint64_t>(f.getSize());
+			f.remove();
+			mBytes -= std::min(mBytes, size);
+		} catch(std::exception const&) {
+		}
+	}
+
+	// Drop the least recently used bodies and their .meta until it's comfortably under
+	void					enforceBudget() {
+		if(mBudget == 0 || mBytes <= mBudget) return;
+
+		std::vector<std::pair<Poco::Timestamp, std::string>>	bodies;
+		try {
+			Poco::DirectoryIterator		end;
+			for(Poco::DirectoryIterator it(mFolder); it != end; ++it) {
+				if(!it->isFile() || ends_with(it.name(), ".meta") || ends_with(it.name(), ".tmp")) continue;
+				bodies.push_back(std::make_pair(it->getLastModified(), it->path()));
+			}
+		} catch(std::exception const& ex) {
+			DS_LOG_WARNING_M("HttpService error scanning the cache folder error=" << ex.what(), HTTP_LOG_M);
+			return;
+		}
+		std::sort(bodies.begin(), bodies.end());
+
+		const uint64_t		target = static_cast<uint64_t>(mBudget * CACHE_TRIM);
+		for(auto it = bodies.begin(), end = bodies.end(); it != end && mBytes > target; ++it) {
+			removeFile(it->second);
+			removeFile(it->second + ".meta");
+		}
+	}
+
+	std::string				mFolder;
+	uint64_t				mBudget;
+	uint64_t				mBytes;
+};
+
+// A blocking request waits on one of these instead of getting a callback
+struct Waiter {
+	Waiter() : mDone(false) {}
+
+	std::mutex					mMutex;
+	std::condition_variable		mCondition;
+	bool						mDone;
+	ds::net::HttpService::Reply	mReply;
+};
+
+}
+
+namespace ds {
+namespace net {
+
+/**
+ * \class ds::net::HttpService::Worker
+ * Owns the curl handles and the thread that runs them. Everything other threads touch is
+ * behind mMutex, and they poke the wake socket so a curl_multi_wait() returns straight away.
+ */
+class HttpService::Worker {
+public:
+	struct Settings {
+		long								mMaxConnections;
+		long								mMaxHostConnections;
+		size_t								mMaxTransfers;
+		std::string							mCacheFolder;
+		uint64_t							mCacheBudget;
+	};
+
+	Worker(const Settings& s)
+		: mSettings(s)
+		, mMulti(nullptr)
+		, mShare(nullptr)
+		, mNextId(1)
+		, mStopping(false)
+		, mStopped(false)
+	{
+		mMulti = curl_multi_init();
+		mShare = curl_share_init();
+		if(!mMulti || !mShare) {
+			DS_LOG_WARNING_M("HttpService couldn't make its curl handles", HTTP_LOG_M);
+			mStopped = true;
+			return;
+		}
+
+		curl_multi_setopt(mMulti, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+		curl_multi_setopt(mMulti, CURLMOPT_MAX_TOTAL_CONNECTIONS, mSettings.mMaxConnections);
+		curl_multi_setopt(mMulti, CURLMOPT_MAX_HOST_CONNECTIONS, mSettings.mMaxHostConnections);
+		// Connections and the dns cache are already shared by everything in the multi handle
+		curl_share_setopt(mShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+
+		try {
+			mWakeSocket.bind(Poco::Net::SocketAddress("127.0.0.1", 0));
+			mWakeSocket.setBlocking(false);
+		} catch(std::exception const& ex) {
+			DS_LOG_WARNING_M("HttpService couldn't make its wake up socket error=" << ex.what(), HTTP_LOG_M);
+		}
+
+		mThread = std::thread(&Worker::run, this);
+	}
+
+	~Worker() {
+		stop();
+
+		for(auto it : mIdle) curl_easy_cleanup(it);
+		if(mMulti) curl_multi_cleanup(mMulti);
+		if(mShare) curl_share_cleanup(mShare);
+	}
+
+	RequestId							add(const Request& r, const std::shared_ptr<Waiter>& waiter) {
+		std::unique_ptr<Transfer>		t(new Transfer());
+		t->mRequest = r;
+		t->mWaiter = waiter;
+		RequestId						id = 0;
+		{
+			std::lock_guard<std::mutex>	lock(mMutex);
+			if(mStopping || mStopped) return 0;
+			id = mNextId;
+			// 0 is never an id
+			mNextId = (mNextId == std::numeric_limits<RequestId>::max()) ? 1 : mNextId + 1;
+			t->mId = id;
+			mQueued.push_back(std::move(t));
+		}
+		wake();
+		return id;
+	}
+
+	void								cancel(const RequestId id) {
+		{
+			std::lock_guard<std::mutex>	lock(mMutex);
+			for(auto it = mQueued.begin(), end = mQueued.end(); it != end; ++it) {
+				if((*it)->mId == id) {
+					mQueued.erase(it);
+					return;
+				}
+			}
+			mCanceled.push_back(id);
+		}
+		wake();
+	}
+
+	void								stop() {
+		{
+			std::lock_guard<std::mutex>	lock(mMutex);
+			if(mStopping) return;
+			mStopping = true;
+		}
+		wake();
+		if(mThread.joinable()) mThread.join();
+	}
+
+	// Replies for callbacks, for the main thread
+	void								takeDone(std::vector<std::pair<RequestId, Reply>>& out) {
+		std::lock_guard<std::mutex>		lock(mMutex);
+		out.swap(mDone);
+	}
+
+	Stats								getStats() const {
+		std::lock_guard<std::mutex>		lock(mMutex);
+		return mStats;
+	}
+
+private:
+	struct Transfer {
+		Transfer()
+			: mId(0)
+			, mEasy(nullptr)
+			, mHeaderList(nullptr)
+			, mFile(nullptr)
+			, mConditional(false)
+			, mNoStore(false)
+		{}
+
+		RequestId						mId;
+		Request							mRequest;
+		Reply							mReply;
+		std::shared_ptr<Waiter>			mWaiter;
+		CURL*							mEasy;
+		curl_slist*						mHeaderList;
+		std::FILE*						mFile;
+		// The request had If-None-Match or If-Modified-Since from the cache
+		bool							mConditional;
+		DiskCache::Entry				mValidators;
+		// The reply's Cache-Control said not to keep it
+		bool							mNoStore;
+		std::string						mCacheKey;
+	};
+
+	static size_t						onBody(char* data, size_t size, size_t count, void* user) {
+		Transfer*						t = static_cast<Transfer*>(user);
+		const size_t					bytes = size * count;
+		if(t->mFile) return std::fwrite(data, 1, bytes, t->mFile);
+		t->mReply.mBody.append(data, bytes);
+		return bytes;
+	}
+
+	static size_t						onHeader(char* line, size_t size, size_t count, void* user) {
+		Transfer*						t = static_cast<Transfer*>(user);
+		const size_t					bytes = size * count;
+		// Each response starts with its status line, only the last one after any redirects counts
+		if(bytes > 5 && strncmp(line, "HTTP/", 5) == 0) {
+			t->mValidators = DiskCache::Entry();
+			t->mNoStore = false;
+			if(!t->mFile) t->mReply.mBody.clear();
+			return bytes;
+		}
+		std::string						value;
+		if(header_value(line, bytes, "ETag", value)) t->mValidators.mEtag = value;
+		else if(header_value(line, bytes, "Last-Modified", value)) t->mValidators.mLastModified = value;
+		else if(header_value(line, bytes, "Cache-Control", value) && forbids_storing(value)) t->mNoStore = true;
+		return bytes;
+	}
+
+	void								run() {
+		mCache.setup(mSettings.mCacheFolder, mSettings.mCacheBudget);
+
+		curl_waitfd						wakeFd;
+		wakeFd.fd = mWakeSocket.impl() ? static_cast<curl_socket_t>(mWakeSocket.impl()->sockfd()) : CURL_SOCKET_BAD;
+		wakeFd.events = CURL_WAIT_POLLIN;
+		wakeFd.revents = 0;
+
+		while(true) {
+			std::vector<RequestId>		canceled;
+			{
+				std::lock_guard<std::mutex>	lock(mMutex);
+				if(mStopping) break;
+				canceled.swap(mCanceled);
+			}
+			for(auto id : canceled) {
+				for(auto it = mActive.begin(), end = mActive.end(); it != end; ++it) {
+					if(it->second->mId != id) continue;
+					std::unique_ptr<Transfer>	t(std::move(it->second));
+					mActive.erase(it);
+					release(*t);
+					break;
+				}
+			}
+
+			startQueued();
+
+			int							running = 0;
+			curl_multi_perform(mMulti, &running);
+
+			CURLMsg*					msg = nullptr;
+			int							left = 0;
+			while((msg = curl_multi_info_read(mMulti, &left)) != nullptr) {
+				if(msg->msg == CURLMSG_DONE) finish(msg->easy_handle, msg->data.result);
+			}
+
+			int							ready = 0;
+			curl_multi_wait(mMulti, wakeFd.fd == CURL_SOCKET_BAD ? nullptr : &wakeFd, wakeFd.fd == CURL_SOCKET_BAD ? 0 : 1, MAX_WAIT_MS, &ready);
+			drainWake();
+		}
+
+		// Anything left never finishes
+		std::vector<std::unique_ptr<Transfer>>	left;
+		{
+			std::lock_guard<std::mutex>	lock(mMutex);
+			mStopped = true;
+			for(auto& it : mQueued) left.push_back(std::move(it));
+			mQueued.clear();
+		}
+		for(auto& it : mActive) {
+			release(*it.second);
+			left.push_back(std::move(it.second));
+		}
+		mActive.clear();
+		for(auto& it : left) {
+			it->mReply.mErrored = true;
+			it->mReply.mError = "The http service stopped";
+			deliver(std::move(it));
+		}
+	}
+
+	void								startQueued() {
+		while(mActive.size() < mSettings.mMaxTransfers) {
+			std::unique_ptr<Transfer>	t;
+			{
+				std::lock_guard<std::mutex>	lock(mMutex);
+				if(mQueued.empty()) return;
+				t = std::move(mQueued.front());
+				mQueued.pop_front();
+			}
+			if(!begin(*t)) {
+				release(*t);
+				deliver(std::move(t));
+				continue;
+			}
+			CURL*						easy = t->mEasy;
+			mActive[easy] = std::move(t);
+		}
+	}
+
+	bool								begin(Transfer& t) {
+		const Request&					r = t.mRequest;
+		if(r.mUrl.empty()) {
+			t.mReply.mErrored = true;
+			t.mReply.mError = "No url specified";
+			return false;
+		}
+
+		if(mIdle.empty()) {
+			t.mEasy = curl_easy_init();
+		} else {
+			t.mEasy = mIdle.back();
+			mIdle.pop_back();
+		}
+		if(!t.mEasy) {
+			t.mReply.mErrored = true;
+			t.mReply.mError = "Couldn't make a curl handle";
+			return false;
+		}
+
+		if(!r.mDownloadFile.empty()) {
+			t.mFile = std::fopen(r.mDownloadFile.c_str(), "wb");
+			if(!t.mFile) {
+				t.mReply.mErrored = true;
+				t.mReply.mError = "Couldn't create the download file " + r.mDownloadFile;
+				return false;
+			}
+		}
+
+		CURL*							e = t.mEasy;
+		curl_easy_setopt(e, CURLOPT_URL, r.mUrl.c_str());
+		curl_easy_setopt(e, CURLOPT_PRIVATE, &t);
+		curl_easy_setopt(e, CURLOPT_SHARE, mShare);
+		curl_easy_setopt(e, CURLOPT_NOSIGNAL, 1L);
+		curl_easy_setopt(e, CURLOPT_CONNECTTIMEOUT, 30L);
+		curl_easy_setopt(e, CURLOPT_TIMEOUT, r.mTimeout);
+		curl_easy_setopt(e, CURLOPT_TCP_KEEPALIVE, 1L);
+		curl_easy_setopt(e, CURLOPT_ACCEPT_ENCODING, "");
+		// HTTP/2 over https when the server offers it, and wait for a connection to
+		// multiplex on instead of opening another
+		curl_easy_setopt(e, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+		curl_easy_setopt(e, CURLOPT_PIPEWAIT, 1L);
+		curl_easy_setopt(e, CURLOPT_WRITEFUNCTION, &Worker::onBody);
+		curl_easy_setopt(e, CURLOPT_WRITEDATA, &t);
+		curl_easy_setopt(e, CURLOPT_HEADERFUNCTION, &Worker::onHeader);
+		curl_easy_setopt(e, CURLOPT_HEADERDATA, &t);
+		if(r.mVerbose) curl_easy_setopt(e, CURLOPT_VERBOSE, 1L);
+		if(r.mFollowRedirects) curl_easy_setopt(e, CURLOPT_FOLLOWLOCATION, 1L);
+		if(!r.mVerifyPeers) curl_easy_setopt(e, CURLOPT_SSL_VERIFYPEER, 0L);
+		if(!r.mVerifyHosts) curl_easy_setopt(e, CURLOPT_SSL_VERIFYHOST, 0L);
+
+		if(!r.mMethod.empty()) curl_easy_setopt(e, CURLOPT_CUSTOMREQUEST, r.mMethod.c_str());
+		if(!r.mBody.empty()) {
+			curl_easy_setopt(e, CURLOPT_POSTFIELDSIZE, static_cast<long>(r.mBody.size()));
+			curl_easy_setopt(e, CURLOPT_POSTFIELDS, r.mBody.data());
+		}
+
+		for(auto& it : r.mHeaders) {
+			t.mHeaderList = curl_slist_append(t.mHeaderList, it.c_str());
+		}
+		if(isCacheable(t)) t.mCacheKey = cacheKey(r);
+		if(!t.mCacheKey.empty() && mCache.find(t.mCacheKey, t.mValidators)) {
+			t.mConditional = true;
+			if(!t.mValidators.mEtag.empty()) {
+				t.mHeaderList = curl_slist_append(t.mHeaderList, ("If-None-Match: " + t.mValidators.mEtag).c_str());
+			}
+			if(!t.mValidators.mLastModified.empty()) {
+				t.mHeaderList = curl_slist_append(t.mHeaderList, ("If-Modified-Since: " + t.mValidators.mLastModified).c_str());
+			}
+		}
+		if(t.mHeaderList) curl_easy_setopt(e, CURLOPT_HTTPHEADER, t.mHeaderList);
+
+		if(curl_multi_add_handle(mMulti, e) != CURLM_OK) {
+			t.mReply.mErrored = true;
+			t.mReply.mError = "Couldn't start the transfer";
+			return false;
+		}
+		return true;
+	}
+
+	bool								isCacheable(const Transfer& t) const {
+		const Request&					r = t.mRequest;
+		if(!r.mUseCache || !mCache.isEnabled() || !r.mBody.empty() || !r.mDownloadFile.empty() || !(r.mMethod.empty() || r.mMethod == "GET")) return false;
+
+		std::string						value;
+		for(auto& it : r.mHeaders) {
+			if(header_value(it.c_str(), it.size(), "Cache-Control", value) && forbids_storing(value)) return false;
+		}
+		return true;
+	}
+
+	// The url, then each header line the request adds, since they can change the reply
+	static std::string					cacheKey(const Request& r) {
+		std::string						key(r.mUrl);
+		for(auto& it : r.mHeaders) {
+			key += "\n";
+			key += it;
+		}
+		return key;
+	}
+
+	void								finish(CURL* easy, const CURLcode result) {
+		auto							found = mActive.find(easy);
+		if(found == mActive.end()) return;
+		std::unique_ptr<Transfer>		t(std::move(found->second));
+		mActive.erase(found);
+
+		Reply&							reply = t->mReply;
+		long							connects = 0;
+		curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &reply.mHttpCode);
+		curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &connects);
+
+		bool							cacheHit = false;
+		if(result != CURLE_OK) {
+			reply.mErrored = true;
+			reply.mError = curl_easy_strerror(result);
+			DS_LOG_WARNING_M("HttpService " << reply.mError << " url=" << t->mRequest.mUrl, HTTP_LOG_M);
+		} else if(reply.mHttpCode == 304 && t->mConditional) {
+			if(mCache.readBody(t->mCacheKey, reply.mBody)) {
+				reply.mHttpCode = 200;
+				reply.mFromCache = true;
+				cacheHit = true;
+			} else {
+				mCache.remove(t->mCacheKey);
+			}
+		} else if(reply.mHttpCode == 200 && !t->mCacheKey.empty()) {
+			if(t->mNoStore || (t->mValidators.mEtag.empty() && t->mValidators.mLastModified.empty())) {
+				mCache.remove(t->mCacheKey);
+			} else {
+				mCache.write(t->mCacheKey, t->mValidators, reply.mBody);
+			}
+		}
+
+		DS_LOG_VERBOSE(1, "HttpService request completed with result=" << result << " httpCode=" << reply.mHttpCode << " fromCache=" << reply.mFromCache << " url=" << t->mRequest.mUrl);
+
+		{
+			std::lock_guard<std::mutex>	lock(mMutex);
+			++mStats.mTransfers;
+			mStats.mConnections += static_cast<unsigned>(connects);
+			if(cacheHit) ++mStats.mCacheHits;
+		}
+
+		release(*t);
+		deliver(std::move(t));
+	}
+
+	// Give the handles back, keeping the easy handle for the next transfer
+	void								release(Transfer& t) {
+		if(t.mEasy) {
+			curl_multi_remove_handle(mMulti, t.mEasy);
+			curl_easy_reset(t.mEasy);
+			if(mIdle.size() < mSettings.mMaxTransfers) mIdle.push_back(t.mEasy);
+			else curl_easy_cleanup(t.mEasy);
+			t.mEasy = nullptr;
+		}
+		if(t.mHeaderList) {
+			curl_slist_free_all(t.mHeaderList);
+			t.mHeaderList = nullptr;
+		}
+		if(t.mFile) {
+			std::fclose(t.mFile);
+			t.mFile = nullptr;
+		}
+	}
+
+	void								deliver(std::unique_ptr<Transfer> t) {
+		if(t->mWaiter) {
+			std::lock_guard<std::mutex>	lock(t->mWaiter->mMutex);
+			t->mWaiter->mReply = t->mReply;
+			t->mWaiter->mDone = true;
+			t->mWaiter->mCondition.notify_all();
+			return;
+		}
+
+		std::lock_guard<std::mutex>		lock(mMutex);
+		mDone.push_back(std::make_pair(t->mId, t->mReply));
+	}
+
+	void								wake() {
+		try {
+			mWakeSocket.sendTo("w", 1, mWakeSocket.address());
+		} catch(std::exception const&) {
+		}
+	}
+
+	void								drainWake() {
+		char							buf[64];
+		try {
+			while(mWakeSocket.available() > 0) mWakeSocket.receiveBytes(buf, sizeof(buf));
+		} catch(std::exception const&) {
+		}
+	}
+
+	const Settings						mSettings;
+	CURLM*								mMulti;
+	CURLSH*								mShare;
+	std::vector<CURL*>					mIdle;
+	std::unordered_map<CURL*, std::unique_ptr<Transfer>>
+										mActive;
+	DiskCache							mCache;
+	Poco::Net::DatagramSocket			mWakeSocket;
+	std::thread							mThread;
+
+	mutable std::mutex					mMutex;
+	RequestId							mNextId;
+	bool								mStopping;
+	bool								mStopped;
+	std::deque<std::unique_ptr<Transfer>>
+										mQueued;
+	std::vector<RequestId>				mCanceled;
+	std::vector<std::pair<RequestId, Reply>>
+										mDone;
+	Stats								mStats;
+};
+
+/**
+ * \class ds::net::HttpService
+ */
+HttpService& HttpService::get(ds::ui::SpriteEngine& e) {
+	INIT.doNothing();
+	return e.getService<HttpService>(HTTP_SERVICE_NAME);
+}
+
+HttpService::HttpService(ds::ui::SpriteEngine& e)
+	: ds::AutoUpdate(e, AutoUpdateType::SERVER | AutoUpdateType::CLIENT)
+{
+	static std::once_flag			curlInit;
+	std::call_once(curlInit, [](){ curl_global_init(CURL_GLOBAL_ALL); });
+
+	ds::cfg::Settings&				settings = mEngine.getSettings("engine");
+	Worker::Settings				s;
+	s.mMaxConnections = std::max(1, settings.getInt("http:max_connections", 0, 16));
+	s.mMaxHostConnections = std::max(1, settings.getInt("http:max_host_connections", 0, 6));
+	s.mMaxTransfers = static_cast<size_t>(std::max(1, settings.getInt("http:max_transfers", 0, 32)));
+	s.mCacheFolder = settings.getBool("http:cache", 0, true) ? settings.getString("http:cache_folder", 0, "%LOCAL%/cache/http") : "";
+	s.mCacheBudget = static_cast<uint64_t>(std::max(0, settings.getInt("http:cache_budget_mb", 0, 256))) * 1024 * 1024;
+	mWorker = std::make_shared<Worker>(s);
+
+	// Remote images go through here too, so they're pooled and cached like everything else
+	std::shared_ptr<Worker>			worker(mWorker);
+	mEngine.getLoadImageService().setUrlLoader([worker](const std::string& url, std::string& out) {
+		Request						r(url);
+		r.mFollowRedirects = true;
+		std::shared_ptr<Waiter>		waiter(new Waiter());
+		if(!worker->add(r, waiter)) return false;
+
+		std::unique_lock<std::mutex>	lock(waiter->mMutex);
+		waiter->mCondition.wait(lock, [&waiter](){ return waiter->mDone; });
+		if(waiter->mReply.mErrored || waiter->mReply.mHttpCode != 200) return false;
+		out.swap(waiter->mReply.mBody);
+		return true;
+	});
+}
+
+HttpService::~HttpService() {
+	stop();
+}
+
+void HttpService::stop() {
+	mCallbacks.clear();
+	if(mWorker) mWorker->stop();
+}
+
+HttpService::RequestId HttpService::request(const Request& r, const Callback& cb) {
+	if(r.mUrl.empty()) {
+		DS_LOG_WARNING_M("Couldn't make a request in HttpService because the url is empty", HTTP_LOG_M);
+		return 0;
+	}
+
+	const RequestId					id = mWorker->add(r, nullptr);
+	if(id && cb) mCallbacks[id] = cb;
+	return id;
+}
+
+void HttpService::cancel(const RequestId id) {
+	if(!id) return;
+
+	mCallbacks.erase(id);
+	mWorker->cancel(id);
+}
+
+bool HttpService::requestAndWait(const Request& r, Reply& out) {
+	std::shared_ptr<Waiter>			waiter(new Waiter());
+	if(!mWorker->add(r, waiter)) return false;
+
+	std::unique_lock<std::mutex>	lock(waiter->mMutex);
+	waiter->mCondition.wait(lock, [&waiter](){ return waiter->mDone; });
+	out = waiter->mReply;
+	return !out.mErrored;
+}
+
+HttpService::Stats HttpService::getStats() const {
+	return mWorker->getStats();
+}
+
+void HttpService::update(const ds::UpdateParams&) {
+	std::vector<std::pair<RequestId, Reply>>	done;
+	mWorker->takeDone(done);
+	for(auto& it : done) {
+		auto						found = mCallbacks.find(it.first);
+		if(found == mCallbacks.end()) continue;
+		// Erased first, the callback is allowed to make another request
+		Callback					cb(found->second);
+		mCallbacks.erase(found);
+		cb(it.second);
+	}
+}
+
+/**
+ * \class ds::net::HttpService::Request
+ */
+HttpService::Request::Request()
+	: mVerifyPeers(true)
+	, mVerifyHosts(true)
+	, mFollowRedirects(false)
+	, mUseCache(true)
+	, mTimeout(0)
+	, mVerbose(false)
+{}
+
+HttpService::Request::Request(const std::string& url)
+	: mUrl(url)
+	, mVerifyPeers(true)
+	, mVerifyHosts(true)
+	, mFollowRedirects(false)
+	, mUseCache(true)
+	, mTimeout(0)
+	, mVerbose(false)
+{}
+
+/**
+ * \class ds::net::HttpService::Reply
+ */
+HttpService::Reply::Reply()
+	: mErrored(false)
+	, mHttpCode(0)
+	, mFromCache(false)
+{}
+
+/**
+ * \class ds::net::HttpService::Stats
+ */
+HttpService::Stats::Stats()
+	: mTransfers(0)
+	, mConnections(0)
+	, mCacheHits(0)
+{}
+
+} // namespace net
+} // namespace ds
@@ -0,0 +1,115 @@
+#pragma once
+#ifndef ESSENTIALS_DS_NETWORK_HTTP_SERVICE
+#define ESSENTIALS_DS_NETWORK_HTTP_SERVICE
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <ds/app/auto_update.h>
+#include <ds/app/engine/engine_service.h>
+
+namespace ds {
+namespace net {
+
+/**
+* \class ds::net::HttpService
+* \brief Makes http and https requests with curl's multi interface, all on one worker thread.
+*
+* Connections stay open and are reused for the next request to the same host, and https
+* requests to a host share one HTTP/2 connection when the server supports it. Only so many
+* transfers run at once, the rest wait their turn. GET replies that have an ETag or a
+* Last-Modified are kept on disk, and the next request for the url with the same headers is
+* conditional, so one that hasn't changed comes back as a 304 and is answered from the disk.
+* Replies or requests with Cache-Control no-store, and private replies, are never kept.
+*
+* Replies are handed to the callbacks on the main thread. There's one per engine, see get().
+* It also fetches http and https images for the LoadImageService.
+*
+* Settings are in the "HTTP SETTINGS" section of engine.xml.
+*/
+class HttpService : public ds::EngineService,
+					public ds::AutoUpdate {
+public:
+	typedef int								RequestId;
+
+	struct Request {
+		Request();
+		explicit Request(const std::string& url);
+
+		std::string							mUrl;
+		/// Empty for a GET, or a POST if there's a body. Anything else is a custom request, like DELETE
+		std::string							mMethod;
+		std::string							mBody;
+		/// Whole header lines, like "Content-Type: application/json"
+		std::vector<std::string>			mHeaders;
+		/// If false, connect even if the certificate is self-signed (Much less secure)
+		bool								mVerifyPeers;
+		/// If false, connect even if the certificate doesn't match the domain (Much less secure)
+		bool								mVerifyHosts;
+		bool								mFollowRedirects;
+		/// GETs only. Keep the reply on disk and ask for it conditionally next time.
+		bool								mUseCache;
+		/// Write the body to this file instead of the reply
+		std::string							mDownloadFile;
+		/// Seconds for the whole transfer, 0 for no limit
+		long								mTimeout;
+		bool								mVerbose;
+	};
+
+	struct Reply {
+		Reply();
+
+		/// Nothing came back, mError says why. Error codes from the server are not errors.
+		bool								mErrored;
+		std::string							mError;
+		long								mHttpCode;
+		std::string							mBody;
+		/// The server said the copy on disk is current, so that's the body, and mHttpCode is 200
+		bool								mFromCache;
+	};
+
+	struct Stats {
+		Stats();
+
+		unsigned							mTransfers;
+		/// Connections that had to be opened, the rest of the transfers reused one
+		unsigned							mConnections;
+		unsigned							mCacheHits;
+	};
+
+	typedef std::function<void(const Reply&)>	Callback;
+
+	/// The engine's service
+	static HttpService&						get(ds::ui::SpriteEngine&);
+
+	HttpService(ds::ui::SpriteEngine&);
+	~HttpService();
+
+	virtual void							stop();
+
+	/// The callback is called on the main thread once it's done. Answers 0 if it couldn't start.
+	RequestId								request(const Request&, const Callback&);
+	/// The callback won't be called, and the transfer is stopped if it's still going
+	void									cancel(const RequestId);
+	/// Waits until it's done. Only for worker threads, it would hold up the main thread.
+	bool									requestAndWait(const Request&, Reply&);
+
+	Stats									getStats() const;
+
+protected:
+	virtual void							update(const ds::UpdateParams&);
+
+private:
+	class Worker;
+
+	// Shared with the LoadImageService url loader, which can outlive this
+	std::shared_ptr<Worker>					mWorker;
+	std::unordered_map<RequestId, Callback>	mCallbacks;
+};
+
+} // namespace net
+} // namespace ds
+
+#endif
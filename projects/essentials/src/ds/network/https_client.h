@@ -6,20 +6,22 @@
 #include <functional>
 #include <vector>
 #include <ds/ui/sprite/sprite_engine.h>
-#include <ds/thread/parallel_runnable.h>
-#include <Poco/Runnable.h>
+#include "ds/network/http_service.h"
 
 namespace ds {
 namespace net {
 /**
 * \class ds::net::HttpsRequest
-* Make very simple https requests
+* Make very simple https requests. They go through the engine's HttpService, so
+* connections are reused and replies are delivered on the main thread.
 */
 
 class HttpsRequest {
 
 public:
 	HttpsRequest(ds::ui::SpriteEngine& eng);
+	/// Anything still waiting on a reply is canceled
+	~HttpsRequest();
 
 	/// The url is the full request url
 	/// verifyPeers if false will use try to connect even if the certificate is self-signed (Much less secure)
@@ -40,34 +42,12 @@ public:
 	void					setVerboseOutput(const bool verbose);
 
 private:
-	class IndividualRequest : public Poco::Runnable {
-	public:
-		IndividualRequest();
+	void									start(const HttpService::Request&);
+	void									onRequestComplete(const HttpService::RequestId, const HttpService::Reply&);
 
-		void				setInput(std::string url);
-
-		virtual void		run();
-
-		bool				mError;
-		std::string			mErrorMessage;
-		std::string			mOutput;
-		std::FILE*			mFp;
-		long				mHttpStatus;
-		std::string			mInput;
-		bool				mVerifyPeers;
-		bool				mVerifyHost;
-		bool				mIsGet;
-		std::string			mPostData;
-		std::string			mCustomRequest;
-		std::vector<std::string>	mHeaders;
-		bool				mVerboseOutput;
-		bool				mIsDownloadMedia;
-		std::string			mDownloadFile;
-	};
-
-	void									onRequestComplete(IndividualRequest&);
+	HttpService&							mService;
 	bool									mVerbose;
-	ds::ParallelRunnable<IndividualRequest>	mRequests;
+	std::vector<HttpService::RequestId>		mPending;
 	std::function<void(const bool errored, const std::string&, const long)>	mReplyFunction;
 };
 } // namespace net
@@ -311,10 +311,10 @@ bool LineSprite::contains(const ci::vec3& point, const float pad) const {
 	// May have negative scaling
 	if (mScale.x == 0.0f || mScale.y == 0.0f) return false;
 
-	buildGlobalTransform();
+	const ci::mat4 inverseGlobal = getInverseGlobalTransform();
 
 	for (int i = 0; i < mPoints.size() - 1; ++i) {
-		auto testPt = mInverseGlobalTransform * ci::vec4(point, 1.0f);
+		auto testPt = inverseGlobal * ci::vec4(point, 1.0f);
 		auto bounds = ci::Rectf(mPoints[i], mPoints[i + 1]);
 		bounds.canonicalize();
 		bounds.inflate(ci::vec2(mLineWidth));
@@ -332,8 +332,9 @@ bool LineSprite::getInnerHit(const ci::vec3& pos) const {
 		return std::abs((P.x - A.x) * (B.y - A.y) - (P.y - A.y) * (B.x - A.x)) / normalLength;
 	};
 
+	const ci::mat4 inverseGlobal = getInverseGlobalTransform();
 	for (int i = 0; i < mPoints.size() - 1; ++i) {
-		auto testPt = mInverseGlobalTransform * ci::vec4(pos, 1.0f);
+		auto testPt = inverseGlobal * ci::vec4(pos, 1.0f);
 		auto bounds = ci::Rectf(mPoints[i], mPoints[i + 1]);
 		bounds.canonicalize();
 		bounds.inflate(ci::vec2(mLineWidth));
@@ -0,0 +1,246 @@
+#include "stdafx.h"
+
+#include "png_sequence_pack.h"
+
+#include <cstring>
+#include <cinder/ImageIo.h>
+#include <ds/debug/logger.h>
+#include "snappy.h"
+
+namespace ds {
+namespace ui {
+
+namespace {
+// Header: magic, then version, frame count, width, height, channels and compression as
+// uint32s, then an offset and size uint64 per frame, then the frames. Little endian.
+const char			PACK_MAGIC[4] = { 'D', 'S', 'P', 'K' };
+const uint32_t		PACK_VERSION = 1;
+const size_t		HEADER_SIZE = sizeof(PACK_MAGIC) + 6 * sizeof(uint32_t);
+const size_t		ENTRY_SIZE = 2 * sizeof(uint64_t);
+
+template <typename T>
+void write_value(std::ofstream& out, const T v){
+	out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+template <typename T>
+T read_value(std::ifstream& in){
+	T				v = T();
+	in.read(reinterpret_cast<char*>(&v), sizeof(T));
+	return v;
+}
+
+ci::SurfaceChannelOrder channel_order(const bool alpha){
+	return alpha ? ci::SurfaceChannelOrder::RGBA : ci::SurfaceChannelOrder::RGB;
+}
+
+// Tightly packed rows, whatever the surface's row padding
+void copy_rows_out(const ci::Surface8u& s, const int channels, std::string& out){
+	const size_t	rowSize = static_cast<size_t>(s.getWidth() * channels);
+	out.resize(rowSize * s.getHeight());
+	for(int y = 0; y < s.getHeight(); ++y){
+		memcpy(&out[y * rowSize], s.getData() + y * s.getRowBytes(), rowSize);
+	}
+}
+
+void copy_rows_in(const char* src, const int channels, ci::Surface8u& s){
+	const size_t	rowSize = static_cast<size_t>(s.getWidth() * channels);
+	for(int y = 0; y < s.getHeight(); ++y){
+		memcpy(s.getData() + y * s.getRowBytes(), src + y * rowSize, rowSize);
+	}
+}
+}
+
+/**
+* \class ds::ui::PngSequencePack
+*/
+bool PngSequencePack::write(const std::vector<std::string>& imageFiles, const std::string& packPath, const Compression compression){
+	if(imageFiles.empty()) return false;
+
+	std::ofstream					out(packPath.c_str(), std::ios::binary | std::ios::trunc);
+	if(!out.is_open()){
+		DS_LOG_WARNING("PngSequencePack couldn't write to " << packPath);
+		return false;
+	}
+
+	std::vector<Entry>				entries(imageFiles.size());
+	uint64_t						offset = HEADER_SIZE + ENTRY_SIZE * entries.size();
+	int								width = 0, height = 0;
+	bool							alpha = false;
+	ci::Surface8u					frame;
+	std::string						raw, compressed;
+
+	// The index is filled in once the frame sizes are known
+	out.seekp(static_cast<std::streamoff>(offset));
+
+	for(size_t i = 0; i < imageFiles.size(); ++i){
+		try {
+			ci::Surface8u			src(ci::loadImage(imageFiles[i]));
+			if(i == 0){
+				width = src.getWidth();
+				height = src.getHeight();
+				alpha = src.hasAlpha();
+				frame = ci::Surface8u(width, height, alpha, channel_order(alpha));
+			} else if(src.getWidth() != width || src.getHeight() != height){
+				DS_LOG_WARNING("PngSequencePack frame " << imageFiles[i] << " isn't the size of the first frame");
+				return false;
+			}
+			frame.copyFrom(src, src.getBounds());
+		} catch(std::exception& e){
+			DS_LOG_WARNING("PngSequencePack couldn't load " << imageFiles[i] << ": " << e.what());
+			return false;
+		}
+
+		copy_rows_out(frame, alpha ? 4 : 3, raw);
+		const std::string*			data = &raw;
+		if(compression == COMPRESS_SNAPPY){
+			snappy::Compress(raw.data(), raw.size(), &compressed);
+			data = &compressed;
+		}
+
+		out.write(data->data(), data->size());
+		entries[i].mOffset = offset;
+		entries[i].mSize = data->size();
+		offset += data->size();
+	}
+
+	out.seekp(0);
+	out.write(PACK_MAGIC, sizeof(PACK_MAGIC));
+	write_value<uint32_t>(out, PACK_VERSION);
+	write_value<uint32_t>(out, static_cast<uint32_t>(entries.size()));
+	write_value<uint32_t>(out, static_cast<uint32_t>(width));
+	write_value<uint32_t>(out, static_cast<uint32_t>(height));
+	write_value<uint32_t>(out, alpha ? 4 : 3);
+	write_value<uint32_t>(out, static_cast<uint32_t>(compression));
+	for(auto& it : entries){
+		write_value<uint64_t>(out, it.mOffset);
+		write_value<uint64_t>(out, it.mSize);
+	}
+
+	if(!out.good()){
+		DS_LOG_WARNING("PngSequencePack error writing " << packPath);
+		return false;
+	}
+	return true;
+}
+
+bool PngSequencePack::isPack(const std::string& path){
+	std::ifstream					in(path.c_str(), std::ios::binary);
+	char							magic[sizeof(PACK_MAGIC)];
+	if(!in.read(magic, sizeof(magic))) return false;
+	return memcmp(magic, PACK_MAGIC, sizeof(magic)) == 0;
+}
+
+PngSequencePack::PngSequencePack()
+	: mWidth(0)
+	, mHeight(0)
+	, mChannels(0)
+	, mCompression(COMPRESS_NONE)
+{}
+
+bool PngSequencePack::open(const std::string& path){
+	close();
+
+	std::lock_guard<std::mutex>		lock(mMutex);
+	mFile.open(path.c_str(), std::ios::binary);
+	char							magic[sizeof(PACK_MAGIC)];
+	if(!mFile.read(magic, sizeof(magic)) || memcmp(magic, PACK_MAGIC, sizeof(magic)) != 0 || read_value<uint32_t>(mFile) != PACK_VERSION){
+		DS_LOG_WARNING("PngSequencePack " << path << " isn't a sequence pack");
+		mFile.close();
+		return false;
+	}
+
+	const uint32_t					count = read_value<uint32_t>(mFile);
+	mWidth = static_cast<int>(read_value<uint32_t>(mFile));
+	mHeight = static_cast<int>(read_value<uint32_t>(mFile));
+	mChannels = static_cast<int>(read_value<uint32_t>(mFile));
+	mCompression = static_cast<Compression>(read_value<uint32_t>(mFile));
+	mEntries.resize(count);
+	for(auto& it : mEntries){
+		it.mOffset = read_value<uint64_t>(mFile);
+		it.mSize = read_value<uint64_t>(mFile);
+	}
+
+	if(!mFile.good() || (mChannels != 3 && mChannels != 4) || mWidth < 1 || mHeight < 1){
+		DS_LOG_WARNING("PngSequencePack " << path << " is damaged");
+		mFile.close();
+		mEntries.clear();
+		return false;
+	}
+	return true;
+}
+
+void PngSequencePack::close(){
+	std::lock_guard<std::mutex>		lock(mMutex);
+	if(mFile.is_open()) mFile.close();
+	mEntries.clear();
+	mWidth = mHeight = mChannels = 0;
+}
+
+bool PngSequencePack::isOpen() const {
+	std::lock_guard<std::mutex>		lock(mMutex);
+	return mFile.is_open();
+}
+
+int PngSequencePack::getNumFrames() const {
+	std::lock_guard<std::mutex>		lock(mMutex);
+	return static_cast<int>(mEntries.size());
+}
+
+int PngSequencePack::getWidth() const {
+	std::lock_guard<std::mutex>		lock(mMutex);
+	return mWidth;
+}
+
+int PngSequencePack::getHeight() const {
+	std::lock_guard<std::mutex>		lock(mMutex);
+	return mHeight;
+}
+
+bool PngSequencePack::hasAlpha() const {
+	std::lock_guard<std::mutex>		lock(mMutex);
+	return mChannels == 4;
+}
+
+bool PngSequencePack::readFrame(const int frameIndex, ci::Surface8u& s, std::string& scratch) const {
+	int								channels = 0;
+	Compression						compression = COMPRESS_NONE;
+	{
+		// Only the read is locked, decompressing can happen on several threads at once
+		std::lock_guard<std::mutex>	lock(mMutex);
+		if(!mFile.is_open() || frameIndex < 0 || frameIndex >= static_cast<int>(mEntries.size()) || mEntries[frameIndex].mSize < 1) return false;
+
+		if(!s.getData() || s.getWidth() != mWidth || s.getHeight() != mHeight || s.hasAlpha() != (mChannels == 4)){
+			s = ci::Surface8u(mWidth, mHeight, mChannels == 4, channel_order(mChannels == 4));
+		}
+
+		const Entry&				entry = mEntries[frameIndex];
+		scratch.resize(static_cast<size_t>(entry.mSize));
+		mFile.clear();
+		mFile.seekg(static_cast<std::streamoff>(entry.mOffset));
+		if(!mFile.read(&scratch[0], scratch.size())) return false;
+		channels = mChannels;
+		compression = mCompression;
+	}
+
+	const size_t					rawSize = static_cast<size_t>(s.getWidth() * channels * s.getHeight());
+	if(compression == COMPRESS_NONE){
+		if(scratch.size() != rawSize) return false;
+		copy_rows_in(scratch.data(), channels, s);
+		return true;
+	}
+
+	size_t							length = 0;
+	if(!snappy::GetUncompressedLength(scratch.data(), scratch.size(), &length) || length != rawSize) return false;
+	if(s.getRowBytes() == static_cast<int32_t>(s.getWidth() * channels)){
+		return snappy::RawUncompress(scratch.data(), scratch.size(), reinterpret_cast<char*>(s.getData()));
+	}
+
+	std::string						rows;
+	if(!snappy::Uncompress(scratch.data(), scratch.size(), &rows)) return false;
+	copy_rows_in(rows.data(), channels, s);
+	return true;
+}
+
+} // namespace ui
+} // namespace ds
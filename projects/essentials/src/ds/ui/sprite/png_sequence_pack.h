@@ -0,0 +1,68 @@
+#pragma once
+#ifndef ESSENTIALS_DS_UI_SPRITE_PNG_SEQUENCE_PACK_H_
+#define ESSENTIALS_DS_UI_SPRITE_PNG_SEQUENCE_PACK_H_
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cinder/Surface.h>
+
+namespace ds {
+namespace ui {
+
+/**
+* \class ds::ui::PngSequencePack
+* \brief All the frames of an image sequence, already decoded, in one file.
+* Frames are stored as plain RGB or RGBA pixels, optionally compressed with snappy, so reading
+* one is a file read and maybe a fast decompress instead of a png decode. Every frame has
+* the size and channels of the first one. Make one with write(), ahead of time.
+*/
+class PngSequencePack {
+public:
+	enum Compression { COMPRESS_NONE = 0, COMPRESS_SNAPPY = 1 };
+
+	/// Decodes each image and writes them all to packPath. Answers false if an image
+	/// couldn't be loaded, didn't match the size of the first, or the file couldn't be written.
+	static bool					write(const std::vector<std::string>& imageFiles, const std::string& packPath, const Compression = COMPRESS_SNAPPY);
+	/// True if the file starts like a pack
+	static bool					isPack(const std::string& path);
+
+	PngSequencePack();
+
+	bool						open(const std::string& path);
+	void						close();
+	bool						isOpen() const;
+
+	int							getNumFrames() const;
+	int							getWidth() const;
+	int							getHeight() const;
+	bool						hasAlpha() const;
+
+	/// Safe from any thread. The surface is made if it isn't the size of the frames.
+	/// The scratch buffer is for compressed bytes, reuse it between calls.
+	bool						readFrame(const int frameIndex, ci::Surface8u&, std::string& scratch) const;
+
+private:
+	PngSequencePack(const PngSequencePack&);
+	PngSequencePack&			operator=(const PngSequencePack&);
+
+	struct Entry {
+		uint64_t				mOffset;
+		uint64_t				mSize;
+	};
+
+	mutable std::mutex			mMutex;
+	mutable std::ifstream		mFile;
+	int							mWidth;
+	int							mHeight;
+	int							mChannels;
+	Compression					mCompression;
+	std::vector<Entry>			mEntries;
+};
+
+} // namespace ui
+} // namespace ds
+
+#endif
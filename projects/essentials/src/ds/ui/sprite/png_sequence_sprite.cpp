@@ -3,25 +3,50 @@
 #include "png_sequence_sprite.h"
 
 #include <cinder/app/App.h>
+#include <cinder/gl/gl.h>
 
+#include <ds/app/app.h>
+#include <ds/app/blob_registry.h>
+#include <ds/app/engine/engine.h>
 #include <ds/debug/logger.h>
 
 namespace ds{
 namespace ui{
 
+// Client/Server Stuff ------------------------------
+namespace {
+class Init {
+public:
+	Init() {
+		ds::App::AddStartup( []( ds::Engine& e ) {
+			e.installSprite(	[]( ds::BlobRegistry& r ){ds::ui::PngSequenceSprite::installAsServer( r ); },
+								[]( ds::BlobRegistry& r ){ds::ui::PngSequenceSprite::installAsClient( r ); } );
+		} );
+	}
+};
+Init				INIT;
+char				BLOB_TYPE				= 0;
+const char			STREAM_SOURCE_ATT		= 80;
+const char			STREAM_FRAME_ATT		= 81;
+const DirtyState&	sStreamSourceDirty		= newUniqueDirtyState();
+const DirtyState&	sStreamFrameDirty		= newUniqueDirtyState();
+}
+
+void PngSequenceSprite::installAsServer(ds::BlobRegistry& registry) {
+	BLOB_TYPE = registry.add([](BlobReader& r) {Sprite::handleBlobFromClient(r); });
+}
+
+void PngSequenceSprite::installAsClient(ds::BlobRegistry& registry) {
+	BLOB_TYPE = registry.add([](BlobReader& r) {Sprite::handleBlobFromServer<PngSequenceSprite>(r); });
+}
+// -- Client/Server Stuff ----------------------------
+
 PngSequenceSprite::PngSequenceSprite(SpriteEngine& engine, const std::vector<std::string>& imageFiles)
-	: ds::ui::Sprite(engine)
-	, mLoopStyle(Loop)
-	, mCurrentFrameIndex(0)
-	, mPlaying(true)
-	, mFrameTime(0.0f)
-	, mNumFrames(0)
+	: PngSequenceSprite(engine)
 {
-	mLayoutFixedAspect = true;
 	setImages(imageFiles);
 
-	mFrames[0]->show();
-	mLastFrameTime = ci::app::getElapsedSeconds();
+	if(!mFrames.empty()) mFrames[0]->show();
 }
 
 PngSequenceSprite::PngSequenceSprite(SpriteEngine& engine)
@@ -31,12 +56,24 @@ PngSequenceSprite::PngSequenceSprite(SpriteEngine& engine)
 	, mPlaying(true)
 	, mFrameTime(0.0f)
 	, mNumFrames(0)
+	, mStreaming(false)
+	, mFrameDropStyle(HoldFrame)
+	, mStreamTexture(-1)
+	, mUploadedFrame(-1)
+	, mDroppedFrames(0)
+	, mSizeToFirstFrame(false)
 {
+	mBlobType = BLOB_TYPE;
 	mLayoutFixedAspect = true;
 	mLastFrameTime = ci::app::getElapsedSeconds();
 }
 
 void PngSequenceSprite::setImages(const std::vector<std::string>& imageFiles){
+	if(mStreaming){
+		clearStreaming();
+		mCurrentFrameIndex = 0;
+	}
+
 	int i=0;
 	for(auto it = imageFiles.begin(); it < imageFiles.end(); ++it){
 		bool created_new_frames = false;
@@ -67,6 +104,94 @@ void PngSequenceSprite::setImages(const std::vector<std::string>& imageFiles){
 	}
 }
 
+void PngSequenceSprite::setImagesStreaming(const std::vector<std::string>& imageFiles){
+	mStreamFiles = imageFiles;
+	mStreamPack.clear();
+	startStreaming();
+}
+
+bool PngSequenceSprite::setPack(const std::string& packPath){
+	mStreamFiles.clear();
+	mStreamPack = packPath;
+	startStreaming();
+	return mNumFrames > 0;
+}
+
+const bool PngSequenceSprite::isStreaming() const {
+	return mStreaming;
+}
+
+void PngSequenceSprite::clearImages(){
+	for(auto it : mFrames){
+		it->release();
+	}
+	mFrames.clear();
+}
+
+void PngSequenceSprite::startStreaming(){
+	clearImages();
+
+	mStreaming = true;
+	if(!mStreamPack.empty()){
+		mStream.setPack(mStreamPack);
+	} else {
+		mStream.setImages(mStreamFiles);
+	}
+	mStream.setLoop(mLoopStyle == Loop);
+
+	mNumFrames = mStream.getNumFrames();
+	mCurrentFrameIndex = 0;
+	mUploadedFrame = -1;
+	mDroppedFrames = 0;
+	mLastFrameTime = ci::app::getElapsedSeconds();
+
+	// Drawn by this sprite, instead of by a child per frame
+	setTransparent(false);
+	setUseShaderTexture(true);
+	markAsDirty(sStreamSourceDirty);
+	markAsDirty(sStreamFrameDirty);
+
+	if(mNumFrames == 0){
+		DS_LOG_WARNING("Png Sequence didn't find any frames to stream.");
+		mPlaying = false;
+	}
+}
+
+void PngSequenceSprite::clearStreaming(){
+	mStream.clear();
+	mStreaming = false;
+	mStreamFiles.clear();
+	mStreamPack.clear();
+	mStreamTextures[0].reset();
+	mStreamTextures[1].reset();
+	mStreamTexture = -1;
+	mUploadedFrame = -1;
+
+	setTransparent(true);
+	setUseShaderTexture(false);
+	markAsDirty(sStreamSourceDirty);
+}
+
+void PngSequenceSprite::setStreamBuffer(const int frames, const int threads){
+	mStream.setBuffer(frames, threads);
+}
+
+void PngSequenceSprite::setFrameDropStyle(const FrameDropStyle style){
+	mFrameDropStyle = style;
+}
+
+const PngSequenceSprite::FrameDropStyle PngSequenceSprite::getFrameDropStyle() const {
+	return mFrameDropStyle;
+}
+
+const int PngSequenceSprite::getDroppedFrames() const {
+	return mDroppedFrames;
+}
+
+PngSequenceStream::Stats PngSequenceSprite::getStreamStats() const {
+	return mStream.getStats();
+}
+
 void PngSequenceSprite::setFrameTime(const float time){
 	if(time < 0.0f) return;
 	mFrameTime = time;
@@ -74,6 +199,7 @@ void PngSequenceSprite::setFrameTime(const float time){
 
 void PngSequenceSprite::setLoopStyle(LoopStyle style){
 	mLoopStyle = style;
+	mStream.setLoop(mLoopStyle == Loop);
 }
 
 const PngSequenceSprite::LoopStyle PngSequenceSprite::getLoopStyle()const{
@@ -95,6 +221,14 @@ const bool PngSequenceSprite::isPlaying()const{
 
 void PngSequenceSprite::setCurrentFrameIndex(const int frameIndex){
 	if(frameIndex < 0 || frameIndex > mNumFrames - 1) return;
+
+	if(mStreaming){
+		// A jump, not frames that were dropped
+		mUploadedFrame = -1;
+		setStreamFrame(frameIndex);
+		return;
+	}
+
 	mCurrentFrameIndex = frameIndex;
 
 	for(int i = 0; i < mNumFrames; i++){
@@ -115,12 +249,18 @@ const int PngSequenceSprite::getNumberOfFrames(){
 }
 
 ds::ui::Image* PngSequenceSprite::getFrameAtIndex(const int frameIndex){
-	if(frameIndex < 0 || frameIndex > mNumFrames - 1) return nullptr;
+	if(mStreaming || frameIndex < 0 || frameIndex > mNumFrames - 1) return nullptr;
 	return mFrames[frameIndex];
 }
 
 void PngSequenceSprite::sizeToFirstImage(){
-	if(mFrames.empty()){
+	if(mStreaming){
+		if(mStreamTexture > -1){
+			setSize(static_cast<float>(mStreamTextures[mStreamTexture]->getWidth()), static_cast<float>(mStreamTextures[mStreamTexture]->getHeight()));
+		} else {
+			mSizeToFirstFrame = true;
+		}
+	} else if(mFrames.empty()){
 		setSize(0.0f, 0.0f);
 	} else {
 		setSize(mFrames[0]->getScaleWidth(), mFrames[0]->getScaleHeight());
@@ -135,6 +275,11 @@ void PngSequenceSprite::onUpdateServer(const ds::UpdateParams& p){
 		mFrames.pop_back();
 	}
 
+	if(mStreaming){
+		updateStreaming();
+		return;
+	}
+
 	if(mPlaying 
 	   && mNumFrames > 0
 	   && !mFrames.empty() 
@@ -153,8 +298,6 @@ void PngSequenceSprite::onUpdateServer(const ds::UpdateParams& p){
 			}
 		}
 
-		bool doAdvance = advanceFrame && !mFrames.empty() && mCurrentFrameIndex > -1 && mCurrentFrameIndex < mFrames.size();
-		std::cout << doAdvance << " " << advanceFrame<< " "  << !mFrames.empty() << " " << mCurrentFrameIndex << " " << mFrames.size() << std::endl;
 		if(advanceFrame 
 		   && !mFrames.empty() 
 		   && mCurrentFrameIndex > -1 
@@ -182,5 +325,135 @@ void PngSequenceSprite::onUpdateServer(const ds::UpdateParams& p){
 
 	}
 }
+
+void PngSequenceSprite::updateStreaming(){
+	if(!mPlaying || mNumFrames < 1) return;
+
+	const double thisTime = ci::app::getElapsedSeconds();
+	int advance = 1;
+	if(mFrameTime > 0.0f){
+		const double deltaTime = thisTime - mLastFrameTime;
+		if(deltaTime <= (double)mFrameTime) return;
+		// Keep time by skipping ahead as many frames as are due
+		if(mFrameDropStyle == DropFrames) advance = static_cast<int>(deltaTime / (double)mFrameTime);
+	}
+
+	int nextFrame = mCurrentFrameIndex + advance;
+	bool reachedEnd = false;
+	if(nextFrame > mNumFrames - 1){
+		if(mLoopStyle == Loop){
+			nextFrame %= mNumFrames;
+		} else {
+			nextFrame = mNumFrames - 1;
+			reachedEnd = true;
+		}
+	}
+
+	// Try again next update, without losing the time that's gone by
+	if(mFrameDropStyle == HoldFrame && (!mStream.isReady(mCurrentFrameIndex) || !mStream.isReady(nextFrame))) return;
+
+	if(mFrameTime > 0.0f && mFrameDropStyle == DropFrames){
+		mLastFrameTime += advance * (double)mFrameTime;
+		if(thisTime - mLastFrameTime > (double)mFrameTime) mLastFrameTime = thisTime;
+	} else {
+		mLastFrameTime = thisTime;
+	}
+
+	setStreamFrame(nextFrame);
+	if(reachedEnd) pause();
+}
+
+void PngSequenceSprite::setStreamFrame(const int frameIndex){
+	mCurrentFrameIndex = frameIndex;
+	mStream.setPlayhead(frameIndex);
+	markAsDirty(sStreamFrameDirty);
+}
+
+void PngSequenceSprite::uploadStreamFrame(){
+	if(mUploadedFrame == mCurrentFrameIndex) return;
+
+	// Not decoded yet, keep showing the last one
+	const ci::Surface8u* frame = mStream.getFrame(mCurrentFrameIndex);
+	if(!frame) return;
+
+	if(mUploadedFrame > -1){
+		const int step = (mCurrentFrameIndex - mUploadedFrame + mNumFrames) % mNumFrames;
+		if(step > 1) mDroppedFrames += step - 1;
+	}
+
+	const int next = (mStreamTexture + 1) % 2;
+	ci::gl::Texture2dRef& tex = mStreamTextures[next];
+	if(!tex || tex->getWidth() != frame->getWidth() || tex->getHeight() != frame->getHeight()){
+		tex = ci::gl::Texture2d::create(*frame);
+	} else {
+		tex->update(*frame);
+	}
+	mStreamTexture = next;
+	mUploadedFrame = mCurrentFrameIndex;
+
+	if(mSizeToFirstFrame || (getWidth() < 1.0f && getHeight() < 1.0f)){
+		mSizeToFirstFrame = false;
+		setSize(static_cast<float>(frame->getWidth()), static_cast<float>(frame->getHeight()));
+	}
+}
+
+void PngSequenceSprite::drawLocalClient(){
+	if(!mStreaming){
+		ds::ui::Sprite::drawLocalClient();
+		return;
+	}
+
+	uploadStreamFrame();
+	if(mStreamTexture < 0) return;
+
+	const ci::gl::Texture2dRef& tex = mStreamTextures[mStreamTexture];
+	tex->bind();
+	ci::gl::drawSolidRect(ci::Rectf(0.0f, 0.0f, getWidth(), getHeight()));
+	tex->unbind();
+}
+
+void PngSequenceSprite::writeAttributesTo(ds::DataBuffer& buf){
+	ds::ui::Sprite::writeAttributesTo(buf);
+
+	if(mDirty.has(sStreamSourceDirty)){
+		buf.add(STREAM_SOURCE_ATT);
+		buf.add<char>(mStreaming ? 1 : 0);
+		buf.add(mStreamPack);
+		buf.add<int32_t>(static_cast<int32_t>(mStreamFiles.size()));
+		for(auto& it : mStreamFiles){
+			buf.add(it);
+		}
+	}
+	if(mDirty.has(sStreamFrameDirty)){
+		buf.add(STREAM_FRAME_ATT);
+		buf.add<int32_t>(mCurrentFrameIndex);
+	}
+}
+
+void PngSequenceSprite::readAttributeFrom(const char attributeId, ds::DataBuffer& buf){
+	if(attributeId == STREAM_SOURCE_ATT){
+		const bool streaming = buf.read<char>() != 0;
+		const std::string pack = buf.read<std::string>();
+		const int32_t count = buf.read<int32_t>();
+		std::vector<std::string> files;
+		for(int32_t i = 0; i < count; ++i){
+			files.push_back(buf.read<std::string>());
+		}
+
+		if(!streaming){
+			if(mStreaming) clearStreaming();
+		} else if(!pack.empty()){
+			setPack(pack);
+		} else {
+			setImagesStreaming(files);
+		}
+	} else if(attributeId == STREAM_FRAME_ATT){
+		const int frameIndex = buf.read<int32_t>();
+		// The server already decided whether it's a drop or a jump
+		if(mStreaming && frameIndex > -1 && frameIndex < mNumFrames) setStreamFrame(frameIndex);
+	} else {
+		ds::ui::Sprite::readAttributeFrom(attributeId, buf);
+	}
+}
 } // namespace ui
 } // namespace ds
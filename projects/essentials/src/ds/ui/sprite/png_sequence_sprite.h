@@ -5,12 +5,17 @@
 #include <ds/ui/sprite/image.h>
 #include <ds/ui/sprite/sprite.h>
 #include <ds/ui/sprite/sprite_engine.h>
+#include "png_sequence_stream.h"
 
 namespace ds {
 namespace ui {
 
 /**
 * \class ds::ui::PngSequenceSprite
+* setImages() makes an Image for every frame, and they're all loaded at once, which is
+* fine for short sequences. Long or large ones should stream instead, see setImagesStreaming()
+* and setPack(): only a few frames are decoded at a time, just ahead of the one showing,
+* and they're drawn from a couple of reused textures.
 */
 class PngSequenceSprite : public ds::ui::Sprite {
 public:
@@ -18,6 +23,11 @@ public:
 	// what to do when you get to the end
 typedef enum { Loop = 0, Once} LoopStyle;
 
+	// Streaming only, what to do when the next frame isn't decoded in time
+	// HoldFrame = keep showing the current frame until it is, playback slows down
+	// DropFrames = keep time, and skip the frames that weren't ready
+typedef enum { HoldFrame = 0, DropFrames } FrameDropStyle;
+
 // Create a png sequence using the image files speficied in the vector. 
 // The string should be loadable by a normal ds::ui::Image
 // Default behavior: playing, one image per server frame, looping
@@ -26,6 +36,23 @@ PngSequenceSprite(SpriteEngine& engine, const std::vector<std::string>& imageFil
 
 	void						setImages(const std::vector<std::string>& imageFiles);
 
+	// Streams the frames from the image files instead of loading them all up front
+	void						setImagesStreaming(const std::vector<std::string>& imageFiles);
+	// Streams the frames from a pack made with PngSequencePack::write(), the fastest to read.
+	// Returns false if it couldn't be opened.
+	bool						setPack(const std::string& packPath);
+	const bool					isStreaming() const;
+
+	// Streaming only. How many frames are decoded ahead (this many frames are held in memory)
+	// and how many threads decode them. Default = 8 frames, 2 threads.
+	void						setStreamBuffer(const int frames, const int threads);
+	// Default = HoldFrame
+	void						setFrameDropStyle(const FrameDropStyle style);
+	const FrameDropStyle		getFrameDropStyle() const;
+	// Frames that were skipped because they weren't decoded in time
+	const int					getDroppedFrames() const;
+	PngSequenceStream::Stats	getStreamStats() const;
+
 	// The number of seconds to wait for the next frame.
 	// Default = 0.0, which will play each png frame on every server frame
 	void						setFrameTime(const float time); 
@@ -51,17 +78,35 @@ PngSequenceSprite(SpriteEngine& engine, const std::vector<std::string>& imageFil
 	const int					getNumberOfFrames();
 
 	// Returns the image sprite at the index supplied.
-	// If the index is invalid, returns nullptr
+	// If the index is invalid or it's streaming, returns nullptr
 	// Don't release this frame, it'll cause trubs
 	ds::ui::Image*				getFrameAtIndex(const int frameIndex);
 
 	// Makes the size of this sprite the same size as the first image
 	// If there are no images, the size will be 0,0
+	// When streaming image files, that happens once the first frame is decoded
 	void						sizeToFirstImage();
 
+	static void					installAsServer(ds::BlobRegistry&);
+	static void					installAsClient(ds::BlobRegistry&);
+
+protected:
+	virtual void				drawLocalClient() override;
+	virtual void				writeAttributesTo(ds::DataBuffer&) override;
+	virtual void				readAttributeFrom(const char attributeId, ds::DataBuffer&) override;
+
 private:
 	virtual void				onUpdateServer(const ds::UpdateParams& p) override;
 
+	// Release the Image for each frame
+	void						clearImages();
+	void						startStreaming();
+	void						clearStreaming();
+	void						updateStreaming();
+	// Upload the current frame if it's decoded and not showing yet
+	void						uploadStreamFrame();
+	void						setStreamFrame(const int frameIndex);
+
 	LoopStyle					mLoopStyle;
 	int							mCurrentFrameIndex;
 	int							mNumFrames;
@@ -70,6 +115,20 @@ private:
 	double						mLastFrameTime;
 	std::vector<ds::ui::Image*>	mFrames;
 
+	// Streaming
+	bool						mStreaming;
+	std::vector<std::string>	mStreamFiles;
+	std::string					mStreamPack;
+	PngSequenceStream			mStream;
+	FrameDropStyle				mFrameDropStyle;
+	// Uploaded to in turn, so the one being drawn isn't written to
+	ci::gl::Texture2dRef		mStreamTextures[2];
+	// The one to draw, or -1 if nothing's been uploaded
+	int							mStreamTexture;
+	int							mUploadedFrame;
+	int							mDroppedFrames;
+	bool						mSizeToFirstFrame;
+
 };
 
 } // namespace ui
@@ -0,0 +1,233 @@
+#include "stdafx.h"
+
+#include "png_sequence_stream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cinder/ImageIo.h>
+#include <ds/debug/logger.h>
+
+namespace ds {
+namespace ui {
+
+namespace {
+const int			DEFAULT_BUFFER_FRAMES = 8;
+const int			DEFAULT_THREADS = 2;
+
+size_t surface_bytes(const ci::Surface8u& s){
+	if(!s.getData()) return 0;
+	return static_cast<size_t>(s.getRowBytes()) * s.getHeight();
+}
+}
+
+/**
+* \class ds::ui::PngSequenceStream
+*/
+PngSequenceStream::PngSequenceStream()
+	: mStopping(false)
+	, mUsePack(false)
+	, mNumFrames(0)
+	, mLoop(true)
+	, mNumThreads(DEFAULT_THREADS)
+	, mSlots(DEFAULT_BUFFER_FRAMES)
+	, mPlayhead(0)
+{}
+
+PngSequenceStream::~PngSequenceStream(){
+	stop();
+}
+
+void PngSequenceStream::setImages(const std::vector<std::string>& imageFiles){
+	clear();
+
+	mFiles = imageFiles;
+	mNumFrames = static_cast<int>(mFiles.size());
+	start();
+}
+
+bool PngSequenceStream::setPack(const std::string& packPath){
+	clear();
+
+	if(!mPack.open(packPath)) return false;
+	mUsePack = true;
+	mNumFrames = mPack.getNumFrames();
+	start();
+	return true;
+}
+
+void PngSequenceStream::clear(){
+	stop();
+
+	mFiles.clear();
+	mPack.close();
+	mUsePack = false;
+	mNumFrames = 0;
+	mPlayhead = 0;
+	// Let go of the decoded frames too
+	mSlots.assign(mSlots.size(), Slot());
+}
+
+void PngSequenceStream::setBuffer(const int frames, const int threads){
+	stop();
+
+	mSlots.assign(static_cast<size_t>(std::max(2, frames)), Slot());
+	mNumThreads = std::max(1, threads);
+	start();
+}
+
+void PngSequenceStream::setLoop(const bool loop){
+	std::lock_guard<std::mutex>		lock(mMutex);
+	mLoop = loop;
+	mWake.notify_all();
+}
+
+int PngSequenceStream::getNumFrames() const {
+	return mNumFrames;
+}
+
+void PngSequenceStream::setPlayhead(const int frameIndex){
+	std::lock_guard<std::mutex>		lock(mMutex);
+	const int64_t					position = positionOf(frameIndex);
+	if(position < 0 || position == mPlayhead) return;
+
+	mPlayhead = position;
+	mWake.notify_all();
+}
+
+bool PngSequenceStream::isReady(const int frameIndex) const {
+	std::lock_guard<std::mutex>		lock(mMutex);
+	return findReady(frameIndex) != nullptr;
+}
+
+const ci::Surface8u* PngSequenceStream::getFrame(const int frameIndex) const {
+	std::lock_guard<std::mutex>		lock(mMutex);
+	const Slot*						slot = findReady(frameIndex);
+	if(!slot || slot->mFailed) return nullptr;
+	return &slot->mSurface;
+}
+
+PngSequenceStream::Stats PngSequenceStream::getStats() const {
+	std::lock_guard<std::mutex>		lock(mMutex);
+	Stats							s = mStats;
+	s.mResidentBytes = 0;
+	for(auto& it : mSlots){
+		s.mResidentBytes += it.mBytes;
+	}
+	return s;
+}
+
+void PngSequenceStream::start(){
+	if(mNumFrames < 1 || !mThreads.empty()) return;
+
+	mStopping = false;
+	for(int i = 0; i < mNumThreads; ++i){
+		mThreads.push_back(std::thread(&PngSequenceStream::run, this));
+	}
+}
+
+void PngSequenceStream::stop(){
+	{
+		std::lock_guard<std::mutex>	lock(mMutex);
+		mStopping = true;
+		mWake.notify_all();
+	}
+
+	for(auto& it : mThreads){
+		if(it.joinable()) it.join();
+	}
+	mThreads.clear();
+}
+
+void PngSequenceStream::run(){
+	std::string						scratch;
+	std::unique_lock<std::mutex>	lock(mMutex);
+	while(!mStopping){
+		int64_t						position = 0;
+		if(!claimNext(position)){
+			mWake.wait(lock);
+			continue;
+		}
+
+		// The slot is this thread's until it's marked ready
+		Slot&						slot = mSlots[static_cast<size_t>(position % mSlots.size())];
+		const int					frameIndex = static_cast<int>(position % mNumFrames);
+		lock.unlock();
+
+		const auto					startTime = std::chrono::steady_clock::now();
+		const bool					decoded = decode(frameIndex, slot.mSurface, scratch);
+		const double				seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+		lock.lock();
+		slot.mState = SLOT_READY;
+		slot.mFailed = !decoded;
+		slot.mBytes = surface_bytes(slot.mSurface);
+		if(decoded) ++mStats.mDecoded;
+		else ++mStats.mFailed;
+		mStats.mDecodeSeconds += seconds;
+	}
+}
+
+bool PngSequenceStream::decode(const int frameIndex, ci::Surface8u& surface, std::string& scratch){
+	// The source doesn't change while the threads are running
+	if(mUsePack) return mPack.readFrame(frameIndex, surface, scratch);
+
+	try {
+		surface = ci::Surface8u(ci::loadImage(mFiles[frameIndex]));
+		return true;
+	} catch(std::exception& e){
+		DS_LOG_WARNING("PngSequenceStream couldn't load " << mFiles[frameIndex] << ": " << e.what());
+	}
+	return false;
+}
+
+int64_t PngSequenceStream::positionOf(const int frameIndex) const {
+	if(frameIndex < 0 || frameIndex >= mNumFrames) return -1;
+
+	// The first position at or after the playhead that shows this frame
+	const int						current = static_cast<int>(mPlayhead % mNumFrames);
+	return mPlayhead + (frameIndex - current + mNumFrames) % mNumFrames;
+}
+
+int64_t PngSequenceStream::windowEnd() const {
+	const int64_t					end = mPlayhead + static_cast<int64_t>(mSlots.size());
+	if(mLoop || mNumFrames < 1) return end;
+	// Stop at the last frame
+	return std::min(end, mPlayhead - mPlayhead % mNumFrames + mNumFrames);
+}
+
+bool PngSequenceStream::claimNext(int64_t& position){
+	if(mNumFrames < 1) return false;
+
+	const int64_t					end = windowEnd();
+	for(int64_t p = mPlayhead; p < end; ++p){
+		Slot&						slot = mSlots[static_cast<size_t>(p % mSlots.size())];
+		if(slot.mPosition == p && slot.mState != SLOT_EMPTY) continue;
+		// Still busy with a frame the playhead has passed
+		if(slot.mState == SLOT_DECODING) continue;
+
+		slot.mPosition = p;
+		slot.mState = SLOT_DECODING;
+		slot.mFailed = false;
+		// A pack decodes into the frame that's there. Loading a file makes a new one, so the
+		// old one goes first, or there'd be two for a moment.
+		if(!mUsePack){
+			slot.mSurface = ci::Surface8u();
+			slot.mBytes = 0;
+		}
+		position = p;
+		return true;
+	}
+	return false;
+}
+
+const PngSequenceStream::Slot* PngSequenceStream::findReady(const int frameIndex) const {
+	const int64_t					position = positionOf(frameIndex);
+	if(position < 0 || position >= windowEnd()) return nullptr;
+
+	const Slot&						slot = mSlots[static_cast<size_t>(position % mSlots.size())];
+	if(slot.mPosition != position || slot.mState != SLOT_READY) return nullptr;
+	return &slot;
+}
+
+} // namespace ui
+} // namespace ds
@@ -0,0 +1,120 @@
+#pragma once
+#ifndef ESSENTIALS_DS_UI_SPRITE_PNG_SEQUENCE_STREAM_H_
+#define ESSENTIALS_DS_UI_SPRITE_PNG_SEQUENCE_STREAM_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cinder/Surface.h>
+#include "png_sequence_pack.h"
+
+namespace ds {
+namespace ui {
+
+/**
+* \class ds::ui::PngSequenceStream
+* \brief Decodes the frames of an image sequence just ahead of a playhead, on worker threads.
+* Only a fixed number of frames are held at once: the one at the playhead and those right
+* after it. When the playhead moves on, the frames behind it are thrown out and their room
+* goes to the next ones. A frame that's still undecoded when the playhead passes it is
+* skipped, so playback that outruns the decoding drops frames instead of falling behind.
+* Memory is at most buffer frames times the size of one frame: a pack is decoded into the frame
+* it replaces, and an image file's old frame is let go before the new one is loaded. Each thread's
+* decoder needs its own working memory on top of that.
+*
+* Frames come from image files, or from a PngSequencePack, which is much faster to read.
+* Everything but the decoding is on the main thread.
+*/
+class PngSequenceStream {
+public:
+	struct Stats {
+		Stats() : mDecoded(0), mFailed(0), mDecodeSeconds(0.0), mResidentBytes(0) {}
+
+		unsigned				mDecoded;
+		unsigned				mFailed;
+		/// Summed over all the threads, so mDecoded / mDecodeSeconds is frames per second per thread
+		double					mDecodeSeconds;
+		/// Frames being held right now, including the ones being decoded into
+		size_t					mResidentBytes;
+	};
+
+	PngSequenceStream();
+	~PngSequenceStream();
+
+	/// Each is decoded with ci::loadImage(). Resets the playhead to the first frame.
+	void						setImages(const std::vector<std::string>& imageFiles);
+	/// Answers false if it isn't a pack. Resets the playhead to the first frame.
+	bool						setPack(const std::string& packPath);
+	void						clear();
+
+	/// Frames to hold decoded, including the one at the playhead, and threads to decode them.
+	/// Default is 8 frames on 2 threads.
+	void						setBuffer(const int frames, const int threads);
+	/// If the frames after the last one are the first ones. Default is true.
+	void						setLoop(const bool loop);
+
+	int							getNumFrames() const;
+
+	/// The frame being shown. The ones after it are decoded next.
+	void						setPlayhead(const int frameIndex);
+	/// The frame is at or ahead of the playhead and done decoding, even if that failed
+	bool						isReady(const int frameIndex) const;
+	/// The decoded frame, or nullptr if it isn't ready or couldn't be decoded. It stays valid
+	/// until the playhead moves past it.
+	const ci::Surface8u*		getFrame(const int frameIndex) const;
+
+	Stats						getStats() const;
+
+private:
+	PngSequenceStream(const PngSequenceStream&);
+	PngSequenceStream&			operator=(const PngSequenceStream&);
+
+	enum SlotState { SLOT_EMPTY, SLOT_DECODING, SLOT_READY };
+
+	// Frames are tracked by position, which keeps counting up through loops, so a position
+	// always has the same slot, and a stale slot is one whose position is out of the window.
+	struct Slot {
+		Slot() : mPosition(-1), mState(SLOT_EMPTY), mFailed(false), mBytes(0) {}
+
+		int64_t					mPosition;
+		SlotState				mState;
+		bool					mFailed;
+		ci::Surface8u			mSurface;
+		// The surface's size, kept under the lock so a slot can be counted while it's decoding
+		size_t					mBytes;
+	};
+
+	void						start();
+	void						stop();
+	void						run();
+	bool						decode(const int frameIndex, ci::Surface8u&, std::string& scratch);
+	// All of these need mMutex locked
+	int64_t						positionOf(const int frameIndex) const;
+	int64_t						windowEnd() const;
+	bool						claimNext(int64_t& position);
+	const Slot*					findReady(const int frameIndex) const;
+
+	mutable std::mutex			mMutex;
+	std::condition_variable		mWake;
+	std::vector<std::thread>	mThreads;
+	bool						mStopping;
+
+	std::vector<std::string>	mFiles;
+	PngSequencePack				mPack;
+	bool						mUsePack;
+	int							mNumFrames;
+	bool						mLoop;
+	int							mNumThreads;
+
+	std::vector<Slot>			mSlots;
+	int64_t						mPlayhead;
+	Stats						mStats;
+};
+
+} // namespace ui
+} // namespace ds
+
+#endif
@@ -1,5 +1,6 @@
 #include "mqtt_watcher.h"
 
+#include <chrono>
 #include "ds/network/mosquitto/mosquittopp.h"
 
 #include <ds/cfg/settings.h>
@@ -24,9 +25,19 @@ private:
 
 const static ds::BitMask   MQTT_LOG = ds::Logger::newModule("mqtt");
 
-static void _clear_queue(MqttWatcher::MessageQueue& q){
-	if(!q.empty()) MqttWatcher::MessageQueue().swap(q);
-}
+// Most messages the loop publishes before going back to the socket
+const size_t		PUBLISH_BATCH = 256;
+// Messages handed to the listeners in one call
+const size_t		DELIVERY_BATCH = 32;
+// Once this many are waiting for the listeners, the rest wait in the inbound queue
+const size_t		MAX_PENDING = 16384;
+// Once this many are waiting for room in the inbound queue, the oldest are dropped
+const size_t		MAX_INBOUND_OVERFLOW = 16384;
+// Not a topic, MQTT topics can't be empty
+const int			NO_POLICY = -1;
+// Topics whose policy is remembered. Past this it starts over, so topics with ids in them
+// can't grow it forever.
+const size_t		MAX_TOPIC_POLICIES = 4096;
 } //!namespace
 
 
@@ -39,7 +50,9 @@ MqttWatcher::MqttWatcher(
 	int port /*= 1883*/,
 	const std::string& clientId)
 	: ds::AutoUpdate(e)
-	, mLoop(e, host, topic_inbound, topic_outband, refresh_rate, port, clientId)
+	, mTopicOutbound(topic_outband)
+	, mDeliveryBudget(0.002f)
+	, mLoop(e, host, topic_inbound, refresh_rate, port, clientId)
 	, mRetryWaitTime(5.0f)
 	, mStarted(false)
 {
@@ -67,36 +80,187 @@ void MqttWatcher::update(const ds::UpdateParams &){
 		}
 	}
 
-	_clear_queue(mMsgInbound);
+	// Past MAX_PENDING the loop thread holds on to them, and eventually drops the oldest
+	while(mPending.size() < MAX_PENDING){
+		MqttMessage*		msg = mLoop.mInbound.front();
+		if(!msg) break;
+		accept(*msg);
+		mLoop.mInbound.pop();
+	}
 
-	if(!mLoop.mLoopInbound.empty()){
-		std::lock_guard<std::mutex>	_lock(mLoop.mInboundMutex);
-		//double check
-		if(!mLoop.mLoopInbound.empty()){
-			mLoop.mLoopInbound.swap(mMsgInbound);
-		}
+	flushOutbound();
+	deliver();
+}
+
+void MqttWatcher::accept(MqttMessage& msg){
+	++mStats.mReceived;
+
+	const Policy*			policy = findPolicy(msg.topic);
+	if(!policy){
+		mPending.push_back(Pending());
+		mPending.back().mMessage.topic.swap(msg.topic);
+		mPending.back().mMessage.message.swap(msg.message);
+		mPending.back().mLatest = false;
+		return;
 	}
 
-	if(!mMsgOutbound.empty()){
-		std::lock_guard<std::mutex>	_lock(mLoop.mOutboundMutex);
-		while(!mMsgOutbound.empty()){
-			mLoop.mLoopOutbound.push_back(mMsgOutbound.back());
-			mMsgOutbound.pop_back();
+	Latest&					latest = mLatest[msg.topic];
+	if(latest.mHasValue) ++mStats.mCoalesced;
+	latest.mHasValue = true;
+	latest.mMessage.message.swap(msg.message);
+
+	// Rate limited topics get their place when they're due, see deliver()
+	if(policy->mMode == COALESCE_LATEST && !latest.mQueued){
+		latest.mQueued = true;
+		mPending.push_back(Pending());
+		mPending.back().mMessage.topic = msg.topic;
+		mPending.back().mLatest = true;
+	}
+	latest.mMessage.topic.swap(msg.topic);
+}
+
+void MqttWatcher::deliver(){
+	const double			start = now();
+
+	for(auto it = mLatest.begin(); it != mLatest.end();){
+		Latest&				latest = it->second;
+		if(latest.mQueued){
+			++it;
+			continue;
+		}
+		const Policy*		policy = findPolicy(it->first);
+		const bool			waiting = policy && policy->mMode == COALESCE_RATE_LIMITED && start - latest.mLastDelivered < policy->mInterval;
+		if(!latest.mHasValue){
+			// Nothing to deliver and no rate limit to keep, so a topic that went quiet is forgotten
+			if(waiting) ++it;
+			else it = mLatest.erase(it);
+			continue;
+		}
+		if(!waiting){
+			latest.mQueued = true;
+			mPending.push_back(Pending());
+			mPending.back().mMessage.topic = it->first;
+			mPending.back().mLatest = true;
 		}
+		++it;
 	}
 
-	if(!mMsgInbound.empty()){
+	while(!mPending.empty()){
+		mMsgInbound.clear();
+		while(!mPending.empty() && mMsgInbound.size() < DELIVERY_BATCH){
+			Pending&		p = mPending.front();
+			if(p.mLatest){
+				auto		found = mLatest.find(p.mMessage.topic);
+				if(found != mLatest.end() && found->second.mHasValue){
+					mMsgInbound.push_back(MqttMessage());
+					mMsgInbound.back().topic.swap(found->second.mMessage.topic);
+					mMsgInbound.back().message.swap(found->second.mMessage.message);
+					found->second.mHasValue = false;
+					found->second.mQueued = false;
+					found->second.mLastDelivered = start;
+				}
+			} else {
+				mMsgInbound.push_back(MqttMessage());
+				mMsgInbound.back().topic.swap(p.mMessage.topic);
+				mMsgInbound.back().message.swap(p.mMessage.message);
+			}
+			mPending.pop_front();
+		}
+
+		if(mMsgInbound.empty()) continue;
+		mStats.mDelivered += static_cast<unsigned>(mMsgInbound.size());
 		for(const std::function<void(const MessageQueue&)>& cb : mListeners){
 			cb(mMsgInbound);
 		}
+
+		if(mDeliveryBudget > 0.0f && now() - start >= mDeliveryBudget) break;
+	}
+}
+
+const MqttWatcher::Policy* MqttWatcher::findPolicy(const std::string& topic){
+	if(mPolicies.empty()) return nullptr;
+
+	auto					found = mTopicPolicies.find(topic);
+	if(found == mTopicPolicies.end()){
+		int					index = NO_POLICY;
+		for(int i = 0; i < static_cast<int>(mPolicies.size()); ++i){
+			bool			matches = false;
+			if(mosqpp::topic_matches_sub(mPolicies[i].mTopic.c_str(), topic.c_str(), &matches) == MOSQ_ERR_SUCCESS && matches){
+				index = i;
+				break;
+			}
+		}
+		if(mTopicPolicies.size() >= MAX_TOPIC_POLICIES) mTopicPolicies.clear();
+		found = mTopicPolicies.insert(std::make_pair(topic, index)).first;
+	}
+
+	if(found->second == NO_POLICY || mPolicies[found->second].mMode == COALESCE_ALL) return nullptr;
+	return &mPolicies[found->second];
+}
+
+void MqttWatcher::setTopicPolicy(const std::string& topic, const Coalesce mode, const float intervalSeconds){
+	for(auto& it : mPolicies){
+		if(it.mTopic == topic){
+			it.mMode = mode;
+			it.mInterval = intervalSeconds;
+			mTopicPolicies.clear();
+			return;
+		}
+	}
+
+	Policy					p;
+	p.mTopic = topic;
+	p.mMode = mode;
+	p.mInterval = intervalSeconds;
+	mPolicies.push_back(p);
+	mTopicPolicies.clear();
+}
+
+double MqttWatcher::now() const {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+MqttWatcher::Stats MqttWatcher::getStats() const {
+	Stats					s = mStats;
+	s.mDropped = mLoop.mDropped;
+	s.mPublished = mLoop.mPublished;
+	s.mTopics = static_cast<unsigned>(mLatest.size());
+	return s;
+}
+
+void MqttWatcher::sendOutboundMessage(const std::string& str, const int qos, const bool retain){
+	sendOutboundMessage(mTopicOutbound, str, qos, retain);
+}
+
+void MqttWatcher::sendOutboundMessage(const std::string& topic, const std::string& message, const int qos, const bool retain){
+	// Straight into the ring, unless earlier ones are still waiting for room
+	MqttMessage*			slot = mMsgOutbound.empty() ? mLoop.mOutbound.beginPush() : nullptr;
+	const bool				inRing = slot != nullptr;
+	if(!inRing){
+		mMsgOutbound.push_back(MqttMessage());
+		slot = &mMsgOutbound.back();
 	}
+
+	slot->topic = topic;
+	slot->message = message;
+	slot->qos = qos;
+	slot->retain = retain;
+
+	if(inRing) mLoop.mOutbound.commitPush();
 }
 
-void MqttWatcher::sendOutboundMessage(const std::string& str){
-	//Dont need to set topic for outbound messages. Handled through setting outbound topic
-	MqttMessage outMsg;
-	outMsg.message = std::string(str);
-	mMsgOutbound.push_back(outMsg);
+void MqttWatcher::flushOutbound(){
+	while(!mMsgOutbound.empty()){
+		MqttMessage*		slot = mLoop.mOutbound.beginPush();
+		if(!slot) break;
+		MqttMessage&		msg = mMsgOutbound.front();
+		slot->topic.swap(msg.topic);
+		slot->message.swap(msg.message);
+		slot->qos = msg.qos;
+		slot->retain = msg.retain;
+		mLoop.mOutbound.commitPush();
+		mMsgOutbound.pop_front();
+	}
 }
 
 void MqttWatcher::startListening(){
@@ -106,6 +270,8 @@ void MqttWatcher::startListening(){
 	mStarted = true;
 	if(!mLoop.mConnected){
 		DS_LOG_INFO_M("Attempting to connect to the MQTT server at " << mLoop.getHost() << ":" << mLoop.getPort(), MQTT_LOG);
+		// Here rather than in the loop, so a stop right after this can't be missed
+		mLoop.mAbort = false;
 		mLoopThread = std::thread( [this](){ mLoop.run(); } );
 		mLoop.mConnected = true;
 	}
@@ -114,8 +280,6 @@ void MqttWatcher::startListening(){
 void MqttWatcher::stopListening(){
 	if(!mStarted) return;
 	mStarted = false;
-	// setting abort is atomic, but someone may want to do something right after this
-	std::lock_guard<std::mutex>	_lock(mLoop.mOutboundMutex);
 	DS_LOG_INFO_M("Closing connection to the MQTT server at " << mLoop.getHost() << ":" << mLoop.getPort(), MQTT_LOG);
 	mLoop.mAbort = true;
 	if(mLoopThread.joinable()){
@@ -124,13 +288,16 @@ void MqttWatcher::stopListening(){
 }
 
 void MqttWatcher::setTopicInbound(const std::string& inBound){
-	std::lock_guard<std::mutex>	_lock(mLoop.mInboundMutex);
 	mLoop.setInBound(inBound);
 }
 
 void MqttWatcher::setTopicOutbound(const std::string& outBound){
-	std::lock_guard<std::mutex>	_lock(mLoop.mOutboundMutex);
-	mLoop.setOutBound(outBound);
+	// Only used on this thread, it's copied into each message
+	mTopicOutbound = outBound;
+}
+
+void MqttWatcher::setInboundQos(const int qos){
+	mLoop.setInboundQos(qos);
 }
 
 void MqttWatcher::setHostString(const std::string& host){
@@ -149,15 +316,14 @@ MqttWatcher::MqttConnectionLoop::MqttConnectionLoop (
 	ds::ui::SpriteEngine&,
 	const std::string& host,
 	const std::string& topic_inbound,
-	const std::string& topic_outband,
 	float refresh_rate,
 	int port,
 	const std::string& clientId)
 	: mAbort(false)
 	, mHost(host)
 	, mPort(port)
+	, mInboundQos(0)
 	, mTopicInbound(topic_inbound)
-	, mTopicOutbound(topic_outband)
 	, mRefreshRateMs(static_cast<int>(refresh_rate * 1000))
 	, mFirstTimeMessage(true)
 	, mClientId(clientId)
@@ -170,22 +336,31 @@ public:
 	MosquittoReceiver(const std::string& id) : mosqpp::mosquittopp(id.c_str(), true){}
 	void on_connect(int rc) override { mConnectAction(rc); }
 	void on_message(const struct mosquitto_message *message) override { 
-		MqttWatcher::MqttMessage msg;
-		msg.topic = std::string((char*)message->topic);
-		msg.message = std::string((char*)message->payload, message->payloadlen);
-		mMessageAction(msg);
+		// Reused, so the strings keep their capacity
+		mMessage.topic.assign((char*)message->topic);
+		mMessage.message.assign((char*)message->payload, message->payloadlen);
+		mMessageAction(mMessage);
 	}
 	void setConnectAction(const std::function<void(int)>& fn) { mConnectAction = fn; }
-	void setMessageAction(const std::function<void(const MqttWatcher::MqttMessage&)>& fn) { mMessageAction = fn; }
+	void setMessageAction(const std::function<void(MqttWatcher::MqttMessage&)>& fn) { mMessageAction = fn; }
 
 private:
+	MqttWatcher::MqttMessage				mMessage;
 	std::function<void(int)>				mConnectAction{ [](int){} };
-	std::function<void(const MqttWatcher::MqttMessage&)>	mMessageAction{ [](const MqttWatcher::MqttMessage&){} };
+	std::function<void(MqttWatcher::MqttMessage&)>	mMessageAction{ [](MqttWatcher::MqttMessage&){} };
 };
 }
 
 void MqttWatcher::MqttConnectionLoop::run(){
-	mAbort = false;
+	std::string			host, topicInbound;
+	int					port, inboundQos;
+	{
+		std::lock_guard<std::mutex>	_lock(mSettingsMutex);
+		host = mHost;
+		topicInbound = mTopicInbound;
+		port = mPort;
+		inboundQos = mInboundQos;
+	}
 
 	std::srand((unsigned int)std::time(0));
 	std::string id = mClientId;
@@ -200,42 +375,48 @@ void MqttWatcher::MqttConnectionLoop::run(){
 		//mConnected = true;
 	});
 
-	mqtt_isnt.setMessageAction([this](const MqttMessage& msg){
-		//std::cout << "MQTT watcher received: " << m << std::endl, MQTT_LOG;
-		if(!mAbort)	{
-			std::lock_guard<std::mutex>	_lock(mInboundMutex);
-			//PUSHES BOTH THE TOPIC AND THE PAYLOAD PER MESSAGE
-			mLoopInbound.push_back(msg);
-		}
+	mqtt_isnt.setMessageAction([this](MqttMessage& msg){
+		if(!mAbort) receive(msg);
 	});
 
-	auto err_no = mqtt_isnt.connect(mHost.c_str(), mPort);
+	auto err_no = mqtt_isnt.connect(host.c_str(), port);
 	if(err_no != MOSQ_ERR_SUCCESS && mFirstTimeMessage){
 		DS_LOG_ERROR_M("Unable to connect to the MQTT server. Error number is: " << err_no << ". Error string is: " << mosqpp::strerror(err_no), MQTT_LOG);
 		mAbort = true;
 	}
 
-	err_no = mqtt_isnt.subscribe(nullptr, mTopicInbound.c_str());
+	err_no = mqtt_isnt.subscribe(nullptr, topicInbound.c_str(), inboundQos);
 	if(err_no != MOSQ_ERR_SUCCESS && mFirstTimeMessage){
-		DS_LOG_ERROR_M("Unable to subscribe to the MQTT topic (" << mTopicInbound << "). Error number is: " << err_no << ". Error string is: " << mosqpp::strerror(err_no), MQTT_LOG);
+		DS_LOG_ERROR_M("Unable to subscribe to the MQTT topic (" << topicInbound << "). Error number is: " << err_no << ". Error string is: " << mosqpp::strerror(err_no), MQTT_LOG);
 		mAbort = true;
 	}
 
+	bool				backlog = false;
 	while(!mAbort){
-		auto loopReturn = mqtt_isnt.loop();			
+		// Waits on the socket for up to the refresh rate, so inbound messages are read as they
+		// arrive. Doesn't wait if there's more to publish.
+		auto loopReturn = mqtt_isnt.loop(backlog ? 0 : mRefreshRateMs);
 		if(loopReturn != MOSQ_ERR_SUCCESS){
 			DS_LOG_WARNING_M("MQTT loop errored with number: " << loopReturn << " Error string is: " << mosqpp::strerror(loopReturn), MQTT_LOG);
 			break;
 		}
-		if(!mLoopOutbound.empty())	{
-			std::lock_guard<std::mutex>	_lock(mOutboundMutex);
-			while(!mLoopOutbound.empty()){
-				mqtt_isnt.publish(nullptr, mTopicOutbound.c_str(), mLoopOutbound.back().message.size(), mLoopOutbound.back().message.data(), 1);
-				mLoopOutbound.pop_back();
+
+		flushInbound();
+
+		// Everything sent since the last pass goes out together, oldest first
+		size_t			published = 0;
+		while(published < PUBLISH_BATCH){
+			MqttMessage*	msg = mOutbound.front();
+			if(!msg) break;
+			auto		pubReturn = mqtt_isnt.publish(nullptr, msg->topic.c_str(), static_cast<int>(msg->message.size()), msg->message.data(), msg->qos, msg->retain);
+			if(pubReturn != MOSQ_ERR_SUCCESS){
+				DS_LOG_WARNING_M("Unable to publish to the MQTT topic (" << msg->topic << "). Error string is: " << mosqpp::strerror(pubReturn), MQTT_LOG);
 			}
+			mOutbound.pop();
+			++published;
 		}
-
-		std::this_thread::sleep_for(std::chrono::milliseconds(mRefreshRateMs));
+		mPublished += static_cast<unsigned>(published);
+		backlog = published == PUBLISH_BATCH || !mInboundOverflow.empty();
 	}
 	DS_LOG_INFO_M("MQTT Watcher loop is returning, setting connected to false.", MQTT_LOG);
 	mConnected = false;
@@ -243,22 +424,67 @@ void MqttWatcher::MqttConnectionLoop::run(){
 	mFirstTimeMessage = false;
 }
 
-void MqttWatcher::MqttConnectionLoop::setInBound(const std::string& inBound){
-	mTopicInbound = inBound;
+void MqttWatcher::MqttConnectionLoop::receive(MqttMessage& msg){
+	// Keep them in order behind any that are already waiting
+	flushInbound();
+
+	MqttMessage*		slot = mInboundOverflow.empty() ? mInbound.beginPush() : nullptr;
+	if(slot){
+		slot->topic.swap(msg.topic);
+		slot->message.swap(msg.message);
+		mInbound.commitPush();
+		return;
+	}
+
+	if(mInboundOverflow.size() >= MAX_INBOUND_OVERFLOW){
+		mInboundOverflow.pop_front();
+		if(mDropped++ == 0){
+			DS_LOG_WARNING_M("MQTT messages are arriving faster than they're handled, dropping the oldest", MQTT_LOG);
+		}
+	}
+	mInboundOverflow.push_back(msg);
 }
 
-void MqttWatcher::MqttConnectionLoop::setOutBound(const std::string& outBound){
-	mTopicOutbound = outBound;
+void MqttWatcher::MqttConnectionLoop::flushInbound(){
+	while(!mInboundOverflow.empty()){
+		MqttMessage*	slot = mInbound.beginPush();
+		if(!slot) return;
+		slot->topic.swap(mInboundOverflow.front().topic);
+		slot->message.swap(mInboundOverflow.front().message);
+		mInbound.commitPush();
+		mInboundOverflow.pop_front();
+	}
+}
+
+void MqttWatcher::MqttConnectionLoop::setInBound(const std::string& inBound){
+	std::lock_guard<std::mutex>	_lock(mSettingsMutex);
+	mTopicInbound = inBound;
 }
 
 void MqttWatcher::MqttConnectionLoop::setHost(const std::string& host){
-	mHost.clear();
+	std::lock_guard<std::mutex>	_lock(mSettingsMutex);
 	mHost = host;
 }
 
 void MqttWatcher::MqttConnectionLoop::setPort(const int port){
+	std::lock_guard<std::mutex>	_lock(mSettingsMutex);
 	mPort = port;
 }
 
+void MqttWatcher::MqttConnectionLoop::setInboundQos(const int qos){
+	std::lock_guard<std::mutex>	_lock(mSettingsMutex);
+	mInboundQos = qos;
+}
+
+const int MqttWatcher::MqttConnectionLoop::getPort(){
+	std::lock_guard<std::mutex>	_lock(mSettingsMutex);
+	return mPort;
+}
+
+std::string MqttWatcher::MqttConnectionLoop::getHost(){
+	std::lock_guard<std::mutex>	_lock(mSettingsMutex);
+	return mHost;
+}
+
 } //!net
 } //!ds
@@ -1,12 +1,14 @@
 #ifndef DS_NETWORK_MQTT_MQTT_WATCHER
 #define DS_NETWORK_MQTT_MQTT_WATCHER
 
-#include <queue>
+#include <deque>
 #include <mutex>
 #include <atomic>
 #include <thread>
+#include <unordered_map>
 
 #include <ds/app/auto_update.h>
+#include <ds/util/spsc_ring.h>
 
 namespace ds {
 namespace net {
@@ -16,15 +18,49 @@ namespace net {
 /**
 * \class ds::MqttWatcher
 * \brief Listen and send messages on MQTT ( http://mqtt.org )
+* Messages go between the main thread and the connection thread through lock-free queues,
+* one each way. Everything sent during a frame is published together on the next pass of
+* the connection loop. Inbound messages are coalesced per topic (see setTopicPolicy()) and
+* handed to the listeners in batches, stopping for the frame once the delivery budget is
+* used up. Whatever's left is delivered next frame.
 */
 class MqttWatcher : public ds::AutoUpdate {
 public:
 	struct MqttMessage {
+		MqttMessage() : qos(1), retain(false) {}
+
 		std::string topic;
 		std::string message;
+		// Outbound only
+		int qos;
+		bool retain;
 	};
 	typedef std::vector<MqttMessage> MessageQueue;
 
+	/// How inbound messages on a topic are handed to the listeners
+	enum Coalesce {
+		/// Every message, in the order they arrived. The default.
+		COALESCE_ALL,
+		/// Only the newest message that arrived since the last one was delivered
+		COALESCE_LATEST,
+		/// Only the newest, and no more than once every interval seconds
+		COALESCE_RATE_LIMITED
+	};
+
+	struct Stats {
+		Stats() : mReceived(0), mDelivered(0), mCoalesced(0), mDropped(0), mPublished(0), mTopics(0) {}
+
+		unsigned					mReceived;
+		unsigned					mDelivered;
+		/// Replaced by a newer message on the same topic before they were delivered
+		unsigned					mCoalesced;
+		/// Inbound messages lost because the main thread fell too far behind
+		unsigned					mDropped;
+		unsigned					mPublished;
+		/// Coalesced topics with a message waiting or a rate limit still running
+		unsigned					mTopics;
+	};
+
 	// Standard MQTT location
 	MqttWatcher(ds::ui::SpriteEngine&,
 		const std::string& host, //example: "test.mosquitto.org"
@@ -39,7 +75,17 @@ public:
 	void							startListening();
 	void							stopListening();
 	void							addInboundListener(const std::function<void(const MessageQueue&)>&);
-	void							sendOutboundMessage(const std::string&);
+	/// Published on the outbound topic
+	void							sendOutboundMessage(const std::string&, const int qos = 1, const bool retain = false);
+	void							sendOutboundMessage(const std::string& topic, const std::string& message, const int qos = 1, const bool retain = false);
+
+	/// The topic can have MQTT wildcards. The first policy that matches a topic wins.
+	void							setTopicPolicy(const std::string& topic, const Coalesce, const float intervalSeconds = 0.0f);
+	/// Seconds per frame the listeners can take before the rest waits for the next frame. 0 for no limit.
+	void							setDeliveryBudget(const float seconds){ mDeliveryBudget = seconds; }
+	/// For subscribing to the inbound topic, takes effect the next time it connects
+	void							setInboundQos(const int qos);
+	Stats							getStats() const;
 
 	void							setTopicInbound(const std::string&);
 	void							setTopicOutbound(const std::string&);
@@ -56,43 +102,100 @@ protected:
 	virtual void					update(const ds::UpdateParams &) override;
 
 private:
+	static const size_t				INBOUND_RING_SIZE = 4096;
+	static const size_t				OUTBOUND_RING_SIZE = 1024;
+
 	class MqttConnectionLoop {
 	public:
-		std::mutex					mInboundMutex;
-		std::mutex					mOutboundMutex;
+		// Guards the connection settings, which are copied when the loop starts
+		std::mutex					mSettingsMutex;
 		std::atomic<bool>			mAbort;
 		std::atomic<bool>			mConnected{ false };
-		MessageQueue				mLoopInbound;
-		MessageQueue				mLoopOutbound;
+		// Filled by the loop thread, emptied by the main thread
+		ds::SpscRing<MqttMessage, INBOUND_RING_SIZE>
+									mInbound;
+		// Filled by the main thread, emptied by the loop thread
+		ds::SpscRing<MqttMessage, OUTBOUND_RING_SIZE>
+									mOutbound;
+		std::atomic<unsigned>		mDropped{ 0 };
+		std::atomic<unsigned>		mPublished{ 0 };
 
 		MqttConnectionLoop(ds::ui::SpriteEngine&,
 			const std::string& host,
 			const std::string& topic_inbound,
-			const std::string& topic_outband,
 			float refresh_rate,
 			int port,
 			const std::string& clientId);
 
 		virtual void				run();
 		void						setInBound(const std::string&);
-		void						setOutBound(const std::string&);
 		void						setHost(const std::string&);
 		void						setPort(const int);
-		const int					getPort(){ return mPort; };
-		std::string					getHost(){ return mHost; }
+		void						setInboundQos(const int);
+		const int					getPort();
+		std::string					getHost();
 
 	private:
+		// Loop thread, hand what arrived to the main thread
+		void						receive(MqttMessage&);
+		void						flushInbound();
+
 		std::string					mHost;
 		std::string					mTopicInbound;
-		std::string					mTopicOutbound;
 		int							mPort;
+		int							mInboundQos;
 		std::string					mClientId;
 		const int					mRefreshRateMs;	// in milliseconds
 		bool						mFirstTimeMessage;
+		// Loop thread, arrived while the inbound ring was full
+		std::deque<MqttMessage>		mInboundOverflow;
 	};
 
+	struct Policy {
+		std::string					mTopic;
+		Coalesce					mMode;
+		double						mInterval;
+	};
+
+	// The newest message on a coalesced topic
+	struct Latest {
+		Latest() : mHasValue(false), mQueued(false), mLastDelivered(0.0) {}
+
+		MqttMessage					mMessage;
+		bool						mHasValue;
+		// Has a place in mPending
+		bool						mQueued;
+		double						mLastDelivered;
+	};
+
+	// A message for the listeners, or a place held for the newest on a coalesced topic
+	struct Pending {
+		MqttMessage					mMessage;
+		bool						mLatest;
+	};
+
+	// Answers nullptr for COALESCE_ALL
+	const Policy*					findPolicy(const std::string& topic);
+	void							accept(MqttMessage&);
+	void							deliver();
+	void							flushOutbound();
+	double							now() const;
+
+	std::string						mTopicOutbound;
 	MessageQueue					mMsgInbound;
-	MessageQueue					mMsgOutbound;
+	// Sent while the outbound ring was full, in order
+	std::deque<MqttMessage>			mMsgOutbound;
+	std::vector<Policy>				mPolicies;
+	// Index into mPolicies by topic, so each topic is matched against the wildcards once.
+	// Cleared when it gets too big.
+	std::unordered_map<std::string, int>
+									mTopicPolicies;
+	// Only topics with something to deliver or a rate limit running, see deliver()
+	std::unordered_map<std::string, Latest>
+									mLatest;
+	std::deque<Pending>				mPending;
+	float							mDeliveryBudget;
+	Stats							mStats;
 	std::vector < std::function<void(const MessageQueue&)> > mListeners;
 	MqttConnectionLoop				mLoop;
 	std::thread						mLoopThread;
@@ -155,6 +155,10 @@ GstVideo& GstVideo::makeVideo(SpriteEngine& e, Sprite* parent) {
 	return makeAlloc<ds::ui::GstVideo>([&e]()->ds::ui::GstVideo*{ return new ds::ui::GstVideo(e); }, parent);
 }
 
+VideoMetaCache& GstVideo::getMetaCache() {
+	return CACHE;
+}
+
 void GstVideo::installAsServer(ds::BlobRegistry& registry) {
 	BLOB_TYPE = registry.add([](BlobReader& r) {Sprite::handleBlobFromClient(r); });
 }
@@ -205,6 +209,7 @@ GstVideo::GstVideo(SpriteEngine& engine)
 	, mStreaming(false)
 	, mClientVideoCompleted(false)
 	, mStreamingLatency(200000000)
+	, mProbeId(0)
 {
 	mLayoutFixedAspect = true;
 	mBlobType = BLOB_TYPE;
@@ -222,6 +227,8 @@ GstVideo::GstVideo(SpriteEngine& engine)
 }
 
 GstVideo::~GstVideo(){
+	cancelLoad();
+
 	if(mGstreamerWrapper){
 		delete mGstreamerWrapper;
 		mGstreamerWrapper = nullptr;
@@ -275,6 +282,7 @@ void * GstVideo::getGstreamerElementByName(const std::string& theName){
 }
 
 void GstVideo::onUpdateServer(const UpdateParams &up){
+	CACHE.update();
 
 	mGstreamerWrapper->update();
 
@@ -314,6 +322,7 @@ void GstVideo::onUpdateServer(const UpdateParams &up){
 }
 
 void GstVideo::onUpdateClient(const UpdateParams& up){
+	CACHE.update();
 	mGstreamerWrapper->update();
 
 	checkStatus();
@@ -530,24 +539,45 @@ void GstVideo::doLoadVideo(const std::string &filename, const std::string &porta
 	}
 
 	mStreaming = false;
+	mFilename = filename;
+	mPortableFilename = portable_filename;
+
+	// Probing a file that isn't cached can take seconds, so that happens on a worker and the
+	// rest of the load waits for it. A cached file finishes loading before this returns.
+	cancelLoad();
+	const VideoMetaCache::RequestId	probeId = CACHE.probeAsync(filename, [this, filename](const VideoMetaCache::Entry& entry){
+		mProbeId = 0;
+		finishLoadVideo(filename, entry);
+	});
+	mProbeId = probeId;
+}
 
+void GstVideo::cancelLoad(){
+	if(mProbeId == 0) return;
+	CACHE.cancelProbe(mProbeId);
+	mProbeId = 0;
+}
+
+void GstVideo::finishLoadVideo(const std::string& filename, const VideoMetaCache::Entry& entry){
 	// This allows apps to only load videos on certain client instances
 	// The default is to load everything everywhere
 	// If nothing has been specified, then load everywhere
 	bool doLoad = thisInstancePlayable();
 
-	VideoMetaCache::Type		type(VideoMetaCache::ERROR_TYPE);
+	const VideoMetaCache::Type	type(entry.mType);
 
 	try	{
+		// A file that couldn't be probed keeps the sprite's size and the last duration
 		int						videoWidth = static_cast<int>(getWidth());
 		int						videoHeight = static_cast<int>(getHeight());
 		bool					generateVideoBuffer = true;
 		std::string				colorSpace = "";
-
-		CACHE.getValues(filename, type, videoWidth, videoHeight, mCachedDuration, colorSpace);
-
-		mFilename = filename;
-		mPortableFilename = portable_filename;
+		if(type != VideoMetaCache::ERROR_TYPE){
+			videoWidth = entry.mWidth;
+			videoHeight = entry.mHeight;
+			mCachedDuration = entry.mDuration;
+			colorSpace = entry.mColorSpace;
+		}
 
 		if(!doLoad){
 			mVideoSize.x = videoWidth;
@@ -669,6 +699,7 @@ void GstVideo::startStream(const std::string& streamingPipeline, const float vid
 
 	setBaseShader(Environment::getAppFolder("data/shaders"), "base");
 
+	cancelLoad();
 	mDrawable = false;
 	mStreaming = true;
 	mFilename = streamingPipeline;
@@ -995,6 +1026,7 @@ void GstVideo::setStreamingLatency(const uint64_t latencyNs){
 }
 
 void GstVideo::unloadVideo(const bool clearFrame){
+	cancelLoad();
 	mGstreamerWrapper->stop();
 	mGstreamerWrapper->close();
 	mFilename.clear();
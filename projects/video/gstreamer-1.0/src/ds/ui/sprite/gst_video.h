@@ -9,6 +9,7 @@
 #include <Poco/Timestamp.h>
 
 #include "gstreamer/gstreamer_audio_device.h"
+#include "gstreamer/video_meta_cache.h"
 
 namespace gstwrapper {
 	class GStreamerWrapper;
@@ -58,6 +59,11 @@ public:
 	// to another Sprite as child.
 	static GstVideo&	makeVideo(SpriteEngine&, Sprite* parent = nullptr);
 
+	// The cache of video sizes, durations and types every GstVideo loads from. Probe a
+	// playlist with it ahead of time and each video opens as it's loaded, not after a probe.
+	// Its callbacks come from GstVideo updates, call update() on it if there are no videos yet.
+	static VideoMetaCache&	getMetaCache();
+
 	// Generic constuctor. To be used with Sprite::addChildPtr(...)
 	GstVideo(SpriteEngine&);
 
@@ -67,7 +73,8 @@ public:
 	// Sets the video sprite size. Internally just scales the texture
 	void				setSize( float width, float height );
 	
-	// Loads a video from a file path.
+	// Loads a video from a file path. A file that isn't in the meta cache is probed on a worker
+	// first, so the video opens and the sprite takes its size from a later update.
 	GstVideo&			loadVideo(const std::string &filename);
 	// Loads a vodeo from a ds::Resource::Id
 	GstVideo&			setResourceId(const ds::Resource::Id& resource_id);
@@ -244,6 +251,10 @@ private:
 	// user accounts and to different CMS locations can interoperate.
 	void				doLoadVideo(const std::string &filename,
 									const std::string &portable_filename);
+	// The rest of doLoadVideo(), once the cache has the file's size and type
+	void				finishLoadVideo(const std::string& filename, const VideoMetaCache::Entry&);
+	// Drop a load that's still waiting on its probe
+	void				cancelLoad();
 	void				applyMovieVolume();
 	void				applyMoviePan(const float pan);
 	void				applyMovieLooping();
@@ -317,6 +328,7 @@ private:
 	bool				mClientVideoCompleted;
 
 	std::uint64_t		mStreamingLatency;	// Latency for streaming pipelines
+	VideoMetaCache::RequestId	mProbeId;	// The probe a load is waiting on, or 0
 
 	std::uint64_t		mBaseTime;		//Base clock for gst pipeline
 	std::uint64_t		mSeekTime;		//Position to seek to
@@ -1,45 +1,54 @@
-#include "stdafx.h"
-
-#include "video_meta_cache.h"
-
-
-// Keep this at the front, can get messed if it comes later
-#include "MediaInfoDLL/MediaInfoDLL.h"
-
-#include <sstream>
-#include <Poco/Path.h>
-#include <Poco/File.h>
-#include <ds/query/query_client.h>
-#include <ds/query/query_result.h>
-#include <ds/debug/logger.h>
-#include <ds/app/environment.h>
-#include <ds/util/string_util.h>
-
-#include "ds/ui/sprite/video.h"
-
+#include "stdafx.h"
+
+#include "video_meta_cache.h"
+
+
+// Keep this at the front, can get messed if it comes later
+#include "MediaInfoDLL/MediaInfoDLL.h"
+
+#include <algorithm>
+#include <memory>
+#include <Poco/DirectoryIterator.h>
+#include <Poco/Path.h>
+#include <Poco/File.h>
+#include <ds/data/resource.h>
+#include <ds/debug/logger.h>
+#include <ds/app/environment.h>
+#include <ds/query/sqlite/sqlite3.h>
+#include <ds/util/string_util.h>
+
+#include "ds/ui/sprite/video.h"
+
 
 // Win32 has UNICODE defined, meaning MediaInfo strings are wstring
 // Linux just uses utf-8 strings.
-#if defined(UNICODE) || defined(_UNICODE)
-	#define _MI_TO_STR(__x) ds::utf8_from_wstr(__x)
-	#define _STR_TO_MI(__x) ds::wstr_from_utf8(__x)
-	#define _MI_TO_VALUE ds::wstring_to_value
-#else
-	#define _MI_TO_STR(__x) __x
-	#define _STR_TO_MI(__x) __x
-	#define _MI_TO_VALUE ds::string_to_value
-#endif
-
-
-namespace ds {
-namespace ui {
-
+#if defined(UNICODE) || defined(_UNICODE)
+	#define _MI_TO_STR(__x) ds::utf8_from_wstr(__x)
+	#define _STR_TO_MI(__x) ds::wstr_from_utf8(__x)
+	#define _MI_TO_VALUE ds::wstring_to_value
+#else
+	#define _MI_TO_STR(__x) __x
+	#define _STR_TO_MI(__x) __x
+	#define _MI_TO_VALUE ds::string_to_value
+#endif
+
+
+namespace ds {
+namespace ui {
+
 namespace {
 const std::string&	ERROR_TYPE_SZ() { static const std::string	ANS(""); return ANS; }
 const std::string&	AUDIO_ONLY_TYPE_SZ() { static const std::string	ANS("a"); return ANS; }
 const std::string&	VIDEO_ONLY_TYPE_SZ() { static const std::string	ANS("v"); return ANS; }
 const std::string&	VIDEO_AND_AUDIO_TYPE_SZ() { static const std::string	ANS("va"); return ANS; }
-
+
+// Write back once this many probes are waiting, or once the workers go quiet
+const size_t		WRITE_BATCH_SIZE = 32;
+// Or once this long has passed with anything waiting, in microseconds
+const Poco::Timestamp::TimeDiff	WRITE_INTERVAL = 2000000;
+
+const char*			COLUMNS_SZ = "type, width, height, duration, colorspace, videocodec, audiocodec, modified, filesize, path";
+
 std::string get_db_directory() {
 	Poco::Path		p(Poco::Path::home());
 	p.append("documents").append("downstream").append("cache").append("video");
@@ -65,182 +74,505 @@ const std::string& db_type_from_type(const VideoMetaCache::Type t) {
 	if(t == VideoMetaCache::VIDEO_ONLY_TYPE) return VIDEO_ONLY_TYPE_SZ();
 	return ERROR_TYPE_SZ();
 }
-
-}
-
-/**
- * \class VideoMetaCache
- */
-VideoMetaCache::VideoMetaCache(const std::string& name)
-	: mName(name)
-{
-	load();
-}
-
-bool VideoMetaCache::getValues(const std::string& videoPath, Type& outType, int& outWidth, int& outHeight, double& outDuration, std::string& outColorSpace) {
-	for(auto it = mEntries.begin(), end = mEntries.end(); it != end; ++it) {
-		const Entry&	e(*it);
-		if (e.mPath == videoPath){
-			outType = e.mType;
-			outWidth = e.mWidth;
-			outHeight = e.mHeight;
-			outDuration = e.mDuration;
-			outColorSpace = e.mColorSpace;
-
-			return true;
-		}
-	}
-
-	// The above search for a pre-cached video info failed, so find the video info
-	try {
-
-		Entry newEntry = Entry();
-		newEntry.mPath = videoPath;
-
-		if(!getVideoInfo(newEntry) || newEntry.mType == ERROR_TYPE){
-			return false;
-		}
-
-		setValues(newEntry);
-
-		outType = newEntry.mType;
-		outWidth = newEntry.mWidth;
-		outHeight = newEntry.mHeight;
-		outDuration = newEntry.mDuration;
-		outColorSpace = newEntry.mColorSpace;
-		return true;
-	} catch (std::exception const& ex) {
-		DS_LOG_WARNING("VideoMetaCache::getWith() error=" << ex.what());
-	}
-	return true;
+
+// Modified time and size of a local file, or false for streams, urls and missing files
+bool get_file_stamp(const std::string& path, int64_t& outModified, int64_t& outSize) {
+	outModified = 0;
+	outSize = 0;
+	try {
+		const Poco::File	file(path);
+		if(!file.exists() || !file.isFile()) return false;
+		outModified = file.getLastModified().epochMicroseconds();
+		outSize = static_cast<int64_t>(file.getSize());
+		return true;
+	} catch(std::exception const&) {
+	}
+	return false;
 }
 
-void VideoMetaCache::setValues(Entry& entry) {
-	if(entry.mType == ERROR_TYPE) {
+bool is_cacheable(const VideoMetaCache::Entry& entry) {
+	if(entry.mType == VideoMetaCache::ERROR_TYPE) {
 		DS_LOG_WARNING("Attempted to cache an invalid media (path=" << entry.mPath << ")");
-		return;
+		return false;
 	}
 	if(entry.mDuration < 0.0f) {
 		DS_LOG_WARNING("Attempted to cache media with no duration (path=" << entry.mPath << ")");
-		return;
+		return false;
 	}
-	if( (entry.mType == VIDEO_ONLY_TYPE || entry.mType == VIDEO_AND_AUDIO_TYPE) && (entry.mWidth < 1 || entry.mHeight < 1)) {
+	if((entry.mType == VideoMetaCache::VIDEO_ONLY_TYPE || entry.mType == VideoMetaCache::VIDEO_AND_AUDIO_TYPE) && (entry.mWidth < 1 || entry.mHeight < 1)) {
 		DS_LOG_WARNING("Attempted to cache video with no size (path=" << entry.mPath << ", width=" << entry.mWidth << ", height=" << entry.mHeight << ")");
-		return;
+		return false;
+	}
+	return true;
+}
+
+std::string column_text(sqlite3_stmt* s, const int column) {
+	const unsigned char*	ans = sqlite3_column_text(s, column);
+	if(!ans) return std::string();
+	return std::string(reinterpret_cast<const char*>(ans));
+}
+
+void bind_text(sqlite3_stmt* s, const int index, const std::string& text) {
+	sqlite3_bind_text(s, index, text.c_str(), static_cast<int>(text.size()), SQLITE_TRANSIENT);
+}
+
+void bind_entry(sqlite3_stmt* s, const VideoMetaCache::Entry& e) {
+	sqlite3_reset(s);
+	bind_text(s, 1, db_type_from_type(e.mType));
+	sqlite3_bind_int(s, 2, e.mWidth);
+	sqlite3_bind_int(s, 3, e.mHeight);
+	sqlite3_bind_double(s, 4, e.mDuration);
+	bind_text(s, 5, e.mColorSpace);
+	bind_text(s, 6, e.mVideoCodec);
+	bind_text(s, 7, e.mAudioCodec);
+	sqlite3_bind_int64(s, 8, e.mModified);
+	sqlite3_bind_int64(s, 9, e.mFileSize);
+	bind_text(s, 10, e.mPath);
+}
+
+bool has_column(sqlite3* db, const std::string& column) {
+	sqlite3_stmt*		s = nullptr;
+	bool				ans = false;
+	if(sqlite3_prepare_v2(db, "PRAGMA table_info(video_meta)", -1, &s, 0) == SQLITE_OK) {
+		while(!ans && sqlite3_step(s) == SQLITE_ROW) {
+			ans = (column_text(s, 1) == column);
+		}
+	}
+	sqlite3_finalize(s);
+	return ans;
+}
+
+// The table as it was before entries had a file stamp gets the two new columns.
+// Old rows keep 0 until they're next written.
+void update_schema(sqlite3* db) {
+	sqlite3_exec(db, "CREATE TABLE IF NOT EXISTS video_meta(id INTEGER PRIMARY KEY AUTOINCREMENT, type TEXT NOT NULL DEFAULT '', path TEXT NOT NULL DEFAULT '', width INT NOT NULL DEFAULT '0', height INT NOT NULL DEFAULT '0', duration DOUBLE NOT NULL DEFAULT '0', colorspace TEXT NOT NULL DEFAULT '', videocodec TEXT NOT NULL DEFAULT '', audiocodec TEXT NOT NULL DEFAULT '', modified INTEGER NOT NULL DEFAULT '0', filesize INTEGER NOT NULL DEFAULT '0');", 0, 0, 0);
+	if(!has_column(db, "modified")) sqlite3_exec(db, "ALTER TABLE video_meta ADD COLUMN modified INTEGER NOT NULL DEFAULT '0';", 0, 0, 0);
+	if(!has_column(db, "filesize")) sqlite3_exec(db, "ALTER TABLE video_meta ADD COLUMN filesize INTEGER NOT NULL DEFAULT '0';", 0, 0, 0);
+	sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS video_meta_path ON video_meta(path);", 0, 0, 0);
+}
+
+sqlite3* open_db(const std::string& file) {
+	sqlite3*			db = nullptr;
+	const int			err = sqlite3_open_v2(file.c_str(), &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, 0);
+	if(err != SQLITE_OK) {
+		DS_LOG_WARNING("VideoMetaCache couldn't open " << file << " (SQLite error " << err << ")");
+		sqlite3_close(db);
+		return nullptr;
 	}
+	sqlite3_busy_timeout(db, 1500);
+	return db;
+}
+
+bool collect_media_files(const Poco::Path& directory, const bool recursive, std::vector<std::string>& out) {
 	try {
-		const std::string				db = get_db_file(mName);
-		std::stringstream				buf;
-		buf << "SELECT id FROM video_meta WHERE path='" << entry.mPath << "'";
-		ds::query::Result						ans;
-		if (ds::query::Client::query(db, buf.str(), ans) && !ans.rowsAreEmpty()) {
-			buf.str("");
-			buf << "UPDATE video_meta SET type='" << db_type_from_type(entry.mType) 
-				<< "', width=" << entry.mWidth 
-				<< ", height=" << entry.mHeight 
-				<< ", duration=" << entry.mDuration
-				<< ", colorspace='" << entry.mColorSpace
-				<< "', videocodec='" << entry.mVideoCodec
-				<< "', audiocodec='" << entry.mAudioCodec
-				<< "' WHERE path='" << entry.mPath << "'";
-			ds::query::Client::queryWrite(db, buf.str(), ans);
-			load();
-			return;
+		Poco::DirectoryIterator		end;
+		for(Poco::DirectoryIterator it(directory); it != end; ++it) {
+			try {
+				if(it->isDirectory()) {
+					if(recursive) collect_media_files(it.path(), recursive, out);
+				} else if(ds::Resource::parseTypeFromFilename(it.path().toString()) == ds::Resource::VIDEO_TYPE) {
+					out.push_back(it.path().toString());
+				}
+			} catch(std::exception const&) {
+			}
 		}
-		buf.str("");
-		buf << "INSERT INTO video_meta (type, path, width, height, duration, colorspace, videocodec, audiocodec) values ('" << 
-			db_type_from_type(entry.mType) << "', '" 
-			<< entry.mPath << "', " 
-			<< entry.mWidth << ", " 
-			<< entry.mHeight << ", " 
-			<< entry.mDuration << ", '" 
-			<< entry.mColorSpace << "', '" 
-			<< entry.mVideoCodec << "', '" 
-			<< entry.mAudioCodec << "')";
-		ds::query::Client::queryWrite(db, buf.str(), ans);
-		mEntries.push_back(entry);
-	} catch (std::exception const&) {
-	}
-
-	//load();
-}
+	} catch(std::exception const& ex) {
+		DS_LOG_WARNING("VideoMetaCache::prescanDirectory could not read directory " << directory.toString() << " error=" << ex.what());
+		return false;
+	}
+	return true;
+}
+
+// MediaInfoDLL loads and counts its module without any locking, so instances are only
+// made and deleted one at a time. Probes on separate instances are fine in parallel.
+class LockedMediaInfo {
+public:
+	LockedMediaInfo() {
+		std::lock_guard<std::mutex>		lock(getMutex());
+		mInfo.reset(new MediaInfoDLL::MediaInfo());
+	}
+
+	~LockedMediaInfo() {
+		std::lock_guard<std::mutex>		lock(getMutex());
+		mInfo.reset();
+	}
+
+	MediaInfoDLL::MediaInfo&			get() { return *mInfo; }
+
+private:
+	static std::mutex&					getMutex() { static std::mutex MUTEX; return MUTEX; }
+
+	std::unique_ptr<MediaInfoDLL::MediaInfo>
+										mInfo;
+};
+
+}
+
+/**
+ * \class VideoMetaCache
+ */
+VideoMetaCache::VideoMetaCache(const std::string& name, const int numThreads)
+	: mName(name)
+	, mNumThreads(std::max(1, numThreads))
+	, mNextRequestId(0)
+	, mWriteRequested(false)
+	, mStopping(false)
+{
+	load();
+}
+
+VideoMetaCache::~VideoMetaCache() {
+	{
+		std::lock_guard<std::mutex>		lock(mMutex);
+		mStopping = true;
+		mQueue.clear();
+	}
+	mCondition.notify_all();
+	for(auto& it : mWorkers) {
+		try {
+			it.join();
+		} catch(std::exception const&) {
+		}
+	}
+
+	flush();
+}
+
+VideoMetaCache::Entry* VideoMetaCache::findCurrent(const std::string& videoPath) {
+	auto found = mEntries.find(videoPath);
+	if(found == mEntries.end()) return nullptr;
+
+	Entry&								e(found->second);
+	int64_t								modified, fileSize;
+	if(!get_file_stamp(videoPath, modified, fileSize)) return &e;
+	if(e.mModified == modified && e.mFileSize == fileSize) return &e;
+
+	// Cached before entries had a stamp, so trust it like before and save the stamp
+	if(e.mModified == 0 && e.mFileSize == 0) {
+		e.mModified = modified;
+		e.mFileSize = fileSize;
+		std::lock_guard<std::mutex>		lock(mMutex);
+		mUnsaved.push_back(e);
+		return &e;
+	}
+
+	// The file has changed since it was probed
+	return nullptr;
+}
+
+bool VideoMetaCache::getValues(const std::string& videoPath, Type& outType, int& outWidth, int& outHeight, double& outDuration, std::string& outColorSpace) {
+	const Entry*						found = findCurrent(videoPath);
+	if(found) {
+		outType = found->mType;
+		outWidth = found->mWidth;
+		outHeight = found->mHeight;
+		outDuration = found->mDuration;
+		outColorSpace = found->mColorSpace;
+		return true;
+	}
+
+	// The above search for a pre-cached video info failed, so find the video info
+	try {
+
+		Entry newEntry = Entry();
+		newEntry.mPath = videoPath;
+		get_file_stamp(videoPath, newEntry.mModified, newEntry.mFileSize);
+
+		if(!getVideoInfo(newEntry) || newEntry.mType == ERROR_TYPE){
+			return false;
+		}
+
+		setValues(newEntry);
+
+		outType = newEntry.mType;
+		outWidth = newEntry.mWidth;
+		outHeight = newEntry.mHeight;
+		outDuration = newEntry.mDuration;
+		outColorSpace = newEntry.mColorSpace;
+		return true;
+	} catch (std::exception const& ex) {
+		DS_LOG_WARNING("VideoMetaCache::getWith() error=" << ex.what());
+	}
+	return true;
+}
+
+bool VideoMetaCache::hasValues(const std::string& videoPath) {
+	return findCurrent(videoPath) != nullptr;
+}
+
+VideoMetaCache::RequestId VideoMetaCache::probeAsync(const std::string& videoPath, const ProbeCallback& callback) {
+	const Entry*						found = findCurrent(videoPath);
+	if(found) {
+		if(callback) callback(*found);
+		return 0;
+	}
+
+	RequestId							id = 0;
+	if(callback) {
+		if(++mNextRequestId < 1) mNextRequestId = 1;
+		id = mNextRequestId;
+		mCallbacks[id] = callback;
+	}
+
+	auto inFlight = mInFlight.find(videoPath);
+	if(inFlight == mInFlight.end()) {
+		inFlight = mInFlight.insert(std::make_pair(videoPath, std::vector<RequestId>())).first;
+		queueProbe(videoPath);
+	}
+	if(id > 0) inFlight->second.push_back(id);
+	return id;
+}
+
+void VideoMetaCache::cancelProbe(const RequestId id) {
+	mCallbacks.erase(id);
+}
+
+size_t VideoMetaCache::prescanDirectory(const std::string& directory, const bool recursive, const ProbeCallback& callback) {
+	std::vector<std::string>			files;
+	collect_media_files(Poco::Path(ds::Environment::expand(directory)), recursive, files);
+
+	size_t								queued = 0;
+	for(auto& it : files) {
+		if(findCurrent(it)) continue;
+		probeAsync(it, callback);
+		++queued;
+	}
+	return queued;
+}
+
+void VideoMetaCache::queueProbe(const std::string& videoPath) {
+	if(mWorkers.empty()) startWorkers();
+	{
+		std::lock_guard<std::mutex>		lock(mMutex);
+		mQueue.push_back(videoPath);
+	}
+	mCondition.notify_one();
+}
+
+void VideoMetaCache::startWorkers() {
+	for(int i = 0; i < mNumThreads; ++i) {
+		try {
+			mWorkers.push_back(std::thread(&VideoMetaCache::runWorker, this));
+		} catch(std::exception const& ex) {
+			DS_LOG_WARNING("VideoMetaCache couldn't start a worker thread error=" << ex.what());
+		}
+	}
+}
+
+void VideoMetaCache::runWorker() {
+	while(true) {
+		std::string						path;
+		bool							write = false;
+		{
+			std::unique_lock<std::mutex>	lock(mMutex);
+			mCondition.wait(lock, [this]{ return mStopping || mWriteRequested || !mQueue.empty(); });
+			if(mStopping) return;
+			if(mWriteRequested) {
+				mWriteRequested = false;
+				write = true;
+			} else {
+				path = mQueue.front();
+				mQueue.pop_front();
+			}
+		}
+
+		if(write) {
+			flush();
+			continue;
+		}
+
+		Entry							e;
+		e.mPath = path;
+		get_file_stamp(path, e.mModified, e.mFileSize);
+		try {
+			if(!getVideoInfo(e)) e.mType = ERROR_TYPE;
+		} catch(std::exception const& ex) {
+			DS_LOG_WARNING("VideoMetaCache probe error=" << ex.what() << " path=" << path);
+			e.mType = ERROR_TYPE;
+		}
+
+		std::lock_guard<std::mutex>		lock(mMutex);
+		mDone.push_back(e);
+	}
+}
+
+void VideoMetaCache::update() {
+	std::vector<Entry>					done;
+	{
+		std::lock_guard<std::mutex>		lock(mMutex);
+		if(mDone.empty() && (mUnsaved.empty() || mWriteRequested)) return;
+		done.swap(mDone);
+	}
+
+	for(auto& it : done) {
+		if(it.mType != ERROR_TYPE) setValues(it);
+
+		auto inFlight = mInFlight.find(it.mPath);
+		if(inFlight == mInFlight.end()) continue;
+		const std::vector<RequestId>	ids(inFlight->second);
+		mInFlight.erase(inFlight);
+		for(auto id : ids) {
+			auto cb = mCallbacks.find(id);
+			if(cb == mCallbacks.end()) continue;
+			const ProbeCallback			fn = cb->second;
+			mCallbacks.erase(cb);
+			fn(it);
+		}
+	}
+
+	// Batch the write-back while probes are still coming in
+	const Poco::Timestamp				now;
+	{
+		std::lock_guard<std::mutex>		lock(mMutex);
+		if(mUnsaved.empty() || mWriteRequested) return;
+		if(mUnsaved.size() < WRITE_BATCH_SIZE && !mInFlight.empty() && now - mLastWrite < WRITE_INTERVAL) return;
+		mLastWrite = now;
+		if(!mWorkers.empty()) mWriteRequested = true;
+	}
+
+	if(mWorkers.empty()) {
+		flush();
+	} else {
+		mCondition.notify_one();
+	}
+}
+
+void VideoMetaCache::flush() {
+	std::lock_guard<std::mutex>			writeLock(mWriteMutex);
+	std::vector<Entry>					entries;
+	{
+		std::lock_guard<std::mutex>		lock(mMutex);
+		entries.swap(mUnsaved);
+	}
+	if(!entries.empty()) writeEntries(entries);
+}
+
+void VideoMetaCache::setValues(Entry& entry) {
+	if(!is_cacheable(entry)) return;
+
+	mEntries[entry.mPath] = entry;
+	std::lock_guard<std::mutex>			lock(mMutex);
+	mUnsaved.push_back(entry);
+}
+
+void VideoMetaCache::writeEntries(const std::vector<Entry>& entries) {
+	sqlite3*							db = open_db(get_db_file(mName));
+	if(!db) return;
+
+	const std::string					updateSql = std::string("UPDATE video_meta SET type=?1, width=?2, height=?3, duration=?4, colorspace=?5, videocodec=?6, audiocodec=?7, modified=?8, filesize=?9 WHERE path=?10");
+	const std::string					insertSql = std::string("INSERT INTO video_meta (") + COLUMNS_SZ + ") VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10)";
+	sqlite3_stmt*						updateStmt = nullptr;
+	sqlite3_stmt*						insertStmt = nullptr;
+	if(sqlite3_prepare_v2(db, updateSql.c_str(), -1, &updateStmt, 0) != SQLITE_OK
+	   || sqlite3_prepare_v2(db, insertSql.c_str(), -1, &insertStmt, 0) != SQLITE_OK) {
+		DS_LOG_WARNING("VideoMetaCache couldn't prepare the write-back error=" << sqlite3_errmsg(db));
+	} else {
+		sqlite3_exec(db, "BEGIN TRANSACTION;", 0, 0, 0);
+		for(auto& it : entries) {
+			bind_entry(updateStmt, it);
+			if(sqlite3_step(updateStmt) == SQLITE_DONE && sqlite3_changes(db) > 0) continue;
+			bind_entry(insertStmt, it);
+			if(sqlite3_step(insertStmt) != SQLITE_DONE) {
+				DS_LOG_WARNING("VideoMetaCache couldn't save " << it.mPath << " error=" << sqlite3_errmsg(db));
+			}
+		}
+		if(sqlite3_exec(db, "COMMIT;", 0, 0, 0) != SQLITE_OK) {
+			DS_LOG_WARNING("VideoMetaCache couldn't commit the write-back error=" << sqlite3_errmsg(db));
+			sqlite3_exec(db, "ROLLBACK;", 0, 0, 0);
+		}
+	}
+
+	sqlite3_finalize(updateStmt);
+	sqlite3_finalize(insertStmt);
+	sqlite3_close(db);
+}
 
 void VideoMetaCache::load() {
 	mEntries.clear();
 
-	// Load in the high scores
-	Poco::File						f(get_db_directory());
-	if (!f.exists()) f.createDirectories();
-
-	const std::string				db(get_db_file(mName));
-	f = Poco::File(db);
-	if (!f.exists()) {
-		f.createFile();
-		ds::query::Result			r;
-		ds::query::Client::queryWrite(db, "CREATE TABLE video_meta(id INTEGER PRIMARY KEY AUTOINCREMENT, type TEXT NOT NULL DEFAULT '', path TEXT NOT NULL DEFAULT '', width INT NOT NULL DEFAULT '0', height INT NOT NULL DEFAULT '0', duration DOUBLE NOT NULL DEFAULT '0', colorspace TEXT NOT NULL DEFAULT '', videocodec TEXT NOT NULL DEFAULT '', audiocodec TEXT NOT NULL DEFAULT '');", r);
-	}
-
-	ds::query::Result				ans;
-	ds::query::Client::query(db, "SELECT type, path, width, height, duration, colorspace, videocodec, audiocodec FROM video_meta", ans);
-	ds::query::Result::RowIterator	it(ans);
-	while (it.hasValue()) {
-		const std::string&			game(it.getString(1));
-		if (!game.empty()) mEntries.push_back(Entry(game, type_from_db_type(it.getString(0)), it.getInt(2), it.getInt(3), it.getFloat(4), it.getString(5), it.getString(6), it.getString(7)));
-		++it;
-	}
-}
-
-bool VideoMetaCache::getVideoInfo(Entry& entry) {
-	MediaInfoDLL::MediaInfo		media_info;
-	if (!media_info.IsReady()) {
-		// Indicates the DLL couldn't be loaded
-		DS_LOG_ERROR("VideoMetaCache::getVideoInfo() MediaInfo not loaded, does dll/MediaInfo.dll exist in the app folder?");
-		return false;
-	}
-	media_info.Open(_STR_TO_MI(entry.mPath));
-	
-	size_t numAudio = media_info.Count_Get(MediaInfoDLL::Stream_Audio);
-	size_t numVideo = media_info.Count_Get(MediaInfoDLL::Stream_Video);
-
-	if(numAudio < 1 && numVideo < 1){
-		DS_LOG_WARNING("Couldn't find any audio or video streams in " << entry.mPath);
-		entry.mType = ERROR_TYPE;
-		return false;
-	}
-
-	// If there's an audio channel, get it's codec
-	if(numAudio > 0){
-		entry.mAudioCodec = _MI_TO_STR(media_info.Get(MediaInfoDLL::Stream_Audio, 0, __T("Codec"), MediaInfoDLL::Info_Text));
-
-		std::cout << "Number of audio channels: " << _MI_TO_STR(media_info.Get(MediaInfoDLL::Stream_Audio, 0, __T("Channels"), MediaInfoDLL::Info_Text)) << std::endl;
-	}
-
-	// No video streams, but has at least one audio stream is a AUDIO_TYPE
-	if(numAudio > 0 && numVideo < 1){
-		entry.mType = AUDIO_ONLY_TYPE;
-		entry.mWidth = 0;
-		entry.mHeight = 0;
-		if(!_MI_TO_VALUE(media_info.Get(MediaInfoDLL::Stream_Audio, 0, __T("Duration"), MediaInfoDLL::Info_Text), entry.mDuration)) return false;
-
-	// Any number of audio streams and at least one video streams is VIDEO_TYPE
-	} else if(numVideo > 0){
-		if(numAudio > 0){
-			entry.mType = VIDEO_AND_AUDIO_TYPE;
-		} else {
-			entry.mType = VIDEO_ONLY_TYPE;
-		}
-		if(!_MI_TO_VALUE(media_info.Get(MediaInfoDLL::Stream_Video, 0, __T("Width"), MediaInfoDLL::Info_Text), entry.mWidth)) return false;
-		if(!_MI_TO_VALUE(media_info.Get(MediaInfoDLL::Stream_Video, 0, __T("Height"), MediaInfoDLL::Info_Text), entry.mHeight)) return false;
-
-		// We don't check errors on these, cause they're not required by gstreamer to play a video, they're just nice-to-have
-		entry.mVideoCodec = _MI_TO_STR(media_info.Get(MediaInfoDLL::Stream_Video, 0, __T("Codec"), MediaInfoDLL::Info_Text));
-		entry.mColorSpace = _MI_TO_STR(media_info.Get(MediaInfoDLL::Stream_Video, 0, __T("Colorimetry"), MediaInfoDLL::Info_Text));
-		_MI_TO_VALUE(media_info.Get(MediaInfoDLL::Stream_Video, 0, __T("Duration"), MediaInfoDLL::Info_Text), entry.mDuration);
-	}
-
-	entry.mDuration /= 1000.0f;
-
-	return true;
+	try {
+		Poco::File						f(get_db_directory());
+		if (!f.exists()) f.createDirectories();
+	} catch(std::exception const& ex) {
+		DS_LOG_WARNING("VideoMetaCache couldn't create the cache folder error=" << ex.what());
+		return;
+	}
+
+	sqlite3*							db = open_db(get_db_file(mName));
+	if(!db) return;
+	update_schema(db);
+
+	// Oldest first, so if a path somehow got in twice the newest wins
+	const std::string					select = std::string("SELECT ") + COLUMNS_SZ + " FROM video_meta ORDER BY id";
+	sqlite3_stmt*						s = nullptr;
+	if(sqlite3_prepare_v2(db, select.c_str(), -1, &s, 0) == SQLITE_OK) {
+		while(sqlite3_step(s) == SQLITE_ROW) {
+			const std::string			path(column_text(s, 9));
+			if(path.empty()) continue;
+			Entry						e(path, type_from_db_type(column_text(s, 0)), sqlite3_column_int(s, 1), sqlite3_column_int(s, 2), sqlite3_column_double(s, 3), column_text(s, 4), column_text(s, 5), column_text(s, 6));
+			e.mModified = sqlite3_column_int64(s, 7);
+			e.mFileSize = sqlite3_column_int64(s, 8);
+			mEntries[path] = e;
+		}
+	} else {
+		DS_LOG_WARNING("VideoMetaCache couldn't read " << mName << " error=" << sqlite3_errmsg(db));
+	}
+	sqlite3_finalize(s);
+	sqlite3_close(db);
+}
+
+bool VideoMetaCache::getVideoInfo(Entry& entry) {
+	LockedMediaInfo				holder;
+	MediaInfoDLL::MediaInfo&	media_info(holder.get());
+	if (!media_info.IsReady()) {
+		// Indicates the DLL couldn't be loaded
+		DS_LOG_ERROR("VideoMetaCache::getVideoInfo() MediaInfo not loaded, does dll/MediaInfo.dll exist in the app folder?");
+		return false;
+	}
+	media_info.Open(_STR_TO_MI(entry.mPath));
+
+	size_t numAudio = media_info.Count_Get(MediaInfoDLL::Stream_Audio);
+	size_t numVideo = media_info.Count_Get(MediaInfoDLL::Stream_Video);
+
+	if(numAudio < 1 && numVideo < 1){
+		DS_LOG_WARNING("Couldn't find any audio or video streams in " << entry.mPath);
+		entry.mType = ERROR_TYPE;
+		return false;
+	}
+
+	// If there's an audio channel, get it's codec
+	if(numAudio > 0){
+		entry.mAudioCodec = _MI_TO_STR(media_info.Get(MediaInfoDLL::Stream_Audio, 0, __T("Codec"), MediaInfoDLL::Info_Text));
+
+		DS_LOG_VERBOSE(2, "Number of audio channels: " << _MI_TO_STR(media_info.Get(MediaInfoDLL::Stream_Audio, 0, __T("Channels"), MediaInfoDLL::Info_Text)));
+	}
+
+	// No video streams, but has at least one audio stream is a AUDIO_TYPE
+	if(numAudio > 0 && numVideo < 1){
+		entry.mType = AUDIO_ONLY_TYPE;
+		entry.mWidth = 0;
+		entry.mHeight = 0;
+		if(!_MI_TO_VALUE(media_info.Get(MediaInfoDLL::Stream_Audio, 0, __T("Duration"), MediaInfoDLL::Info_Text), entry.mDuration)) return false;
+
+	// Any number of audio streams and at least one video streams is VIDEO_TYPE
+	} else if(numVideo > 0){
+		if(numAudio > 0){
+			entry.mType = VIDEO_AND_AUDIO_TYPE;
+		} else {
+			entry.mType = VIDEO_ONLY_TYPE;
+		}
+		if(!_MI_TO_VALUE(media_info.Get(MediaInfoDLL::Stream_Video, 0, __T("Width"), MediaInfoDLL::Info_Text), entry.mWidth)) return false;
+		if(!_MI_TO_VALUE(media_info.Get(MediaInfoDLL::Stream_Video, 0, __T("Height"), MediaInfoDLL::Info_Text), entry.mHeight)) return false;
+
+		// We don't check errors on these, cause they're not required by gstreamer to play a video, they're just nice-to-have
+		entry.mVideoCodec = _MI_TO_STR(media_info.Get(MediaInfoDLL::Stream_Video, 0, __T("Codec"), MediaInfoDLL::Info_Text));
+		entry.mColorSpace = _MI_TO_STR(media_info.Get(MediaInfoDLL::Stream_Video, 0, __T("Colorimetry"), MediaInfoDLL::Info_Text));
+		_MI_TO_VALUE(media_info.Get(MediaInfoDLL::Stream_Video, 0, __T("Duration"), MediaInfoDLL::Info_Text), entry.mDuration);
+	}
+
+	entry.mDuration /= 1000.0f;
+
+	return true;
 }
 
 /**
@@ -250,7 +582,9 @@ VideoMetaCache::Entry::Entry()
 	: mType(ERROR_TYPE)
 	, mWidth(0)
 	, mHeight(0)
-	, mDuration(0.0f) {
+	, mDuration(0.0f)
+	, mModified(0)
+	, mFileSize(0) {
 }
 
 VideoMetaCache::Entry::Entry(const std::string& key, const Type t, const int width, const int height, const double duration, const std::string& colorSpace, const std::string& videoCodec, const std::string& audioCodec)
@@ -258,12 +592,14 @@ VideoMetaCache::Entry::Entry(const std::string& key, const Type t, const int wid
 	, mType(t)
 	, mWidth(width)
 	, mHeight(height)
-	, mDuration(duration) 
+	, mDuration(duration)
 	, mAudioCodec(audioCodec)
 	, mVideoCodec(videoCodec)
 	, mColorSpace(colorSpace)
+	, mModified(0)
+	, mFileSize(0)
 {
-}
-
-} // namespace ui
-} // namespace ds
+}
+
+} // namespace ui
+} // namespace ds
@@ -2,12 +2,28 @@
 #ifndef DS_PROJECTS_VIDEO_GSTREAMER_VIDEOMETACACHE_H_
 #define DS_PROJECTS_VIDEO_GSTREAMER_VIDEOMETACACHE_H_
 
-#include <vector>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <Poco/Timestamp.h>
 
 /**
  * \class VideoMetaCache
  * \b Store values for video to be quickly looked up later.
+ * Entries are indexed by path and only used while the file's modified time and size
+ * still match, so replacing a video gets it probed again. Results are written back to
+ * the sqlite file in batches, one transaction each, from a worker thread.
+ *
+ * Probing a new file with MediaInfo can take a long time, so anything that knows which
+ * videos it's going to need should probeAsync() or prescanDirectory() them ahead of
+ * time. Those run on a small pool of worker threads, and the callbacks are called from
+ * update(). Apart from the workers, everything here is for the main thread only.
  */
 namespace ds {
 namespace ui {
@@ -15,28 +31,8 @@ class SpriteEngine;
 
 class VideoMetaCache
 {
-
-private:
-	class Entry;
-
 public:
 	enum Type { ERROR_TYPE, AUDIO_ONLY_TYPE, VIDEO_ONLY_TYPE, VIDEO_AND_AUDIO_TYPE };
-	VideoMetaCache(const std::string& name);
-
-	// responds with true if it had to go get the values
-	bool					getValues(const std::string& videoPath, Type&, int& outWidth, int& outHeight, double& outDuration, std::string& outColorSpace);
-
-protected:
-	void					setValues(Entry&);
-
-private:
-	void					load();
-
-
-	VideoMetaCache(const VideoMetaCache&);
-	VideoMetaCache&			operator=(const VideoMetaCache&);
-
-
 
 	class Entry {
 	public:
@@ -51,12 +47,86 @@ private:
 		std::string			mColorSpace;
 		std::string			mVideoCodec;
 		std::string			mAudioCodec;
+		// Of the file when it was probed, both 0 for anything that isn't a local file
+		int64_t				mModified;
+		int64_t				mFileSize;
 	};
-	const std::string		mName;
-	std::vector<Entry>		mEntries;
 
+	/// Called with the probe results. mType is ERROR_TYPE if the file couldn't be probed.
+	typedef std::function<void(const Entry&)>	ProbeCallback;
+	typedef int									RequestId;
+
+	/// numThreads is the most probes that run at once. The threads are only started
+	/// the first time something is probed asynchronously.
+	VideoMetaCache(const std::string& name, const int numThreads = 2);
+	~VideoMetaCache();
+
+	// responds with true if it had to go get the values
+	bool					getValues(const std::string& videoPath, Type&, int& outWidth, int& outHeight, double& outDuration, std::string& outColorSpace);
+	/// True if there are values for the file as it is now, so getValues() won't block
+	bool					hasValues(const std::string& videoPath);
+
+	/// Probe a file on a worker thread. If it's already cached the callback is called right
+	/// away and this answers 0, otherwise the callback is called from update() once the probe
+	/// is done. Requests for a file that's already being probed share the one probe.
+	RequestId				probeAsync(const std::string& videoPath, const ProbeCallback& = nullptr);
+	/// The callback won't be called. The probe still finishes and is cached.
+	void					cancelProbe(const RequestId);
+	/// Queue a probe for every video and audio file in the directory that isn't cached.
+	/// Answers the number of probes queued.
+	size_t					prescanDirectory(const std::string& directory, const bool recursive = true, const ProbeCallback& = nullptr);
+	/// Files queued or being probed
+	size_t					getPendingCount() const { return mInFlight.size(); }
+
+	/// Delivers finished probes and starts a write-back. Main thread, every frame.
+	void					update();
+	/// Write anything that hasn't been saved yet, on this thread
+	void					flush();
+
+protected:
+	void					setValues(Entry&);
+
+private:
+	void					load();
 
-	bool					getVideoInfo(Entry&);
+	VideoMetaCache(const VideoMetaCache&);
+	VideoMetaCache&			operator=(const VideoMetaCache&);
+
+	// The entry for the file as it is now, or nullptr
+	Entry*					findCurrent(const std::string& videoPath);
+	void					queueProbe(const std::string& videoPath);
+	void					startWorkers();
+	void					runWorker();
+	void					writeEntries(const std::vector<Entry>&);
+
+	static bool				getVideoInfo(Entry&);
+
+	const std::string		mName;
+	const int				mNumThreads;
+	std::unordered_map<std::string, Entry>
+							mEntries;
+
+	// Main thread only. Paths queued or probing, and the requests waiting on each.
+	std::unordered_map<std::string, std::vector<RequestId>>
+							mInFlight;
+	std::unordered_map<RequestId, ProbeCallback>
+							mCallbacks;
+	RequestId				mNextRequestId;
+	Poco::Timestamp			mLastWrite;
+
+	// Shared with the workers
+	std::mutex				mMutex;
+	std::condition_variable	mCondition;
+	std::deque<std::string>	mQueue;
+	std::vector<Entry>		mDone;
+	std::vector<Entry>		mUnsaved;
+	bool					mWriteRequested;
+	bool					mStopping;
+	// Only one write-back at a time
+	std::mutex				mWriteMutex;
+
+	std::vector<std::thread>
+							mWorkers;
 };
 
 } // namespace ui
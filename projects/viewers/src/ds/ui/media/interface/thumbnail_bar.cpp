@@ -7,6 +7,7 @@
 #include <ds/app/environment.h>
 #include <ds/ui/sprite/sprite_engine.h>
 #include <ds/ui/sprite/image.h>
+#include <ds/ui/sprite/image_with_thumbnail.h>
 #include <ds/debug/logger.h>
 #include <ds/util/string_util.h>
 #include <ds/ui/util/ui_utils.h>
@@ -59,7 +60,10 @@ ThumbnailBar::ThumbnailBar(ds::ui::SpriteEngine& se)
 	});
 
 	mFileList->setCreateItemCallback([this]()->ds::ui::Sprite* {
-		return new ds::ui::Image(mEngine);
+		// Items are small, so load the cached thumbnail levels rather than the full images when there are any
+		auto img = new ds::ui::ImageWithThumbnail(mEngine);
+		img->setUseThumbnailLevels(true);
+		return img;
 	});
 
 	mFileList->setDataCallback([this](ds::ui::Sprite* bs, int dbId){
@@ -18,6 +18,7 @@
 #include <ds/util/string_util.h>
 #include "private/web_service.h"
 #include "private/web_callbacks.h"
+#include "private/web_paint_buffer.h"
 
 
 #include "include/cef_app.h"
@@ -84,8 +85,8 @@ Web::Web( ds::ui::SpriteEngine &engine, float width, float height )
 	, mHasError(false)
 	, mAllowClicks(true)
 	, mBrowserId(-1)
-	, mBuffer(nullptr)
-	, mHasBuffer(false)
+	, mPaintBuffer(new ds::web::WebPaintBuffer())
+	, mUsePixelBuffer(engine.getSettings("engine").getBool("web:pixel_buffer_upload", 0, false))
 	, mBrowserSize(0, 0)
 	, mPopupBuffer(nullptr)
 	, mPopupShowing(false)
@@ -183,11 +184,6 @@ Web::~Web() {
 	{
 		// I don't think we'll need to lock this anymore, as the previous call to clear will prevent any callbacks
 	//	std::lock_guard<std::mutex> lock(mMutex);
-		if(mBuffer){
-			delete mBuffer;
-			mBuffer = nullptr;
-		}
-
 		if(mPopupBuffer) {
 			delete mPopupBuffer;
 			mPopupBuffer = nullptr;
@@ -212,7 +208,7 @@ void Web::initializeBrowser(){
 	mNeedsInitialized = false;
 
 	// Now that we know about the browser, set it to the correct size
-	if(!mBuffer){
+	if(!mPaintBuffer->hasSize()){
 		onSizeChanged();
 	} else {
 		mService.requestBrowserResize(mBrowserId, mBrowserSize);
@@ -264,18 +260,10 @@ void Web::initializeBrowser(){
 		}
 	};
 
-	wcc.mPaintCallback = [this](const void * buffer, const int bufferWidth, const int bufferHeight){
-
+	wcc.mPaintCallback = [this](const void * buffer, const int bufferWidth, const int bufferHeight, const std::vector<ci::Area>& dirtyRects){
 		// This callback comes back from the CEF UI thread
-		std::lock_guard<std::mutex> lock(mMutex);
-
-		// verify the buffer exists and is the correct size
-		// TODO: Add ability to redraw only the changed rectangles (which is what comes from CEF)
-		// Would be much more performant, especially for large browsers with small ui changes (like blinking cursors)
-		if(mBuffer && bufferWidth == mBrowserSize.x && bufferHeight == mBrowserSize.y){
-			mHasBuffer = true;
-			memcpy(mBuffer, buffer, bufferWidth * bufferHeight * 4);
-		}
+		// The paint buffer locks itself and ignores frames that aren't the current size
+		mPaintBuffer->paint(buffer, bufferWidth, bufferHeight, dirtyRects);
 	};
 
 	wcc.mPopupPaintCallback = [this](const void * buffer, const int bufferWidth, const int bufferHeight) {
@@ -445,19 +433,12 @@ void Web::update(const ds::UpdateParams &p) {
 		setZoom(mZoom);
 	}
 
-	// Anything that modifies mBuffer needs to be locked
-	std::lock_guard<std::mutex> lock(mMutex);
-
-	if(mBuffer && mHasBuffer) {
-		DS_LOG_VERBOSE(5, "Web: creating draw texture " << mUrl);
-
-		ci::gl::Texture::Format fmt;
-		fmt.setMinFilter(GL_LINEAR);
-		fmt.setMagFilter(GL_LINEAR);
-		mWebTexture = ci::gl::Texture::create(mBuffer, GL_BGRA, mBrowserSize.x, mBrowserSize.y, fmt);
-		mHasBuffer = false;
+	if(mPaintBuffer->swap(mDirtyAreas)) {
+		uploadWebTexture();
 	}
 
+	// Anything that modifies the popup buffer needs to be locked
+	std::lock_guard<std::mutex> lock(mMutex);
 
 	if(mPopupBuffer && mHasPopupBuffer) {
 		DS_LOG_VERBOSE(5, "Web: creating popup draw texture " << mUrl);
@@ -474,26 +455,19 @@ void Web::update(const ds::UpdateParams &p) {
 
 void Web::onSizeChanged() {
 	{
-		// Anything that modifies mBuffer needs to be locked
 		std::lock_guard<std::mutex> lock(mMutex);
 
 		const int theWid = static_cast<int>(getWidth());
 		const int theHid = static_cast<int>(getHeight());
 		const ci::ivec2 newBrowserSize(theWid, theHid);
-		if(newBrowserSize == mBrowserSize && mBuffer){
+		if(newBrowserSize == mBrowserSize && mPaintBuffer->hasSize()){
 			return;
 		}
 
 		mBrowserSize = newBrowserSize;
 
-		if(mBuffer){
-			delete mBuffer;
-			mBuffer = nullptr;
-		}
-		const int bufferSize = theWid * theHid * 4;
-		mBuffer = new unsigned char[bufferSize];
-
-		mHasBuffer = false;
+		// Paints at the old size are dropped from here on, and the texture is remade on the next one
+		mPaintBuffer->resize(theWid, theHid);
 	}
 
 	DS_LOG_VERBOSE(4, "Web: changed size " << getSize() << " url=" << mUrl);
@@ -503,6 +477,76 @@ void Web::onSizeChanged() {
 	}
 }
 
+void Web::uploadWebTexture() {
+	const unsigned char* front = mPaintBuffer->getFront();
+	const int theWid = mPaintBuffer->getWidth();
+	const int theHid = mPaintBuffer->getHeight();
+	if(!front || theWid < 1 || theHid < 1) return;
+
+	// New or resized, so upload the whole thing
+	if(!mWebTexture || mWebTexture->getWidth() != theWid || mWebTexture->getHeight() != theHid) {
+		DS_LOG_VERBOSE(5, "Web: creating draw texture " << mUrl);
+
+		ci::gl::Texture::Format fmt;
+		fmt.setMinFilter(GL_LINEAR);
+		fmt.setMagFilter(GL_LINEAR);
+		mWebTexture = ci::gl::Texture::create(front, GL_BGRA, theWid, theHid, fmt);
+		return;
+	}
+
+	DS_LOG_VERBOSE(6, "Web: updating " << mDirtyAreas.size() << " areas of the draw texture " << mUrl);
+
+	ci::gl::ScopedTextureBind scopedTexture(mWebTexture);
+
+	if(mUsePixelBuffer) {
+		// Pack the areas into a pixel buffer, so the driver can copy it to the texture without stalling this thread
+		size_t totalBytes = 0;
+		for(auto& it : mDirtyAreas) {
+			totalBytes += static_cast<size_t>(it.calcArea()) * 4;
+		}
+
+		if(!mUploadPbo || static_cast<size_t>(mUploadPbo->getSize()) < totalBytes) {
+			mUploadPbo = ci::gl::Pbo::create(GL_PIXEL_UNPACK_BUFFER, totalBytes, nullptr, GL_STREAM_DRAW);
+		}
+
+		bool uploaded = false;
+		{
+			ci::gl::ScopedBuffer scopedPbo(mUploadPbo);
+			// Orphan the last upload's storage rather than waiting for it
+			mUploadPbo->bufferData(mUploadPbo->getSize(), nullptr, GL_STREAM_DRAW);
+			unsigned char* dst = static_cast<unsigned char*>(mUploadPbo->mapBufferRange(0, totalBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+			if(dst) {
+				size_t offset = 0;
+				for(auto& it : mDirtyAreas) {
+					ds::web::WebPaintBuffer::packArea(front, theWid, it, dst + offset);
+					offset += static_cast<size_t>(it.calcArea()) * 4;
+				}
+				mUploadPbo->unmap();
+
+				// With a pixel buffer bound, the data pointer is an offset into it
+				offset = 0;
+				for(auto& it : mDirtyAreas) {
+					glTexSubImage2D(mWebTexture->getTarget(), 0, it.x1, it.y1, it.getWidth(), it.getHeight(), GL_BGRA, GL_UNSIGNED_BYTE, reinterpret_cast<const void*>(offset));
+					offset += static_cast<size_t>(it.calcArea()) * 4;
+				}
+				uploaded = true;
+			}
+		}
+		if(uploaded) return;
+
+		DS_LOG_WARNING("Web: couldn't map the pixel buffer, uploading directly from now on");
+		mUsePixelBuffer = false;
+	}
+
+	// Upload straight out of the front buffer, which is a full frame wide
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, theWid);
+	for(auto& it : mDirtyAreas) {
+		const size_t start = (static_cast<size_t>(it.y1) * theWid + it.x1) * 4;
+		glTexSubImage2D(mWebTexture->getTarget(), 0, it.x1, it.y1, it.getWidth(), it.getHeight(), GL_BGRA, GL_UNSIGNED_BYTE, front + start);
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
 void Web::drawLocalClient() {
 	if(mWebTexture) {
 
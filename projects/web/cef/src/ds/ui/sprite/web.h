@@ -4,15 +4,18 @@
 
 #include <cinder/app/KeyEvent.h>
 #include <cinder/app/MouseEvent.h>
+#include <cinder/gl/Pbo.h>
 #include <ds/ui/soft_keyboard/entry_field.h>
 #include "ds/ui/sprite/text.h"
 
+#include <memory>
 #include <mutex>
 #include <thread>
 
 namespace ds {
 namespace web {
 	class WebCefService;
+	class WebPaintBuffer;
 }
 
 namespace ui {
@@ -232,10 +235,15 @@ private:
 	ds::web::WebCefService&						mService;
 
 	int											mBrowserId;
-	unsigned char *								mBuffer;
-	bool										mHasBuffer;
+	// Only the parts of the page that changed are copied out of CEF and uploaded to the texture
+	std::unique_ptr<ds::web::WebPaintBuffer>	mPaintBuffer;
+	std::vector<ci::Area>						mDirtyAreas;
 	ci::ivec2									mBrowserSize; // basically the w/h of this sprite, but tracked so we only recreate the buffer when needed
 	ci::gl::TextureRef							mWebTexture;
+	// web:pixel_buffer_upload in engine settings, uploads changed areas through mUploadPbo
+	bool										mUsePixelBuffer;
+	ci::gl::PboRef								mUploadPbo;
+	void										uploadWebTexture();
 	bool										mTransparentBackground;
 
 	unsigned char *								mPopupBuffer;
@@ -3,6 +3,8 @@
 #define PRIVATE_CEF_WEB_CALLBACKS_H
 
 #include <functional>
+#include <vector>
+#include <cinder/Area.h>
 
 namespace ds {
 class Engine;
@@ -18,7 +20,8 @@ public:
 	WebCefCallbacks(){};
 
 	// Gets called when the browser sends new paint info, aka new buffers
-	std::function<void(const void *, const int, const int)> mPaintCallback;
+	// The buffer is always the whole view, the areas are the parts of it that changed
+	std::function<void(const void *, const int, const int, const std::vector<ci::Area>&)> mPaintCallback;
 
 	// Popups here are most commonly HTML select elements (drop down menus)
 	std::function<void(const void *, const int, const int)> mPopupPaintCallback;
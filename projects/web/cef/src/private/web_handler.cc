@@ -380,8 +380,6 @@ void WebHandler::OnPaint(CefRefPtr<CefBrowser> browser,
 	// be sure this is locked with other requests to the browser list
 	base::AutoLock lock_scope(mLock);
 
-	//TODO: Handle dirty rects
-
 	int browserId = browser->GetIdentifier();
 
 	//std::cout << "OnPaint, " << browserId << " type: " << type << " " << width << " " << height << std::endl;
@@ -390,7 +388,12 @@ void WebHandler::OnPaint(CefRefPtr<CefBrowser> browser,
 	if(findy != mWebCallbacks.end()){
 		if(type == PaintElementType::PET_VIEW) {
 			if(findy->second.mPaintCallback) {
-				findy->second.mPaintCallback(buffer, width, height);
+				std::vector<ci::Area> dirtyAreas;
+				dirtyAreas.reserve(dirtyRects.size());
+				for(auto& it : dirtyRects) {
+					dirtyAreas.push_back(ci::Area(it.x, it.y, it.x + it.width, it.y + it.height));
+				}
+				findy->second.mPaintCallback(buffer, width, height, dirtyAreas);
 			}
 		} else if(type == PaintElementType::PET_POPUP) {
 			if(findy->second.mPopupPaintCallback) {
@@ -0,0 +1,161 @@
+#include "stdafx.h"
+
+#include "private/web_paint_buffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ds {
+namespace web {
+
+namespace {
+const int				BYTES_PER_PIXEL = 4;
+
+bool overlaps(const ci::Area& a, const ci::Area& b) {
+	return a.x1 < b.x2 && b.x1 < a.x2 && a.y1 < b.y2 && b.y1 < a.y2;
+}
+
+}
+
+/**
+ * \class ds::web::WebPaintBuffer
+ */
+WebPaintBuffer::WebPaintBuffer()
+	: mWidth(0)
+	, mHeight(0)
+	, mHasSize(false)
+	, mNeedsFull(true)
+	, mPainting(0)
+	, mReady(1)
+	, mFront(2)
+{
+}
+
+void WebPaintBuffer::resize(const int width, const int height) {
+	std::lock_guard<std::mutex> paintLock(mPaintMutex);
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	mWidth = std::max(0, width);
+	mHeight = std::max(0, height);
+	mHasSize = true;
+	mNeedsFull = true;
+	mDirty.clear();
+
+	const size_t bufferSize = static_cast<size_t>(mWidth) * mHeight * BYTES_PER_PIXEL;
+	for(int i = 0; i < FRAMES; ++i) {
+		mFrames[i].assign(bufferSize, 0);
+		mBehind[i].clear();
+	}
+}
+
+void WebPaintBuffer::paint(const void* buffer, const int width, const int height, const std::vector<ci::Area>& dirty) {
+	if(!buffer) return;
+
+	// Only resize() competes for this one, swap() never waits on the copy
+	std::lock_guard<std::mutex> paintLock(mPaintMutex);
+	std::vector<unsigned char>&	frame = mFrames[mPainting];
+	if(width != mWidth || height != mHeight || frame.empty()) return;
+
+	const ci::Area			bounds(0, 0, mWidth, mHeight);
+	const unsigned char*	src = static_cast<const unsigned char*>(buffer);
+	std::vector<ci::Area>	changed;
+	if(mNeedsFull || dirty.empty()) {
+		mNeedsFull = false;
+		memcpy(frame.data(), src, frame.size());
+		changed.push_back(bounds);
+	} else {
+		for(auto& it : dirty) {
+			addDirty(changed, it, bounds);
+		}
+		if(changed.empty()) return;
+
+		// What changed now, and what changed while this frame was the ready or front one
+		std::vector<ci::Area>	copies(mBehind[mPainting]);
+		for(auto& it : changed) {
+			addDirty(copies, it, bounds);
+		}
+		for(auto& it : copies) {
+			copyArea(src, frame.data(), mWidth, it);
+		}
+	}
+	mBehind[mPainting].clear();
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	for(auto& it : changed) {
+		addDirty(mBehind[mReady], it, bounds);
+		addDirty(mBehind[mFront], it, bounds);
+		addDirty(mDirty, it, bounds);
+	}
+	std::swap(mPainting, mReady);
+}
+
+bool WebPaintBuffer::swap(std::vector<ci::Area>& outDirty) {
+	outDirty.clear();
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	if(mDirty.empty()) return false;
+
+	std::swap(mFront, mReady);
+	outDirty.swap(mDirty);
+	return true;
+}
+
+void WebPaintBuffer::addDirty(std::vector<ci::Area>& list, const ci::Area& area, const ci::Area& bounds, const size_t maxRects) {
+	ci::Area				merged(area);
+	merged.clipBy(bounds);
+	if(merged.getWidth() < 1 || merged.getHeight() < 1) return;
+
+	// Keep merging until it doesn't overlap anything, since growing it can make it overlap more
+	for(bool found = true; found; ) {
+		found = false;
+		for(auto it = list.begin(); it != list.end(); ++it) {
+			if(overlaps(*it, merged)) {
+				merged.include(*it);
+				list.erase(it);
+				found = true;
+				break;
+			}
+		}
+	}
+	list.push_back(merged);
+
+	if(list.size() > maxRects) {
+		ci::Area			all(list.front());
+		for(auto& it : list) {
+			all.include(it);
+		}
+		list.clear();
+		list.push_back(all);
+	}
+}
+
+void WebPaintBuffer::copyArea(const unsigned char* src, unsigned char* dst, const int width, const ci::Area& area) {
+	const size_t			stride = static_cast<size_t>(width) * BYTES_PER_PIXEL;
+	const size_t			start = static_cast<size_t>(area.y1) * stride + static_cast<size_t>(area.x1) * BYTES_PER_PIXEL;
+
+	// Full rows are one block
+	if(area.x1 == 0 && area.x2 == width) {
+		memcpy(dst + start, src + start, stride * area.getHeight());
+		return;
+	}
+
+	const size_t			rowBytes = static_cast<size_t>(area.getWidth()) * BYTES_PER_PIXEL;
+	for(int y = 0; y < area.getHeight(); ++y) {
+		const size_t		offset = start + y * stride;
+		memcpy(dst + offset, src + offset, rowBytes);
+	}
+}
+
+void WebPaintBuffer::packArea(const unsigned char* src, const int width, const ci::Area& area, unsigned char* dst) {
+	const size_t			stride = static_cast<size_t>(width) * BYTES_PER_PIXEL;
+	const size_t			rowBytes = static_cast<size_t>(area.getWidth()) * BYTES_PER_PIXEL;
+	const unsigned char*	row = src + static_cast<size_t>(area.y1) * stride + static_cast<size_t>(area.x1) * BYTES_PER_PIXEL;
+	for(int y = 0; y < area.getHeight(); ++y) {
+		memcpy(dst, row, rowBytes);
+		dst += rowBytes;
+		row += stride;
+	}
+}
+
+} // namespace web
+} // namespace ds
@@ -0,0 +1,81 @@
+#pragma once
+#ifndef PRIVATE_CEF_WEB_PAINT_BUFFER_H
+#define PRIVATE_CEF_WEB_PAINT_BUFFER_H
+
+#include <mutex>
+#include <vector>
+#include <cinder/Area.h>
+
+namespace ds {
+namespace web {
+
+/**
+* \class ds::web::WebPaintBuffer
+* \brief Hands BGRA frames from the CEF UI thread to the main thread, copying only what changed.
+*		 Three whole frames: CEF paints into one it owns, then trades it for the ready one, and the
+*		 main thread's swap() trades the ready one for its front. Only those trades are locked, the
+*		 copies aren't, so neither thread waits on the other's copy. Each frame remembers the areas
+*		 it's behind by, so a paint brings the frame it's given fully up to date from CEF's buffer,
+*		 and swap() answers every area that changed since the last one, which is all it needs to
+*		 upload. Nothing in here touches GL or CEF.
+*/
+class WebPaintBuffer {
+public:
+	static const size_t			MAX_DIRTY_RECTS = 8;
+
+	WebPaintBuffer();
+
+	/// Main thread. Reallocates the frames and drops anything pending, so the first paint
+	/// after this is copied whole. Waits for a paint in progress.
+	void						resize(const int width, const int height);
+	/// True once resize() has been called
+	bool						hasSize() const { return mHasSize; }
+	int							getWidth() const { return mWidth; }
+	int							getHeight() const { return mHeight; }
+
+	/// CEF UI thread. buffer is the whole frame, only the dirty areas of it are copied.
+	/// Frames that don't match the size are ignored, they're from before a resize.
+	void						paint(const void* buffer, const int width, const int height, const std::vector<ci::Area>& dirty);
+
+	/// Main thread. Makes the latest paint the front frame and answers the areas that changed
+	/// since the last swap. False if nothing did. Copies nothing.
+	bool						swap(std::vector<ci::Area>& outDirty);
+	/// The frame as of the last swap(), width * height * 4 bytes
+	const unsigned char*		getFront() const { return mFrames[mFront].empty() ? nullptr : mFrames[mFront].data(); }
+
+	/// Add an area to a dirty list, merged with any it overlaps and clipped to bounds.
+	/// More than maxRects are collapsed into the one area that covers them all.
+	static void					addDirty(std::vector<ci::Area>&, const ci::Area&, const ci::Area& bounds, const size_t maxRects = MAX_DIRTY_RECTS);
+	/// Copy an area between two frames that are both width * 4 bytes a row
+	static void					copyArea(const unsigned char* src, unsigned char* dst, const int width, const ci::Area&);
+	/// Copy an area out of a frame that's width * 4 bytes a row, to rows of just the area's width
+	static void					packArea(const unsigned char* src, const int width, const ci::Area&, unsigned char* dst);
+
+private:
+	static const int			FRAMES = 3;
+
+	// Held by paint() the whole time, and by resize(), so the frames aren't reallocated under a copy
+	std::mutex					mPaintMutex;
+	// Held while frames are traded
+	std::mutex					mMutex;
+	int							mWidth;
+	int							mHeight;
+	bool						mHasSize;
+	// Set by resize(), the first paint after it is copied whole
+	bool						mNeedsFull;
+
+	std::vector<unsigned char>	mFrames[FRAMES];
+	// The areas each frame is behind the latest paint by
+	std::vector<ci::Area>		mBehind[FRAMES];
+	// Which frame is which. Painting is only changed by the CEF thread and front by the main thread.
+	int							mPainting;
+	int							mReady;
+	int							mFront;
+	// Changed since the last swap()
+	std::vector<ci::Area>		mDirty;
+};
+
+} // namespace web
+} // namespace ds
+
+#endif // PRIVATE_CEF_WEB_PAINT_BUFFER_H
@@ -25,6 +25,7 @@ if( NOT TARGET web )
 		${WEB_SRC_PATH}/ds/ui/sprite/web.cpp
 		${WEB_SRC_PATH}/private/web_app.cc
 		${WEB_SRC_PATH}/private/web_handler.cc
+		${WEB_SRC_PATH}/private/web_paint_buffer.cpp
 	)
 
 	add_library( web ${WEB_SRC_FILES} )
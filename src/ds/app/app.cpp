@@ -2,6 +2,8 @@
 
 #include "ds/app/app.h"
 
+#include <cstdio>
+#include <cstdlib>
 #include <Poco/File.h>
 #include <Poco/Path.h>
 
@@ -14,6 +16,7 @@
 #include "ds/app/environment.h"
 #include "ds/debug/logger.h"
 #include "ds/debug/debug_defines.h"
+#include "ds/debug/frame_profiler.h"
 
 // For installing the sprite types
 #include "ds/app/engine/engine_stats_view.h"
@@ -92,6 +95,19 @@ static std::vector<std::function<void(ds::Engine&)>>& get_setups() {
 namespace {
 std::string				APP_DATA_PATH;
 
+// Set by App::quitWithExitCode(), -1 to leave it to Cinder. Cinder's main() always answers 0,
+// so once main() has returned and everything registered at exit after this has run, leave with it.
+int						EXIT_CODE = -1;
+
+void					exit_with_code() {
+	if(EXIT_CODE < 0) return;
+	std::fflush(nullptr);
+	std::_Exit(EXIT_CODE);
+}
+
+// Registered while statics are initialized, so it's about the last thing to run at exit
+const int				EXIT_REGISTERED = std::atexit(exit_with_code);
+
 void					add_dll_path() {
 	// If there's a DLL folder, then add it to my PATH environment variable.
 	try {
@@ -295,6 +311,9 @@ void App::preServerSetup() {
 }
 
 void App::update() {
+	ds::debug::FrameProfiler::get().endFrame();
+	DS_PROFILE_ZONE("update");
+
 #ifdef _WIN32
 	if(mEngine.getSettings("engine").getBool("system:never_sleep", 0, true)) {
 		// prevents the system from going to sleep
@@ -324,6 +343,7 @@ void App::update() {
 }
 
 void App::draw() {
+	DS_PROFILE_ZONE("app_draw");
 	mEngine.draw();
 }
 void App::mouseDown(ci::app::MouseEvent e) {
@@ -441,6 +461,7 @@ void App::setupKeyPresses() {
 	mKeyManager.registerKey("Toggle console", [this] {mEngine.toggleConsole(); }, KeyEvent::KEY_c);
 	mKeyManager.registerKey("Touch mode", [this] {mEngine.nextTouchMode(); }, KeyEvent::KEY_t);
 	mKeyManager.registerKey("Take screenshot", [this] {saveTransparentScreenshot(); }, KeyEvent::KEY_F8);
+	mKeyManager.registerKey("Dump frame profiler trace", [this] { ds::debug::FrameProfiler::get().dumpTrace(); }, KeyEvent::KEY_F9);
 	mKeyManager.registerKey("Kill supporting apps", [this] { killSupportingApps(); }, KeyEvent::KEY_k, false, true);
 	mKeyManager.registerKey("Toggle mouse", [this] { mEngine.setHideMouse(!mEngine.getHideMouse()); }, KeyEvent::KEY_m);
 	mKeyManager.registerKey("Verbose logging toggle", [this] { if(ds::getLogger().getVerboseLevel() > 0) ds::getLogger().setVerboseLevel(0); else ds::getLogger().setVerboseLevel(9); }, KeyEvent::KEY_v);
@@ -521,6 +542,11 @@ void App::shutdown(){
 	quit();
 }
 
+void App::quitWithExitCode(const int code){
+	EXIT_CODE = code;
+	quit();
+}
+
 /**
  * \class ds::EngineSettingsPreloader::Initializer
  */
@@ -116,6 +116,9 @@ public:
 	virtual void				draw();
 	virtual void				quit();
 	virtual void				shutdown();
+	/// Quit, and once the app has shut down and the log is flushed, end the process with
+	/// code. For unattended runs where something checks the result.
+	void						quitWithExitCode(const int code);
 
 	// Triggered by F8 key, saves a transparent png on the desktop
 	void						saveTransparentScreenshot();
@@ -25,6 +25,7 @@ class BlobRegistry {
     friend class EngineClient;
     friend class EngineServer;
     friend class EngineReceiver;
+    friend class ReplicationPlayer;
     std::vector<std::function<void(BlobReader&)>>
                       mReader;
 };
@@ -15,14 +15,18 @@
 #include "ds/debug/console.h"
 #endif
 #include "ds/debug/debug_defines.h"
+#include "ds/debug/frame_profiler.h"
 #include "ds/debug/logger.h"
 #include "ds/math/math_defs.h"
 #include "ds/metrics/metrics_service.h"
 #include "ds/ui/ip/ip_defs.h"
 #include "ds/ui/ip/functions/ip_circle_mask.h"
+#include "ds/ui/ip/functions/ip_kernels.h"
 #include "ds/ui/touch/draw_touch_view.h"
 #include "ds/ui/touch/touch_event.h"
+#include "ds/ui/touch/tuio_ingest.h"
 #include "ds/util/file_meta_data.h"
+#include "ds/util/image_meta_data.h"
 
 #include <cinder/Display.h>
 #include <boost/algorithm/string.hpp>
@@ -64,6 +68,7 @@ Engine::Engine(ds::App& app, ds::EngineSettings &settings,
 	, mTouchMode(ds::ui::TouchMode::kTuioAndMouse)
 	, mTouchManager(*this, mTouchMode)
 	, mPangoFontService(*this)
+	, mShaderService(*this)
 	, mSettings(settings)
 	, mSettingsEditor(nullptr)
 	, mTouchBeginEvents(mTouchMutex,	mLastTouchTime,  [&app, this](const ds::ui::TouchEvent& e) {app.onTouchesBegan(e); this->mTouchManager.touchesBegin(e);}, "touchbegin")
@@ -99,6 +104,11 @@ Engine::Engine(ds::App& app, ds::EngineSettings &settings,
 	// so lightweight it probably makes sense just to have them always available for clients instead
 	// of requiring some sort of configuration.
 	mIpFunctions.add(ds::ui::ip::CIRCLE_MASK, ds::ui::ip::FunctionRef(new ds::ui::ip::CircleMask()));
+	mIpFunctions.add(ds::ui::ip::ROUNDED_MASK, ds::ui::ip::FunctionRef(new ds::ui::ip::KernelFunction("rounded_mask")));
+	mIpFunctions.add(ds::ui::ip::DESATURATE, ds::ui::ip::FunctionRef(new ds::ui::ip::KernelFunction("desaturate")));
+	mIpFunctions.add(ds::ui::ip::BLUR, ds::ui::ip::FunctionRef(new ds::ui::ip::KernelFunction("blur")));
+	mIpFunctions.add(ds::ui::ip::RESIZE_TO_FIT, ds::ui::ip::FunctionRef(new ds::ui::ip::KernelFunction("resize_to_fit")));
+	mIpFunctions.add(ds::ui::ip::PIPELINE, ds::ui::ip::FunctionRef(new ds::ui::ip::PipelineFunction()));
 
 	if (mAutoDraw) addService("AUTODRAW", *mAutoDraw);
 
@@ -106,11 +116,22 @@ Engine::Engine(ds::App& app, ds::EngineSettings &settings,
 
 Engine::~Engine() {
 	mTuio.disconnect();
+	if(mTuioIngest) mTuioIngest->stop();
+	mIoReactor.stop();
+
+	// Sends anything still queued and stops the flush thread
+	if(mMetricsService) {
+		delete mMetricsService;
+		mMetricsService = nullptr;
+	}
 
 	// Important to do this here before the auto update list is destructed.
 	// so any autoupdate services get removed.
 	mData.clearServices();
 
+	// The logger is still up here, it isn't by the time statics are destroyed
+	ds::ImageMetaData::saveIndex();
+
 	hideConsole();
 }
 
@@ -248,8 +269,8 @@ void Engine::setupResourceLocation() {
 
 
 	mData.mCmsURL = mSettings.getString("cms:url");
-	if(mData.mCmsURL.empty() || mData.mCmsURL == "DS_BASEURL") {
-		auto _env_var_ptr = std::getenv("DS_BASEURL");
+	if(mData.mCmsURL.empty() || mData.mCmsURL == "DS_BASEURL") {
+		auto _env_var_ptr = std::getenv("DS_BASEURL");
 		mData.mCmsURL = std::string{ _env_var_ptr == nullptr ? "" : _env_var_ptr };
 		if(mData.mCmsURL.empty()) {
 			DS_LOG_VERBOSE(1, "cms:url and DS_BASEURL are both not defined. Only a problem if this app relies on Engine::getCmsURL()");
@@ -473,8 +494,14 @@ bool Engine::isShowingSettingsEditor(){
 void Engine::setup(ds::App& app) {
 
 	mCinderWindow = app.getWindow();
+
+	// Needs the GL context, which exists by now
+	mShaderService.start();
 	//mCinderWindow->spanAllDisplays
 
+	ds::debug::FrameProfiler::setEnabled(mSettings.getBool("profiler:enabled", 0, true));
+	ds::debug::FrameProfiler::get().installSignalHandler();
+
 	mTouchTranslator.setTranslation(mData.mSrcRect.x1, mData.mSrcRect.y1);
 	mTouchTranslator.setScale(mData.mSrcRect.getWidth() / ci::app::getWindowWidth(), mData.mSrcRect.getHeight() / ci::app::getWindowHeight());
 
@@ -550,7 +577,23 @@ void Engine::setupTouch(ds::App& app) {
 	mTuioPort = mSettings.getInt("touch:tuio:port");
 	// don't lose idle just because we got a marker moved event
 	mTuioObjectsMoved.setAutoIdleReset(false);
-	if(ds::ui::TouchMode::hasTuio(mTouchMode)) {
+	// The batched ingest only handles cursors, so apps that want objects keep the regular client
+	const bool batchedTuio = mSettings.getBool("touch:tuio:batched_ingest") && !mSettings.getBool("touch:tuio:receive_objects");
+	if(ds::ui::TouchMode::hasTuio(mTouchMode) && batchedTuio) {
+		if(!mTuioIngest) mTuioIngest.reset(new ds::ui::TuioIngest());
+		if(!mTuioIngest->isRunning() || oldTuioPort != mTuioPort) {
+			if(mTuioIngest->start(mTuioPort)) {
+				DS_LOG_INFO("TUIO batched ingest listening on port " << mTuioPort);
+			} else {
+				DS_LOG_WARNING("TUIO batched ingest could not be started on port " << mTuioPort << ". The most common cause is that the port is already bound by another app.");
+			}
+		}
+	} else if(mTuioIngest && mTuioIngest->isRunning()) {
+		mTuioIngest->stop();
+		DS_LOG_INFO("TUIO batched ingest stopped");
+	}
+
+	if(ds::ui::TouchMode::hasTuio(mTouchMode) && !batchedTuio) {
 		if(!mTuioRegistered){
 			ci::tuio::Client&		tuioClient = getTuioClient();
 			mTuioBeganRegistrationId = tuioClient.registerTouchesBegan(&app, &ds::App::touchesBegan);
@@ -787,23 +830,43 @@ void Engine::updateClient() {
 	checkIdle();
 
 	{
-		std::lock_guard<std::mutex> lock(mTouchMutex);
-		mMouseBeginEvents.lockedUpdate();
-		mMouseMovedEvents.lockedUpdate();
-		mMouseEndedEvents.lockedUpdate();
-	}
+		DS_PROFILE_ZONE("touch_queues");
+		{
+			std::lock_guard<std::mutex> lock(mTouchMutex);
+			mMouseBeginEvents.lockedUpdate();
+			mMouseMovedEvents.lockedUpdate();
+			mMouseEndedEvents.lockedUpdate();
+		}
 
-	mMouseBeginEvents.update(curr);
-	mMouseMovedEvents.update(curr);
-	mMouseEndedEvents.update(curr);
+		mMouseBeginEvents.update(curr);
+		mMouseMovedEvents.update(curr);
+		mMouseEndedEvents.update(curr);
+	}
 
+	mShaderService.update();
 	mUpdateParams.setDeltaTime(dt);
 	mUpdateParams.setElapsedTime(curr);
 
-	mAutoUpdateClient.update(mUpdateParams);
+	{
+		DS_PROFILE_ZONE("tweens");
+		mTweenline.update();
+	}
 
-	for (auto it=mRoots.begin(), end=mRoots.end(); it!=end; ++it) {
-		(*it)->updateClient(mUpdateParams);
+	{
+		DS_PROFILE_ZONE("auto_update");
+		mAutoUpdateClient.update(mUpdateParams);
+	}
+
+	{
+		DS_PROFILE_ZONE("sprite_update");
+		for (auto it=mRoots.begin(), end=mRoots.end(); it!=end; ++it) {
+			(*it)->updateClient(mUpdateParams);
+		}
+	}
+
+	{
+		DS_PROFILE_ZONE("transforms");
+		mSpriteTransforms.update();
 	}
 }
 
@@ -821,42 +884,69 @@ void Engine::updateServer() {
 
 	checkIdle();
 
-	//////////////////////////////////////////////////////////////////////////
 	{
-		std::lock_guard<std::mutex> lock(mTouchMutex);
-		mMouseBeginEvents.lockedUpdate();
-		mMouseMovedEvents.lockedUpdate();
-		mMouseEndedEvents.lockedUpdate();
-
-		mTouchBeginEvents.lockedUpdate();
-		mTouchMovedEvents.lockedUpdate();
-		mTouchEndedEvents.lockedUpdate();
-
-		mTuioObjectsBegin.lockedUpdate();
-		mTuioObjectsMoved.lockedUpdate();
-		mTuioObjectsEnded.lockedUpdate();
-	} // unlock touch mutex
-	//////////////////////////////////////////////////////////////////////////
+		DS_PROFILE_ZONE("touch_queues");
+		drainTuioIngest();
+
+		//////////////////////////////////////////////////////////////////////////
+		{
+			std::lock_guard<std::mutex> lock(mTouchMutex);
+			mMouseBeginEvents.lockedUpdate();
+			mMouseMovedEvents.lockedUpdate();
+			mMouseEndedEvents.lockedUpdate();
+
+			mTouchBeginEvents.lockedUpdate();
+			mTouchMovedEvents.lockedUpdate();
+			mTouchEndedEvents.lockedUpdate();
+
+			mTuioObjectsBegin.lockedUpdate();
+			mTuioObjectsMoved.lockedUpdate();
+			mTuioObjectsEnded.lockedUpdate();
+		} // unlock touch mutex
+		//////////////////////////////////////////////////////////////////////////
+
+		mMouseBeginEvents.update(curr);
+		mMouseMovedEvents.update(curr);
+		mMouseEndedEvents.update(curr);
+
+		mTouchBeginEvents.update(curr);
+		mTouchMovedEvents.update(curr);
+		mTouchEndedEvents.update(curr);
+
+		mTuioObjectsBegin.update(curr);
+		mTuioObjectsMoved.update(curr);
+		mTuioObjectsEnded.update(curr);
+	}
 
-	mMouseBeginEvents.update(curr);
-	mMouseMovedEvents.update(curr);
-	mMouseEndedEvents.update(curr);
+	mShaderService.update();
+	mUpdateParams.setDeltaTime(dt);
+	mUpdateParams.setElapsedTime(curr);
 
-	mTouchBeginEvents.update(curr);
-	mTouchMovedEvents.update(curr);
-	mTouchEndedEvents.update(curr);
+	{
+		DS_PROFILE_ZONE("tweens");
+		mTweenline.update();
+	}
 
-	mTuioObjectsBegin.update(curr);
-	mTuioObjectsMoved.update(curr);
-	mTuioObjectsEnded.update(curr);
+	{
+		DS_PROFILE_ZONE("timers");
+		mTimerWheel.advance();
+	}
 
-	mUpdateParams.setDeltaTime(dt);
-	mUpdateParams.setElapsedTime(curr);
+	{
+		DS_PROFILE_ZONE("auto_update");
+		mAutoUpdateServer.update(mUpdateParams);
+	}
 
-	mAutoUpdateServer.update(mUpdateParams);
+	{
+		DS_PROFILE_ZONE("sprite_update");
+		for (auto it=mRoots.begin(), end=mRoots.end(); it!=end; ++it) {
+			(*it)->updateServer(mUpdateParams);
+		}
+	}
 
-	for (auto it=mRoots.begin(), end=mRoots.end(); it!=end; ++it) {
-		(*it)->updateServer(mUpdateParams);
+	{
+		DS_PROFILE_ZONE("transforms");
+		mSpriteTransforms.update();
 	}
 }
 
@@ -945,6 +1035,31 @@ void Engine::clearAllSprites(const bool clearDebug) {
 	}
 }
 
+void Engine::drainTuioIngest() {
+	if(!mTuioIngest) return;
+
+	// Same scaling as ci::tuio::Client, and the same ids for a single source, so the touch queues
+	// can't tell the difference. Touches from more sources are kept apart by their source.
+	const ci::vec2		windowSize(ci::app::getWindowSize());
+	const double		time = ci::app::getElapsedSeconds();
+	mTuioIngest->drain([this, &windowSize, time](const ds::ui::TuioIngest::Frame& f) {
+		mIngestBegan.clear();
+		mIngestMoved.clear();
+		mIngestEnded.clear();
+		for(int i = 0; i < f.mNumCursors; ++i) {
+			const ds::ui::TuioIngest::Cursor&	c = f.mCursors[i];
+			const ci::app::TouchEvent::Touch	t(ci::vec2(c.mX, c.mY) * windowSize, ci::vec2(c.mPrevX, c.mPrevY) * windowSize,
+												  c.mTouchId, time, nullptr);
+			if(c.mPhase == ds::ui::TuioIngest::Cursor::BEGAN) mIngestBegan.push_back(t);
+			else if(c.mPhase == ds::ui::TuioIngest::Cursor::MOVED) mIngestMoved.push_back(t);
+			else mIngestEnded.push_back(t);
+		}
+		if(!mIngestBegan.empty()) mDsApp.touchesBegan(ci::app::TouchEvent(ci::app::WindowRef(), mIngestBegan));
+		if(!mIngestMoved.empty()) mDsApp.touchesMoved(ci::app::TouchEvent(ci::app::WindowRef(), mIngestMoved));
+		if(!mIngestEnded.empty()) mDsApp.touchesEnded(ci::app::TouchEvent(ci::app::WindowRef(), mIngestEnded));
+	});
+}
+
 void Engine::registerForTuioObjects(ci::tuio::Client& client) {
 	if (mSettings.getBool("touch:tuio:receive_objects", 0, false)) {
 		client.registerObjectAdded([this](ci::tuio::Object o) { this->mTuioObjectsBegin.incoming(TuioObject(o.getFiducialId(), o.getPos(), o.getAngle())); });
@@ -954,6 +1069,7 @@ void Engine::registerForTuioObjects(ci::tuio::Client& client) {
 }
 
 void Engine::drawClient() {
+	DS_PROFILE_ZONE("draw");
 	ci::gl::enableAlphaBlending();
 
 	ci::gl::clear(ci::ColorA(0.0f, 0.0f, 0.0f, 0.0f));
@@ -964,6 +1080,7 @@ void Engine::drawClient() {
 }
 
 void Engine::drawServer() {
+	DS_PROFILE_ZONE("draw");
 	ci::gl::enableAlphaBlending();
 
 	ci::gl::clear(ci::ColorA(0.0f, 0.0f, 0.0f, 0.0f));
@@ -974,11 +1091,7 @@ void Engine::drawServer() {
 }
 
 ds::sprite_id_t Engine::nextSpriteId() {
-	static ds::sprite_id_t              ID = 0;
-	++ID;
-	// Skip negative values.
-	if (ID <= EMPTY_SPRITE_ID) ID = EMPTY_SPRITE_ID + 1;
-	return ID;
+	return mSprites.allocate();
 }
 
 void Engine::registerSprite(ds::ui::Sprite& s) {
@@ -987,7 +1100,7 @@ void Engine::registerSprite(ds::ui::Sprite& s) {
 		assert(false);
 		return;
 	}
-	mSprites[s.getId()] = &s;
+	mSprites.insert(s.getId(), &s);
 }
 
 void Engine::unregisterSprite(ds::ui::Sprite& s) {
@@ -997,15 +1110,11 @@ void Engine::unregisterSprite(ds::ui::Sprite& s) {
 		assert(false);
 		return;
 	}
-	auto it = mSprites.find(s.getId());
-	if (it != mSprites.end()) mSprites.erase(it);
+	mSprites.erase(s.getId());
 }
 
 ds::ui::Sprite* Engine::findSprite(const ds::sprite_id_t id) {
-	if (mSprites.empty()) return nullptr;
-	auto it = mSprites.find(id);
-	if (it == mSprites.end()) return nullptr;
-	return it->second;
+	return mSprites.find(id);
 }
 
 void Engine::spriteDeleted(const ds::sprite_id_t&) {
@@ -29,8 +29,11 @@
 #include "ds/data/resource_list.h"
 #include "ds/data/tuio_object.h"
 #include "ds/app/engine/engine_settings.h"
+#include "ds/app/engine/sprite_id_table.h"
+#include "ds/network/io_reactor.h"
 #include "ds/ui/ip/ip_function_list.h"
 #include "ds/ui/service/pango_font_service.h"
+#include "ds/ui/service/shader_service.h"
 #include "ds/ui/sprite/sprite_engine.h"
 #include "ds/ui/touch/touch_manager.h"
 #include "ds/ui/touch/touch_translator.h"
@@ -42,6 +45,9 @@ class App;
 class AutoDrawService;
 class AutoUpdate;
 class EngineRoot;
+namespace ui {
+class TuioIngest;
+}
 
 namespace cfg {
 class SettingsEditor;
@@ -72,7 +78,10 @@ public:
 	virtual ds::AutoUpdateList&			getAutoUpdateList(const int = AutoUpdateType::SERVER);
 	virtual ds::ImageRegistry&			getImageRegistry() { return mImageRegistry; }
 	virtual ds::ui::PangoFontService&	getPangoFontService(){ return mPangoFontService; }
+	virtual ds::ui::ShaderService&		getShaderService(){ return mShaderService; }
+	virtual ds::net::IoReactor&			getIoReactor(){ return mIoReactor; }
 	virtual ds::ui::Tweenline&			getTweenline() { return mTweenline; }
+	virtual ds::ui::SpriteTransforms&	getSpriteTransforms() { return mSpriteTransforms; }
 
 	// I take ownership of any services added to me.
 	void								addService(const std::string&, ds::EngineService&);
@@ -275,8 +284,7 @@ protected:
 	static const int					NumberOfNetworkThreads;
 
 	ds::BlobRegistry					mBlobRegistry;
-	std::unordered_map<ds::sprite_id_t, ds::ui::Sprite*>
-										mSprites;
+	ds::SpriteIdTable					mSprites;
 	int									mTuioPort;
 
 	// All the installed image processing functions.
@@ -285,6 +293,8 @@ protected:
 
 private:
 	void								setTouchMode(const ds::ui::TouchMode::Enum&);
+	// Hand any frames from the batched TUIO ingest to the app as touch events
+	void								drainTuioIngest();
 	void								createStatsView(sprite_id_t root_id);
 	
 	/// Read these values from settings and apply them
@@ -305,6 +315,8 @@ private:
 	void								setupMetrics();
 
 	friend class EngineStatsView;
+	// Declared before the roots so it outlives every sprite
+	ds::ui::SpriteTransforms			mSpriteTransforms;
 	std::vector<std::unique_ptr<EngineRoot> >
 										mRoots;
 	ds::App&							mDsApp;
@@ -313,6 +325,8 @@ private:
 	bool								mShowConsole;
 	ImageRegistry						mImageRegistry;
 	ds::ui::PangoFontService			mPangoFontService;
+	ds::ui::ShaderService				mShaderService;
+	ds::net::IoReactor					mIoReactor;
 	ds::ui::Tweenline					mTweenline;
 	// A cache of all the resources in the system
 	ResourceList						mResources;
@@ -330,6 +344,10 @@ private:
 	uint32_t							mTuioMovedRegistrationId;
 	uint32_t							mTuioEndedRegistrationId;
 	bool								mTuioRegistered;
+	// Only used if the settings file has "touch:tuio:batched_ingest" set to true
+	std::unique_ptr<ds::ui::TuioIngest>	mTuioIngest;
+	std::vector<ci::app::TouchEvent::Touch>
+										mIngestBegan, mIngestMoved, mIngestEnded;
 	// Clients that will get update() called automatically at the start
 	// of each update cycle
 	AutoUpdateList						mAutoUpdateServer;
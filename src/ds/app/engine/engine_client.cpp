@@ -2,8 +2,13 @@
 
 #include "ds/app/engine/engine_client.h"
 
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include "ds/app/environment.h"
 #include "ds/app/engine/engine_io_defs.h"
 #include "ds/app/engine/engine_data.h"
+#include "ds/debug/frame_profiler.h"
 #include "ds/debug/logger.h"
 #include "ds/debug/debug_defines.h"
 #include "ds/ui/sprite/image.h"
@@ -16,9 +21,10 @@
 namespace ds {
 
 namespace {
-char				HEADER_BLOB = 0;
+// Most chunk ranges asked for in one message
+const size_t		MAX_NACK_RANGES = 96;
+
 char				COMMAND_BLOB = 0;
-char				DELETE_SPRITE_BLOB = 0;
 
 // Used for clients to get info to the server
 char				CLIENT_STATUS_BLOB = 0;
@@ -38,27 +44,41 @@ EngineClient::EngineClient(	ds::App& app, ds::EngineSettings& settings,
 							ds::EngineData& ed, const ds::RootList& roots)
 		: inherited(app, settings, ed, roots)
 		, mLoadImageService(*this, mIpFunctions)
+		, mThumbnailService(*this)
 		, mSender(mSendConnection, false)
 		, mReceiver(mReceiveConnection, true)
-		, mBlobReader(mReceiver.getData(), *this)
+		, mDecoder(*this, mReceiver)
 		, mSessionId(0)
 		, mConnectionRenewed(false)
-		, mServerFrame(-1)
+		, mResyncAfterLost(0)
+		, mReplaying(false)
+		, mReplayRealTime(true)
+		, mReplayQuit(false)
+		, mReplayStart(-1.0)
 		, mState(nullptr)
 		, mIoInfo(*this)
 {
 
-	// NOTE:  Must be EXACTLY the same items as in EngineServer, in same order,
-	// so that the BLOB ids match.
-	HEADER_BLOB = mBlobRegistry.add([this](BlobReader& r) {receiveHeader(r.mDataBuffer);});
-	COMMAND_BLOB = mBlobRegistry.add([this](BlobReader& r) {receiveCommand(r.mDataBuffer);});
-	DELETE_SPRITE_BLOB = mBlobRegistry.add([this](BlobReader& r) {receiveDeleteSprite(r.mDataBuffer);});
-	CLIENT_STATUS_BLOB = mBlobRegistry.add([this](BlobReader& r) {receiveClientStatus(r.mDataBuffer); });
-	CLIENT_INPUT_BLOB = mBlobRegistry.add([this](BlobReader& r) {receiveClientInput(r.mDataBuffer); });
-	mReceiver.setHeaderAndCommandIds(HEADER_BLOB, COMMAND_BLOB);
+	// Must come before any sprite types, so the BLOB ids match the server's
+	mDecoder.install(mBlobRegistry);
+	mDecoder.mOnWorld = [this]() { return onReceiveWorld(); };
+	mDecoder.mOnStartedReply = [this](const std::vector<ClientDecoder::StartedReply>& r) { onClientStartedReply(r); };
+	COMMAND_BLOB = mDecoder.getCommandBlob();
+	CLIENT_STATUS_BLOB = mDecoder.getClientStatusBlob();
+	CLIENT_INPUT_BLOB = mDecoder.getClientInputBlob();
+
+	mReceiver.setRecovery(std::max(0, settings.getInt("client:nack_delay", 0, 0)), std::max(1, settings.getInt("client:nack_attempts", 0, 3)));
+	mResyncAfterLost = std::max(0, settings.getInt("client:resync_after_lost", 0, 1));
+
+	const std::string	replayFile(settings.getString("client:replay_file", 0, ""));
+	if (!replayFile.empty() && mReplayer.open(ds::Environment::expand(replayFile))) {
+		mReplaying = true;
+		mReplayRealTime = settings.getBool("client:replay_realtime", 0, true);
+		mReplayQuit = settings.getBool("client:replay_quit", 0, false);
+	}
 	
 	try {
-		if (settings.getBool("server:connect", 0, true)) {
+		if (!mReplaying && settings.getBool("server:connect", 0, true)) {
 			mSendConnection.initialize(true, settings.getString("server:ip"), ds::value_to_string(settings.getInt("server:listen_port")));
 			mReceiveConnection.initialize(false, settings.getString("server:ip"), ds::value_to_string(settings.getInt("server:send_port")));
 		}
@@ -86,13 +106,31 @@ ds::sprite_id_t EngineClient::nextSpriteId() {
 
 void EngineClient::setup(ds::App& app) {
 	inherited::setup(app);
+
+	if (mReplaying) {
+		// Stand in for the client-started handshake: the recording has the roots,
+		// and any session id lets the recorded world through.
+		createClientRoots(mReplayer.getRoots());
+		mSessionId = 1;
+		setState(mBlankState);
+	}
 }
 
 void EngineClient::update() {
-	mWorkManager.update();
+	{
+		DS_PROFILE_ZONE("work_manager");
+		mWorkManager.update();
+	}
 	updateClient();
 	mComputerInfo->update();
 
+	DS_PROFILE_ZONE("replication");
+
+	if (mReplaying) {
+		updateReplay();
+		return;
+	}
+
 	if (!mConnectionRenewed && 
 		(mReceiver.hasLostConnection() || !mSendConnection.initialized())
 		){
@@ -111,34 +149,98 @@ void EngineClient::update() {
 	}
 
 
-	// Every update, receive data
-	mReceiver.setHeaderAndCommandOnly(mState->getHeaderAndCommandOnly());
-
 	// Don't change state or take any action if there's no data waiting
 	if(!mReceiver.receiveBlob()) return;
 
-	// Run through all the blobs we just 
-	while(true) {
-		bool moreData = false;
+	sendNacks();
 
-		// there's an edge case where we're just listening for the fresh world
-		// If that's the case, then don't handle the rest of the blobs this frame, handle those next frame (the receiver keeps track of stuff)
-		if(!mReceiver.handleBlob(mBlobRegistry, mBlobReader, moreData)){
-			return;
-		}
-
-		if(!moreData) break;
-	}
+	// Run through all the blobs we just got
+	if(!mDecoder.decode(mBlobRegistry, mState->getHeaderAndCommandOnly())) return;
 
 	mConnectionRenewed = false;
 
+	// Recovery couldn't get something back, so the sprites could be out of date
+	if(mResyncAfterLost > 0 && mState == &mRunningState && mReceiver.getLostGroups() >= mResyncAfterLost) {
+		DS_LOG_WARNING_M("EngineClient lost " << mReceiver.getLostGroups() << " frames from the server, requesting the world", ds::IO_LOG);
+		mReceiver.clearLostGroups();
+		setState(mBlankState);
+	}
+
 	mState->update(*this);
 }
 
+void EngineClient::sendNacks() {
+	if(mSessionId < 1) return;
+
+	mNackRanges.clear();
+	mReceiver.getMissing(mNackRanges);
+	if(mNackRanges.empty()) return;
+	if(mNackRanges.size() > MAX_NACK_RANGES) mNackRanges.resize(MAX_NACK_RANGES);
+
+	EngineSender::AutoSend  send(mSender);
+	ds::DataBuffer&   buf = send.mData;
+	buf.add(COMMAND_BLOB);
+	buf.add(CMD_CLIENT_NACK);
+	buf.add(ATT_SESSION_ID);
+	buf.add(mSessionId);
+	buf.add(static_cast<int32_t>(mNackRanges.size()));
+	for(auto& it : mNackRanges) {
+		buf.add(static_cast<uint32_t>(it.mGroupId));
+		buf.add(static_cast<uint32_t>(it.mFirst));
+		buf.add(static_cast<uint32_t>(it.mCount));
+	}
+	buf.add(ds::TERMINATOR_CHAR);
+}
+
 void EngineClient::draw() {
 	drawClient();
 }
 
+void EngineClient::updateReplay() {
+	if (mReplayer.isDone()) return;
+
+	const double		now = ci::app::getElapsedSeconds();
+	if (mReplayStart < 0.0) mReplayStart = now;
+
+	// In real time, everything that's due by now. Otherwise the whole recording, as fast as it decodes.
+	const double		due = (mReplayRealTime ? now - mReplayStart : -1.0);
+	ReplicationReplayer::Stats&	stats = mReplayer.getStats();
+	const auto			start = std::chrono::steady_clock::now();
+	std::string			blob;
+	while (mReplayer.next(due, blob)) {
+		mReceiver.addBlob(blob);
+		// The world command changes the state partway through, so check it for every blob
+		mDecoder.decode(mBlobRegistry, mState->getHeaderAndCommandOnly());
+		stats.mPeakSprites = std::max(stats.mPeakSprites, getNumberOfSprites());
+	}
+	stats.mDecodeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	mState->update(*this);
+
+	if (mReplayer.isDone()) {
+		reportReplay();
+		if (mReplayQuit) ci::app::App::get()->quit();
+	}
+}
+
+void EngineClient::reportReplay() {
+	// Combine the synchronized roots in order, the same ones the server recorded
+	uint64_t			checksum = 0;
+	const size_t		count(getRootCount());
+	for (size_t k = 0; k < count; ++k) {
+		if (!getRootBuilder(k).mSyncronize) continue;
+		checksum = checksum * 31 + ReplicationReplayer::checksum(getRootSprite(k));
+	}
+
+	const ReplicationReplayer::Stats&	stats = mReplayer.getStats();
+	const ds::SlabPool::Stats			pool = ds::ui::Sprite::getAllocationStats();
+	DS_LOG_INFO_M("Replay finished: frames=" << stats.mFrames << " bytes=" << stats.mBytes
+				  << " decode_ms=" << stats.mDecodeSeconds * 1000.0
+				  << " sprites=" << getNumberOfSprites() << " peak_sprites=" << stats.mPeakSprites
+				  << " sprite_allocations=" << pool.mAllocations
+				  << " checksum=" << std::hex << std::setw(16) << std::setfill('0') << checksum, ds::IO_LOG);
+}
+
 void EngineClient::stopServices() {
 	inherited::stopServices();
 	mWorkManager.stopManager();
@@ -152,133 +254,30 @@ int EngineClient::getBytesSent(){
 	return mSendConnection.getSentBytes();
 }
 
-void EngineClient::receiveHeader(ds::DataBuffer& data) {
-	if (data.canRead<int32_t>()) {
-		mServerFrame = data.read<int32_t>();
-	} else {
-		DS_LOG_WARNING_M("EngineClient::receiveHeader() invalid server frame. This is likely a net communication issue, packets lost, etc.", ds::IO_LOG);
-	}
-	// Terminator
-	if (data.canRead<char>()) {
-		data.read<char>();
-	} else {
-		DS_LOG_WARNING_M("EngineClient::receiveHeader() No terminator found for header!", ds::IO_LOG);
-	}
-}
-
-void EngineClient::receiveCommand(ds::DataBuffer& data) {
-	char            cmd;
-	while (data.canRead<char>() && (cmd=data.read<char>()) != ds::TERMINATOR_CHAR) {
-		if (cmd == CMD_SERVER_SEND_WORLD) {
-			DS_LOG_INFO_M("Receive world, sessionid=" << mSessionId, ds::IO_LOG);
-			clearAllSprites(false);
-
-			if (mSessionId < 1) {
-				setState(mClientStartedState);
-			} else {
-				// Make sure the rest of the blobs are handled
-				mReceiver.setHeaderAndCommandOnly(false);
-				setState(mRunningState);
-			}
-		} else if(cmd == CMD_CLIENT_STARTED_REPLY) {
-			DS_LOG_INFO_M("Receive ClientStartedReply", ds::IO_LOG);
-			onClientStartedReplyCommand(data);
-		}
-	}
-}
+bool EngineClient::onReceiveWorld() {
+	DS_LOG_INFO_M("Receive world, sessionid=" << mSessionId, ds::IO_LOG);
+	clearAllSprites(false);
 
-void EngineClient::receiveDeleteSprite(ds::DataBuffer& data) {
-	// First data is the count
-	if (!data.canRead<size_t>()) return;
-
-	size_t		size = data.read<size_t>();
-	for (size_t k=0; k<size; ++k) {
-		if (data.canRead<sprite_id_t>()) {
-			const sprite_id_t	id = data.read<sprite_id_t>();
-
-			if (!mSprites.empty()) {
-				auto f = mSprites.find(id);
-				if (f != mSprites.end()) {
-					// Once I delete this item, mSprites will have been updated,
-					// with f->second and all children removed, so do not reference f again.
-					if (f->second) f->second->release();
-				}
-			}
-		} else {
-			break;
-		}
-	}
-	if (!data.canRead<char>()) {
-		DS_LOG_ERROR("EngineClient::receiveDeleteSprite() no space for an ending terminator");
-		return;
-	}
-	const char		cmd(data.read<char>());
-	if (cmd != ds::TERMINATOR_CHAR) {
-		DS_LOG_ERROR("EngineClient::receiveDeleteSprite() no ending terminator");
-	}
-}
-
-void EngineClient::receiveClientStatus(ds::DataBuffer& data) {
-	// Whaaaat? Server should never be sending this.
-	while (data.canRead<char>()) {
-		const char		cmd(data.read<char>());
-		if (cmd == ds::TERMINATOR_CHAR) return;
-	}
-}
-
-void EngineClient::receiveClientInput(ds::DataBuffer& data) {
-	// Whaaaat? Server should never be sending this.
-	while(data.canRead<char>()) {
-		const char		cmd(data.read<char>());
-		if(cmd == ds::TERMINATOR_CHAR) return;
+	if (mSessionId < 1) {
+		setState(mClientStartedState);
+		return false;
 	}
+	// Make sure the rest of the blobs are handled
+	setState(mRunningState);
+	return true;
 }
 
-void EngineClient::onClientStartedReplyCommand(ds::DataBuffer& data) {
+void EngineClient::onClientStartedReply(const std::vector<ClientDecoder::StartedReply>& replies) {
+	DS_LOG_INFO_M("Receive ClientStartedReply", ds::IO_LOG);
 	clearRoots();
-	
-	char					cmd;
-	while (data.canRead<char>() && (cmd=data.read<char>()) != ds::TERMINATOR_CHAR) {
-		if (cmd == ATT_CLIENT) {
-			char			att;
-			std::string		guid;
-			int32_t			sessionid(0);
-			unsigned int	chunkerId(0);
-			while (data.canRead<char>() && (att=data.read<char>()) != ds::TERMINATOR_CHAR) {
-				if (att == ATT_GLOBAL_ID) {
-					guid = data.read<std::string>();
-				} else if (att == ATT_SESSION_ID) {
-					sessionid = data.read<int32_t>();
-				} else if(att == ATT_ROOTS){
-					std::vector<RootList::Root> roots;
-					int numRoots = data.read<int32_t>();
-					for(int i = 0; i < numRoots; i++){
-						RootList::Root root = RootList::Root();
-						int rootId = data.read<int32_t>();
-						int typey = data.read<int32_t>();
-						if(typey == RootList::Root::kOrtho){
-							root.mType = RootList::Root::kOrtho;
-						} else if(typey == RootList::Root::kPerspective){
-							root.mType = RootList::Root::kPerspective;
-						} else {
-							DS_LOG_ERROR("Got an invalid root type! " << typey);
-							continue;
-						}
-
-
-						root.mRootId = rootId;
-						roots.push_back(root);
-					}
-
-					createClientRoots(roots);
-				}
-			}
-			if (guid == mIoInfo.mGlobalId) {
-				mSessionId = sessionid;
-				mSender.setPacketNumber(chunkerId);
-				setState(mBlankState);
-			}
-		} 
+
+	for (auto it = replies.begin(), end = replies.end(); it != end; ++it) {
+		if (it->mHasRoots) createClientRoots(it->mRoots);
+		if (it->mGlobalId == mIoInfo.mGlobalId) {
+			mSessionId = it->mSessionId;
+			mSender.setPacketNumber(0);
+			setState(mBlankState);
+		}
 	}
 }
 
@@ -331,7 +330,7 @@ EngineClient::RunningState::RunningState() {
 
 void EngineClient::RunningState::begin(EngineClient &c) {
 	DS_LOG_INFO_M("RunningState", ds::IO_LOG);
-	c.mServerFrame = -1;
+	c.mDecoder.setServerFrame(-1);
 }
 
 void EngineClient::RunningState::update(EngineClient &e) {
@@ -342,7 +341,7 @@ void EngineClient::RunningState::update(EngineClient &e) {
 	buf.add(ATT_SESSION_ID);
 	buf.add(e.mSessionId);
 	buf.add(ATT_FRAME);
-	buf.add(e.mServerFrame);
+	buf.add(e.mDecoder.getServerFrame());
 	buf.add(ds::TERMINATOR_CHAR);
 
 	const size_t count(e.getRootCount());
@@ -352,7 +351,7 @@ void EngineClient::RunningState::update(EngineClient &e) {
 		s.writeClientTo(buf);
 	}
 
-	//DS_LOG_INFO_M("RunningState send reply frame=" << e.mServerFrame, ds::IO_LOG);
+	//DS_LOG_INFO_M("RunningState send reply frame=" << e.mDecoder.getServerFrame(), ds::IO_LOG);
 }
 
 /**
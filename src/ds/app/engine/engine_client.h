@@ -9,6 +9,7 @@
 #include "ds/network/udp_connection.h"
 #include "ds/thread/work_manager.h"
 #include "ds/ui/service/load_image_service.h"
+#include "ds/ui/service/thumbnail_service.h"
 
 namespace ds {
 
@@ -24,6 +25,7 @@ public:
 
 	virtual ds::WorkManager&		getWorkManager()		{ return mWorkManager; }
 	virtual ui::LoadImageService&	getLoadImageService()	{ return mLoadImageService; }
+	virtual ui::ThumbnailService&	getThumbnailService()	{ return mThumbnailService; }
 	virtual ds::sprite_id_t			nextSpriteId();
 
 	virtual void					installSprite(	const std::function<void(ds::BlobRegistry&)>& asServer,
@@ -39,16 +41,14 @@ public:
 	virtual int						getBytesRecieved();
 	virtual int						getBytesSent();
 
-	// The most recent frame received from the server.
-	int32_t							mServerFrame;
-
 private:
-	void							receiveHeader(ds::DataBuffer&);
-	void							receiveCommand(ds::DataBuffer&);
-	void							receiveDeleteSprite(ds::DataBuffer&);
-	void							receiveClientStatus(ds::DataBuffer&);
-	void							receiveClientInput(ds::DataBuffer&);
-	void							onClientStartedReplyCommand(ds::DataBuffer&);
+	bool							onReceiveWorld();
+	void							onClientStartedReply(const std::vector<ClientDecoder::StartedReply>&);
+	// Ask the server to resend whatever chunks the receiver is missing
+	void							sendNacks();
+	// Feed a recording into the receiver instead of the network
+	void							updateReplay();
+	void							reportReplay();
 
 	virtual void					handleMouseTouchBegin(const ci::app::MouseEvent&, int id);
 	virtual void					handleMouseTouchMoved(const ci::app::MouseEvent&, int id);
@@ -58,17 +58,28 @@ private:
 	typedef Engine inherited;
 	WorkManager						mWorkManager;
 	ui::LoadImageService			mLoadImageService;
+	ui::ThumbnailService			mThumbnailService;
 
 	EngineIoInfo					mIoInfo;
 	ds::UdpConnection				mSendConnection;
 	ds::UdpConnection				mReceiveConnection;
 	EngineSender					mSender;
 	EngineReceiver					mReceiver;
-	ds::BlobReader					mBlobReader;
+	ClientDecoder					mDecoder;
 	int32_t							mSessionId;
 	// True if I lost the connection, renewed it, and am
 	// waiting to hear back.
 	bool							mConnectionRenewed;
+	// Lost frames before asking for the world again, 0 for never
+	unsigned						mResyncAfterLost;
+	std::vector<ds::net::ChunkRange>	mNackRanges;
+
+	// Replaying a ReplicationRecorder file ("client:replay_file") instead of listening to a server
+	ReplicationReplayer				mReplayer;
+	bool							mReplaying;
+	bool							mReplayRealTime;
+	bool							mReplayQuit;
+	double							mReplayStart;
 
 	// STATES
 	class State {
@@ -13,6 +13,7 @@ EngineClientServer::EngineClientServer(	ds::App& app, ds::EngineSettings& settin
 										ds::EngineData& ed, const ds::RootList& roots)
 		: inherited(app, settings, ed, roots)
 		, mLoadImageService(*this, mIpFunctions)
+		, mThumbnailService(*this)
 {
 }
 
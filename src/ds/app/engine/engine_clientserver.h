@@ -17,6 +17,7 @@ public:
 	~EngineClientServer();
 
 	virtual ui::LoadImageService&	getLoadImageService()	{ return mLoadImageService; }
+	virtual ui::ThumbnailService&	getThumbnailService()	{ return mThumbnailService; }
 
 	virtual void					setup(ds::App&);
 	virtual void					draw();
@@ -26,6 +27,7 @@ public:
 private:
 	typedef AbstractEngineServer inherited;
 	ui::LoadImageService			mLoadImageService;
+	ui::ThumbnailService			mThumbnailService;
 };
 
 } // namespace ds
@@ -4,7 +4,10 @@
 
 #include "ds/app/blob_reader.h"
 #include "ds/app/blob_registry.h"
+#include "ds/app/engine/engine_io_defs.h"
 #include "ds/debug/logger.h"
+#include "ds/ui/sprite/sprite.h"
+#include "ds/ui/sprite/sprite_engine.h"
 #include "ds/util/string_util.h"
 #include "snappy.h"
 #include <cinder/Rand.h>
@@ -13,6 +16,15 @@
 
 namespace ds {
 
+namespace {
+// Client status and input only ever go to the server
+void						skip_to_terminator(ds::DataBuffer& data) {
+	while(data.canRead<char>()) {
+		if(data.read<char>() == ds::TERMINATOR_CHAR) return;
+	}
+}
+}
+
 /**
  * \class ds::EngineSender
  */
@@ -20,6 +32,7 @@ EngineSender::EngineSender(ds::NetConnection& con, const bool useChunker)
 		: mConnection(con) 
 		, mPacketId(0)
 		, mUseChunker(useChunker)
+		, mResentBytes(0)
 {
 }
 
@@ -27,6 +40,44 @@ void EngineSender::setPacketNumber(unsigned int packetId){
 	mPacketId = packetId;
 }
 
+void EngineSender::setParitySpan(const unsigned span){
+	mChunker.setParitySpan(span);
+}
+
+int EngineSender::resend(const unsigned groupId, const unsigned first, const unsigned count){
+	if(!mUseChunker || !mConnection.initialized()) return 0;
+
+	const unsigned			last = count > 0 ? first + count : mChunker.getDataChunkCount(groupId);
+	int						sent = 0;
+	for(unsigned i = first; i < last; ++i){
+		const char*			data = nullptr;
+		int					size = 0;
+		if(!mChunker.getDatagram(groupId, i, data, size)) break;
+		if(mConnection.sendMessage(data, size)){
+			mResentBytes += size;
+			++sent;
+		}
+	}
+	return sent;
+}
+
+EngineSender::Stats EngineSender::getStats() const {
+	Stats					stats;
+	stats.mDataBytes = mChunker.getDataBytes();
+	stats.mParityBytes = mChunker.getParityBytes();
+	stats.mResentBytes = mResentBytes;
+	return stats;
+}
+
+bool EngineSender::startRecording(const std::string& path, const std::vector<RootList::Root>& roots) {
+	if(!mRecorder) mRecorder.reset(new ReplicationRecorder());
+	return mRecorder->open(path, roots);
+}
+
+void EngineSender::stopRecording() {
+	mRecorder.reset();
+}
+
 /**
  * \class ds::EngineSender::AutoSend
  */
@@ -38,27 +89,26 @@ EngineSender::AutoSend::AutoSend(EngineSender& sender)
 
 EngineSender::AutoSend::~AutoSend() {
 	// Send data to client
-	if (!mSender.mConnection.initialized()) return;
+	const bool recording = mSender.mRecorder && mSender.mRecorder->isOpen();
+	if (!recording && !mSender.mConnection.initialized()) return;
 	if (mData.size() < 1) return;
 
 	const size_t size = mData.size();
 	mSender.mRawDataBuffer.setSize(size);
 	mData.readRaw(mSender.mRawDataBuffer.data(), size);
+	if (recording) {
+		mSender.mRecorder->write(mSender.mRawDataBuffer.data(), size);
+		if (!mSender.mConnection.initialized()) return;
+	}
 	snappy::Compress(mSender.mRawDataBuffer.data(), size, &mSender.mCompressionBuffer);
 
-	std::vector<std::string> chunks;
-
 	if(mSender.mUseChunker){
-
 		mSender.mPacketId++;
-		ds::net::Chunker chunker;
-		chunker.Chunkify(mSender.mCompressionBuffer, mSender.mPacketId, chunks);
+		auto& chunker = mSender.mChunker;
+		const unsigned count = chunker.chunkify(mSender.mCompressionBuffer.c_str(), static_cast<unsigned>(mSender.mCompressionBuffer.size()), mSender.mPacketId);
+		mSender.mConnection.sendMessages(chunker.getDatagrams().data(), chunker.getDatagramSizes().data(), static_cast<int>(count));
 	} else {
-		chunks.push_back(mSender.mCompressionBuffer);
-	}
-
-	for (auto it : chunks){
-		mSender.mConnection.sendMessage(it);
+		mSender.mConnection.sendMessage(mSender.mCompressionBuffer);
 	}
 
 	mData.clear();
@@ -73,7 +123,9 @@ EngineReceiver::EngineReceiver(ds::NetConnection& con, const bool useChunker)
 		, mCommandId(0)
 		, mHeaderAndCommandOnly(false)
 		, mUseChunker(useChunker)
-		, mNoDataCount(0) {
+		, mNoDataCount(0)
+		, mNackAttempts(0)
+		, mLostBase(0) {
 	setHeaderAndCommandOnly();
 }
 
@@ -94,21 +146,21 @@ bool EngineReceiver::receiveBlob() {
 	std::string recvBuffer;
 
 	if(mUseChunker){
+		// Take groups out as they become available, so a backlog can't push them out of the dechunker's window
 		while(mConnection.recvMessage(recvBuffer)) {
 			mDechunker.addChunk(recvBuffer);
-		}
 
-		while(mDechunker.getAvailable() > 0) {
-			std::string outBuf;
-			bool validy = mDechunker.getNextGroup(outBuf);
+			while(mDechunker.getAvailable() > 0) {
+				bool validy = mDechunker.getNextGroup(mGroupBuffer);
 
-			if(!validy) {
-				DS_LOG_WARNING_M("EngineReceiver: Invalid chunk received. Expect a new world frame shortly.", ds::IO_LOG);
-				return false;
-			}
+				if(!validy) {
+					DS_LOG_WARNING_M("EngineReceiver: Invalid chunk received. Expect a new world frame shortly.", ds::IO_LOG);
+					return false;
+				}
 
-			snappy::Uncompress(outBuf.c_str(), outBuf.size(), &mCompressionBufferRead);
-			mReceiveBuffers.push_back(mCompressionBufferRead);
+				snappy::Uncompress(mGroupBuffer.c_str(), mGroupBuffer.size(), &mCompressionBufferRead);
+				mReceiveBuffers.push_back(mCompressionBufferRead);
+			}
 		}
 	} else {
 		while(mConnection.recvMessage(recvBuffer)) {
@@ -161,6 +213,11 @@ bool EngineReceiver::handleBlob(ds::BlobRegistry& registry, ds::BlobReader& read
 	return true;
 }
 
+void EngineReceiver::addBlob(std::string& blob) {
+	mReceiveBuffers.push_back(std::string());
+	mReceiveBuffers.back().swap(blob);
+}
+
 bool EngineReceiver::hasLostConnection() const {
 	return mNoDataCount > 300;
 }
@@ -169,5 +226,208 @@ void EngineReceiver::clearLostConnection() {
 	mNoDataCount = 0;
 }
 
+void EngineReceiver::setRecovery(const unsigned delay, const unsigned attempts) {
+	mDechunker.setReorderDelay(delay);
+	mNackAttempts = delay > 0 ? attempts : 0;
+}
+
+void EngineReceiver::getMissing(std::vector<ds::net::ChunkRange>& out) {
+	if(!mUseChunker || mNackAttempts < 1) return;
+	mDechunker.getMissing(out, mNackAttempts);
+}
+
+unsigned EngineReceiver::getLostGroups() const {
+	return mDechunker.getStats().mDropped - mLostBase;
+}
+
+void EngineReceiver::clearLostGroups() {
+	mLostBase = mDechunker.getStats().mDropped;
+}
+
+/**
+ * \class ds::ServerEncoder
+ */
+ServerEncoder::ServerEncoder()
+		: mHeaderBlob(0)
+		, mCommandBlob(0)
+		, mDeleteSpriteBlob(0)
+		, mClientStatusBlob(0)
+		, mClientInputBlob(0) {
+}
+
+void ServerEncoder::install(ds::BlobRegistry& registry,
+							const std::function<void(BlobReader&)>& header,
+							const std::function<void(BlobReader&)>& command,
+							const std::function<void(BlobReader&)>& deleteSprite,
+							const std::function<void(BlobReader&)>& clientStatus,
+							const std::function<void(BlobReader&)>& clientInput) {
+	mHeaderBlob = registry.add(header);
+	mCommandBlob = registry.add(command);
+	mDeleteSpriteBlob = registry.add(deleteSprite);
+	mClientStatusBlob = registry.add(clientStatus);
+	mClientInputBlob = registry.add(clientInput);
+}
+
+void ServerEncoder::addHeader(ds::DataBuffer& data, const int32_t frame) const {
+	data.add(mHeaderBlob);
+	data.add(frame);
+	data.add(ds::TERMINATOR_CHAR);
+}
+
+void ServerEncoder::addWorld(ds::DataBuffer& data) const {
+	addHeader(data, -1);
+	data.add(mCommandBlob);
+	data.add(CMD_SERVER_SEND_WORLD);
+	data.add(ds::TERMINATOR_CHAR);
+}
+
+void ServerEncoder::addRoot(ds::DataBuffer& data, ds::ui::Sprite& root, const bool world) const {
+	if(world) {
+		root.markTreeAsDirty();
+	} else if(!root.isDirty()) {
+		return;
+	}
+	root.writeTo(data);
+}
+
+void ServerEncoder::addDeletedSprites(ds::DataBuffer& data, const std::vector<sprite_id_t>& ids) const {
+	if(ids.empty()) return;
+
+	data.add(mDeleteSpriteBlob);
+	data.add(ids.size());
+	for(auto it = ids.begin(), end = ids.end(); it != end; ++it) {
+		data.add(*it);
+	}
+	data.add(ds::TERMINATOR_CHAR);
+}
+
+/**
+ * \class ds::ClientDecoder
+ */
+ClientDecoder::StartedReply::StartedReply()
+		: mSessionId(0)
+		, mHasRoots(false) {
+}
+
+ClientDecoder::ClientDecoder(ds::ui::SpriteEngine& engine, EngineReceiver& receiver)
+		: mEngine(engine)
+		, mReceiver(receiver)
+		, mReader(receiver.getData(), engine)
+		, mHeaderBlob(0)
+		, mCommandBlob(0)
+		, mClientStatusBlob(0)
+		, mClientInputBlob(0)
+		, mServerFrame(-1) {
+}
+
+void ClientDecoder::install(ds::BlobRegistry& registry) {
+	mHeaderBlob = registry.add([this](BlobReader& r) { receiveHeader(r.mDataBuffer); });
+	mCommandBlob = registry.add([this](BlobReader& r) { receiveCommand(r.mDataBuffer); });
+	registry.add([this](BlobReader& r) { receiveDeleteSprite(r.mDataBuffer); });
+	mClientStatusBlob = registry.add([](BlobReader& r) { skip_to_terminator(r.mDataBuffer); });
+	mClientInputBlob = registry.add([](BlobReader& r) { skip_to_terminator(r.mDataBuffer); });
+	mReceiver.setHeaderAndCommandIds(mHeaderBlob, mCommandBlob);
+}
+
+bool ClientDecoder::decode(ds::BlobRegistry& registry, const bool headerAndCommandOnly) {
+	// The world command turns this off partway through, so the sprites after it are read
+	mReceiver.setHeaderAndCommandOnly(headerAndCommandOnly);
+
+	bool					decoded = false;
+	bool					moreData = true;
+	while(moreData && mReceiver.handleBlob(registry, mReader, moreData)) {
+		decoded = true;
+	}
+	return decoded;
+}
+
+void ClientDecoder::receiveHeader(ds::DataBuffer& data) {
+	if(data.canRead<int32_t>()) {
+		mServerFrame = data.read<int32_t>();
+	} else {
+		DS_LOG_WARNING_M("ClientDecoder::receiveHeader() invalid server frame. This is likely a net communication issue, packets lost, etc.", ds::IO_LOG);
+	}
+	// Terminator
+	if(data.canRead<char>()) {
+		data.read<char>();
+	} else {
+		DS_LOG_WARNING_M("ClientDecoder::receiveHeader() No terminator found for header!", ds::IO_LOG);
+	}
+}
+
+void ClientDecoder::receiveCommand(ds::DataBuffer& data) {
+	char					cmd;
+	while(data.canRead<char>() && (cmd = data.read<char>()) != ds::TERMINATOR_CHAR) {
+		if(cmd == CMD_SERVER_SEND_WORLD) {
+			// Anything lost before the world doesn't matter anymore
+			mReceiver.clearLostGroups();
+			if(mOnWorld && mOnWorld()) mReceiver.setHeaderAndCommandOnly(false);
+		} else if(cmd == CMD_CLIENT_STARTED_REPLY) {
+			receiveStartedReply(data);
+		}
+	}
+}
+
+void ClientDecoder::receiveStartedReply(ds::DataBuffer& data) {
+	mReplies.clear();
+
+	char					cmd;
+	while(data.canRead<char>() && (cmd = data.read<char>()) != ds::TERMINATOR_CHAR) {
+		if(cmd != ATT_CLIENT) continue;
+
+		StartedReply		reply;
+		char				att;
+		while(data.canRead<char>() && (att = data.read<char>()) != ds::TERMINATOR_CHAR) {
+			if(att == ATT_GLOBAL_ID) {
+				reply.mGlobalId = data.read<std::string>();
+			} else if(att == ATT_SESSION_ID) {
+				reply.mSessionId = data.read<int32_t>();
+			} else if(att == ATT_ROOTS) {
+				reply.mHasRoots = true;
+				const int32_t	numRoots = data.read<int32_t>();
+				for(int32_t i = 0; i < numRoots; ++i) {
+					RootList::Root	root = RootList::Root();
+					const int32_t	rootId = data.read<int32_t>();
+					const int32_t	typey = data.read<int32_t>();
+					if(typey == RootList::Root::kOrtho) {
+						root.mType = RootList::Root::kOrtho;
+					} else if(typey == RootList::Root::kPerspective) {
+						root.mType = RootList::Root::kPerspective;
+					} else {
+						DS_LOG_ERROR("Got an invalid root type! " << typey);
+						continue;
+					}
+					root.mRootId = rootId;
+					reply.mRoots.push_back(root);
+				}
+			}
+		}
+		mReplies.push_back(reply);
+	}
+
+	if(mOnStartedReply) mOnStartedReply(mReplies);
+}
+
+void ClientDecoder::receiveDeleteSprite(ds::DataBuffer& data) {
+	// First data is the count
+	if(!data.canRead<size_t>()) return;
+
+	const size_t			size = data.read<size_t>();
+	for(size_t k = 0; k < size; ++k) {
+		if(!data.canRead<sprite_id_t>()) break;
+
+		// Stale ids (already deleted here) come back null
+		ds::ui::Sprite*		s = mEngine.findSprite(data.read<sprite_id_t>());
+		if(s) s->release();
+	}
+	if(!data.canRead<char>()) {
+		DS_LOG_ERROR("ClientDecoder::receiveDeleteSprite() no space for an ending terminator");
+		return;
+	}
+	if(data.read<char>() != ds::TERMINATOR_CHAR) {
+		DS_LOG_ERROR("ClientDecoder::receiveDeleteSprite() no ending terminator");
+	}
+}
+
 
 } // namespace ds
\ No newline at end of file
@@ -2,6 +2,13 @@
 #ifndef DS_APP_ENGINE_ENGINEIO_H_
 #define DS_APP_ENGINE_ENGINEIO_H_
 
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ds/app/app_defs.h"
+#include "ds/app/blob_reader.h"
+#include "ds/app/engine/engine_replay.h"
 #include "ds/data/data_buffer.h"
 #include "ds/query/recycle_array.h"
 #include "ds/network/net_connection.h"
@@ -12,8 +19,11 @@
  */
 
 namespace ds {
-class BlobReader;
 class BlobRegistry;
+namespace ui {
+class Sprite;
+class SpriteEngine;
+}
 
 /**
  * \class ds::EngineSender
@@ -24,14 +34,35 @@ public:
 	EngineSender(ds::NetConnection&, const bool useChunker);
 
 	void						setPacketNumber(unsigned int packetId);
+	/// When chunking, add a parity chunk for every span data chunks. 0 for none.
+	void						setParitySpan(const unsigned span);
+	/// When chunking, send chunks of a recent group again. A count of 0 is all of its
+	/// data chunks. Answers how many were still around to send.
+	int							resend(const unsigned groupId, const unsigned first, const unsigned count);
+
+	struct Stats {
+		unsigned long long		mDataBytes;
+		unsigned long long		mParityBytes;
+		unsigned long long		mResentBytes;
+	};
+	/// Bytes of chunks sent, when chunking
+	Stats						getStats() const;
+
+	/// Write everything sent from now on to a file, whether or not the connection is up
+	bool						startRecording(const std::string& path, const std::vector<RootList::Root>&);
+	void						stopRecording();
 
 private:
 	ds::NetConnection&			mConnection;
 	ds::DataBuffer				mSendBuffer;
 	RecycleArray<char>			mRawDataBuffer;
 	std::string					mCompressionBuffer;
+	ds::net::Chunker			mChunker;
 	unsigned int				mPacketId;
 	bool						mUseChunker;
+	unsigned long long			mResentBytes;
+	std::unique_ptr<ReplicationRecorder>
+								mRecorder;
 
 public:
 	class AutoSend {
@@ -66,9 +97,23 @@ public:
 	// receive and handle the data. Answer true if there was data.
 	bool						receiveBlob();
 	bool						handleBlob(ds::BlobRegistry&, ds::BlobReader&, bool& morePacketsAvailable);
+	/// Queue an uncompressed blob as if it had just come off the connection, for replaying recordings
+	void						addBlob(std::string& blob);
 	bool						hasLostConnection() const;
 	void						clearLostConnection();
 
+	/// When chunking, hand out groups in order, holding them up to delay groups for a
+	/// missing one to be resent. Each group is asked for at most attempts times.
+	/// A delay of 0 hands out groups as they complete and never asks for anything.
+	void						setRecovery(const unsigned delay, const unsigned attempts);
+	/// Add what to ask the sender to resend, see ds::net::DeChunker::getMissing()
+	void						getMissing(std::vector<ds::net::ChunkRange>&);
+	/// Groups that were lost for good since the last clearLostGroups()
+	unsigned					getLostGroups() const;
+	void						clearLostGroups();
+	const ds::net::DeChunker::Stats&
+								getChunkStats() const { return mDechunker.getStats(); }
+
 private:
 	ds::DataBuffer				mCurrentDataBuffer;
 	ds::NetConnection&			mConnection;
@@ -89,7 +134,105 @@ private:
 	// in which case we can run through and update all the buffers at once and catch up
 	std::vector<std::string>	mReceiveBuffers;
 	ds::net::DeChunker			mDechunker;
+	std::string					mGroupBuffer;
 	bool						mUseChunker;
+	unsigned					mNackAttempts;
+	unsigned					mLostBase;
+};
+
+/**
+ * \class ds::ServerEncoder
+ * Writes the blobs EngineServer sends: the header, the world command, root changes and
+ * deleted sprites. The server's states write through it, so anything standing in for a
+ * server, like a test recording a session, sends exactly the same bytes.
+ */
+class ServerEncoder {
+public:
+	ServerEncoder();
+
+	/// Adds the server's blobs, exactly what ClientDecoder::install() adds and in its order,
+	/// so the sprite types installed after them get the same ids
+	void						install(ds::BlobRegistry&,
+										const std::function<void(BlobReader&)>& header,
+										const std::function<void(BlobReader&)>& command,
+										const std::function<void(BlobReader&)>& deleteSprite,
+										const std::function<void(BlobReader&)>& clientStatus,
+										const std::function<void(BlobReader&)>& clientInput);
+	char						getHeaderBlob() const { return mHeaderBlob; }
+	char						getCommandBlob() const { return mCommandBlob; }
+	char						getClientStatusBlob() const { return mClientStatusBlob; }
+	char						getClientInputBlob() const { return mClientInputBlob; }
+
+	void						addHeader(ds::DataBuffer&, const int32_t frame) const;
+	/// The header and CMD_SERVER_SEND_WORLD. Follow it with every synchronized root as a world root.
+	void						addWorld(ds::DataBuffer&) const;
+	/// The whole tree for a world, otherwise only what changed
+	void						addRoot(ds::DataBuffer&, ds::ui::Sprite&, const bool world) const;
+	void						addDeletedSprites(ds::DataBuffer&, const std::vector<sprite_id_t>&) const;
+
+private:
+	char						mHeaderBlob;
+	char						mCommandBlob;
+	char						mDeleteSpriteBlob;
+	char						mClientStatusBlob;
+	char						mClientInputBlob;
+};
+
+/**
+ * \class ds::ClientDecoder
+ * The client side of the blobs EngineServer sends: the header, commands and deleted sprites,
+ * read off an EngineReceiver. EngineClient decodes the network through it and ReplicationPlayer
+ * decodes recordings through it. What the world and the started reply do is up to the owner.
+ */
+class ClientDecoder {
+public:
+	class StartedReply {
+	public:
+		StartedReply();
+		std::string				mGlobalId;
+		int32_t					mSessionId;
+		bool					mHasRoots;
+		std::vector<RootList::Root>	mRoots;
+	};
+
+	ClientDecoder(ds::ui::SpriteEngine&, EngineReceiver&);
+
+	/// Adds the client's blobs, exactly what ServerEncoder::install() adds and in its order,
+	/// so the sprite types installed after them get the same ids
+	void						install(ds::BlobRegistry&);
+	char						getCommandBlob() const { return mCommandBlob; }
+	char						getClientStatusBlob() const { return mClientStatusBlob; }
+	char						getClientInputBlob() const { return mClientInputBlob; }
+
+	/// Hand every blob the receiver has waiting to the registry. Only the header and command
+	/// are read until the world arrives, if headerAndCommandOnly. Answers false if nothing was waiting.
+	bool						decode(ds::BlobRegistry&, const bool headerAndCommandOnly);
+
+	/// The most recent frame received from the server
+	int32_t						getServerFrame() const { return mServerFrame; }
+	void						setServerFrame(const int32_t frame) { mServerFrame = frame; }
+
+	/// CMD_SERVER_SEND_WORLD arrived. Answer true to read the sprites that come with it.
+	std::function<bool()>		mOnWorld;
+	/// CMD_CLIENT_STARTED_REPLY arrived, with an entry for each client the server answered
+	std::function<void(const std::vector<StartedReply>&)>
+								mOnStartedReply;
+
+private:
+	void						receiveHeader(ds::DataBuffer&);
+	void						receiveCommand(ds::DataBuffer&);
+	void						receiveStartedReply(ds::DataBuffer&);
+	void						receiveDeleteSprite(ds::DataBuffer&);
+
+	ds::ui::SpriteEngine&		mEngine;
+	EngineReceiver&				mReceiver;
+	ds::BlobReader				mReader;
+	char						mHeaderBlob;
+	char						mCommandBlob;
+	char						mClientStatusBlob;
+	char						mClientInputBlob;
+	int32_t						mServerFrame;
+	std::vector<StartedReply>	mReplies;
 };
 
 } // namespace ds
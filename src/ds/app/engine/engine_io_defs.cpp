@@ -25,6 +25,7 @@ const char			CMD_CLIENT_STARTED_REPLY = 2;
 const char			CMD_CLIENT_STARTED = 3;
 const char			CMD_CLIENT_REQUEST_WORLD = 4;
 const char			CMD_CLIENT_RUNNING = 5;
+const char			CMD_CLIENT_NACK = 6;
 
 const char			ATT_CLIENT = 1;
 const char			ATT_GLOBAL_ID = 2;
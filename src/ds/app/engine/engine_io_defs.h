@@ -21,6 +21,9 @@ extern const char				CMD_CLIENT_REQUEST_WORLD;	// The client is requesting the e
 
 extern const char				CMD_CLIENT_RUNNING;			// A general heartbeat from the client.
 
+extern const char				CMD_CLIENT_NACK;			// The client is asking for lost chunks to be sent again,
+															// as a count then group, first chunk, chunk count for each.
+
 // ATTRIBUTES
 extern const char				ATT_CLIENT;					// Header for a client, which might have: ATT_GLOBAL_ID, ATT_SESSION_ID
 extern const char				ATT_GLOBAL_ID;				// A string, which is a GUID
@@ -0,0 +1,253 @@
+#include "stdafx.h"
+
+#include "ds/app/engine/engine_replay.h"
+
+#include <cstring>
+#include "ds/app/engine/engine_io.h"
+#include "ds/debug/logger.h"
+#include "ds/network/udp_connection.h"
+#include "ds/ui/sprite/sprite.h"
+#include "ds/ui/sprite/sprite_engine.h"
+#include "ds/util/fnv_hash.h"
+
+namespace ds {
+
+namespace {
+const char					MAGIC[4] = { 'D', 'S', 'R', 'R' };
+const uint32_t				VERSION = 1;
+
+template <typename T>
+void						write_value(std::ofstream& f, const T& v) {
+	f.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+template <typename T>
+bool						read_value(std::ifstream& f, T& v) {
+	f.read(reinterpret_cast<char*>(&v), sizeof(T));
+	return f.gcount() == sizeof(T);
+}
+
+void						hash_sprite(uint64_t& h, ds::ui::Sprite& s) {
+	fnv_hash_value(h, s.getId());
+	fnv_hash_value(h, s.getPosition());
+	fnv_hash_value(h, s.getScale());
+	fnv_hash_value(h, s.getRotation());
+	fnv_hash_value(h, s.getWidth());
+	fnv_hash_value(h, s.getHeight());
+	fnv_hash_value(h, s.getColor());
+	fnv_hash_value(h, s.getOpacity());
+	fnv_hash_value(h, s.visible());
+
+	const std::vector<ds::ui::Sprite*>	children = s.getChildren();
+	fnv_hash_value(h, children.size());
+	for(auto it = children.begin(), end = children.end(); it != end; ++it) {
+		if(*it) hash_sprite(h, **it);
+	}
+}
+}
+
+/**
+ * \class ds::ReplicationRecorder
+ */
+ReplicationRecorder::ReplicationRecorder()
+		: mFrames(0) {
+}
+
+bool ReplicationRecorder::open(const std::string& path, const std::vector<RootList::Root>& roots) {
+	close();
+	mFile.open(path.c_str(), std::ios::binary | std::ios::out | std::ios::trunc);
+	if(!mFile.is_open()) {
+		DS_LOG_WARNING_M("ReplicationRecorder can't open " << path, ds::IO_LOG);
+		return false;
+	}
+
+	mFile.write(MAGIC, sizeof(MAGIC));
+	write_value(mFile, VERSION);
+	write_value(mFile, static_cast<uint32_t>(roots.size()));
+	for(auto it = roots.begin(), end = roots.end(); it != end; ++it) {
+		write_value(mFile, static_cast<int32_t>(it->mRootId));
+		write_value(mFile, static_cast<int32_t>(it->mType));
+	}
+
+	mStart = std::chrono::steady_clock::now();
+	mFrames = 0;
+	DS_LOG_INFO_M("Recording replication to " << path, ds::IO_LOG);
+	return true;
+}
+
+void ReplicationRecorder::close() {
+	if(mFile.is_open()) mFile.close();
+}
+
+void ReplicationRecorder::write(const char* data, const size_t size) {
+	if(!mFile.is_open() || !data || size < 1) return;
+
+	const double			seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - mStart).count();
+	write_value(mFile, seconds);
+	write_value(mFile, static_cast<uint32_t>(size));
+	mFile.write(data, size);
+	++mFrames;
+}
+
+/**
+ * \class ds::ReplicationReplayer::Stats
+ */
+ReplicationReplayer::Stats::Stats()
+		: mFrames(0)
+		, mBytes(0)
+		, mDecodeSeconds(0.0)
+		, mPeakSprites(0) {
+}
+
+/**
+ * \class ds::ReplicationReplayer
+ */
+ReplicationReplayer::ReplicationReplayer()
+		: mPendingTime(0.0)
+		, mHasPending(false)
+		, mDone(true) {
+}
+
+bool ReplicationReplayer::open(const std::string& path) {
+	mFile.close();
+	mRoots.clear();
+	mHasPending = false;
+	mDone = true;
+	mStats = Stats();
+
+	mFile.open(path.c_str(), std::ios::binary | std::ios::in);
+	if(!mFile.is_open()) {
+		DS_LOG_WARNING_M("ReplicationReplayer can't open " << path, ds::IO_LOG);
+		return false;
+	}
+
+	char					magic[4];
+	uint32_t				version = 0,
+							rootCount = 0;
+	mFile.read(magic, sizeof(magic));
+	if(mFile.gcount() != sizeof(magic) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0
+			|| !read_value(mFile, version) || version != VERSION || !read_value(mFile, rootCount)) {
+		DS_LOG_WARNING_M("ReplicationReplayer " << path << " isn't a replication recording", ds::IO_LOG);
+		mFile.close();
+		return false;
+	}
+
+	for(uint32_t k = 0; k < rootCount; ++k) {
+		int32_t				id = 0,
+							type = 0;
+		if(!read_value(mFile, id) || !read_value(mFile, type)) break;
+		RootList::Root		root;
+		root.mRootId = id;
+		root.mType = (type == RootList::Root::kPerspective ? RootList::Root::kPerspective : RootList::Root::kOrtho);
+		mRoots.push_back(root);
+	}
+
+	mDone = false;
+	return true;
+}
+
+bool ReplicationReplayer::next(const double seconds, std::string& out) {
+	if(!mHasPending && !readNext()) return false;
+	if(seconds >= 0.0 && mPendingTime > seconds) return false;
+
+	out.swap(mPending);
+	mHasPending = false;
+	++mStats.mFrames;
+	mStats.mBytes += out.size();
+	return true;
+}
+
+bool ReplicationReplayer::readNext() {
+	if(mDone) return false;
+
+	uint32_t				size = 0;
+	if(!read_value(mFile, mPendingTime) || !read_value(mFile, size)) {
+		mDone = true;
+		return false;
+	}
+	mPending.resize(size);
+	if(size > 0) mFile.read(&mPending[0], size);
+	if(static_cast<uint32_t>(mFile.gcount()) != size) {
+		DS_LOG_WARNING_M("ReplicationReplayer recording is truncated", ds::IO_LOG);
+		mDone = true;
+		return false;
+	}
+	mHasPending = true;
+	return true;
+}
+
+uint64_t ReplicationReplayer::checksum(ds::ui::Sprite& s) {
+	uint64_t				h = FNV_OFFSET;
+	hash_sprite(h, s);
+	return h;
+}
+
+/**
+ * \class ds::ReplicationPlayer
+ */
+ReplicationPlayer::ReplicationPlayer(ds::ui::SpriteEngine& engine)
+		: mEngine(engine)
+		, mConnection(new ds::UdpConnection())
+		, mReceiver(new EngineReceiver(*mConnection, false))
+		, mDecoder(new ClientDecoder(engine, *mReceiver))
+		, mHaveWorld(false) {
+	mDecoder->install(mRegistry);
+	// The recording already has the roots, so the started reply is ignored
+	mDecoder->mOnWorld = [this]() {
+		for(auto it = mRoots.begin(), end = mRoots.end(); it != end; ++it) {
+			(*it)->clearChildren();
+		}
+		mHaveWorld = true;
+		return true;
+	};
+}
+
+ReplicationPlayer::~ReplicationPlayer() {
+	clearRoots();
+}
+
+bool ReplicationPlayer::open(const std::string& path) {
+	clearRoots();
+	mDecoder->setServerFrame(-1);
+	mHaveWorld = false;
+	if(!mReplayer.open(path)) return false;
+
+	const std::vector<RootList::Root>&	roots = mReplayer.getRoots();
+	for(auto it = roots.begin(), end = roots.end(); it != end; ++it) {
+		mRoots.push_back(new ds::ui::Sprite(mEngine, it->mRootId, it->mType == RootList::Root::kPerspective));
+	}
+	return true;
+}
+
+size_t ReplicationPlayer::play(const double seconds) {
+	size_t					played = 0;
+	const auto				start = std::chrono::steady_clock::now();
+	while(mReplayer.next(seconds, mBlob)) {
+		mReceiver->addBlob(mBlob);
+		mDecoder->decode(mRegistry, !mHaveWorld);
+		++played;
+	}
+	mReplayer.getStats().mDecodeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return played;
+}
+
+int32_t ReplicationPlayer::getServerFrame() const {
+	return mDecoder->getServerFrame();
+}
+
+uint64_t ReplicationPlayer::checksum() const {
+	uint64_t				checksum = 0;
+	for(auto it = mRoots.begin(), end = mRoots.end(); it != end; ++it) {
+		checksum = checksum * 31 + ReplicationReplayer::checksum(**it);
+	}
+	return checksum;
+}
+
+void ReplicationPlayer::clearRoots() {
+	for(auto it = mRoots.begin(), end = mRoots.end(); it != end; ++it) {
+		(*it)->release();
+	}
+	mRoots.clear();
+}
+
+} // namespace ds
@@ -0,0 +1,155 @@
+#pragma once
+#ifndef DS_APP_ENGINE_ENGINEREPLAY_H_
+#define DS_APP_ENGINE_ENGINEREPLAY_H_
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ds/app/app_defs.h"
+#include "ds/app/blob_reader.h"
+#include "ds/app/blob_registry.h"
+#include "ds/data/data_buffer.h"
+
+namespace ds {
+class ClientDecoder;
+class EngineReceiver;
+class UdpConnection;
+namespace ui {
+class Sprite;
+class SpriteEngine;
+}
+
+/**
+ * \class ds::ReplicationRecorder
+ * \brief Writes every blob an EngineSender sends to a file, uncompressed, with the
+ * seconds since recording started. The file starts with the replicated roots, so a
+ * ReplicationReplayer can rebuild them without the client-started handshake.
+ * Turned on for a server with "server:record_file" in the engine settings.
+ */
+class ReplicationRecorder {
+public:
+	ReplicationRecorder();
+
+	bool						open(const std::string& path, const std::vector<RootList::Root>&);
+	void						close();
+	bool						isOpen() const { return mFile.is_open(); }
+
+	void						write(const char* data, const size_t size);
+
+	size_t						getFrameCount() const { return mFrames; }
+
+private:
+	std::ofstream				mFile;
+	std::chrono::steady_clock::time_point
+								mStart;
+	size_t						mFrames;
+};
+
+/**
+ * \class ds::ReplicationReplayer
+ * \brief Reads a ReplicationRecorder file back one blob at a time. The caller decides
+ * when each blob is due, either by its timestamp (real time) or right away (as fast as
+ * they decode). Keeps the numbers a replay reports when it's done.
+ */
+class ReplicationReplayer {
+public:
+	ReplicationReplayer();
+
+	bool						open(const std::string& path);
+	bool						isOpen() const { return mFile.is_open(); }
+	bool						isDone() const { return mDone; }
+
+	const std::vector<RootList::Root>&
+								getRoots() const { return mRoots; }
+
+	/// Read the next blob into out if it was recorded at or before seconds. Pass a
+	/// negative time to ignore timestamps. Answer false when nothing is due or the file is done.
+	bool						next(const double seconds, std::string& out);
+
+	/// A hash of every sprite's id, geometry, color and visibility, in tree order.
+	/// The same session replayed twice, or received live, gives the same answer.
+	static uint64_t				checksum(ds::ui::Sprite&);
+
+	class Stats {
+	public:
+		Stats();
+		size_t					mFrames;
+		size_t					mBytes;
+		// Seconds spent decoding, in ClientDecoder::decode()
+		double					mDecodeSeconds;
+		size_t					mPeakSprites;
+	};
+	Stats&						getStats() { return mStats; }
+
+private:
+	bool						readNext();
+
+	std::ifstream				mFile;
+	std::vector<RootList::Root>	mRoots;
+	// The blob read ahead of time, waiting until it's due
+	std::string					mPending;
+	double						mPendingTime;
+	bool						mHasPending;
+	bool						mDone;
+	Stats						mStats;
+};
+
+/**
+ * \class ds::ReplicationPlayer
+ * \brief Plays a ReplicationRecorder file into a sprite tree on any SpriteEngine, with no
+ * app, window or GL, for tools and tests. It makes a plain sprite for each recorded root
+ * and decodes through the same EngineReceiver and ClientDecoder as EngineClient, off a
+ * connection that's never opened. Sprite types have to be installed on getRegistry() in the order the server
+ * installed them, the same as for a client. Sprite blobs are ignored until the recording
+ * sends the world, like a client waiting in its blank state.
+ */
+class ReplicationPlayer {
+public:
+	ReplicationPlayer(ds::ui::SpriteEngine&);
+	~ReplicationPlayer();
+
+	ds::BlobRegistry&			getRegistry() { return mRegistry; }
+
+	/// Opens the recording and makes its roots, throwing out any from before
+	bool						open(const std::string& path);
+	bool						isDone() const { return mReplayer.isDone(); }
+
+	/// Decode every blob recorded at or before seconds, or all the rest with a negative
+	/// time. Answers how many were decoded.
+	size_t						play(const double seconds);
+	size_t						playAll() { return play(-1.0); }
+
+	size_t						getRootCount() const { return mRoots.size(); }
+	ds::ui::Sprite&				getRoot(const size_t index) const { return *mRoots[index]; }
+	/// ReplicationReplayer::checksum() of the roots combined in order, as a client reports it
+	uint64_t					checksum() const;
+	int32_t						getServerFrame() const;
+	const ReplicationReplayer::Stats&
+								getStats() { return mReplayer.getStats(); }
+
+private:
+	ReplicationPlayer(const ReplicationPlayer&);
+	ReplicationPlayer&			operator=(const ReplicationPlayer&);
+
+	void						clearRoots();
+
+	ds::ui::SpriteEngine&		mEngine;
+	ReplicationReplayer			mReplayer;
+	ds::BlobRegistry			mRegistry;
+	std::unique_ptr<ds::UdpConnection>
+								mConnection;
+	std::unique_ptr<EngineReceiver>
+								mReceiver;
+	std::unique_ptr<ClientDecoder>
+								mDecoder;
+	std::vector<ds::ui::Sprite*>	mRoots;
+	std::string					mBlob;
+	bool						mHaveWorld;
+};
+
+} // namespace ds
+
+#endif // DS_APP_ENGINE_ENGINEREPLAY_H_
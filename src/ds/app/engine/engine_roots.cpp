@@ -38,8 +38,13 @@ OrthRoot::OrthRoot(Engine& e, const RootList::Root& r, const sprite_id_t id)
 		, mDstRect(0.0f, 0.0f, -1.0f, -1.0f)
 		, mNearPlane(-1.0f)
 		, mFarPlane(1.0f)
+		, mUseDrawList(false)
+		, mCull(false)
+		, mViewRect(0.0f, 0.0f, 0.0f, 0.0f)
 {
 	mSprite->setSecondBeforeIdle(mEngine.getSettings("engine").getDouble("idle_time"));
+	mUseDrawList = mEngine.getSettings("engine").getBool("render:draw_list");
+	mCull = mEngine.getSettings("engine").getBool("render:cull_offscreen");
 }
 
 void OrthRoot::setup(const Settings& s) {
@@ -84,8 +89,17 @@ void OrthRoot::drawClient(const DrawParams& p, AutoDrawService* auto_draw) {
 
 	ci::gl::ScopedDepth depthScope( false );
 
+	DrawParams params = p;
+	params.mCull = mCull && mViewRect.getWidth() > 0.0f && mViewRect.getHeight() > 0.0f;
+	params.mCullRect = mViewRect;
+
 	ci::mat4 m = ci::gl::getModelMatrix();
-	mSprite->drawClient(m, p);
+	if (mUseDrawList) {
+		mDrawList.compile(*mSprite, m, params);
+		mDrawList.draw();
+	} else {
+		mSprite->drawClient(m, params);
+	}
 
 	if (auto_draw) auto_draw->drawClient(m, p);
 }
@@ -98,8 +112,12 @@ void OrthRoot::drawServer(const DrawParams& p) {
 
 	ci::gl::ScopedDepth depthScope( false );
 
+	DrawParams params = p;
+	params.mCull = mCull && mViewRect.getWidth() > 0.0f && mViewRect.getHeight() > 0.0f;
+	params.mCullRect = mViewRect;
+
 	ci::mat4 m = ci::gl::getModelMatrix();
-	mSprite->drawServer(m, p);
+	mSprite->drawServer(m, params);
 }
 
 ui::Sprite* OrthRoot::getHit(const ci::vec3& point) {
@@ -111,9 +129,11 @@ void OrthRoot::setCinderCamera() {
 
 	if(getBuilder().mDrawScaled) {
 		mCamera.setOrtho(mSrcRect.x1, mSrcRect.x2, mSrcRect.y2, mSrcRect.y1, mNearPlane, mFarPlane);
+		mViewRect = mSrcRect;
 	}
 	else {
 		mCamera.setOrtho(0.0f, mDstRect.getWidth(), mDstRect.getHeight(), 0.0f, mNearPlane, mFarPlane);
+		mViewRect = ci::Rectf(0.0f, 0.0f, mDstRect.getWidth(), mDstRect.getHeight());
 	}
 }
 
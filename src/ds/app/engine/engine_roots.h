@@ -6,6 +6,7 @@
 #include "ds/app/app_defs.h"
 #include "ds/cfg/settings.h"
 #include "ds/ui/sprite/sprite.h"
+#include "ds/ui/sprite/util/sprite_draw_list.h"
 #include "ds/params/camera_params.h"
 #include "ds/params/draw_params.h"
 #include "ds/params/update_params.h"
@@ -106,6 +107,13 @@ private:
 	float							mNearPlane;
 	float							mFarPlane;
 
+	// "render:draw_list"
+	bool							mUseDrawList;
+	ds::ui::SpriteDrawList			mDrawList;
+	// "render:cull_offscreen", and what the camera shows
+	bool							mCull;
+	ci::Rectf						mViewRect;
+
 };
 
 /**
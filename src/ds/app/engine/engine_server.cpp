@@ -2,9 +2,12 @@
 
 #include "ds/app/engine/engine_server.h"
 
+#include <algorithm>
 #include <ds/app/engine/engine_io_defs.h>
 #include "ds/app/app.h"
 #include "ds/app/blob_reader.h"
+#include "ds/app/environment.h"
+#include "ds/debug/frame_profiler.h"
 #include "ds/debug/logger.h"
 #include "ds/util/string_util.h"
 #include "ds/debug/computer_info.h"
@@ -13,9 +16,7 @@
 namespace ds {
 
 namespace {
-char				HEADER_BLOB = 0;
 char				COMMAND_BLOB = 0;
-char				DELETE_SPRITE_BLOB = 0;
 
 // Used for clients to get info to the server
 char				CLIENT_STATUS_BLOB = 0;
@@ -24,6 +25,23 @@ char				CLIENT_STATUS_BLOB = 0;
 char				CLIENT_INPUT_BLOB = 0;
 
 const char			TERMINATOR = 0;
+
+// A range in a client's NACK: group, first chunk and chunk count
+typedef uint32_t	NackRange[3];
+
+// The roots a client builds to match this server
+std::vector<RootList::Root>	synchronized_roots(ds::Engine& engine) {
+	std::vector<RootList::Root>	roots;
+	const size_t rootCount = engine.getRootCount();
+	for(size_t i = 0; i < rootCount; i++){
+		if(!engine.getRootBuilder(i).mSyncronize) continue;
+		RootList::Root newRoot = RootList::Root();
+		newRoot.mRootId = engine.getRootBuilder(i).mRootId;
+		newRoot.mType = engine.getRootBuilder(i).mType;
+		roots.push_back(newRoot);
+	}
+	return roots;
+}
 }
 
 using namespace ci;
@@ -41,13 +59,16 @@ AbstractEngineServer::AbstractEngineServer(	ds::App& app, ds::EngineSettings& se
 	, mBlobReader(mReceiver.getData(), *this)
 	, mState(nullptr)
 {
-	// NOTE:  Must be EXACTLY the same items as in EngineClient, in same order,
-	// so that the BLOB ids match.
-	HEADER_BLOB = mBlobRegistry.add([this](BlobReader& r) {receiveHeader(r.mDataBuffer);});
-	COMMAND_BLOB = mBlobRegistry.add([this](BlobReader& r) {receiveCommand(r.mDataBuffer);});
-	DELETE_SPRITE_BLOB = mBlobRegistry.add([this](BlobReader& r) {receiveDeleteSprite(r.mDataBuffer);});
-	CLIENT_STATUS_BLOB = mBlobRegistry.add([this](BlobReader& r) {receiveClientStatus(r.mDataBuffer); });
-	CLIENT_INPUT_BLOB = mBlobRegistry.add([this](BlobReader& r) {receiveClientInput(r.mDataBuffer); });
+	// Must come before any sprite types, so the BLOB ids match the client's
+	mEncoder.install(mBlobRegistry,
+					 [this](BlobReader& r) {receiveHeader(r.mDataBuffer);},
+					 [this](BlobReader& r) {receiveCommand(r.mDataBuffer);},
+					 [this](BlobReader& r) {receiveDeleteSprite(r.mDataBuffer);},
+					 [this](BlobReader& r) {receiveClientStatus(r.mDataBuffer); },
+					 [this](BlobReader& r) {receiveClientInput(r.mDataBuffer); });
+	COMMAND_BLOB = mEncoder.getCommandBlob();
+	CLIENT_STATUS_BLOB = mEncoder.getClientStatusBlob();
+	CLIENT_INPUT_BLOB = mEncoder.getClientInputBlob();
 
 	try {
 		if (settings.getBool("server:connect", 0, true)) {
@@ -57,6 +78,13 @@ AbstractEngineServer::AbstractEngineServer(	ds::App& app, ds::EngineSettings& se
 	} catch (std::exception &e) {
 		DS_LOG_ERROR_M("EngineServer() initializing connection: " << e.what(), ds::ENGINE_LOG);
 	}
+	mSender.setParitySpan(static_cast<unsigned>(std::max(0, settings.getInt("server:parity_span", 0, 0))));
+
+	// Starts in the send world state, so every recording begins with the whole world
+	const std::string	recordFile(settings.getString("server:record_file", 0, ""));
+	if (!recordFile.empty()) {
+		mSender.startRecording(ds::Environment::expand(recordFile), synchronized_roots(*this));
+	}
 
 	setState(mSendWorldState);
 }
@@ -80,9 +108,13 @@ void AbstractEngineServer::setup(ds::App& app) {
 
 void AbstractEngineServer::update() {
 	mComputerInfo->update();
-	mWorkManager.update();
+	{
+		DS_PROFILE_ZONE("work_manager");
+		mWorkManager.update();
+	}
 	updateServer();
 
+	DS_PROFILE_ZONE("replication");
 	mState->update(*this);
 }
 
@@ -122,6 +154,8 @@ void AbstractEngineServer::receiveCommand(ds::DataBuffer &data) {
 			onClientStartedCommand(data);
 		} else if (cmd == CMD_CLIENT_RUNNING) {
 			onClientRunningCommand(data);
+		} else if (cmd == CMD_CLIENT_NACK) {
+			onClientNackCommand(data);
 		} else if (cmd == CMD_CLIENT_REQUEST_WORLD) {
 			DS_LOG_INFO_M("CMD_CLIENT_REQUEST_WORLD", ds::IO_LOG);
 			setState(mSendWorldState);
@@ -244,6 +278,24 @@ void AbstractEngineServer::onClientRunningCommand(ds::DataBuffer &data) {
 	mClients.reportingIn(session_id, frame);
 }
 
+void AbstractEngineServer::onClientNackCommand(ds::DataBuffer &data) {
+	if (!data.canRead<char>()) return;
+
+	char				att = data.read<char>();
+	if (att != ATT_SESSION_ID) return;
+	if (!data.canRead<int32_t>()) return;
+	data.read<int32_t>();
+
+	if (!data.canRead<int32_t>()) return;
+	const int32_t		count = data.read<int32_t>();
+	for (int32_t i = 0; i < count && data.canRead<NackRange>(); ++i) {
+		const uint32_t	group = data.read<uint32_t>();
+		const uint32_t	first = data.read<uint32_t>();
+		const uint32_t	chunks = data.read<uint32_t>();
+		mSender.resend(group, first, chunks);
+	}
+}
+
 void AbstractEngineServer::setState(State& s) {
 	if (&s == mState) return;
 
@@ -272,13 +324,6 @@ AbstractEngineServer::State::State() {
 void AbstractEngineServer::State::begin(AbstractEngineServer&) {
 }
 
-void AbstractEngineServer::State::addHeader(ds::DataBuffer& data, const int frame) {
-	data.add(HEADER_BLOB);
-
-	data.add(frame);
-	data.add(ds::TERMINATOR_CHAR);
-}
-
 /**
  * EngineServer::RunningState
  */
@@ -306,21 +351,16 @@ void EngineServer::RunningState::update(AbstractEngineServer& engine) {
 	{
 		EngineSender::AutoSend  send(engine.mSender);
 		// Always send the header
-		addHeader(send.mData, mFrame);
+		engine.mEncoder.addHeader(send.mData, mFrame);
 
 		const size_t numRoots = engine.getRootCount();
 		for(int i = 0; i < numRoots - 1; i++){
 			if(!engine.getRootBuilder(i).mSyncronize) continue;
-			ds::ui::Sprite& rooty = engine.getRootSprite(i);
-			if(rooty.isDirty()){
-				rooty.writeTo(send.mData);
-			}
+			engine.mEncoder.addRoot(send.mData, engine.getRootSprite(i), false);
 		}
 
-		if (!mDeletedSprites.empty()) {
-			addDeletedSprites(send.mData);
-			mDeletedSprites.clear();
-		}
+		engine.mEncoder.addDeletedSprites(send.mData, mDeletedSprites);
+		mDeletedSprites.clear();
 	}
 
 	// this receive call pulls everything it can off the wire and caches it
@@ -343,9 +383,20 @@ void EngineServer::RunningState::update(AbstractEngineServer& engine) {
 	// Track how far behind any clients are
 	engine.mClients.compare(mFrame);
 
+	if (mFrame > 0 && mFrame % 600 == 0) logTransportStats(engine);
+
 	mFrame++;
 }
 
+void EngineServer::RunningState::logTransportStats(AbstractEngineServer& engine) const {
+	const EngineSender::Stats	stats = engine.mSender.getStats();
+	if (stats.mDataBytes < 1 || (stats.mParityBytes < 1 && stats.mResentBytes < 1)) return;
+
+	const double				data = static_cast<double>(stats.mDataBytes);
+	DS_LOG_INFO_M("Replication sent " << stats.mDataBytes / 1024 << "KB, parity " << stats.mParityBytes * 100.0 / data
+				  << "% resent " << stats.mResentBytes * 100.0 / data << "% on top", ds::IO_LOG);
+}
+
 void EngineServer::RunningState::spriteDeleted(const ds::sprite_id_t &id) {
 	try {
 		mDeletedSprites.push_back(id);
@@ -353,17 +404,6 @@ void EngineServer::RunningState::spriteDeleted(const ds::sprite_id_t &id) {
 	}
 }
 
-void EngineServer::RunningState::addDeletedSprites(ds::DataBuffer &data) const {
-	if (mDeletedSprites.empty()) return;
-
-	data.add(DELETE_SPRITE_BLOB);
-	data.add(mDeletedSprites.size());
-	for (auto it=mDeletedSprites.begin(), end=mDeletedSprites.end(); it!=end; ++it) {
-		data.add(*it);
-	}
-	data.add(ds::TERMINATOR_CHAR);
-}
-
 /**
  * EngineServer::ClientStartedReplyState
  */
@@ -385,7 +425,7 @@ void EngineServer::ClientStartedReplyState::update(AbstractEngineServer& engine)
 		EngineSender::AutoSend  send(engine.mSender);
 		DS_LOG_INFO_M("Send ClientStartedReply " << std::time(0), ds::IO_LOG);
 		// Always send the header
-		addHeader(send.mData, -1);
+		engine.mEncoder.addHeader(send.mData, -1);
 		send.mData.add(COMMAND_BLOB);
 		send.mData.add(CMD_CLIENT_STARTED_REPLY);
 		// Send each client
@@ -400,18 +440,8 @@ void EngineServer::ClientStartedReplyState::update(AbstractEngineServer& engine)
 				send.mData.add(s->mSessionId);
 
 				send.mData.add(ATT_ROOTS);
-				size_t rootCount = engine.getRootCount();
-				int numActualRoots = 0;
-				std::vector<RootList::Root> roots;
-
-				for(size_t i = 0; i < rootCount; i++){
-					if(!engine.getRootBuilder(i).mSyncronize) continue;
-					numActualRoots++;
-					RootList::Root newRoot = RootList::Root();
-					newRoot.mRootId = engine.getRootBuilder(i).mRootId;
-					newRoot.mType = engine.getRootBuilder(i).mType;
-					roots.push_back(newRoot);
-				}
+				const std::vector<RootList::Root> roots = synchronized_roots(engine);
+				const int numActualRoots = static_cast<int>(roots.size());
 				if(numActualRoots > 0){
 					send.mData.add(numActualRoots);
 					for(int i = 0; i < numActualRoots; i++){
@@ -448,19 +478,12 @@ void EngineServer::SendWorldState::update(AbstractEngineServer& engine) {
 	{
 		EngineSender::AutoSend  send(engine.mSender);
 		DS_LOG_INFO_M("SEND WORLD " << std::time(0), ds::IO_LOG);
-		// Always send the header
-		addHeader(send.mData, -1);
-		send.mData.add(COMMAND_BLOB);
-		send.mData.add(CMD_SERVER_SEND_WORLD);
-		send.mData.add(ds::TERMINATOR_CHAR);
+		engine.mEncoder.addWorld(send.mData);
 
 		const size_t numRoots = engine.getRootCount();
 		for(size_t i = 0; i < numRoots - 1; i++){
 			if(!engine.getRootBuilder(i).mSyncronize) continue;
-			ds::ui::Sprite& rooty = engine.getRootSprite(i);
-			rooty.markTreeAsDirty();
-			rooty.writeTo(send.mData);
-			
+			engine.mEncoder.addRoot(send.mData, engine.getRootSprite(i), true);
 		}
 	}
 
@@ -474,6 +497,7 @@ EngineServer::EngineServer(	ds::App& app, ds::EngineSettings& settings,
 							ds::EngineData& ed, const ds::RootList& roots)
 	: inherited(app, settings, ed, roots)
 	, mLoadImageService(*this, mIpFunctions)
+	, mThumbnailService(*this)
 {
 }
 
@@ -9,6 +9,7 @@
 #include "ds/network/udp_connection.h"
 #include "ds/thread/work_manager.h"
 #include "ds/ui/service/load_image_service.h"
+#include "ds/ui/service/thumbnail_service.h"
 
 namespace ds {
 
@@ -49,6 +50,7 @@ private:
 	void							receiveClientInput(ds::DataBuffer&);
 	void							onClientStartedCommand(ds::DataBuffer&);
 	void							onClientRunningCommand(ds::DataBuffer&);
+	void							onClientNackCommand(ds::DataBuffer&);
 
 	virtual void					handleMouseTouchBegin(const ci::app::MouseEvent&, int id);
 	virtual void					handleMouseTouchMoved(const ci::app::MouseEvent&, int id);
@@ -63,6 +65,7 @@ private:
 	EngineSender					mSender;
 	EngineReceiver					mReceiver;
 	ds::BlobReader					mBlobReader;
+	ServerEncoder					mEncoder;
 
 	// STATES
 	class State {
@@ -71,9 +74,6 @@ private:
 		virtual void				begin(AbstractEngineServer&);
 		virtual void				update(AbstractEngineServer&) = 0;
 		virtual void				spriteDeleted(const ds::sprite_id_t&) { }
-
-	protected:
-		void						addHeader(ds::DataBuffer&, const int frame);
 	};
 
 	/* Default state: Gathers all changes in the app and sends them out each frame.
@@ -87,7 +87,7 @@ private:
 
 		std::vector<sprite_id_t>	mDeletedSprites;
 	private:
-		void						addDeletedSprites(ds::DataBuffer&) const;
+		void						logTransportStats(AbstractEngineServer&) const;
 
 		int32_t						mFrame;
 	};
@@ -133,10 +133,12 @@ public:
 	~EngineServer();
 
 	virtual ui::LoadImageService&	getLoadImageService()	{ return mLoadImageService; }
+	virtual ui::ThumbnailService&	getThumbnailService()	{ return mThumbnailService; }
 
 private:
 	typedef AbstractEngineServer inherited;
 	ui::LoadImageService			mLoadImageService;
+	ui::ThumbnailService			mThumbnailService;
 };
 
 } // namespace ds
@@ -171,6 +171,14 @@ void EngineSettings::setDefaults(){
 	getSetting("server:ip", 0, ds::cfg::SETTING_TYPE_STRING, "The multicast group udp address and port of the server", "239.255.42.58");
 	getSetting("server:send_port", 0, ds::cfg::SETTING_TYPE_INT, "The send port of the server. Match these between server and client", "1037", "1", "99999");
 	getSetting("server:listen_port", 0, ds::cfg::SETTING_TYPE_INT, "The listen port of the server (which is what the client sends on). Match these between server and client.", "1038", "1", "99999");
+	getSetting("server:record_file", 0, ds::cfg::SETTING_TYPE_STRING, "Servers only: write everything sent to clients to this file, to replay later with client:replay_file. Blank to not record.", "");
+	getSetting("client:replay_file", 0, ds::cfg::SETTING_TYPE_STRING, "Clients only: replay a file recorded with server:record_file instead of connecting to a server. Blank for a normal client.", "");
+	getSetting("client:replay_realtime", 0, ds::cfg::SETTING_TYPE_BOOL, "When replaying, true plays the recording back at the speed it was recorded, false decodes the whole recording in the first client frame, for timing and checksums.", "true");
+	getSetting("client:replay_quit", 0, ds::cfg::SETTING_TYPE_BOOL, "When replaying, quit once the recording is finished and the results are logged.", "false");
+	getSetting("server:parity_span", 0, ds::cfg::SETTING_TYPE_INT, "Servers only: send a parity chunk for every this many data chunks, so clients can rebuild one lost chunk out of each run without asking for it. 0 for no parity.", "0", "0", "64");
+	getSetting("client:nack_delay", 0, ds::cfg::SETTING_TYPE_INT, "Clients only: how many server frames to hold updates while asking the server to resend lost chunks. 0, the default, to never ask, and apply updates as they arrive. Around 10 recovers most loss on a busy network.", "0", "0", "60");
+	getSetting("client:nack_attempts", 0, ds::cfg::SETTING_TYPE_INT, "Clients only: how many times to ask for the same lost chunks.", "3", "1", "10");
+	getSetting("client:resync_after_lost", 0, ds::cfg::SETTING_TYPE_INT, "Clients only: request the whole world again once this many server frames have been lost for good. 0 to never.", "1", "0", "1000");
 	getSetting("platform:architecture", 0, ds::cfg::SETTING_TYPE_STRING, "If this is a server (world engine), a client (render engine) or both (world + render). clientserver is an EngineClientServer, which both displays content and can control other instances. standalone does not transmit or receive.", "standalone", "", "", "standalone, client, server, clientserver");
 	getSetting("platform:guid", 0, ds::cfg::SETTING_TYPE_STRING, "Unique identifier for network traffic (appended by additional unique values).", "Downstream");
 	getSetting("xml_importer:cache", 0, ds::cfg::SETTING_TYPE_BOOL, "If the xml importer should cache xml content or reload from disk each time", "true");
@@ -195,11 +203,16 @@ void EngineSettings::setDefaults(){
 	getSetting("camera:arrow_keys", 0, ds::cfg::SETTING_TYPE_FLOAT, "How much to step the camera when using the arrow keys. Set to a value above 0.025 to enable arrow key usage.", "30.0", "-1.0", "200.0");
 	getSetting("platform:mute", 0, ds::cfg::SETTING_TYPE_BOOL, "Mutes all video sound if true", "false");
 	getSetting("animation:duration", 0, ds::cfg::SETTING_TYPE_FLOAT, "Standard duration for animations", "0.35", "0.0", "10.0");
+	getSetting("render:draw_list", 0, ds::cfg::SETTING_TYPE_BOOL, "Draw ortho roots through a compiled draw list that batches plain rectangles and images into fewer draw calls.", "false");
+	getSetting("render:cull_offscreen", 0, ds::cfg::SETTING_TYPE_BOOL, "Skip drawing sprites (and their children) that are entirely outside the window or a clipping parent. Sprites with no size are always drawn.", "false");
+	getSetting("shader:async_compile", 0, ds::cfg::SETTING_TYPE_BOOL, "Compile sprite shaders on a background GL thread. Sprites draw with the default shader until theirs is ready.", "true");
+	getSetting("shader:manifest", 0, ds::cfg::SETTING_TYPE_STRING, "A text file listing shaders to compile at startup, one path (without .vert/.frag) per line, optionally followed by defines", "");
 
 	getSetting("TOUCH SETTINGS", 0, ds::cfg::SETTING_TYPE_SECTION_HEADER, "");
 	getSetting("touch:mode", 0, ds::cfg::SETTING_TYPE_STRING, "Set the current touch mode: Tuio, TuioAndMouse, System, SystemAndMouse, All.", "SystemAndMouse", "", "", "Tuio, TuioAndMouse, System, SystemAndMouse, All");
 	getSetting("touch:tuio:port", 0, ds::cfg::SETTING_TYPE_INT, "UDP Port to listen to tuio stream.", "3333", "1", "9999");
 	getSetting("touch:tuio:receive_objects", 0, ds::cfg::SETTING_TYPE_BOOL, "Will allow tuio to receive object data.", "false");
+	getSetting("touch:tuio:batched_ingest", 0, ds::cfg::SETTING_TYPE_BOOL, "Receive tuio cursors on a dedicated thread with batched, allocation-free reads. Ignored if receive_objects is on.", "false");
 	getSetting("touch:override_translation", 0, ds::cfg::SETTING_TYPE_BOOL, "Override the built-in touch scale and offset parsing. It's uncommon you'll need to do this. Default is to use the built-in Cinder touch translation, which is generally correct if the window is the same pixel size as the main screen and not scaled at all.", "false");
 	getSetting("touch:dimensions", 0, ds::cfg::SETTING_TYPE_VEC2, "How large in screen pixels the touch input stream covers", "1920, 1080");
 	getSetting("touch:offset", 0, ds::cfg::SETTING_TYPE_VEC2, "How much to offset touch input in pixels", "0, 0");
@@ -222,7 +235,23 @@ void EngineSettings::setDefaults(){
 	getSetting("resource_db", 0, ds::cfg::SETTING_TYPE_STRING, "Path of the database relative to the resource_location. E.g. ../db/database.sqlite");
 	getSetting("configuration_folder:allow_expand_override", 0, ds::cfg::SETTING_TYPE_BOOL, "Allows you to place any relative file in a configuration folder. For instance, you could have a layout file specific to a particular configuration.", "false");
 	getSetting("cms:url", 0, ds::cfg::SETTING_TYPE_STRING, "The URL of a Content Management System, set as DS_BASE_URL to use that env variable.", "DS_BASEURL");
-	getSetting("node:refresh_rate", 0, ds::cfg::SETTING_TYPE_FLOAT, "If your app uses a NodeWatcher, how often to check for node updates", "0.1", "0.001", "10.0");
+	getSetting("node:refresh_rate", 0, ds::cfg::SETTING_TYPE_FLOAT, "Unused, a NodeWatcher reads node updates as soon as they arrive", "0.1", "0.001", "10.0");
+
+	getSetting("THUMBNAIL SETTINGS", 0, ds::cfg::SETTING_TYPE_SECTION_HEADER, "");
+	getSetting("thumbnail:generate", 0, ds::cfg::SETTING_TYPE_BOOL, "Make and cache small copies of big images, so image sprites shown small don't decode the whole file", "false");
+	getSetting("thumbnail:levels", 0, ds::cfg::SETTING_TYPE_STRING, "Long edge in pixels of each cached copy, comma separated", "128, 256, 512, 1024");
+	getSetting("thumbnail:cache_folder", 0, ds::cfg::SETTING_TYPE_STRING, "Where the cached copies are written", "%LOCAL%/cache/thumbnails");
+	getSetting("thumbnail:cache_budget_mb", 0, ds::cfg::SETTING_TYPE_INT, "Least recently used copies are deleted to keep the cache under this size. 0 for no limit", "1024", "0", "100000");
+	getSetting("thumbnail:quality", 0, ds::cfg::SETTING_TYPE_FLOAT, "Jpeg quality of the cached copies", "0.85", "0.1", "1.0");
+	getSetting("thumbnail:max_simultaneous", 0, ds::cfg::SETTING_TYPE_INT, "How many images can be shrunk at once on worker threads", "2", "1", "16");
+
+	getSetting("HTTP SETTINGS", 0, ds::cfg::SETTING_TYPE_SECTION_HEADER, "");
+	getSetting("http:max_connections", 0, ds::cfg::SETTING_TYPE_INT, "How many connections the http service keeps open in total, for apps that use it", "16", "1", "256");
+	getSetting("http:max_host_connections", 0, ds::cfg::SETTING_TYPE_INT, "How many connections it opens to any one host. HTTP/2 hosts share one", "6", "1", "64");
+	getSetting("http:max_transfers", 0, ds::cfg::SETTING_TYPE_INT, "How many requests run at once, the rest wait their turn", "32", "1", "1024");
+	getSetting("http:cache", 0, ds::cfg::SETTING_TYPE_BOOL, "Keep GET replies with an ETag or Last-Modified on disk, and only download them again if they changed", "true");
+	getSetting("http:cache_folder", 0, ds::cfg::SETTING_TYPE_STRING, "Where the cached replies are written", "%LOCAL%/cache/http");
+	getSetting("http:cache_budget_mb", 0, ds::cfg::SETTING_TYPE_INT, "Least recently used replies are deleted to keep the cache under this size. 0 for no limit", "256", "0", "100000");
 
 	getSetting("LOGGER", 0, ds::cfg::SETTING_TYPE_SECTION_HEADER, "");
 	getSetting("logger:level", 0, ds::cfg::SETTING_TYPE_STRING, "What level of log to log.", "all", "", "", "all, none, info, warning, error, fatal");
@@ -231,6 +260,9 @@ void EngineSettings::setDefaults(){
 	getSetting("logger:file", 0, ds::cfg::SETTING_TYPE_STRING, "Filename and location", "%LOCAL%/logs/");
 	getSetting("logger:verbose_level", 0, ds::cfg::SETTING_TYPE_INT, "How much verbose output to log. 0=nothing, 9=everything", "0", "0", "9");
 
+	getSetting("PROFILER", 0, ds::cfg::SETTING_TYPE_SECTION_HEADER, "");
+	getSetting("profiler:enabled", 0, ds::cfg::SETTING_TYPE_BOOL, "Time the phases of each frame for the stats view. F9 or SIGUSR1 writes a chrome trace to the logs folder", "true");
+
 	getSetting("METRICS", 0, ds::cfg::SETTING_TYPE_SECTION_HEADER, "");
 	getSetting("metrics:active", 0, ds::cfg::SETTING_TYPE_BOOL, "Enable telegraf metrics sending", "true");
 	getSetting("metrics:send_base_info", 0, ds::cfg::SETTING_TYPE_BOOL, "Send common engine info like fps and number of sprites", "true");
@@ -238,6 +270,8 @@ void EngineSettings::setDefaults(){
 	getSetting("metrics:send_touch_info", 0, ds::cfg::SETTING_TYPE_BOOL, "Record touch data or not", "false");
 	getSetting("metrics:udp_host", 0, ds::cfg::SETTING_TYPE_STRING, "The host name to send udp metrics info to", "127.0.0.1");
 	getSetting("metrics:udp_port", 0, ds::cfg::SETTING_TYPE_STRING, "The port to send udp metrics info to", "8094");
+	getSetting("metrics:flush_interval", 0, ds::cfg::SETTING_TYPE_DOUBLE, "How often to send queued and aggregated metrics in seconds", "1.0", "0.01", "60");
+	getSetting("metrics:max_packet_size", 0, ds::cfg::SETTING_TYPE_INT, "Largest udp packet to send to telegraf in bytes. Keep this under the network MTU", "1400", "128", "65000");
 
 }
 
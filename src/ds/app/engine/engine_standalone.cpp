@@ -4,6 +4,7 @@
 
 #include "ds/app/app.h"
 
+#include <ds/debug/frame_profiler.h>
 #include <ds/debug/logger.h>
 #include <ds/debug/computer_info.h>
 
@@ -19,6 +20,7 @@ EngineStandalone::EngineStandalone(	ds::App& app, ds::EngineSettings& settings,
 									ds::EngineData& ed, const ds::RootList& roots)
 		: inherited(app, settings, ed, roots)
 		, mLoadImageService(*this, mIpFunctions)
+		, mThumbnailService(*this)
  {
 }
 
@@ -44,7 +46,10 @@ void EngineStandalone::setup(ds::App& app) {
 
 
 void EngineStandalone::update() {
-	mWorkManager.update();
+	{
+		DS_PROFILE_ZONE("work_manager");
+		mWorkManager.update();
+	}
 	mComputerInfo->update();
 	updateServer();
 }
@@ -5,6 +5,7 @@
 #include "ds/app/engine/engine.h"
 #include "ds/thread/work_manager.h"
 #include "ds/ui/service/load_image_service.h"
+#include "ds/ui/service/thumbnail_service.h"
 
 namespace ds {
 
@@ -20,6 +21,7 @@ public:
 
 	virtual ds::WorkManager&		getWorkManager()		{ return mWorkManager; }
 	virtual ui::LoadImageService&	getLoadImageService()	{ return mLoadImageService; }
+	virtual ui::ThumbnailService&	getThumbnailService()	{ return mThumbnailService; }
 
 	virtual void					installSprite(const std::function<void(ds::BlobRegistry&)>& asServer,
 													const std::function<void(ds::BlobRegistry&)>& asClient);
@@ -43,6 +45,7 @@ private:
 
 	WorkManager						mWorkManager;
 	ui::LoadImageService			mLoadImageService;
+	ui::ThumbnailService			mThumbnailService;
 };
 
 } // namespace ds
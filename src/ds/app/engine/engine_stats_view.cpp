@@ -5,7 +5,9 @@
 #include "ds/app/blob_reader.h"
 #include "ds/data/data_buffer.h"
 #include "engine_data.h"
+#include <iomanip>
 #include <ds/debug/computer_info.h>
+#include <ds/debug/frame_profiler.h>
 
 #pragma warning(disable: 4355)
 
@@ -113,6 +115,15 @@ void EngineStatsView::updateStats() {
 			ss << "<span weight='bold'>FPS:</span> " << fpsy << std::endl;
 		}
 
+		const auto zones = ds::debug::FrameProfiler::get().getStats();
+		if(!zones.empty()) {
+			ss << "<span weight='bold'>Frame ms (last / p50 / p95 / max):</span>" << std::endl;
+			ss << std::fixed << std::setprecision(2);
+			for(const auto& z : zones) {
+				ss << z.mName << ": " << z.mLastMs << " / " << z.mMedianMs << " / " << z.mP95Ms << " / " << z.mMaxMs << std::endl;
+			}
+		}
+
 		mText->setText(ss.str());
 
 		if(mBackground->getHeight() < mText->getPosition().y * 2.0f + mText->getHeight()){
@@ -0,0 +1,161 @@
+#include "stdafx.h"
+
+#include "ds/app/engine/sprite_id_table.h"
+
+#include "ds/debug/logger.h"
+
+namespace ds {
+
+namespace {
+const uint32_t				INDEX_MASK = (1u << SpriteIdTable::INDEX_BITS) - 1;
+const uint32_t				MAX_GENERATION = (1u << SpriteIdTable::GENERATION_BITS) - 1;
+// Slots aren't reused until this many are free. A client can still be holding a
+// deleted sprite for a frame or two, and this keeps its slot from being handed out again.
+const size_t				MIN_FREE = 1024;
+}
+
+/**
+ * \class ds::SpriteIdTable::Slot
+ */
+SpriteIdTable::Slot::Slot()
+		: mId(EMPTY_SPRITE_ID)
+		, mSprite(nullptr)
+		, mGeneration(0)
+		, mReserved(false)
+		, mQueued(false) {
+}
+
+/**
+ * \class ds::SpriteIdTable
+ */
+SpriteIdTable::SpriteIdTable()
+		: mSize(0) {
+}
+
+sprite_id_t SpriteIdTable::allocate() {
+	uint32_t					index = 0;
+	bool						found = false;
+	while(mFree.size() > MIN_FREE || (!mFree.empty() && mSlots.size() > INDEX_MASK)) {
+		index = mFree.front();
+		mFree.pop_front();
+		mSlots[index].mQueued = false;
+		// Taken by a hand-set id since it was freed. It's queued again when that id is erased.
+		if(mSlots[index].mSprite) continue;
+		found = true;
+		break;
+	}
+
+	if(!found) {
+		if(mSlots.size() > INDEX_MASK) {
+			DS_LOG_ERROR("SpriteIdTable::allocate() out of sprite ids");
+			return EMPTY_SPRITE_ID;
+		}
+		index = static_cast<uint32_t>(mSlots.size());
+		mSlots.push_back(Slot());
+	}
+
+	Slot&						slot = mSlots[index];
+	// Generation 0 is never given out, so a hand-picked id can't match one made here
+	slot.mGeneration = slot.mGeneration % MAX_GENERATION + 1;
+	slot.mReserved = true;
+	return static_cast<sprite_id_t>((slot.mGeneration << INDEX_BITS) | index);
+}
+
+void SpriteIdTable::insert(const sprite_id_t id, ds::ui::Sprite* sprite) {
+	if(id == EMPTY_SPRITE_ID) return;
+
+	if(!mOverflow.empty()) {
+		auto					found = mOverflow.find(id);
+		if(found != mOverflow.end()) {
+			found->second = sprite;
+			return;
+		}
+	}
+
+	if(id > 0) {
+		const uint32_t			index = indexOf(id);
+		if(index >= mSlots.size()) {
+			// A hand-set id past the end. The slots before it are free, not lost.
+			const uint32_t		first = static_cast<uint32_t>(mSlots.size());
+			mSlots.resize(index + 1);
+			for(uint32_t k = first; k < index; ++k) queue(k);
+		}
+		Slot&					slot = mSlots[index];
+		if(!slot.mSprite || slot.mId == id) {
+			if(!slot.mSprite) ++mSize;
+			slot.mId = id;
+			slot.mSprite = sprite;
+			return;
+		}
+	}
+
+	mOverflow[id] = sprite;
+	++mSize;
+}
+
+void SpriteIdTable::erase(const sprite_id_t id) {
+	if(id == EMPTY_SPRITE_ID) return;
+
+	if(id > 0) {
+		const uint32_t			index = indexOf(id);
+		if(index < mSlots.size() && mSlots[index].mSprite && mSlots[index].mId == id) {
+			mSlots[index].mSprite = nullptr;
+			mSlots[index].mId = EMPTY_SPRITE_ID;
+			--mSize;
+			release(id);
+			return;
+		}
+	}
+
+	if(!mOverflow.empty()) {
+		auto					found = mOverflow.find(id);
+		if(found != mOverflow.end()) {
+			mOverflow.erase(found);
+			--mSize;
+		}
+	}
+	if(id > 0) release(id);
+}
+
+ds::ui::Sprite* SpriteIdTable::find(const sprite_id_t id) const {
+	if(id > 0) {
+		const uint32_t			index = indexOf(id);
+		if(index < mSlots.size() && mSlots[index].mId == id) return mSlots[index].mSprite;
+	}
+
+	if(mOverflow.empty()) return nullptr;
+	auto						found = mOverflow.find(id);
+	if(found == mOverflow.end()) return nullptr;
+	return found->second;
+}
+
+uint32_t SpriteIdTable::indexOf(const sprite_id_t id) {
+	return static_cast<uint32_t>(id) & INDEX_MASK;
+}
+
+uint32_t SpriteIdTable::generationOf(const sprite_id_t id) {
+	return (static_cast<uint32_t>(id) >> INDEX_BITS) & MAX_GENERATION;
+}
+
+void SpriteIdTable::release(const sprite_id_t id) {
+	const uint32_t				index = indexOf(id);
+	if(index >= mSlots.size()) return;
+	Slot&						slot = mSlots[index];
+	if(slot.mReserved) {
+		// Still reserved for a different id from allocate()
+		if(slot.mGeneration != generationOf(id)) return;
+		slot.mReserved = false;
+	}
+	// A hand-set id or a second id on the same slot is still in it
+	if(slot.mSprite) return;
+	queue(index);
+}
+
+void SpriteIdTable::queue(const uint32_t index) {
+	Slot&						slot = mSlots[index];
+	if(slot.mQueued) return;
+	slot.mQueued = true;
+	mFree.push_back(index);
+}
+
+} // namespace ds
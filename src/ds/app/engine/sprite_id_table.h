@@ -0,0 +1,81 @@
+#pragma once
+#ifndef DS_APP_ENGINE_SPRITEIDTABLE_H_
+#define DS_APP_ENGINE_SPRITEIDTABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#include "ds/app/app_defs.h"
+
+namespace ds {
+namespace ui {
+class Sprite;
+}
+
+/**
+ * \class ds::SpriteIdTable
+ * \brief Maps sprite ids to sprites. The engine hands out ids as a slot index with a
+ * generation above it, so a lookup is an array index and a stale id (one whose slot has
+ * been reused) is told apart by its generation. Clients store the server's ids the same
+ * way, so they get the same lookups.
+ *
+ * Ids that don't fit the scheme (the negative root ids, or two live ids that land in the
+ * same slot, which a client can briefly see while a delete is on its way) go in a small
+ * map on the side, so every id still works.
+ *
+ * An id that was set by hand instead of made by allocate() still takes its slot, and the
+ * slot goes back on the free list once that id is erased, as do any slots skipped over to
+ * reach it. A slot is always reserved, holding a sprite, or on the free list.
+ */
+class SpriteIdTable {
+public:
+	static const int			INDEX_BITS = 20;
+	// Leaves the sign bit clear, so every id made here is positive
+	static const int			GENERATION_BITS = 11;
+
+	SpriteIdTable();
+
+	/// A new id. Its slot isn't reused until a sprite with the id has been erased.
+	sprite_id_t					allocate();
+
+	void						insert(const sprite_id_t, ds::ui::Sprite*);
+	void						erase(const sprite_id_t);
+	ds::ui::Sprite*				find(const sprite_id_t) const;
+
+	size_t						size() const { return mSize; }
+	bool						empty() const { return mSize == 0; }
+
+	static uint32_t				indexOf(const sprite_id_t);
+	static uint32_t				generationOf(const sprite_id_t);
+
+private:
+	class Slot {
+	public:
+		Slot();
+		sprite_id_t				mId;
+		ds::ui::Sprite*			mSprite;
+		// The last generation allocate() gave out for this slot
+		uint32_t				mGeneration;
+		// allocate() gave out mGeneration and it hasn't been erased yet
+		bool					mReserved;
+		// In mFree
+		bool					mQueued;
+	};
+
+	// The id is gone, give its slot back if nothing else holds it
+	void						release(const sprite_id_t);
+	void						queue(const uint32_t index);
+
+	std::vector<Slot>			mSlots;
+	// Oldest first, so a freed slot is reused as late as possible
+	std::deque<uint32_t>		mFree;
+	std::unordered_map<sprite_id_t, ds::ui::Sprite*>
+								mOverflow;
+	size_t						mSize;
+};
+
+} // namespace ds
+
+#endif // DS_APP_ENGINE_SPRITEIDTABLE_H_
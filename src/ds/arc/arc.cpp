@@ -25,6 +25,16 @@ void Arc::renderCircle(const Input&, RenderCircleParams&) const
 {
 }
 
+bool Arc::compileCircle(const Input&, const RenderCircleParams&, CircleProgram&) const
+{
+	return false;
+}
+
+bool Arc::compileRun(const Input&, std::vector<CircleOp>&) const
+{
+	return false;
+}
+
 void Arc::readXml(const ci::XmlTree&)
 {
 }
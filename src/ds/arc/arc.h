@@ -3,10 +3,13 @@
 #define DS_ARC_ARC_H_
 
 #include <string>
+#include <vector>
 #include <cinder/Xml.h>
 
 namespace ds {
 namespace arc {
+class CircleOp;
+class CircleProgram;
 class Input;
 class RenderCircleParams;
 
@@ -24,6 +27,13 @@ public:
 
 	virtual void				renderCircle(const Input&, RenderCircleParams&) const;
 
+	// Flatten renderCircle() into a program that renders a row at a time. Answer false
+	// if this arc can't be compiled, and the renderer will fall back to renderCircle().
+	virtual bool				compileCircle(const Input&, const RenderCircleParams&, CircleProgram&) const;
+	// Flatten run() into a list of ops. Answer false if this arc can't be compiled,
+	// and run() will be called for each pixel instead.
+	virtual bool				compileRun(const Input&, std::vector<CircleOp>&) const;
+
 	virtual void				readXml(const ci::XmlTree&);
 
 protected:
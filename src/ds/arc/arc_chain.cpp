@@ -2,6 +2,7 @@
 
 #include "ds/arc/arc_chain.h"
 
+#include "ds/arc/arc_circle_program.h"
 #include "ds/arc/arc_io.h"
 
 namespace ds {
@@ -29,6 +30,23 @@ void Chain::renderCircle(const Input& input, RenderCircleParams& p) const {
 	}
 }
 
+bool Chain::compileCircle(const Input& input, const RenderCircleParams& p, CircleProgram& prg) const {
+	for (auto it=mArc.begin(), end=mArc.end(); it!=end; ++it) {
+		const Arc*		a = it->get();
+		if (a && !a->compileCircle(input, p, prg)) return false;
+	}
+	return true;
+}
+
+bool Chain::compileRun(const Input& input, std::vector<CircleOp>& ops) const {
+	for (auto it=mArc.begin(), end=mArc.end(); it!=end; ++it) {
+		const Arc*		a = it->get();
+		if (!a) continue;
+		if (!a->compileRun(input, ops)) ops.push_back(CircleOp::call(a, input));
+	}
+	return true;
+}
+
 void Chain::readXml(const ci::XmlTree& xml) {
 	mArc.clear();
 
@@ -19,6 +19,8 @@ public:
 	
 	virtual double				run(const Input&, const double) const;
 	virtual void				renderCircle(const Input&, RenderCircleParams&) const;
+	virtual bool				compileCircle(const Input&, const RenderCircleParams&, CircleProgram&) const;
+	virtual bool				compileRun(const Input&, std::vector<CircleOp>&) const;
 
 	virtual void				readXml(const ci::XmlTree&);
 
@@ -0,0 +1,287 @@
+#include "stdafx.h"
+
+#include "ds/arc/arc_circle_program.h"
+
+#include <algorithm>
+#include <cmath>
+#include "ds/arc/arc.h"
+#include "ds/math/math_func.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DS_ARC_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace ds {
+namespace arc {
+
+namespace {
+
+// Same as the to_color(un_premult()) the per-pixel path uses
+inline uint8_t		to_channel(const float v, const float a) {
+	const float		straight = (a < 1.0f && a > 0.0f) ? v / a : v;
+	if (straight <= 0.0f) return 0;
+	if (straight >= 1.0f) return 255;
+	return static_cast<uint8_t>(straight*255.0f);
+}
+
+inline uint8_t		to_alpha(const float a) {
+	if (a <= 0.0f) return 0;
+	if (a >= 1.0f) return 255;
+	return static_cast<uint8_t>(a*255.0f);
+}
+
+#ifdef DS_ARC_SSE2
+inline __m128d		select_pd(const __m128d mask, const __m128d a, const __m128d b) {
+	return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+}
+
+inline __m128		select_ps(const __m128 mask, const __m128 a, const __m128 b) {
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+inline __m128		load_pd_as_ps(const double* src) {
+	return _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(src)), _mm_cvtpd_ps(_mm_loadu_pd(src + 2)));
+}
+#endif
+
+}
+
+/**
+ * ds::arc::CircleOp
+ */
+CircleOp::CircleOp()
+	: mType(MAP)
+	, mA(0.0)
+	, mB(0.0)
+	, mC(0.0)
+	, mD(0.0)
+	, mArc(nullptr)
+	, mInput(nullptr)
+{
+}
+
+CircleOp CircleOp::map(const double fromMin, const double fromMax, const double toMin, const double toMax) {
+	CircleOp		op;
+	op.mType = MAP;
+	op.mA = fromMin;
+	op.mB = fromMax;
+	op.mC = toMin;
+	op.mD = toMax;
+	return op;
+}
+
+CircleOp CircleOp::pow(const double exp) {
+	CircleOp		op;
+	op.mType = POW;
+	op.mA = exp;
+	return op;
+}
+
+CircleOp CircleOp::call(const Arc* a, const Input& input) {
+	CircleOp		op;
+	op.mType = CALL;
+	op.mArc = a;
+	op.mInput = &input;
+	return op;
+}
+
+/**
+ * ds::arc::CircleLayer
+ */
+CircleLayer::CircleLayer()
+	: mCenX(0.0)
+	, mCenY(0.0)
+	, mMaxDist(0.0)
+	, mDegreeInput(false)
+	, mR(0.0f)
+	, mG(0.0f)
+	, mB(0.0f)
+	, mA(1.0f)
+{
+}
+
+/**
+ * ds::arc::CircleProgram
+ */
+CircleProgram::CircleProgram()
+{
+}
+
+void CircleProgram::renderRow(const int y, const int width, const Layout& layout, Scratch& s, uint8_t* dst) const
+{
+	if (width < 1) return;
+	if (s.mDist.size() < static_cast<size_t>(width)) {
+		s.mDist.resize(width);
+		s.mValue.resize(width);
+		s.mR.resize(width);
+		s.mG.resize(width);
+		s.mB.resize(width);
+		s.mA.resize(width);
+	}
+	std::fill(s.mR.begin(), s.mR.begin() + width, 0.0f);
+	std::fill(s.mG.begin(), s.mG.begin() + width, 0.0f);
+	std::fill(s.mB.begin(), s.mB.begin() + width, 0.0f);
+	std::fill(s.mA.begin(), s.mA.begin() + width, 0.0f);
+
+	for (auto it=mLayers.begin(), end=mLayers.end(); it!=end; ++it) {
+		renderLayer(*it, static_cast<double>(y), width, s);
+	}
+
+	// Convert to 8 bit, un-premultiplying the colour
+	int				x = 0;
+#ifdef DS_ARC_SSE2
+	const __m128	zero = _mm_setzero_ps(),
+					one = _mm_set1_ps(1.0f),
+					scale = _mm_set1_ps(255.0f);
+	for (; x + 4 <= width; x += 4) {
+		const __m128	a = _mm_loadu_ps(&s.mA[x]);
+		const __m128	premult = _mm_and_ps(_mm_cmplt_ps(a, one), _mm_cmpgt_ps(a, zero));
+		__m128			clr[4];
+		clr[0] = _mm_loadu_ps(&s.mR[x]);
+		clr[1] = _mm_loadu_ps(&s.mG[x]);
+		clr[2] = _mm_loadu_ps(&s.mB[x]);
+		for (int c=0; c<3; ++c) clr[c] = select_ps(premult, _mm_div_ps(clr[c], a), clr[c]);
+		clr[3] = a;
+
+		int32_t			out[4][4];
+		for (int c=0; c<4; ++c) {
+			const __m128	v = _mm_mul_ps(_mm_min_ps(_mm_max_ps(clr[c], zero), one), scale);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out[c]), _mm_cvttps_epi32(v));
+		}
+		for (int k=0; k<4; ++k) {
+			uint8_t*	pix = dst + (x + k)*layout.mPixelInc;
+			pix[layout.mRed] = static_cast<uint8_t>(out[0][k]);
+			pix[layout.mGreen] = static_cast<uint8_t>(out[1][k]);
+			pix[layout.mBlue] = static_cast<uint8_t>(out[2][k]);
+			if (layout.mAlpha >= 0) pix[layout.mAlpha] = static_cast<uint8_t>(out[3][k]);
+		}
+	}
+#endif
+	for (; x < width; ++x) {
+		const float		a = s.mA[x];
+		uint8_t*		pix = dst + x*layout.mPixelInc;
+		pix[layout.mRed] = to_channel(s.mR[x], a);
+		pix[layout.mGreen] = to_channel(s.mG[x], a);
+		pix[layout.mBlue] = to_channel(s.mB[x], a);
+		if (layout.mAlpha >= 0) pix[layout.mAlpha] = to_alpha(a);
+	}
+}
+
+void CircleProgram::renderLayer(const CircleLayer& layer, const double y, const int width, Scratch& s) const
+{
+	const double		maxDist = layer.mMaxDist;
+	if (!(maxDist > 0.0)) return;
+
+	// ds::math::dist(cenx, ceny, x, y) measures from (cenx, x) to (ceny, y), so the
+	// first term is constant for the whole image. Match it so the output doesn't change.
+	const double		a = layer.mCenY - layer.mCenX,
+						aa = a*a;
+	double*				dist = s.mDist.data();
+	double*				value = s.mValue.data();
+
+	// Distance and unit distance
+	int					x = 0;
+#ifdef DS_ARC_SSE2
+	{
+		const __m128d	aa2 = _mm_set1_pd(aa),
+						y2 = _mm_set1_pd(y),
+						step = _mm_set1_pd(2.0),
+						max2 = _mm_set1_pd(maxDist),
+						zero = _mm_setzero_pd(),
+						one = _mm_set1_pd(1.0);
+		__m128d			x2 = _mm_set_pd(1.0, 0.0);
+		for (; x + 2 <= width; x += 2) {
+			const __m128d	b = _mm_sub_pd(y2, x2);
+			const __m128d	d = _mm_sqrt_pd(_mm_add_pd(aa2, _mm_mul_pd(b, b)));
+			_mm_storeu_pd(dist + x, d);
+			const __m128d	unit = _mm_min_pd(_mm_max_pd(_mm_div_pd(d, max2), zero), one);
+			_mm_storeu_pd(value + x, _mm_sub_pd(one, unit));
+			x2 = _mm_add_pd(x2, step);
+		}
+	}
+#endif
+	for (; x < width; ++x) {
+		const double	b = y - static_cast<double>(x);
+		dist[x] = std::sqrt(aa + b*b);
+		value[x] = 1.0 - ds::math::clamp(dist[x] / maxDist, 0.0, 1.0);
+	}
+
+	if (layer.mDegreeInput) {
+		for (x = 0; x < width; ++x) {
+			value[x] = ds::math::clamp(ds::math::degree(static_cast<double>(x) - layer.mCenX, layer.mCenY - y) / 360.0, 0.0, 1.0);
+		}
+	}
+
+	// Value ops
+	for (auto it=layer.mOps.begin(), end=layer.mOps.end(); it!=end; ++it) {
+		const CircleOp&		op = *it;
+		if (op.mType == CircleOp::MAP) {
+			const double	fromRange = op.mB - op.mA,
+							toRange = op.mD - op.mC;
+			for (x = 0; x < width; ++x) {
+				double		v = value[x];
+				if (v < op.mA) v = op.mA;
+				else if (v > op.mB) v = op.mB;
+				value[x] = op.mC + (((v - op.mA) / fromRange) * toRange);
+			}
+		} else if (op.mType == CircleOp::POW) {
+			for (x = 0; x < width; ++x) value[x] = std::pow(value[x], op.mA);
+		} else if (op.mArc && op.mInput) {
+			for (x = 0; x < width; ++x) value[x] = op.mArc->run(*op.mInput, value[x]);
+		}
+	}
+
+	// Colour, antialias the edge, and composite src over
+	float*				r = s.mR.data();
+	float*				g = s.mG.data();
+	float*				b = s.mB.data();
+	float*				alpha = s.mA.data();
+	x = 0;
+#ifdef DS_ARC_SSE2
+	{
+		const __m128d	max2 = _mm_set1_pd(maxDist),
+						edge2 = _mm_set1_pd(maxDist - 1.0),
+						oned = _mm_set1_pd(1.0),
+						zerod = _mm_setzero_pd();
+		const __m128	zero = _mm_setzero_ps(),
+						one = _mm_set1_ps(1.0f),
+						lr = _mm_set1_ps(layer.mR),
+						lg = _mm_set1_ps(layer.mG),
+						lb = _mm_set1_ps(layer.mB),
+						la = _mm_set1_ps(layer.mA);
+		for (; x + 4 <= width; x += 4) {
+			// Coverage is 0 outside, the distance to the edge in the last pixel, and 1 everywhere else
+			double			cover[4];
+			for (int k=0; k<4; k += 2) {
+				const __m128d	d = _mm_loadu_pd(dist + x + k);
+				const __m128d	aa = select_pd(_mm_cmpgt_pd(d, edge2), _mm_sub_pd(max2, d), oned);
+				_mm_storeu_pd(cover + k, select_pd(_mm_cmplt_pd(d, max2), aa, zerod));
+			}
+			__m128			a = _mm_mul_ps(la, load_pd_as_ps(value + x));
+			a = _mm_mul_ps(a, load_pd_as_ps(cover));
+			a = _mm_and_ps(_mm_cmpgt_ps(a, zero), a);
+			const __m128	amt = _mm_sub_ps(one, a);
+			_mm_storeu_ps(r + x, _mm_add_ps(_mm_mul_ps(lr, a), _mm_mul_ps(amt, _mm_loadu_ps(r + x))));
+			_mm_storeu_ps(g + x, _mm_add_ps(_mm_mul_ps(lg, a), _mm_mul_ps(amt, _mm_loadu_ps(g + x))));
+			_mm_storeu_ps(b + x, _mm_add_ps(_mm_mul_ps(lb, a), _mm_mul_ps(amt, _mm_loadu_ps(b + x))));
+			_mm_storeu_ps(alpha + x, _mm_add_ps(a, _mm_mul_ps(amt, _mm_loadu_ps(alpha + x))));
+		}
+	}
+#endif
+	for (; x < width; ++x) {
+		const double	d = dist[x];
+		if (d >= maxDist) continue;
+		float			a = layer.mA * static_cast<float>(value[x]);
+		if (!(a > 0.0f)) continue;
+		if (d > (maxDist - 1.0)) a *= static_cast<float>(maxDist - d);
+		const float		amt = 1.0f - a;
+		r[x] = layer.mR*a + (amt * r[x]);
+		g[x] = layer.mG*a + (amt * g[x]);
+		b[x] = layer.mB*a + (amt * b[x]);
+		alpha[x] = a + (amt * alpha[x]);
+	}
+}
+
+} // namespace arc
+} // namespace ds
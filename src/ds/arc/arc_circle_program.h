@@ -0,0 +1,92 @@
+#pragma once
+#ifndef DS_ARC_ARCCIRCLEPROGRAM_H_
+#define DS_ARC_ARCCIRCLEPROGRAM_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace ds {
+namespace arc {
+class Arc;
+class Input;
+
+/**
+ * \class ds::arc::CircleOp
+ * \brief One step of a compiled run() chain, with its params already
+ * resolved against the Input.
+ */
+class CircleOp {
+public:
+	enum Type { MAP, POW, CALL };
+
+	static CircleOp			map(const double fromMin, const double fromMax, const double toMin, const double toMax);
+	static CircleOp			pow(const double exp);
+	/// For arcs that can't be compiled, run() gets called for each pixel
+	static CircleOp			call(const Arc*, const Input&);
+
+	Type					mType;
+	double					mA, mB, mC, mD;
+	const Arc*				mArc;
+	const Input*			mInput;
+
+private:
+	CircleOp();
+};
+
+/**
+ * \class ds::arc::CircleLayer
+ * \brief A compiled ds::arc::Layer. Everything that's constant across
+ * the image is resolved up front.
+ */
+class CircleLayer {
+public:
+	CircleLayer();
+
+	double					mCenX, mCenY;
+	double					mMaxDist;
+	bool					mDegreeInput;
+	std::vector<CircleOp>	mOps;
+	// Straight colour, the alpha gets modulated by the layer value
+	float					mR, mG, mB, mA;
+};
+
+/**
+ * \class ds::arc::CircleProgram
+ * \brief An arc graph flattened into a list of layers, evaluated a row at
+ * a time in passes over contiguous arrays instead of a chain of virtual calls
+ * per pixel. The distance, composite and output passes use SSE2 when
+ * available. Rows are independent, so any number of threads can render
+ * different rows of the same program.
+ */
+class CircleProgram {
+public:
+	/// Per-thread working memory for renderRow()
+	class Scratch {
+	public:
+		std::vector<double>	mDist, mValue;
+		std::vector<float>	mR, mG, mB, mA;
+	};
+
+	/// Byte offsets of each channel in a pixel. alpha < 0 if there's no alpha channel.
+	class Layout {
+	public:
+		Layout() : mPixelInc(4), mRed(0), mGreen(1), mBlue(2), mAlpha(3) {}
+		int					mPixelInc;
+		int					mRed, mGreen, mBlue, mAlpha;
+	};
+
+	CircleProgram();
+
+	std::vector<CircleLayer>	mLayers;
+
+	/// Render row y of a width-pixel image into dst
+	void					renderRow(const int y, const int width, const Layout&, Scratch&, uint8_t* dst) const;
+
+private:
+	void					renderLayer(const CircleLayer&, const double y, const int width, Scratch&) const;
+};
+
+} // namespace arc
+} // namespace ds
+
+#endif // DS_ARC_ARCCIRCLEPROGRAM_H_
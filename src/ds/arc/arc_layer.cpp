@@ -3,6 +3,7 @@
 #include "ds/arc/arc_layer.h"
 
 #include <Poco/String.h>
+#include "ds/arc/arc_circle_program.h"
 #include "ds/arc/arc_io.h"
 #include "ds/arc/arc_render_circle.h"
 #include "ds/math/math_func.h"
@@ -16,6 +17,7 @@ namespace arc {
 Layer::Layer()
 	: mScaleMode(SCALE_MULTIPLY)
 	, mScale(1.0)
+	, mInputMode(INPUT_DIST)
 {
 	setInput(INPUT_DIST);
 	setScale(SCALE_MULTIPLY, 1.0);
@@ -55,6 +57,27 @@ void Layer::renderCircle(const Input& ip, RenderCircleParams& p) const
 	}
 }
 
+bool Layer::compileCircle(const Input& ip, const RenderCircleParams& p, CircleProgram& prg) const
+{
+	CircleLayer		layer;
+	ci::dvec2		offset = mOffset.getValue(ip);
+	layer.mCenX = p.mCenX + offset.x;
+	layer.mCenY = p.mCenY + offset.y;
+	layer.mMaxDist = mScaleFn(p, offset);
+	layer.mDegreeInput = (mInputMode == INPUT_DEGREE);
+	if (mArc && !mArc->compileRun(ip, layer.mOps)) {
+		layer.mOps.push_back(CircleOp::call(mArc.get(), ip));
+	}
+	// The colour is constant, the value only modulates its alpha
+	const ci::ColorA	clr = mColor.at(ip, 1.0);
+	layer.mR = clr.r;
+	layer.mG = clr.g;
+	layer.mB = clr.b;
+	layer.mA = clr.a;
+	prg.mLayers.push_back(layer);
+	return true;
+}
+
 void Layer::readXml(const ci::XmlTree& xml)
 {
 	mArc.reset();
@@ -114,6 +137,7 @@ void Layer::setScale(const std::string& in_mode, const double amount)
 
 void Layer::setInput(const InputMode mode)
 {
+	mInputMode = mode;
 	if (mode == INPUT_DEGREE) mInputFn = [](const double dist, const double degree)->double{return degree;};
 	else mInputFn = [](const double dist, const double degree)->double{return dist;};
 }
@@ -19,6 +19,7 @@ public:
 	Layer();
 
 	virtual void			renderCircle(const Input&, RenderCircleParams&) const;
+	virtual bool			compileCircle(const Input&, const RenderCircleParams&, CircleProgram&) const;
 
 	virtual void			readXml(const ci::XmlTree&);
 
@@ -35,6 +36,7 @@ private:
 	Vec2Param				mOffset;
 	ScaleMode				mScaleMode;
 	double					mScale;
+	InputMode				mInputMode;
 	std::unique_ptr<Arc>	mArc;
 	ColorArray				mColor;
 	std::function<double(const RenderCircleParams&, const ci::dvec2& offset)>
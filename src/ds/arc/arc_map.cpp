@@ -2,6 +2,8 @@
 
 #include "ds/arc/arc_map.h"
 
+#include "ds/arc/arc_circle_program.h"
+
 namespace ds {
 namespace arc {
 
@@ -40,6 +42,11 @@ double Map::run(const Input& input, const double v) const {
 	return ans;
 }
 
+bool Map::compileRun(const Input& input, std::vector<CircleOp>& ops) const {
+	ops.push_back(CircleOp::map(mFromMin.getValue(input), mFromMax.getValue(input), mToMin.getValue(input), mToMax.getValue(input)));
+	return true;
+}
+
 void Map::readXml(const ci::XmlTree& xml) {
 	mFromMin = FloatParam(0.0);
 	mFromMax = FloatParam(1.0);
@@ -21,6 +21,7 @@ public:
 	Map();
 
 	virtual double		run(const Input&, const double) const;
+	virtual bool		compileRun(const Input&, std::vector<CircleOp>&) const;
 
 	virtual void		readXml(const ci::XmlTree&);
 
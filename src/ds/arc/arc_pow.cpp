@@ -2,6 +2,8 @@
 
 #include "ds/arc/arc_pow.h"
 
+#include "ds/arc/arc_circle_program.h"
+
 namespace ds {
 namespace arc {
 
@@ -16,6 +18,11 @@ double Pow::run(const Input& input, const double v) const {
 	return pow(v, mExp.getValue(input));
 }
 
+bool Pow::compileRun(const Input& input, std::vector<CircleOp>& ops) const {
+	ops.push_back(CircleOp::pow(mExp.getValue(input)));
+	return true;
+}
+
 void Pow::readXml(const ci::XmlTree& xml) {
 	mExp = FloatParam(1.0);
 
@@ -19,6 +19,7 @@ public:
 	Pow();
 
 	virtual double		run(const Input&, const double) const;
+	virtual bool		compileRun(const Input&, std::vector<CircleOp>&) const;
 
 	virtual void		readXml(const ci::XmlTree&);
 
@@ -2,7 +2,10 @@
 
 #include "ds/arc/arc_render_circle.h"
 
+#include <algorithm>
+#include "ds/arc/arc_circle_program.h"
 #include "ds/math/math_func.h"
+#include "ds/ui/ip/ip_kernel.h"
 
 namespace ds {
 namespace arc {
@@ -18,9 +21,15 @@ RenderCircleParams::RenderCircleParams()
  * ds::arc::RenderCircle
  */
 RenderCircle::RenderCircle()
+	: mNumThreads(0)
 {
 }
 
+void RenderCircle::setNumThreads(const int n)
+{
+	mNumThreads = std::max(0, n);
+}
+
 static inline float un_premult(const float v, const float a)
 {
 	if (a < 1.0f && a > 0.0f) {
@@ -47,6 +56,42 @@ bool RenderCircle::on(const Input& input, ci::Surface8u& s, ds::arc::Arc& a)
 	params.mCenY = (s.getHeight()-1)/2.0;
 	params.mMaxDist = ds::math::dist(params.mCenX, params.mCenY, params.mCenX, 0.0);
 
+	CircleProgram	program;
+	if (!a.compileCircle(input, params, program)) {
+		renderPixels(input, s, a, params);
+		return true;
+	}
+
+	CircleProgram::Layout	layout;
+	layout.mPixelInc = s.getPixelInc();
+	layout.mRed = s.getChannelOrder().getRedOffset();
+	layout.mGreen = s.getChannelOrder().getGreenOffset();
+	layout.mBlue = s.getChannelOrder().getBlueOffset();
+	layout.mAlpha = s.hasAlpha() ? s.getChannelOrder().getAlphaOffset() : -1;
+
+	const int		w = s.getWidth(),
+					h = s.getHeight();
+	uint8_t*		data = s.getData();
+	const ptrdiff_t	rowBytes = s.getRowBytes();
+	auto			renderRows = [&](const int begin, const int end) {
+		CircleProgram::Scratch	scratch;
+		for (int y = begin; y < end; ++y) {
+			program.renderRow(y, w, layout, scratch, data + y*rowBytes);
+		}
+	};
+
+	// Not worth handing out small images
+	if (mNumThreads == 1 || w*h < 2*64*64) {
+		renderRows(0, h);
+	} else {
+		ds::ui::ip::forEachRow(h, renderRows);
+	}
+
+	return true;
+}
+
+void RenderCircle::renderPixels(const Input& input, ci::Surface8u& s, ds::arc::Arc& a, RenderCircleParams& params)
+{
 	auto			pix = s.getIter();
 	params.mY = 0.0;
 	while (pix.line()) {
@@ -63,8 +108,6 @@ bool RenderCircle::on(const Input& input, ci::Surface8u& s, ds::arc::Arc& a)
 		}
 		++params.mY;
 	}
-
-	return true;
 }
 
 } // namespace arc
@@ -29,6 +29,9 @@ public:
 /**
  * \class ds::arc::RenderCircle
  * \brief Given an arc, generate a circular image.
+ * The arc is compiled to a ds::arc::CircleProgram and rows are split across
+ * the shared image processing pool (ds::ui::ip::forEachRow). Arcs that can't
+ * be compiled are rendered a pixel at a time on the calling thread.
  */
 class RenderCircle
 {
@@ -36,6 +39,14 @@ public:
 	RenderCircle();
 
 	bool				on(const Input&, ci::Surface8u&, ds::arc::Arc&);
+
+	/// 1 renders on the calling thread. Anything else (0 is the default) uses the shared pool.
+	void				setNumThreads(const int);
+
+private:
+	void				renderPixels(const Input&, ci::Surface8u&, ds::arc::Arc&, RenderCircleParams&);
+
+	int					mNumThreads;
 };
 
 } // namespace arc
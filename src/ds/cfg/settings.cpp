@@ -2,6 +2,7 @@
 
 #include "settings.h"
 
+#include <mutex>
 #include <cinder/Xml.h>
 #include <Poco/File.h>
 #include <Poco/String.h>
@@ -52,84 +53,76 @@ void initialize_types(){
 	}
 }
 
-static void merge_settings(
-	std::vector<std::pair<std::string, std::vector<ds::cfg::Settings::Setting>>>& dst,
-	const std::vector<std::pair<std::string, std::vector<ds::cfg::Settings::Setting>>>& src){
+// Bits for Setting::mParsed
+static const int	PARSED_BOOL		= (1 << 0);
+static const int	PARSED_INT		= (1 << 1);
+static const int	PARSED_FLOAT	= (1 << 2);
+static const int	PARSED_DOUBLE	= (1 << 3);
+static const int	PARSED_VECTOR	= (1 << 4);
+static const int	PARSED_RECT		= (1 << 5);
+static const int	PARSED_COLOR	= (1 << 6);
+static const int	PARSED_WSTRING	= (1 << 7);
 
-	int highestReadIndex = 0;
+// Guards every Setting's parsed values. Getters are called from worker threads too, and the
+// lock is uncontended nearly always, which is cheaper than a parse.
+std::mutex			PARSED_MUTEX;
 
-	for(auto& dit : dst) {
-		for (auto vit : dit.second){
-			if(vit.mReadIndex > highestReadIndex) highestReadIndex = vit.mReadIndex;
-		}
+bool sort_by_read_index(const ds::cfg::Settings::Setting& a, const ds::cfg::Settings::Setting& b){
+	if(a.mReadIndex < b.mReadIndex){
+		return true;
+	} else if(a.mReadIndex == b.mReadIndex){
+		return a.mName < b.mName;
 	}
 
-	highestReadIndex += SETTINGS_INCREMENT;
-
-	for(auto sit : src) {
-		bool found = false;
-		for(auto& dit : dst){
-			if(dit.first == sit.first){
-
-				int thisReadIndex = 0;
-				for(int i = 0; i < sit.second.size(); i++) {
-					if(i < dit.second.size()) {
-						int readIndex = dit.second[i].mReadIndex;
-						dit.second[i] = sit.second[i];
-						dit.second[i].mReadIndex = readIndex;
-
-						if(readIndex > thisReadIndex) thisReadIndex = readIndex;
-					} else {
-						dit.second.emplace_back(sit.second[i]);
-						if(thisReadIndex > 0) {
-							dit.second.back().mReadIndex = thisReadIndex;
-							thisReadIndex += 1;
-						}
-
-					}
-				}
-			
-
-				found = true;
-				break;
-			}
-		}
-
-		if(!found){
-			for (auto it : sit.second){
-				it.mReadIndex = highestReadIndex;
-				highestReadIndex += SETTINGS_INCREMENT;
-			}
+	return false;
+}
 
-			dst.emplace_back(sit);
-		}
-	}
 }
 
+bool Settings::Setting::checkParsed(const int typeBit) const {
+	if(mParsed == 0 || mParsedRaw != mRawValue){
+		mParsedRaw = mRawValue;
+		mParsed = 0;
+	}
+	if((mParsed & typeBit) != 0) return true;
+	mParsed |= typeBit;
+	return false;
 }
 
 bool Settings::Setting::getBool() const {
-	return parseBoolean(mRawValue);
+	std::lock_guard<std::mutex>	lock(PARSED_MUTEX);
+	if(!checkParsed(PARSED_BOOL)) mBoolValue = parseBoolean(mRawValue);
+	return mBoolValue;
 }
 
 int Settings::Setting::getInt() const{
-	return ds::string_to_int(mRawValue);
+	std::lock_guard<std::mutex>	lock(PARSED_MUTEX);
+	if(!checkParsed(PARSED_INT)) mIntValue = ds::string_to_int(mRawValue);
+	return mIntValue;
 }
 
 float Settings::Setting::getFloat() const{
-	return ds::string_to_float(mRawValue);
+	std::lock_guard<std::mutex>	lock(PARSED_MUTEX);
+	if(!checkParsed(PARSED_FLOAT)) mFloatValue = ds::string_to_float(mRawValue);
+	return mFloatValue;
 }
 
 double Settings::Setting::getDouble() const{
-	return ds::string_to_double(mRawValue);
+	std::lock_guard<std::mutex>	lock(PARSED_MUTEX);
+	if(!checkParsed(PARSED_DOUBLE)) mDoubleValue = ds::string_to_double(mRawValue);
+	return mDoubleValue;
 }
 
 const ci::Color Settings::Setting::getColor(ds::ui::SpriteEngine& eng) const{
-	return ds::parseColor(mRawValue, eng);
+	return getColorA(eng);
 }
 
 const ci::ColorA Settings::Setting::getColorA(ds::ui::SpriteEngine& eng) const{
-	return ds::parseColor(mRawValue, eng);
+	// Named colors are looked up every time, since the engine's colors can change
+	if(mRawValue.empty() || mRawValue[0] != '#') return ds::parseColor(mRawValue, eng);
+	std::lock_guard<std::mutex>	lock(PARSED_MUTEX);
+	if(!checkParsed(PARSED_COLOR)) mColorValue = ds::parseColor(mRawValue, eng);
+	return mColorValue;
 }
 
 const std::string& Settings::Setting::getString() const{
@@ -137,19 +130,25 @@ const std::string& Settings::Setting::getString() const{
 }
 
 const std::wstring Settings::Setting::getWString() const{
-	return ds::wstr_from_utf8(mRawValue);
+	std::lock_guard<std::mutex>	lock(PARSED_MUTEX);
+	if(!checkParsed(PARSED_WSTRING)) mWStringValue = ds::wstr_from_utf8(mRawValue);
+	return mWStringValue;
 }
 
 const ci::vec2 Settings::Setting::getVec2() const {
-	return ci::vec2(parseVector(mRawValue));
+	return ci::vec2(getVec3());
 }
 
 const ci::vec3 Settings::Setting::getVec3() const {
-	return parseVector(mRawValue);
+	std::lock_guard<std::mutex>	lock(PARSED_MUTEX);
+	if(!checkParsed(PARSED_VECTOR)) mVecValue = parseVector(mRawValue);
+	return mVecValue;
 }
 
 const cinder::Rectf Settings::Setting::getRect() const{
-	return parseRect(mRawValue);
+	std::lock_guard<std::mutex>	lock(PARSED_MUTEX);
+	if(!checkParsed(PARSED_RECT)) mRectValue = parseRect(mRawValue);
+	return mRectValue;
 }
 
 std::vector<std::string> Settings::Setting::getPossibleValues() const{
@@ -159,6 +158,8 @@ std::vector<std::string> Settings::Setting::getPossibleValues() const{
 
 Settings::Settings()
 	: mReadIndex(1)
+	, mSortedDirty(true)
+	, mNextSubscriptionId(1)
 {
 	initialize_types();
 }
@@ -172,7 +173,46 @@ void Settings::readFrom(const std::string& filename, const bool append){
 	Settings		s;
 	s.directReadFrom(filename, false);
 
-	merge_settings(mSettings, s.mSettings);
+	mergeSettings(s);
+}
+
+void Settings::mergeSettings(const Settings& src){
+	std::vector<std::string> changed;
+
+	for(auto& sit : src.mSettings) {
+		auto findy = mIndex.find(sit.first);
+		if(findy == mIndex.end()){
+			// New names keep the read index they were read with
+			appendSettings(sit.first, sit.second);
+			continue;
+		}
+
+		auto& dst = mSettings[findy->second].second;
+		unsigned int thisReadIndex = 0;
+		for(size_t i = 0; i < sit.second.size(); i++) {
+			if(i < dst.size()) {
+				if(i == 0 && dst[i].mRawValue != sit.second[i].mRawValue) changed.push_back(sit.first);
+
+				unsigned int readIndex = dst[i].mReadIndex;
+				dst[i] = sit.second[i];
+				dst[i].mReadIndex = readIndex;
+
+				if(readIndex > thisReadIndex) thisReadIndex = readIndex;
+			} else {
+				dst.emplace_back(sit.second[i]);
+				if(thisReadIndex > 0) {
+					dst.back().mReadIndex = thisReadIndex;
+					thisReadIndex += 1;
+				}
+			}
+		}
+	}
+
+	mSortedDirty = true;
+
+	if(!mSubscribers.empty()){
+		for(auto& it : changed) notifyChanged(it);
+	}
 }
 
 void Settings::directReadFrom(const std::string& filename, const bool clearAll){
@@ -222,14 +262,7 @@ void Settings::directReadFrom(const std::string& filename, const bool clearAll){
 
 		theSetting.mSource = filename;
 
-		auto settingIndex = getSettingIndex(theName);
-		if(settingIndex > -1 && !mSettings.empty()){
-			mSettings[settingIndex].second.push_back(theSetting);
-		} else {
-			std::vector<Setting> newSettingVec;
-			newSettingVec.push_back(theSetting);
-			mSettings.emplace_back(std::pair<std::string, std::vector<Setting>>(theName, newSettingVec));
-		}
+		addSetting(theSetting);
 	}
 }
 
@@ -239,8 +272,8 @@ void Settings::writeTo(const std::string& filename){
 	ci::XmlTree xml = ci::XmlTree::createDoc();
 	ci::XmlTree rootNode;
 	rootNode.setTag("settings");
-	auto& sortedSettings = getReadSortedSettings();
-	for(auto sit : sortedSettings){
+	for(auto& it : getSortedOrder()){
+		const Setting& sit = mSettings[it.first].second[it.second];
 		ci::XmlTree settingNode;
 		settingNode.setTag("setting");
 		settingNode.setAttribute("name", sit.mName);
@@ -265,6 +298,8 @@ bool Settings::empty() const {
 
 void Settings::clear() {
 	mSettings.clear();
+	mIndex.clear();
+	mSortedDirty = true;
 }
 
 
@@ -274,6 +309,8 @@ const bool Settings::getBool(const std::string& name, const int index) {
 
 const bool Settings::getBool(const std::string& name, const int index, const bool defaultValue){
 	/// std::to_string was converting bool to int and returning 1 or 0
+	Setting* theSetting = findSetting(name, index);
+	if(theSetting) return theSetting->getBool();
 	std::string defaultString = "false";
 	if(defaultValue) defaultString = "true";
 	return getSetting(name, index, defaultString).getBool();
@@ -284,6 +321,8 @@ const int Settings::getInt(const std::string& name, const int index){
 }
 
 const int Settings::getInt(const std::string& name, const int index, const int defaultValue){
+	Setting* theSetting = findSetting(name, index);
+	if(theSetting) return theSetting->getInt();
 	return getSetting(name, index, std::to_string(defaultValue)).getInt();
 }
 
@@ -292,6 +331,8 @@ const float Settings::getFloat(const std::string& name, const int index){
 }
 
 const float Settings::getFloat(const std::string& name, const int index, const float defaultValue){
+	Setting* theSetting = findSetting(name, index);
+	if(theSetting) return theSetting->getFloat();
 	return getSetting(name, index, std::to_string(defaultValue)).getFloat();
 }
 
@@ -300,6 +341,8 @@ const double Settings::getDouble(const std::string& name, const int index){
 }
 
 const double Settings::getDouble(const std::string& name, const int index, const double defaultValue){
+	Setting* theSetting = findSetting(name, index);
+	if(theSetting) return theSetting->getDouble();
 	return getSetting(name, index, std::to_string(defaultValue)).getDouble();
 }
 
@@ -308,6 +351,8 @@ const ci::Color Settings::getColor(ds::ui::SpriteEngine& engine, const std::stri
 }
 
 const ci::Color Settings::getColor(ds::ui::SpriteEngine& engine, const std::string& name, const int index, const ci::Color& defaultValue){
+	Setting* theSetting = findSetting(name, index);
+	if(theSetting) return theSetting->getColor(engine);
 	return getSetting(name, index, ds::unparseColor(defaultValue)).getColor(engine);
 }
 
@@ -316,6 +361,8 @@ const ci::ColorA Settings::getColorA(ds::ui::SpriteEngine& engine, const std::st
 }
 
 const ci::ColorA Settings::getColorA(ds::ui::SpriteEngine& engine, const std::string& name, const int index, const ci::ColorA& defaultValue){
+	Setting* theSetting = findSetting(name, index);
+	if(theSetting) return theSetting->getColor(engine);
 	return getSetting(name, index, ds::unparseColor(defaultValue)).getColor(engine);
 }
 
@@ -332,6 +379,8 @@ const std::wstring Settings::getWString(const std::string& name, const int index
 }
 
 const std::wstring Settings::getWString(const std::string& name, const int index, const std::wstring& defaultValue){
+	Setting* theSetting = findSetting(name, index);
+	if(theSetting) return theSetting->getWString();
 	return getSetting(name, index, ds::utf8_from_wstr(defaultValue)).getWString();
 }
 
@@ -340,6 +389,8 @@ const ci::vec2 Settings::getVec2(const std::string& name, const int index){
 }
 
 const ci::vec2 Settings::getVec2(const std::string& name, const int index, const ci::vec2& defaultValue){
+	Setting* theSetting = findSetting(name, index);
+	if(theSetting) return theSetting->getVec2();
 	return getSetting(name, index, ds::unparseVector(defaultValue)).getVec2();
 }
 
@@ -348,6 +399,8 @@ const ci::vec3 Settings::getVec3(const std::string& name, const int index){
 }
 
 const ci::vec3 Settings::getVec3(const std::string& name, const int index, const ci::vec3& defaultValue){
+	Setting* theSetting = findSetting(name, index);
+	if(theSetting) return theSetting->getVec3();
 	return getSetting(name, index, ds::unparseVector(defaultValue)).getVec3();
 }
 
@@ -356,6 +409,8 @@ const cinder::Rectf Settings::getRect(const std::string& name, const int index){
 }
 
 const cinder::Rectf Settings::getRect(const std::string& name, const int index, const ci::Rectf& defaultValue){
+	Setting* theSetting = findSetting(name, index);
+	if(theSetting) return theSetting->getRect();
 	return getSetting(name, index, ds::unparseRect(defaultValue)).getRect();
 }
 
@@ -363,73 +418,95 @@ bool Settings::validateType(const std::string& inputType) {
 	return std::find(SETTING_TYPES.begin(), SETTING_TYPES.end(), inputType) != SETTING_TYPES.end();
 }
 
-bool sortByReadIndex(ds::cfg::Settings::Setting& a, ds::cfg::Settings::Setting& b){
-	if(a.mReadIndex < b.mReadIndex){
-		return true;
-	} else if(a.mReadIndex == b.mReadIndex){
-		return a.mName < b.mName;
+const std::vector<std::pair<size_t, size_t>>& Settings::getSortedOrder(){
+	if(!mSortedDirty){
+		// Read indices can be changed from outside, so make sure the old order still holds
+		for(size_t i = 1; i < mSortedOrder.size(); i++){
+			auto& prev = mSortedOrder[i - 1];
+			auto& cur = mSortedOrder[i];
+			if(sort_by_read_index(mSettings[cur.first].second[cur.second], mSettings[prev.first].second[prev.second])){
+				mSortedDirty = true;
+				break;
+			}
+		}
 	}
 
-	return false;
+	if(mSortedDirty){
+		mSortedOrder.clear();
+		for(size_t i = 0; i < mSettings.size(); i++){
+			for(size_t k = 0; k < mSettings[i].second.size(); k++){
+				mSortedOrder.push_back(std::make_pair(i, k));
+			}
+		}
+
+		std::sort(mSortedOrder.begin(), mSortedOrder.end(), [this](const std::pair<size_t, size_t>& a, const std::pair<size_t, size_t>& b){
+			return sort_by_read_index(mSettings[a.first].second[a.second], mSettings[b.first].second[b.second]);
+		});
+		mSortedDirty = false;
+	}
+
+	return mSortedOrder;
 }
 
 std::vector<ds::cfg::Settings::Setting>& Settings::getReadSortedSettings(){
 	mSortedSettings.clear();
 
-	for(auto it : mSettings){
-		auto theVec = it.second;
-		for(auto sit : theVec){
-			mSortedSettings.push_back(sit);
-		}
+	for(auto& it : getSortedOrder()){
+		mSortedSettings.push_back(mSettings[it.first].second[it.second]);
 	}
 
-	std::sort(mSortedSettings.begin(), mSortedSettings.end(), sortByReadIndex);
-
 	return mSortedSettings;
 }
 
 bool Settings::hasSetting(const std::string& name) const {
-	for(auto it : mSettings){
-		if(it.first == name) return true;
-	}
-
-	return false;
+	return mIndex.find(name) != mIndex.end();
 }
 
 size_t Settings::countSetting(const std::string& name) const {
-	for(auto it : mSettings) {
-		if(it.first == name) return it.second.size();
-	}
-
-	return 0;
+	auto findy = mIndex.find(name);
+	if(findy == mIndex.end()) return 0;
+	return mSettings[findy->second].second.size();
 }
 
 int Settings::getSettingIndex(const std::string& name) const {
-	for(int i = 0; i < mSettings.size(); i++){
-		if(mSettings[i].first == name) return i;
-	}
-
-	return -1;
+	auto findy = mIndex.find(name);
+	if(findy == mIndex.end()) return -1;
+	return (int)findy->second;
 }
 
 void Settings::forEachSetting(const std::function<void(Setting&)>& func, const std::string& typeFilter /*= ""*/) {
-	auto& theThingies = getReadSortedSettings();
-	for(auto sit : theThingies){
+	// Copy the order, func is allowed to add settings
+	const std::vector<std::pair<size_t, size_t>> theOrder = getSortedOrder();
+	for(auto& it : theOrder){
+		Setting& sit = mSettings[it.first].second[it.second];
 		if(!typeFilter.empty() && typeFilter != sit.mType) continue;
 		func(sit);
 	}
 }
 
+Settings::Setting* Settings::findSetting(const std::string& name, const int index){
+	auto findy = mIndex.find(name);
+	if(findy == mIndex.end() || index < 0) return nullptr;
+
+	auto& theSettings = mSettings[findy->second].second;
+	if((size_t)index >= theSettings.size()) return nullptr;
+	return &theSettings[index];
+}
+
+void Settings::appendSettings(const std::string& name, const std::vector<Setting>& settings){
+	// A name that's already here keeps pointing at its first entry, like the old linear search
+	mIndex.insert(std::make_pair(name, mSettings.size()));
+	mSettings.emplace_back(std::pair<std::string, std::vector<Setting>>(name, settings));
+	mSortedDirty = true;
+}
+
 ds::cfg::Settings::Setting& Settings::getSetting(const std::string& name, const int index) {
 	return getSetting(name, index, "");
 }
 
 ds::cfg::Settings::Setting& Settings::getSetting(const std::string& name, const int index, const std::string& defaultRawValue){
-	auto settingIndex = getSettingIndex(name);
-
-	if(settingIndex > -1 && index > -1 && !mSettings[settingIndex].second.empty() && index < mSettings[settingIndex].second.size()){
-		return mSettings[settingIndex].second[index];
-	}
+	Setting* theSetting = findSetting(name, index);
+	if(theSetting) return *theSetting;
 
 	// create a new blank setting and return that
 	std::vector<Setting> settings;
@@ -438,7 +515,7 @@ ds::cfg::Settings::Setting& Settings::getSetting(const std::string& name, const
 	settings.back().mRawValue = defaultRawValue;
 	settings.back().mReadIndex = mReadIndex;
 	mReadIndex += SETTINGS_INCREMENT;
-	mSettings.emplace_back(std::pair<std::string, std::vector<Setting>>(name, settings));
+	appendSettings(name, settings);
 
 	return mSettings.back().second.back();
 
@@ -460,20 +537,53 @@ ds::cfg::Settings::Setting& Settings::getSetting(const std::string& name, const
 void Settings::addSetting(const Setting& newSetting){
 	auto settingIndex = getSettingIndex(newSetting.mName);
 
-	if(settingIndex > -1 && !mSettings.empty()){
+	if(settingIndex > -1){
 		mSettings[settingIndex].second.push_back(newSetting);
+		mSortedDirty = true;
 	} else {
 		std::vector<Setting> theSettings;
 		theSettings.push_back(newSetting);
-		auto hintInsert = mSettings.end();
-		mSettings.insert(hintInsert, std::pair<std::string, std::vector<Setting>>(newSetting.mName, theSettings));
+		appendSettings(newSetting.mName, theSettings);
+	}
+}
+
+void Settings::setRawValue(const std::string& name, const int index, const std::string& rawValue){
+	Setting& theSetting = getSetting(name, index);
+	if(theSetting.mRawValue == rawValue) return;
+	theSetting.mRawValue = rawValue;
+	notifyChanged(name);
+}
+
+Settings::SubscriptionId Settings::subscribe(const std::string& name, const std::function<void(Setting&)>& func){
+	const SubscriptionId id = mNextSubscriptionId++;
+	mSubscribers[id] = std::make_pair(name, func);
+	return id;
+}
+
+void Settings::unsubscribe(const SubscriptionId id){
+	mSubscribers.erase(id);
+}
+
+void Settings::notifyChanged(const std::string& name){
+	if(mSubscribers.empty()) return;
+
+	// Copied first, a subscriber can unsubscribe from its own callback
+	std::vector<std::function<void(Setting&)>> funcs;
+	for(auto& it : mSubscribers){
+		if(it.second.first == name && it.second.second) funcs.push_back(it.second.second);
+	}
+	if(funcs.empty()) return;
+
+	Setting& theSetting = getSetting(name, 0);
+	for(auto& it : funcs){
+		it(theSetting);
 	}
 }
 
 void Settings::printAllSettings(){
 	std::cout << "Settings: " << std::endl;
-	auto& theVec = getReadSortedSettings();
-	for(auto sit : theVec){
+	for(auto& it : getSortedOrder()){
+		const Setting& sit = mSettings[it.first].second[it.second];
 		std::cout << std::endl << "\t" << sit.mName << ": \t" << sit.mRawValue << std::endl;
 		std::cout << "\t\t source: \t" << sit.mSource << std::endl;
 
@@ -2,7 +2,10 @@
 #ifndef DS_CFG_SETTINGS_MANAGER_H_
 #define DS_CFG_SETTINGS_MANAGER_H_
 
+#include <functional>
 #include <map>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include <cinder/Color.h>
 #include <cinder/Rect.h>
@@ -46,9 +49,10 @@ public:
 
 	// An actual setting with some metadata. 
 	struct Setting {
-		Setting() : mType(SETTING_TYPE_UNKNOWN), mReadIndex(-1){};
+		Setting() : mType(SETTING_TYPE_UNKNOWN), mReadIndex(-1), mParsed(0){};
 
-		/// Type conversion happens at read time for all getters
+		/// Type conversion happens the first time a getter is called, and the result is kept until mRawValue changes.
+		/// The getters can be called from any thread, as long as nothing is changing the setting at the same time.
 		bool							getBool() const;
 		int								getInt() const;
 		float							getFloat() const;
@@ -97,6 +101,23 @@ public:
 
 		/// an id that's auto-assigned to this setting to determine overall sort order
 		unsigned int					mReadIndex;
+
+	private:
+		/// Throws out the parsed values if mRawValue isn't what they were parsed from, and
+		/// answers true if the type bit was already parsed (setting it either way).
+		/// The parsed values are shared between threads, so all of this happens under a lock.
+		bool							checkParsed(const int typeBit) const;
+
+		mutable std::string				mParsedRaw;
+		mutable int						mParsed;
+		mutable bool					mBoolValue;
+		mutable int						mIntValue;
+		mutable float					mFloatValue;
+		mutable double					mDoubleValue;
+		mutable ci::vec3				mVecValue;
+		mutable cinder::Rectf			mRectValue;
+		mutable ci::ColorA				mColorValue;
+		mutable std::wstring			mWStringValue;
 	};
 
 	/// The name of these settings (e.g. engine, layout, text, etc)
@@ -208,6 +229,18 @@ public:
 	/// How many settings there are with this name
 	size_t								countSetting(const std::string& name) const;
 
+	/// Sets the raw value of a setting, creating it if needed, and calls any subscribers if it changed
+	void								setRawValue(const std::string& name, const int index, const std::string& rawValue);
+
+	/// Calls the function with the first setting of that name whenever it's changed with setRawValue(),
+	/// notifyChanged() or the SettingsEditor. Unsubscribe before anything the function uses goes away.
+	typedef int							SubscriptionId;
+	SubscriptionId						subscribe(const std::string& name, const std::function<void(Setting&)>& func);
+	void								unsubscribe(const SubscriptionId);
+
+	/// Tells the subscribers to a setting that it changed, for when mRawValue was set directly
+	void								notifyChanged(const std::string& name);
+
 	/// Validate if the type string is known (int, float, string, section_header, etc)
 	static bool							validateType(const std::string& inputType);
 
@@ -232,10 +265,30 @@ protected:
 
 	std::string															mName;
 	unsigned int														mReadIndex;
-	std::vector<Setting>												mSortedSettings; // rebuilt every call of getReadSortedIndex()
+	std::vector<Setting>												mSortedSettings; // copied every call of getReadSortedSettings()
+
+	/// Position in mSettings of each name, so lookups don't have to walk the whole list
+	std::unordered_map<std::string, size_t>								mIndex;
+
+	/// Positions (in mSettings, then in the same-name vector) in read order. Only sorted again
+	/// when settings are added or a read index changes.
+	std::vector<std::pair<size_t, size_t>>								mSortedOrder;
+	bool																mSortedDirty;
+
+	std::map<SubscriptionId, std::pair<std::string, std::function<void(Setting&)>>>
+																		mSubscribers;
+	SubscriptionId														mNextSubscriptionId;
 
 	/// Used in the read function
-	void								directReadFrom(const std::string& filename, const bool clear); \
+	void								directReadFrom(const std::string& filename, const bool clear);
+
+	/// Returns the setting, or nullptr if there isn't one with that name and index. Never creates one.
+	Setting*							findSetting(const std::string& name, const int index);
+	/// Adds a new name to the end of mSettings
+	void								appendSettings(const std::string& name, const std::vector<Setting>& settings);
+	void								mergeSettings(const Settings& src);
+	const std::vector<std::pair<size_t, size_t>>&
+										getSortedOrder();
 
 
 
@@ -207,6 +207,7 @@ void SettingsEditor::editProperty(EditorItem* ei){
 
 		mEditView->setSettingUpdatedCallback([this](Settings::Setting* theSetting){
 			if(!theSetting) return;
+			if(mCurrentSettings) mCurrentSettings->notifyChanged(theSetting->mName);
 			for (auto it : mSettingItems){
 				if(it->getSettingName() == theSetting->mName && mSettingsLayout && mPrimaryLayout){
 					auto yPos = mSettingsLayout->getPosition().y;
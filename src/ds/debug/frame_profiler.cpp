@@ -0,0 +1,244 @@
+#include "stdafx.h"
+
+#include "frame_profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <Poco/DateTimeFormatter.h>
+#include <Poco/File.h>
+#include <Poco/LocalDateTime.h>
+#include <Poco/Path.h>
+#include "ds/app/environment.h"
+#include "ds/debug/logger.h"
+
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+namespace ds {
+namespace debug {
+
+namespace {
+thread_local void*			THREAD_BUFFER = nullptr;
+
+#ifndef _WIN32
+void						on_dump_signal(int) {
+	FrameProfiler::get().requestDump();
+}
+#endif
+
+// Names come from string literals in code, but be safe for JSON anyways
+std::string					json_escape(const std::string& s) {
+	std::string				ans;
+	ans.reserve(s.size());
+	for(auto c : s) {
+		if(c == '"' || c == '\\') ans.push_back('\\');
+		if(static_cast<unsigned char>(c) < 0x20) continue;
+		ans.push_back(c);
+	}
+	return ans;
+}
+}
+
+std::atomic<bool> FrameProfiler::sEnabled(true);
+
+FrameProfiler& FrameProfiler::get() {
+	static FrameProfiler		PROFILER;
+	return PROFILER;
+}
+
+FrameProfiler::FrameProfiler()
+	: mHistoryIndex(0)
+	, mHistoryCount(0)
+	, mFrameStart(0)
+	, mFrameZone(0)
+	, mMainThread(0)
+	, mDumpRequested(false)
+{
+	mZoneNames.push_back("frame");
+}
+
+FrameProfiler::ZoneId FrameProfiler::registerZone(const char* name) {
+	FrameProfiler&				p(get());
+	std::lock_guard<std::mutex>	lock(p.mMutex);
+	auto found = std::find(p.mZoneNames.begin(), p.mZoneNames.end(), name);
+	if(found != p.mZoneNames.end()) {
+		return static_cast<ZoneId>(found - p.mZoneNames.begin());
+	}
+	p.mZoneNames.push_back(name);
+	return static_cast<ZoneId>(p.mZoneNames.size() - 1);
+}
+
+int64_t FrameProfiler::now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+FrameProfiler::ThreadBuffer* FrameProfiler::getThreadBuffer() {
+	if(!THREAD_BUFFER) {
+		// Buffers outlive their threads so the last events can still be dumped
+		std::lock_guard<std::mutex>	lock(mMutex);
+		mBuffers.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer(mBuffers.size())));
+		THREAD_BUFFER = mBuffers.back().get();
+	}
+	return static_cast<ThreadBuffer*>(THREAD_BUFFER);
+}
+
+void FrameProfiler::record(const ZoneId zone, const int64_t start, const int64_t end) {
+	ThreadBuffer*				buffer = getThreadBuffer();
+	const uint64_t				w = buffer->mWrite.load(std::memory_order_relaxed);
+	Event&						e = buffer->mEvents[w % EVENTS_PER_THREAD];
+	// Seqlock: mark the slot as being written, fill it, then publish it with its index
+	e.mSeq.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	e.mStart.store(start, std::memory_order_relaxed);
+	e.mEnd.store(end, std::memory_order_relaxed);
+	e.mZone.store(zone, std::memory_order_relaxed);
+	e.mSeq.store(w + 1, std::memory_order_release);
+	buffer->mWrite.store(w + 1, std::memory_order_release);
+}
+
+bool FrameProfiler::readEvent(const ThreadBuffer& buffer, const uint64_t index, EventCopy& out) {
+	const Event&				e = buffer.mEvents[index % EVENTS_PER_THREAD];
+	if(e.mSeq.load(std::memory_order_acquire) != index + 1) return false;
+	out.mStart = e.mStart.load(std::memory_order_relaxed);
+	out.mEnd = e.mEnd.load(std::memory_order_relaxed);
+	out.mZone = e.mZone.load(std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return e.mSeq.load(std::memory_order_relaxed) == index + 1;
+}
+
+void FrameProfiler::endFrame() {
+	const int64_t				frameEnd = now();
+	mMainThread = getThreadBuffer()->mIndex;
+	if(mFrameStart != 0 && isEnabled()) {
+		record(mFrameZone, mFrameStart, frameEnd);
+	}
+	mFrameStart = frameEnd;
+
+	std::vector<ThreadBuffer*>	buffers;
+	size_t						numZones = 0;
+	{
+		std::lock_guard<std::mutex>	lock(mMutex);
+		for(auto& it : mBuffers) buffers.push_back(it.get());
+		numZones = mZoneNames.size();
+	}
+	if(mHistory.size() < numZones) mHistory.resize(numZones);
+
+	// Sum up everything recorded since last frame, per zone, across all threads
+	for(auto buffer : buffers) {
+		const uint64_t			w = buffer->mWrite.load(std::memory_order_acquire);
+		// If a thread lapped us, skip what got overwritten
+		if(w - buffer->mRead > EVENTS_PER_THREAD) buffer->mRead = w - EVENTS_PER_THREAD;
+		EventCopy				e;
+		for(; buffer->mRead < w; ++buffer->mRead) {
+			if(!readEvent(*buffer, buffer->mRead, e) || e.mZone >= mHistory.size()) continue;
+			mHistory[e.mZone].mFrameTotal += e.mEnd - e.mStart;
+			mHistory[e.mZone].mSeen = true;
+		}
+	}
+
+	for(auto& h : mHistory) {
+		if(!h.mSeen) continue;
+		if(h.mFrames.size() < HISTORY_FRAMES) h.mFrames.resize(HISTORY_FRAMES, 0.0f);
+		h.mLast = static_cast<float>(static_cast<double>(h.mFrameTotal) / 1000000.0);
+		h.mFrames[mHistoryIndex] = h.mLast;
+		h.mFrameTotal = 0;
+	}
+	mHistoryIndex = (mHistoryIndex + 1) % HISTORY_FRAMES;
+	mHistoryCount = std::min(mHistoryCount + 1, static_cast<size_t>(HISTORY_FRAMES));
+
+	if(mDumpRequested.exchange(false)) {
+		dumpTrace();
+	}
+}
+
+std::vector<FrameProfiler::ZoneStats> FrameProfiler::getStats() const {
+	std::vector<std::string>	names;
+	{
+		std::lock_guard<std::mutex>	lock(mMutex);
+		names = mZoneNames;
+	}
+
+	std::vector<ZoneStats>		ans;
+	std::vector<float>			sorted;
+	for(size_t i = 0; i < mHistory.size() && i < names.size(); ++i) {
+		const ZoneHistory&		h = mHistory[i];
+		if(!h.mSeen || mHistoryCount < 1) continue;
+
+		sorted.assign(h.mFrames.begin(), h.mFrames.begin() + mHistoryCount);
+		std::sort(sorted.begin(), sorted.end());
+
+		ZoneStats				stats;
+		stats.mName = names[i];
+		stats.mLastMs = h.mLast;
+		stats.mMedianMs = sorted[sorted.size() / 2];
+		stats.mP95Ms = sorted[std::min(sorted.size() - 1, (sorted.size() * 95) / 100)];
+		stats.mMaxMs = sorted.back();
+		ans.push_back(stats);
+	}
+	return ans;
+}
+
+bool FrameProfiler::writeChromeTrace(const std::string& path) const {
+	std::vector<std::string>	names;
+	std::vector<ThreadBuffer*>	buffers;
+	{
+		std::lock_guard<std::mutex>	lock(mMutex);
+		names = mZoneNames;
+		for(auto& it : mBuffers) buffers.push_back(it.get());
+	}
+
+	std::ofstream				out(path, std::ios_base::out | std::ios_base::trunc);
+	if(!out) {
+		DS_LOG_WARNING("FrameProfiler couldn't write trace to " << path);
+		return false;
+	}
+
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool						first = true;
+	for(auto buffer : buffers) {
+		if(!first) out << ",\n";
+		first = false;
+		out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->mIndex
+			<< ",\"args\":{\"name\":\"" << (buffer->mIndex == mMainThread ? "main" : "thread " + std::to_string(buffer->mIndex)) << "\"}}";
+
+		// Anything the thread overwrites while we're going fails to read and is skipped
+		const uint64_t			w = buffer->mWrite.load(std::memory_order_acquire);
+		const uint64_t			begin = w > EVENTS_PER_THREAD ? w - EVENTS_PER_THREAD : 0;
+		EventCopy				e;
+		for(uint64_t i = begin; i < w; ++i) {
+			if(!readEvent(*buffer, i, e) || e.mZone >= names.size()) continue;
+			out << ",\n{\"name\":\"" << json_escape(names[e.mZone]) << "\",\"cat\":\"ds\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->mIndex
+				<< ",\"ts\":" << (e.mStart / 1000) << "." << ((e.mStart / 100) % 10)
+				<< ",\"dur\":" << ((e.mEnd - e.mStart) / 1000) << "." << (((e.mEnd - e.mStart) / 100) % 10) << "}";
+		}
+	}
+	out << "\n]}\n";
+	return true;
+}
+
+std::string FrameProfiler::dumpTrace() const {
+	Poco::Path					p(ds::Environment::expand("%LOCAL%/logs/"));
+	try {
+		Poco::File(p).createDirectories();
+	} catch(std::exception const&) {
+	}
+	p.setFileName("frame_trace_" + Poco::DateTimeFormatter::format(Poco::LocalDateTime(), "%Y-%m-%d_%H-%M-%S") + ".json");
+
+	const std::string			path = p.toString();
+	if(writeChromeTrace(path)) {
+		DS_LOG_INFO("FrameProfiler wrote trace to " << path);
+		return path;
+	}
+	return "";
+}
+
+void FrameProfiler::installSignalHandler() {
+#ifndef _WIN32
+	signal(SIGUSR1, on_dump_signal);
+#endif
+}
+
+} // namespace debug
+} // namespace ds
@@ -0,0 +1,160 @@
+#pragma once
+#ifndef DS_DEBUG_FRAMEPROFILER_H_
+#define DS_DEBUG_FRAMEPROFILER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ds {
+namespace debug {
+
+/**
+ * \class ds::debug::FrameProfiler
+ * \brief Scoped timing of the phases of each frame.
+ * Use DS_PROFILE_ZONE("name") at the top of a scope to time it. Zones go into a fixed ring
+ * buffer per thread with no locking or allocation. Once a frame, the engine folds the new
+ * zones into rolling per-zone stats, which the stats view displays.
+ * The raw zones can be written as Chrome trace-event JSON for chrome://tracing or Perfetto,
+ * with F9 or (on linux) by sending the process SIGUSR1.
+ * Define DS_DISABLE_PROFILER to compile every zone out.
+ */
+class FrameProfiler {
+public:
+	typedef uint16_t					ZoneId;
+
+	class ZoneStats {
+	public:
+		ZoneStats() : mLastMs(0.0), mMedianMs(0.0), mP95Ms(0.0), mMaxMs(0.0) {}
+		std::string						mName;
+		double							mLastMs;
+		double							mMedianMs;
+		double							mP95Ms;
+		double							mMaxMs;
+	};
+
+	static FrameProfiler&				get();
+
+	/// Zone names are interned once, the macro keeps the id in a function-level static
+	static ZoneId						registerZone(const char* name);
+	/// Nanoseconds on a steady clock
+	static int64_t						now();
+	static bool							isEnabled() { return sEnabled.load(std::memory_order_relaxed); }
+	static void							setEnabled(const bool enabled) { sEnabled = enabled; }
+
+	/// Add a zone from the calling thread
+	void								record(const ZoneId, const int64_t start, const int64_t end);
+
+	/// Called by the engine at the start of each frame, on the main thread
+	void								endFrame();
+
+	/// Rolling stats over the last HISTORY_FRAMES frames for each zone, as time per frame summed across threads
+	std::vector<ZoneStats>				getStats() const;
+
+	/// Write everything still in the ring buffers as Chrome trace-event JSON
+	bool								writeChromeTrace(const std::string& path) const;
+	/// Writes a trace to %LOCAL%/logs and answers the path
+	std::string							dumpTrace() const;
+	/// Safe to call from a signal handler, the trace gets written on the next frame
+	void								requestDump() { mDumpRequested = true; }
+	/// Dump on SIGUSR1. Does nothing on windows
+	void								installSignalHandler();
+
+	static const size_t					EVENTS_PER_THREAD = 8192;
+	static const size_t					HISTORY_FRAMES = 240;
+
+private:
+	FrameProfiler();
+
+	// A ring buffer slot. mSeq is 0 while the owning thread writes the slot and its write index + 1
+	// once it's done, so a reader can throw away a slot that was torn or lapped while it read it.
+	class Event {
+	public:
+		Event() : mSeq(0), mStart(0), mEnd(0), mZone(0) {}
+		std::atomic<uint64_t>			mSeq;
+		std::atomic<int64_t>			mStart;
+		std::atomic<int64_t>			mEnd;
+		std::atomic<ZoneId>				mZone;
+	};
+
+	class EventCopy {
+	public:
+		int64_t							mStart;
+		int64_t							mEnd;
+		ZoneId							mZone;
+	};
+
+	class ThreadBuffer {
+	public:
+		ThreadBuffer(const size_t index) : mWrite(0), mRead(0), mIndex(index) {}
+		Event							mEvents[EVENTS_PER_THREAD];
+		std::atomic<uint64_t>			mWrite;
+		// Only touched by the main thread in endFrame()
+		uint64_t						mRead;
+		const size_t					mIndex;
+	};
+
+	class ZoneHistory {
+	public:
+		ZoneHistory() : mFrameTotal(0), mLast(0.0f), mSeen(false) {}
+		int64_t							mFrameTotal;
+		float							mLast;
+		bool							mSeen;
+		std::vector<float>				mFrames;
+	};
+
+	ThreadBuffer*						getThreadBuffer();
+	/// Copy out the event written at index. False if the slot holds anything else, or changed while it was read.
+	static bool							readEvent(const ThreadBuffer&, const uint64_t index, EventCopy&);
+
+	static std::atomic<bool>			sEnabled;
+
+	mutable std::mutex					mMutex;
+	std::vector<std::string>			mZoneNames;
+	std::vector<std::unique_ptr<ThreadBuffer>>
+										mBuffers;
+
+	// Main thread only
+	std::vector<ZoneHistory>			mHistory;
+	size_t								mHistoryIndex;
+	size_t								mHistoryCount;
+	int64_t								mFrameStart;
+	ZoneId								mFrameZone;
+	size_t								mMainThread;
+	std::atomic<bool>					mDumpRequested;
+};
+
+/**
+ * \class ds::debug::ProfileZone
+ * \brief RAII timer for a single zone. Use the DS_PROFILE_ZONE macro rather than this directly.
+ */
+class ProfileZone {
+public:
+	ProfileZone(const FrameProfiler::ZoneId id)
+		: mId(id)
+		, mStart(FrameProfiler::isEnabled() ? FrameProfiler::now() : 0) {}
+	~ProfileZone() {
+		if(mStart != 0) FrameProfiler::get().record(mId, mStart, FrameProfiler::now());
+	}
+
+private:
+	const FrameProfiler::ZoneId			mId;
+	const int64_t						mStart;
+};
+
+} // namespace debug
+} // namespace ds
+
+#ifdef DS_DISABLE_PROFILER
+	#define DS_PROFILE_ZONE(name)		(void)0
+#else
+	#define DS_PROFILE_CONCAT_IMPL(a, b)	a##b
+	#define DS_PROFILE_CONCAT(a, b)			DS_PROFILE_CONCAT_IMPL(a, b)
+	#define DS_PROFILE_ZONE(name)		static const ds::debug::FrameProfiler::ZoneId DS_PROFILE_CONCAT(dsProfileZoneId, __LINE__) = ds::debug::FrameProfiler::registerZone(name); \
+										ds::debug::ProfileZone DS_PROFILE_CONCAT(dsProfileZone, __LINE__)(DS_PROFILE_CONCAT(dsProfileZoneId, __LINE__))
+#endif
+
+#endif // DS_DEBUG_FRAMEPROFILER_H_
@@ -0,0 +1,323 @@
+#include "stdafx.h"
+
+#include "ds/gl/draw_list.h"
+
+#include <algorithm>
+
+namespace ds {
+namespace gl {
+
+namespace {
+const size_t				DEFAULT_LOOK_BACK = 32;
+const uint32_t				NONE = 0xFFFFFFFF;
+const int					GRID_MAX = 64;
+
+ci::Rectf					bounds_of(const DrawList::Quad& q) {
+	ci::Rectf				r(q.mCorner[0].x, q.mCorner[0].y, q.mCorner[0].x, q.mCorner[0].y);
+	for(int i = 1; i < 4; ++i) r.include(ci::vec2(q.mCorner[i].x, q.mCorner[i].y));
+	return r;
+}
+
+// Quads that only share an edge don't cover the same pixels, so they don't count
+bool						overlaps(const ci::Rectf& a, const ci::Rectf& b) {
+	return a.x1 < b.x2 && b.x1 < a.x2 && a.y1 < b.y2 && b.y1 < a.y2;
+}
+}
+
+/**
+ * \class ds::gl::DrawList::Quad
+ */
+DrawList::Quad::Quad()
+		: mColor(1.0f, 1.0f, 1.0f, 1.0f)
+		, mShader(nullptr)
+		, mTexture(nullptr)
+		, mBlend(0) {
+}
+
+/**
+ * \class ds::gl::DrawList::Stats
+ */
+DrawList::Stats::Stats()
+		: mQuads(0)
+		, mCustom(0)
+		, mClips(0)
+		, mBatches(0)
+		, mDrawCalls(0) {
+}
+
+/**
+ * \class ds::gl::DrawList
+ */
+DrawList::DrawList()
+		: mLookBack(DEFAULT_LOOK_BACK)
+		, mCellSize(1.0f)
+		, mGridWidth(0)
+		, mGridHeight(0) {
+}
+
+void DrawList::clear() {
+	mItems.clear();
+	mQuads.clear();
+	mQuadBounds.clear();
+	mCommands.clear();
+	mVertices.clear();
+	mStats = Stats();
+}
+
+void DrawList::addQuad(const Quad& q) {
+	Item					item;
+	item.mType = QUADS;
+	item.mIndex = static_cast<uint32_t>(mQuads.size());
+	mItems.push_back(item);
+	mQuads.push_back(q);
+	mQuadBounds.push_back(bounds_of(q));
+}
+
+void DrawList::addCustom(const uint32_t payload) {
+	Item					item;
+	item.mType = CUSTOM;
+	item.mIndex = payload;
+	mItems.push_back(item);
+}
+
+void DrawList::pushClip(const ci::Rectf& worldClip) {
+	Item					item;
+	item.mType = PUSH_CLIP;
+	item.mIndex = 0;
+	item.mClip = worldClip;
+	mItems.push_back(item);
+}
+
+void DrawList::popClip() {
+	Item					item;
+	item.mType = POP_CLIP;
+	item.mIndex = 0;
+	mItems.push_back(item);
+}
+
+void DrawList::setLookBack(const size_t n) {
+	mLookBack = std::max<size_t>(1, n);
+}
+
+void DrawList::compile() {
+	mCommands.clear();
+	mVertices.clear();
+	mStats = Stats();
+	mVertices.reserve(mQuads.size() * 4);
+	mNext.resize(mQuads.size());
+	mQuadBatch.resize(mQuads.size());
+
+	size_t					runBegin = 0;
+	for(size_t i = 0; i < mItems.size(); ++i) {
+		const Item&			item = mItems[i];
+		if(item.mType == QUADS) continue;
+
+		compileRun(runBegin, i);
+		runBegin = i + 1;
+
+		Command				cmd;
+		cmd.mType = item.mType;
+		cmd.mShader = nullptr;
+		cmd.mTexture = nullptr;
+		cmd.mBlend = 0;
+		cmd.mFirst = item.mIndex;
+		cmd.mCount = 0;
+		cmd.mClip = item.mClip;
+		mCommands.push_back(cmd);
+
+		if(item.mType == CUSTOM) {
+			++mStats.mCustom;
+			++mStats.mDrawCalls;
+		} else if(item.mType == PUSH_CLIP) {
+			++mStats.mClips;
+		}
+	}
+	compileRun(runBegin, mItems.size());
+}
+
+void DrawList::compileRun(const size_t begin, const size_t end) {
+	if(begin >= end) return;
+
+	// Size the grid so a typical quad covers a few cells, with no more than GRID_MAX a side
+	mGridBounds = mQuadBounds[mItems[begin].mIndex];
+	float					sizeSum = 0.0f;
+	for(size_t i = begin; i < end; ++i) {
+		const ci::Rectf&	r = mQuadBounds[mItems[i].mIndex];
+		mGridBounds.include(r);
+		sizeSum += std::max(r.getWidth(), r.getHeight());
+	}
+	const float				extent = std::max(mGridBounds.getWidth(), mGridBounds.getHeight());
+	mCellSize = std::max(std::max(sizeSum / static_cast<float>(end - begin), extent / GRID_MAX), 1.0f);
+	mGridWidth = std::min(GRID_MAX, static_cast<int>(mGridBounds.getWidth() / mCellSize) + 1);
+	mGridHeight = std::min(GRID_MAX, static_cast<int>(mGridBounds.getHeight() / mCellSize) + 1);
+	mCellHead.assign(static_cast<size_t>(mGridWidth * mGridHeight), NONE);
+	mCellQuad.clear();
+	mCellNext.clear();
+
+	// Each quad joins the latest batch with the same state, as long as nothing drawn in a
+	// later batch overlaps it. Otherwise it starts a new one.
+	mBatches.clear();
+	for(size_t i = begin; i < end; ++i) {
+		const uint32_t		q = mItems[i].mIndex;
+		const Quad&			quad = mQuads[q];
+		const ci::Rectf&	bounds = mQuadBounds[q];
+		mNext[q] = NONE;
+
+		uint32_t			target = NONE;
+		const size_t		stop = mBatches.size() > mLookBack ? mBatches.size() - mLookBack : 0;
+		for(size_t b = mBatches.size(); b > stop; --b) {
+			const Batch&	batch = mBatches[b - 1];
+			if(batch.mShader == quad.mShader && batch.mTexture == quad.mTexture && batch.mBlend == quad.mBlend) {
+				target = static_cast<uint32_t>(b - 1);
+				break;
+			}
+		}
+		if(target != NONE && coveredAfter(bounds, target)) target = NONE;
+
+		if(target != NONE) {
+			Batch&			batch = mBatches[target];
+			mNext[batch.mTail] = q;
+			batch.mTail = q;
+		} else {
+			Batch			batch;
+			batch.mShader = quad.mShader;
+			batch.mTexture = quad.mTexture;
+			batch.mBlend = quad.mBlend;
+			batch.mHead = batch.mTail = q;
+			target = static_cast<uint32_t>(mBatches.size());
+			mBatches.push_back(batch);
+		}
+		mQuadBatch[q] = target;
+
+		int					x1, y1, x2, y2;
+		cellRange(bounds, x1, y1, x2, y2);
+		for(int y = y1; y <= y2; ++y) {
+			for(int x = x1; x <= x2; ++x) {
+				uint32_t&	head = mCellHead[y * mGridWidth + x];
+				mCellQuad.push_back(q);
+				mCellNext.push_back(head);
+				head = static_cast<uint32_t>(mCellQuad.size() - 1);
+			}
+		}
+	}
+
+	for(const Batch& batch : mBatches) {
+		Command				cmd;
+		cmd.mType = QUADS;
+		cmd.mShader = batch.mShader;
+		cmd.mTexture = batch.mTexture;
+		cmd.mBlend = batch.mBlend;
+		cmd.mFirst = static_cast<uint32_t>(mVertices.size());
+		for(uint32_t q = batch.mHead; q != NONE; q = mNext[q]) {
+			const Quad&		quad = mQuads[q];
+			for(int k = 0; k < 4; ++k) {
+				Vertex		v;
+				v.mPosition = quad.mCorner[k];
+				v.mTexCoord = quad.mTexCoord[k];
+				v.mColor = quad.mColor;
+				mVertices.push_back(v);
+			}
+			++mStats.mQuads;
+		}
+		cmd.mCount = static_cast<uint32_t>(mVertices.size()) - cmd.mFirst;
+		mCommands.push_back(cmd);
+		++mStats.mBatches;
+		++mStats.mDrawCalls;
+	}
+}
+
+void DrawList::cellRange(const ci::Rectf& r, int& x1, int& y1, int& x2, int& y2) const {
+	x1 = std::max(0, std::min(mGridWidth - 1, static_cast<int>((r.x1 - mGridBounds.x1) / mCellSize)));
+	y1 = std::max(0, std::min(mGridHeight - 1, static_cast<int>((r.y1 - mGridBounds.y1) / mCellSize)));
+	x2 = std::max(0, std::min(mGridWidth - 1, static_cast<int>((r.x2 - mGridBounds.x1) / mCellSize)));
+	y2 = std::max(0, std::min(mGridHeight - 1, static_cast<int>((r.y2 - mGridBounds.y1) / mCellSize)));
+}
+
+bool DrawList::coveredAfter(const ci::Rectf& bounds, const uint32_t batch) const {
+	int						x1, y1, x2, y2;
+	cellRange(bounds, x1, y1, x2, y2);
+	for(int y = y1; y <= y2; ++y) {
+		for(int x = x1; x <= x2; ++x) {
+			for(uint32_t e = mCellHead[y * mGridWidth + x]; e != NONE; e = mCellNext[e]) {
+				const uint32_t	q = mCellQuad[e];
+				if(mQuadBatch[q] > batch && overlaps(mQuadBounds[q], bounds)) return true;
+			}
+		}
+	}
+	return false;
+}
+
+void DrawList::execute(DrawBackend& backend) const {
+	backend.begin(mVertices);
+	for(const Command& cmd : mCommands) {
+		switch(cmd.mType) {
+		case QUADS:		backend.drawQuads(cmd); break;
+		case CUSTOM:	backend.drawCustom(cmd.mFirst); break;
+		case PUSH_CLIP:	backend.pushClip(cmd.mClip); break;
+		case POP_CLIP:	backend.popClip(); break;
+		}
+	}
+	backend.end();
+}
+
+/**
+ * \class ds::gl::CountingDrawBackend
+ */
+CountingDrawBackend::CountingDrawBackend() {
+	reset();
+}
+
+void CountingDrawBackend::reset() {
+	mDrawCalls = 0;
+	mQuads = 0;
+	mCustom = 0;
+	mShaderChanges = 0;
+	mTextureChanges = 0;
+	mBlendChanges = 0;
+	mClipChanges = 0;
+	mMaxClipDepth = 0;
+	mCustomOrder.clear();
+	mStateKnown = false;
+	mShader = nullptr;
+	mTexture = nullptr;
+	mBlend = 0;
+	mClipDepth = 0;
+}
+
+void CountingDrawBackend::begin(const std::vector<DrawList::Vertex>&) {
+	mStateKnown = false;
+}
+
+void CountingDrawBackend::drawQuads(const DrawList::Command& cmd) {
+	++mDrawCalls;
+	mQuads += cmd.mCount / 4;
+	if(!mStateKnown || cmd.mShader != mShader) ++mShaderChanges;
+	if(!mStateKnown || cmd.mTexture != mTexture) ++mTextureChanges;
+	if(!mStateKnown || cmd.mBlend != mBlend) ++mBlendChanges;
+	mStateKnown = true;
+	mShader = cmd.mShader;
+	mTexture = cmd.mTexture;
+	mBlend = cmd.mBlend;
+}
+
+void CountingDrawBackend::drawCustom(const uint32_t payload) {
+	++mDrawCalls;
+	++mCustom;
+	mCustomOrder.push_back(payload);
+	// A custom draw sets whatever state it likes
+	mStateKnown = false;
+}
+
+void CountingDrawBackend::pushClip(const ci::Rectf&) {
+	++mClipChanges;
+	++mClipDepth;
+	mMaxClipDepth = std::max(mMaxClipDepth, mClipDepth);
+}
+
+void CountingDrawBackend::popClip() {
+	++mClipChanges;
+	if(mClipDepth > 0) --mClipDepth;
+}
+
+} // namespace gl
+} // namespace ds
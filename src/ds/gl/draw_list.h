@@ -0,0 +1,201 @@
+#pragma once
+#ifndef DS_GL_DRAWLIST_H_
+#define DS_GL_DRAWLIST_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <cinder/Color.h>
+#include <cinder/Rect.h>
+#include <cinder/Vector.h>
+
+namespace ds {
+namespace gl {
+class DrawBackend;
+
+/**
+ * \class ds::gl::DrawList
+ * \brief A flat list of draw commands, rebuilt each frame from the sprite tree.
+ * Plain quads are recorded already in world space. Anything else is a custom command
+ * that the backend draws the old way, in order.
+ *
+ * compile() works on each run of quads between two custom commands or clip changes.
+ * It groups the quads by shader, texture and blend mode, and each group becomes one
+ * batched draw. A quad only moves ahead of quads it doesn't overlap, so what ends up
+ * on screen is the same as drawing in tree order. Overlap is tested quad against quad,
+ * found through a coarse grid over the run, so tiles of different textures packed
+ * side by side still batch.
+ *
+ * The list never talks to GL. Shaders and textures are opaque keys, so it can be built,
+ * compiled and run against CountingDrawBackend without a context.
+ */
+class DrawList {
+public:
+	typedef const void*			Key;
+
+	class Vertex {
+	public:
+		ci::vec3				mPosition;
+		ci::vec2				mTexCoord;
+		ci::ColorA				mColor;
+	};
+
+	/// Corners go clockwise from the top left
+	class Quad {
+	public:
+		Quad();
+		ci::vec3				mCorner[4];
+		ci::vec2				mTexCoord[4];
+		ci::ColorA				mColor;
+		Key						mShader;
+		/// nullptr for a solid colour
+		Key						mTexture;
+		int						mBlend;
+	};
+
+	enum Type { QUADS, CUSTOM, PUSH_CLIP, POP_CLIP };
+
+	class Command {
+	public:
+		Type					mType;
+		Key						mShader;
+		Key						mTexture;
+		int						mBlend;
+		/// QUADS: vertex range in getVertices(), 4 per quad. CUSTOM: mFirst is the payload.
+		uint32_t				mFirst;
+		uint32_t				mCount;
+		/// PUSH_CLIP, in world space
+		ci::Rectf				mClip;
+	};
+
+	class Stats {
+	public:
+		Stats();
+		size_t					mQuads;
+		size_t					mCustom;
+		size_t					mClips;
+		/// Number of QUADS commands
+		size_t					mBatches;
+		/// Batches plus custom draws
+		size_t					mDrawCalls;
+	};
+
+	DrawList();
+
+	void						clear();
+	void						addQuad(const Quad&);
+	/// Something that can't be batched. The payload is handed back to DrawBackend::drawCustom().
+	void						addCustom(const uint32_t payload);
+	void						pushClip(const ci::Rectf& worldClip);
+	void						popClip();
+
+	/// Batch everything added since clear()
+	void						compile();
+	void						execute(DrawBackend&) const;
+
+	const std::vector<Command>&	getCommands() const { return mCommands; }
+	const std::vector<Vertex>&	getVertices() const { return mVertices; }
+	const Stats&				getStats() const { return mStats; }
+
+	/// How many batches back a quad can look for one to join. More finds more batches in busy scenes
+	/// at the cost of more overlap tests.
+	void						setLookBack(const size_t);
+
+private:
+	class Item {
+	public:
+		Type					mType;
+		uint32_t				mIndex;
+		ci::Rectf				mClip;
+	};
+
+	class Batch {
+	public:
+		Key						mShader;
+		Key						mTexture;
+		int						mBlend;
+		uint32_t				mHead, mTail;
+	};
+
+	void						compileRun(const size_t begin, const size_t end);
+	// The grid cells a quad's bounds cover
+	void						cellRange(const ci::Rectf&, int& x1, int& y1, int& x2, int& y2) const;
+	// True if a quad in a batch after the given one overlaps the bounds
+	bool						coveredAfter(const ci::Rectf&, const uint32_t batch) const;
+
+	std::vector<Item>			mItems;
+	std::vector<Quad>			mQuads;
+	std::vector<ci::Rectf>		mQuadBounds;
+	size_t						mLookBack;
+
+	std::vector<Command>		mCommands;
+	std::vector<Vertex>			mVertices;
+	Stats						mStats;
+
+	// Reused by compileRun()
+	std::vector<Batch>			mBatches;
+	std::vector<uint32_t>		mNext;
+	std::vector<uint32_t>		mQuadBatch;
+	// Each cell is a list of the quads touching it, threaded through mCellNext
+	ci::Rectf					mGridBounds;
+	float						mCellSize;
+	int							mGridWidth, mGridHeight;
+	std::vector<uint32_t>		mCellHead;
+	std::vector<uint32_t>		mCellQuad, mCellNext;
+};
+
+/**
+ * \class ds::gl::DrawBackend
+ * \brief Carries out a compiled DrawList.
+ */
+class DrawBackend {
+public:
+	virtual ~DrawBackend() {}
+
+	/// Called first with every vertex the list will draw, so they can be uploaded at once
+	virtual void				begin(const std::vector<DrawList::Vertex>&) {}
+	virtual void				drawQuads(const DrawList::Command&) = 0;
+	virtual void				drawCustom(const uint32_t payload) = 0;
+	virtual void				pushClip(const ci::Rectf&) = 0;
+	virtual void				popClip() = 0;
+	virtual void				end() {}
+};
+
+/**
+ * \class ds::gl::CountingDrawBackend
+ * \brief Draws nothing, just counts what a GL backend would have done.
+ */
+class CountingDrawBackend : public DrawBackend {
+public:
+	CountingDrawBackend();
+
+	void						reset();
+
+	virtual void				begin(const std::vector<DrawList::Vertex>&) override;
+	virtual void				drawQuads(const DrawList::Command&) override;
+	virtual void				drawCustom(const uint32_t payload) override;
+	virtual void				pushClip(const ci::Rectf&) override;
+	virtual void				popClip() override;
+
+	size_t						mDrawCalls;
+	size_t						mQuads;
+	size_t						mCustom;
+	size_t						mShaderChanges;
+	size_t						mTextureChanges;
+	size_t						mBlendChanges;
+	size_t						mClipChanges;
+	size_t						mMaxClipDepth;
+	std::vector<uint32_t>		mCustomOrder;
+
+private:
+	bool						mStateKnown;
+	DrawList::Key				mShader;
+	DrawList::Key				mTexture;
+	int							mBlend;
+	size_t						mClipDepth;
+};
+
+} // namespace gl
+} // namespace ds
+
+#endif // DS_GL_DRAWLIST_H_
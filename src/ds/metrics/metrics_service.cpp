@@ -2,6 +2,9 @@
 
 #include "metrics_service.h"
 
+#include <algorithm>
+#include <cmath>
+#include <Poco/Timestamp.h>
 #include <ds/debug/logger.h>
 #include <ds/debug/computer_info.h>
 #include <ds/util/string_util.h>
@@ -9,17 +12,49 @@
 
 namespace ds {
 
-MetricsService::MetricsService(ds::Engine& eng)
+namespace {
+// Upper bounds in milliseconds, the last bucket catches everything else
+const double		LATENCY_BUCKETS[] = { 1.0, 2.0, 5.0, 10.0, 20.0, 50.0, 100.0, 200.0, 500.0, 1000.0, 2000.0, 5000.0, 1.0e12 };
+
+// If telegraf isn't keeping up (or we're not connected), don't let the queue grow forever
+const size_t		MAX_PENDING_SIZE = 4 * 1024 * 1024;
+
+std::string			timestamp_suffix() {
+	// Lines are batched, so they need their own timestamp or telegraf will stamp them all with the flush time
+	return " " + std::to_string(Poco::Timestamp().epochMicroseconds() * 1000) + "\n";
+}
+}
+
+MetricsService::MetricsService(ds::ui::SpriteEngine& eng)
 	: mEngine(eng)
 	, mActive(true)
 	, mSendBaseInfo(true)
 	, mSendTouchInfo(false)
 	, mCallbacks(eng)
+	, mMaxPacketSize(1400)
+	, mFlushInterval(1.0)
+	, mDroppedLines(0)
+	, mAbort(false)
 {
 
 	mActive = mEngine.getSettings("engine").getBool("metrics:active");
 	mSendBaseInfo = mEngine.getSettings("engine").getBool("metrics:send_base_info");
 	mSendTouchInfo = mEngine.getSettings("engine").getBool("metrics:send_touch_info");
+	mFlushInterval = mEngine.getSettings("engine").getDouble("metrics:flush_interval", 0, mFlushInterval);
+	mMaxPacketSize = static_cast<size_t>(mEngine.getSettings("engine").getInt("metrics:max_packet_size", 0, static_cast<int>(mMaxPacketSize)));
+	if(mFlushInterval < 0.01) mFlushInterval = 0.01;
+	if(mMaxPacketSize < 128) mMaxPacketSize = 128;
+
+	std::string appName = mEngine.getAppInstanceName();
+	sanitizeString(appName);
+	mAppTag = ",app=" + appName;
+
+	mFpsId = getMetricId("engine", "fps");
+	mSpritesId = getMetricId("engine", "sprites");
+	mPhysicalMemoryId = getMetricId("engine", "physical_memory");
+	mVirtualMemoryId = getMetricId("engine", "virtual_memory");
+	mTouchAddedId = getMetricId("input", "added");
+	mTouchRemovedId = getMetricId("input", "removed");
 
 	if(mActive) {
 		std::string host = mEngine.getSettings("engine").getString("metrics:udp_host");
@@ -27,6 +62,8 @@ MetricsService::MetricsService(ds::Engine& eng)
 		if(mUdpReccy.connect(host, port)) {
 			DS_LOG_INFO("MetricsService: connected to telegraf udp at " << host << ":" << port);
 		}
+
+		mFlushThread = std::thread([this] { flushLoop(); });
 	}
 
 	if(mSendBaseInfo) {
@@ -40,12 +77,24 @@ MetricsService::MetricsService(ds::Engine& eng)
 	}
 }
 
+MetricsService::~MetricsService() {
+	{
+		std::lock_guard<std::mutex> lock(mFlushMutex);
+		mAbort = true;
+	}
+	mFlushCondition.notify_all();
+	if(mFlushThread.joinable()) {
+		mFlushThread.join();
+	}
+}
+
 void MetricsService::sendSystemInfo() {
-	auto fps = mEngine.getAverageFps();
-	recordMetric("engine", "fps", std::to_string(fps));
-	recordMetric("engine", "sprites", std::to_string(mEngine.getNumberOfSprites()));
-	recordMetric("engine", "physical_memory", std::to_string(mEngine.getComputerInfo().getPhysicalMemoryUsedByProcess()));
-	recordMetric("engine", "virtual_memory", std::to_string(mEngine.getComputerInfo().getVirtualMemoryUsedByProcess()));
+	if(auto engine = dynamic_cast<ds::Engine*>(&mEngine)) {
+		setGauge(mFpsId, static_cast<double>(engine->getAverageFps()));
+		setGauge(mSpritesId, static_cast<double>(engine->getNumberOfSprites()));
+	}
+	setGauge(mPhysicalMemoryId, static_cast<double>(mEngine.getComputerInfo().getPhysicalMemoryUsedByProcess()));
+	setGauge(mVirtualMemoryId, static_cast<double>(mEngine.getComputerInfo().getVirtualMemoryUsedByProcess()));
 }
 
 void MetricsService::sanitizeString(std::string& theStr) {
@@ -54,15 +103,13 @@ void MetricsService::sanitizeString(std::string& theStr) {
 }
 
 void MetricsService::recordMetric(const std::string& metricName, const std::string& fieldName, const std::string& fieldValue) {
-	std::string appName = mEngine.getEngineData().mAppInstanceName;
 	auto theMetricName = metricName;
 	auto theFieldName = fieldName;
 	auto theFieldValue = fieldValue;
-	sanitizeString(appName);
 	sanitizeString(theMetricName);
 	sanitizeString(theFieldName);
 	sanitizeString(theFieldValue);
-	sendMetrics(theMetricName + ",app=" + appName + " " + theFieldName + "=" + theFieldValue + "\n");
+	sendMetrics(theMetricName + mAppTag + " " + theFieldName + "=" + theFieldValue + timestamp_suffix());
 }
 
 void MetricsService::recordMetric(const std::string& metricName, const std::string& fieldName, const int& fieldValue) {
@@ -78,30 +125,25 @@ void MetricsService::recordMetric(const std::string& metricName, const std::stri
 }
 
 void MetricsService::recordMetric(const std::string& metricName, const std::string& fieldName, const ci::vec2& fieldValue) {
-	recordMetric(metricName, fieldName + "_x", std::to_string(fieldValue.x));
-	recordMetric(metricName, fieldName + "_y", std::to_string(fieldValue.y));
+	recordMetric(metricName, fieldName + "_x=" + std::to_string(fieldValue.x) + "," + fieldName + "_y=" + std::to_string(fieldValue.y));
 }
 
 void MetricsService::recordMetric(const std::string& metricName, const std::string& fieldName, const ci::vec3& fieldValue) {
-	recordMetric(metricName, fieldName + "_x", std::to_string(fieldValue.x));
-	recordMetric(metricName, fieldName + "_y", std::to_string(fieldValue.y));
-	recordMetric(metricName, fieldName + "_z", std::to_string(fieldValue.z));
+	recordMetric(metricName, fieldName + "_x=" + std::to_string(fieldValue.x) + "," + fieldName + "_y=" + std::to_string(fieldValue.y)
+				 + "," + fieldName + "_z=" + std::to_string(fieldValue.z));
 }
 
 void MetricsService::recordMetric(const std::string& metricName, const std::string& fieldName, const ci::Rectf& fieldValue) {
-	recordMetric(metricName, fieldName + "_x", std::to_string(fieldValue.x1));
-	recordMetric(metricName, fieldName + "_y", std::to_string(fieldValue.y1));
-	recordMetric(metricName, fieldName + "_w", std::to_string(fieldValue.getWidth()));
-	recordMetric(metricName, fieldName + "_h", std::to_string(fieldValue.getHeight()));
+	recordMetric(metricName, fieldName + "_x=" + std::to_string(fieldValue.x1) + "," + fieldName + "_y=" + std::to_string(fieldValue.y1)
+				 + "," + fieldName + "_w=" + std::to_string(fieldValue.getWidth()) + "," + fieldName + "_h=" + std::to_string(fieldValue.getHeight()));
 }
 
 void MetricsService::recordMetric(const std::string& metricName, const std::string& fieldNameAndValue) {
-	std::string appName = mEngine.getEngineData().mAppInstanceName;
 	auto theMetricName = metricName;
 	auto theFieldValue = fieldNameAndValue;
 	sanitizeString(theMetricName);
 	sanitizeString(theFieldValue);
-	sendMetrics(theMetricName + ",app=" + appName + " " + fieldNameAndValue + "\n");
+	sendMetrics(theMetricName + mAppTag + " " + theFieldValue + timestamp_suffix());
 }
 
 void MetricsService::recordMetricString(const std::string& metricName, const std::string& fieldName, const std::string& stringValue) {
@@ -118,23 +160,219 @@ void MetricsService::recordMetricTouch(ds::ui::TouchInfo& ti) {
 	//ignore moved. 
 	if(ti.mPhase == ds::ui::TouchInfo::Moved) return;
 
-	/// Save a separate setting so we can track number of inputs separate from all of the info
+	/// Count inputs separately so we can track number of inputs separate from all of the info
 	if(ti.mPhase == ds::ui::TouchInfo::Added) {
-		recordMetric("input", "added", "1");
+		incrementCounter(mTouchAddedId);
 	} else if(ti.mPhase == ds::ui::TouchInfo::Removed) {
-		recordMetric("input", "removed", "1");
+		incrementCounter(mTouchRemovedId);
 	}
-	recordMetric("input", "phase", ti.mPhase);
-	recordMetric("input", "finger_id", ti.mFingerId);
-	recordMetric("input", "pos", ti.mCurrentGlobalPoint);
+	recordMetric("input", "phase=" + std::to_string(ti.mPhase) + ",finger_id=" + std::to_string(ti.mFingerId)
+				 + ",pos_x=" + std::to_string(ti.mCurrentGlobalPoint.x) + ",pos_y=" + std::to_string(ti.mCurrentGlobalPoint.y)
+				 + ",pos_z=" + std::to_string(ti.mCurrentGlobalPoint.z));
+}
+
+MetricsService::MetricId MetricsService::getMetricId(const std::string& metricName, const std::string& fieldName, const std::string& tags) {
+	auto theMetricName = metricName;
+	auto theFieldName = fieldName;
+	auto theTags = tags;
+	sanitizeString(theMetricName);
+	sanitizeString(theFieldName);
+	sanitizeString(theTags);
+
+	std::string series = theMetricName + mAppTag;
+	if(!theTags.empty()) series += "," + theTags;
+	const std::string key = series + " " + theFieldName;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	auto found = mMetricIds.find(key);
+	if(found != mMetricIds.end()) return found->second;
+
+	const MetricId id = mAggregates.size();
+	mAggregates.push_back(Aggregate(series, theFieldName));
+	mMetricIds[key] = id;
+	return id;
+}
+
+void MetricsService::incrementCounter(const MetricId id, const int64_t amount) {
+	if(!mActive) return;
+	std::lock_guard<std::mutex> lock(mMutex);
+	if(id >= mAggregates.size()) return;
+	AggregateValues& v = mAggregates[id].mValues;
+	if(v.empty()) mDirtyAggregates.push_back(id);
+	v.mCount += amount;
+	v.mHasCount = true;
+}
+
+void MetricsService::setGauge(const MetricId id, const double value) {
+	if(!mActive) return;
+	std::lock_guard<std::mutex> lock(mMutex);
+	if(id >= mAggregates.size()) return;
+	AggregateValues& v = mAggregates[id].mValues;
+	if(v.empty()) mDirtyAggregates.push_back(id);
+	v.mGauge = value;
+	v.mHasGauge = true;
+}
+
+void MetricsService::recordLatency(const MetricId id, const double milliseconds) {
+	if(!mActive) return;
+	size_t bucket = 0;
+	while(bucket < NUM_LATENCY_BUCKETS - 1 && milliseconds > LATENCY_BUCKETS[bucket]) ++bucket;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	if(id >= mAggregates.size()) return;
+	AggregateValues& v = mAggregates[id].mValues;
+	if(v.empty()) mDirtyAggregates.push_back(id);
+	v.mBuckets[bucket]++;
+	v.mSamples++;
+	v.mSum += milliseconds;
+	v.mMax = std::max(v.mMax, milliseconds);
+}
+
+void MetricsService::incrementCounter(const std::string& metricName, const std::string& fieldName, const int64_t amount) {
+	incrementCounter(getMetricId(metricName, fieldName), amount);
+}
+
+void MetricsService::setGauge(const std::string& metricName, const std::string& fieldName, const double value) {
+	setGauge(getMetricId(metricName, fieldName), value);
+}
+
+void MetricsService::recordLatency(const std::string& metricName, const std::string& fieldName, const double milliseconds) {
+	recordLatency(getMetricId(metricName, fieldName), milliseconds);
 }
 
 void MetricsService::sendMetrics(const std::string& metrix) {
 	DS_LOG_VERBOSE(1, metrix);
-	if(mUdpReccy.isConnected()) {
-		mUdpReccy.sendMessage(metrix);
+	if(!mActive) return;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	if(mPending.size() + metrix.size() > MAX_PENDING_SIZE) {
+		mDroppedLines++;
+		return;
+	}
+	mPending.append(metrix);
+}
+
+void MetricsService::flushLoop() {
+	std::unique_lock<std::mutex> lock(mFlushMutex);
+	while(!mAbort) {
+		mFlushCondition.wait_for(lock, std::chrono::microseconds(static_cast<int64_t>(mFlushInterval * 1000000.0)));
+		lock.unlock();
+		flush();
+		lock.lock();
 	}
 }
 
+void MetricsService::flush() {
+	std::lock_guard<std::mutex> sendLock(mSendMutex);
+
+	// Grab everything under the lock, then format and send without holding up the recording threads
+	std::string lines;
+	std::vector<std::pair<const Aggregate*, AggregateValues>> aggregates;
+	size_t dropped = 0;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		lines.swap(mPending);
+		mPending.reserve(lines.capacity());
+		aggregates.reserve(mDirtyAggregates.size());
+		for(auto id : mDirtyAggregates) {
+			Aggregate& agg = mAggregates[id];
+			aggregates.push_back(std::make_pair(&agg, agg.mValues));
+			agg.mValues.clear();
+		}
+		mDirtyAggregates.clear();
+		std::swap(dropped, mDroppedLines);
+	}
+
+	if(dropped > 0) {
+		DS_LOG_WARNING("MetricsService: dropped " << dropped << " metrics because the send queue was full");
+	}
+
+	if(!aggregates.empty()) {
+		const std::string timestamp = timestamp_suffix();
+		for(auto& it : aggregates) {
+			writeAggregate(*it.first, it.second, timestamp, lines);
+		}
+	}
+
+	sendPackets(lines);
 }
 
+void MetricsService::writeAggregate(const Aggregate& agg, const AggregateValues& v, const std::string& timestamp, std::string& out) const {
+	out.append(agg.mSeries);
+	out.push_back(' ');
+
+	bool first = true;
+	auto field = [&out, &agg, &first](const char* suffix, const std::string& value) {
+		if(!first) out.push_back(',');
+		first = false;
+		out.append(agg.mField);
+		out.append(suffix);
+		out.push_back('=');
+		out.append(value);
+	};
+
+	if(v.mHasCount) field("", std::to_string(v.mCount));
+	if(v.mHasGauge) field(v.mHasCount ? "_gauge" : "", std::to_string(v.mGauge));
+	if(v.mSamples > 0) {
+		field("_count", std::to_string(v.mSamples));
+		field("_mean", std::to_string(v.mSum / static_cast<double>(v.mSamples)));
+		field("_max", std::to_string(v.mMax));
+
+		// Percentiles are the upper bound of the bucket they land in, clamped to the largest sample
+		const double percentiles[] = { 0.5, 0.9, 0.99 };
+		const char* names[] = { "_p50", "_p90", "_p99" };
+		for(size_t p = 0; p < 3; ++p) {
+			const uint32_t target = static_cast<uint32_t>(std::ceil(percentiles[p] * static_cast<double>(v.mSamples)));
+			uint32_t seen = 0;
+			size_t bucket = 0;
+			for(; bucket < NUM_LATENCY_BUCKETS - 1; ++bucket) {
+				seen += v.mBuckets[bucket];
+				if(seen >= target) break;
+			}
+			field(names[p], std::to_string(std::min(LATENCY_BUCKETS[bucket], v.mMax)));
+		}
+	}
+	out.append(timestamp);
+}
+
+void MetricsService::sendPackets(const std::string& lines) {
+	if(lines.empty() || !mUdpReccy.isConnected()) return;
+
+	// Pack whole lines into datagrams up to the max packet size. A single line that's too big goes on its own.
+	size_t packetStart = 0;
+	size_t packetEnd = 0;
+	while(packetEnd < lines.size()) {
+		size_t lineEnd = lines.find('\n', packetEnd);
+		lineEnd = (lineEnd == std::string::npos) ? lines.size() : lineEnd + 1;
+
+		if(lineEnd - packetStart > mMaxPacketSize && packetEnd > packetStart) {
+			mUdpReccy.sendMessage(lines.data() + packetStart, static_cast<int>(packetEnd - packetStart));
+			packetStart = packetEnd;
+		}
+		packetEnd = lineEnd;
+	}
+	if(packetEnd > packetStart) {
+		mUdpReccy.sendMessage(lines.data() + packetStart, static_cast<int>(packetEnd - packetStart));
+	}
+}
+
+MetricsService::AggregateValues::AggregateValues() {
+	clear();
+}
+
+bool MetricsService::AggregateValues::empty() const {
+	return !mHasCount && !mHasGauge && mSamples == 0;
+}
+
+void MetricsService::AggregateValues::clear() {
+	mCount = 0;
+	mHasCount = false;
+	mGauge = 0.0;
+	mHasGauge = false;
+	mBuckets.fill(0);
+	mSamples = 0;
+	mSum = 0.0;
+	mMax = 0.0;
+}
+
+}
@@ -2,6 +2,12 @@
 #ifndef DS_METRICS_METRICS_SERVICE_
 #define DS_METRICS_METRICS_SERVICE_
 
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <ds/app/engine/engine.h>
 #include <ds/network/single_udp_receiver.h>
 #include <ds/app/auto_update.h>
@@ -11,11 +17,18 @@ namespace ds {
 /**
 * \class vm::MetricsService
 * \brief Sends metrics data to a telegraf data collector
+*		 Nothing is sent from the calling thread. Raw metrics are timestamped and queued, counters, gauges
+*		 and latencies are aggregated in place, and everything is flushed on a background thread as
+*		 batched line-protocol packets every metrics:flush_interval seconds.
 */
 class MetricsService {
 public:
-	/// Auto-tags all recordings with the app name and sanitizes the output
-	MetricsService(ds::Engine&);
+	typedef size_t						MetricId;
+
+	/// Auto-tags all recordings with the app name and sanitizes the output.
+	/// The frame rate and sprite count are only sent when the engine is a ds::Engine.
+	MetricsService(ds::ui::SpriteEngine&);
+	~MetricsService();
 
 	/// Sends the raw field value, so if this should be a string to be saved, you'll need to wrap it in quotes or use the recordMetricString() function
 	void								recordMetric(const std::string& metricName, const std::string& fieldName, const std::string& fieldValue);
@@ -29,7 +42,7 @@ public:
 	/// Appends _x, _y, _w, _h to field name to save 4 metrics, one for each part of the rect
 	void								recordMetric(const std::string& metricName, const std::string& fieldName, const ci::Rectf& fieldValue);
 
-	/// Combined field and value in the format field0=fieldValue,field1=field1value 
+	/// Combined field and value in the format field0=fieldValue,field1=field1value
 	/// Use this if you're sending multiple fields that should have the same timestamp
 	/// You'll need to wrap any string values in quotes
 	void								recordMetric(const std::string& metricName, const std::string& fieldNameAndValue);
@@ -41,23 +54,97 @@ public:
 	/// Saves an input with x, y, fingerid and phase
 	void								recordMetricTouch(ds::ui::TouchInfo& ti);
 
+	/// Aggregated metrics. Look up the id once and keep it, recording against an id does no string work.
+	/// Tags are optional, in the format tag0=value0,tag1=value1. The app tag is always added.
+	MetricId							getMetricId(const std::string& metricName, const std::string& fieldName, const std::string& tags = "");
+	/// Counters are summed between flushes and sent as the total
+	void								incrementCounter(const MetricId, const int64_t amount = 1);
+	/// Gauges send the last value set before a flush
+	void								setGauge(const MetricId, const double value);
+	/// Latencies go into fixed buckets and send count, mean, max, p50, p90 and p99 for each flush
+	void								recordLatency(const MetricId, const double milliseconds);
+
+	void								incrementCounter(const std::string& metricName, const std::string& fieldName, const int64_t amount = 1);
+	void								setGauge(const std::string& metricName, const std::string& fieldName, const double value);
+	void								recordLatency(const std::string& metricName, const std::string& fieldName, const double milliseconds);
 
+	/// Sends everything that's queued right now. Normally the flush thread takes care of this.
+	void								flush();
 
 private:
+	static const size_t					NUM_LATENCY_BUCKETS = 13;
+
+	class AggregateValues {
+	public:
+		AggregateValues();
+
+		bool							empty() const;
+		void							clear();
+
+		int64_t							mCount;
+		bool							mHasCount;
+		double							mGauge;
+		bool							mHasGauge;
+		std::array<uint32_t, NUM_LATENCY_BUCKETS>
+										mBuckets;
+		uint32_t						mSamples;
+		double							mSum;
+		double							mMax;
+	};
+
+	class Aggregate {
+	public:
+		Aggregate(const std::string& series, const std::string& field) : mSeries(series), mField(field) {}
+		// Never change after the aggregate is created, so the flush thread can read them without the lock
+		const std::string				mSeries;
+		const std::string				mField;
+		AggregateValues					mValues;
+	};
+
 	void								sendMetrics(const std::string& metrix);
 	void								sendSystemInfo();
+	void								flushLoop();
+	void								writeAggregate(const Aggregate&, const AggregateValues&, const std::string& timestamp, std::string& out) const;
+	void								sendPackets(const std::string& lines);
 
 	bool								mActive;
 	bool								mSendBaseInfo;
 	bool								mSendTouchInfo;
-	
+
 	ds::time::Callback					mCallbacks;
-	ds::Engine&							mEngine;
+	ds::ui::SpriteEngine&				mEngine;
 	ds::UdpReceiver						mUdpReccy;
 
 	void								sanitizeString(std::string& theStr);
+
+	// ",app=<name>", sanitized once
+	std::string							mAppTag;
+	size_t								mMaxPacketSize;
+	double								mFlushInterval;
+
+	std::mutex							mMutex;
+	std::string							mPending;
+	size_t								mDroppedLines;
+	std::unordered_map<std::string, MetricId>
+										mMetricIds;
+	// deque so aggregates don't move when new ones are added
+	std::deque<Aggregate>				mAggregates;
+	std::vector<MetricId>				mDirtyAggregates;
+
+	MetricId							mFpsId;
+	MetricId							mSpritesId;
+	MetricId							mPhysicalMemoryId;
+	MetricId							mVirtualMemoryId;
+	MetricId							mTouchAddedId;
+	MetricId							mTouchRemovedId;
+
+	std::mutex							mSendMutex;
+	std::mutex							mFlushMutex;
+	std::condition_variable				mFlushCondition;
+	bool								mAbort;
+	std::thread							mFlushThread;
 };
 
-} 
+}
 
 #endif // !DS_METRICS_METRICS_SERVICE_
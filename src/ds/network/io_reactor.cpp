@@ -0,0 +1,421 @@
+#include "stdafx.h"
+
+#include "ds/network/io_reactor.h"
+
+#include <algorithm>
+#include <limits>
+#include <Poco/Net/SocketImpl.h>
+#include <Poco/Timespan.h>
+#include "ds/debug/logger.h"
+
+#if defined(__linux__)
+#define DS_IO_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+namespace ds {
+namespace net {
+
+namespace {
+// Longest wait without a timer due, anything added wakes the thread anyway
+const int					MAX_WAIT_MS = 1000;
+// Id of the wake up handle in epoll, handler ids start after it
+const IoReactor::HandlerId	WAKE_ID = 0;
+#ifdef DS_IO_EPOLL
+const int					MAX_EVENTS = 64;
+#endif
+
+void call_safely(const IoReactor::Callback& cb) {
+	try {
+		if(cb) cb();
+	} catch(std::exception& e) {
+		DS_LOG_WARNING("IoReactor handler exception: " << e.what());
+	} catch(...) {
+		DS_LOG_WARNING("IoReactor handler unknown exception");
+	}
+}
+
+}
+
+/**
+ * \class ds::net::IoReactor
+ */
+IoReactor::IoReactor()
+		: mRunning(false)
+		, mStopping(false)
+		, mNextId(WAKE_ID + 1)
+		, mDispatching(WAKE_ID)
+		, mStart(std::chrono::steady_clock::now()) {
+#ifdef DS_IO_EPOLL
+	mEpoll = epoll_create1(EPOLL_CLOEXEC);
+	mWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(mEpoll >= 0 && mWakeFd >= 0) {
+		epoll_event			ev;
+		ev.events = EPOLLIN;
+		ev.data.u64 = WAKE_ID;
+		epoll_ctl(mEpoll, EPOLL_CTL_ADD, mWakeFd, &ev);
+	} else {
+		DS_LOG_ERROR("IoReactor couldn't create its epoll instance");
+	}
+#else
+	try {
+		mWakeSocket.bind(Poco::Net::SocketAddress("127.0.0.1", 0));
+		mWakeSocket.setBlocking(false);
+	} catch(std::exception& e) {
+		DS_LOG_ERROR("IoReactor couldn't create its wake up socket: " << e.what());
+	}
+#endif
+}
+
+IoReactor::~IoReactor() {
+	stop();
+
+#ifdef DS_IO_EPOLL
+	if(mWakeFd >= 0) close(mWakeFd);
+	if(mEpoll >= 0) close(mEpoll);
+#else
+	try {
+		mWakeSocket.close();
+	} catch(std::exception&) {
+	}
+#endif
+}
+
+IoReactor::HandlerId IoReactor::addSocket(const Poco::Net::Socket& socket, const Callback& onReadable, const Callback& onWritable) {
+	if(!onReadable || !socket.impl() || socket.impl()->sockfd() == POCO_INVALID_SOCKET) return 0;
+
+	HandlerRef						h = std::make_shared<Handler>();
+	h->mSocket = socket;
+	h->mIsSocket = true;
+	h->mCallback = onReadable;
+	h->mOnWritable = onWritable;
+
+	{
+		std::lock_guard<std::mutex>	lock(mMutex);
+		h->mId = mNextId++;
+
+#ifdef DS_IO_EPOLL
+		epoll_event					ev;
+		ev.events = EPOLLIN;
+		ev.data.u64 = static_cast<uint64_t>(h->mId);
+		if(epoll_ctl(mEpoll, EPOLL_CTL_ADD, static_cast<int>(socket.impl()->sockfd()), &ev) != 0) {
+			DS_LOG_WARNING("IoReactor couldn't watch socket " << socket.impl()->sockfd());
+			return 0;
+		}
+#endif
+		mHandlers[h->mId] = h;
+		start();
+	}
+
+	// The select list gets rebuilt when it wakes
+	wake();
+	return h->mId;
+}
+
+void IoReactor::setWritable(const HandlerId id, const bool on) {
+	{
+		std::lock_guard<std::mutex>	lock(mMutex);
+		auto						found = mHandlers.find(id);
+		if(found == mHandlers.end()) return;
+		Handler&					h = *found->second;
+		if(!h.mIsSocket || !h.mOnWritable || h.mWantsWritable == on) return;
+		h.mWantsWritable = on;
+
+#ifdef DS_IO_EPOLL
+		epoll_event					ev;
+		ev.events = EPOLLIN | (on ? EPOLLOUT : 0);
+		ev.data.u64 = static_cast<uint64_t>(id);
+		epoll_ctl(mEpoll, EPOLL_CTL_MOD, static_cast<int>(h.mSocket.impl()->sockfd()), &ev);
+	}
+#else
+	}
+	// The select lists get rebuilt when it wakes
+	if(!isReactorThread()) wake();
+#endif
+}
+
+IoReactor::HandlerId IoReactor::addTimer(const double seconds, const Callback& cb, const bool repeat) {
+	if(!cb) return 0;
+
+	HandlerRef						h = std::make_shared<Handler>();
+	h->mCallback = cb;
+	h->mInterval = std::max(0.0, seconds);
+	h->mDue = now() + h->mInterval;
+	h->mRepeat = repeat;
+
+	{
+		std::lock_guard<std::mutex>	lock(mMutex);
+		h->mId = mNextId++;
+		mHandlers[h->mId] = h;
+		start();
+	}
+
+	// So the wait is no longer than the new timer
+	wake();
+	return h->mId;
+}
+
+void IoReactor::remove(const HandlerId id) {
+	std::unique_lock<std::mutex>	lock(mMutex);
+	auto							found = mHandlers.find(id);
+	if(found == mHandlers.end()) return;
+
+#ifdef DS_IO_EPOLL
+	const HandlerRef&				h = found->second;
+	if(h->mIsSocket && h->mSocket.impl()) {
+		epoll_ctl(mEpoll, EPOLL_CTL_DEL, static_cast<int>(h->mSocket.impl()->sockfd()), nullptr);
+	}
+#endif
+	mHandlers.erase(found);
+
+	if(!isReactorThread()) {
+		mDispatchDone.wait(lock, [this, id]() { return mDispatching != id; });
+	}
+}
+
+void IoReactor::post(const Callback& cb) {
+	if(!cb) return;
+
+	{
+		std::lock_guard<std::mutex>	lock(mMutex);
+		mPosted.push_back(cb);
+		start();
+	}
+	wake();
+}
+
+void IoReactor::stop() {
+	{
+		std::lock_guard<std::mutex>	lock(mMutex);
+		if(!mRunning) return;
+		mStopping = true;
+	}
+
+	wake();
+	if(mThread.joinable()) mThread.join();
+
+	std::lock_guard<std::mutex>		lock(mMutex);
+	mRunning = false;
+	mStopping = false;
+}
+
+bool IoReactor::isRunning() const {
+	std::lock_guard<std::mutex>		lock(mMutex);
+	return mRunning && !mStopping;
+}
+
+bool IoReactor::isReactorThread() const {
+	return mThreadId.load() == std::this_thread::get_id();
+}
+
+void IoReactor::start() {
+	// mMutex is locked
+	if(mRunning) return;
+
+#ifdef DS_IO_EPOLL
+	if(mEpoll < 0) return;
+#endif
+	mRunning = true;
+	mThread = std::thread(&IoReactor::run, this);
+}
+
+void IoReactor::run() {
+	mThreadId = std::this_thread::get_id();
+
+	std::vector<Ready>				ready;
+	std::vector<Callback>			posted;
+	while(true) {
+		{
+			std::lock_guard<std::mutex>	lock(mMutex);
+			if(mStopping) break;
+			posted.swap(mPosted);
+		}
+		for(auto& it : posted) {
+			call_safely(it);
+		}
+		posted.clear();
+
+		ready.clear();
+		waitForEvents(getTimeout(), ready);
+
+		for(auto& it : ready) {
+			HandlerRef				h;
+			{
+				std::lock_guard<std::mutex>	lock(mMutex);
+				if(mStopping) break;
+				auto				found = mHandlers.find(it.first);
+				// Removed since the wait finished
+				if(found == mHandlers.end()) continue;
+				h = found->second;
+				mDispatching = it.first;
+			}
+			dispatch(h, it.second);
+		}
+
+		runTimers();
+	}
+
+	mThreadId = std::thread::id();
+}
+
+void IoReactor::wake() {
+#ifdef DS_IO_EPOLL
+	const uint64_t					one = 1;
+	if(write(mWakeFd, &one, sizeof(one)) < 0) {
+		// Already has a wake up pending
+	}
+#else
+	try {
+		mWakeSocket.sendTo("w", 1, mWakeSocket.address());
+	} catch(std::exception&) {
+	}
+#endif
+}
+
+void IoReactor::waitForEvents(const int timeoutMs, std::vector<Ready>& ready) {
+#ifdef DS_IO_EPOLL
+	epoll_event						events[MAX_EVENTS];
+	const int						n = epoll_wait(mEpoll, events, MAX_EVENTS, timeoutMs);
+	for(int i = 0; i < n; ++i) {
+		const HandlerId				id = static_cast<HandlerId>(events[i].data.u64);
+		if(id == WAKE_ID) {
+			uint64_t				count = 0;
+			if(read(mWakeFd, &count, sizeof(count)) < 0) {
+				// Someone else drained it
+			}
+			continue;
+		}
+		// A hang up or error is for the reader to find out about
+		int							ev = 0;
+		if(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) ev |= READABLE;
+		if(events[i].events & EPOLLOUT) ev |= WRITABLE;
+		ready.push_back(Ready(id, ev));
+	}
+#else
+	Poco::Net::Socket::SocketList	readList, writeList, exceptList;
+	std::vector<std::pair<HandlerId, Poco::Net::Socket>>	sockets;
+	readList.push_back(mWakeSocket);
+	{
+		std::lock_guard<std::mutex>	lock(mMutex);
+		for(auto& it : mHandlers) {
+			if(!it.second->mIsSocket) continue;
+			readList.push_back(it.second->mSocket);
+			if(it.second->mWantsWritable) writeList.push_back(it.second->mSocket);
+			sockets.push_back(std::make_pair(it.first, it.second->mSocket));
+		}
+	}
+
+	try {
+		if(Poco::Net::Socket::select(readList, writeList, exceptList, Poco::Timespan(0, timeoutMs * 1000)) < 1) return;
+	} catch(std::exception& e) {
+		DS_LOG_WARNING("IoReactor select error: " << e.what());
+		return;
+	}
+
+	for(auto& s : readList) {
+		if(s == mWakeSocket) {
+			char					buf[64];
+			try {
+				while(mWakeSocket.available() > 0) mWakeSocket.receiveBytes(buf, sizeof(buf));
+			} catch(std::exception&) {
+			}
+			continue;
+		}
+		for(auto& it : sockets) {
+			if(it.second == s) ready.push_back(Ready(it.first, READABLE));
+		}
+	}
+	for(auto& s : writeList) {
+		for(auto& it : sockets) {
+			if(it.second == s) ready.push_back(Ready(it.first, WRITABLE));
+		}
+	}
+#endif
+}
+
+void IoReactor::dispatch(const HandlerRef& h, const int events) {
+	if(events & READABLE) call_safely(h->mCallback);
+	if(events & WRITABLE) {
+		// The read might have closed it, or sent everything that was waiting
+		bool						writable = false;
+		{
+			std::lock_guard<std::mutex>	lock(mMutex);
+			auto					found = mHandlers.find(h->mId);
+			writable = found != mHandlers.end() && found->second == h && h->mWantsWritable;
+		}
+		if(writable) call_safely(h->mOnWritable);
+	}
+
+	{
+		std::lock_guard<std::mutex>	lock(mMutex);
+		mDispatching = WAKE_ID;
+	}
+	mDispatchDone.notify_all();
+}
+
+void IoReactor::runTimers() {
+	const double					t = now();
+	std::vector<HandlerId>			due;
+	{
+		std::lock_guard<std::mutex>	lock(mMutex);
+		for(auto& it : mHandlers) {
+			if(!it.second->mIsSocket && it.second->mDue <= t) due.push_back(it.first);
+		}
+	}
+
+	for(auto id : due) {
+		HandlerRef					h;
+		{
+			std::lock_guard<std::mutex>	lock(mMutex);
+			if(mStopping) return;
+			auto					found = mHandlers.find(id);
+			if(found == mHandlers.end()) continue;
+			h = found->second;
+			// Skip whatever was missed rather than calling it in a burst
+			h->mDue = h->mRepeat ? std::max(h->mDue + h->mInterval, t) : std::numeric_limits<double>::max();
+			mDispatching = id;
+		}
+		dispatch(h);
+
+		if(!h->mRepeat) {
+			std::lock_guard<std::mutex>	lock(mMutex);
+			auto					found = mHandlers.find(id);
+			if(found != mHandlers.end() && found->second == h) mHandlers.erase(found);
+		}
+	}
+}
+
+int IoReactor::getTimeout() {
+	const double					t = now();
+	double							wait = MAX_WAIT_MS / 1000.0;
+
+	std::lock_guard<std::mutex>		lock(mMutex);
+	if(!mPosted.empty()) return 0;
+	for(auto& it : mHandlers) {
+		if(!it.second->mIsSocket) wait = std::min(wait, it.second->mDue - t);
+	}
+	if(wait <= 0.0) return 0;
+	// Round up, so a timer isn't woken for a hair early and then waited on again with 0
+	return std::min(MAX_WAIT_MS, static_cast<int>(wait * 1000.0) + 1);
+}
+
+double IoReactor::now() const {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - mStart).count();
+}
+
+/**
+ * \class ds::net::IoReactor::Handler
+ */
+IoReactor::Handler::Handler()
+		: mId(0)
+		, mIsSocket(false)
+		, mWantsWritable(false)
+		, mDue(0.0)
+		, mInterval(0.0)
+		, mRepeat(false) {
+}
+
+} // namespace net
+} // namespace ds
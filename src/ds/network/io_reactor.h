@@ -0,0 +1,126 @@
+#pragma once
+#ifndef DS_NETWORK_IOREACTOR_H_
+#define DS_NETWORK_IOREACTOR_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <Poco/Net/DatagramSocket.h>
+#include <Poco/Net/Socket.h>
+
+namespace ds {
+namespace net {
+
+/**
+ * \class ds::net::IoReactor
+ * \brief One thread that waits on any number of sockets and timers, and calls a handler
+ *		  when a socket has something to read or a timer is due. Uses epoll on Linux, and
+ *		  select everywhere else.
+ *
+ * Handlers run on the reactor thread, so they should read what's there, hand it off to a
+ * queue for whoever wants it, and return. They must never sleep or block on a socket.
+ * Sockets are level triggered: a handler that leaves data unread is called again straight
+ * away, and a socket watched for writing is called for as long as it has room.
+ *
+ * The engine has one of these, see SpriteEngine::getIoReactor(). The thread is started the
+ * first time anything is added. UdpConnection and UdpReceiver aren't on it: they have no
+ * thread of their own, and are read where their data is used, on the main thread.
+ */
+class IoReactor {
+public:
+	typedef int							HandlerId;
+	typedef std::function<void()>		Callback;
+
+	IoReactor();
+	~IoReactor();
+
+	/// Call onReadable whenever the socket can be read without blocking, or has closed or
+	/// failed. While setWritable() is on, call onWritable whenever it can be written without
+	/// blocking. The socket is kept open until it's removed. Answers 0 if it couldn't be added.
+	HandlerId							addSocket(	const Poco::Net::Socket&, const Callback& onReadable,
+													const Callback& onWritable = Callback());
+	/// Start or stop calling a socket's onWritable, for when it has something waiting to send
+	void								setWritable(const HandlerId, const bool);
+	/// Call the callback after seconds, and every seconds after that if it repeats
+	HandlerId							addTimer(const double seconds, const Callback&, const bool repeat = true);
+	/// Stop calling a socket or timer handler. Once this returns the handler isn't running,
+	/// unless this is called from the handler itself, and won't be called again.
+	void								remove(const HandlerId);
+
+	/// Run something on the reactor thread
+	void								post(const Callback&);
+
+	/// Stops the thread, not from inside a handler. Handlers that are still added stay
+	/// that way, and are waited on again if anything new is added.
+	void								stop();
+	bool								isRunning() const;
+	/// True from inside a handler
+	bool								isReactorThread() const;
+
+private:
+	IoReactor(const IoReactor&);
+	IoReactor&							operator=(const IoReactor&);
+
+	struct Handler {
+		Handler();
+
+		HandlerId						mId;
+		Poco::Net::Socket				mSocket;
+		bool							mIsSocket;
+		Callback						mCallback;
+		Callback						mOnWritable;
+		bool							mWantsWritable;
+		// Timers, in seconds since the reactor was made
+		double							mDue;
+		double							mInterval;
+		bool							mRepeat;
+	};
+	typedef std::shared_ptr<Handler>	HandlerRef;
+
+	void								start();
+	void								run();
+	void								wake();
+	// What a socket is ready for
+	enum								{ READABLE = 1, WRITABLE = 2 };
+	typedef std::pair<HandlerId, int>	Ready;
+	// Wait until a socket is ready or it's time for the next timer
+	void								waitForEvents(const int timeoutMs, std::vector<Ready>& ready);
+	void								dispatch(const HandlerRef&, const int events = READABLE);
+	void								runTimers();
+	int									getTimeout();
+	double								now() const;
+
+	mutable std::mutex					mMutex;
+	std::condition_variable				mDispatchDone;
+	std::thread							mThread;
+	std::atomic<std::thread::id>		mThreadId;
+	bool								mRunning;
+	bool								mStopping;
+	HandlerId							mNextId;
+	std::unordered_map<HandlerId, HandlerRef>
+										mHandlers;
+	std::vector<Callback>				mPosted;
+	// The handler being called right now, so remove() can wait for it
+	HandlerId							mDispatching;
+	const std::chrono::steady_clock::time_point
+										mStart;
+
+	// Something to wait on that other threads can poke
+#if defined(__linux__)
+	int									mEpoll;
+	int									mWakeFd;
+#else
+	Poco::Net::DatagramSocket			mWakeSocket;
+#endif
+};
+
+} // namespace net
+} // namespace ds
+
+#endif // DS_NETWORK_IOREACTOR_H_
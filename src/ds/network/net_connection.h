@@ -20,6 +20,14 @@ public:
 
 	virtual bool	sendMessage(const std::string &data) = 0;
 	virtual bool	sendMessage(const char *data, int size) = 0;
+	/// Send count messages at once, answers how many went. Connections that can batch them override this.
+	virtual int		sendMessages(const char* const* data, const int* sizes, const int count) {
+		int sent = 0;
+		for(int i = 0; i < count; ++i){
+			if(sendMessage(data[i], sizes[i])) ++sent;
+		}
+		return sent;
+	}
 
 	virtual int		recvMessage(std::string &msg) = 0;
 
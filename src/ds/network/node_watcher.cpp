@@ -2,32 +2,42 @@
 
 #include "ds/network/node_watcher.h"
 
-#include <Poco/Net/DatagramSocket.h>
-#include <ds/cfg/settings.h>
-#include <ds/debug/debug_defines.h>
+#include <Poco/Exception.h>
+#include <ds/debug/logger.h>
 #include <ds/ui/sprite/sprite_engine.h>
 
 namespace ds {
 
+namespace {
+const int						BUF_SIZE = 512;
+// If update() stops being called, keep the newest messages and forget the rest
+const size_t					MAX_PENDING = 1000;
+}
+
 /**
  * \class ds::NodeWatcher
  */
 NodeWatcher::NodeWatcher(ds::ui::SpriteEngine& se, const std::string& host, const int port)
 		: ds::AutoUpdate(se)
-		, mLoop(se, host, port) {
-	mThread.start(mLoop);
+		, mReactor(se.getIoReactor())
+		, mHandlerId(0) {
+	try {
+		mSocket.setReuseAddress(true);
+		mSocket.setReusePort(true);
+		mSocket.bind(Poco::Net::SocketAddress(host, port));
+		mSocket.setBlocking(false);
+		mHandlerId = mReactor.addSocket(mSocket, [this]() { onReadable(); });
+	} catch (std::exception& e) {
+		DS_LOG_WARNING("Unable to construct the DatagramSocket to DS Node. " << e.what());
+	}
 }
 
 NodeWatcher::~NodeWatcher() {
-	{
-		Poco::Mutex::ScopedLock		l(mLoop.mMutex);
-		mLoop.mAbort = true;
-		// I don't know how one would "wakeup" the socket.  If I knew that,
-		// I could increase the timeout and make the whole thing more efficient.
-//		mLoop.mCondition.signal();
-	}
+	// Once this returns onReadable() won't be called again
+	if (mHandlerId) mReactor.remove(mHandlerId);
+
 	try {
-		mThread.join();
+		mSocket.close();
 	} catch (std::exception&) {
 	}
 }
@@ -44,8 +54,8 @@ void NodeWatcher::add(const std::function<void(const Message&)>& f) {
 void NodeWatcher::update(const ds::UpdateParams &) {
 	mMsg.clear();
 	{
-		Poco::Mutex::ScopedLock	l(mLoop.mMutex);
-		mMsg.swap(mLoop.mMsg);
+		Poco::Mutex::ScopedLock	l(mMutex);
+		mMsg.swap(mPending);
 	}
 	if (mMsg.empty()) return;
 
@@ -54,89 +64,28 @@ void NodeWatcher::update(const ds::UpdateParams &) {
 	}
 }
 
-/**
- * \class ds::NodeWatcher::Loop
- */
-static long get_refresh_rate(ds::ui::SpriteEngine& e) {
-	// Default to one second
-	ds::cfg::Settings&				settings = e.getSettings("engine");
-	float							rate = settings.getFloat("node:refresh_rate", 0, .1f);
-	long							ans = static_cast<long>(rate * 1000.0f);
-	if (ans < 10) return 10;
-	else if (ans > 1000 * 10) return 1000 * 10;
-	return ans;
-}
-
-NodeWatcher::Loop::Loop(ds::ui::SpriteEngine& e, const std::string& host, const int port)
-		: mAbort(false)
-		, mHost(host)
-		, mPort(port)
-		, mRefreshRateMs(get_refresh_rate(e)) {
-}
-
-// WARNING: this class can throw in constructor thanks to
-// awesome architecture of Poco. Use with try-catch.
-struct ScopedDatagramSocket
-{
-	ScopedDatagramSocket(const std::string& host, int port)
-		: mCmsReceiver(Poco::Net::SocketAddress(host, port))
-	{}
-
-	~ScopedDatagramSocket() { try { mCmsReceiver.close(); } catch (...) {} }
-
-	Poco::Net::DatagramSocket	mCmsReceiver;
-};
-
-void NodeWatcher::Loop::run() {
-	static const int			BUF_SIZE = 512;
+void NodeWatcher::onReadable() {
 	char						buf[BUF_SIZE];
 
-	Poco::Net::DatagramSocket theSocket;
-
-	try	{
-
-		theSocket.setBlocking(false);
-		theSocket.setReuseAddress(true);
-		theSocket.setReusePort(true);
-		theSocket.bind(Poco::Net::SocketAddress(mHost, mPort));
-		theSocket.setReceiveTimeout(0);
-
-		while (true)		{
-			int						length = 0;
-
-			try	{
-				length = theSocket.receiveBytes(buf, BUF_SIZE);
-			} catch (const Poco::TimeoutException&)	{
-			} catch (const std::exception&)	{
-			}
-
-			if (length > 0)	{
-				try	{
-					std::string		msg(buf, length);
-					Poco::Mutex::ScopedLock	l(mMutex);
-					mMsg.mData.push_back(msg);
-				}
-				catch (const std::exception&){
-				}
-			}
-
-			Poco::Thread::sleep(mRefreshRateMs);
+	// Read everything that's waiting, or the reactor will just call again
+	while (true) {
+		int						length = 0;
+		try {
+			length = mSocket.receiveBytes(buf, BUF_SIZE);
+		} catch (const Poco::TimeoutException&) {
+		} catch (const std::exception&) {
+		}
+		if (length <= 0) return;
 
-			{
-				Poco::Mutex::ScopedLock	l(mMutex);
-				if (mAbort) break;
+		try {
+			Poco::Mutex::ScopedLock	l(mMutex);
+			if (mPending.mData.size() >= MAX_PENDING) {
+				mPending.mData.erase(mPending.mData.begin());
 			}
+			mPending.mData.push_back(std::string(buf, length));
+		} catch (const std::exception&) {
 		}
 	}
-	catch (std::exception& e){
-		std::cout << "Unable to construct the DatagramSocket to DS Node. " <<  e.what() << std::endl;
-	}
-
-	try{
-		//theSocket.close();
-	} catch(std::exception& e){
-		std::cout << "Exception closing node watcher datagram socket: " << e.what() << std::endl;
-	}
 }
 
 /**
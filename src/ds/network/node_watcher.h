@@ -4,17 +4,18 @@
 
 #include <functional>
 #include <vector>
-#include <Poco/Condition.h>
 #include <Poco/Mutex.h>
-#include <Poco/Runnable.h>
-#include <Poco/Thread.h>
+#include <Poco/Net/DatagramSocket.h>
 #include "ds/app/auto_update.h"
+#include "ds/network/io_reactor.h"
 
 namespace ds {
 
 /**
  * \class ds::NodeWatcher
  * \brief Feed clients information about changes in the node.
+ *        The socket is read on the engine's IoReactor as soon as anything arrives,
+ *        and listeners are called from update() on the main thread.
  */
 class NodeWatcher : public ds::AutoUpdate {
 public:
@@ -42,25 +43,15 @@ protected:
 	virtual void					update(const ds::UpdateParams &);
 
 private:
-	class Loop : public Poco::Runnable {
-	public:
-		Poco::Mutex					mMutex;
-		bool						mAbort;
-		Message						mMsg;
-
-	public:
-		Loop(ds::ui::SpriteEngine&, const std::string& host, const int port);
-
-		virtual void				run();
-
-	private:
-		const std::string			mHost;
-		const int					mPort;
-		const long					mRefreshRateMs;	// in milliseconds
-	};
-
-	Poco::Thread					mThread;
-	Loop							mLoop;
+	// Called on the reactor thread
+	void							onReadable();
+
+	ds::net::IoReactor&				mReactor;
+	Poco::Net::DatagramSocket		mSocket;
+	ds::net::IoReactor::HandlerId	mHandlerId;
+	Poco::Mutex						mMutex;
+	// Received and not yet handed to the listeners, guarded by mMutex
+	Message							mPending;
 	std::vector<std::function<void(const Message&)>>
 									mListener;
 	Message							mMsg;
@@ -2,64 +2,245 @@
 
 #include "packet_chunker.h"
 #include "snappy.h"
-#include <iostream>
 #include <algorithm>
+#include <cstring>
 
 namespace ds {
 namespace net {
 
-Chunker::Chunker()
-	: mChunkSize(1400)
-{
+namespace {
+// A group this far behind the newest one means the sender started numbering over, not a late packet
+const unsigned			RESTART_DISTANCE = 1000;
+// How many recent groups the chunker can find in its ring
+const unsigned			SENT_HISTORY = 256;
+// Groups to wait for a resend before asking again
+const unsigned			NACK_INTERVAL = 2;
+// More runs than this missing from one group and the whole group is asked for
+const size_t			MAX_NACK_RANGES = 16;
+
+bool valid_header(const ChunkHeader& header, const unsigned payloadSize){
+	if(header.mChunkSize == 0 || header.mTotal == 0 || header.mTotal > DeChunker::MAX_CHUNKS_PER_GROUP) return false;
+
+	// Every chunk but the last is full
+	const unsigned long long	full = static_cast<unsigned long long>(header.mTotal - 1) * header.mChunkSize;
+	if(header.mSize <= full || header.mSize > full + header.mChunkSize) return false;
+
+	if(header.mId >= header.mTotal){
+		// Parity, always full size
+		if(header.mParitySpan == 0) return false;
+		const unsigned			blocks = (header.mTotal + header.mParitySpan - 1) / header.mParitySpan;
+		return header.mId - header.mTotal < blocks && payloadSize == header.mChunkSize;
+	}
+
+	const unsigned long long	expected = (header.mId + 1 == header.mTotal) ? header.mSize - full : header.mChunkSize;
+	return payloadSize == expected;
 }
 
-void Chunker::Chunkify(const char *src, unsigned size, unsigned groupId, std::vector<std::string> &dst){
+void xor_into(char* dst, const char* src, const unsigned size){
+	for(unsigned i = 0; i < size; ++i){
+		dst[i] ^= src[i];
+	}
+}
 
-	unsigned chunkSize = mChunkSize - sizeof(ChunkHeader);
-	unsigned pos = 0;
+}
+
+Chunker::Chunker(const unsigned datagramSize, const unsigned slotCount)
+	: mDatagramSize(std::max<unsigned>(datagramSize, sizeof(ChunkHeader) + 1))
+	, mSlotCount(std::max<unsigned>(slotCount, 1))
+	, mHead(0)
+	, mParitySpan(0)
+	, mDataBytes(0)
+	, mParityBytes(0)
+{
+	mRing.resize(static_cast<size_t>(mSlotCount) * mDatagramSize);
+	mSlotSizes.resize(mSlotCount, 0);
+	mSent.resize(SENT_HISTORY);
+}
+
+unsigned Chunker::chunkify(const char *src, unsigned size, unsigned groupId){
+	const unsigned chunkSize = mDatagramSize - sizeof(ChunkHeader);
 
 	snappy::Compress(src, size, &mCompressedBuffer);
 
-	unsigned nSize = mCompressedBuffer.size();
-	unsigned numIterations = nSize / chunkSize;
+	const unsigned nSize = static_cast<unsigned>(mCompressedBuffer.size());
+	const unsigned total = nSize / chunkSize + (nSize % chunkSize ? 1 : 0);
 
-	unsigned excess = nSize % chunkSize;
+	mDatagrams.clear();
+	mDatagramSizes.clear();
+	if(total < 1) return 0;
 
-	unsigned total = numIterations + (excess ? 1 : 0);
+	const unsigned parityCount = mParitySpan > 0 ? (total + mParitySpan - 1) / mParitySpan : 0;
+	const unsigned count = total + parityCount;
 
-	dst.resize(total);
+	// Only happens for a group bigger than anything before it, which throws away the history
+	if(count > mSlotCount){
+		mSlotCount = count;
+		mRing.resize(static_cast<size_t>(mSlotCount) * mDatagramSize);
+		mSlotSizes.resize(mSlotCount, 0);
+		mHead = 0;
+	}
+
+	// Keep the group in consecutive slots
+	if(mHead + count > mSlotCount){
+		mHead = 0;
+	}
 
-	ChunkHeader header = { groupId, nSize, 0, total, chunkSize };
+	ChunkHeader header = { groupId, nSize, 0, total, chunkSize, mParitySpan };
+	unsigned pos = 0;
+	for(unsigned i = 0; i < total; ++i){
+		const unsigned payload = std::min(chunkSize, nSize - pos);
+		char* slot = mRing.data() + static_cast<size_t>(mHead + i) * mDatagramSize;
 
-	int i;
-	for(i = 0; i < numIterations; ++i){
 		header.mId = i;
-		dst[i].resize(sizeof(ChunkHeader) + chunkSize);
-		std::copy(reinterpret_cast<char *>(&header), reinterpret_cast<char *>(&header) + sizeof(ChunkHeader), dst[i].begin());
-		std::copy(mCompressedBuffer.begin() + pos, mCompressedBuffer.begin() + pos + chunkSize, dst[i].begin() + sizeof(ChunkHeader));
-		pos += chunkSize;
+		memcpy(slot, &header, sizeof(ChunkHeader));
+		memcpy(slot + sizeof(ChunkHeader), mCompressedBuffer.data() + pos, payload);
+		pos += payload;
+
+		mSlotSizes[mHead + i] = static_cast<int>(sizeof(ChunkHeader) + payload);
+		mDataBytes += mSlotSizes[mHead + i];
 	}
 
-	if(excess){
-		header.mId = i;
-		dst[i].resize(sizeof(ChunkHeader) + excess);
-		std::copy(reinterpret_cast<char *>(&header), reinterpret_cast<char *>(&header) + sizeof(ChunkHeader), dst[i].begin());
-		std::copy(mCompressedBuffer.begin() + pos, mCompressedBuffer.begin() + pos + excess, dst[i].begin() + sizeof(ChunkHeader));
-		pos += chunkSize;
+	// Each parity chunk is the xor of the data chunks in its block, short ones padded with zeros
+	for(unsigned b = 0; b < parityCount; ++b){
+		char* slot = mRing.data() + static_cast<size_t>(mHead + total + b) * mDatagramSize;
+		char* parity = slot + sizeof(ChunkHeader);
+
+		header.mId = total + b;
+		memcpy(slot, &header, sizeof(ChunkHeader));
+		memset(parity, 0, chunkSize);
+
+		const unsigned last = std::min(total, (b + 1) * mParitySpan);
+		for(unsigned i = b * mParitySpan; i < last; ++i){
+			const char* data = mRing.data() + static_cast<size_t>(mHead + i) * mDatagramSize;
+			xor_into(parity, data + sizeof(ChunkHeader), mSlotSizes[mHead + i] - sizeof(ChunkHeader));
+		}
+
+		mSlotSizes[mHead + total + b] = static_cast<int>(mDatagramSize);
+		mParityBytes += mDatagramSize;
+	}
+
+	for(unsigned i = 0; i < count; ++i){
+		mDatagrams.push_back(mRing.data() + static_cast<size_t>(mHead + i) * mDatagramSize);
+		mDatagramSizes.push_back(mSlotSizes[mHead + i]);
 	}
+
+	Sent& sent = mSent[groupId % mSent.size()];
+	sent.mGroupId = groupId;
+	sent.mFirstSlot = mHead;
+	sent.mDataCount = total;
+	sent.mCount = count;
+
+	mHead = (mHead + count) % mSlotCount;
+	return count;
 }
 
-void Chunker::Chunkify(std::string src, unsigned groupId, std::vector<std::string> &dst){
-	Chunkify(src.c_str(), src.size(), groupId, dst);
+bool Chunker::getDatagram(const unsigned groupId, const unsigned chunkId, const char*& outData, int& outSize) const {
+	const Sent& sent = mSent[groupId % mSent.size()];
+	if(sent.mCount < 1 || sent.mGroupId != groupId || chunkId >= sent.mCount) return false;
+
+	const unsigned slot = sent.mFirstSlot + chunkId;
+	if(slot >= mSlotCount) return false;
+
+	// Later groups may have been written over it since
+	const char* data = mRing.data() + static_cast<size_t>(slot) * mDatagramSize;
+	ChunkHeader header;
+	memcpy(&header, data, sizeof(ChunkHeader));
+	if(header.mGroupId != groupId || header.mId != chunkId) return false;
+
+	outData = data;
+	outSize = mSlotSizes[slot];
+	return true;
 }
 
+unsigned Chunker::getDataChunkCount(const unsigned groupId) const {
+	const char* data = nullptr;
+	int size = 0;
+	if(!getDatagram(groupId, 0, data, size)) return 0;
+	return mSent[groupId % mSent.size()].mDataCount;
+}
 
-DeChunker::DeChunker(){
-	mMaxReceivedSize = 1000;
+void Chunker::Chunkify(const char *src, unsigned size, unsigned groupId, std::vector<std::string> &dst){
+	const unsigned total = chunkify(src, size, groupId);
+	dst.resize(total);
+	for(unsigned i = 0; i < total; ++i){
+		dst[i].assign(mDatagrams[i], mDatagramSizes[i]);
+	}
 }
 
-bool DeChunker::addChunk(std::string &chunk){
-	return addChunk(chunk.c_str(), chunk.size());
+void Chunker::Chunkify(const std::string& src, unsigned groupId, std::vector<std::string> &dst){
+	Chunkify(src.c_str(), static_cast<unsigned>(src.size()), groupId, dst);
+}
+
+
+DeChunker::Stats::Stats()
+	: mCompleted(0)
+	, mRepaired(0)
+	, mParityChunks(0)
+	, mDropped(0)
+{
+}
+
+DeChunker::Group::Group()
+	: mState(EMPTY)
+	, mGroupId(0)
+	, mSize(0)
+	, mTotal(0)
+	, mChunkSize(0)
+	, mParitySpan(0)
+	, mReceived(0)
+	, mRepaired(false)
+	, mNackCount(0)
+	, mNackedAt(0)
+{
+}
+
+void DeChunker::Group::expect(const unsigned groupId){
+	mState = FILLING;
+	mGroupId = groupId;
+	mSize = 0;
+	mTotal = 0;
+	mChunkSize = 0;
+	mParitySpan = 0;
+	mReceived = 0;
+	mRepaired = false;
+	mNackCount = 0;
+	mNackedAt = groupId;
+}
+
+void DeChunker::Group::start(const ChunkHeader& header){
+	mSize = header.mSize;
+	mTotal = header.mTotal;
+	mChunkSize = header.mChunkSize;
+	mParitySpan = header.mParitySpan;
+	mReceived = 0;
+	mHave.reset();
+	mHaveParity.reset();
+	mData.resize(mSize);
+	if(mParitySpan > 0){
+		mParity.resize(static_cast<size_t>((mTotal + mParitySpan - 1) / mParitySpan) * mChunkSize);
+	}
+}
+
+bool DeChunker::Group::matches(const ChunkHeader& header) const {
+	return mSize == header.mSize && mTotal == header.mTotal && mChunkSize == header.mChunkSize && mParitySpan == header.mParitySpan;
+}
+
+unsigned DeChunker::Group::getChunkLength(const unsigned id) const {
+	return (id + 1 == mTotal) ? mSize - id * mChunkSize : mChunkSize;
+}
+
+DeChunker::DeChunker(const unsigned window)
+	: mWindow(std::max<unsigned>(window, 1))
+	, mHasNewest(false)
+	, mNewest(0)
+	, mAvailable(0)
+	, mReorderDelay(0)
+{
+	mGroups.resize(mWindow);
+}
+
+bool DeChunker::addChunk(const std::string &chunk){
+	return addChunk(chunk.c_str(), static_cast<unsigned>(chunk.size()));
 }
 
 bool DeChunker::addChunk(const char *chunk, unsigned size){
@@ -74,112 +255,269 @@ bool DeChunker::addChunk(const char *chunk, unsigned size){
 		clearReceived();
 	}
 
-	if(std::find(mReceived.begin(), mReceived.end(), chunkHeader.mGroupId) != mReceived.end()
-	   && std::find(mGroupsReceived.begin(), mGroupsReceived.end(), chunkHeader.mGroupId) == mGroupsReceived.end()){
+	const unsigned payloadSize = size - sizeof(ChunkHeader);
+	if(!valid_header(chunkHeader, payloadSize)){
 		return false;
 	}
 
-	auto found = mDataChunks.find(chunkHeader.mGroupId);
-
-	auto &stats = mDataChunks[chunkHeader.mGroupId];
-	if(found == mDataChunks.end()){
-
-		for(unsigned i = 0; i < chunkHeader.mTotal; ++i){
-			stats.mIdsMissing.push_back(i);
+	// Group ids wrap, so compare them by distance
+	if(!mHasNewest){
+		mHasNewest = true;
+		mNewest = chunkHeader.mGroupId;
+	} else {
+		const int ahead = static_cast<int>(chunkHeader.mGroupId - mNewest);
+		if(ahead > 0){
+			// The sender numbers every group, so anything skipped was lost entirely
+			expectGroups(mNewest + 1, chunkHeader.mGroupId);
+			mNewest = chunkHeader.mGroupId;
+			dropStale();
+		} else if(static_cast<unsigned>(-ahead) > RESTART_DISTANCE){
+			clearReceived();
+			mHasNewest = true;
+			mNewest = chunkHeader.mGroupId;
+		} else if(static_cast<unsigned>(-ahead) >= mWindow){
+			return false;
 		}
+	}
 
-		if(!mReserveStrings.empty()) {
-			stats.mData = std::move(mReserveStrings.back());
-			mReserveStrings.pop_back();
-		} else {
-			stats.mData = std::unique_ptr<std::string>(new std::string);
-		}
+	Group& group = mGroups[chunkHeader.mGroupId % mWindow];
+	if(group.mState == Group::EMPTY || group.mGroupId != chunkHeader.mGroupId){
+		dropGroup(group);
+		group.expect(chunkHeader.mGroupId);
+	}
 
-		if(stats.mData.get()){
-			stats.mData.get()->resize(chunkHeader.mSize);
-		}
+	// A chunk of a group that's already done
+	if(group.mState != Group::FILLING){
+		return false;
+	}
+	if(group.isUnknown()){
+		group.start(chunkHeader);
+	} else if(!group.matches(chunkHeader)){
+		return false;
+	}
 
-		mGroupsReceived.push_back(chunkHeader.mGroupId);
-		mReceived.push_back(chunkHeader.mGroupId);
+	if(chunkHeader.mId < chunkHeader.mTotal){
+		addData(group, chunkHeader, chunk + sizeof(ChunkHeader), payloadSize);
+	} else {
+		addParity(group, chunkHeader, chunk + sizeof(ChunkHeader));
+	}
 
-		while(mReceived.size() > mMaxReceivedSize){
-			mReceived.pop_front();
-		}
+	if(group.mReceived < group.mTotal){
+		return false;
+	}
 
-		std::sort(mGroupsReceived.begin(), mGroupsReceived.end(), [](unsigned a, unsigned b) -> bool {
-			if(a > b)
-				return true;
-			return false;
-		});
+	group.mState = Group::COMPLETE;
+	++mAvailable;
+	return true;
+}
+
+void DeChunker::addData(Group& group, const ChunkHeader& header, const char* payload, const unsigned payloadSize){
+	if(group.mHave.test(header.mId)){
+		return;
 	}
 
-	addChunkToGroup(stats, chunk, size);
+	memcpy(&group.mData[static_cast<size_t>(header.mId) * group.mChunkSize], payload, payloadSize);
+	group.mHave.set(header.mId);
+	++group.mReceived;
 
-	if(stats.mIdsMissing.empty()){
-		mGroupsAvailable.push_back(chunkHeader.mGroupId);
-		std::sort(mGroupsAvailable.begin(), mGroupsAvailable.end(), [](unsigned a, unsigned b) -> bool {
-			if(a > b){
-				return true;
-			}
-			return false;
-		});
-		return true;
+	if(group.mParitySpan > 0){
+		repairBlock(group, header.mId / group.mParitySpan);
 	}
-	return false;
 }
 
-void DeChunker::addChunkToGroup(DeChunkStats &stats, const char *chunk, unsigned size){
-	ChunkHeader chunkHeader;
-	memcpy(reinterpret_cast<char *>(&chunkHeader), chunk, sizeof(ChunkHeader));
+void DeChunker::addParity(Group& group, const ChunkHeader& header, const char* payload){
+	const unsigned block = header.mId - group.mTotal;
+	if(group.mHaveParity.test(block)){
+		return;
+	}
 
-	auto found = std::find(stats.mIdsMissing.begin(), stats.mIdsMissing.end(), chunkHeader.mId);
-	if(found == stats.mIdsMissing.end())
+	memcpy(&group.mParity[static_cast<size_t>(block) * group.mChunkSize], payload, group.mChunkSize);
+	group.mHaveParity.set(block);
+	repairBlock(group, block);
+}
+
+void DeChunker::repairBlock(Group& group, const unsigned block){
+	if(!group.mHaveParity.test(block)){
 		return;
+	}
 
-	unsigned nSize = chunkHeader.mSize / chunkHeader.mChunkSize;
-	unsigned pos = chunkHeader.mId * chunkHeader.mChunkSize;
+	// Only one missing chunk can be rebuilt
+	const unsigned first = block * group.mParitySpan;
+	const unsigned last = std::min(group.mTotal, first + group.mParitySpan);
+	unsigned missing = group.mTotal;
+	for(unsigned i = first; i < last; ++i){
+		if(group.mHave.test(i)) continue;
+		if(missing != group.mTotal) return;
+		missing = i;
+	}
+	if(missing == group.mTotal){
+		return;
+	}
+
+	// The parity xor every other chunk in the block leaves the missing one
+	const unsigned length = group.getChunkLength(missing);
+	char* dst = &group.mData[static_cast<size_t>(missing) * group.mChunkSize];
+	memcpy(dst, &group.mParity[static_cast<size_t>(block) * group.mChunkSize], length);
+	for(unsigned i = first; i < last; ++i){
+		if(i == missing) continue;
+		xor_into(dst, &group.mData[static_cast<size_t>(i) * group.mChunkSize], std::min(length, group.getChunkLength(i)));
+	}
+
+	group.mHave.set(missing);
+	++group.mReceived;
+	group.mRepaired = true;
+	++mStats.mParityChunks;
+}
+
+void DeChunker::expectGroups(const unsigned first, const unsigned last){
+	// Only the ones that fit in the window
+	unsigned id = first;
+	if(last - first >= mWindow){
+		id = last - (mWindow - 1);
+	}
 
-	if(stats.mData.get()){
-		std::copy(chunk + sizeof(ChunkHeader), chunk + size, stats.mData.get()->begin() + pos);
+	for(; id != last; ++id){
+		Group& group = mGroups[id % mWindow];
+		dropGroup(group);
+		group.expect(id);
+	}
+}
+
+DeChunker::Group* DeChunker::findNext(){
+	// Oldest first
+	Group* next = nullptr;
+	for(auto& it : mGroups){
+		if(it.mState != Group::COMPLETE) continue;
+		if(!next || static_cast<int>(it.mGroupId - next->mGroupId) < 0){
+			next = &it;
+		}
+	}
+	if(!next || mReorderDelay == 0){
+		return next;
+	}
+
+	// Held up by anything older that might still arrive
+	for(auto& it : mGroups){
+		if(it.mState == Group::FILLING && static_cast<int>(it.mGroupId - next->mGroupId) < 0){
+			return nullptr;
+		}
 	}
-	stats.mIdsMissing.remove(chunkHeader.mId);
+	return next;
 }
 
 bool DeChunker::getNextGroup(std::string &dst){
-	if(!mGroupsAvailable.empty() && !mGroupsReceived.empty())	{
+	Group* next = findNext();
+	if(!next){
+		return false;
+	}
 
-		unsigned groupId = mGroupsAvailable.back();
-		
-		auto gr = std::find(mGroupsReceived.begin(), mGroupsReceived.end(), groupId);
-		if(gr != mGroupsReceived.end()){
-			mGroupsAvailable.pop_back();
-			mGroupsReceived.erase(gr);
+	next->mState = Group::DELIVERED;
+	--mAvailable;
+	++mStats.mCompleted;
+	if(next->mRepaired || next->mNackCount > 0){
+		++mStats.mRepaired;
+	}
+	return snappy::Uncompress(next->mData.c_str(), next->mData.size(), &dst);
+}
 
-			if(mDataChunks[groupId].mData.get()){
-				snappy::Uncompress(mDataChunks[groupId].mData.get()->c_str(), mDataChunks[groupId].mData.get()->size(), &dst);
-			}
+unsigned DeChunker::getAvailable() const {
+	if(mAvailable == 0 || mReorderDelay == 0){
+		return mAvailable;
+	}
 
-			mReserveStrings.push_back(std::move(mDataChunks[groupId].mData));
-			mDataChunks.erase(groupId);
+	// Only the ones older than the oldest incomplete group
+	const Group* oldest = nullptr;
+	for(auto& it : mGroups){
+		if(it.mState != Group::FILLING) continue;
+		if(!oldest || static_cast<int>(it.mGroupId - oldest->mGroupId) < 0){
+			oldest = &it;
+		}
+	}
+	if(!oldest){
+		return mAvailable;
+	}
 
-			return true;
-		} else {
-			std::cout << "Big trubs with mismatched lists!" << std::endl;
+	unsigned available = 0;
+	for(auto& it : mGroups){
+		if(it.mState == Group::COMPLETE && static_cast<int>(it.mGroupId - oldest->mGroupId) < 0){
+			++available;
 		}
+	}
+	return available;
+}
+
+void DeChunker::setReorderDelay(const unsigned groups){
+	mReorderDelay = groups;
+}
 
+void DeChunker::getMissing(std::vector<ChunkRange>& out, const unsigned maxAttempts){
+	if(!mHasNewest){
+		return;
 	}
 
-	std::cout << "get next group is borking: " << mGroupsAvailable.empty() << " " << mGroupsReceived.empty() << std::endl;
+	for(auto& group : mGroups){
+		// The newest group could still be arriving
+		if(group.mState != Group::FILLING || group.mGroupId == mNewest) continue;
+		if(group.mNackCount >= maxAttempts) continue;
+		if(group.mNackCount > 0 && mNewest - group.mNackedAt < NACK_INTERVAL) continue;
+
+		++group.mNackCount;
+		group.mNackedAt = mNewest;
+
+		const ChunkRange whole = { group.mGroupId, 0, 0 };
+		if(group.isUnknown()){
+			out.push_back(whole);
+			continue;
+		}
 
-	return false;
+		const size_t before = out.size();
+		for(unsigned i = 0; i < group.mTotal; ){
+			if(group.mHave.test(i)){
+				++i;
+				continue;
+			}
+
+			const unsigned first = i;
+			while(i < group.mTotal && !group.mHave.test(i)) ++i;
+			const ChunkRange range = { group.mGroupId, first, i - first };
+			out.push_back(range);
+
+			if(out.size() - before > MAX_NACK_RANGES){
+				out.resize(before);
+				out.push_back(whole);
+				break;
+			}
+		}
+	}
 }
 
 void DeChunker::clearReceived(){
-	mReceived.clear();
-	mDataChunks.clear();
-	mGroupsAvailable.clear();
-	mGroupsReceived.clear();
+	for(auto& it : mGroups){
+		it.mState = Group::EMPTY;
+	}
+	mHasNewest = false;
+	mAvailable = 0;
+}
+
+void DeChunker::dropStale(){
+	// Complete groups wait to be read, they only go when their slot is needed
+	const unsigned limit = mReorderDelay > 0 ? std::min(mReorderDelay, mWindow) : mWindow;
+	for(auto& it : mGroups){
+		if(it.mState == Group::FILLING && mNewest - it.mGroupId >= limit){
+			dropGroup(it);
+		}
+	}
+}
+
+void DeChunker::dropGroup(Group& group){
+	if(group.mState == Group::FILLING || group.mState == Group::COMPLETE){
+		++mStats.mDropped;
+	}
+	if(group.mState == Group::COMPLETE){
+		--mAvailable;
+	}
+	group.mState = Group::EMPTY;
 }
 
 }
-}
\ No newline at end of file
+}
@@ -1,12 +1,9 @@
 #pragma once
 #ifndef CHUNKER_DS_H
 #define CHUNKER_DS_H
+#include <bitset>
 #include <string>
 #include <vector>
-#include <map>
-#include <set>
-#include <memory>
-#include <list>
 
 namespace ds {
 namespace net {
@@ -17,51 +14,176 @@ struct ChunkHeader {
 	unsigned mId;
 	unsigned mTotal;
 	unsigned mChunkSize;
+	// Data chunks covered by each parity chunk, 0 if the group has none.
+	// Parity chunks come after the data, with ids from mTotal up.
+	unsigned mParitySpan;
+};
+
+/// A run of chunks a receiver is missing. An mCount of 0 is the whole group.
+struct ChunkRange {
+	unsigned mGroupId;
+	unsigned mFirst;
+	unsigned mCount;
 };
 
 /// Chunker splits packets up into byte-sized pieces. HA! Wordplay!
+/// Each piece is a whole datagram, header and all, written into a ring of fixed size slots
+/// that's allocated once, so sending doesn't allocate anything. A group's datagrams are
+/// always in consecutive slots, and stay valid until the ring comes back around to them,
+/// so recent groups can be sent again from the ring when a receiver asks for them.
+/// Optionally each run of setParitySpan() data chunks is followed by one parity chunk, the
+/// xor of them all, which lets the receiver rebuild any one of them that's lost.
 class Chunker {
 
 public:
-	Chunker();
+	static const unsigned DEFAULT_DATAGRAM_SIZE = 1400;
+	static const unsigned DEFAULT_SLOT_COUNT = 512;
+
+	Chunker(const unsigned datagramSize = DEFAULT_DATAGRAM_SIZE, const unsigned slotCount = DEFAULT_SLOT_COUNT);
+
+	/// Compress src and split it into datagrams. Answers how many, they're in getDatagrams()
+	/// and getDatagramSizes() until the next call. The ring grows if one group needs more slots than it has.
+	unsigned chunkify(const char *src, unsigned size, unsigned groupId);
+	/// A datagram of a recent group. False if the ring has been reused since.
+	bool getDatagram(const unsigned groupId, const unsigned chunkId, const char*& outData, int& outSize) const;
+	/// The number of data chunks in a recent group, 0 if the ring has been reused since
+	unsigned getDataChunkCount(const unsigned groupId) const;
+
+	/// 0 for no parity chunks
+	void setParitySpan(const unsigned span) { mParitySpan = span; }
+	unsigned getParitySpan() const { return mParitySpan; }
+	/// Bytes chunkified so far, headers included
+	unsigned long long getDataBytes() const { return mDataBytes; }
+	unsigned long long getParityBytes() const { return mParityBytes; }
+	const std::vector<const char*>&	getDatagrams() const { return mDatagrams; }
+	const std::vector<int>&			getDatagramSizes() const { return mDatagramSizes; }
+
+	/// Copies the datagrams out, for anything that still wants them as strings
 	void Chunkify(const char *src, unsigned size, unsigned groupId, std::vector<std::string> &dst);
-	void Chunkify(std::string src, unsigned groupId, std::vector<std::string> &dst);
+	void Chunkify(const std::string& src, unsigned groupId, std::vector<std::string> &dst);
 
 private:
-	unsigned mChunkSize;
-	std::string mCompressedBuffer;
+	// Where each recent group is in the ring
+	struct Sent {
+		Sent() : mGroupId(0), mFirstSlot(0), mDataCount(0), mCount(0) {}
+
+		unsigned				mGroupId;
+		unsigned				mFirstSlot;
+		unsigned				mDataCount;
+		unsigned				mCount;
+	};
+
+	const unsigned				mDatagramSize;
+	unsigned					mSlotCount;
+	// mSlotCount slots of mDatagramSize bytes
+	std::vector<char>			mRing;
+	std::vector<int>			mSlotSizes;
+	unsigned					mHead;
+	std::vector<Sent>			mSent;
+	unsigned					mParitySpan;
+	unsigned long long			mDataBytes;
+	unsigned long long			mParityBytes;
+	std::string					mCompressedBuffer;
+	std::vector<const char*>	mDatagrams;
+	std::vector<int>			mDatagramSizes;
 };
 
-/// DeChunker recombines the pieces into a single unit
+/// DeChunker recombines the pieces into a single unit.
+/// Groups being put back together live in a fixed number of slots, one per group id in
+/// the window behind the newest group seen. Each has a bitmap of the chunks it has and
+/// one buffer the chunks are copied straight into, both reused from group to group.
+/// Groups that fall out of the window before they're complete are dropped, as are chunks
+/// for them and duplicates of chunks that already arrived. A data chunk that's lost can
+/// be rebuilt from its parity chunk if all the others it covers arrived.
+///
+/// By default complete groups are handed out as soon as they're done. With a reorder delay
+/// they're handed out strictly in order instead: an incomplete group holds up the ones
+/// after it until it's complete, or until it's that many groups behind the newest and is
+/// dropped. That leaves time to ask the sender for what's missing, see getMissing().
 class DeChunker {
 public:
-	DeChunker();
+	struct Stats {
+		Stats();
+
+		/// Groups handed out
+		unsigned			mCompleted;
+		/// Of those, the ones that needed parity or a resend to complete
+		unsigned			mRepaired;
+		/// Chunks rebuilt from parity
+		unsigned			mParityChunks;
+		/// Groups dropped before they were complete or read
+		unsigned			mDropped;
+	};
+
+	static const unsigned MAX_CHUNKS_PER_GROUP = 8192;
+	static const unsigned DEFAULT_WINDOW = 64;
+
+	DeChunker(const unsigned window = DEFAULT_WINDOW);
+	/// Answers true if this chunk completed its group
 	bool addChunk(const char *chunk, unsigned size);
-	bool addChunk(std::string &chunk);
+	bool addChunk(const std::string &chunk);
+	/// The oldest complete group, uncompressed. False if there isn't one or it couldn't be uncompressed.
 	bool getNextGroup(std::string &dst);
 	void clearReceived();
-	unsigned getAvailable() { return mGroupsAvailable.size(); }
+	/// Complete groups that getNextGroup() will hand out now
+	unsigned getAvailable() const;
+
+	/// In groups, 0 to hand out complete groups in any order
+	void setReorderDelay(const unsigned groups);
+	/// Add what's missing from incomplete groups that newer groups have started arriving
+	/// after, including groups that nothing arrived for. Each group is asked for at most
+	/// maxAttempts times, and not again until a couple more groups have arrived.
+	void getMissing(std::vector<ChunkRange>&, const unsigned maxAttempts);
+
+	const Stats& getStats() const { return mStats; }
 
 private:
-	struct DeChunkStats	{
-		DeChunkStats(){}
-		DeChunkStats(DeChunkStats &&rhs)		{
-			mData = std::move(rhs.mData);
-			mIdsMissing = rhs.mIdsMissing;
-		}
-
-		std::list<unsigned> mIdsMissing;
-		std::unique_ptr<std::string> mData;
+	struct Group {
+		enum State { EMPTY, FILLING, COMPLETE, DELIVERED };
+
+		Group();
+		// A group that should exist because a newer one arrived, but nothing has arrived for it
+		void expect(const unsigned groupId);
+		void start(const ChunkHeader&);
+		bool matches(const ChunkHeader&) const;
+		// Nothing of it has arrived, so it's not known how big it is
+		bool isUnknown() const { return mTotal == 0; }
+		unsigned getChunkLength(const unsigned id) const;
+
+		State								mState;
+		unsigned							mGroupId;
+		unsigned							mSize;
+		unsigned							mTotal;
+		unsigned							mChunkSize;
+		unsigned							mParitySpan;
+		unsigned							mReceived;
+		bool								mRepaired;
+		unsigned							mNackCount;
+		unsigned							mNackedAt;
+		std::bitset<MAX_CHUNKS_PER_GROUP>	mHave;
+		std::bitset<MAX_CHUNKS_PER_GROUP>	mHaveParity;
+		std::string							mData;
+		std::string							mParity;
 	};
 
-	void addChunkToGroup(DeChunkStats &stats, const char *chunk, unsigned size);
+	// Add a chunk that has been checked against its group
+	void addData(Group&, const ChunkHeader&, const char* payload, const unsigned payloadSize);
+	void addParity(Group&, const ChunkHeader&, const char* payload);
+	void repairBlock(Group&, const unsigned block);
+	void complete(Group&);
+	void expectGroups(const unsigned first, const unsigned last);
+	// The complete group getNextGroup() would hand out, if any
+	Group* findNext();
+	void dropStale();
+	void dropGroup(Group&);
 
-	std::map<unsigned, DeChunkStats>				mDataChunks;
-	std::vector<unsigned>							mGroupsAvailable;
-	std::vector<unsigned>							mGroupsReceived;
-	std::list<unsigned>							mReceived;
-	unsigned										mMaxReceivedSize;
-	std::vector<std::unique_ptr<std::string>>	mReserveStrings;
+	const unsigned				mWindow;
+	std::vector<Group>			mGroups;
+	bool						mHasNewest;
+	unsigned					mNewest;
+	unsigned					mAvailable;
+	unsigned					mReorderDelay;
+	Stats						mStats;
 };
 
 }
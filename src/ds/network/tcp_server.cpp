@@ -2,133 +2,147 @@
 
 #include "ds/network/tcp_server.h"
 
+#include <algorithm>
+#include <atomic>
+#include <climits>
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string.hpp>
+#include <Poco/Exception.h>
+#include <Poco/Net/SocketDefs.h>
 #include "ds/debug/debug_defines.h"
 #include "ds/debug/logger.h"
-#include "tcp_client.h"
+#include "ds/ui/sprite/sprite_engine.h"
 
 namespace ds {
 namespace net {
 
 namespace {
-	class EchoConnection: public Poco::Net::TCPServerConnection {
-	public:
-		EchoConnection(	const Poco::Net::StreamSocket& s,
-						std::shared_ptr<TcpServer::SendBucket>& b,
-						std::shared_ptr<ds::AsyncQueue<std::string>>& rq,
-						std::shared_ptr<bool>& st,
-						const std::string& wakeup,
-						const std::string &terminator)
-				: Poco::Net::TCPServerConnection(s)
-				, mBucket(b)
-				, mSendQueue(b->startQueue())
-				, mReceiveQueue(rq)
-				, mSt(st)
-				, mTerminator(terminator) {
-			if (mSendQueue && !wakeup.empty()) mSendQueue->push(wakeup);
-		}
+const int					BUFFER_SIZE = 4096;
+// A client that's gone shouldn't take the app down with a SIGPIPE
+#ifdef MSG_NOSIGNAL
+const int					SEND_FLAGS = MSG_NOSIGNAL;
+#else
+const int					SEND_FLAGS = 0;
+#endif
+
+bool would_block(const int code) {
+	return code == POCO_EWOULDBLOCK || code == POCO_EAGAIN;
+}
+}
+
+struct TcpServer::Connection {
+	Connection() : mHandlerId(0), mClosed(false) {}
+
+	Poco::Net::StreamSocket			mSocket;
+	ds::net::IoReactor::HandlerId	mHandlerId;
+	// A partial message still waiting on its terminator
+	std::string						mWaiting;
+	// Sent to this client, but not yet taken by its socket
+	std::string						mOutgoing;
+	bool							mClosed;
+};
+
+/**
+ * \class ds::net::TcpServer::Clients
+ * Every open connection. Changed and sent to on the reactor thread, and read by the
+ * destructor to remove the handlers.
+ */
+class TcpServer::Clients {
+public:
+	Clients(ds::net::IoReactor& r) : mReactor(r), mSendLimit(DEFAULT_SEND_LIMIT) {}
+
+	void							add(const std::shared_ptr<Connection>& c) {
+		Poco::Mutex::ScopedLock		l(mMutex);
+		mConnections.push_back(c);
+	}
 
-		~EchoConnection() {
-			mBucket->endQueue(mSendQueue);
+	void							getHandlerIds(std::vector<ds::net::IoReactor::HandlerId>& out) {
+		Poco::Mutex::ScopedLock		l(mMutex);
+		for (const auto& it : mConnections) out.push_back(it->mHandlerId);
+	}
+
+	size_t							size() {
+		Poco::Mutex::ScopedLock		l(mMutex);
+		return mConnections.size();
+	}
+
+	void							setSendLimit(const size_t bytes) {
+		mSendLimit = bytes;
+	}
+
+	// Everything from here on is on the reactor thread
+
+	void							send(const std::string& data) {
+		std::vector<std::shared_ptr<Connection>>	connections;
+		{
+			Poco::Mutex::ScopedLock	l(mMutex);
+			connections = mConnections;
 		}
-		
-		void run() {
-			Poco::Net::StreamSocket&		ss = socket();
-			ss.setNoDelay(true);
-			ss.setBlocking(false);
-			// Keep running until the connection is closed externally
-			bool							keepRunning = true;
-			while (keepRunning) {
-				try {
-					sendTo(ss);
-					receiveFrom(ss);
-				} catch (Poco::TimeoutException const&) {
-					const bool				stopped = *mSt;
-					if (stopped) keepRunning = false;
-				} catch (std::exception const&) {
-					keepRunning = false;
-				}
-				if (keepRunning) {
-					Poco::Thread::sleep(100);
-				}
-			}
+		for (const auto& it : connections) {
+			send(*it, data);
 		}
+	}
 
-	private:
-		void		sendTo(Poco::Net::StreamSocket& socket) {
-			if (!mSendQueue) return;
-			const std::vector<std::string>*	send = mSendQueue->update();
-			if (!send) return;
-
-			// Compile into a single chunk of data. Note that I've seen
-			// messages not go through when we try to make a series
-			// of sendBytes() calls, so this prevents that.
-			std::stringstream				buf;
-			for (const auto& d : *send) {
-				if (!d.empty()) buf << d << mTerminator;
-			}
-
-			TcpClient::sendBytes(socket, buf.str());
+	void							send(Connection& c, const std::string& data) {
+		if (c.mClosed) return;
+		if (c.mOutgoing.size() + data.size() > mSendLimit) {
+			DS_LOG_WARNING("TcpServer closing a client that's " << c.mOutgoing.size() << " bytes behind");
+			close(c);
+			return;
 		}
+		// Anything already waiting goes first, and will be flushed when the socket has room
+		const bool					waiting = !c.mOutgoing.empty();
+		c.mOutgoing += data;
+		if (!waiting) flush(c);
+	}
 
-		void		receiveFrom(Poco::Net::StreamSocket& socket) {
-			int					n = 0;
-			while ((n = socket.receiveBytes(mBuffer, sizeof(mBuffer))) > 0) {
-				const std::string	incoming(mBuffer, n);
-				if (mTerminator.empty()) {
-					mReceiveQueue->push(incoming);
-				} else {
-					mWaiting += incoming;
-					std::vector<std::string> all;
-					boost::split(all, mWaiting, boost::is_any_of(mTerminator));
-					mWaiting.clear();
-					// The last element will be an empty string if this update() str ended
-					// with the terminator; if it's not, then it's a partial, so track that.
-					if (!all.empty() && !all.back().empty()) {
-						mWaiting = all.back();
-						all.pop_back();
-					}
-					for (auto it=all.begin(), end=all.end(); it!=end; ++it) {
-						if (it->empty()) continue;
-						mReceiveQueue->push(*it);
-					}
-				}
+	// Write as much as the socket takes, and watch for room when it doesn't take it all
+	void							flush(Connection& c) {
+		size_t						sent = 0;
+		while (sent < c.mOutgoing.size()) {
+			const int				size = static_cast<int>(std::min(c.mOutgoing.size() - sent, static_cast<size_t>(INT_MAX)));
+			int						n = 0;
+			try {
+				n = c.mSocket.sendBytes(c.mOutgoing.data() + sent, size, SEND_FLAGS);
+			} catch (Poco::TimeoutException const&) {
+				break;
+			} catch (Poco::Exception const& ex) {
+				if (would_block(ex.code())) break;
+				close(c);
+				return;
+			} catch (std::exception const&) {
+				close(c);
+				return;
 			}
+			if (n <= 0) break;
+			sent += static_cast<size_t>(n);
 		}
+		c.mOutgoing.erase(0, sent);
+		mReactor.setWritable(c.mHandlerId, !c.mOutgoing.empty());
+	}
 
-		static const int								BUFFER_SIZE = 4096;
-		char											mBuffer[BUFFER_SIZE];
-		std::shared_ptr<TcpServer::SendBucket>			mBucket;
-		ds::AsyncQueue<std::string>*					mSendQueue;
-		std::shared_ptr<ds::AsyncQueue<std::string>>	mReceiveQueue;
-		std::shared_ptr<bool>							mSt;
-		const std::string								mTerminator;
-		std::string										mWaiting;
-	};
-
-	class ConnectionFactory: public Poco::Net::TCPServerConnectionFactory {
-	public:
-		ConnectionFactory(	std::shared_ptr<TcpServer::SendBucket>& b, std::shared_ptr<ds::AsyncQueue<std::string>>& rq,
-							std::shared_ptr<bool>& st, const std::string& wakeup, const std::string &terminator)
-				: mBucket(b)
-				, mReceiveQueue(rq)
-				, mSt(st)
-				, mWakeup(wakeup)
-				, mTerminator(terminator) {
-		}
+	void							close(Connection& c) {
+		if (c.mClosed) return;
+		c.mClosed = true;
+		// On the reactor thread, so this doesn't wait on the handler that's calling it
+		mReactor.remove(c.mHandlerId);
+		c.mOutgoing.clear();
 
-		Poco::Net::TCPServerConnection* createConnection(const Poco::Net::StreamSocket& socket) {
-			return new EchoConnection(socket, mBucket, mReceiveQueue, mSt, mWakeup, mTerminator);
+		Poco::Mutex::ScopedLock		l(mMutex);
+		for (auto it=mConnections.begin(), end=mConnections.end(); it!=end; ++it) {
+			if (it->get() == &c) {
+				mConnections.erase(it);
+				return;
+			}
 		}
+	}
 
-		std::shared_ptr<TcpServer::SendBucket>			mBucket;
-		std::shared_ptr<ds::AsyncQueue<std::string>>	mReceiveQueue;
-		std::shared_ptr<bool>							mSt;
-		const std::string								mWakeup;
-		const std::string								mTerminator;
-	};
-}
+private:
+	ds::net::IoReactor&							mReactor;
+	std::atomic<size_t>							mSendLimit;
+	Poco::Mutex									mMutex;
+	std::vector<std::shared_ptr<Connection>>	mConnections;
+};
 
 /**
  * \class ds::TcpServer
@@ -136,27 +150,33 @@ namespace {
 TcpServer::TcpServer(	ds::ui::SpriteEngine& e, const Poco::Net::SocketAddress& address,
 						const std::string& wakeup, const std::string &terminator)
 		: ds::AutoUpdate(e)
+		, mReactor(e.getIoReactor())
 		, mAddress(address)
-		, mStopped(new bool(false))
-		, mBucket(new SendBucket())
-		, mReceiveQueue(new ds::AsyncQueue<std::string>())
-		, mServer(new ConnectionFactory(mBucket, mReceiveQueue, mStopped, wakeup, terminator), Poco::Net::ServerSocket(address)) {
-	if (!mStopped) DS_LOG_WARNING("TcpServer failed making mStopped");
-	if(!mBucket) DS_LOG_WARNING("TcpServer failed making mBucket");
-	if(!mReceiveQueue) DS_LOG_WARNING("TcpServer failed making mReceiveQueue");
-
+		, mWakeup(wakeup)
+		, mTerminator(terminator)
+		, mAcceptId(0)
+		, mClients(new Clients(mReactor)) {
 	try {
-		mServer.start();
+		mServerSocket = Poco::Net::ServerSocket(address);
+		mAcceptId = mReactor.addSocket(mServerSocket, [this]() { onAccept(); });
+		if (!mAcceptId) DS_LOG_ERROR("TcpServer failed to start (" << address.toString() << ") couldn't watch the socket");
 	} catch (std::exception const& ex) {
 		DS_LOG_ERROR("TcpServer failed to start (" << address.toString() << ") error=" << ex.what());
 	}
 }
 
 TcpServer::~TcpServer() {
-	(*mStopped) = true;
+	// No new connections, then none of the handlers are running or will run again
+	if (mAcceptId) mReactor.remove(mAcceptId);
+
+	std::vector<ds::net::IoReactor::HandlerId>	ids;
+	mClients->getHandlerIds(ids);
+	for (auto id : ids) mReactor.remove(id);
 
+	// Anything still waiting to go out is dropped, and the sockets close with the last send
+	// queued for them
 	try {
-		mServer.stop();
+		mServerSocket.close();
 	} catch (std::exception const&) {
 	}
 }
@@ -171,11 +191,24 @@ void TcpServer::add(const std::function<void(const std::string&)>& f) {
 }
 
 void TcpServer::sendToClients(const std::string& data) {
-	mBucket->add(data);
+	if (data.empty()) return;
+
+	// Sent from the reactor thread, so a slow client doesn't hold up the caller
+	std::shared_ptr<Clients>		clients(mClients);
+	const std::string				msg(data + mTerminator);
+	mReactor.post([clients, msg]() { clients->send(msg); });
+}
+
+void TcpServer::setSendLimit(const size_t bytes) {
+	mClients->setSendLimit(bytes);
+}
+
+size_t TcpServer::getClientCount() const {
+	return mClients->size();
 }
 
 void TcpServer::update(const ds::UpdateParams&) {
-	const std::vector<std::string>* vec = mReceiveQueue->update();
+	const std::vector<std::string>* vec = mReceiveQueue.update();
 	if (!vec) return;
 
 	for (auto it=mListener.begin(), end=mListener.end(); it != end; ++it) {
@@ -183,43 +216,73 @@ void TcpServer::update(const ds::UpdateParams&) {
 	}
 }
 
-/**
- * \class ds::TcpServer::SendBucket
- */
-TcpServer::SendBucket::SendBucket() {
-}
-
-ds::AsyncQueue<std::string>* TcpServer::SendBucket::startQueue() {
+void TcpServer::onAccept() {
+	std::shared_ptr<Connection>		c(new Connection());
 	try {
-		ds::AsyncQueue<std::string>*	q = new ds::AsyncQueue<std::string>();
-		if (!q) return nullptr;
-		Poco::Mutex::ScopedLock			l(mMutex);
-		mQueue.push_back(q);
-		return q;
-	} catch (std::exception const&) {
+		c->mSocket = mServerSocket.acceptConnection();
+		c->mSocket.setNoDelay(true);
+		c->mSocket.setBlocking(false);
+	} catch (std::exception const& ex) {
+		DS_LOG_WARNING("TcpServer failed to accept a connection error=" << ex.what());
+		return;
 	}
-	return nullptr;
+
+	// The connection lives as long as it's in mClients, and its handler is removed first
+	Connection*						raw = c.get();
+	Clients*						clients = mClients.get();
+	c->mHandlerId = mReactor.addSocket(c->mSocket, [this, raw]() { onReadable(raw); }, [clients, raw]() { clients->flush(*raw); });
+	if (!c->mHandlerId) return;
+
+	mClients->add(c);
+	if (!mWakeup.empty()) mClients->send(*c, mWakeup + mTerminator);
 }
 
-void TcpServer::SendBucket::endQueue(ds::AsyncQueue<std::string>* q) {
-	if (!q) return;
+void TcpServer::onReadable(Connection* c) {
+	char							buffer[BUFFER_SIZE];
 
-	Poco::Mutex::ScopedLock		l(mMutex);
-	for (auto it=mQueue.begin(), end=mQueue.end(); it!=end; ++it) {
-		if ((*it) == q) {
-			mQueue.erase(it);
+	// Read everything that's waiting, or the reactor will just call again
+	while (true) {
+		int							n = 0;
+		try {
+			n = c->mSocket.receiveBytes(buffer, BUFFER_SIZE);
+		} catch (Poco::TimeoutException const&) {
+			return;
+		} catch (std::exception const&) {
+			mClients->close(*c);
 			return;
 		}
+
+		// Readable with nothing to read means the other end closed
+		if (n == 0) {
+			mClients->close(*c);
+			return;
+		}
+		if (n < 0) return;
+
+		receive(*c, buffer, n);
 	}
 }
 
-void TcpServer::SendBucket::add(const std::string& data) {
-	if (data.empty()) return;
+void TcpServer::receive(Connection& c, const char* data, const int size) {
+	const std::string				incoming(data, size);
+	if (mTerminator.empty()) {
+		mReceiveQueue.push(incoming);
+		return;
+	}
 
-	Poco::Mutex::ScopedLock		l(mMutex);
-	for (auto it=mQueue.begin(), end=mQueue.end(); it!=end; ++it) {
-		auto*	q = *it;
-		if (q) q->push(data);
+	c.mWaiting += incoming;
+	std::vector<std::string> all;
+	boost::split(all, c.mWaiting, boost::is_any_of(mTerminator));
+	c.mWaiting.clear();
+	// The last element will be an empty string if this update() str ended
+	// with the terminator; if it's not, then it's a partial, so track that.
+	if (!all.empty() && !all.back().empty()) {
+		c.mWaiting = all.back();
+		all.pop_back();
+	}
+	for (auto it=all.begin(), end=all.end(); it!=end; ++it) {
+		if (it->empty()) continue;
+		mReceiveQueue.push(*it);
 	}
 }
 
@@ -2,9 +2,11 @@
 #ifndef DS_NETWORK_TCPSERVER_H_
 #define DS_NETWORK_TCPSERVER_H_
 
-#include <Poco/Net/TCPServer.h>
-#include <cinder/Thread.h>
+#include <functional>
+#include <memory>
+#include <Poco/Net/ServerSocket.h>
 #include "ds/app/auto_update.h"
+#include "ds/network/io_reactor.h"
 #include "ds/thread/async_queue.h"
 
 namespace ds {
@@ -13,7 +15,12 @@ namespace net {
 /**
  * \class ds::net::TcpServer
  * \brief Start a server that outside clients can connect to, and will report any changes
- * to the calling application.
+ * to the calling application. Connections are accepted, read and written on the engine's
+ * IoReactor, so there's no thread per connection.
+ *
+ * Sends are buffered for each client and written as its socket takes them. A client that
+ * falls more than the send limit behind is closed, rather than held up for or buffered
+ * without end.
  */
 class TcpServer : public ds::AutoUpdate {
 public:
@@ -27,34 +34,34 @@ public:
 	void							add(const std::function<void(const std::string&)>&);
 	void							sendToClients(const std::string& data);
 
+	static const size_t				DEFAULT_SEND_LIMIT = 4 * 1024 * 1024;
+	/// Bytes waiting to go to one client before it's closed
+	void							setSendLimit(const size_t bytes);
+	/// Clients connected right now
+	size_t							getClientCount() const;
+
 protected:
 	// Flush any change notifications from the calling thread.
 	virtual void					update(const ds::UpdateParams&);
 
-public:
-	class SendBucket {
-	public:
-		SendBucket();
-
-		ds::AsyncQueue<std::string>*	startQueue();
-		void							endQueue(ds::AsyncQueue<std::string>*);
-
-		void							add(const std::string& data);
+private:
+	class Clients;
+	struct Connection;
 
-	private:
-		Poco::Mutex									mMutex;
-		std::vector<ds::AsyncQueue<std::string>*>	mQueue;
-	};
+	// Called on the reactor thread
+	void							onAccept();
+	void							onReadable(Connection*);
+	void							receive(Connection&, const char* data, const int size);
 
-private:
+	ds::net::IoReactor&				mReactor;
 	const Poco::Net::SocketAddress	mAddress;
-	// These shared_ptr objects are shared with each connection I create.
-	// Connections might exist past the life of this class.
-	std::shared_ptr<bool>			mStopped;
-	std::shared_ptr<SendBucket>		mBucket;
-	std::shared_ptr<ds::AsyncQueue<std::string>>
-									mReceiveQueue;
-	Poco::Net::TCPServer			mServer;
+	const std::string				mWakeup;
+	const std::string				mTerminator;
+	Poco::Net::ServerSocket			mServerSocket;
+	ds::net::IoReactor::HandlerId	mAcceptId;
+	// Shared with anything queued to send, which might run past the life of this class.
+	std::shared_ptr<Clients>		mClients;
+	ds::AsyncQueue<std::string>		mReceiveQueue;
 	std::vector<std::function<void(const std::string&)>>
 									mListener;
 };
@@ -1,15 +1,33 @@
 #include "stdafx.h"
 
 #include "udp_connection.h"
+#include <algorithm>
 #include <iostream>
 #include <Poco/Net/NetException.h>
 #include "ds/util/string_util.h"
 #include <ds/debug/logger.h>
 
+#if defined(__linux__)
+#define DS_UDP_SENDMMSG
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <Poco/Net/SocketImpl.h>
+#endif
+
 const unsigned int		ds::NET_MAX_UDP_PACKET_SIZE = 2000000;
 
 namespace ds {
 
+namespace {
+#ifdef DS_UDP_SENDMMSG
+// How long sendMessages() waits, all told, for the send buffer to make room
+const int				SEND_WAIT_MS = 10;
+#endif
+}
+
 UdpConnection::UdpConnection(int numThreads)
 	: mServer(false)
 	, mInitialized(false)
@@ -130,6 +148,69 @@ bool UdpConnection::sendMessage(const char *data, int size){
 	return false;
 }
 
+int UdpConnection::sendMessages(const char* const* data, const int* sizes, const int count){
+	if(!mInitialized || count < 1){
+		return 0;
+	}
+
+#ifdef DS_UDP_SENDMMSG
+	const int				BATCH_SIZE = 64;
+	const int				fd = static_cast<int>(mSocket.impl()->sockfd());
+	struct mmsghdr			msgs[BATCH_SIZE];
+	struct iovec			iovs[BATCH_SIZE];
+
+	// The socket is connected, so no addresses
+	int sent = 0;
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SEND_WAIT_MS);
+	while(sent < count){
+		const int batch = std::min(BATCH_SIZE, count - sent);
+		for(int i = 0; i < batch; ++i){
+			iovs[i].iov_base = const_cast<char*>(data[sent + i]);
+			iovs[i].iov_len = sizes[sent + i];
+			std::memset(&msgs[i], 0, sizeof(msgs[i]));
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		const int n = sendmmsg(fd, msgs, batch, 0);
+		if(n <= 0){
+			const int err = (n == 0 ? EAGAIN : errno);
+			if(err == EINTR) continue;
+
+			// The send buffer is full, the socket is non-blocking. Wait for room and go on with the rest.
+			if(err == EAGAIN || err == EWOULDBLOCK || err == ENOBUFS){
+				const auto now = std::chrono::steady_clock::now();
+				if(now < deadline){
+					struct pollfd	pfd;
+					pfd.fd = fd;
+					pfd.events = POLLOUT;
+					pfd.revents = 0;
+					poll(&pfd, 1, static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count()) + 1);
+					continue;
+				}
+				DS_LOG_WARNING("UdpConnection::sendMessages() send buffer stayed full, dropped " << count - sent << " of " << count);
+				break;
+			}
+
+			// Anything else may be down to one datagram, so send the rest one at a time
+			DS_LOG_WARNING("UdpConnection::sendMessages() error " << strerror(err) << ", sending the rest singly");
+			const int first = sent;
+			for(int i = first; i < count; ++i){
+				if(sendMessage(data[i], sizes[i])) ++sent;
+			}
+			break;
+		}
+		for(int i = 0; i < n; ++i){
+			mSentBytes += msgs[i].msg_len;
+		}
+		sent += n;
+	}
+	return sent;
+#else
+	return NetConnection::sendMessages(data, sizes, count);
+#endif
+}
+
 int UdpConnection::recvMessage(std::string &msg){
 	if(!mInitialized)
 		return 0;
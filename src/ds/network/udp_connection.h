@@ -24,6 +24,9 @@ public:
 
 	bool sendMessage(const std::string &data);
 	bool sendMessage(const char *data, int size);
+	// Uses sendmmsg() where there is one. When the send buffer is full it waits up to 10ms for
+	// room, then drops the rest. Answers how many were sent.
+	int sendMessages(const char* const* data, const int* sizes, const int count);
 
 	int recvMessage(std::string &msg);
 	// Answer true if I have more data to receive, false otherwise.
@@ -7,6 +7,8 @@ namespace ds
 
 DrawParams::DrawParams()
   : mParentOpacity(1.0f)
+  , mCull(false)
+  , mCullRect(0.0f, 0.0f, 0.0f, 0.0f)
 {
 
 }
@@ -2,6 +2,8 @@
 #ifndef DS_DRAW_PARAMS_H
 #define DS_DRAW_PARAMS_H
 
+#include <cinder/Rect.h>
+
 namespace ds {
 
 /**
@@ -12,6 +14,10 @@ class DrawParams {
 public:
 	DrawParams();
 	float mParentOpacity;
+	/// Sprites entirely outside this world-space rect aren't drawn, when mCull is on. It starts as
+	/// the viewport and shrinks to each clipping sprite on the way down.
+	bool mCull;
+	ci::Rectf mCullRect;
 };
 
 } // namespace ds
@@ -111,6 +111,18 @@ void WorkManager::update()
 	mOutputTmp.clear();
 }
 
+size_t WorkManager::getInputSize()
+{
+	Poco::Mutex::ScopedLock		l(mInputMutex);
+	return mInput.size();
+}
+
+size_t WorkManager::getOutputSize()
+{
+	Poco::Mutex::ScopedLock		l(mOutputMutex);
+	return mOutput.size();
+}
+
 bool WorkManager::inputAdded()
 {
 	// Start a new thread to handle the input.  If we can't start one, no big deal,
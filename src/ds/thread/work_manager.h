@@ -35,6 +35,10 @@ public:
 	// Stop the thread pool.  Called from the destructor, if a client doesn't call it earlier.
 	void							stopManager();
 
+	// Requests waiting for a thread, and finished requests waiting for update()
+	size_t							getInputSize();
+	size_t							getOutputSize();
+
 protected:
 	friend class WorkClient;
 
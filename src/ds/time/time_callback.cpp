@@ -8,59 +8,37 @@ namespace time {
 
 
 Callback::Callback(ds::ui::SpriteEngine& eng) 
-	: ds::AutoUpdate(eng)
-	, mRunning(false)
-	, mRepeated(false)
-	, mDelay(0.0)
-	, mCallback(nullptr)
+	: mEngine(eng)
+	, mId(0)
 {}
 
 Callback::Callback(ds::ui::SpriteEngine& eng, std::function<void()> func, const double secondsDelay)
-	: ds::AutoUpdate(eng)
-	, mRunning(false)
-	, mRepeated(true)
-	, mDelay(0.0)
-	, mCallback(nullptr)
+	: mEngine(eng)
+	, mId(0)
 {
 	repeatedCallback(func, secondsDelay);
 }
 
+Callback::~Callback() {
+	cancel();
+}
+
 size_t Callback::timedCallback(std::function<void()> func, const double secondsCallback) {
-	mId = mEngine.mCallbackId++;
-	mRunning = true;
-	mRepeated = false;
-	mCallback = func;
-	mDelay = secondsCallback;
-	mStart = Poco::Timestamp().epochMicroseconds();
+	cancel();
+	mId = mEngine.getTimerWheel().scheduleIn(secondsCallback, func);
 	return mId;
 }
 
 size_t Callback::repeatedCallback(std::function<void()> func, const double secondsCallback) {
-	mId = mEngine.mCallbackId++;
-	mRunning = true;
-	mRepeated = true;
-	mCallback = func;
-	mDelay = secondsCallback;
-	mStart = Poco::Timestamp().epochMicroseconds();
+	cancel();
+	// A zero delay used to mean every update, so keep it repeating at the wheel's resolution
+	const double repeat = secondsCallback > 0.0 ? secondsCallback : TimerWheel::TICK_MICROS / 1000000.0;
+	mId = mEngine.getTimerWheel().scheduleIn(secondsCallback, func, repeat);
 	return mId;
 }
 
 void Callback::cancel() {
-	mRunning = false;
-	mCallback = nullptr;
-}
-
-void Callback::update(const ds::UpdateParams& p) {
-	if(mRunning && mCallback) {
-		if((Poco::Timestamp().epochMicroseconds() - mStart) / Poco::Timestamp::resolution() > mDelay) {
-			mCallback();
-			if(mRepeated) {
-				mStart = Poco::Timestamp().epochMicroseconds();
-			} else {
-				mRunning = false;
-			}
-		}
-	}
+	if(mId) mEngine.getTimerWheel().cancel(mId);
 }
 
 
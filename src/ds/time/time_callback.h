@@ -2,18 +2,21 @@
 #ifndef DS_TIME_TIME_CALLBACK
 #define DS_TIME_TIME_CALLBACK
 
-#include <Poco/Timestamp.h>
-#include <ds/app/auto_update.h>
+#include <ds/time/timer_wheel.h>
 #include <functional>
 
 namespace ds {
+namespace ui {
+class SpriteEngine;
+}
 namespace time {
 
 /**
 * \class ds::time::Callback
 * \brief Get a lambda function back after a certain amount of time. Only supports a single callback at a time
+* Runs on the engine's TimerWheel, and cancels itself when destroyed.
 */
-class Callback : ds::AutoUpdate {
+class Callback {
 public:
 
 	/// Construct a blank callback, use singleCallback() or repeatedCallback()
@@ -21,6 +24,8 @@ public:
 
 	/// Repeatedly callback
 	Callback(ds::ui::SpriteEngine& eng, std::function<void()> func, const double secondsDelay);
+
+	~Callback();
 	
 	/// Waits the specified amount of time, calls the function, then stops
 	/// Returns an ID so you can cancel it later if you need to (if you're starting this from the engine)
@@ -37,14 +42,11 @@ public:
 	size_t getId() { return mId; }
 
 private:
+	Callback(const Callback&);
+	Callback&					operator=(const Callback&);
 
-	virtual void				update(const ds::UpdateParams& p) override;
-	std::function<void()>		mCallback;
-	Poco::Timestamp::TimeVal	mStart;
-	size_t						mId;
-	double						mDelay;
-	bool						mRepeated;
-	bool						mRunning;
+	ds::ui::SpriteEngine&		mEngine;
+	TimerWheel::Handle			mId;
 };
 
 } // namespace time
@@ -0,0 +1,276 @@
+#include "stdafx.h"
+
+#include "ds/time/timer_wheel.h"
+
+#include <algorithm>
+#include <Poco/Clock.h>
+
+namespace ds {
+namespace time {
+
+namespace {
+// Handles pack the node index in the low bits and a generation count above it, so a
+// stale handle never cancels whatever timer reused its node.
+const int					INDEX_BITS = sizeof(size_t) >= 8 ? 32 : 20;
+const uint32_t				GENERATION_MASK = sizeof(size_t) >= 8 ? 0xFFFFFFFF : 0xFFF;
+
+int64_t						seconds_to_micros(const double s) {
+	return static_cast<int64_t>(s * 1000000.0);
+}
+}
+
+/**
+ * \class ds::time::TimerWheel
+ */
+TimerWheel::TimerWheel()
+		: mTick(0)
+		, mOriginMicros(now())
+		, mCount(0) {
+	std::fill(mOccupied, mOccupied + LEVELS, 0);
+}
+
+TimerWheel::TimerWheel(const int64_t nowMicros)
+		: mTick(0)
+		, mOriginMicros(nowMicros)
+		, mCount(0) {
+	std::fill(mOccupied, mOccupied + LEVELS, 0);
+}
+
+int64_t TimerWheel::now() {
+	return Poco::Clock().microseconds();
+}
+
+TimerWheel::Handle TimerWheel::scheduleIn(const double secondsDelay, const std::function<void()>& fn, const double repeatSeconds) {
+	return schedule(now() + seconds_to_micros(secondsDelay), fn, seconds_to_micros(repeatSeconds));
+}
+
+TimerWheel::Handle TimerWheel::schedule(const int64_t dueMicros, const std::function<void()>& fn, const int64_t repeatMicros) {
+	if(!fn) return 0;
+	const uint32_t			index = allocNode();
+	if(index == NONE) return 0;
+
+	// Round up, so a timer never fires before its time
+	int64_t					due = (dueMicros - mOriginMicros + TICK_MICROS - 1) / TICK_MICROS;
+	if(due <= mTick) due = mTick + 1;
+
+	Node&					n = mNodes[index];
+	n.mState = PENDING;
+	n.mDue = due;
+	n.mRepeat = repeatMicros > 0 ? std::max<int64_t>(1, (repeatMicros + TICK_MICROS - 1) / TICK_MICROS) : 0;
+	n.mFn = fn;
+	link(index);
+	++mCount;
+	return makeHandle(index);
+}
+
+bool TimerWheel::cancel(const Handle h) {
+	const uint32_t			index = findNode(h);
+	if(index == NONE) return false;
+
+	Node&					n = mNodes[index];
+	if(n.mState == FIRING) {
+		// Its callback is on the stack, so fireSlot() frees it afterwards
+		n.mState = CANCELLED;
+		return true;
+	}
+	unlink(index);
+	freeNode(index);
+	return true;
+}
+
+bool TimerWheel::isPending(const Handle h) const {
+	return findNode(h) != NONE;
+}
+
+size_t TimerWheel::advance() {
+	return advance(now());
+}
+
+size_t TimerWheel::advance(const int64_t nowMicros) {
+	const int64_t			target = (nowMicros - mOriginMicros) / TICK_MICROS;
+	size_t					fired = 0;
+	while(mTick < target) {
+		// Nothing can fire before the next boundary of the lowest level holding timers, so skip to it
+		int					lowest = 0;
+		while(lowest < LEVELS && mOccupied[lowest] == 0) ++lowest;
+		if(lowest == LEVELS) {
+			mTick = target;
+			break;
+		}
+		if(lowest > 0) {
+			const int		shift = lowest * SLOT_BITS;
+			const int64_t	boundary = ((mTick >> shift) + 1) << shift;
+			mTick = std::min(target, boundary) - 1;
+		}
+
+		++mTick;
+		// Pull the timers from any higher level slot that starts on this tick down toward level 0
+		int					top = 0;
+		while(top + 1 < LEVELS && (mTick & ((int64_t(1) << ((top + 1) * SLOT_BITS)) - 1)) == 0) ++top;
+		for(int level = top; level > 0; --level) cascade(level);
+
+		fired += fireSlot(static_cast<int>(mTick & (SLOTS - 1)));
+	}
+	return fired;
+}
+
+TimerWheel::Handle TimerWheel::makeHandle(const uint32_t index) const {
+	return (static_cast<Handle>(mNodes[index].mGeneration) << INDEX_BITS) | static_cast<Handle>(index);
+}
+
+uint32_t TimerWheel::findNode(const Handle h) const {
+	if(h == 0) return NONE;
+	const uint32_t			index = static_cast<uint32_t>(h & ((static_cast<Handle>(1) << INDEX_BITS) - 1));
+	const uint32_t			generation = static_cast<uint32_t>(h >> INDEX_BITS);
+	if(index >= mNodes.size()) return NONE;
+	const Node&				n = mNodes[index];
+	if(n.mGeneration != generation || (n.mState != PENDING && n.mState != FIRING)) return NONE;
+	return index;
+}
+
+uint32_t TimerWheel::allocNode() {
+	if(!mFree.empty()) {
+		const uint32_t		index = mFree.back();
+		mFree.pop_back();
+		return index;
+	}
+	if(mNodes.size() >= (static_cast<size_t>(1) << INDEX_BITS) - 1) return NONE;
+	mNodes.push_back(Node());
+	mNodes.back().mGeneration = 1;
+	return static_cast<uint32_t>(mNodes.size() - 1);
+}
+
+void TimerWheel::freeNode(const uint32_t index) {
+	Node&					n = mNodes[index];
+	n.mState = FREE;
+	n.mFn = nullptr;
+	n.mGeneration = (n.mGeneration + 1) & GENERATION_MASK;
+	if(n.mGeneration == 0) n.mGeneration = 1;
+	mFree.push_back(index);
+	--mCount;
+}
+
+void TimerWheel::link(const uint32_t index) {
+	Node&					n = mNodes[index];
+	const int64_t			delta = n.mDue - mTick;
+	int						level = 0;
+	while(level + 1 < LEVELS && delta >= (int64_t(1) << ((level + 1) * SLOT_BITS))) ++level;
+	const int64_t			due = (level + 1 == LEVELS) ? std::min(n.mDue, mTick + (int64_t(1) << (LEVELS * SLOT_BITS)) - 1) : n.mDue;
+	const int				slot = static_cast<int>((due >> (level * SLOT_BITS)) & (SLOTS - 1));
+
+	List&					list = mSlots[level * SLOTS + slot];
+	n.mSlot = static_cast<uint32_t>(level * SLOTS + slot);
+	n.mNext = NONE;
+	n.mPrev = list.mTail;
+	if(list.mTail != NONE) mNodes[list.mTail].mNext = index;
+	else list.mHead = index;
+	list.mTail = index;
+	mOccupied[level] |= (uint64_t(1) << slot);
+}
+
+void TimerWheel::unlink(const uint32_t index) {
+	Node&					n = mNodes[index];
+	if(n.mSlot == NONE) return;
+	List&					list = mSlots[n.mSlot];
+	if(n.mPrev != NONE) mNodes[n.mPrev].mNext = n.mNext;
+	else list.mHead = n.mNext;
+	if(n.mNext != NONE) mNodes[n.mNext].mPrev = n.mPrev;
+	else list.mTail = n.mPrev;
+	if(list.mHead == NONE) mOccupied[n.mSlot / SLOTS] &= ~(uint64_t(1) << (n.mSlot % SLOTS));
+	n.mPrev = n.mNext = n.mSlot = NONE;
+}
+
+void TimerWheel::cascade(const int level) {
+	const int				slot = static_cast<int>((mTick >> (level * SLOT_BITS)) & (SLOTS - 1));
+	List&					list = mSlots[level * SLOTS + slot];
+	uint32_t				index = list.mHead;
+	list.mHead = list.mTail = NONE;
+	mOccupied[level] &= ~(uint64_t(1) << slot);
+	while(index != NONE) {
+		const uint32_t		next = mNodes[index].mNext;
+		mNodes[index].mSlot = NONE;
+		link(index);
+		index = next;
+	}
+}
+
+size_t TimerWheel::fireSlot(const int slot) {
+	List&					list = mSlots[slot];
+	if(list.mHead == NONE) return 0;
+
+	// Take the whole slot first, so callbacks can schedule and cancel freely
+	mFiring.clear();
+	for(uint32_t index = list.mHead; index != NONE; index = mNodes[index].mNext) {
+		mFiring.push_back(index);
+		mNodes[index].mState = FIRING;
+		mNodes[index].mSlot = NONE;
+	}
+	list.mHead = list.mTail = NONE;
+	mOccupied[0] &= ~(uint64_t(1) << slot);
+
+	// A callback can advance the wheel re-entrantly, which reuses mFiring
+	std::vector<uint32_t>	firing;
+	firing.swap(mFiring);
+
+	size_t					fired = 0;
+	for(const uint32_t index : firing) {
+		if(mNodes[index].mState == CANCELLED) {
+			freeNode(index);
+			continue;
+		}
+
+		// Scheduling from inside the callback can grow mNodes, so don't call through a reference into it
+		std::function<void()>	fn;
+		fn.swap(mNodes[index].mFn);
+		fn();
+		++fired;
+
+		Node&				n = mNodes[index];
+		if(n.mState == FIRING && n.mRepeat > 0) {
+			n.mState = PENDING;
+			n.mDue = mTick + n.mRepeat;
+			n.mFn.swap(fn);
+			link(index);
+		} else {
+			freeNode(index);
+		}
+	}
+
+	firing.clear();
+	if(mFiring.empty()) mFiring.swap(firing);
+	return fired;
+}
+
+/**
+ * \class ds::time::TimerWheel::Scope
+ */
+TimerWheel::Scope::Scope(TimerWheel& w)
+		: mWheel(w) {
+}
+
+TimerWheel::Scope::~Scope() {
+	cancelAll();
+}
+
+TimerWheel::Handle TimerWheel::Scope::scheduleIn(const double secondsDelay, const std::function<void()>& fn, const double repeatSeconds) {
+	// Forget timers that have already fired every so often, so one-shots don't pile up
+	if(mHandles.size() >= 32 && (mHandles.size() & (mHandles.size() - 1)) == 0) {
+		mHandles.erase(std::remove_if(mHandles.begin(), mHandles.end(), [this](const Handle h){ return !mWheel.isPending(h); }), mHandles.end());
+	}
+	const Handle			h = mWheel.scheduleIn(secondsDelay, fn, repeatSeconds);
+	if(h) mHandles.push_back(h);
+	return h;
+}
+
+void TimerWheel::Scope::cancel(const Handle h) {
+	mWheel.cancel(h);
+	mHandles.erase(std::remove(mHandles.begin(), mHandles.end(), h), mHandles.end());
+}
+
+void TimerWheel::Scope::cancelAll() {
+	for(const Handle h : mHandles) mWheel.cancel(h);
+	mHandles.clear();
+}
+
+} // namespace time
+} // namespace ds
@@ -0,0 +1,129 @@
+#pragma once
+#ifndef DS_TIME_TIMERWHEEL_H_
+#define DS_TIME_TIMERWHEEL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace ds {
+namespace time {
+
+/**
+ * \class ds::time::TimerWheel
+ * \brief Hierarchical timer wheel. Scheduling and cancelling are constant time, and
+ * advancing only touches timers that are due (plus an occasional cascade), so idle
+ * timers cost nothing per frame. The engine advances its wheel once per server update;
+ * see SpriteEngine::getTimerWheel(). Not thread safe.
+ */
+class TimerWheel {
+public:
+	/// 0 is never a valid handle
+	typedef size_t				Handle;
+
+	/// Tick length. Timers fire on the first advance() at or after their due tick.
+	static const int64_t		TICK_MICROS = 1000;
+
+	/// Starts the wheel at the current clock time
+	TimerWheel();
+	/// Starts the wheel at an arbitrary time, for driving it with a fake clock
+	explicit TimerWheel(const int64_t nowMicros);
+
+	/// Monotonic clock time in microseconds. Same timebase as advance() and schedule().
+	static int64_t				now();
+
+	/// Call fn once, secondsDelay from now. If repeatSeconds is greater than zero,
+	/// keep calling it that often, measured from each time it fires, until cancelled.
+	Handle						scheduleIn(const double secondsDelay, const std::function<void()>& fn, const double repeatSeconds = 0.0);
+	/// Call fn at an absolute clock time, and every repeatMicros after if that's greater than zero
+	Handle						schedule(const int64_t dueMicros, const std::function<void()>& fn, const int64_t repeatMicros = 0);
+
+	/// Answers true if the timer was still pending. Safe to call from inside a callback,
+	/// including the one being cancelled.
+	bool						cancel(const Handle);
+	bool						isPending(const Handle) const;
+	size_t						size() const { return mCount; }
+
+	/// Fire everything due at or before the current clock time. Answers how many fired.
+	size_t						advance();
+	size_t						advance(const int64_t nowMicros);
+
+	/**
+	 * \class ds::time::TimerWheel::Scope
+	 * \brief Cancels the timers it scheduled when it goes away. Keep one as a member
+	 * of a sprite (or anything else) to tie its timers to its lifetime.
+	 */
+	class Scope {
+	public:
+		Scope(TimerWheel&);
+		~Scope();
+
+		Handle					scheduleIn(const double secondsDelay, const std::function<void()>& fn, const double repeatSeconds = 0.0);
+		void					cancel(const Handle);
+		void					cancelAll();
+
+	private:
+		Scope(const Scope&);
+		Scope&					operator=(const Scope&);
+
+		TimerWheel&				mWheel;
+		std::vector<Handle>		mHandles;
+	};
+
+private:
+	TimerWheel(const TimerWheel&);
+	TimerWheel&					operator=(const TimerWheel&);
+
+	static const int			SLOT_BITS = 6;
+	static const int			SLOTS = 1 << SLOT_BITS;
+	static const int			LEVELS = 6;
+	static const uint32_t		NONE = 0xFFFFFFFF;
+
+	enum State { FREE, PENDING, FIRING, CANCELLED };
+
+	class Node {
+	public:
+		Node() : mPrev(NONE), mNext(NONE), mSlot(NONE), mGeneration(0), mState(FREE), mDue(0), mRepeat(0) {}
+		uint32_t				mPrev, mNext;
+		// Level * SLOTS + slot, or NONE when not linked
+		uint32_t				mSlot;
+		uint32_t				mGeneration;
+		State					mState;
+		int64_t					mDue;
+		int64_t					mRepeat;
+		std::function<void()>	mFn;
+	};
+
+	class List {
+	public:
+		List() : mHead(NONE), mTail(NONE) {}
+		uint32_t				mHead, mTail;
+	};
+
+	Handle						makeHandle(const uint32_t index) const;
+	uint32_t					findNode(const Handle) const;
+	uint32_t					allocNode();
+	void						freeNode(const uint32_t index);
+	void						link(const uint32_t index);
+	void						unlink(const uint32_t index);
+	void						cascade(const int level);
+	size_t						fireSlot(const int slot);
+
+	std::vector<Node>			mNodes;
+	std::vector<uint32_t>		mFree;
+	List						mSlots[LEVELS * SLOTS];
+	// Bit per non-empty slot, per level, so empty stretches can be skipped
+	uint64_t					mOccupied[LEVELS];
+	// Current tick, and the clock time it was measured against
+	int64_t						mTick;
+	int64_t						mOriginMicros;
+	size_t						mCount;
+	// Reused by fireSlot()
+	std::vector<uint32_t>		mFiring;
+};
+
+} // namespace time
+} // namespace ds
+
+#endif // DS_TIME_TIMERWHEEL_H_
@@ -0,0 +1,442 @@
+#include "stdafx.h"
+
+#include <ds/ui/ip/functions/ip_kernels.h>
+
+#include <algorithm>
+#include <cmath>
+#include <Poco/String.h>
+#include "ds/debug/logger.h"
+#include "ds/util/string_util.h"
+
+namespace ds {
+namespace ui {
+namespace ip {
+
+namespace {
+const float					PI_F = 3.14159265358979f;
+// Columns per vertical blur job, 64 bytes for RGBA
+const int					BLUR_STRIP = 16;
+
+// Params are comma separated key:value pairs
+float						get_param(const std::string& parameters, const std::string& key, const float defaultValue) {
+	const std::vector<std::string>	pairs = ds::split(parameters, ",", true);
+	for(auto it : pairs) {
+		const std::string	p = Poco::trim(it);
+		if(p.compare(0, key.size() + 1, key + ":") == 0) {
+			return ds::string_to_float(p.substr(key.size() + 1));
+		}
+	}
+	return defaultValue;
+}
+
+std::string					get_string_param(const std::string& parameters, const std::string& key) {
+	const std::vector<std::string>	pairs = ds::split(parameters, ",", true);
+	for(auto it : pairs) {
+		const std::string	p = Poco::trim(it);
+		if(p.compare(0, key.size() + 1, key + ":") == 0) {
+			return Poco::toLower(p.substr(key.size() + 1));
+		}
+	}
+	return "";
+}
+
+std::vector<float>&			coverage_scratch(const int width) {
+	static thread_local std::vector<float>	SCRATCH;
+	if(SCRATCH.size() < static_cast<size_t>(width)) SCRATCH.resize(width);
+	return SCRATCH;
+}
+
+std::vector<uint8_t>&		byte_scratch(const size_t size) {
+	static thread_local std::vector<uint8_t>	SCRATCH;
+	if(SCRATCH.size() < size) SCRATCH.resize(size);
+	return SCRATCH;
+}
+
+// Premultiply before kernels that average neighbours, so transparent pixels don't bleed colour.
+// Answers true if the caller should unpremultiply when done.
+bool						premultiply(ci::Surface8u& s) {
+	const PixelLayout		layout(s);
+	if(layout.mA < 0 || s.isPremultiplied()) return false;
+	uint8_t*				data = s.getData();
+	const ptrdiff_t			rowBytes = s.getRowBytes();
+	const int				width = s.getWidth();
+	forEachRow(s.getHeight(), [&](const int begin, const int end) {
+		for(int y = begin; y < end; ++y) premultiplyRow(layout, data + y * rowBytes, width);
+	});
+	return true;
+}
+
+void						unpremultiply(ci::Surface8u& s) {
+	const PixelLayout		layout(s);
+	uint8_t*				data = s.getData();
+	const ptrdiff_t			rowBytes = s.getRowBytes();
+	const int				width = s.getWidth();
+	forEachRow(s.getHeight(), [&](const int begin, const int end) {
+		for(int y = begin; y < end; ++y) unpremultiplyRow(layout, data + y * rowBytes, width);
+	});
+}
+
+float						sinc(const float x) {
+	if(x == 0.0f) return 1.0f;
+	const float				px = PI_F * x;
+	return std::sin(px) / px;
+}
+
+// Source pixels and weights that make up one output pixel of a resize
+class Contribution {
+public:
+	int						mFirst;
+	std::vector<float>		mWeights;
+};
+
+std::vector<Contribution>	resize_contributions(const int srcSize, const int dstSize, const bool lanczos) {
+	const float				scale = static_cast<float>(dstSize) / static_cast<float>(srcSize);
+	// Only ever shrinking, so the filter gets stretched to cover every source pixel
+	const float				filterScale = 1.0f / scale;
+	const float				support = (lanczos ? 3.0f : 0.5f) * filterScale;
+
+	std::vector<Contribution>	ans(dstSize);
+	for(int i = 0; i < dstSize; ++i) {
+		const float			centre = (static_cast<float>(i) + 0.5f) / scale - 0.5f;
+		const int			first = std::max(0, static_cast<int>(std::floor(centre - support)));
+		const int			last = std::min(srcSize - 1, static_cast<int>(std::ceil(centre + support)));
+		Contribution&		c = ans[i];
+		c.mFirst = first;
+		float				total = 0.0f;
+		for(int j = first; j <= last; ++j) {
+			const float		t = (static_cast<float>(j) - centre) / filterScale;
+			float			w = 0.0f;
+			if(lanczos) {
+				if(t > -3.0f && t < 3.0f) w = sinc(t) * sinc(t / 3.0f);
+			} else {
+				if(t >= -0.5f && t < 0.5f) w = 1.0f;
+			}
+			c.mWeights.push_back(w);
+			total += w;
+		}
+		if(total != 0.0f) {
+			for(auto& w : c.mWeights) w /= total;
+		}
+	}
+	return ans;
+}
+
+inline uint8_t				to_byte(const float v) {
+	if(v <= 0.0f) return 0;
+	if(v >= 255.0f) return 255;
+	return static_cast<uint8_t>(v + 0.5f);
+}
+}
+
+/**
+ * \class ds::ui::ip::MaskKernel
+ */
+MaskKernel::MaskKernel(const Shape shape, const std::string& parameters)
+		: mShape(shape)
+		, mPad(get_param(parameters, "pad", 0.0f))
+		, mRadius(get_param(parameters, "radius", 0.0f))
+		, mCenX(0.0f)
+		, mCenY(0.0f)
+		, mMaxSq(0.0f)
+		, mHalfW(0.0f)
+		, mHalfH(0.0f) {
+}
+
+void MaskKernel::begin(const ci::Surface8u& s) {
+	mCenX = static_cast<float>(s.getWidth()) / 2.0f;
+	mCenY = static_cast<float>(s.getHeight()) / 2.0f;
+
+	float					max = (mCenX <= mCenY ? mCenX : mCenY);
+	if(mPad > max) {
+		max = 0.0f;
+	} else {
+		max = max - mPad;
+	}
+	mMaxSq = max * max; // compare the squared distance for speed
+
+	mHalfW = std::max(0.0f, mCenX - mPad);
+	mHalfH = std::max(0.0f, mCenY - mPad);
+}
+
+void MaskKernel::row(const PixelLayout& layout, const int y, const int width, uint8_t* pixels) const {
+	if(layout.mA < 0) return;
+	float*					coverage = coverage_scratch(width).data();
+
+	if(mShape == CIRCLE) {
+		// Same falloff as the original per-pixel circle mask
+		const float			dy = static_cast<float>(y) - mCenY;
+		const float			dySq = dy * dy;
+		for(int x = 0; x < width; ++x) {
+			const float		dx = static_cast<float>(x) - mCenX;
+			const float		d = dx * dx + dySq;
+			float			alpha_f = 1.0f;
+			if(d > mMaxSq) {
+				alpha_f = 0.0f;
+			} else if(d > mMaxSq - 1.0f) {
+				alpha_f = 1.0f - (d - (mMaxSq - 1.0f));
+			}
+			coverage[x] = alpha_f;
+		}
+	} else {
+		// Signed distance to the rounded rect, sampled at the pixel centre
+		const float			radius = std::min(mRadius, std::min(mHalfW, mHalfH));
+		const float			qy = std::abs(static_cast<float>(y) + 0.5f - mCenY) - (mHalfH - radius);
+		for(int x = 0; x < width; ++x) {
+			const float		qx = std::abs(static_cast<float>(x) + 0.5f - mCenX) - (mHalfW - radius);
+			const float		ox = std::max(qx, 0.0f),
+							oy = std::max(qy, 0.0f);
+			const float		sd = std::sqrt(ox * ox + oy * oy) + std::min(std::max(qx, qy), 0.0f) - radius;
+			coverage[x] = std::min(1.0f, std::max(0.0f, 0.5f - sd));
+		}
+	}
+
+	multiplyAlphaRow(layout, pixels, coverage, width);
+}
+
+/**
+ * \class ds::ui::ip::DesaturateKernel
+ */
+DesaturateKernel::DesaturateKernel(const std::string& parameters)
+		: mAmount(static_cast<int>(std::min(1.0f, std::max(0.0f, get_param(parameters, "amount", 1.0f))) * 256.0f)) {
+}
+
+void DesaturateKernel::row(const PixelLayout& layout, const int, const int width, uint8_t* pixels) const {
+	const int				keep = 256 - mAmount;
+	for(int x = 0; x < width; ++x) {
+		uint8_t*			p = pixels + x * layout.mPixelInc;
+		const int			r = p[layout.mR], g = p[layout.mG], b = p[layout.mB];
+		const int			luma = (77 * r + 150 * g + 29 * b + 128) >> 8;
+		p[layout.mR] = static_cast<uint8_t>((r * keep + luma * mAmount + 128) >> 8);
+		p[layout.mG] = static_cast<uint8_t>((g * keep + luma * mAmount + 128) >> 8);
+		p[layout.mB] = static_cast<uint8_t>((b * keep + luma * mAmount + 128) >> 8);
+	}
+}
+
+/**
+ * \class ds::ui::ip::BlurKernel
+ */
+BlurKernel::BlurKernel(const std::string& parameters) {
+	const float				sigma = std::max(0.1f, get_param(parameters, "sigma", 2.0f));
+	const int				radius = std::max(1, static_cast<int>(std::ceil(sigma * 3.0f)));
+
+	std::vector<float>		weights(radius + 1);
+	float					total = 0.0f;
+	for(int i = 0; i <= radius; ++i) {
+		weights[i] = std::exp(-static_cast<float>(i * i) / (2.0f * sigma * sigma));
+		total += (i == 0 ? weights[i] : weights[i] * 2.0f);
+	}
+
+	// Quantize, and give any rounding error to the centre tap so the weights sum to exactly 1
+	mWeights.resize(radius + 1);
+	int32_t					sides = 0;
+	for(int i = 1; i <= radius; ++i) {
+		mWeights[i] = static_cast<int32_t>(weights[i] / total * 65536.0f + 0.5f);
+		sides += mWeights[i] * 2;
+	}
+	mWeights[0] = 65536 - sides;
+}
+
+void BlurKernel::run(ci::Surface8u& s) const {
+	const bool				unpremult = premultiply(s);
+
+	const int				w = s.getWidth(),
+							h = s.getHeight(),
+							inc = static_cast<int>(s.getPixelInc()),
+							radius = static_cast<int>(mWeights.size()) - 1;
+	uint8_t*				data = s.getData();
+	const ptrdiff_t			rowBytes = s.getRowBytes();
+	const int32_t*			weights = mWeights.data();
+
+	// Horizontal, a row at a time
+	forEachRow(h, [&](const int begin, const int end) {
+		std::vector<uint8_t>&	scratch = byte_scratch(static_cast<size_t>(w * inc));
+		for(int y = begin; y < end; ++y) {
+			uint8_t*		row = data + y * rowBytes;
+			std::copy(row, row + w * inc, scratch.begin());
+			const uint8_t*	src = scratch.data();
+			for(int x = 0; x < w; ++x) {
+				for(int c = 0; c < inc; ++c) {
+					int32_t	acc = weights[0] * src[x * inc + c];
+					for(int i = 1; i <= radius; ++i) {
+						const int	l = std::max(0, x - i),
+									r = std::min(w - 1, x + i);
+						acc += weights[i] * (src[l * inc + c] + src[r * inc + c]);
+					}
+					row[x * inc + c] = static_cast<uint8_t>((acc + 32768) >> 16);
+				}
+			}
+		}
+	});
+
+	// Vertical, in strips of columns so each job reads whole cache lines
+	const int				strips = (w + BLUR_STRIP - 1) / BLUR_STRIP;
+	forEachRow(strips, [&](const int begin, const int end) {
+		for(int strip = begin; strip < end; ++strip) {
+			const int		x0 = strip * BLUR_STRIP;
+			const int		bytes = (std::min(w, x0 + BLUR_STRIP) - x0) * inc;
+			std::vector<uint8_t>&	scratch = byte_scratch(static_cast<size_t>(bytes * h));
+			for(int y = 0; y < h; ++y) {
+				const uint8_t*	row = data + y * rowBytes + x0 * inc;
+				std::copy(row, row + bytes, scratch.begin() + y * bytes);
+			}
+			const uint8_t*	src = scratch.data();
+			for(int y = 0; y < h; ++y) {
+				uint8_t*	dst = data + y * rowBytes + x0 * inc;
+				for(int b = 0; b < bytes; ++b) {
+					int32_t	acc = weights[0] * src[y * bytes + b];
+					for(int i = 1; i <= radius; ++i) {
+						const int	t = std::max(0, y - i),
+									u = std::min(h - 1, y + i);
+						acc += weights[i] * (src[t * bytes + b] + src[u * bytes + b]);
+					}
+					dst[b] = static_cast<uint8_t>((acc + 32768) >> 16);
+				}
+			}
+		}
+	});
+
+	if(unpremult) unpremultiply(s);
+}
+
+/**
+ * \class ds::ui::ip::ResizeKernel
+ */
+ResizeKernel::ResizeKernel(const std::string& parameters)
+		: mWidth(static_cast<int>(get_param(parameters, "width", 0.0f)))
+		, mHeight(static_cast<int>(get_param(parameters, "height", 0.0f)))
+		, mLanczos(get_string_param(parameters, "filter") == "lanczos") {
+}
+
+void ResizeKernel::run(ci::Surface8u& s) const {
+	const int				w = s.getWidth(),
+							h = s.getHeight();
+	if(mWidth < 1 && mHeight < 1) return;
+	const float				sx = (mWidth > 0 ? static_cast<float>(mWidth) / static_cast<float>(w) : 1.0f),
+							sy = (mHeight > 0 ? static_cast<float>(mHeight) / static_cast<float>(h) : 1.0f),
+							scale = std::min(sx, sy);
+	if(scale >= 1.0f) return;
+
+	const int				nw = std::max(1, static_cast<int>(static_cast<float>(w) * scale + 0.5f)),
+							nh = std::max(1, static_cast<int>(static_cast<float>(h) * scale + 0.5f));
+	const std::vector<Contribution>	cols = resize_contributions(w, nw, mLanczos),
+									rows = resize_contributions(h, nh, mLanczos);
+
+	const bool				unpremult = premultiply(s);
+	const PixelLayout		layout(s);
+	const int				inc = layout.mPixelInc;
+	const uint8_t*			src = s.getData();
+	const ptrdiff_t			srcRowBytes = s.getRowBytes();
+
+	// Horizontal into a packed buffer of nw x h, then vertical into the new surface
+	std::vector<uint8_t>	tmp(static_cast<size_t>(nw * inc * h));
+	forEachRow(h, [&](const int begin, const int end) {
+		for(int y = begin; y < end; ++y) {
+			const uint8_t*	in = src + y * srcRowBytes;
+			uint8_t*		out = tmp.data() + y * nw * inc;
+			for(int x = 0; x < nw; ++x) {
+				const Contribution&	c = cols[x];
+				for(int ch = 0; ch < inc; ++ch) {
+					float	acc = 0.0f;
+					for(size_t k = 0; k < c.mWeights.size(); ++k) {
+						acc += c.mWeights[k] * static_cast<float>(in[(c.mFirst + static_cast<int>(k)) * inc + ch]);
+					}
+					out[x * inc + ch] = to_byte(acc);
+				}
+			}
+		}
+	});
+
+	ci::Surface8u			dst(nw, nh, s.hasAlpha(), s.getChannelOrder());
+	if(!dst.getData()) {
+		DS_LOG_WARNING("ip::ResizeKernel couldn't allocate a " << nw << "x" << nh << " surface");
+		if(unpremult) unpremultiply(s);
+		return;
+	}
+	const PixelLayout		dstLayout(dst);
+	uint8_t*				dstData = dst.getData();
+	const ptrdiff_t			dstRowBytes = dst.getRowBytes();
+	forEachRow(nh, [&](const int begin, const int end) {
+		for(int y = begin; y < end; ++y) {
+			const Contribution&	c = rows[y];
+			uint8_t*		out = dstData + y * dstRowBytes;
+			for(int b = 0; b < nw * inc; ++b) {
+				float		acc = 0.0f;
+				for(size_t k = 0; k < c.mWeights.size(); ++k) {
+					acc += c.mWeights[k] * static_cast<float>(tmp[(c.mFirst + static_cast<int>(k)) * nw * inc + b]);
+				}
+				out[b] = to_byte(acc);
+			}
+			if(dstLayout.mA >= 0) {
+				// Lanczos can ring past the alpha, which isn't a valid premultiplied colour
+				for(int x = 0; x < nw; ++x) {
+					uint8_t*	p = out + x * inc;
+					const uint8_t	a = p[dstLayout.mA];
+					p[dstLayout.mR] = std::min(p[dstLayout.mR], a);
+					p[dstLayout.mG] = std::min(p[dstLayout.mG], a);
+					p[dstLayout.mB] = std::min(p[dstLayout.mB], a);
+				}
+			}
+			if(unpremult) unpremultiplyRow(dstLayout, out, nw);
+		}
+	});
+
+	dst.setPremultiplied(s.isPremultiplied());
+	s = dst;
+}
+
+std::unique_ptr<Kernel> createKernel(const std::string& name, const std::string& parameters) {
+	if(name == "circle_mask") return std::unique_ptr<Kernel>(new MaskKernel(MaskKernel::CIRCLE, parameters));
+	if(name == "rounded_mask") return std::unique_ptr<Kernel>(new MaskKernel(MaskKernel::ROUNDED_RECT, parameters));
+	if(name == "desaturate") return std::unique_ptr<Kernel>(new DesaturateKernel(parameters));
+	if(name == "blur") return std::unique_ptr<Kernel>(new BlurKernel(parameters));
+	if(name == "resize_to_fit") return std::unique_ptr<Kernel>(new ResizeKernel(parameters));
+	return nullptr;
+}
+
+/**
+ * \class ds::ui::ip::KernelFunction
+ */
+KernelFunction::KernelFunction(const std::string& kernelName)
+		: mKernelName(kernelName) {
+}
+
+void KernelFunction::on(const std::string& parameters, ci::Surface8u& s) const {
+	if(!s.getData()) return;
+	Pipeline				p;
+	p.add(createKernel(mKernelName, parameters));
+	p.run(s);
+}
+
+/**
+ * \class ds::ui::ip::PipelineFunction
+ */
+PipelineFunction::PipelineFunction() {
+}
+
+void PipelineFunction::on(const std::string& parameters, ci::Surface8u& s) const {
+	if(!s.getData()) return;
+	Pipeline				p;
+	const std::vector<std::string>	stages = ds::split(parameters, "|", true);
+	for(auto it : stages) {
+		const std::string	stage = Poco::trim(it);
+		const size_t		open = stage.find('(');
+		const size_t		close = stage.rfind(')');
+		const std::string	name = Poco::trim(stage.substr(0, open));
+		std::string			params;
+		if(open != std::string::npos && close != std::string::npos && close > open) {
+			params = stage.substr(open + 1, close - open - 1);
+		}
+
+		std::unique_ptr<Kernel>	k = createKernel(name, params);
+		if(!k) {
+			DS_LOG_WARNING("ip::PipelineFunction unknown kernel (" << name << ")");
+			continue;
+		}
+		p.add(std::move(k));
+	}
+	p.run(s);
+}
+
+} // namespace ip
+} // namespace ui
+} // namespace ds
@@ -0,0 +1,118 @@
+#pragma once
+#ifndef DS_UI_IP_FUNCTIONS_IPKERNELS_H_
+#define DS_UI_IP_FUNCTIONS_IPKERNELS_H_
+
+#include <string>
+#include <vector>
+#include <ds/ui/ip/ip_function.h>
+#include <ds/ui/ip/ip_kernel.h>
+
+namespace ds {
+namespace ui {
+namespace ip {
+
+/**
+ * \class ds::ui::ip::MaskKernel
+ * Alpha out everything outside a circle or rounded rectangle. A row kernel.
+ * Params: "pad:<pixels>" for both, plus "radius:<pixels>" for the rounded rect.
+ */
+class MaskKernel : public Kernel {
+public:
+	enum Shape { CIRCLE, ROUNDED_RECT };
+	MaskKernel(const Shape, const std::string& parameters);
+
+	virtual void				begin(const ci::Surface8u&);
+	virtual void				row(const PixelLayout&, const int y, const int width, uint8_t* pixels) const;
+
+private:
+	const Shape					mShape;
+	float						mPad, mRadius;
+	// Set in begin()
+	float						mCenX, mCenY, mMaxSq;
+	float						mHalfW, mHalfH;
+};
+
+/**
+ * \class ds::ui::ip::DesaturateKernel
+ * Blend toward Rec. 601 luma. A row kernel. Params: "amount:<0-1>", default 1.
+ */
+class DesaturateKernel : public Kernel {
+public:
+	DesaturateKernel(const std::string& parameters);
+
+	virtual void				row(const PixelLayout&, const int y, const int width, uint8_t* pixels) const;
+
+private:
+	int							mAmount;
+};
+
+/**
+ * \class ds::ui::ip::BlurKernel
+ * Separable gaussian blur, done premultiplied so transparent edges don't go dark.
+ * Params: "sigma:<pixels>", default 2.
+ */
+class BlurKernel : public Kernel {
+public:
+	BlurKernel(const std::string& parameters);
+
+	virtual bool				isRowKernel() const { return false; }
+	virtual void				run(ci::Surface8u&) const;
+
+private:
+	// 16.16 fixed point, centre tap first
+	std::vector<int32_t>		mWeights;
+};
+
+/**
+ * \class ds::ui::ip::ResizeKernel
+ * Shrink to fit inside a box, keeping the aspect ratio. Never enlarges.
+ * Params: "width:<pixels>,height:<pixels>,filter:<box|lanczos>". Box is the default.
+ */
+class ResizeKernel : public Kernel {
+public:
+	ResizeKernel(const std::string& parameters);
+
+	virtual bool				isRowKernel() const { return false; }
+	virtual void				run(ci::Surface8u&) const;
+
+private:
+	int							mWidth, mHeight;
+	bool						mLanczos;
+};
+
+/// Build one of the kernels above by name: circle_mask, rounded_mask, desaturate, blur or resize_to_fit.
+/// Answers nullptr for an unknown name.
+std::unique_ptr<Kernel>			createKernel(const std::string& name, const std::string& parameters);
+
+/**
+ * \class ds::ui::ip::KernelFunction
+ * Run a single built-in kernel as an IP function.
+ */
+class KernelFunction : public Function {
+public:
+	KernelFunction(const std::string& kernelName);
+
+	virtual void				on(const std::string& parameters, ci::Surface8u&) const;
+
+private:
+	const std::string			mKernelName;
+};
+
+/**
+ * \class ds::ui::ip::PipelineFunction
+ * Run a chain of built-in kernels, with no intermediate surfaces between row kernels.
+ * Params are stages separated by |, each a kernel name with its own params in brackets, i.e.
+ * "resize_to_fit(width:512,height:512,filter:lanczos)|desaturate|circle_mask(pad:2)"
+ */
+class PipelineFunction : public Function {
+public:
+	PipelineFunction();
+
+	virtual void				on(const std::string& parameters, ci::Surface8u&) const;
+};
+
+} // namespace ip
+} // namespace ui
+} // namespace ds
+
+#endif
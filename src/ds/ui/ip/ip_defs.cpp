@@ -8,9 +8,19 @@ namespace ip {
 
 namespace {
 const std::string		_CIRCLE_MASK("ds:circle_mask");
+const std::string		_ROUNDED_MASK("ds:rounded_mask");
+const std::string		_DESATURATE("ds:desaturate");
+const std::string		_BLUR("ds:blur");
+const std::string		_RESIZE_TO_FIT("ds:resize_to_fit");
+const std::string		_PIPELINE("ds:pipeline");
 }
 
 const std::string&		CIRCLE_MASK(_CIRCLE_MASK);
+const std::string&		ROUNDED_MASK(_ROUNDED_MASK);
+const std::string&		DESATURATE(_DESATURATE);
+const std::string&		BLUR(_BLUR);
+const std::string&		RESIZE_TO_FIT(_RESIZE_TO_FIT);
+const std::string&		PIPELINE(_PIPELINE);
 
 } // namespace ip
 } // namespace ui
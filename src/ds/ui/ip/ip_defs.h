@@ -12,6 +12,16 @@ namespace ip {
 
 // Make everything outside the largest possible circle transparent.
 extern const std::string&	CIRCLE_MASK;
+// Make everything outside a rounded rectangle transparent. Params: radius:<pixels>,pad:<pixels>
+extern const std::string&	ROUNDED_MASK;
+// Blend toward greyscale. Params: amount:<0-1>
+extern const std::string&	DESATURATE;
+// Gaussian blur. Params: sigma:<pixels>
+extern const std::string&	BLUR;
+// Shrink to fit a box. Params: width:<pixels>,height:<pixels>,filter:<box|lanczos>
+extern const std::string&	RESIZE_TO_FIT;
+// Run several of the above in one go, see ds::ui::ip::PipelineFunction
+extern const std::string&	PIPELINE;
 
 } // namespace ip
 } // namespace ui
@@ -0,0 +1,315 @@
+#include "stdafx.h"
+
+#include "ds/ui/ip/ip_kernel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DS_IP_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace ds {
+namespace ui {
+namespace ip {
+
+namespace {
+// Rows handed out at a time. Small enough to balance, big enough to keep the counter quiet.
+const int					ROW_CHUNK = 16;
+
+/**
+ * A handful of threads shared by every image processing call. Image load
+ * threads each want to split their image up, so only one of them gets the
+ * pool at a time, and everyone else just runs on their own thread.
+ */
+class RowPool {
+public:
+	static RowPool&			get() {
+		static RowPool		POOL;
+		return POOL;
+	}
+
+	RowPool()
+		: mAbort(false)
+		, mJob(nullptr)
+		, mRows(0)
+		, mNextRow(0)
+		, mJobId(0)
+		, mBusyWorkers(0)
+	{
+		const int			n = static_cast<int>(std::thread::hardware_concurrency()) - 1;
+		for(int i = 0; i < n; ++i) {
+			mThreads.push_back(std::thread([this](){ workerLoop(); }));
+		}
+	}
+
+	~RowPool() {
+		{
+			std::lock_guard<std::mutex>	lock(mMutex);
+			mAbort = true;
+		}
+		mWake.notify_all();
+		for(auto& t : mThreads) t.join();
+	}
+
+	void					run(const int rows, const std::function<void(const int, const int)>& fn) {
+		std::unique_lock<std::mutex>	job(mJobMutex, std::try_to_lock);
+		if(mThreads.empty() || rows <= ROW_CHUNK || !job.owns_lock()) {
+			fn(0, rows);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex>	lock(mMutex);
+			mJob = &fn;
+			mRows = rows;
+			mNextRow = 0;
+			mBusyWorkers = static_cast<int>(mThreads.size());
+			++mJobId;
+		}
+		mWake.notify_all();
+
+		work(fn, rows);
+
+		std::unique_lock<std::mutex>	lock(mMutex);
+		mDone.wait(lock, [this](){ return mBusyWorkers == 0; });
+		mJob = nullptr;
+	}
+
+private:
+	void					work(const std::function<void(const int, const int)>& fn, const int rows) {
+		for(int begin = mNextRow.fetch_add(ROW_CHUNK); begin < rows; begin = mNextRow.fetch_add(ROW_CHUNK)) {
+			fn(begin, std::min(rows, begin + ROW_CHUNK));
+		}
+	}
+
+	void					workerLoop() {
+		uint64_t			lastJob = 0;
+		while(true) {
+			const std::function<void(const int, const int)>*	fn = nullptr;
+			int				rows = 0;
+			{
+				std::unique_lock<std::mutex>	lock(mMutex);
+				mWake.wait(lock, [this, lastJob](){ return mAbort || mJobId != lastJob; });
+				if(mAbort) return;
+				lastJob = mJobId;
+				fn = mJob;
+				rows = mRows;
+			}
+
+			if(fn) work(*fn, rows);
+
+			{
+				std::lock_guard<std::mutex>	lock(mMutex);
+				--mBusyWorkers;
+			}
+			mDone.notify_all();
+		}
+	}
+
+	std::mutex				mJobMutex;
+	std::mutex				mMutex;
+	std::condition_variable	mWake;
+	std::condition_variable	mDone;
+	bool					mAbort;
+	const std::function<void(const int, const int)>*
+							mJob;
+	int						mRows;
+	std::atomic<int>		mNextRow;
+	uint64_t				mJobId;
+	int						mBusyWorkers;
+	std::vector<std::thread>
+							mThreads;
+};
+
+// (v + 128 + ((v + 128) >> 8)) >> 8 is v / 255 rounded, for any product of two bytes
+inline uint8_t				mul_div_255(const int c, const int a) {
+	const int				t = c * a + 128;
+	return static_cast<uint8_t>((t + (t >> 8)) >> 8);
+}
+
+// 255 / a in 16.16 fixed point, so unpremultiply doesn't divide
+class UnpremultiplyTable {
+public:
+	UnpremultiplyTable() {
+		mScale[0] = 0;
+		for(int a = 1; a < 256; ++a) mScale[a] = static_cast<uint32_t>((255u * 65536u + a / 2) / a);
+	}
+	uint32_t				mScale[256];
+};
+}
+
+/**
+ * \class ds::ui::ip::PixelLayout
+ */
+PixelLayout::PixelLayout()
+		: mPixelInc(4)
+		, mR(0)
+		, mG(1)
+		, mB(2)
+		, mA(3) {
+}
+
+PixelLayout::PixelLayout(const ci::Surface8u& s)
+		: mPixelInc(static_cast<int>(s.getPixelInc()))
+		, mR(s.getChannelOrder().getRedOffset())
+		, mG(s.getChannelOrder().getGreenOffset())
+		, mB(s.getChannelOrder().getBlueOffset())
+		, mA(s.hasAlpha() ? s.getChannelOrder().getAlphaOffset() : -1) {
+}
+
+/**
+ * \class ds::ui::ip::Kernel
+ */
+Kernel::Kernel() {
+}
+
+Kernel::~Kernel() {
+}
+
+/**
+ * \class ds::ui::ip::Pipeline
+ */
+Pipeline::Pipeline() {
+}
+
+bool Pipeline::empty() const {
+	return mKernels.empty();
+}
+
+void Pipeline::add(std::unique_ptr<Kernel> k) {
+	if(k) mKernels.push_back(std::move(k));
+}
+
+void Pipeline::run(ci::Surface8u& s) const {
+	auto					it = mKernels.begin();
+	while(it != mKernels.end()) {
+		if(!s.getData() || s.getWidth() < 1 || s.getHeight() < 1) return;
+
+		if(!(*it)->isRowKernel()) {
+			(*it)->begin(s);
+			(*it)->run(s);
+			++it;
+			continue;
+		}
+
+		// Gather every row kernel up to the next barrier and run them in one pass
+		std::vector<Kernel*>	fused;
+		for(; it != mKernels.end() && (*it)->isRowKernel(); ++it) {
+			(*it)->begin(s);
+			fused.push_back(it->get());
+		}
+
+		const PixelLayout		layout(s);
+		const int				width = s.getWidth();
+		uint8_t*				data = s.getData();
+		const ptrdiff_t			rowBytes = s.getRowBytes();
+		forEachRow(s.getHeight(), [&](const int begin, const int end) {
+			for(int y = begin; y < end; ++y) {
+				uint8_t*		row = data + y * rowBytes;
+				for(auto k : fused) k->row(layout, y, width, row);
+			}
+		});
+	}
+}
+
+void forEachRow(const int rows, const std::function<void(const int begin, const int end)>& fn) {
+	if(rows < 1) return;
+	RowPool::get().run(rows, fn);
+}
+
+void premultiplyRow(const PixelLayout& layout, uint8_t* pixels, const int count) {
+	if(layout.mA < 0) return;
+	int						x = 0;
+#ifdef DS_IP_SSE2
+	if(layout.mPixelInc == 4) {
+		const __m128i		zero = _mm_setzero_si128();
+		const __m128i		round = _mm_set1_epi16(128);
+		const __m128i		alphaMask = _mm_set1_epi32(0xFF);
+		const __m128i		alphaShift = _mm_cvtsi32_si128(layout.mA * 8);
+		// 16 bit lanes holding the alpha channel itself, which gets multiplied by 255 instead
+		short				lanes[8];
+		for(int i = 0; i < 8; ++i) lanes[i] = ((i % 4) == layout.mA) ? -1 : 0;
+		const __m128i		selfLanes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes));
+		const __m128i		opaque = _mm_and_si128(selfLanes, _mm_set1_epi16(255));
+
+		for(; x + 4 <= count; x += 4) {
+			uint8_t*		p = pixels + x * 4;
+			const __m128i	px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			const __m128i	a32 = _mm_and_si128(_mm_srl_epi32(px, alphaShift), alphaMask);
+			const __m128i	a16 = _mm_or_si128(a32, _mm_slli_epi32(a32, 16));
+
+			__m128i			halves[2];
+			halves[0] = _mm_unpacklo_epi8(px, zero);
+			halves[1] = _mm_unpackhi_epi8(px, zero);
+			__m128i			mults[2];
+			mults[0] = _mm_unpacklo_epi32(a16, a16);
+			mults[1] = _mm_unpackhi_epi32(a16, a16);
+			for(int h = 0; h < 2; ++h) {
+				const __m128i	m = _mm_or_si128(_mm_andnot_si128(selfLanes, mults[h]), opaque);
+				const __m128i	t = _mm_add_epi16(_mm_mullo_epi16(halves[h], m), round);
+				halves[h] = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_packus_epi16(halves[0], halves[1]));
+		}
+	}
+#endif
+	for(; x < count; ++x) {
+		uint8_t*			p = pixels + x * layout.mPixelInc;
+		const int			a = p[layout.mA];
+		p[layout.mR] = mul_div_255(p[layout.mR], a);
+		p[layout.mG] = mul_div_255(p[layout.mG], a);
+		p[layout.mB] = mul_div_255(p[layout.mB], a);
+	}
+}
+
+void unpremultiplyRow(const PixelLayout& layout, uint8_t* pixels, const int count) {
+	if(layout.mA < 0) return;
+	static const UnpremultiplyTable		TABLE;
+	for(int x = 0; x < count; ++x) {
+		uint8_t*			p = pixels + x * layout.mPixelInc;
+		const uint32_t		a = p[layout.mA];
+		if(a == 255 || a == 0) continue;
+		const uint32_t		scale = TABLE.mScale[a];
+		p[layout.mR] = static_cast<uint8_t>(std::min<uint32_t>(255, (p[layout.mR] * scale + 0x8000) >> 16));
+		p[layout.mG] = static_cast<uint8_t>(std::min<uint32_t>(255, (p[layout.mG] * scale + 0x8000) >> 16));
+		p[layout.mB] = static_cast<uint8_t>(std::min<uint32_t>(255, (p[layout.mB] * scale + 0x8000) >> 16));
+	}
+}
+
+void multiplyAlphaRow(const PixelLayout& layout, uint8_t* pixels, const float* coverage, const int count) {
+	if(layout.mA < 0) return;
+	int						x = 0;
+#ifdef DS_IP_SSE2
+	if(layout.mPixelInc == 4) {
+		const __m128i		alphaMask = _mm_set1_epi32(0xFF);
+		const __m128i		alphaShift = _mm_cvtsi32_si128(layout.mA * 8);
+		const __m128i		keepMask = _mm_xor_si128(_mm_sll_epi32(alphaMask, alphaShift), _mm_set1_epi32(-1));
+		const __m128		zero = _mm_setzero_ps(),
+							max = _mm_set1_ps(255.0f);
+		for(; x + 4 <= count; x += 4) {
+			uint8_t*		p = pixels + x * 4;
+			const __m128i	px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			const __m128	a = _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(px, alphaShift), alphaMask));
+			const __m128	v = _mm_min_ps(_mm_max_ps(_mm_mul_ps(a, _mm_loadu_ps(coverage + x)), zero), max);
+			const __m128i	out = _mm_sll_epi32(_mm_cvttps_epi32(v), alphaShift);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_or_si128(_mm_and_si128(px, keepMask), out));
+		}
+	}
+#endif
+	for(; x < count; ++x) {
+		uint8_t*			p = pixels + x * layout.mPixelInc;
+		int32_t				a = static_cast<int32_t>(static_cast<float>(p[layout.mA]) * coverage[x]);
+		if(a < 0) a = 0;
+		else if(a > 255) a = 255;
+		p[layout.mA] = static_cast<uint8_t>(a);
+	}
+}
+
+} // namespace ip
+} // namespace ui
+} // namespace ds
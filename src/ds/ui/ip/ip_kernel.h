@@ -0,0 +1,88 @@
+#pragma once
+#ifndef DS_UI_IP_IPKERNEL_H_
+#define DS_UI_IP_IPKERNEL_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <cinder/Surface.h>
+
+namespace ds {
+namespace ui {
+namespace ip {
+
+/**
+ * \class ds::ui::ip::PixelLayout
+ * Byte offsets of each channel in an 8 bit surface. mA is -1 when there's no alpha.
+ */
+class PixelLayout {
+public:
+	PixelLayout();
+	explicit PixelLayout(const ci::Surface8u&);
+
+	int							mPixelInc;
+	int							mR, mG, mB, mA;
+};
+
+/**
+ * \class ds::ui::ip::Kernel
+ * One stage of image processing. Row kernels only touch the row they're
+ * given, so a chain of them runs fused in a single pass over the image,
+ * with rows split across the worker pool. Kernels that need neighbouring
+ * rows or change the size override isRowKernel() and run() instead.
+ * Kernels are built for a single call, so they can hold per-image state,
+ * but row() is called from several threads at once.
+ */
+class Kernel {
+public:
+	virtual ~Kernel();
+
+	virtual bool				isRowKernel() const { return true; }
+
+	/// Called once before any rows, on the calling thread
+	virtual void				begin(const ci::Surface8u&) {}
+	/// Process width pixels of row y in place
+	virtual void				row(const PixelLayout&, const int y, const int width, uint8_t* pixels) const {}
+	/// Process the whole surface, for kernels that aren't row kernels
+	virtual void				run(ci::Surface8u&) const {}
+
+protected:
+	Kernel();
+};
+
+/**
+ * \class ds::ui::ip::Pipeline
+ * A list of kernels. Runs of row kernels are fused, so no intermediate
+ * surface is created between them.
+ */
+class Pipeline {
+public:
+	Pipeline();
+
+	bool						empty() const;
+	void						add(std::unique_ptr<Kernel>);
+
+	void						run(ci::Surface8u&) const;
+
+private:
+	std::vector<std::unique_ptr<Kernel>>
+								mKernels;
+};
+
+/// Split [0, rows) into chunks and run them on the shared worker pool and the calling thread.
+/// Blocks until every row is done. If the pool is busy with another image, everything runs
+/// on the calling thread instead of waiting.
+void							forEachRow(const int rows, const std::function<void(const int begin, const int end)>&);
+
+/// SIMD helpers (SSE2 when available). All work on count pixels in place.
+void							premultiplyRow(const PixelLayout&, uint8_t* pixels, const int count);
+void							unpremultiplyRow(const PixelLayout&, uint8_t* pixels, const int count);
+/// alpha = alpha * coverage, with coverage in 0-1. Truncates, like the original circle mask.
+void							multiplyAlphaRow(const PixelLayout&, uint8_t* pixels, const float* coverage, const int count);
+
+} // namespace ip
+} // namespace ui
+} // namespace ds
+
+#endif
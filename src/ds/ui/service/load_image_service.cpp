@@ -2,9 +2,11 @@
 
 #include "ds/ui/service/load_image_service.h"
 
+#include <cinder/DataSource.h>
 #include <cinder/ImageIo.h>
 #include "ds/app/environment.h"
 #include "ds/debug/debug_defines.h"
+#include "ds/debug/frame_profiler.h"
 #include "ds/debug/logger.h"
 #include "ds/ui/sprite/image.h"
 #include "Poco/File.h"
@@ -13,6 +15,20 @@ namespace {
 const ds::BitMask	LOAD_IMAGE_LOG_M = ds::Logger::newModule("load_image");
 // A mask of all the image flags that impact the key.
 const int			IMAGE_FLAGS_KEY_MASK(ds::ui::Image::IMG_CACHE_F);
+
+bool				is_url(const std::string& fn) {
+	return fn.compare(0, 7, "http://") == 0 || fn.compare(0, 8, "https://") == 0;
+}
+
+// So cinder knows what decoder to use, without the query or fragment
+std::string			url_extension(const std::string& url) {
+	const size_t	end = url.find_first_of("?#");
+	const std::string	path = url.substr(0, end);
+	const size_t	dot = path.rfind('.'),
+					slash = path.rfind('/');
+	if(dot == std::string::npos || (slash != std::string::npos && dot < slash)) return "";
+	return path.substr(dot + 1);
+}
 }
 
 namespace ds {
@@ -159,7 +175,7 @@ void LoadImageService::advanceQueue(){
 	mOperationsQueue.erase(mOperationsQueue.begin());
 
 	mLoadsInProgress++;
-	mLoadThreads.start([this, oppy](ImageLoadThread& ilt){ ilt.mOutput = oppy; });
+	mLoadThreads.start([this, oppy](ImageLoadThread& ilt){ ilt.mOutput = oppy; ilt.mUrlLoader = mUrlLoader; });
 }
 
 void LoadImageService::release(const ImageKey& key) {
@@ -213,6 +229,7 @@ bool LoadImageService::peekToken(const ImageKey& key, int* flags) const {
 }
 
 void LoadImageService::onLoadComplete(ImageLoadThread& loadThread){
+	DS_PROFILE_ZONE("image_upload");
 
 	mLoadsInProgress--;
 
@@ -277,6 +294,7 @@ LoadImageService::ImageLoadThread::ImageLoadThread(){
 
 }
 void LoadImageService::ImageLoadThread::run(){
+	DS_PROFILE_ZONE("image_decode");
 
 	mError = true;
 	try {
@@ -287,6 +305,22 @@ void LoadImageService::ImageLoadThread::run(){
 		if(!mOutput.mIpFunction.empty())	alpha = boost::tribool(true);
 
 		const std::string					fn = ds::Environment::expand(mOutput.mKey.mFilename);
+
+		std::string							bytes;
+		if(mUrlLoader && is_url(fn)) {
+			if(mUrlLoader(fn, bytes) && !bytes.empty()) {
+				ci::DataSourceRef			src = ci::DataSourceBuffer::create(std::make_shared<ci::Buffer>(&bytes[0], bytes.size()));
+				mOutput.mSurface = ci::Surface8u(ci::loadImage(src, ci::ImageSource::Options(), url_extension(fn)), ci::SurfaceConstraintsDefault(), alpha);
+				if(mOutput.mSurface.getData()) {
+					mOutput.mIpFunction.on(mOutput.mKey.mIpParams, mOutput.mSurface);
+					mError = false;
+				}
+			} else if(mOutput.mNumberTries < 2) {
+				DS_LOG_WARNING_M("LoadImageService::ImageLoadThread::run() failed fetching url: " << mOutput.mKey.mFilename, LOAD_IMAGE_LOG_M);
+			}
+			return;
+		}
+
 		const Poco::File file(fn);
 
 		if(file.exists()) {
@@ -2,6 +2,7 @@
 #ifndef DS_UI_SERVICE_LOADIMAGESERVICE_H_
 #define DS_UI_SERVICE_LOADIMAGESERVICE_H_
 
+#include <functional>
 #include <unordered_map>
 #include <vector>
 #include <cinder/Surface.h>
@@ -116,6 +117,15 @@ public:
 
 	void						clear();
 
+	// Fetches the bytes of an http or https image, called on a load thread. Without one
+	// cinder loads the url itself.
+	typedef std::function<bool(const std::string& url, std::string& outBytes)>	UrlLoader;
+	void						setUrlLoader(const UrlLoader& l) { mUrlLoader = l; }
+
+	// Images held (loaded, loading or failed), and loads waiting for a free thread
+	size_t						getCacheSize() const { return mImageResource.size(); }
+	size_t						getQueueSize() const { return mOperationsQueue.size(); }
+
 private:
 	// store a single image slot
 	struct ImageHolder {
@@ -148,6 +158,7 @@ private:
 
 			virtual void						run();
 			ImageOperation						mOutput;
+			UrlLoader							mUrlLoader;
 			bool								mError;
 	};
 
@@ -165,6 +176,7 @@ private:
 	const int									mMaxLoadTries;
 
 	std::vector<ImageOperation>					mOperationsQueue;
+	UrlLoader									mUrlLoader;
 
 	ds::ParallelRunnable<ImageLoadThread>		mLoadThreads;
 };
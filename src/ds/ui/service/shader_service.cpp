@@ -0,0 +1,209 @@
+#include "stdafx.h"
+
+#include "ds/ui/service/shader_service.h"
+
+#include <unordered_map>
+#include <cinder/gl/gl.h>
+#include "ds/app/environment.h"
+#include "ds/cfg/settings.h"
+#include "ds/debug/debug_defines.h"
+#include "ds/debug/logger.h"
+#include "ds/ui/sprite/sprite_engine.h"
+
+namespace ds {
+namespace ui {
+
+namespace {
+const ds::BitMask		SHADER_SERVICE_LOG = ds::Logger::newModule("shader_service");
+
+// Shared by every engine, like the name-keyed map SpriteShader used to keep. Main thread only.
+std::unordered_map<std::string, ci::gl::GlslProgRef>	PROGRAMS;
+std::unordered_set<std::string>							FAILED;
+// location/name to the text of its files, or an empty source if they couldn't be read
+std::unordered_map<std::string, ShaderSource>			FILES;
+
+ci::gl::GlslProgRef create_program(const ShaderSource& src, std::string& error){
+	try {
+		ci::gl::GlslProg::Format	fmt;
+		fmt.vertex(src.getVert());
+		fmt.fragment(src.getFrag());
+		for(auto& it : src.getDefines()){
+			fmt.define(it);
+		}
+		return ci::gl::GlslProg::create(fmt);
+	} catch(std::exception& e){
+		error = e.what();
+	}
+	return nullptr;
+}
+
+void add_result(const ShaderSource& src, ci::gl::GlslProgRef prog, const std::string& error){
+	if(prog){
+		PROGRAMS[src.getKey()] = prog;
+	} else {
+		FAILED.insert(src.getKey());
+		DS_LOG_WARNING_M("ShaderService couldn't compile " << src.getName() << " (" << src.getKey() << ")\n" << error, SHADER_SERVICE_LOG);
+	}
+}
+
+}
+
+/**
+ * \class ds::ui::ShaderService
+ */
+ShaderService::ShaderService(ds::ui::SpriteEngine& e)
+	: ds::GlThreadClient<ShaderService>(mGlThread)
+	, mEngine(e)
+	, mStarted(false)
+	, mAsync(false)
+{
+}
+
+ShaderService::~ShaderService(){
+	// Anything still queued is dropped, the thread stops when mGlThread goes
+	Poco::Mutex::ScopedLock		l(mMutex);
+	mQueue.clear();
+}
+
+void ShaderService::start(){
+	if(mStarted) return;
+	mStarted = true;
+
+	ds::cfg::Settings&			settings = mEngine.getSettings("engine");
+	mAsync = settings.getBool("shader:async_compile", 0, true);
+	if(mAsync){
+		mGlThread.start(true);
+	}
+
+	const std::string			manifestPath = settings.getString("shader:manifest", 0, "");
+	if(manifestPath.empty()) return;
+
+	const std::string			expanded = ds::Environment::expand(manifestPath);
+	const auto					entries = ShaderManifest::load(expanded);
+	if(entries.empty()){
+		DS_LOG_WARNING_M("ShaderService: nothing to precompile in " << expanded, SHADER_SERVICE_LOG);
+	}
+	for(auto& it : entries){
+		ShaderSource			src;
+		if(!getFileSource(ds::Environment::expand(it.mLocation), it.mName, src)){
+			DS_LOG_WARNING_M("ShaderService: missing manifest shader " << it.mLocation << "/" << it.mName, SHADER_SERVICE_LOG);
+			continue;
+		}
+		src.setDefines(it.mDefines);
+		getProgram(src);
+	}
+}
+
+void ShaderService::update(){
+	if(mPending.empty()) return;
+
+	std::vector<std::pair<std::string, std::pair<ci::gl::GlslProgRef, std::string>>>	done;
+	{
+		Poco::Mutex::ScopedLock		l(mMutex);
+		if(mDone.empty()) return;
+		done.swap(mDone);
+	}
+
+	for(auto& it : done){
+		mPending.erase(it.first);
+		if(it.second.first){
+			PROGRAMS[it.first] = it.second.first;
+		} else {
+			FAILED.insert(it.first);
+			DS_LOG_WARNING_M("ShaderService couldn't compile " << it.first << "\n" << it.second.second, SHADER_SERVICE_LOG);
+		}
+	}
+}
+
+ci::gl::GlslProgRef ShaderService::getProgram(const ShaderSource& src){
+	if(src.empty()) return nullptr;
+
+	auto found = PROGRAMS.find(src.getKey());
+	if(found != PROGRAMS.end()) return found->second;
+	if(FAILED.find(src.getKey()) != FAILED.end()) return nullptr;
+	if(mPending.find(src.getKey()) != mPending.end()) return nullptr;
+
+	if(mStarted && mAsync){
+		mPending.insert(src.getKey());
+		{
+			Poco::Mutex::ScopedLock		l(mMutex);
+			mQueue.push_back(src);
+		}
+		if(performOnWorkerThread(&ShaderService::compileQueued, true)) return nullptr;
+
+		// No GL thread after all, so compile everything here from now on
+		DS_LOG_WARNING_M("ShaderService: no compile thread, compiling on the main thread", SHADER_SERVICE_LOG);
+		mAsync = false;
+		mPending.erase(src.getKey());
+		Poco::Mutex::ScopedLock		l(mMutex);
+		mQueue.clear();
+	}
+
+	return compile(src);
+}
+
+bool ShaderService::isPending(const ShaderSource& src) const {
+	return mPending.find(src.getKey()) != mPending.end();
+}
+
+void ShaderService::compileQueued(){
+	std::vector<ShaderSource>		todo;
+	{
+		Poco::Mutex::ScopedLock		l(mMutex);
+		todo.swap(mQueue);
+	}
+	if(todo.empty()) return;
+
+	std::vector<std::pair<std::string, std::pair<ci::gl::GlslProgRef, std::string>>>	done;
+	for(auto& it : todo){
+		std::string					error;
+		ci::gl::GlslProgRef			prog = create_program(it, error);
+		if(!prog) error = it.getName() + ": " + error;
+		done.push_back(std::make_pair(it.getKey(), std::make_pair(prog, error)));
+	}
+
+	// The programs get used from the app's context, make sure the driver is done with them first
+	glFinish();
+	DS_REPORT_GL_ERRORS();
+
+	Poco::Mutex::ScopedLock			l(mMutex);
+	mDone.insert(mDone.end(), done.begin(), done.end());
+}
+
+ci::gl::GlslProgRef ShaderService::compile(const ShaderSource& src){
+	if(src.empty()) return nullptr;
+
+	auto found = PROGRAMS.find(src.getKey());
+	if(found != PROGRAMS.end()) return found->second;
+	if(FAILED.find(src.getKey()) != FAILED.end()) return nullptr;
+
+	std::string						error;
+	ci::gl::GlslProgRef				prog = create_program(src, error);
+	add_result(src, prog, error);
+	return prog;
+}
+
+bool ShaderService::getFileSource(const std::string& location, const std::string& name, ShaderSource& out){
+	const std::string				path = location + "/" + name;
+	auto found = FILES.find(path);
+	if(found == FILES.end()){
+		ShaderSource				src;
+		if(!src.loadFiles(location, name)){
+			src = ShaderSource();
+		}
+		found = FILES.insert(std::make_pair(path, src)).first;
+	}
+
+	if(found->second.empty()) return false;
+	out = found->second;
+	return true;
+}
+
+void ShaderService::clearCache(){
+	PROGRAMS.clear();
+	FAILED.clear();
+	FILES.clear();
+}
+
+} // namespace ui
+} // namespace ds
@@ -0,0 +1,83 @@
+#pragma once
+#ifndef DS_UI_SERVICE_SHADERSERVICE_H_
+#define DS_UI_SERVICE_SHADERSERVICE_H_
+
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <Poco/Mutex.h>
+#include <cinder/gl/GlslProg.h>
+#include "ds/thread/gl_thread.h"
+#include "ds/ui/sprite/shader/shader_source.h"
+
+namespace ds {
+namespace ui {
+class SpriteEngine;
+
+/**
+ * \class ds::ui::ShaderService
+ * \brief Compiles shader programs and caches them by ShaderSource key, so a program is
+ * only ever compiled once per process no matter how many sprites use it.
+ *
+ * With shader:async_compile on, programs are compiled on a GL thread with a context
+ * shared with the app's, and getProgram() answers nullptr until they're done; SpriteShader
+ * draws with the default shader in the meantime. Anything listed in the shader:manifest
+ * file is queued as soon as the service starts, so it's usually ready before it's drawn.
+ *
+ * The cache is shared by every engine in the process. Without an engine, compile()
+ * works like the service with async compiling off.
+ */
+class ShaderService : public ds::GlThreadClient<ShaderService> {
+public:
+	ShaderService(ds::ui::SpriteEngine&);
+	~ShaderService();
+
+	/// Starts the compile thread and queues the manifest. Needs the app's GL context, so it's
+	/// called from the engine's setup. Until then everything compiles immediately.
+	void								start();
+	/// Moves finished programs into the cache. Main thread, every frame.
+	void								update();
+
+	/// The compiled program, or nullptr if it's still compiling or failed to compile.
+	/// Anything that isn't compiled or queued yet gets queued, or compiled right here
+	/// when async compiling is off.
+	ci::gl::GlslProgRef					getProgram(const ShaderSource&);
+	/// True while a program is queued or compiling on the GL thread
+	bool								isPending(const ShaderSource&) const;
+	size_t								getPendingCount() const { return mPending.size(); }
+
+	/// Compiles on this thread if it isn't cached. nullptr if it doesn't compile.
+	static ci::gl::GlslProgRef			compile(const ShaderSource&);
+	/// The shader files at location/name, read once and kept until clearCache(). False if they don't exist.
+	static bool							getFileSource(const std::string& location, const std::string& name, ShaderSource&);
+	/// Forget every compiled program, failure and file read, so edited shaders get picked up
+	static void							clearCache();
+
+private:
+	// GL thread
+	void								compileQueued();
+	void								queue(const ShaderSource&);
+
+	ds::ui::SpriteEngine&				mEngine;
+	bool								mStarted;
+	bool								mAsync;
+
+	// Keys queued or compiling. Main thread only.
+	std::unordered_set<std::string>		mPending;
+
+	// Shared with the GL thread
+	Poco::Mutex							mMutex;
+	std::vector<ShaderSource>			mQueue;
+	// Key, program (nullptr if it failed) and any error
+	std::vector<std::pair<std::string, std::pair<ci::gl::GlslProgRef, std::string>>>
+										mDone;
+
+	// Last, so it stops before anything it uses goes away
+	ds::GlThread						mGlThread;
+};
+
+} // namespace ui
+} // namespace ds
+
+#endif // DS_UI_SERVICE_SHADERSERVICE_H_
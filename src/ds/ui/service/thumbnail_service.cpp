@@ -0,0 +1,471 @@
+#include "stdafx.h"
+
+#include "ds/ui/service/thumbnail_service.h"
+
+#include <algorithm>
+#include <sstream>
+#include <cinder/ImageIo.h>
+#include <cinder/ip/Resize.h>
+#include <Poco/DirectoryIterator.h>
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include "ds/app/environment.h"
+#include "ds/cfg/settings.h"
+#include "ds/debug/debug_defines.h"
+#include "ds/debug/frame_profiler.h"
+#include "ds/debug/logger.h"
+#include "ds/ui/sprite/sprite_engine.h"
+#include "ds/util/fnv_hash.h"
+#include "ds/util/image_meta_data.h"
+#include "ds/util/scaled_jpeg.h"
+#include "ds/util/string_util.h"
+
+namespace ds {
+namespace ui {
+
+namespace {
+const ds::BitMask	THUMBNAIL_LOG_M = ds::Logger::newModule("thumbnail");
+// A source is stat'ed again after this long, so an edited file gets new levels
+const Poco::Timestamp::TimeDiff	SOURCE_RECHECK = 10 * Poco::Timestamp::resolution();
+
+// The key for an (expanded) source, or empty if it doesn't exist. Touches the disk.
+std::string			key_for(const std::string& expandedSource) {
+	try {
+		const Poco::File	f(expandedSource);
+		if(!f.exists() || !f.isFile()) return "";
+
+		std::stringstream	ss;
+		ss << expandedSource << "|" << f.getLastModified().epochMicroseconds() << "|" << f.getSize();
+		return ds::fnv_hash_string(ss.str());
+	} catch(std::exception const&) {
+	}
+	return "";
+}
+
+int					long_edge(const ci::Surface8u& s) {
+	return std::max(s.getWidth(), s.getHeight());
+}
+
+// Average every 2x2 block. Much cheaper than a general resize, and good enough
+// for getting most of the way down before the final resize.
+ci::Surface8u		half_size(const ci::Surface8u& src) {
+	const int		w = src.getWidth() / 2,
+					h = src.getHeight() / 2;
+	ci::Surface8u	dst(w, h, src.hasAlpha(), src.getChannelOrder());
+	const int		inc = src.getPixelInc();
+	const int32_t	srcRow = src.getRowBytes();
+	for(int y = 0; y < h; ++y) {
+		const uint8_t*	r0 = src.getData() + (2 * y) * srcRow;
+		const uint8_t*	r1 = r0 + srcRow;
+		uint8_t*		d = dst.getData() + y * dst.getRowBytes();
+		for(int x = 0; x < w; ++x) {
+			const int	a = 2 * x * inc,
+						b = a + inc;
+			for(int c = 0; c < inc; ++c) {
+				d[x * inc + c] = static_cast<uint8_t>((r0[a + c] + r0[b + c] + r1[a + c] + r1[b + c] + 2) >> 2);
+			}
+		}
+	}
+	return dst;
+}
+
+// Shrink so the long edge is edge pixels. Never enlarges.
+ci::Surface8u		scale_to(ci::Surface8u s, const int edge) {
+	while(long_edge(s) / 2 >= edge) {
+		s = half_size(s);
+	}
+	const int		current = long_edge(s);
+	if(current <= edge) return s;
+
+	const float		scale = static_cast<float>(edge) / static_cast<float>(current);
+	const ci::ivec2	size(std::max(1, static_cast<int>(s.getWidth() * scale + 0.5f)),
+						 std::max(1, static_cast<int>(s.getHeight() * scale + 0.5f)));
+	return ci::ip::resize(s, s.getBounds(), size);
+}
+}
+
+/**
+ * \class ds::ui::ThumbnailService
+ */
+ThumbnailService::ThumbnailService(ds::ui::SpriteEngine& eng)
+		: mEngine(eng)
+		, mInitialized(false)
+		, mEnabled(false)
+		, mBudget(0)
+		, mQuality(0.85f)
+		, mMaxSimultaneous(2)
+		, mCacheBytes(0)
+		, mNextId(1)
+		, mInProgress(0)
+		, mGenerators(eng) {
+	mGenerators.setReplyHandler([this](Generator& g){ onGenerated(g); });
+}
+
+bool ThumbnailService::isEnabled() {
+	init();
+	return mEnabled;
+}
+
+const std::vector<int>& ThumbnailService::getLevels() {
+	init();
+	return mLevels;
+}
+
+int ThumbnailService::getLevelFor(const float displaySize) {
+	init();
+	for(auto it = mLevels.begin(), end = mLevels.end(); it != end; ++it) {
+		if(static_cast<float>(*it) >= displaySize) return *it;
+	}
+	return 0;
+}
+
+std::string ThumbnailService::find(const std::string& source, const float displaySize) {
+	init();
+	const int			level = getLevelFor(displaySize);
+	if(!mEnabled || level < 1) return source;
+	return lookup(source, ds::Environment::expand(source), level);
+}
+
+ThumbnailService::RequestId ThumbnailService::request(const std::string& source, const float displaySize, const Callback& cb) {
+	init();
+	const int			level = getLevelFor(displaySize);
+	const std::string	expanded = ds::Environment::expand(source);
+	const std::string	found = (mEnabled && level > 0 ? lookup(source, expanded, level) : source);
+	if(!found.empty()) {
+		if(cb) cb(found);
+		return 0;
+	}
+
+	Waiter				w;
+	w.mId = mNextId++;
+	w.mLevel = level;
+	w.mSource = source;
+	w.mCallback = cb;
+
+	auto				waiting = mWaiting.find(expanded);
+	if(waiting != mWaiting.end()) {
+		waiting->second.push_back(w);
+	} else {
+		mWaiting[expanded].push_back(w);
+		queue(expanded);
+	}
+	return w.mId;
+}
+
+void ThumbnailService::cancel(const RequestId id) {
+	if(id == 0) return;
+	for(auto it = mWaiting.begin(), end = mWaiting.end(); it != end; ++it) {
+		std::vector<Waiter>&	waiters = it->second;
+		for(auto w = waiters.begin(), wend = waiters.end(); w != wend; ++w) {
+			if(w->mId == id) {
+				// Leave the source waiting, even with no callbacks, so it isn't queued twice
+				waiters.erase(w);
+				return;
+			}
+		}
+	}
+}
+
+uint64_t ThumbnailService::getCacheBytes() {
+	init();
+	return mCacheBytes;
+}
+
+void ThumbnailService::init() {
+	if(mInitialized) return;
+	mInitialized = true;
+
+	ds::cfg::Settings&		settings = mEngine.getSettings("engine");
+	mEnabled = settings.getBool("thumbnail:generate", 0, false);
+
+	mLevels.clear();
+	ds::tokenize(settings.getString("thumbnail:levels", 0, "128, 256, 512, 1024"), ',', [this](const std::string& s) {
+		const int			level = ds::string_to_int(s);
+		if(level > 0) mLevels.push_back(level);
+	});
+	std::sort(mLevels.begin(), mLevels.end());
+	mLevels.erase(std::unique(mLevels.begin(), mLevels.end()), mLevels.end());
+
+	mBudget = static_cast<uint64_t>(std::max(0, settings.getInt("thumbnail:cache_budget_mb", 0, 1024))) * 1024 * 1024;
+	mQuality = settings.getFloat("thumbnail:quality", 0, mQuality);
+	mMaxSimultaneous = std::max(1, settings.getInt("thumbnail:max_simultaneous", 0, mMaxSimultaneous));
+
+	if(!mEnabled) return;
+
+	try {
+		Poco::Path			p(ds::Environment::expand(settings.getString("thumbnail:cache_folder", 0, "%LOCAL%/cache/thumbnails")));
+		p.makeDirectory();
+		Poco::File			dir(p.toString());
+		if(!dir.exists()) dir.createDirectories();
+		mFolder = p.toString();
+	} catch(std::exception const& ex) {
+		DS_LOG_WARNING_M("ThumbnailService could not create the cache folder, thumbnails are off. error=" << ex.what(), THUMBNAIL_LOG_M);
+		mEnabled = false;
+		return;
+	}
+
+	scanCache();
+	enforceBudget("");
+}
+
+void ThumbnailService::scanCache() {
+	// Files are <key>_<level>.<ext>. Leftover .tmp files are from a run that quit mid-write.
+	try {
+		Poco::DirectoryIterator		end;
+		for(Poco::DirectoryIterator it(mFolder); it != end; ++it) {
+			if(!it->isFile()) continue;
+			const std::string		name = it.name();
+			if(name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0) {
+				it->remove();
+				continue;
+			}
+			const size_t			underscore = name.find('_'),
+									dot = name.rfind('.');
+			if(underscore == std::string::npos || dot == std::string::npos || dot < underscore) continue;
+			const int				level = ds::string_to_int(name.substr(underscore + 1, dot - underscore - 1));
+			if(level < 1) continue;
+
+			Entry&					e = mEntries[name.substr(0, underscore)];
+			File&					file = e.mFiles[level];
+			file.mPath = it->path();
+			file.mBytes = static_cast<uint64_t>(it->getSize());
+			e.mBytes += file.mBytes;
+			mCacheBytes += file.mBytes;
+			e.mLastUse = std::max(e.mLastUse, it->getLastModified());
+		}
+	} catch(std::exception const& ex) {
+		DS_LOG_WARNING_M("ThumbnailService error scanning the cache folder error=" << ex.what(), THUMBNAIL_LOG_M);
+	}
+	DS_LOG_INFO_M("ThumbnailService cache has " << mEntries.size() << " sources, " << (mCacheBytes / (1024 * 1024)) << "MB", THUMBNAIL_LOG_M);
+}
+
+std::string ThumbnailService::lookup(const std::string& source, const std::string& expandedSource, const int level) {
+	auto					s = mSources.find(expandedSource);
+	if(s == mSources.end() || s->second.mChecked.isElapsed(SOURCE_RECHECK)) return "";
+	// No level is made for sources that are already small enough
+	if(s->second.mEdge > 0 && s->second.mEdge <= level) return source;
+
+	auto					found = mEntries.find(s->second.mKey);
+	if(found != mEntries.end()) {
+		Entry&				e = found->second;
+		auto				file = e.mFiles.find(level);
+		if(file != e.mFiles.end()) {
+			e.mLastUse.update();
+			return file->second.mPath;
+		}
+		if(e.mSourceEdge > 0 && e.mSourceEdge <= level) return source;
+	}
+	return "";
+}
+
+void ThumbnailService::queue(const std::string& expandedSource) {
+	auto					s = mSources.find(expandedSource);
+	const bool				known = (s != mSources.end() && !s->second.mChecked.isElapsed(SOURCE_RECHECK));
+	mQueue.push_back(std::make_pair(expandedSource, known ? s->second.mKey : std::string()));
+	advanceQueue();
+}
+
+void ThumbnailService::advanceQueue() {
+	while(mInProgress < mMaxSimultaneous && !mQueue.empty()) {
+		const std::pair<std::string, std::string>	next = mQueue.front();
+		mQueue.pop_front();
+
+		++mInProgress;
+		const bool			started = mGenerators.start([this, &next](Generator& g) {
+			g.mSource = next.first;
+			g.mKey = next.second;
+			g.mDecode = !next.second.empty();
+			g.mFolder = mFolder;
+			g.mLevels = mLevels;
+			g.mQuality = mQuality;
+		});
+		if(!started) {
+			--mInProgress;
+			Generator		failed;
+			failed.mSource = next.first;
+			failed.mKey = next.second;
+			failed.mDecode = !next.second.empty();
+			failed.mErrorMessage = "no worker available";
+			onGenerated(failed);
+		}
+	}
+}
+
+void ThumbnailService::onGenerated(Generator& g) {
+	DS_PROFILE_ZONE("thumbnail_generated");
+	if(mInProgress > 0) --mInProgress;
+
+	if(!g.mKey.empty()) {
+		Source&				s = mSources[g.mSource];
+		s.mKey = g.mKey;
+		if(g.mSourceEdge > 0) s.mEdge = g.mSourceEdge;
+		s.mChecked.update();
+	}
+
+	if(g.mError) {
+		DS_LOG_WARNING_M("ThumbnailService couldn't make levels for " << g.mSource << " error=" << g.mErrorMessage, THUMBNAIL_LOG_M);
+	} else if(g.mDecode) {
+		Entry&				e = mEntries[g.mKey];
+		e.mSourceEdge = g.mSourceEdge;
+		e.mLastUse.update();
+		for(auto it = g.mFiles.begin(), end = g.mFiles.end(); it != end; ++it) {
+			// A level made again replaces the one that was counted
+			auto			old = e.mFiles.find(it->first);
+			if(old != e.mFiles.end()) {
+				if(old->second.mPath != it->second.mPath) {
+					try {
+						Poco::File(old->second.mPath).remove();
+					} catch(std::exception const&) {
+					}
+				}
+				e.mBytes -= std::min(e.mBytes, old->second.mBytes);
+				mCacheBytes -= std::min(mCacheBytes, old->second.mBytes);
+			}
+			e.mFiles[it->first] = it->second;
+			e.mBytes += it->second.mBytes;
+			mCacheBytes += it->second.mBytes;
+		}
+	}
+
+	std::vector<Waiter>		waiters;
+	auto					waiting = mWaiting.find(g.mSource);
+	if(waiting != mWaiting.end()) {
+		waiters.swap(waiting->second);
+		mWaiting.erase(waiting);
+	}
+
+	enforceBudget(g.mKey);
+	g.mFiles.clear();
+
+	// Sort out every answer before any callback runs, they're free to make new requests.
+	// After a look up, whoever still needs a level waits for it to be made.
+	std::vector<std::pair<Callback, std::string>>	answers;
+	std::vector<Waiter>		remaining;
+	for(auto it = waiters.begin(), end = waiters.end(); it != end; ++it) {
+		std::string			path = lookup(it->mSource, g.mSource, it->mLevel);
+		if(path.empty() && !g.mDecode && !g.mError) {
+			remaining.push_back(*it);
+			continue;
+		}
+		if(path.empty()) path = it->mSource;
+		answers.push_back(std::make_pair(it->mCallback, path));
+	}
+	if(!remaining.empty()) {
+		mWaiting[g.mSource].swap(remaining);
+		queue(g.mSource);
+	}
+
+	for(auto it = answers.begin(), end = answers.end(); it != end; ++it) {
+		if(it->first) it->first(it->second);
+	}
+
+	advanceQueue();
+}
+
+void ThumbnailService::enforceBudget(const std::string& keep) {
+	if(mBudget < 1) return;
+
+	while(mCacheBytes > mBudget && !mEntries.empty()) {
+		auto				oldest = mEntries.end();
+		for(auto it = mEntries.begin(), end = mEntries.end(); it != end; ++it) {
+			if(it->first == keep) continue;
+			if(oldest == mEntries.end() || it->second.mLastUse < oldest->second.mLastUse) oldest = it;
+		}
+		if(oldest == mEntries.end()) return;
+
+		for(auto it = oldest->second.mFiles.begin(), end = oldest->second.mFiles.end(); it != end; ++it) {
+			try {
+				Poco::File(it->second.mPath).remove();
+			} catch(std::exception const&) {
+			}
+		}
+		mCacheBytes -= std::min(mCacheBytes, oldest->second.mBytes);
+		mEntries.erase(oldest);
+	}
+}
+
+/**
+ * \class ds::ui::ThumbnailService::Entry
+ */
+ThumbnailService::Entry::Entry()
+		: mBytes(0)
+		, mLastUse(0)
+		, mSourceEdge(0) {
+}
+
+/**
+ * \class ds::ui::ThumbnailService::Generator
+ */
+ThumbnailService::Generator::Generator()
+		: mDecode(false)
+		, mQuality(0.85f)
+		, mError(true)
+		, mSourceEdge(0) {
+}
+
+void ThumbnailService::Generator::run() {
+	DS_PROFILE_ZONE("thumbnail_generate");
+
+	mError = true;
+	mErrorMessage.clear();
+	mSourceEdge = 0;
+	mFiles.clear();
+
+	if(!mDecode) {
+		mKey = key_for(mSource);
+		if(mKey.empty()) {
+			mErrorMessage = "missing";
+			return;
+		}
+		// The header is enough to tell if the source is smaller than a level
+		const ImageMetaData			meta(mSource);
+		if(!meta.empty()) mSourceEdge = static_cast<int>(std::max(meta.mSize.x, meta.mSize.y));
+		mError = false;
+		return;
+	}
+
+	try {
+		// One decode, at no more than the biggest level needs, then every level is made
+		// from the one above it
+		ci::Surface8u				surface;
+		ci::ivec2					fullSize;
+		if(mLevels.empty() || !load_scaled_jpeg(mSource, mLevels.back(), surface, &fullSize)) {
+			surface = ci::Surface8u(ci::loadImage(mSource));
+			fullSize = surface.getSize();
+		}
+		if(!surface.getData()) {
+			mErrorMessage = "decode failed";
+			return;
+		}
+		mSourceEdge = std::max(fullSize.x, fullSize.y);
+
+		// Keep alpha if there is any, jpeg is smaller and faster otherwise
+		const std::string			ext = (surface.hasAlpha() ? "png" : "jpg");
+		for(auto it = mLevels.rbegin(), end = mLevels.rend(); it != end; ++it) {
+			const int				level = *it;
+			if(level >= mSourceEdge) continue;
+
+			surface = scale_to(surface, level);
+
+			std::stringstream		ss;
+			ss << mFolder << mKey << "_" << level << "." << ext;
+			const std::string		path = ss.str();
+			// Written under another name first, so a half-written file is never picked up
+			const std::string		tmp = path + ".tmp";
+			ci::writeImage(tmp, surface, ci::ImageTarget::Options().quality(mQuality), ext);
+			Poco::File				f(tmp);
+			f.renameTo(path);
+
+			File					file;
+			file.mPath = path;
+			file.mBytes = static_cast<uint64_t>(f.getSize());
+			mFiles.push_back(std::make_pair(level, file));
+		}
+		mError = false;
+	} catch(std::exception const& ex) {
+		mErrorMessage = ex.what();
+	}
+}
+
+} // namespace ui
+} // namespace ds
@@ -0,0 +1,170 @@
+#pragma once
+#ifndef DS_UI_SERVICE_THUMBNAILSERVICE_H_
+#define DS_UI_SERVICE_THUMBNAILSERVICE_H_
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <Poco/Runnable.h>
+#include <Poco/Timestamp.h>
+#include "ds/thread/parallel_runnable.h"
+
+namespace ds {
+namespace ui {
+class SpriteEngine;
+
+/**
+ * \class ds::ui::ThumbnailService
+ * \brief Makes and keeps a small pyramid of downscaled copies of image files
+ * (128, 256, 512 and 1024 pixels on the long edge by default), so a sprite showing
+ * a large image small can load a small file instead of decoding the whole thing.
+ *
+ * Each source is decoded once on a worker thread and every level is made from the
+ * one above it. JPEGs are decoded straight to the smallest power of two fraction that still
+ * covers the biggest level. Levels are written to a disk cache keyed by the source's path,
+ * modified time and size, so an edited file gets new levels and old ones age out. The cache
+ * is kept under thumbnail:cache_budget_mb by deleting the least recently used sources.
+ *
+ * The main thread never touches the source file. Its key and size are looked up on a worker
+ * too, and looked up again once they're a few seconds old.
+ *
+ * Answers are file paths, which load through the LoadImageService like any other image.
+ * Nothing is generated unless thumbnail:generate is on.
+ */
+class ThumbnailService {
+public:
+	typedef int						RequestId;
+	typedef std::function<void(const std::string& path)>
+									Callback;
+
+	ThumbnailService(ds::ui::SpriteEngine&);
+
+	/// Off until thumbnail:generate is set. When off, find() and request() answer the source.
+	bool							isEnabled();
+
+	/// The level sizes, smallest first
+	const std::vector<int>&			getLevels();
+	/// The smallest level at least displaySize pixels, or 0 if displaySize is bigger than every level
+	int								getLevelFor(const float displaySize);
+
+	/// The file to show source at displaySize pixels on its long edge: the smallest cached level
+	/// at least that big, or the source itself when it's no bigger than that level. Answers
+	/// empty when the level still has to be made, or when the source hasn't been looked up
+	/// lately. Never starts any work.
+	std::string						find(const std::string& source, const float displaySize);
+
+	/// Like find(), but makes the level if it has to. The callback gets the path, immediately
+	/// if it's already known (and 0 is answered), otherwise on the main thread once it's on disk.
+	/// If the level can't be made the callback gets the source.
+	RequestId						request(const std::string& source, const float displaySize, const Callback&);
+	/// Drop a callback that hasn't run yet. The level is still made.
+	void							cancel(const RequestId);
+
+	/// Bytes of levels in the cache folder
+	uint64_t						getCacheBytes();
+
+private:
+	class File {
+	public:
+		File() : mBytes(0) {}
+		std::string					mPath;
+		uint64_t					mBytes;
+	};
+
+	class Entry {
+	public:
+		Entry();
+		// Level size to file
+		std::map<int, File>			mFiles;
+		uint64_t					mBytes;
+		Poco::Timestamp				mLastUse;
+		// The source's long edge, once a generation has told us
+		int							mSourceEdge;
+	};
+
+	// What a worker found out about a source file
+	class Source {
+	public:
+		Source() : mEdge(0), mChecked(0) {}
+		std::string					mKey;
+		// Long edge, or 0 if the header didn't say
+		int							mEdge;
+		Poco::Timestamp				mChecked;
+	};
+
+	class Waiter {
+	public:
+		RequestId					mId;
+		int							mLevel;
+		std::string					mSource;
+		Callback					mCallback;
+	};
+
+	class Generator : public Poco::Runnable {
+	public:
+		Generator();
+		virtual void				run();
+
+		// Input. Without decode it only finds the key and size.
+		std::string					mSource;
+		bool						mDecode;
+		std::string					mKey;
+		std::string					mFolder;
+		std::vector<int>			mLevels;
+		float						mQuality;
+		// Output, and mKey
+		bool						mError;
+		std::string					mErrorMessage;
+		int							mSourceEdge;
+		std::vector<std::pair<int, File>>
+									mFiles;
+	};
+
+	void							init();
+	void							scanCache();
+	// Answer the cached level, the source, or empty if the level has to be made or the
+	// source looked up first
+	std::string						lookup(const std::string& source, const std::string& expandedSource, const int level);
+	// Queue a look up, or a generation if the source's key is known
+	void							queue(const std::string& expandedSource);
+	void							advanceQueue();
+	void							onGenerated(Generator&);
+	void							enforceBudget(const std::string& keep);
+
+	ds::ui::SpriteEngine&			mEngine;
+	bool							mInitialized;
+	bool							mEnabled;
+	std::vector<int>				mLevels;
+	std::string						mFolder;
+	uint64_t						mBudget;
+	float							mQuality;
+	int								mMaxSimultaneous;
+
+	std::unordered_map<std::string, Entry>
+									mEntries;
+	uint64_t						mCacheBytes;
+	// By expanded source
+	std::unordered_map<std::string, Source>
+									mSources;
+
+	// Expanded sources waiting for a generator, with their key if it's known, and the
+	// callbacks waiting on each source
+	std::deque<std::pair<std::string, std::string>>
+									mQueue;
+	std::unordered_map<std::string, std::vector<Waiter>>
+									mWaiting;
+	RequestId						mNextId;
+	int								mInProgress;
+
+	ds::ParallelRunnable<Generator>	mGenerators;
+};
+
+} // namespace ui
+} // namespace ds
+
+#endif // DS_UI_SERVICE_THUMBNAILSERVICE_H_
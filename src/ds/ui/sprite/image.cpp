@@ -3,6 +3,7 @@
 #include "image.h"
 
 #include <map>
+#include <typeinfo>
 
 #include <cinder/ImageIo.h>
 
@@ -219,6 +220,19 @@ void Image::drawLocalClient(){
 	}
 }
 
+bool Image::getDrawListQuad(ci::Rectf& localRect, ci::gl::TextureRef& texture){
+	// Subclasses may draw more than the texture
+	if (typeid(*this) != typeid(Image) || mCircleCropped) return false;
+
+	localRect = ci::Rectf::zero();
+	texture = nullptr;
+	if (inBounds() && isLoaded()){
+		texture = mImageSource.getImage();
+		if (texture) localRect = mDrawRect.mOrthoRect;
+	}
+	return true;
+}
+
 void Image::setSizeAll( float width, float height, float depth ){
 	setScale( width / getWidth(), height / getHeight() );
 }
@@ -81,6 +81,7 @@ protected:
 	void						onUpdateServer(const UpdateParams&) override;
 	void						onUpdateClient(const UpdateParams&) override;
 	void						drawLocalClient() override;
+	bool						getDrawListQuad(ci::Rectf&, ci::gl::TextureRef&) override;
 	void						writeAttributesTo(ds::DataBuffer&) override;
 	void						readAttributeFrom(const char attributeId, ds::DataBuffer&) override;
 
@@ -2,7 +2,10 @@
 
 #include "image_with_thumbnail.h"
 
+#include <algorithm>
+
 #include "ds/ui/sprite/sprite_engine.h"
+#include "ds/util/image_meta_data.h"
 
 namespace ds {
 namespace ui {
@@ -13,6 +16,12 @@ ImageWithThumbnail::ImageWithThumbnail(SpriteEngine& engine, const int flags, fl
 	: inherited(engine, flags)
 	, mThumbnail(nullptr)
 	, mFadeDuration(fadeDuration)
+	, mThumbnailRequest(0)
+	, mUseLevels(false)
+	, mLevelFlags(0)
+	, mLevel(-1)
+	, mLevelRequest(0)
+	, mLevelCheck(false)
 {
 	mLayoutFixedAspect = true;
 }
@@ -21,6 +30,12 @@ ImageWithThumbnail::ImageWithThumbnail(SpriteEngine& engine, const std::string&
 	: inherited(engine, filename, flags)
 	, mThumbnail(nullptr)
 	, mFadeDuration(fadeDuration)
+	, mThumbnailRequest(0)
+	, mUseLevels(false)
+	, mLevelFlags(0)
+	, mLevel(-1)
+	, mLevelRequest(0)
+	, mLevelCheck(false)
 {
 	mLayoutFixedAspect = true;
 }
@@ -29,6 +44,12 @@ ImageWithThumbnail::ImageWithThumbnail(SpriteEngine& engine, const ds::Resource:
 	: inherited(engine, resourceId, flags)
 	, mThumbnail(nullptr)
 	, mFadeDuration(fadeDuration)
+	, mThumbnailRequest(0)
+	, mUseLevels(false)
+	, mLevelFlags(0)
+	, mLevel(-1)
+	, mLevelRequest(0)
+	, mLevelCheck(false)
 {
 	mLayoutFixedAspect = true;
 }
@@ -37,13 +58,44 @@ ImageWithThumbnail::ImageWithThumbnail(SpriteEngine& engine, const ds::Resource&
 	: inherited(engine, flags)
 	, mThumbnail(nullptr)
 	, mFadeDuration(fadeDuration)
+	, mThumbnailRequest(0)
+	, mUseLevels(false)
+	, mLevelFlags(0)
+	, mLevel(-1)
+	, mLevelRequest(0)
+	, mLevelCheck(false)
 {
 	setImageResource(resource, flags);
 	mLayoutFixedAspect = true;
 }
 
+ImageWithThumbnail::~ImageWithThumbnail(){
+	// The service would call back into a dead sprite otherwise
+	cancelThumbnailRequests();
+}
+
 void ImageWithThumbnail::setImageResource(const ds::Resource& resource, const int flags){
-	inherited::setImageResource(resource, flags);
+	ThumbnailService&	thumbs = mEngine.getThumbnailService();
+	cancelThumbnailRequests();
+	mLevelSource.clear();
+	mLevel = -1;
+
+	const bool			isImage = (resource.getType() == ds::Resource::IMAGE_TYPE && thumbs.isEnabled());
+	const bool			useLevels = (mUseLevels && isImage);
+	if(useLevels){
+		// Nothing loads until the next update, so whoever set the resource has a chance to size
+		// the sprite first. Meanwhile the size is the source's, so sizing works like it always does.
+		clearImage();
+		mLevelSource = resource.getAbsoluteFilePath();
+		mLevelFlags = flags;
+		mLevelCheck = true;
+		const ImageMetaData	meta(mLevelSource);
+		if(!meta.empty()){
+			Sprite::setSizeAll(meta.mSize.x, meta.mSize.y, mDepth);
+		}
+	} else {
+		inherited::setImageResource(resource, flags);
+	}
 
 	// dump an existing thumbnail, if any
 	if(mThumbnail){
@@ -55,18 +107,30 @@ void ImageWithThumbnail::setImageResource(const ds::Resource& resource, const in
 
 	if(!isLoadedPrimary()){
 		if(resource.getThumbnailId() > 0 || !resource.getThumbnailFilePath().empty()){
-			mThumbnail = new ds::ui::Image(mEngine);
-			addChildPtr(mThumbnail);
+			mThumbnail = createThumbnail();
 			if(resource.getThumbnailId() > 0){
 				mThumbnail->setImageResource(resource.getThumbnailId());
 			} else {
 				mThumbnail->setImageFile(resource.getThumbnailFilePath());
 			}
-			mThumbnail->setSize(getWidth(), getHeight());
+		} else if(isImage && !useLevels && !thumbs.getLevels().empty()){
+			// The smallest level is plenty for something that's only up until the real image loads
+			const std::string	source = resource.getAbsoluteFilePath();
+			mThumbnailRequest = thumbs.request(source, (float)thumbs.getLevels().front(), [this, source](const std::string& path){
+				mThumbnailRequest = 0;
+				if(path.empty() || path == source || isLoadedPrimary()) return;
+				if(mThumbnail) mThumbnail->release();
+				mThumbnail = createThumbnail();
+				mThumbnail->setImageFile(path);
+			});
 		}
 	}
 }
 
+void ImageWithThumbnail::setUseThumbnailLevels(const bool useLevels){
+	mUseLevels = useLevels;
+}
+
 bool ImageWithThumbnail::isLoaded() const{
 	return isLoadedThumbnail(true);
 }
@@ -127,6 +191,76 @@ void ImageWithThumbnail::onSizeChanged(){
 	if(mThumbnail){
 		mThumbnail->setSize(getWidth(), getHeight());
 	}
+	mLevelCheck = true;
+}
+
+void ImageWithThumbnail::onScaleChanged(){
+	inherited::onScaleChanged();
+	mLevelCheck = true;
+}
+
+void ImageWithThumbnail::onUpdateServer(const UpdateParams& p){
+	inherited::onUpdateServer(p);
+	if(mLevelCheck){
+		mLevelCheck = false;
+		requestThumbnailLevel();
+	}
+}
+
+Image* ImageWithThumbnail::createThumbnail(){
+	Image*			thumb = new ds::ui::Image(mEngine);
+	addChildPtr(thumb);
+	thumb->setSize(getWidth(), getHeight());
+	return thumb;
+}
+
+void ImageWithThumbnail::cancelThumbnailRequests(){
+	ThumbnailService&	thumbs = mEngine.getThumbnailService();
+	if(mThumbnailRequest){
+		thumbs.cancel(mThumbnailRequest);
+		mThumbnailRequest = 0;
+	}
+	if(mLevelRequest){
+		thumbs.cancel(mLevelRequest);
+		mLevelRequest = 0;
+	}
+}
+
+void ImageWithThumbnail::requestThumbnailLevel(){
+	if(mLevelSource.empty()) return;
+
+	ThumbnailService&	thumbs = mEngine.getThumbnailService();
+	const float			shown = std::max(getWidth() * getScale().x, getHeight() * getScale().y);
+	const int			level = thumbs.getLevelFor(shown);
+	// Only ever go up. Whatever is showing already covers a smaller size.
+	if(mLevel == 0) return;
+	if(mLevel > 0 && level != 0 && level <= mLevel) return;
+
+	mLevel = level;
+	if(mLevelRequest) thumbs.cancel(mLevelRequest);
+	mLevelRequest = thumbs.request(mLevelSource, shown, [this](const std::string& path){
+		mLevelRequest = 0;
+		showThumbnailLevel(path);
+	});
+}
+
+void ImageWithThumbnail::showThumbnailLevel(const std::string& path){
+	const std::string	current = getImageFilename();
+	if(path.empty() || path == current) return;
+
+	// Keep the smaller level up until the bigger one has loaded, the same way a thumbnail is
+	if(!current.empty() && isLoadedPrimary() && !mThumbnail){
+		mThumbnail = createThumbnail();
+		mThumbnail->setImageFile(current, mLevelFlags);
+	}
+
+	// The new file has a different natural size, keep showing it at the same size
+	const float			w = getWidth() * getScale().x;
+	const float			h = getHeight() * getScale().y;
+	setImageFile(path, mLevelFlags);
+	if(w > 0.0f && h > 0.0f){
+		setSize(w, h);
+	}
 }
 
 } // namespace ui
@@ -5,6 +5,7 @@
 #include <ds/ui/sprite/sprite.h>
 #include <ds/ui/sprite/image.h>
 #include "ds/data/resource.h"
+#include "ds/ui/service/thumbnail_service.h"
 
 namespace ds {
 namespace ui {
@@ -25,6 +26,7 @@ public:
 	ImageWithThumbnail(SpriteEngine& engine, const std::string& filename, const int flags = 0, float fadeDuration = DEFAULT_FADE_DURATION);
 	ImageWithThumbnail(SpriteEngine& engine, const ds::Resource::Id& resourceId, const int flags = 0, float fadeDuration = DEFAULT_FADE_DURATION);
 	ImageWithThumbnail(SpriteEngine& engine, const ds::Resource& resource, const int flags = 0, float fadeDuration = DEFAULT_FADE_DURATION);
+	virtual ~ImageWithThumbnail();
 
 	/// @endcond
 
@@ -35,6 +37,13 @@ public:
 	// this is our interception point for duplicating the resource with a thumbnail (if any)
 	virtual void				setImageResource(const ds::Resource& resource, const int flags = 0);
 
+	/// @brief Show image resources from the ThumbnailService's cached levels: the smallest level that covers
+	/// the displayed size instead of the full file, moving up a level as the sprite is sized or scaled up.
+	/// Only this sprite's size and scale count, not its parents'. Needs thumbnail:generate, and applies
+	/// to the next setImageResource(). Off by default.
+	void						setUseThumbnailLevels(const bool useLevels);
+	bool						getUseThumbnailLevels() const { return mUseLevels; }
+
 	/// @brief returns true if the last requested image is loaded as a texture
 	virtual bool				isLoaded() const;
 	bool						isLoadedThumbnail(bool thumbnail) const;
@@ -50,13 +59,32 @@ protected:
 	/// @endcond
 
 	virtual void				onSizeChanged();
+	virtual void				onScaleChanged();
+	virtual void				onUpdateServer(const UpdateParams&) override;
 
 private:
 	typedef Image				inherited;
 
+	Image*						createThumbnail();
+	void						cancelThumbnailRequests();
+	void						requestThumbnailLevel();
+	void						showThumbnailLevel(const std::string& path);
+
 	Image*						mThumbnail;
 	float						mFadeDuration;
 
+	// Without a thumbnail in the resource, the placeholder comes from the ThumbnailService
+	ThumbnailService::RequestId	mThumbnailRequest;
+
+	bool						mUseLevels;
+	std::string					mLevelSource;
+	int							mLevelFlags;
+	// The level asked for, 0 for the source itself, -1 for nothing yet
+	int							mLevel;
+	ThumbnailService::RequestId	mLevelRequest;
+	// Size or scale changed, see if a bigger level is needed on the next update
+	bool						mLevelCheck;
+
 };
 
 } // namespace ui
@@ -0,0 +1,125 @@
+#include "stdafx.h"
+
+#include "shader_source.h"
+
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include "ds/util/fnv_hash.h"
+
+namespace ds {
+namespace ui {
+
+namespace {
+
+void hash_bytes(uint64_t& h, const std::string& s){
+	ds::fnv_hash(h, s);
+	// A separator, so moving text from one part to the next changes the hash
+	const unsigned char	SEPARATOR = 0xff;
+	ds::fnv_hash(h, &SEPARATOR, 1);
+}
+
+bool read_file(const std::string& path, std::string& out){
+	std::ifstream		in(path.c_str(), std::ios::in | std::ios::binary);
+	if(!in.is_open()) return false;
+	std::stringstream	ss;
+	ss << in.rdbuf();
+	out = ss.str();
+	return !in.bad();
+}
+
+std::string trim(const std::string& s){
+	const size_t		first = s.find_first_not_of(" \t\r\n");
+	if(first == std::string::npos) return "";
+	const size_t		last = s.find_last_not_of(" \t\r\n");
+	return s.substr(first, last - first + 1);
+}
+
+}
+
+/**
+ * \class ds::ui::ShaderSource
+ */
+ShaderSource::ShaderSource()
+	: mKey(makeKey("", "", std::vector<std::string>()))
+{
+}
+
+ShaderSource::ShaderSource(const std::string& vert, const std::string& frag, const std::vector<std::string>& defines)
+	: mVert(vert)
+	, mFrag(frag)
+	, mDefines(defines)
+	, mKey(makeKey(vert, frag, defines))
+{
+}
+
+bool ShaderSource::loadFiles(const std::string& location, const std::string& name){
+	std::string			vert, frag;
+	if(!read_file(location + "/" + name + ".vert", vert)) return false;
+	if(!read_file(location + "/" + name + ".frag", frag)) return false;
+
+	mVert = vert;
+	mFrag = frag;
+	if(mName.empty()) mName = name;
+	mKey = makeKey(mVert, mFrag, mDefines);
+	return true;
+}
+
+void ShaderSource::setDefines(const std::vector<std::string>& defines){
+	mDefines = defines;
+	mKey = makeKey(mVert, mFrag, mDefines);
+}
+
+std::string ShaderSource::makeKey(const std::string& vert, const std::string& frag, const std::vector<std::string>& defines){
+	uint64_t			h = ds::FNV_OFFSET;
+	hash_bytes(h, vert);
+	hash_bytes(h, frag);
+	for(auto& it : defines){
+		hash_bytes(h, it);
+	}
+	return ds::fnv_to_hex(h);
+}
+
+/**
+ * \class ds::ui::ShaderManifest
+ */
+std::vector<ShaderManifest::Entry> ShaderManifest::parse(const std::string& text){
+	std::vector<Entry>		ans;
+	std::istringstream		lines(text);
+	std::string				line;
+	while(std::getline(lines, line)){
+		line = trim(line);
+		if(line.empty() || line[0] == '#') continue;
+
+		std::istringstream	words(line);
+		std::string			path;
+		words >> path;
+		const size_t		slash = path.find_last_of("/\\");
+		Entry				e;
+		if(slash == std::string::npos){
+			e.mName = path;
+		} else {
+			e.mLocation = path.substr(0, slash);
+			e.mName = path.substr(slash + 1);
+		}
+		if(e.mName.empty()) continue;
+
+		std::string			define;
+		while(words >> define){
+			const size_t	eq = define.find('=');
+			if(eq != std::string::npos) define[eq] = ' ';
+			e.mDefines.push_back(define);
+		}
+		ans.push_back(e);
+	}
+	return ans;
+}
+
+std::vector<ShaderManifest::Entry> ShaderManifest::load(const std::string& path){
+	std::string				text;
+	if(!read_file(path, text)) return std::vector<Entry>();
+	return parse(text);
+}
+
+} // namespace ui
+} // namespace ds
@@ -0,0 +1,80 @@
+#pragma once
+#ifndef DS_UI_SPRITE_SHADER_SHADERSOURCE_H_
+#define DS_UI_SPRITE_SHADER_SHADERSOURCE_H_
+
+#include <string>
+#include <vector>
+
+namespace ds {
+namespace ui {
+
+/**
+ * \class ds::ui::ShaderSource
+ * \brief The text of a vertex and fragment shader plus any defines, and the key the
+ * compiled program is cached under. The key is a hash of all of it, so two shaders
+ * with the same name and different text never share a program, and an edited file
+ * gets a new one. Nothing in here touches GL.
+ */
+class ShaderSource {
+public:
+	ShaderSource();
+	/// Defines are "NAME" or "NAME VALUE", the same as the text after #define
+	ShaderSource(const std::string& vert, const std::string& frag, const std::vector<std::string>& defines = std::vector<std::string>());
+
+	/// Reads location/name.vert and location/name.frag. Answers false if either can't be read.
+	bool							loadFiles(const std::string& location, const std::string& name);
+
+	bool							empty() const { return mVert.empty() || mFrag.empty(); }
+
+	const std::string&				getVert() const { return mVert; }
+	const std::string&				getFrag() const { return mFrag; }
+	const std::vector<std::string>&	getDefines() const { return mDefines; }
+	void							setDefines(const std::vector<std::string>&);
+
+	/// Only for log messages, not part of the key
+	const std::string&				getName() const { return mName; }
+	void							setName(const std::string& name) { mName = name; }
+
+	/// 16 hex digits, a hash of both sources and the defines
+	const std::string&				getKey() const { return mKey; }
+
+	static std::string				makeKey(const std::string& vert, const std::string& frag, const std::vector<std::string>& defines);
+
+private:
+	std::string						mVert;
+	std::string						mFrag;
+	std::vector<std::string>		mDefines;
+	std::string						mName;
+	std::string						mKey;
+};
+
+/**
+ * \class ds::ui::ShaderManifest
+ * \brief A list of file shaders to compile at startup, so nothing waits on them the
+ * first time they're drawn. One shader per line: the path without the extension, then
+ * any defines, separated by spaces. NAME=VALUE defines become "NAME VALUE". Blank lines
+ * and lines starting with # are skipped.
+ *
+ *	# blur, in two qualities
+ *	%APP%/data/shaders/blur
+ *	%APP%/data/shaders/blur HIGH_QUALITY RADIUS=8
+ */
+class ShaderManifest {
+public:
+	class Entry {
+	public:
+		std::string					mLocation;
+		std::string					mName;
+		std::vector<std::string>	mDefines;
+	};
+
+	/// Paths are kept as written, expand them before loading
+	static std::vector<Entry>		parse(const std::string& text);
+	/// Empty if the file can't be read
+	static std::vector<Entry>		load(const std::string& path);
+};
+
+} // namespace ui
+} // namespace ds
+
+#endif // DS_UI_SPRITE_SHADER_SHADERSOURCE_H_
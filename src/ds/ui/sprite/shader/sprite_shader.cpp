@@ -1,11 +1,9 @@
 #include "stdafx.h"
 
 #include "sprite_shader.h"
-#include "cinder/DataSource.h"
 #include "ds/debug/logger.h"
-#include <ds/util/file_meta_data.h>
-
-#include <Poco/File.h>
+#include "ds/ui/service/shader_service.h"
+#include "ds/ui/sprite/shader/shader_source.h"
 
 namespace {
 
@@ -98,8 +96,6 @@ const std::string NoImageVert =
 
 const ds::BitMask SHADER_LOG = ds::Logger::newModule("shader");
 
-std::unordered_map<std::string, ci::gl::GlslProgRef> GlslProgs;
-
 }
 
 namespace ds {
@@ -109,6 +105,8 @@ SpriteShader::SpriteShader(const std::string &defaultLocation, const std::string
 	: mDefaultLocation(defaultLocation)
 	, mDefaultName(defaultName)
 	, mShader(nullptr)
+	, mService(nullptr)
+	, mPending(false)
 {
 	mLocation = mDefaultLocation;
 	mName = mDefaultName;
@@ -120,6 +118,8 @@ SpriteShader::SpriteShader(const std::string& vert_memory, const std::string& fr
 	, mMemoryFrag(frag_memory)
 	, mName(shaderName)
 	, mShader(nullptr)
+	, mService(nullptr)
+	, mPending(false)
 {
 }
 
@@ -127,6 +127,7 @@ void SpriteShader::setShaders(const std::string& vert_memory, const std::string&
 	if(mShader) {
 		mShader.reset();
 	}
+	mPending = false;
 
 	mMemoryVert = vert_memory;
 	mMemoryFrag = frag_memory;
@@ -146,15 +147,25 @@ void SpriteShader::setShaders(const std::string &location, const std::string &na
 	if(mShader){
 		mShader.reset();
 	}
+	mPending = false;
 
 	mLocation = location;
 	mName = name;
 }
 
+void SpriteShader::setDefines(const std::vector<std::string>& defines){
+	if(mDefines == defines) return;
+
+	mDefines = defines;
+	mShader.reset();
+	mPending = false;
+}
+
 void SpriteShader::setToDefaultShader(){
 	if(mShader){
 		mShader.reset();
 	}
+	mPending = false;
 
 	mName = "base";
 	loadDefaultFromMemory();
@@ -164,135 +175,96 @@ void SpriteShader::setToNoImageShader() {
 	if(mShader) {
 		mShader.reset();
 	}
+	mPending = false;
 
 	mName = "noImage";
 	loadNoImageFromMemory();
 }
 
-void SpriteShader::loadShaders() {
-	if(mShader) return;
-	if(!mShader) loadShadersFromFile();
-	if(!mShader) loadFromMemory();
-	if(!mShader) loadDefaultFromFile();
+void SpriteShader::setShaderService(ShaderService* service){
+	mService = service;
+}
+
+bool SpriteShader::loadShaders() {
+	if(mShader && !mPending) return false;
+
+	const ci::gl::GlslProgRef previous = mShader;
+	mShader.reset();
+	mPending = false;
+
+	loadShadersFromFile();
+	if(!mShader && !mPending) loadFromMemory();
+	if(!mShader && !mPending) loadDefaultFromFile();
+	// Draw with the default until the real one is compiled
 	if(!mShader) loadDefaultFromMemory();
+
+	return mShader != previous;
 }
 
 bool SpriteShader::isValid() const {
 	return (mShader != nullptr);
 }
 
+bool SpriteShader::isPending() const {
+	return mPending;
+}
+
 ci::gl::GlslProgRef SpriteShader::getShader(){
 	return mShader;
 }
 
+void SpriteShader::useProgram(const ShaderSource& src){
+	if(mService){
+		mShader = mService->getProgram(src);
+		if(!mShader) mPending = mService->isPending(src);
+	} else {
+		mShader = ShaderService::compile(src);
+	}
+}
+
 void SpriteShader::loadShadersFromFile(){
 	if(mName.empty())
 		return;
 
-	try {
-		auto found = GlslProgs.find(mName);
-		if(found == GlslProgs.end()) {
-			std::string vertLocation = (mLocation + "/" + mName + ".vert");
-			std::string fragLocation = (mLocation + "/" + mName + ".frag");
-			Poco::File vertFile = Poco::File(vertLocation);
-			Poco::File fragFile = Poco::File(fragLocation);
-			bool exist = false;
-			try{
-				if(vertFile.exists() && fragFile.exists()){
-					exist = true;
-				} 
-			} catch(std::exception&){
-				// swallow these, cause shaders could be loaded otherwise
-			}
-			if(exist){
-				mShader = ci::gl::GlslProg::create(ci::loadFile(vertLocation.c_str()), ci::loadFile(fragLocation.c_str()));
-				GlslProgs[mName] = mShader;
-			}
-		} else {
-			mShader = found->second;
-		}
-	} catch(std::exception &e) {
-		//std::cout << e.what() << std::endl;
-		if(mName.empty()) {
-			DS_LOG_WARNING_M("SpriteShader::loadShadersFromFile() on non empty name, did you intend that?", SHADER_LOG);
-		} else {
-			DS_LOG_WARNING_M("SpriteShader::loadShadersFromFile() on " + mName + "\n" + e.what(), SHADER_LOG);
-		}
-	}
+	ShaderSource src;
+	if(!ShaderService::getFileSource(mLocation, mName, src)) return;
+	if(!mDefines.empty()) src.setDefines(mDefines);
+	useProgram(src);
 }
 
 void SpriteShader::loadDefaultFromFile(){
 	if(mDefaultName.empty())
 		return;
 
-	try {
-		std::string vertLocation = (mDefaultLocation + "/" + mDefaultName + ".vert");
-		std::string fragLocation = (mDefaultLocation + "/" + mDefaultName + ".frag");
-		if(!ds::safeFileExistsCheck(vertLocation) || !ds::safeFileExistsCheck(fragLocation)){
-			// swallow these errors?
-		} else {
-			auto found = GlslProgs.find(mDefaultName);
-			if(found == GlslProgs.end()) {
-				mShader = ci::gl::GlslProg::create(ci::loadFile((mDefaultLocation + "/" + mDefaultName + ".vert").c_str()), ci::loadFile((mDefaultLocation + "/" + mDefaultName + ".frag").c_str()));
-				GlslProgs[mDefaultName] = mShader;
-			} else {
-				mShader = found->second;
-			}
-		}
-
-	} catch(std::exception &e) {
-		//    std::cout << e.what() << std::endl;
-		DS_LOG_WARNING_M("SpriteShader::loadShadersFromFile() on " + mDefaultName + "\n" + e.what(), SHADER_LOG);
-	}
+	ShaderSource src;
+	if(!ShaderService::getFileSource(mDefaultLocation, mDefaultName, src)) return;
+	useProgram(src);
 }
 
 void SpriteShader::loadFromMemory(){
-	try {
-		auto found = GlslProgs.find(mName);
-		if(found == GlslProgs.end()) {
-			if(mMemoryVert.empty() || mMemoryFrag.empty()){
-				// swallow these errors?
-			} else {
-				mShader = ci::gl::GlslProg::create(mMemoryVert.c_str(), mMemoryFrag.c_str());
-				GlslProgs[mName] = mShader;
-			}
-		} else {
-			mShader = found->second;
-		}
-	} catch(std::exception &e) {
-		//std::cout << e.what() << std::endl;
-		DS_LOG_WARNING_M("SpriteShader::loadShadersFromMemory() " << mName << " " << e.what(), SHADER_LOG);
-	}
+	if(mMemoryVert.empty() || mMemoryFrag.empty()) return;
 
+	ShaderSource src(mMemoryVert, mMemoryFrag, mDefines);
+	src.setName(mName);
+	useProgram(src);
 }
 
 void SpriteShader::loadDefaultFromMemory(){
-	try {
-		auto found = GlslProgs.find("base");
-		if(found == GlslProgs.end()) {
-			mShader = ci::gl::GlslProg::create(DefaultVert.c_str(), DefaultFrag.c_str());
-			GlslProgs["base"] = mShader;
-		} else {
-			mShader = found->second;
-		}
-	} catch(std::exception &e) {
-		//std::cout << e.what() << std::endl;
-		DS_LOG_WARNING_M(std::string("SpriteShader::loadDefaultFromMemory() on DefaultVert\n") + e.what(), SHADER_LOG);
+	// The fallback for everything else, so it never waits on the compile thread
+	static ShaderSource src(DefaultVert, DefaultFrag);
+	src.setName("base");
+	mShader = ShaderService::compile(src);
+	if(!mShader) {
+		DS_LOG_WARNING_M("SpriteShader::loadDefaultFromMemory() couldn't compile the default shader", SHADER_LOG);
 	}
 }
 
 void SpriteShader::loadNoImageFromMemory() {
-	try {
-		auto found = GlslProgs.find("noImage");
-		if(found == GlslProgs.end()) {
-			mShader = ci::gl::GlslProg::create(NoImageVert.c_str(), NoImageFrag.c_str());
-			GlslProgs["noImage"] = mShader;
-		} else {
-			mShader = found->second;
-		}
-	} catch(std::exception &e) {
-		//std::cout << e.what() << std::endl;
-		DS_LOG_WARNING_M(std::string("SpriteShader::loadDefaultFromMemory() on NoImage\n") + e.what(), SHADER_LOG);
+	static ShaderSource src(NoImageVert, NoImageFrag);
+	src.setName("noImage");
+	mShader = ShaderService::compile(src);
+	if(!mShader) {
+		DS_LOG_WARNING_M("SpriteShader::loadNoImageFromMemory() couldn't compile the no image shader", SHADER_LOG);
 	}
 }
 
@@ -306,7 +278,7 @@ std::string SpriteShader::getName() const{
 
 
 void SpriteShader::clearShaderCache() {
-	GlslProgs.clear();
+	ShaderService::clearCache();
 }
 
 }
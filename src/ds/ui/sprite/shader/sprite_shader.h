@@ -3,9 +3,12 @@
 #define DS_UI_SPRITE_SHADER_H
 #include "cinder/gl/GlslProg.h"
 #include <string>
+#include <vector>
 
 namespace ds {
 namespace ui {
+class ShaderService;
+class ShaderSource;
 
 class SpriteShader
 {
@@ -17,14 +20,26 @@ public:
 	void setShaders(const std::string &vert_memory, const std::string &frag_memory, const std::string &shaderName);
 	void setToDefaultShader();
 	void setToNoImageShader();
-	void loadShaders();
+	/// "NAME" or "NAME VALUE", added to file and memory shaders as #defines
+	void setDefines(const std::vector<std::string>& defines);
+
+	/// Sprites set this to their engine's. Without one, shaders compile as soon as they're needed.
+	void setShaderService(ShaderService*);
+
+	/// Answers true if the program changed, so anything holding the old one needs updating.
+	/// While the real shader is still compiling on the ShaderService, this is the default shader.
+	bool loadShaders();
 	bool isValid() const;
+	/// True while drawing with the default shader because the real one isn't compiled yet
+	bool isPending() const;
 
 	/**
 	 * Clears the cache of loaded GLSL shaders, so that the next time
 	 * a sprite sets a shader, it will reload that shader from the
 	 * source file.  This is particularly useful during development if
 	 * you want to test changes to a shader without restarting the app.
+	 * Programs are cached by their source text (see ShaderSource), so
+	 * shaders with the same name and different text don't collide.
 	 */
 	static void clearShaderCache();
 
@@ -33,6 +48,7 @@ public:
 	std::string getLocation() const;
 	std::string getName() const;
 private:
+	void useProgram(const ShaderSource&);
 	void loadShadersFromFile();
 	void loadFromMemory();
 
@@ -46,8 +62,12 @@ private:
 	std::string			mName;
 	std::string			mMemoryVert;
 	std::string			mMemoryFrag;
+	std::vector<std::string>
+						mDefines;
 
 	ci::gl::GlslProgRef	mShader;
+	ShaderService*		mService;
+	bool				mPending;
 };
 
 }
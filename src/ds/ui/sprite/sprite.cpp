@@ -16,11 +16,14 @@
 #include "ds/ui/tween/tweenline.h"
 #include "ds/util/string_util.h"
 #include "util/clip_plane.h"
+#include "util/sprite_draw_list.h"
 #include "ds/params/draw_params.h"
 
 #include "cinder/ImageIo.h"
 #include <cinder/Ray.h>
 #include <cinder/Rand.h>
+#include <algorithm>
+#include <typeinfo>
 
 //#include <glm/gtx/rotate_vector.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -79,6 +82,25 @@ const int			ROTATE_TOUCHES_F = (1 << 7);
 const int			DRAW_DEBUG_F		= (1<<8);
 
 const ds::BitMask	SPRITE_LOG = ds::Logger::newModule("sprite");
+
+// Big enough for every sprite class in the framework; larger app classes go to the heap.
+// Never destroyed, so sprites released during static destruction still have somewhere to go.
+ds::SlabPool&		sprite_pool() {
+	static ds::SlabPool*	POOL = new ds::SlabPool(16, 8192, 256 * 1024);
+	return *POOL;
+}
+}
+
+void* Sprite::operator new(const size_t size) {
+	return sprite_pool().allocate(size);
+}
+
+void Sprite::operator delete(void* p, const size_t size) {
+	sprite_pool().deallocate(p, size);
+}
+
+ds::SlabPool::Stats Sprite::getAllocationStats() {
+	return sprite_pool().getStats();
 }
 
 void Sprite::installAsServer(ds::BlobRegistry& registry) {
@@ -143,6 +165,8 @@ void Sprite::init(const ds::sprite_id_t id) {
 	mRotationOrderZYX = false;
 	mScale = ci::vec3(1.0f, 1.0f, 1.0f);
 	mUpdateTransform = true;
+	mTransformHandle = mEngine.getSpriteTransforms().create(*this);
+	mSpriteShader.setShaderService(&mEngine.getShaderService());
 	mParent = nullptr;
 	mOpacity = 1.0f;
 	mColor = ci::Color(1.0f, 1.0f, 1.0f);
@@ -150,6 +174,11 @@ void Sprite::init(const ds::sprite_id_t id) {
 	mCheckBounds = false;
 	mBoundsNeedChecking = true;
 	mInBounds = true;
+	mSubtreeBoundsEmpty = true;
+	mSubtreeUnbounded = false;
+	mSubtreeBoundsDirty = true;
+	mCulled = false;
+	mSkipUpdateWhenCulled = false;
 	mDepth = 1.0f;
 	mDragDestination = nullptr;
 	mBlobType = BLOB_TYPE;
@@ -163,6 +192,8 @@ void Sprite::init(const ds::sprite_id_t id) {
 	mLayoutFixedAspect = false;
 	mShaderTexture = nullptr;
 	mNeedsBatchUpdate = false;
+	mDeferDimensionalState = false;
+	mDimensionalStateDeferred = false;
 	mDoSpecialRotation = false;
 	mDegree = 0.0f;
 
@@ -199,6 +230,7 @@ void Sprite::init(const ds::sprite_id_t id) {
 Sprite::~Sprite() {
 	animStop();
 	cancelDelayedCall();
+	mTimers.reset();
 
 	mEngine.removeFromDragDestinationList(this);
 
@@ -219,6 +251,8 @@ Sprite::~Sprite() {
 			mEngine.spriteDeleted(id);
 		}
 	}
+
+	mEngine.getSpriteTransforms().release(mTransformHandle);
 }
 
 void Sprite::updateClient(const UpdateParams &p) {
@@ -228,6 +262,10 @@ void Sprite::updateClient(const UpdateParams &p) {
 		updateCheckBounds();
 	}
 
+	if(mSkipUpdateWhenCulled && isCulled()) {
+		return;
+	}
+
 	for(auto it = mChildren.begin(), it2 = mChildren.end(); it != it2; ++it) {
 		(*it)->updateClient(p);
 	}
@@ -244,6 +282,10 @@ void Sprite::updateServer(const UpdateParams &p) {
 		updateCheckBounds();
 	}
 
+	if(mSkipUpdateWhenCulled && isCulled()) {
+		return;
+	}
+
 	for(auto it = mChildren.begin(), it2 = mChildren.end(); it != it2; ++it) {
 		(*it)->updateServer(p);
 	}
@@ -259,6 +301,9 @@ void Sprite::drawClient(const ci::mat4 &trans, const DrawParams &drawParams) {
 
 	buildTransform();
 	ci::mat4 totalTransformation = trans*mTransformation;
+	if (drawParams.mCull && cullSubtree(totalTransformation, drawParams)) {
+		return;
+	}
 	ci::gl::pushModelMatrix();
 	
 	if (mIsRenderFinalToTexture && mOutputFbo){
@@ -282,7 +327,49 @@ void Sprite::drawClient(const ci::mat4 &trans, const DrawParams &drawParams) {
 		ci::gl::translate(0.0f, (float)-getHeight(), 0.0f);			// shift origin up to upper-left corner.
 	}
 
-	mSpriteShader.loadShaders();	
+	drawSelfClient(drawParams);
+
+
+	if (mIsRenderFinalToTexture && mOutputFbo){
+		// Reverse flipping
+		//ci::gl::scale(1.0f, -1.0f, 1.0f);
+		//ci::gl::translate(0.0f, (float)-getHeight(), 0.0f);
+	} else if ((mSpriteFlags&CLIP_F) != 0){ // Clipping is implicit when rendering to an FBO, only set clipping if we aren't
+		const ci::Rectf&      clippingBounds = getClippingBounds();
+		clip_plane::enableClipping(clippingBounds.getX1(), clippingBounds.getY1(), clippingBounds.getX2(), clippingBounds.getY2());
+	}
+
+	ci::gl::popModelMatrix();
+	DS_REPORT_GL_ERRORS();
+
+
+	DrawParams dParams = drawParams;
+	dParams.mParentOpacity *= mOpacity;
+	if (dParams.mCull) cullChildParams(dParams);
+
+	if((mSpriteFlags&DRAW_SORTED_F) == 0) {
+		for(auto it = mChildren.begin(), it2 = mChildren.end(); it != it2; ++it) {
+			(*it)->drawClient(totalTransformation, dParams);
+		}
+	} else {
+		makeSortedChildren();
+		for(auto it = mSortedTmp.begin(), it2 = mSortedTmp.end(); it != it2; ++it) {
+			(*it)->drawClient(totalTransformation, dParams);
+		}
+	}
+
+	if (mIsRenderFinalToTexture && mOutputFbo){
+		mOutputFbo->unbindFramebuffer();
+		ci::gl::popViewport();
+		ci::gl::popMatrices();
+	} else if ((mSpriteFlags&CLIP_F) != 0){
+		clip_plane::disableClipping();
+	}
+}
+
+void Sprite::drawSelfClient(const DrawParams& drawParams) {
+	// The shader changes when one that was still compiling is ready
+	if(mSpriteShader.loadShaders()) mNeedsBatchUpdate = true;
 
 	if ((mSpriteFlags&TRANSPARENT_F) == 0) {
 
@@ -328,45 +415,78 @@ void Sprite::drawClient(const ci::mat4 &trans, const DrawParams &drawParams) {
 		DS_REPORT_GL_ERRORS();
 		drawLocalClient();
 		DS_REPORT_GL_ERRORS();
-	}	
+	}
+}
 
+void Sprite::compileDrawList(SpriteDrawList& drawList, const ci::mat4 &trans, const DrawParams &drawParams) {
+	if ((mSpriteFlags&VISIBLE_F) == 0) {
+		return;
+	}
 
+	// Rendering to a texture changes the target and transforms for the whole subtree
 	if (mIsRenderFinalToTexture && mOutputFbo){
-		// Reverse flipping
-		//ci::gl::scale(1.0f, -1.0f, 1.0f);
-		//ci::gl::translate(0.0f, (float)-getHeight(), 0.0f);
-	} else if ((mSpriteFlags&CLIP_F) != 0){ // Clipping is implicit when rendering to an FBO, only set clipping if we aren't
-		const ci::Rectf&      clippingBounds = getClippingBounds();
-		clip_plane::enableClipping(clippingBounds.getX1(), clippingBounds.getY1(), clippingBounds.getX2(), clippingBounds.getY2());
+		drawList.addSubtree(*this, trans, drawParams);
+		return;
 	}
 
-	ci::gl::popModelMatrix();
-	DS_REPORT_GL_ERRORS();
+	buildTransform();
+	const ci::mat4 totalTransformation = trans*mTransformation;
+	if (drawParams.mCull && cullSubtree(totalTransformation, drawParams)) {
+		return;
+	}
 
+	if ((mSpriteFlags&TRANSPARENT_F) == 0) {
+		if(mSpriteShader.loadShaders()) mNeedsBatchUpdate = true;
+
+		// Batching needs the base shader with nothing per-sprite in it
+		ci::Rectf localRect;
+		ci::gl::TextureRef texture;
+		const bool plain = mSpriteShader.isValid() && mSpriteShader.getName() == "base" && mUniform.empty()
+							&& mCornerRadius <= 0.0f && !mUseDepthBuffer && !mPerspective;
+		if (plain && getDrawListQuad(localRect, texture)) {
+			mDrawOpacity = mOpacity*drawParams.mParentOpacity;
+			if (localRect.getWidth() > 0.0f && localRect.getHeight() > 0.0f) {
+				drawList.addQuad(totalTransformation, localRect, texture, mSpriteShader.getShader(), mBlendMode,
+								 ci::ColorA(mColor.r, mColor.g, mColor.b, mDrawOpacity));
+			}
+		} else {
+			drawList.addSprite(*this, totalTransformation, drawParams);
+		}
+	}
+
+	const bool clip = (mSpriteFlags&CLIP_F) != 0;
+	if (clip){
+		drawList.beginClip(getClippingBounds());
+	}
 
 	DrawParams dParams = drawParams;
 	dParams.mParentOpacity *= mOpacity;
+	if (dParams.mCull) cullChildParams(dParams);
 
 	if((mSpriteFlags&DRAW_SORTED_F) == 0) {
 		for(auto it = mChildren.begin(), it2 = mChildren.end(); it != it2; ++it) {
-			(*it)->drawClient(totalTransformation, dParams);
+			(*it)->compileDrawList(drawList, totalTransformation, dParams);
 		}
 	} else {
 		makeSortedChildren();
 		for(auto it = mSortedTmp.begin(), it2 = mSortedTmp.end(); it != it2; ++it) {
-			(*it)->drawClient(totalTransformation, dParams);
+			(*it)->compileDrawList(drawList, totalTransformation, dParams);
 		}
 	}
 
-	if (mIsRenderFinalToTexture && mOutputFbo){
-		mOutputFbo->unbindFramebuffer();
-		ci::gl::popViewport();
-		ci::gl::popMatrices();
-	} else if ((mSpriteFlags&CLIP_F) != 0){
-		clip_plane::disableClipping();
+	if (clip){
+		drawList.endClip();
 	}
 }
 
+bool Sprite::getDrawListQuad(ci::Rectf& localRect, ci::gl::TextureRef& texture) {
+	// Subclasses draw all sorts of things in drawLocalClient(), so they have to opt in
+	if (typeid(*this) != typeid(Sprite) || mUseShaderTexture) return false;
+	localRect = ci::Rectf(0.0f, 0.0f, mWidth, mHeight);
+	texture = nullptr;
+	return true;
+}
+
 void Sprite::drawServer(const ci::mat4 &trans, const DrawParams &drawParams) {
 	if((mSpriteFlags&VISIBLE_F) == 0) {
 		return;
@@ -374,6 +494,9 @@ void Sprite::drawServer(const ci::mat4 &trans, const DrawParams &drawParams) {
 
 	buildTransform();
 	ci::mat4 totalTransformation = trans*mTransformation;
+	if(drawParams.mCull && cullSubtree(totalTransformation, drawParams)) {
+		return;
+	}
 	ci::gl::pushModelMatrix();
 
 	ci::gl::multModelMatrix(totalTransformation);
@@ -407,14 +530,17 @@ void Sprite::drawServer(const ci::mat4 &trans, const DrawParams &drawParams) {
 
 	ci::gl::popModelMatrix();
 
+	DrawParams dParams = drawParams;
+	if(dParams.mCull) cullChildParams(dParams);
+
 	if((mSpriteFlags&DRAW_SORTED_F) == 0) {
 		for(auto it = mChildren.begin(), it2 = mChildren.end(); it != it2; ++it) {
-			(*it)->drawServer(totalTransformation, drawParams);
+			(*it)->drawServer(totalTransformation, dParams);
 		}
 	} else {
 		makeSortedChildren();
 		for(auto it = mSortedTmp.begin(), it2 = mSortedTmp.end(); it != it2; ++it) {
-			(*it)->drawServer(totalTransformation, drawParams);
+			(*it)->drawServer(totalTransformation, dParams);
 		}
 	}
 
@@ -494,7 +620,7 @@ void Sprite::doSetPosition(const ci::vec3& pos) {
 	if (mPosition == pos) return;
 
 	mPosition = pos;
-	mUpdateTransform = true;
+	markTransformDirty();
 	mBoundsNeedChecking = true;
 	markAsDirty(POSITION_DIRTY);
 	dimensionalStateChanged();
@@ -505,7 +631,7 @@ void Sprite::doSetScale(const ci::vec3& scale) {
 	if(mScale == scale) return;
 
 	mScale = scale;
-	mUpdateTransform = true;
+	markTransformDirty();
 	mBoundsNeedChecking = true;
 	markAsDirty(SCALE_DIRTY);
 	dimensionalStateChanged();
@@ -554,7 +680,7 @@ void Sprite::setCenter(const ci::vec3& center){
 	if(mCenter == center) return;
 
 	mCenter = center;
-	mUpdateTransform = true;
+	markTransformDirty();
 	mBoundsNeedChecking = true;
 	markAsDirty(CENTER_DIRTY);
 	dimensionalStateChanged();
@@ -589,13 +715,37 @@ void Sprite::doSetRotation(const ci::vec3& rot) {
 		return;
 
 	mRotation = rot;
-	mUpdateTransform = true;
+	markTransformDirty();
 	mBoundsNeedChecking = true;
 	markAsDirty(ROTATION_DIRTY);
 	dimensionalStateChanged();
 	onRotationChanged();
 }
 
+void Sprite::applyTweenedValues(const int channels, const SpriteTweens::Values& values) {
+	// Each value goes through its setter, so overrides of doSetPosition() and the rest see tweens too.
+	// What dimensionalStateChanged() does is held until they've all been set.
+	mDeferDimensionalState = true;
+	if(channels & (1 << SpriteTweens::POSITION)) doSetPosition(values.mValue[SpriteTweens::POSITION]);
+	if(channels & (1 << SpriteTweens::SCALE)) doSetScale(values.mValue[SpriteTweens::SCALE]);
+	if(channels & (1 << SpriteTweens::ROTATION)) doSetRotation(values.mValue[SpriteTweens::ROTATION]);
+	if(channels & (1 << SpriteTweens::OPACITY)) setOpacity(values.mValue[SpriteTweens::OPACITY].x);
+	if(channels & (1 << SpriteTweens::SIZE)) {
+		const ci::vec3&	size = values.mValue[SpriteTweens::SIZE];
+		setSizeAll(size.x, size.y, size.z);
+	}
+	if(channels & (1 << SpriteTweens::COLOR)) {
+		const ci::vec3&	c = values.mValue[SpriteTweens::COLOR];
+		setColor(ci::Color(c.x, c.y, c.z));
+	}
+	mDeferDimensionalState = false;
+
+	if(mDimensionalStateDeferred) {
+		mDimensionalStateDeferred = false;
+		dimensionalStateChanged();
+	}
+}
+
 ci::vec3 Sprite::getRotation() const
 {
 	return mRotation;
@@ -665,6 +815,7 @@ void Sprite::addChild(Sprite &child){
 	child.setPerspective(mPerspective);
 	child.setDrawSorted(getDrawSorted());
 	child.setUseDepthBuffer(mUseDepthBuffer);
+	markSubtreeBoundsDirty();
 
 	onChildAdded(child);
 }
@@ -677,6 +828,7 @@ void Sprite::removeChild(Sprite &child){
 
 	auto found = std::find(mChildren.begin(), mChildren.end(), &child);
 	if(found != mChildren.end()) mChildren.erase(found);
+	markSubtreeBoundsDirty();
 	if(child.getParent() == this) {
 		child.setParent(nullptr);
 		child.setPerspective(false);
@@ -689,6 +841,7 @@ void Sprite::setParent(Sprite *parent) {
 	}
 	removeParent();
 	mParent = parent;
+	updateTransformParent();
 	if(mParent)
 		mParent->addChild(*this);
 	onParentSet();
@@ -699,10 +852,17 @@ void Sprite::removeParent() {
 	if (mParent) {
 		mParent->removeChild(*this);
 		mParent = nullptr;
+		updateTransformParent();
 		markAsDirty(PARENT_DIRTY);
 	}
 }
 
+void Sprite::updateTransformParent() {
+	SpriteTransforms::Handle	parent = SpriteTransforms::NONE;
+	if(mParent) parent = mParent->mTransformHandle;
+	mEngine.getSpriteTransforms().setParent(mTransformHandle, parent);
+}
+
 void Sprite::remove() {
 	clearChildren();
 	removeParent();
@@ -780,7 +940,7 @@ void Sprite::setSizeAll(float width, float height, float depth){
 	mWidth = width;
 	mHeight = height;
 	mDepth = depth;
-	mUpdateTransform = true;
+	markTransformDirty();
 	mNeedsBatchUpdate = true;
 	markAsDirty(SIZE_DIRTY);
 	dimensionalStateChanged();
@@ -906,17 +1066,9 @@ bool Sprite::isEnabled() const {
 	return getFlag(ENABLED_F, mSpriteFlags);
 }
 
-void Sprite::buildGlobalTransform() const {
-	buildTransform();
-
-	mGlobalTransform = mTransformation;
-
-	for(Sprite *parent = mParent; parent; parent = parent->getParent())	{
-		parent->buildTransform();
-		mGlobalTransform = parent->mTransformation * mGlobalTransform;
-	}
-
-	mInverseGlobalTransform = glm::inverse(mGlobalTransform);
+void Sprite::markTransformDirty() {
+	mUpdateTransform = true;
+	mEngine.getSpriteTransforms().markDirty(mTransformHandle);
 }
 
 void Sprite::parentEventReceived(const ds::Event &e) {
@@ -931,22 +1083,20 @@ Sprite *Sprite::getParent() const {
 	return mParent;
 }
 
-const ci::mat4 &Sprite::getGlobalTransform() const {
-	buildGlobalTransform();
-
-	return mGlobalTransform;
+ci::mat4 Sprite::getGlobalTransform() const {
+	return mEngine.getSpriteTransforms().getWorld(mTransformHandle);
 }
 
 ci::vec3 Sprite::globalToLocal(const ci::vec3 &globalPoint){
-	buildGlobalTransform();
+	const ci::mat4& inverseGlobal = mEngine.getSpriteTransforms().getInverseWorld(mTransformHandle);
 
-	ci::vec4 point = mInverseGlobalTransform * ci::vec4(globalPoint.x, globalPoint.y, globalPoint.z, 1.0f);
+	ci::vec4 point = inverseGlobal * ci::vec4(globalPoint.x, globalPoint.y, globalPoint.z, 1.0f);
 	return ci::vec3(point.x, point.y, point.z);
 }
 
 ci::vec3 Sprite::localToGlobal(const ci::vec3 &localPoint){
-	buildGlobalTransform();
-	ci::vec4 point = mGlobalTransform * ci::vec4(localPoint.x, localPoint.y, localPoint.z, 1.0f);
+	const ci::mat4& global = mEngine.getSpriteTransforms().getWorld(mTransformHandle);
+	ci::vec4 point = global * ci::vec4(localPoint.x, localPoint.y, localPoint.z, 1.0f);
 	return ci::vec3(point.x, point.y, point.z);
 }
 
@@ -959,13 +1109,13 @@ bool Sprite::contains(const ci::vec3& point, const float pad) const {
 	//May have negative scaling
 	if (mScale.x == 0.0f || mScale.y == 0.0f) return false;
 
-	buildGlobalTransform();
+	const ci::mat4& global = mEngine.getSpriteTransforms().getWorld(mTransformHandle);
 
 	glm::vec4 pR = glm::vec4(point.x, point.y, point.z, 1.0f);
 
-	glm::vec4 cA = mGlobalTransform * glm::vec4(-pad, -pad, 0.0f, 1.0f);
-	glm::vec4 cB = mGlobalTransform * glm::vec4(mWidth + pad, -pad, 0.0f, 1.0f);
-	glm::vec4 cC = mGlobalTransform * glm::vec4(mWidth + pad, mHeight + pad, 0.0f, 1.0f);
+	glm::vec4 cA = global * glm::vec4(-pad, -pad, 0.0f, 1.0f);
+	glm::vec4 cB = global * glm::vec4(mWidth + pad, -pad, 0.0f, 1.0f);
+	glm::vec4 cC = global * glm::vec4(mWidth + pad, mHeight + pad, 0.0f, 1.0f);
 
 	glm::vec4 v1 = cA - cB;
 	glm::vec4 v2 = cC - cB;
@@ -1081,7 +1231,7 @@ void Sprite::processTouchInfo(const TouchInfo &touchInfo) {
 
 void Sprite::move(const ci::vec3 &delta) {
 	mPosition += delta;
-	mUpdateTransform = true;
+	markTransformDirty();
 	mBoundsNeedChecking = true;
 	// XXX This REALLY should be going through doSetPosition().
 	// Don't know what the original thought was, but now I'm
@@ -1092,7 +1242,7 @@ void Sprite::move(const ci::vec3 &delta) {
 
 void Sprite::move( float deltaX, float deltaY, float deltaZ ) {
 	mPosition += ci::vec3(deltaX, deltaY, deltaZ);
-	mUpdateTransform = true;
+	markTransformDirty();
 	mBoundsNeedChecking = true;
 	// XXX This REALLY should be going through doSetPosition().
 	// Don't know what the original thought was, but now I'm
@@ -1105,8 +1255,8 @@ bool Sprite::multiTouchEnabled() const {
 	return mMultiTouchEnabled;
 }
 
-const ci::mat4& Sprite::getInverseGlobalTransform() const {
-	return mInverseGlobalTransform;
+ci::mat4 Sprite::getInverseGlobalTransform() const {
+	return mEngine.getSpriteTransforms().getInverseWorld(mTransformHandle);
 }
 
 const ci::mat4& Sprite::getInverseTransform() const {
@@ -1209,6 +1359,26 @@ void Sprite::cancelDelayedCall(){
 	}
 }
 
+size_t Sprite::timedCallback(const std::function<void(void)>& fn, const double delay_in_seconds){
+	if(!fn) return 0;
+	if(!mTimers) mTimers.reset(new ds::time::TimerWheel::Scope(mEngine.getTimerWheel()));
+	return mTimers->scheduleIn(delay_in_seconds, fn);
+}
+
+size_t Sprite::repeatedCallback(const std::function<void(void)>& fn, const double every_seconds){
+	if(!fn) return 0;
+	if(!mTimers) mTimers.reset(new ds::time::TimerWheel::Scope(mEngine.getTimerWheel()));
+	return mTimers->scheduleIn(every_seconds, fn, every_seconds > 0.0 ? every_seconds : ds::time::TimerWheel::TICK_MICROS / 1000000.0);
+}
+
+void Sprite::cancelTimedCallback(const size_t callbackId){
+	if(mTimers) mTimers->cancel(callbackId);
+}
+
+void Sprite::cancelAllTimedCallbacks(){
+	if(mTimers) mTimers->cancelAll();
+}
+
 bool Sprite::checkBounds() const {
 	if(!mCheckBounds)
 		return true;
@@ -1230,12 +1400,12 @@ bool Sprite::checkBounds() const {
 
 	ci::vec3 positions[4];
 
-	buildGlobalTransform();
+	const ci::mat4& global = mEngine.getSpriteTransforms().getWorld(mTransformHandle);
 
-	positions[0] = glm::vec3(mGlobalTransform * glm::vec4(spriteMinX, spriteMinY, 0.0f, 1.0f));
-	positions[1] = glm::vec3(mGlobalTransform * glm::vec4(spriteMaxX, spriteMinY, 0.0f, 1.0f));
-	positions[2] = glm::vec3(mGlobalTransform * glm::vec4(spriteMinX, spriteMaxY, 0.0f, 1.0f));
-	positions[3] = glm::vec3(mGlobalTransform * glm::vec4(spriteMaxX, spriteMaxY, 0.0f, 1.0f));
+	positions[0] = glm::vec3(global * glm::vec4(spriteMinX, spriteMinY, 0.0f, 1.0f));
+	positions[1] = glm::vec3(global * glm::vec4(spriteMaxX, spriteMinY, 0.0f, 1.0f));
+	positions[2] = glm::vec3(global * glm::vec4(spriteMinX, spriteMaxY, 0.0f, 1.0f));
+	positions[3] = glm::vec3(global * glm::vec4(spriteMaxX, spriteMaxY, 0.0f, 1.0f));
 
 
 	spriteMinX = spriteMaxX = positions[0].x;
@@ -1322,6 +1492,118 @@ bool Sprite::inBounds() const {
 	return mInBounds;
 }
 
+namespace {
+// Axis-aligned bounds of the rect after it's transformed. Only x and y matter in an ortho view.
+ci::Rectf transformed_bounds(const ci::mat4& m, const ci::Rectf& r) {
+	const ci::vec4	corners[4] = { ci::vec4(r.x1, r.y1, 0.0f, 1.0f), ci::vec4(r.x2, r.y1, 0.0f, 1.0f),
+								   ci::vec4(r.x2, r.y2, 0.0f, 1.0f), ci::vec4(r.x1, r.y2, 0.0f, 1.0f) };
+	ci::vec4		p = m * corners[0];
+	ci::Rectf		ans(p.x, p.y, p.x, p.y);
+	for(int i = 1; i < 4; ++i) {
+		p = m * corners[i];
+		ans.include(ci::vec2(p.x, p.y));
+	}
+	return ans;
+}
+
+// Edges count as touching, so nothing that might show a pixel is culled. An inverted
+// cull rect means a clipping ancestor left nothing visible.
+bool overlaps_cull_rect(const ci::Rectf& bounds, const ci::Rectf& cull) {
+	if(cull.x1 > cull.x2 || cull.y1 > cull.y2) return false;
+	return bounds.x1 <= cull.x2 && cull.x1 <= bounds.x2 && bounds.y1 <= cull.y2 && cull.y1 <= bounds.y2;
+}
+}
+
+bool Sprite::isCulled() const {
+	// Children of a culled sprite aren't visited, so their own flag can be out of date
+	for(const Sprite* s = this; s; s = s->mParent) {
+		if(s->mCulled) return true;
+	}
+	return false;
+}
+
+void Sprite::setSkipUpdateWhenCulled(const bool skip) {
+	mSkipUpdateWhenCulled = skip;
+}
+
+bool Sprite::getSkipUpdateWhenCulled() const {
+	return mSkipUpdateWhenCulled;
+}
+
+const ci::Rectf& Sprite::getSubtreeBounds() {
+	if(!mSubtreeBoundsDirty) return mSubtreeBounds;
+	mSubtreeBoundsDirty = false;
+
+	mSubtreeBoundsEmpty = (mWidth == 0.0f && mHeight == 0.0f);
+	mSubtreeBounds = ci::Rectf(0.0f, 0.0f, mWidth, mHeight).canonicalized();
+	// A sprite with no size that still draws itself could be drawing anywhere
+	mSubtreeUnbounded = mSubtreeBoundsEmpty && (mSpriteFlags&TRANSPARENT_F) == 0;
+
+	// Nothing a child draws can end up outside a clipping sprite or an fbo
+	const bool		contained = (mSpriteFlags&CLIP_F) != 0 || (mIsRenderFinalToTexture && mOutputFbo);
+	if(!contained && !mSubtreeUnbounded) {
+		for(auto it = mChildren.begin(), end = mChildren.end(); it != end; ++it) {
+			Sprite*				child = *it;
+			if(!child || !child->visible()) continue;
+			const ci::Rectf&	childBounds = child->getSubtreeBounds();
+			if(child->mSubtreeUnbounded) {
+				mSubtreeUnbounded = true;
+				break;
+			}
+			if(child->mSubtreeBoundsEmpty) continue;
+			child->buildTransform();
+			const ci::Rectf		r = transformed_bounds(child->mTransformation, childBounds);
+			if(mSubtreeBoundsEmpty) {
+				mSubtreeBounds = r;
+				mSubtreeBoundsEmpty = false;
+			} else {
+				mSubtreeBounds.include(r);
+			}
+		}
+	}
+	if(mSubtreeBoundsEmpty || mSubtreeUnbounded) mSubtreeBounds = ci::Rectf::zero();
+	return mSubtreeBounds;
+}
+
+bool Sprite::getSubtreeUnbounded() {
+	getSubtreeBounds();
+	return mSubtreeUnbounded;
+}
+
+void Sprite::markSubtreeBoundsDirty() {
+	// A clean sprite never has a dirty parent, so stop at the first one that's already dirty
+	for(Sprite* s = this; s && !s->mSubtreeBoundsDirty; s = s->mParent) {
+		s->mSubtreeBoundsDirty = true;
+	}
+}
+
+bool Sprite::cullSubtree(const ci::mat4& totalTransformation, const DrawParams& drawParams) {
+	mCulled = false;
+	// Render-to-texture output can be used elsewhere, so it always gets drawn
+	if(mPerspective || (mIsRenderFinalToTexture && mOutputFbo)) return false;
+
+	const ci::Rectf&	bounds = getSubtreeBounds();
+	// Sprites without a size can still draw something, there's just no telling where
+	if(mSubtreeBoundsEmpty || mSubtreeUnbounded) return false;
+
+	mCulled = !overlaps_cull_rect(transformed_bounds(totalTransformation, bounds), drawParams.mCullRect);
+	return mCulled;
+}
+
+void Sprite::cullChildParams(DrawParams& childParams) {
+	if(mIsRenderFinalToTexture && mOutputFbo) {
+		// The children draw into the fbo, not the window
+		childParams.mCull = false;
+	} else if((mSpriteFlags&CLIP_F) != 0) {
+		const ci::Rectf&	clip = getClippingBounds();
+		ci::Rectf&			cull = childParams.mCullRect;
+		cull.x1 = std::max(cull.x1, std::min(clip.x1, clip.x2));
+		cull.y1 = std::max(cull.y1, std::min(clip.y1, clip.y2));
+		cull.x2 = std::min(cull.x2, std::max(clip.x1, clip.x2));
+		cull.y2 = std::min(cull.y2, std::max(clip.y1, clip.y2));
+	}
+}
+
 bool Sprite::isLoaded() const {
 	return true;
 }
@@ -1494,6 +1776,8 @@ void Sprite::readAttributesFrom(ds::DataBuffer& buf) {
 			transformChanged = true;
 		} else if (id == FLAGS_ATT) {
 			mSpriteFlags = buf.read<int>();
+			markSubtreeBoundsDirty();
+			if(mParent) mParent->markSubtreeBoundsDirty();
 			// This is being read here because I do not want to introduce a
 			// new dirty state and the previous code already sets flag to false.
 			// This is a no-op if it's the same shader.
@@ -1558,7 +1842,7 @@ void Sprite::readAttributesFrom(ds::DataBuffer& buf) {
 	}
 
 	if (transformChanged) {
-		mUpdateTransform = true;
+		markTransformDirty();
 		mBoundsNeedChecking = true;
 		dimensionalStateChanged();
 	}
@@ -1581,6 +1865,12 @@ void Sprite::setFlag(const int newBit, const bool on, const DirtyState& dirty, i
 
 	oldFlags = newFlags;
 	markAsDirty(dirty);
+
+	if((newBit & (VISIBLE_F | CLIP_F | TRANSPARENT_F)) != 0 && &oldFlags == &mSpriteFlags) {
+		markSubtreeBoundsDirty();
+		// A hidden child isn't part of the parent's bounds, and might not have been kept up to date
+		if(mParent) mParent->markSubtreeBoundsDirty();
+	}
 }
 
 bool Sprite::getFlag(const int bit, const int flags) const {
@@ -1676,6 +1966,7 @@ void Sprite::setShaderExtraData(const ci::vec4& data){
 void Sprite::setFinalRenderToTexture(bool render_to_texture){
 	if (render_to_texture == mIsRenderFinalToTexture) return;
 	mIsRenderFinalToTexture = render_to_texture;
+	markSubtreeBoundsDirty();
 
 	setupFinalRenderBuffer();
 
@@ -1766,7 +2057,12 @@ void Sprite::computeClippingBounds(){
 }
 
 void Sprite::dimensionalStateChanged(){
+	if(mDeferDimensionalState) {
+		mDimensionalStateDeferred = true;
+		return;
+	}
 	markClippingDirty();
+	markSubtreeBoundsDirty();
 	if (mLastWidth != mWidth || mLastHeight != mHeight) {
 		mLastWidth = mWidth;
 		mLastHeight = mHeight;
@@ -2028,11 +2324,11 @@ void Sprite::writeState(std::ostream &s, const size_t tab) const {
 	s << std::endl;
 	// Global transform
 	for (size_t k=0; k<tab+2; ++k) s << "\t";
-	s << "STATE global_tx=" << mGlobalTransform;
+	s << "STATE global_tx=" << getGlobalTransform();
 	s << std::endl;
 	// Global inverse transform
 	for (size_t k=0; k<tab+2; ++k) s << "\t";
-	s << "STATE gl_inv_tx=" << mInverseGlobalTransform;
+	s << "STATE gl_inv_tx=" << getInverseGlobalTransform();
 	s << std::endl;
 }
 
@@ -21,9 +21,12 @@
 #include "ds/ui/touch/touch_process.h"
 #include "ds/ui/touch/multi_touch_constraints.h"
 #include "ds/ui/tween/sprite_anim.h"
+#include "ds/ui/sprite/util/sprite_transforms.h"
+#include "ds/ui/tween/sprite_tweens.h"
 #include "ds/ui/sprite/shader/sprite_shader.h"
 #include "ds/ui/sprite/util/blend.h"
 #include "ds/util/idle_timer.h"
+#include "ds/util/slab_pool.h"
 #include "ds/debug/debug_defines.h"
 #include "ds/app/blob_reader.h"
 #include "ds/data/data_buffer.h"
@@ -40,6 +43,7 @@ class Event;
 class UpdateParams;
 
 namespace ui {
+	class SpriteDrawList;
 	struct DragDestinationInfo;
 	struct TapInfo;
 	struct TouchInfo;
@@ -86,6 +90,12 @@ namespace ui {
 		Sprite(SpriteEngine& engine, float width = 0.0f, float height = 0.0f);
 		virtual ~Sprite();
 
+		/** Sprites (and subclasses) come from size-classed slabs instead of the general heap,
+			which keeps constant creating and releasing from fragmenting it. See ds::SlabPool.	*/
+		static void*			operator new(const size_t);
+		static void				operator delete(void*, const size_t);
+		static ds::SlabPool::Stats	getAllocationStats();
+
 		/** Update function for when this app is set to be a client.
 			Don't override this function, use onUpdateClient if you need it
 			\param updateParams UpdateParams containing some conveniences such as delta time.		*/
@@ -124,6 +134,13 @@ namespace ui {
 			\param drawParams Parameters for drawing, such as the opacity of the parent.		*/
 		virtual void			drawServer(const ci::mat4 &transformMatrix, const DrawParams &drawParams);
 
+		/** Client drawing through a SpriteDrawList: add this sprite and its children to the list instead of drawing them.
+			Sprites that override drawClient() should override this to call SpriteDrawList::addSubtree().
+			\param drawList The list being compiled.
+			\param transformMatrix The transform matrix of the parent.
+			\param drawParams Parameters for drawing, such as the opacity of the parent.		*/
+		virtual void			compileDrawList(SpriteDrawList& drawList, const ci::mat4 &transformMatrix, const DrawParams &drawParams);
+
 		/** Returns the unique id for this Sprite. The SpriteEngine will automatically generate an id for the sprite when constructed.
 			We recommend you use references or pointers to keep track of sprites, rather than looking up by Id.
 			\return Unique sprite id.		*/
@@ -346,8 +363,9 @@ namespace ui {
 
 		const ci::mat4&			getTransform() const;
 		const ci::mat4&			getInverseTransform() const;
-		const ci::mat4&			getGlobalTransform() const;
-		const ci::mat4&			getInverseGlobalTransform() const;
+		/// Kept up to date by the engine's SpriteTransforms, so these are cheap once per frame
+		ci::mat4				getGlobalTransform() const;
+		ci::mat4				getInverseGlobalTransform() const;
 
 		/** Arbitrary data (float's and int's) on this sprite. See UserData for storage usage. */
 		ds::UserData&			getUserData();
@@ -571,10 +589,30 @@ namespace ui {
 
 		void					callAfterDelay(const std::function<void(void)>&, const float delay_in_seconds);
 		void					cancelDelayedCall();
+		/// Like SpriteEngine::timedCallback() and repeatedCallback(), but the timer is cancelled when this sprite
+		/// is released, so the function can safely use the sprite. Answers an id for cancelTimedCallback().
+		size_t					timedCallback(const std::function<void(void)>&, const double delay_in_seconds);
+		size_t					repeatedCallback(const std::function<void(void)>&, const double every_seconds);
+		void					cancelTimedCallback(const size_t callbackId);
+		void					cancelAllTimedCallbacks();
 
 		bool					inBounds() const;
 		void					setCheckBounds(bool checkBounds);
 		bool					getCheckBounds() const;
+		/** With "render:cull_offscreen" on, a sprite whose subtree is entirely outside the window or its clipping
+			ancestors isn't drawn, and neither are its children.
+			\return True if this sprite or an ancestor was culled the last time it would have been drawn.		*/
+		bool					isCulled() const;
+		/** Also skip the children and onUpdateClient() / onUpdateServer() while isCulled(). Touches and the idle
+			timer are still processed. Off by default, since nothing in those updates can bring the sprite back.		*/
+		void					setSkipUpdateWhenCulled(const bool skip);
+		bool					getSkipUpdateWhenCulled() const;
+		/** The area this sprite and its visible children cover, in local space. Cached until something in the
+			subtree moves, resizes, shows or hides. Clipping sprites only cover their own size. A sprite with no
+			size that isn't transparent could draw anywhere, so it and its ancestors get a zero rect and are never culled.		*/
+		const ci::Rectf&		getSubtreeBounds();
+		/// True if something in the subtree could draw anywhere, see getSubtreeBounds()
+		bool					getSubtreeUnbounded();
 		virtual bool			isLoaded() const;
 		void					setDragDestination(Sprite *dragDestination);
 		Sprite*					getDragDestination() const;
@@ -702,14 +740,22 @@ namespace ui {
 		void				processTouchInfoCallback(const TouchInfo &touchInfo);
 
 		void				buildTransform() const;
-		void				buildGlobalTransform() const;
 		virtual void		drawLocalClient();
 		virtual void		drawLocalServer();
+		// Answer true if drawLocalClient() just draws localRect with the base shader and texture, or
+		// nothing if localRect is empty, so a SpriteDrawList can batch it. Only a plain Sprite does by default.
+		virtual bool		getDrawListQuad(ci::Rectf& localRect, ci::gl::TextureRef& texture);
 		bool				hasDoubleTap() const;
 		bool				hasTap() const;
 		bool				hasTapInfo() const;
 		void				updateCheckBounds() const;
 		bool				checkBounds() const;
+		// Call when something changes what getSubtreeBounds() would answer for this sprite
+		void				markSubtreeBoundsDirty();
+		// Test the subtree against drawParams.mCullRect and remember the answer for isCulled()
+		bool				cullSubtree(const ci::mat4& totalTransformation, const DrawParams&);
+		// Narrow the cull rect that children are drawn with
+		void				cullChildParams(DrawParams&);
 
 		// Once the sprite has passed the getHit() sprite bounds, this is a second
 		// stage that allows the sprite itself to determine if the point is interior,
@@ -777,6 +823,12 @@ namespace ui {
 
 		mutable bool			mBoundsNeedChecking;
 		mutable bool			mInBounds;
+		ci::Rectf				mSubtreeBounds;
+		bool					mSubtreeBoundsEmpty;
+		bool					mSubtreeUnbounded;
+		bool					mSubtreeBoundsDirty;
+		bool					mCulled;
+		bool					mSkipUpdateWhenCulled;
 
 
 		SpriteEngine&			mEngine;
@@ -805,6 +857,9 @@ namespace ui {
 		bool					mClippingBoundsDirty;
 
 		bool					mNeedsBatchUpdate;
+		// Set while applyTweenedValues() holds back dimensionalStateChanged()
+		bool					mDeferDimensionalState;
+		bool					mDimensionalStateDeferred;
 		ci::gl::BatchRef		mRenderBatch;
 		SpriteShader			mSpriteShader;
 
@@ -814,8 +869,8 @@ namespace ui {
 
 		ci::vec4				mShaderExtraData;
 
-		mutable ci::mat4		mGlobalTransform;
-		mutable ci::mat4		mInverseGlobalTransform;
+		// The world transforms live in the engine's SpriteTransforms
+		SpriteTransforms::Handle	mTransformHandle;
 
 		ds::UserData			mUserData;
 
@@ -862,6 +917,9 @@ namespace ui {
 
 		friend class ds::Engine;
 		friend class ds::EngineRoot;
+		friend class SpriteTweens;
+		friend class SpriteDrawList;
+		friend class SpriteTransforms;
 		// Disable copy constructor; sprites are managed by their parent and
 		// must be allocated
 		Sprite(const Sprite&);
@@ -872,7 +930,15 @@ namespace ui {
 		void				init(const ds::sprite_id_t);
 		void				readAttributesFrom(ds::DataBuffer&);
 
+		// Everything drawClient() does for this sprite alone, once the model matrix is set
+		void				drawSelfClient(const DrawParams&);
 		void				dimensionalStateChanged();
+		// Call instead of setting mUpdateTransform, so the world transforms below are rebuilt too
+		void				markTransformDirty();
+		void				updateTransformParent();
+		// Assign everything the SpriteTweens calculated this frame through the setters, with one
+		// dimensionalStateChanged() at the end instead of one per property
+		void				applyTweenedValues(const int channels, const SpriteTweens::Values&);
 		// Applies to all children, too.
 		void				markClippingDirty();
 		// Store all children in mSortedTmp by z order.
@@ -906,6 +972,9 @@ namespace ui {
 		// Store a CueRef from the cinder timeline to clear the callAfterDelay() function
 		// Cleared automatically on destruction
 		ci::CueRef			mDelayedCallCueRef;
+		// The timedCallback() timers, made on the first one
+		std::unique_ptr<ds::time::TimerWheel::Scope>
+							mTimers;
 
 		// For debugging, and in a super-duper pinch, in production. 
 		std::wstring		mSpriteName;
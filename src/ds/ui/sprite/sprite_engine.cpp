@@ -17,7 +17,6 @@ namespace ui {
 SpriteEngine::SpriteEngine(ds::EngineData& ed)
 	: mData(ed)
 	, mRegisteredEntryField(nullptr)
-	, mCallbackId(0)
 	, mMetricsService(nullptr)
 {
 	mComputerInfo = new ds::ComputerInfo();
@@ -241,45 +240,15 @@ ds::ui::IEntryField* SpriteEngine::getRegisteredEntryField(){
 
 
 size_t SpriteEngine::timedCallback(std::function<void()> func, const double timerSeconds) {
-	auto theCallback = new ds::time::Callback(*this);
-	if(theCallback) {
-		DS_LOG_WARNING("Couldn't create a timed callback! That's a big deal!");
-		return 0;
-	}
-	mTimedCallbacks.emplace_back(theCallback);
-	auto wrappedCallback = [this, func, theCallback] {
-		func();
-		for(auto it = mTimedCallbacks.begin(); it < mTimedCallbacks.end(); it++) {
-			if((*it) == theCallback) {
-				mTimedCallbacks.erase(it);
-				break;
-			}
-		}
-	};
-
-	theCallback->timedCallback(wrappedCallback, timerSeconds);
-
-	return theCallback->getId();
+	return mTimerWheel.scheduleIn(timerSeconds, func);
 }
 
 size_t SpriteEngine::repeatedCallback(std::function<void()> func, const double timerSeconds) {
-	auto theCallback = new ds::time::Callback(*this);
-	if(!theCallback) {
-		DS_LOG_WARNING("Couldn't create a repeated callback! That's a big deal!");
-		return 0;
-	}
-	mTimedCallbacks.emplace_back(theCallback);
-	return theCallback->repeatedCallback(func, timerSeconds);
+	return mTimerWheel.scheduleIn(timerSeconds, func, timerSeconds > 0.0 ? timerSeconds : ds::time::TimerWheel::TICK_MICROS / 1000000.0);
 }
 
 void SpriteEngine::cancelTimedCallback(size_t callbackId) {
-	for(auto it = mTimedCallbacks.begin(); it < mTimedCallbacks.end(); it++) {
-		if((*it)->getId() == callbackId) {
-			(*it)->cancel();
-			mTimedCallbacks.erase(it);
-			break;
-		}
-	}
+	mTimerWheel.cancel(callbackId);
 }
 
 void SpriteEngine::recordMetric(const std::string& metricName, const std::string& fieldName, const std::string& fieldValue) {
@@ -10,6 +10,7 @@
 #include <cinder/app/Window.h>
 #include "ds/app/app_defs.h"
 #include "ds/time/time_callback.h"
+#include "ds/time/timer_wheel.h"
 #include <memory>
 
 namespace ds {
@@ -34,11 +35,18 @@ class Text;
 
 class TuioObject;
 
+namespace net {
+class IoReactor;
+}
+
 namespace ui {
 class IEntryField;
 class LoadImageService;
 class PangoFontService;
+class ShaderService;
 class Sprite;
+class SpriteTransforms;
+class ThumbnailService;
 class Tweenline;
 class TouchEvent;
 struct TouchInfo;
@@ -64,9 +72,17 @@ public:
 	virtual const ds::FontList&		getFonts() const = 0;
 	virtual ds::AutoUpdateList&		getAutoUpdateList(const int = AutoUpdateType::SERVER) = 0;
 	virtual LoadImageService&		getLoadImageService() = 0;
+	/// Small cached copies of big images, for showing them small
+	virtual ThumbnailService&		getThumbnailService() = 0;
 	virtual PangoFontService&		getPangoFontService() = 0;
+	/// Compiles and caches sprite shader programs
+	virtual ShaderService&			getShaderService() = 0;
+	/// One thread that waits on sockets and timers for anything that would otherwise poll
+	virtual ds::net::IoReactor&		getIoReactor() = 0;
 	virtual ds::ImageRegistry&		getImageRegistry() = 0;
 	virtual Tweenline&				getTweenline() = 0;
+	/// The world transforms of every sprite
+	virtual SpriteTransforms&		getSpriteTransforms() = 0;
 	virtual ci::app::WindowRef		getWindow() = 0;
 
 	bool							getMute();
@@ -220,6 +236,9 @@ public:
 	/// Cancels a timedCallback() or a repeatedCallback() using the return value from above
 	void							cancelTimedCallback(size_t callbackId);
 
+	/// The wheel behind timedCallback(), repeatedCallback() and ds::time::Callback. Advanced once per server update.
+	ds::time::TimerWheel&			getTimerWheel() { return mTimerWheel; }
+
 	/// Get the service that saves metrics, to easily record multiple types
 	MetricsService*					getMetrics() { return mMetricsService; }
 
@@ -263,9 +282,7 @@ protected:
 	std::unordered_map<std::string, std::function<ds::ui::Sprite*(ds::ui::SpriteEngine&)>> mImporterMap;
 	std::unordered_map<std::string, std::function<void(ds::ui::Sprite& theSprite, const std::string& theValue, const std::string& fileRefferer)>> mPropertyMap;
 
-	friend class ds::time::Callback;
-	std::vector<ds::time::Callback*>	mTimedCallbacks;
-	size_t							mCallbackId; // for tracking the above
+	ds::time::TimerWheel			mTimerWheel;
 
 private:
 	ds::EngineService&				private_getService(const std::string&);
@@ -13,6 +13,7 @@
 #include "ds/app/blob_reader.h"
 #include "ds/app/blob_registry.h"
 #include "ds/data/data_buffer.h"
+#include "ds/debug/frame_profiler.h"
 #include "ds/debug/logger.h"
 #include "ds/ui/sprite/sprite_engine.h"
 #include "ds/ui/service/pango_font_service.h"
@@ -500,6 +501,7 @@ void Text::onUpdateServer(const UpdateParams&){
 
 bool Text::measurePangoText() {
 	if(mNeedsFontUpdate || mNeedsMeasuring || mNeedsTextRender || mNeedsMarkupDetection) {
+		DS_PROFILE_ZONE("text_layout");
 
 		if(mText.empty() || mTextSize <= 0.0f){
 			if(mWidth > 0.0f || mHeight > 0.0f){
@@ -690,6 +692,7 @@ void Text::renderPangoText(){
 	int extraTextureSize = (int)mTextSize;
 
 	if(mNeedsTextRender && mPixelWidth > 0 && mPixelHeight > 0) {
+		DS_PROFILE_ZONE("text_render");
 		// Create appropriately sized cairo surface
 		const bool grayscale = false; // Not really supported
 		_cairo_format cairoFormat = grayscale ? CAIRO_FORMAT_A8 : CAIRO_FORMAT_ARGB32;
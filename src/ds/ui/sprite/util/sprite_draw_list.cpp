@@ -0,0 +1,182 @@
+#include "stdafx.h"
+
+#include "ds/ui/sprite/util/sprite_draw_list.h"
+
+#include <cstddef>
+#include <cinder/gl/gl.h>
+#include "ds/debug/debug_defines.h"
+#include "ds/ui/sprite/sprite.h"
+#include "ds/ui/sprite/util/blend.h"
+#include "ds/ui/sprite/util/clip_plane.h"
+
+namespace ds {
+namespace ui {
+
+namespace {
+typedef ds::gl::DrawList::Vertex	Vertex;
+
+void						set_attrib(const ci::gl::GlslProgRef& shader, const ci::geom::Attrib attrib, const GLint size, const size_t offset) {
+	const int				loc = shader->getAttribSemanticLocation(attrib);
+	if(loc < 0) return;
+	ci::gl::enableVertexAttribArray(loc);
+	ci::gl::vertexAttribPointer(loc, size, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<const GLvoid*>(offset));
+}
+}
+
+/**
+ * \class ds::ui::SpriteDrawList
+ */
+SpriteDrawList::SpriteDrawList()
+		: mIndexedQuads(0) {
+}
+
+void SpriteDrawList::compile(Sprite& root, const ci::mat4& trans, const DrawParams& params) {
+	mList.clear();
+	mCustom.clear();
+	mShaders.clear();
+	mTextures.clear();
+	root.compileDrawList(*this, trans, params);
+	mList.compile();
+}
+
+void SpriteDrawList::draw() {
+	mList.execute(*this);
+}
+
+void SpriteDrawList::addQuad(const ci::mat4& trans, const ci::Rectf& r, const ci::gl::TextureRef& texture,
+							 const ci::gl::GlslProgRef& shader, const int blendMode, const ci::ColorA& color) {
+	// Same texture coordinates as ci::gl::drawSolidRect() and ci::geom::Rect
+	ds::gl::DrawList::Quad	q;
+	q.mCorner[0] = ci::vec3(trans * ci::vec4(r.x1, r.y1, 0.0f, 1.0f));
+	q.mCorner[1] = ci::vec3(trans * ci::vec4(r.x2, r.y1, 0.0f, 1.0f));
+	q.mCorner[2] = ci::vec3(trans * ci::vec4(r.x2, r.y2, 0.0f, 1.0f));
+	q.mCorner[3] = ci::vec3(trans * ci::vec4(r.x1, r.y2, 0.0f, 1.0f));
+	q.mTexCoord[0] = ci::vec2(0.0f, 1.0f);
+	q.mTexCoord[1] = ci::vec2(1.0f, 1.0f);
+	q.mTexCoord[2] = ci::vec2(1.0f, 0.0f);
+	q.mTexCoord[3] = ci::vec2(0.0f, 0.0f);
+	q.mColor = color;
+	q.mShader = shader.get();
+	q.mTexture = texture.get();
+	q.mBlend = blendMode;
+	mList.addQuad(q);
+
+	mShaders[q.mShader] = shader;
+	if(texture) mTextures[q.mTexture] = texture;
+}
+
+void SpriteDrawList::addSprite(Sprite& s, const ci::mat4& totalTransform, const DrawParams& params) {
+	Custom					c;
+	c.mSprite = &s;
+	c.mTransform = totalTransform;
+	c.mParams = params;
+	c.mSubtree = false;
+	mList.addCustom(static_cast<uint32_t>(mCustom.size()));
+	mCustom.push_back(c);
+}
+
+void SpriteDrawList::addSubtree(Sprite& s, const ci::mat4& trans, const DrawParams& params) {
+	Custom					c;
+	c.mSprite = &s;
+	c.mTransform = trans;
+	c.mParams = params;
+	c.mSubtree = true;
+	mList.addCustom(static_cast<uint32_t>(mCustom.size()));
+	mCustom.push_back(c);
+}
+
+void SpriteDrawList::begin(const std::vector<Vertex>& vertices) {
+	if(vertices.empty()) return;
+
+	const size_t			bytes = vertices.size() * sizeof(Vertex);
+	if(!mVertices || mVertices->getSize() < bytes) {
+		mVertices = ci::gl::Vbo::create(GL_ARRAY_BUFFER, bytes * 2, nullptr, GL_STREAM_DRAW);
+	}
+	mVertices->bufferSubData(0, bytes, vertices.data());
+
+	// Two triangles per quad. The pattern never changes, so it's only rebuilt when there are more quads.
+	const size_t			quads = vertices.size() / 4;
+	if(!mIndices || mIndexedQuads < quads) {
+		mIndexedQuads = quads * 2;
+		std::vector<uint32_t>	indices;
+		indices.reserve(mIndexedQuads * 6);
+		for(uint32_t q = 0; q < mIndexedQuads; ++q) {
+			const uint32_t	v = q * 4;
+			indices.push_back(v);
+			indices.push_back(v + 1);
+			indices.push_back(v + 2);
+			indices.push_back(v);
+			indices.push_back(v + 2);
+			indices.push_back(v + 3);
+		}
+		mIndices = ci::gl::Vbo::create(GL_ELEMENT_ARRAY_BUFFER, indices, GL_STATIC_DRAW);
+	}
+	if(!mVao) mVao = ci::gl::Vao::create();
+}
+
+void SpriteDrawList::drawQuads(const ds::gl::DrawList::Command& cmd) {
+	auto					shader = mShaders.find(cmd.mShader);
+	if(shader == mShaders.end() || !shader->second || cmd.mCount < 4) return;
+	ci::gl::TextureRef		texture;
+	if(cmd.mTexture) {
+		auto				found = mTextures.find(cmd.mTexture);
+		if(found != mTextures.end()) texture = found->second;
+	}
+	DS_REPORT_GL_ERRORS();
+
+	// The same state Sprite::drawClient() sets up for each of these sprites
+	const BlendMode			blendMode = static_cast<BlendMode>(cmd.mBlend);
+	ci::gl::enableAlphaBlending();
+	applyBlendingMode(blendMode);
+	ci::gl::disableDepthRead();
+	ci::gl::disableDepthWrite();
+
+	const ci::gl::GlslProgRef&	prog = shader->second;
+	prog->bind();
+	prog->uniform("tex0", 0);
+	prog->uniform("useTexture", texture != nullptr);
+	prog->uniform("preMultiply", premultiplyAlpha(blendMode));
+	clip_plane::passClipPlanesToShader(prog);
+	if(texture) texture->bind(0);
+
+	{
+		ci::gl::ScopedVao		vao(mVao);
+		ci::gl::ScopedBuffer	vbo(mVertices);
+		set_attrib(prog, ci::geom::Attrib::POSITION, 3, offsetof(Vertex, mPosition));
+		set_attrib(prog, ci::geom::Attrib::TEX_COORD_0, 2, offsetof(Vertex, mTexCoord));
+		set_attrib(prog, ci::geom::Attrib::COLOR, 4, offsetof(Vertex, mColor));
+		ci::gl::ScopedBuffer	ibo(mIndices);
+		ci::gl::setDefaultShaderVars();
+		const size_t			firstIndex = cmd.mFirst / 4 * 6;
+		ci::gl::drawElements(GL_TRIANGLES, static_cast<GLsizei>(cmd.mCount / 4 * 6), GL_UNSIGNED_INT,
+							 reinterpret_cast<const GLvoid*>(firstIndex * sizeof(uint32_t)));
+	}
+
+	if(texture) texture->unbind(0);
+	DS_REPORT_GL_ERRORS();
+}
+
+void SpriteDrawList::drawCustom(const uint32_t payload) {
+	if(payload >= mCustom.size()) return;
+	const Custom&			c = mCustom[payload];
+	if(c.mSubtree) {
+		c.mSprite->drawClient(c.mTransform, c.mParams);
+		return;
+	}
+
+	ci::gl::pushModelMatrix();
+	ci::gl::multModelMatrix(c.mTransform);
+	c.mSprite->drawSelfClient(c.mParams);
+	ci::gl::popModelMatrix();
+}
+
+void SpriteDrawList::pushClip(const ci::Rectf& r) {
+	clip_plane::enableClipping(r.getX1(), r.getY1(), r.getX2(), r.getY2());
+}
+
+void SpriteDrawList::popClip() {
+	clip_plane::disableClipping();
+}
+
+} // namespace ui
+} // namespace ds
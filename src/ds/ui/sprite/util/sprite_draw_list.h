@@ -0,0 +1,81 @@
+#pragma once
+#ifndef DS_UI_SPRITE_UTIL_SPRITEDRAWLIST_H_
+#define DS_UI_SPRITE_UTIL_SPRITEDRAWLIST_H_
+
+#include <unordered_map>
+#include <vector>
+#include <cinder/gl/GlslProg.h>
+#include <cinder/gl/Texture.h>
+#include <cinder/gl/Vao.h>
+#include <cinder/gl/Vbo.h>
+#include "ds/gl/draw_list.h"
+#include "ds/params/draw_params.h"
+
+namespace ds {
+namespace ui {
+class Sprite;
+
+/**
+ * \class ds::ui::SpriteDrawList
+ * \brief Draws a sprite tree through a ds::gl::DrawList. Sprites that are plain
+ * rectangles with the base shader (solid sprites and images) are batched; everything
+ * else draws itself as usual, in the same order and with the same clipping.
+ * Used by the ortho roots when "render:draw_list" is on in the engine settings.
+ */
+class SpriteDrawList : public ds::gl::DrawBackend {
+public:
+	SpriteDrawList();
+
+	/// Rebuild the list from the sprite and its children
+	void						compile(Sprite& root, const ci::mat4& trans, const DrawParams&);
+	/// Draw the last compile()
+	void						draw();
+
+	const ds::gl::DrawList&		getDrawList() const { return mList; }
+
+	/// Called by Sprite::compileDrawList()
+	void						addQuad(const ci::mat4& trans, const ci::Rectf& localRect, const ci::gl::TextureRef&,
+										const ci::gl::GlslProgRef&, const int blendMode, const ci::ColorA&);
+	/// The sprite draws itself with drawLocalClient(), but its children are still compiled
+	void						addSprite(Sprite&, const ci::mat4& totalTransform, const DrawParams&);
+	/// The sprite and all its children draw through Sprite::drawClient(), for anything that changes
+	/// render state for a whole subtree. trans is the parent's transform.
+	void						addSubtree(Sprite&, const ci::mat4& trans, const DrawParams&);
+	/// Children added until endClip() are clipped to this
+	void						beginClip(const ci::Rectf& worldClip) { mList.pushClip(worldClip); }
+	void						endClip() { mList.popClip(); }
+
+	// DrawBackend
+	virtual void				begin(const std::vector<ds::gl::DrawList::Vertex>&) override;
+	virtual void				drawQuads(const ds::gl::DrawList::Command&) override;
+	virtual void				drawCustom(const uint32_t payload) override;
+	virtual void				pushClip(const ci::Rectf&) override;
+	virtual void				popClip() override;
+
+private:
+	class Custom {
+	public:
+		Sprite*					mSprite;
+		ci::mat4				mTransform;
+		DrawParams				mParams;
+		bool					mSubtree;
+	};
+
+	ds::gl::DrawList			mList;
+	std::vector<Custom>			mCustom;
+	// Keeps the shaders and textures alive from compile() to draw(), and maps the list's keys back to them
+	std::unordered_map<ds::gl::DrawList::Key, ci::gl::GlslProgRef>
+								mShaders;
+	std::unordered_map<ds::gl::DrawList::Key, ci::gl::TextureRef>
+								mTextures;
+
+	ci::gl::VaoRef				mVao;
+	ci::gl::VboRef				mVertices;
+	ci::gl::VboRef				mIndices;
+	size_t						mIndexedQuads;
+};
+
+} // namespace ui
+} // namespace ds
+
+#endif // DS_UI_SPRITE_UTIL_SPRITEDRAWLIST_H_
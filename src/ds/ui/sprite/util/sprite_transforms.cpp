@@ -0,0 +1,213 @@
+#include "stdafx.h"
+
+#include "ds/ui/sprite/util/sprite_transforms.h"
+
+#include <algorithm>
+#include "ds/ui/sprite/sprite.h"
+
+namespace ds {
+namespace ui {
+
+namespace {
+const uint32_t				DROPPED = 0xFFFFFFFF;
+// Release this many slots before the order is rebuilt just to reclaim them
+const size_t				MIN_DEAD = 64;
+
+template <typename T>
+void						permute(std::vector<T>& v, const std::vector<uint32_t>& newSlot, const size_t live) {
+	std::vector<T>			out(live);
+	for(size_t s = 0; s < v.size(); ++s) {
+		if(newSlot[s] != DROPPED) out[newSlot[s]] = v[s];
+	}
+	v.swap(out);
+}
+}
+
+/**
+ * \class ds::ui::SpriteTransforms
+ */
+SpriteTransforms::SpriteTransforms()
+		: mLastStamp(0)
+		, mDeadCount(0)
+		, mOrderDirty(false)
+		, mClean(true) {
+}
+
+SpriteTransforms::Handle SpriteTransforms::create(const Sprite& s) {
+	Handle					h;
+	if(!mFreeHandles.empty()) {
+		h = mFreeHandles.back();
+		mFreeHandles.pop_back();
+	} else {
+		h = static_cast<Handle>(mSlotOf.size());
+		mSlotOf.push_back(DROPPED);
+	}
+
+	// New slots go on the end, so they're after any parent they're given later
+	mSlotOf[h] = static_cast<uint32_t>(mSprite.size());
+	mSprite.push_back(&s);
+	mHandle.push_back(h);
+	mParent.push_back(DROPPED);
+	mLocalDirty.push_back(1);
+	mLocal.push_back(ci::mat4());
+	mWorld.push_back(ci::mat4());
+	mInverseWorld.push_back(ci::mat4());
+	mStamp.push_back(0);
+	mParentStamp.push_back(0);
+	mInverseStamp.push_back(0);
+	mClean = false;
+	return h;
+}
+
+void SpriteTransforms::release(const Handle h) {
+	if(h >= mSlotOf.size() || mSlotOf[h] == NONE) return;
+	const uint32_t			slot = mSlotOf[h];
+	mSprite[slot] = nullptr;
+	mSlotOf[h] = NONE;
+	mFreeHandles.push_back(h);
+
+	++mDeadCount;
+	if(mDeadCount >= MIN_DEAD && mDeadCount * 4 >= mSprite.size()) mOrderDirty = true;
+}
+
+void SpriteTransforms::setParent(const Handle h, const Handle parent) {
+	const uint32_t			slot = mSlotOf[h];
+	uint32_t				parentSlot = NONE;
+	if(parent != NONE) parentSlot = mSlotOf[parent];
+	if(mParent[slot] == parentSlot) return;
+
+	mParent[slot] = parentSlot;
+	mLocalDirty[slot] = 1;
+	mClean = false;
+	if(parentSlot != NONE && parentSlot > slot) mOrderDirty = true;
+}
+
+void SpriteTransforms::markDirty(const Handle h) {
+	mLocalDirty[mSlotOf[h]] = 1;
+	mClean = false;
+}
+
+const ci::mat4& SpriteTransforms::getWorld(const Handle h) {
+	const uint32_t			slot = mSlotOf[h];
+	if(!mClean) validate(slot);
+	return mWorld[slot];
+}
+
+const ci::mat4& SpriteTransforms::getInverseWorld(const Handle h) {
+	const uint32_t			slot = mSlotOf[h];
+	if(!mClean) validate(slot);
+	if(mInverseStamp[slot] != mStamp[slot]) {
+		mInverseWorld[slot] = glm::inverse(mWorld[slot]);
+		mInverseStamp[slot] = mStamp[slot];
+	}
+	return mInverseWorld[slot];
+}
+
+void SpriteTransforms::update() {
+	if(mOrderDirty) rebuildOrder();
+	if(mClean) return;
+
+	// Parents come first, so each slot only has to look at its parent
+	const uint32_t			count = static_cast<uint32_t>(mSprite.size());
+	for(uint32_t s = 0; s < count; ++s) {
+		if(mSprite[s]) compute(s);
+	}
+	mClean = true;
+}
+
+void SpriteTransforms::validate(const uint32_t slot) {
+	mPath.clear();
+	for(uint32_t s = slot; s != NONE && mSprite[s]; s = mParent[s]) {
+		mPath.push_back(s);
+	}
+	for(auto it = mPath.rbegin(), end = mPath.rend(); it != end; ++it) {
+		compute(*it);
+	}
+}
+
+void SpriteTransforms::compute(const uint32_t s) {
+	bool					changed = false;
+	if(mLocalDirty[s]) {
+		mLocalDirty[s] = 0;
+		const Sprite*		sprite = mSprite[s];
+		sprite->buildTransform();
+		mLocal[s] = sprite->mTransformation;
+		changed = true;
+	}
+
+	const uint32_t			p = mParent[s];
+	const bool				hasParent = (p != NONE && mSprite[p] != nullptr);
+	const uint64_t			parentStamp = (hasParent ? mStamp[p] : 0);
+	if(changed || mStamp[s] == 0 || mParentStamp[s] != parentStamp) {
+		// Root down, the same order drawing composes in
+		mWorld[s] = (hasParent ? mWorld[p] * mLocal[s] : mLocal[s]);
+		mParentStamp[s] = parentStamp;
+		mStamp[s] = ++mLastStamp;
+	}
+}
+
+void SpriteTransforms::rebuildOrder() {
+	mOrderDirty = false;
+	const uint32_t			count = static_cast<uint32_t>(mSprite.size());
+
+	// Depth of every live slot. Anything under a released slot becomes a root.
+	mDepth.assign(count, DROPPED);
+	uint32_t				maxDepth = 0;
+	for(uint32_t s = 0; s < count; ++s) {
+		if(!mSprite[s] || mDepth[s] != NONE) continue;
+
+		mPath.clear();
+		uint32_t			depth = 0;
+		for(uint32_t at = s; ; ) {
+			mPath.push_back(at);
+			const uint32_t	p = mParent[at];
+			if(p == NONE || !mSprite[p]) break;
+			if(mDepth[p] != NONE) {
+				depth = mDepth[p] + 1;
+				break;
+			}
+			at = p;
+		}
+		for(auto it = mPath.rbegin(), end = mPath.rend(); it != end; ++it) {
+			mDepth[*it] = depth++;
+		}
+		maxDepth = std::max(maxDepth, depth - 1);
+	}
+
+	// Stable counting sort by depth
+	std::vector<uint32_t>	next(maxDepth + 2, 0);
+	for(uint32_t s = 0; s < count; ++s) {
+		if(mSprite[s]) ++next[mDepth[s] + 1];
+	}
+	for(size_t d = 1; d < next.size(); ++d) next[d] += next[d - 1];
+	mNewSlot.assign(count, DROPPED);
+	for(uint32_t s = 0; s < count; ++s) {
+		if(mSprite[s]) mNewSlot[s] = next[mDepth[s]]++;
+	}
+
+	for(uint32_t s = 0; s < count; ++s) {
+		const uint32_t		p = mParent[s];
+		if(p == NONE || !mSprite[p]) mParent[s] = NONE;
+		else mParent[s] = mNewSlot[p];
+	}
+
+	const size_t			live = count - mDeadCount;
+	permute(mSprite, mNewSlot, live);
+	permute(mHandle, mNewSlot, live);
+	permute(mParent, mNewSlot, live);
+	permute(mLocalDirty, mNewSlot, live);
+	permute(mLocal, mNewSlot, live);
+	permute(mWorld, mNewSlot, live);
+	permute(mInverseWorld, mNewSlot, live);
+	permute(mStamp, mNewSlot, live);
+	permute(mParentStamp, mNewSlot, live);
+	permute(mInverseStamp, mNewSlot, live);
+	for(uint32_t s = 0; s < live; ++s) {
+		mSlotOf[mHandle[s]] = s;
+	}
+	mDeadCount = 0;
+	mClean = false;
+}
+
+} // namespace ui
+} // namespace ds
@@ -0,0 +1,85 @@
+#pragma once
+#ifndef DS_UI_SPRITE_UTIL_SPRITETRANSFORMS_H_
+#define DS_UI_SPRITE_UTIL_SPRITETRANSFORMS_H_
+
+#include <cstdint>
+#include <vector>
+#include <cinder/Matrix.h>
+
+namespace ds {
+namespace ui {
+class Sprite;
+
+/**
+ * \class ds::ui::SpriteTransforms
+ * \brief The world transforms of every sprite, kept in parallel arrays instead of in each sprite.
+ * Slots are ordered so a parent always comes before its children, which lets update() bring
+ * every world matrix up to date in one pass from front to back. A sprite only holds a handle,
+ * since slots move when the order is rebuilt.
+ *
+ * Each slot remembers the stamp of the parent world it was built from. A world matrix is
+ * current when its local transform hasn't changed and its parent's stamp still matches, so
+ * moving a sprite costs nothing until something asks for a world matrix under it. Asking
+ * between passes only rebuilds the slots on the path up to the root. Owned by the engine.
+ *
+ * A world matrix is the parent's world times the local, composed from the root down the same
+ * way drawClient(), drawServer() and compileDrawList() compose trans * mTransformation.
+ */
+class SpriteTransforms {
+public:
+	typedef uint32_t			Handle;
+	static const Handle			NONE = 0xFFFFFFFF;
+
+	SpriteTransforms();
+
+	Handle						create(const Sprite&);
+	void						release(const Handle);
+	void						setParent(const Handle, const Handle parent);
+	/// The sprite's local transform changed. It's read back through Sprite::buildTransform() when needed.
+	void						markDirty(const Handle);
+
+	const ci::mat4&				getWorld(const Handle);
+	const ci::mat4&				getInverseWorld(const Handle);
+
+	/// Rebuild the order if the tree changed, then bring every world matrix up to date
+	void						update();
+
+	size_t						size() const { return mSprite.size() - mDeadCount; }
+
+private:
+	void						validate(const uint32_t slot);
+	void						compute(const uint32_t slot);
+	void						rebuildOrder();
+
+	// By handle
+	std::vector<uint32_t>		mSlotOf;
+	std::vector<Handle>			mFreeHandles;
+
+	// By slot. A null sprite is a released slot, which is dropped on the next rebuild.
+	std::vector<const Sprite*>	mSprite;
+	std::vector<Handle>			mHandle;
+	std::vector<uint32_t>		mParent;
+	std::vector<uint8_t>		mLocalDirty;
+	std::vector<ci::mat4>		mLocal;
+	std::vector<ci::mat4>		mWorld;
+	std::vector<ci::mat4>		mInverseWorld;
+	std::vector<uint64_t>		mStamp;
+	std::vector<uint64_t>		mParentStamp;
+	std::vector<uint64_t>		mInverseStamp;
+
+	uint64_t					mLastStamp;
+	size_t						mDeadCount;
+	bool						mOrderDirty;
+	// Nothing has changed since the last update()
+	bool						mClean;
+
+	// Scratch
+	std::vector<uint32_t>		mPath;
+	std::vector<uint32_t>		mDepth;
+	std::vector<uint32_t>		mNewSlot;
+};
+
+} // namespace ui
+} // namespace ds
+
+#endif // DS_UI_SPRITE_UTIL_SPRITETRANSFORMS_H_
@@ -61,8 +61,7 @@ void ButtonBehaviour::disable() {
 
 namespace {
 void			anim_scale_to(ds::ui::Sprite& s, const float scale, const float duration) {
-	s.mAnimScale.stop();
-	s.getEngine().getTweenline().apply(s, s.ANIM_SCALE(), ci::vec3(scale, scale, 1.0f), duration, ci::easeInOutQuad);
+	s.tweenScale(ci::vec3(scale, scale, 1.0f), duration, 0.0f, ci::easeInOutQuad);
 }
 
 }
@@ -0,0 +1,323 @@
+#include "stdafx.h"
+
+#include "ds/ui/touch/tuio_ingest.h"
+
+#include <chrono>
+#include <cstring>
+#include <Poco/Net/SocketAddress.h>
+#include <Poco/Net/SocketImpl.h>
+#include <Poco/Timespan.h>
+#include "ds/debug/logger.h"
+#include "osc/OscReceivedElements.h"
+
+#if defined(__linux__)
+#define DS_TUIO_RECVMMSG
+#include <sys/socket.h>
+#include <netinet/in.h>
+#endif
+
+namespace ds {
+namespace ui {
+
+namespace {
+const char*					CURSOR_ADDRESS = "/tuio/2Dcur";
+
+// How long the receive thread blocks before checking whether it should stop
+const Poco::Timespan		RECEIVE_TIMEOUT(0, 100000);
+
+// Low bits of a touch id that hold the session id, the source index is above them
+const int					SESSION_BITS = 24;
+const uint32_t				SESSION_MASK = (1u << SESSION_BITS) - 1;
+
+uint32_t					ipv4_of(const struct sockaddr* sa) {
+	if(!sa || sa->sa_family != AF_INET) return 0;
+	return reinterpret_cast<const struct sockaddr_in*>(sa)->sin_addr.s_addr;
+}
+}
+
+/**
+ * \class ds::ui::TuioIngest::Source
+ */
+TuioIngest::Source::Source()
+		: mAddress(0)
+		, mUsed(false)
+		, mPreviousFrame(0)
+		, mNumSets(0)
+		, mNumDeletes(0) {
+	for(int i = 0; i < MAX_CURSORS; ++i) mSlots[i].mActive = false;
+}
+
+void TuioIngest::Source::clearPending() {
+	mNumSets = 0;
+	mNumDeletes = 0;
+}
+
+/**
+ * \class ds::ui::TuioIngest
+ */
+TuioIngest::TuioIngest()
+		: mRunning(false)
+		, mPastFrameThreshold(DEFAULT_PAST_FRAME_THRESHOLD)
+		, mDroppedFrames(0)
+		, mDatagrams(0) {
+}
+
+TuioIngest::~TuioIngest() {
+	stop();
+}
+
+bool TuioIngest::start(const int port) {
+	stop();
+	try {
+		mSocket = Poco::Net::DatagramSocket(Poco::Net::IPAddress::IPv4);
+		mSocket.bind(Poco::Net::SocketAddress(Poco::Net::IPAddress(), static_cast<Poco::UInt16>(port)), true);
+		mSocket.setReceiveTimeout(RECEIVE_TIMEOUT);
+	} catch(std::exception const& ex) {
+		DS_LOG_WARNING("TuioIngest::start() couldn't bind port " << port << ": " << ex.what());
+		return false;
+	}
+
+	mRunning = true;
+	mThread = std::thread([this](){ receiveLoop(); });
+	return true;
+}
+
+void TuioIngest::stop() {
+	if(!mRunning && !mThread.joinable()) return;
+	mRunning = false;
+	if(mThread.joinable()) mThread.join();
+	try {
+		mSocket.close();
+	} catch(std::exception const&) {
+	}
+}
+
+size_t TuioIngest::drain(const std::function<void(const Frame&)>& fn) {
+	size_t					count = 0;
+	for(const Frame* f = mFrames.front(); f; f = mFrames.front()) {
+		if(fn) fn(*f);
+		mFrames.pop();
+		++count;
+	}
+	return count;
+}
+
+int64_t TuioIngest::now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t TuioIngest::touchIdOf(const uint16_t sourceIndex, const int32_t sessionId) {
+	return (static_cast<uint32_t>(sourceIndex) << SESSION_BITS) | (static_cast<uint32_t>(sessionId) & SESSION_MASK);
+}
+
+void TuioIngest::receiveLoop() {
+	// Everything the loop needs is set up once, so reading a datagram never allocates
+	std::unique_ptr<char[]>	buffers(new char[BATCH_SIZE * MAX_DATAGRAM]);
+
+#ifdef DS_TUIO_RECVMMSG
+	const int				fd = static_cast<int>(mSocket.impl()->sockfd());
+	struct mmsghdr			msgs[BATCH_SIZE];
+	struct iovec			iovs[BATCH_SIZE];
+	struct sockaddr_in		senders[BATCH_SIZE];
+
+	while(mRunning) {
+		for(int i = 0; i < BATCH_SIZE; ++i) {
+			iovs[i].iov_base = buffers.get() + i * MAX_DATAGRAM;
+			iovs[i].iov_len = MAX_DATAGRAM;
+			std::memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_name = &senders[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(senders[i]);
+		}
+
+		// Blocks for the first datagram (up to the receive timeout), then takes whatever else is queued
+		const int			n = recvmmsg(fd, msgs, BATCH_SIZE, MSG_WAITFORONE, nullptr);
+		if(n <= 0) continue;
+
+		const int64_t		stamp = now();
+		for(int i = 0; i < n; ++i) {
+			ingest(buffers.get() + i * MAX_DATAGRAM, msgs[i].msg_len,
+				   ipv4_of(reinterpret_cast<const struct sockaddr*>(&senders[i])), stamp);
+		}
+	}
+#else
+	Poco::Net::SocketAddress	sender;
+	while(mRunning) {
+		try {
+			const int		n = mSocket.receiveFrom(buffers.get(), MAX_DATAGRAM, sender);
+			if(n > 0) ingest(buffers.get(), static_cast<size_t>(n), ipv4_of(sender.addr()), now());
+		} catch(Poco::TimeoutException const&) {
+		} catch(std::exception const& ex) {
+			if(mRunning) DS_LOG_WARNING("TuioIngest receive error: " << ex.what());
+		}
+	}
+#endif
+}
+
+void TuioIngest::ingest(const char* data, const size_t size, const uint32_t sourceAddress, const int64_t receivedNs) {
+	if(!data || size < 1) return;
+	++mDatagrams;
+
+	const uint16_t			sourceIndex = internSource(sourceAddress);
+	if(sourceIndex >= MAX_SOURCES) return;
+	Source&					source = mSources[sourceIndex];
+
+	try {
+		const ::osc::ReceivedPacket		packet(data, size);
+
+		// Walk the packet without copying. TUIO senders bundle one alive, the sets, and one fseq.
+		auto handle = [&](const ::osc::ReceivedMessage& m) {
+			if(std::strcmp(m.AddressPattern(), CURSOR_ADDRESS) != 0) return;
+			auto			arg = m.ArgumentsBegin();
+			if(arg == m.ArgumentsEnd() || !arg->IsString()) return;
+			const char*		command = arg->AsString();
+			++arg;
+
+			if(std::strcmp(command, "set") == 0) {
+				int32_t		id = 0;
+				float		x = 0.0f, y = 0.0f;
+				if(arg == m.ArgumentsEnd()) return;
+				id = (arg++)->AsInt32();
+				if(arg == m.ArgumentsEnd()) return;
+				x = (arg++)->AsFloat();
+				if(arg == m.ArgumentsEnd()) return;
+				y = (arg++)->AsFloat();
+				onSet(source, id, x, y);
+			} else if(std::strcmp(command, "alive") == 0) {
+				int32_t		ids[MAX_CURSORS];
+				int			count = 0;
+				for(; arg != m.ArgumentsEnd() && count < MAX_CURSORS; ++arg) {
+					if(arg->IsInt32()) ids[count++] = arg->AsInt32Unchecked();
+				}
+				onAlive(source, ids, count);
+			} else if(std::strcmp(command, "fseq") == 0) {
+				if(arg == m.ArgumentsEnd()) return;
+				onFseq(source, sourceIndex, arg->AsInt32(), receivedNs);
+			}
+		};
+
+		if(packet.IsMessage()) {
+			handle(::osc::ReceivedMessage(packet));
+		} else if(packet.IsBundle()) {
+			const ::osc::ReceivedBundle	bundle(packet);
+			for(auto it = bundle.ElementsBegin(); it != bundle.ElementsEnd(); ++it) {
+				// Nested bundles aren't part of TUIO, so they're skipped
+				if(it->IsMessage()) handle(::osc::ReceivedMessage(*it));
+			}
+		}
+	} catch(::osc::Exception const& ex) {
+		DS_LOG_VERBOSE(2, "TuioIngest dropped a bad packet: " << ex.what());
+	}
+}
+
+uint16_t TuioIngest::internSource(const uint32_t address) {
+	for(uint16_t i = 0; i < MAX_SOURCES; ++i) {
+		if(mSources[i].mUsed && mSources[i].mAddress == address) return i;
+	}
+	for(uint16_t i = 0; i < MAX_SOURCES; ++i) {
+		if(!mSources[i].mUsed) {
+			mSources[i].mUsed = true;
+			mSources[i].mAddress = address;
+			return i;
+		}
+	}
+	return MAX_SOURCES;
+}
+
+void TuioIngest::onSet(Source& s, const int32_t id, const float x, const float y) {
+	// A second set for the same cursor before the fseq replaces the first
+	for(int i = 0; i < s.mNumSets; ++i) {
+		if(s.mSets[i].mSessionId == id) {
+			s.mSets[i].mX = x;
+			s.mSets[i].mY = y;
+			return;
+		}
+	}
+	if(s.mNumSets >= MAX_CURSORS) return;
+	Slot&					set = s.mSets[s.mNumSets++];
+	set.mSessionId = id;
+	set.mX = x;
+	set.mY = y;
+	set.mActive = true;
+}
+
+void TuioIngest::onAlive(Source& s, const int32_t* ids, const int count) {
+	// Anything current that's not in the alive list has gone away
+	for(int i = 0; i < MAX_CURSORS; ++i) {
+		if(!s.mSlots[i].mActive) continue;
+		bool				alive = false;
+		for(int k = 0; k < count && !alive; ++k) alive = (ids[k] == s.mSlots[i].mSessionId);
+		if(!alive && s.mNumDeletes < MAX_CURSORS) s.mDeletes[s.mNumDeletes++] = s.mSlots[i].mSessionId;
+	}
+}
+
+void TuioIngest::onFseq(Source& s, const uint16_t sourceIndex, const int32_t frame, const int64_t receivedNs) {
+	// UDP can deliver frames from the past, which get dropped, unless they're far enough
+	// back that the source has probably restarted. -1 means an update with no new time.
+	const int32_t			dframe = frame - s.mPreviousFrame;
+	if(frame != -1 && dframe <= 0 && dframe >= -mPastFrameThreshold) {
+		s.clearPending();
+		return;
+	}
+
+	Frame*					out = mFrames.beginPush();
+	if(out) {
+		out->mSource = sourceIndex;
+		out->mFseq = frame;
+		out->mReceivedNs = receivedNs;
+		out->mNumCursors = 0;
+	} else {
+		// The slot state still advances so the touch stream stays consistent once there's room
+		++mDroppedFrames;
+	}
+
+	auto emit = [out, sourceIndex](const Slot& now, const float prevX, const float prevY, const Cursor::Phase phase) {
+		if(!out) return;
+		Cursor&				c = out->mCursors[out->mNumCursors++];
+		c.mSessionId = now.mSessionId;
+		c.mTouchId = touchIdOf(sourceIndex, now.mSessionId);
+		c.mX = now.mX;
+		c.mY = now.mY;
+		c.mPrevX = prevX;
+		c.mPrevY = prevY;
+		c.mPhase = phase;
+	};
+
+	// Adds and updates
+	for(int i = 0; i < s.mNumSets; ++i) {
+		const Slot&			set = s.mSets[i];
+		Slot*				slot = nullptr;
+		Slot*				empty = nullptr;
+		for(int k = 0; k < MAX_CURSORS && !slot; ++k) {
+			if(s.mSlots[k].mActive && s.mSlots[k].mSessionId == set.mSessionId) slot = &s.mSlots[k];
+			else if(!empty && !s.mSlots[k].mActive) empty = &s.mSlots[k];
+		}
+		if(slot) {
+			const float		px = slot->mX, py = slot->mY;
+			*slot = set;
+			emit(*slot, px, py, Cursor::MOVED);
+		} else if(empty) {
+			*empty = set;
+			emit(*empty, set.mX, set.mY, Cursor::BEGAN);
+		}
+	}
+
+	// Deletes
+	for(int i = 0; i < s.mNumDeletes; ++i) {
+		for(int k = 0; k < MAX_CURSORS; ++k) {
+			Slot&			slot = s.mSlots[k];
+			if(!slot.mActive || slot.mSessionId != s.mDeletes[i]) continue;
+			emit(slot, slot.mX, slot.mY, Cursor::ENDED);
+			slot.mActive = false;
+			break;
+		}
+	}
+
+	if(out) mFrames.commitPush();
+	if(frame != -1) s.mPreviousFrame = frame;
+	s.clearPending();
+}
+
+} // namespace ui
+} // namespace ds
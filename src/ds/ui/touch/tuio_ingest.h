@@ -0,0 +1,133 @@
+#pragma once
+#ifndef DS_UI_TOUCH_TUIOINGEST_H_
+#define DS_UI_TOUCH_TUIOINGEST_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <Poco/Net/DatagramSocket.h>
+#include "ds/util/spsc_ring.h"
+
+namespace ds {
+namespace ui {
+
+/**
+ * \class ds::ui::TuioIngest
+ * \brief Receives TUIO 1.1 2Dcur cursors without allocating per packet, as an alternative to ci::tuio::Client.
+ * Datagrams are read in batches (recvmmsg on linux) on a receive thread and parsed in place.
+ * Cursors go into fixed slots for each source, and each accepted fseq is published
+ * as a Frame through a single-producer/single-consumer ring. The engine drains the
+ * ring on the main thread. Objects (2Dobj) and 25Dcur are ignored.
+ * Frame semantics match ci::tuio::Client: set/alive are held until fseq, and old
+ * frames are dropped unless they're far enough back to look like a restarted source.
+ * Session ids are only unique per source, so each cursor also gets a touch id made from
+ * both. For the first source the touch id is the session id, like ci::tuio::Client.
+ */
+class TuioIngest {
+public:
+	static const int			MAX_CURSORS = 64;
+	static const int			MAX_SOURCES = 16;
+	static const size_t			RING_FRAMES = 256;
+	static const int			BATCH_SIZE = 32;
+	static const int			MAX_DATAGRAM = 4096;
+	static const int32_t		DEFAULT_PAST_FRAME_THRESHOLD = 10;
+
+	class Cursor {
+	public:
+		enum Phase { BEGAN, MOVED, ENDED };
+		int32_t					mSessionId;
+		// Unique across sources, use this as the touch id
+		uint32_t				mTouchId;
+		// Normalized 0-1, as sent
+		float					mX, mY;
+		float					mPrevX, mPrevY;
+		Phase					mPhase;
+	};
+
+	class Frame {
+	public:
+		uint16_t				mSource;
+		int32_t					mFseq;
+		// Steady clock nanoseconds when the datagram holding the fseq was read
+		int64_t					mReceivedNs;
+		int						mNumCursors;
+		// Ended cursors can ride along with a full set of live ones
+		Cursor					mCursors[MAX_CURSORS * 2];
+	};
+
+	TuioIngest();
+	~TuioIngest();
+
+	/// Bind the port and start the receive thread. Answers false if the port couldn't be bound.
+	bool						start(const int port);
+	void						stop();
+	bool						isRunning() const { return mRunning; }
+
+	void						setPastFrameThreshold(const int32_t t) { mPastFrameThreshold = t; }
+
+	/// Main thread. Calls fn with each waiting frame, oldest first, and answers how many there were.
+	size_t						drain(const std::function<void(const Frame&)>& fn);
+
+	/// Parse one datagram as if it came from the given IPv4 address. This is what the receive
+	/// thread calls, and lets captured packets be replayed without a socket. Only call it
+	/// from one thread at a time, and not while the receive thread is running.
+	void						ingest(const char* data, const size_t size, const uint32_t sourceAddress, const int64_t receivedNs);
+
+	static int64_t				now();
+	/// The source index goes in the top bits, so live touches from different sources never share an id
+	static uint32_t				touchIdOf(const uint16_t sourceIndex, const int32_t sessionId);
+
+	/// Frames dropped because the main thread fell behind and the ring filled up
+	uint64_t					getDroppedFrames() const { return mDroppedFrames; }
+	uint64_t					getDatagramCount() const { return mDatagrams; }
+
+private:
+	class Slot {
+	public:
+		int32_t					mSessionId;
+		float					mX, mY;
+		bool					mActive;
+	};
+
+	class Source {
+	public:
+		Source();
+		void					clearPending();
+
+		uint32_t				mAddress;
+		bool					mUsed;
+		int32_t					mPreviousFrame;
+		Slot					mSlots[MAX_CURSORS];
+
+		// Held until the next fseq
+		Slot					mSets[MAX_CURSORS];
+		int						mNumSets;
+		int32_t					mDeletes[MAX_CURSORS];
+		int						mNumDeletes;
+	};
+
+	void						receiveLoop();
+	uint16_t					internSource(const uint32_t address);
+	void						onSet(Source&, const int32_t id, const float x, const float y);
+	void						onAlive(Source&, const int32_t* ids, const int count);
+	void						onFseq(Source&, const uint16_t sourceIndex, const int32_t fseq, const int64_t receivedNs);
+
+	Poco::Net::DatagramSocket	mSocket;
+	std::thread					mThread;
+	std::atomic<bool>			mRunning;
+	int32_t						mPastFrameThreshold;
+
+	// Receive thread only
+	Source						mSources[MAX_SOURCES];
+
+	ds::SpscRing<Frame, RING_FRAMES>
+								mFrames;
+	std::atomic<uint64_t>		mDroppedFrames;
+	std::atomic<uint64_t>		mDatagrams;
+};
+
+} // namespace ui
+} // namespace ds
+
+#endif // DS_UI_TOUCH_TUIOINGEST_H_
@@ -23,24 +23,13 @@ SpriteAnimatable::SpriteAnimatable(Sprite& s, SpriteEngine& e)
 	, mAnimateOnOpacityTarget(1.0f)
 	, mAnimateOnScript("")
 	, mNormalizedTweenValue(0.0f)
-	, mInternalColorCinderTweenRef(nullptr)
-	, mInternalScaleCinderTweenRef(nullptr)
-	, mInternalRotationCinderTweenRef(nullptr)
-	, mInternalPositionCinderTweenRef(nullptr)
-	, mInternalSizeCinderTweenRef(nullptr)
-	, mInternalOpacityCinderTweenRef(nullptr)
-	, mInternalNormalizedCinderTweenRef(nullptr)
+	, mTweenRecord(0xFFFFFFFF)
 	, mDelayedCallCueRef(nullptr)
 {}
 
 SpriteAnimatable::~SpriteAnimatable() {
-	mInternalColorCinderTweenRef = nullptr;
-	mInternalScaleCinderTweenRef = nullptr;
-	mInternalRotationCinderTweenRef = nullptr;
-	mInternalPositionCinderTweenRef = nullptr;
-	mInternalSizeCinderTweenRef = nullptr;
-	mInternalOpacityCinderTweenRef = nullptr;
-	mInternalNormalizedCinderTweenRef = nullptr;
+	// Only touch the tweenline if there's something in it, since at shutdown it can be gone first
+	if(mTweenRecord != 0xFFFFFFFF) mEngine.getTweenline().getSpriteTweens().stopAll(*this);
 	mDelayedCallCueRef = nullptr;
 }
 
@@ -103,142 +92,101 @@ const SpriteAnim<float>& SpriteAnimatable::ANIM_NORMALIZED() {
 void SpriteAnimatable::tweenColor(const ci::Color& c, const float duration, const float delay,
 								  const ci::EaseFn& ease, const std::function<void(void)>& finishFn, const std::function<void(void)>& updateFn) {
 	animColorStop();
-	auto options = mEngine.getTweenline().apply(mOwner, ANIM_COLOR(), c, duration, ease, finishFn, delay, updateFn);
-	mInternalColorCinderTweenRef = options.operator ci::TweenRef<ci::Color>();
+	mEngine.getTweenline().tween(mOwner, SpriteTweens::COLOR, ci::vec3(c.r, c.g, c.b), duration, delay, ease, finishFn, updateFn);
 }
 
 void SpriteAnimatable::tweenOpacity(const float opacity, const float duration, const float delay,
 									const ci::EaseFn& ease, const std::function<void(void)>& finishFn, const std::function<void(void)>& updateFn) {
 	animOpacityStop();
-	auto options = mEngine.getTweenline().apply(mOwner, ANIM_OPACITY(), opacity, duration, ease, finishFn, delay, updateFn);
-	mInternalOpacityCinderTweenRef = options.operator ci::TweenRef<float>();
+	mEngine.getTweenline().tween(mOwner, SpriteTweens::OPACITY, ci::vec3(opacity, 0.0f, 0.0f), duration, delay, ease, finishFn, updateFn);
 }
 
 void SpriteAnimatable::tweenPosition(const ci::vec3& pos, const float duration, const float delay,
 									 const ci::EaseFn& ease, const std::function<void(void)>& finishFn, const std::function<void(void)>& updateFn) {
 	animPositionStop();
-	auto options = mEngine.getTweenline().apply(mOwner, ANIM_POSITION(), pos, duration, ease, finishFn, delay, updateFn);
-	mInternalPositionCinderTweenRef = options.operator ci::TweenRef<ci::vec3>();
+	mEngine.getTweenline().tween(mOwner, SpriteTweens::POSITION, pos, duration, delay, ease, finishFn, updateFn);
 }
 
 void SpriteAnimatable::tweenRotation(const ci::vec3& rot, const float duration, const float delay,
 									 const ci::EaseFn& ease, const std::function<void(void)>& finishFn, const std::function<void(void)>& updateFn) {
 	animRotationStop();
-	auto options = mEngine.getTweenline().apply(mOwner, ANIM_ROTATION(), rot, duration, ease, finishFn, delay, updateFn);
-	mInternalRotationCinderTweenRef = options.operator ci::TweenRef<ci::vec3>();
+	mEngine.getTweenline().tween(mOwner, SpriteTweens::ROTATION, rot, duration, delay, ease, finishFn, updateFn);
 }
 
 void SpriteAnimatable::tweenScale(const ci::vec3& scale, const float duration, const float delay,
 								  const ci::EaseFn& ease, const std::function<void(void)>& finishFn, const std::function<void(void)>& updateFn) {
 	animScaleStop();
-	auto options = mEngine.getTweenline().apply(mOwner, ANIM_SCALE(), scale, duration, ease, finishFn, delay, updateFn);
-	mInternalScaleCinderTweenRef = options.operator ci::TweenRef<ci::vec3>();
+	mEngine.getTweenline().tween(mOwner, SpriteTweens::SCALE, scale, duration, delay, ease, finishFn, updateFn);
 }
 
 void SpriteAnimatable::tweenSize(const ci::vec3& size, const float duration, const float delay,
 								 const ci::EaseFn& ease, const std::function<void(void)>& finishFn, const std::function<void(void)>& updateFn) {
 	animSizeStop();
-	auto options = mEngine.getTweenline().apply(mOwner, ANIM_SIZE(), size, duration, ease, finishFn, delay, updateFn);
-	mInternalSizeCinderTweenRef = options.operator ci::TweenRef<ci::vec3>();
+	mEngine.getTweenline().tween(mOwner, SpriteTweens::SIZE, size, duration, delay, ease, finishFn, updateFn);
 }
 
 void SpriteAnimatable::tweenNormalized(const float duration, const float delay,
 									const ci::EaseFn& ease, const std::function<void(void)>& finishFn, const std::function<void(void)>& updateFn) {
 	animNormalizedStop();
-	auto options = mEngine.getTweenline().apply(mOwner, ANIM_NORMALIZED(), 1.0f, duration, ease, finishFn, delay, updateFn);
-	mInternalNormalizedCinderTweenRef = options.operator ci::TweenRef<float>();
+	mNormalizedTweenValue = 0.0f;
+	mEngine.getTweenline().tween(mOwner, SpriteTweens::NORMALIZED, ci::vec3(1.0f, 0.0f, 0.0f), duration, delay, ease, finishFn, updateFn);
 }
 
 
 void SpriteAnimatable::completeTweenColor(const bool callFinishFunction){
-	if(mInternalColorCinderTweenRef){
-		if(getColorTweenIsRunning()){
-			mAnimColor.stop();
-			mOwner.setColor(mInternalColorCinderTweenRef->getEndValue());
-			if(callFinishFunction){
-				auto finishFunc = mInternalColorCinderTweenRef->getFinishFn();
-				if(finishFunc) finishFunc();
-			}
-		}
-	}
+	ci::vec3 end;
+	std::function<void(void)> finishFunc;
+	if(!mEngine.getTweenline().getSpriteTweens().stopAtEnd(*this, SpriteTweens::COLOR, end, finishFunc)) return;
+	mOwner.setColor(ci::Color(end.x, end.y, end.z));
+	if(callFinishFunction && finishFunc) finishFunc();
 }
 
 void SpriteAnimatable::completeTweenOpacity(const bool callFinishFunction){
-	if(mInternalOpacityCinderTweenRef){
-		if(getOpacityTweenIsRunning()){
-			mAnimOpacity.stop();
-			mOwner.setOpacity(mInternalOpacityCinderTweenRef->getEndValue());
-			if(callFinishFunction){
-				auto finishFunc = mInternalOpacityCinderTweenRef->getFinishFn();
-				if(finishFunc) finishFunc();
-			}
-		}
-	}
+	ci::vec3 end;
+	std::function<void(void)> finishFunc;
+	if(!mEngine.getTweenline().getSpriteTweens().stopAtEnd(*this, SpriteTweens::OPACITY, end, finishFunc)) return;
+	mOwner.setOpacity(end.x);
+	if(callFinishFunction && finishFunc) finishFunc();
 }
 
 void SpriteAnimatable::completeTweenPosition(const bool callFinishFunction){
-	if(mInternalPositionCinderTweenRef){
-		if(getPositionTweenIsRunning()){
-			mAnimPosition.stop();
-			mOwner.setPosition(mInternalPositionCinderTweenRef->getEndValue());
-			if(callFinishFunction){
-				auto finishFunc = mInternalPositionCinderTweenRef->getFinishFn();
-				if(finishFunc) finishFunc();
-			}
-		}
-	}
+	ci::vec3 end;
+	std::function<void(void)> finishFunc;
+	if(!mEngine.getTweenline().getSpriteTweens().stopAtEnd(*this, SpriteTweens::POSITION, end, finishFunc)) return;
+	mOwner.setPosition(end);
+	if(callFinishFunction && finishFunc) finishFunc();
 }
 
 void SpriteAnimatable::completeTweenRotation(const bool callFinishFunction){
-	if(mInternalRotationCinderTweenRef){
-		if(getRotationTweenIsRunning()){
-			mAnimRotation.stop();
-			mOwner.setRotation(mInternalRotationCinderTweenRef->getEndValue());
-			if(callFinishFunction){
-				auto finishFunc = mInternalRotationCinderTweenRef->getFinishFn();
-				if(finishFunc) finishFunc();
-			}
-		}
-	}
+	ci::vec3 end;
+	std::function<void(void)> finishFunc;
+	if(!mEngine.getTweenline().getSpriteTweens().stopAtEnd(*this, SpriteTweens::ROTATION, end, finishFunc)) return;
+	mOwner.setRotation(end);
+	if(callFinishFunction && finishFunc) finishFunc();
 }
 
 void SpriteAnimatable::completeTweenScale(const bool callFinishFunction){
-	if(mInternalScaleCinderTweenRef){
-		if(getScaleTweenIsRunning()){
-			mAnimScale.stop();
-			mOwner.setScale(mInternalScaleCinderTweenRef->getEndValue());
-			if(callFinishFunction){
-				auto finishFunc = mInternalScaleCinderTweenRef->getFinishFn();
-				if(finishFunc) finishFunc();
-			}
-		}
-	}
+	ci::vec3 end;
+	std::function<void(void)> finishFunc;
+	if(!mEngine.getTweenline().getSpriteTweens().stopAtEnd(*this, SpriteTweens::SCALE, end, finishFunc)) return;
+	mOwner.setScale(end);
+	if(callFinishFunction && finishFunc) finishFunc();
 }
 
 void SpriteAnimatable::completeTweenSize(const bool callFinishFunction){
-	if(mInternalSizeCinderTweenRef){
-		if(getSizeTweenIsRunning()){
-			mAnimSize.stop();
-			mOwner.setSizeAll(mInternalSizeCinderTweenRef->getEndValue());
-			if(callFinishFunction){
-				auto finishFunc = mInternalSizeCinderTweenRef->getFinishFn();
-				if(finishFunc) finishFunc();
-			}
-		}
-	}
+	ci::vec3 end;
+	std::function<void(void)> finishFunc;
+	if(!mEngine.getTweenline().getSpriteTweens().stopAtEnd(*this, SpriteTweens::SIZE, end, finishFunc)) return;
+	mOwner.setSizeAll(end);
+	if(callFinishFunction && finishFunc) finishFunc();
 }
 
 void SpriteAnimatable::completeTweenNormalized(const bool callFinishFunction){
-	if(mInternalNormalizedCinderTweenRef){
-		if(getSizeTweenIsRunning()){
-			mAnimSize.stop();
-			mNormalizedTweenValue = (mInternalNormalizedCinderTweenRef->getEndValue());
-			if(callFinishFunction){
-				auto finishFunc = mInternalNormalizedCinderTweenRef->getFinishFn();
-				if(finishFunc) finishFunc();
-			}
-		}
-	}
+	ci::vec3 end;
+	std::function<void(void)> finishFunc;
+	if(!mEngine.getTweenline().getSpriteTweens().stopAtEnd(*this, SpriteTweens::NORMALIZED, end, finishFunc)) return;
+	mNormalizedTweenValue = end.x;
+	if(callFinishFunction && finishFunc) finishFunc();
 }
 const bool SpriteAnimatable::animationRunning(){
 	return getOpacityTweenIsRunning() 
@@ -251,25 +199,25 @@ const bool SpriteAnimatable::animationRunning(){
 }
 
 const bool SpriteAnimatable::getPositionTweenIsRunning(){
-	return (mInternalPositionCinderTweenRef && !mAnimPosition.isComplete());
+	return mEngine.getTweenline().getSpriteTweens().isRunning(*this, SpriteTweens::POSITION);
 }
 const bool SpriteAnimatable::getRotationTweenIsRunning(){
-	return (mInternalRotationCinderTweenRef && !mAnimRotation.isComplete());
+	return mEngine.getTweenline().getSpriteTweens().isRunning(*this, SpriteTweens::ROTATION);
 }
 const bool SpriteAnimatable::getSizeTweenIsRunning(){
-	return (mInternalSizeCinderTweenRef && !mAnimSize.isComplete());
+	return mEngine.getTweenline().getSpriteTweens().isRunning(*this, SpriteTweens::SIZE);
 }
 const bool SpriteAnimatable::getScaleTweenIsRunning(){
-	return (mInternalScaleCinderTweenRef && !mAnimScale.isComplete());
+	return mEngine.getTweenline().getSpriteTweens().isRunning(*this, SpriteTweens::SCALE);
 }
 const bool SpriteAnimatable::getOpacityTweenIsRunning(){
-	return (mInternalOpacityCinderTweenRef && !mAnimOpacity.isComplete());
+	return mEngine.getTweenline().getSpriteTweens().isRunning(*this, SpriteTweens::OPACITY);
 }
 const bool SpriteAnimatable::getColorTweenIsRunning(){
-	return (mInternalColorCinderTweenRef && !mAnimColor.isComplete());
+	return mEngine.getTweenline().getSpriteTweens().isRunning(*this, SpriteTweens::COLOR);
 }
 const bool SpriteAnimatable::getNormalizeTweenIsRunning(){
-	return (mInternalNormalizedCinderTweenRef && !mAnimNormalized.isComplete());
+	return mEngine.getTweenline().getSpriteTweens().isRunning(*this, SpriteTweens::NORMALIZED);
 }
 
 void SpriteAnimatable::animStop() {
@@ -287,39 +235,40 @@ void SpriteAnimatable::animStop() {
 	}
 }
 
+// The ci::Anim members are stopped too, in case an app drove them through Tweenline::apply()
 void SpriteAnimatable::animPositionStop(){
 	mAnimPosition.stop();
-	mInternalPositionCinderTweenRef = nullptr;
+	mEngine.getTweenline().getSpriteTweens().stop(*this, SpriteTweens::POSITION);
 }
 
 void SpriteAnimatable::animRotationStop(){
 	mAnimRotation.stop();
-	mInternalRotationCinderTweenRef = nullptr;
+	mEngine.getTweenline().getSpriteTweens().stop(*this, SpriteTweens::ROTATION);
 }
 
 void SpriteAnimatable::animScaleStop(){
 	mAnimScale.stop();
-	mInternalScaleCinderTweenRef = nullptr;
+	mEngine.getTweenline().getSpriteTweens().stop(*this, SpriteTweens::SCALE);
 }
 
 void SpriteAnimatable::animSizeStop(){
 	mAnimSize.stop();
-	mInternalSizeCinderTweenRef = nullptr;
+	mEngine.getTweenline().getSpriteTweens().stop(*this, SpriteTweens::SIZE);
 }
 
 void SpriteAnimatable::animOpacityStop(){
 	mAnimOpacity.stop();
-	mInternalOpacityCinderTweenRef = nullptr;
+	mEngine.getTweenline().getSpriteTweens().stop(*this, SpriteTweens::OPACITY);
 }
 
 void SpriteAnimatable::animColorStop(){
 	mAnimColor.stop();
-	mInternalColorCinderTweenRef = nullptr;
+	mEngine.getTweenline().getSpriteTweens().stop(*this, SpriteTweens::COLOR);
 }
 
 void SpriteAnimatable::animNormalizedStop(){
 	mAnimNormalized.stop();
-	mInternalNormalizedCinderTweenRef = nullptr;
+	mEngine.getTweenline().getSpriteTweens().stop(*this, SpriteTweens::NORMALIZED);
 }
 
 void SpriteAnimatable::completeAllTweens(const bool callFinishFunctions, const bool recursive){
@@ -6,6 +6,7 @@
 #include <cinder/Easing.h>
 #include <cinder/Tween.h>
 #include <cinder/Vector.h>
+#include <cstdint>
 
 namespace ds {
 namespace ui {
@@ -191,14 +192,9 @@ private:
 
 	float									mNormalizedTweenValue;
 
-	//---- For completing tweens, yaaay ----------------------------//
-	ci::TweenRef<ci::vec3>					mInternalPositionCinderTweenRef;
-	ci::TweenRef<ci::vec3>					mInternalScaleCinderTweenRef;
-	ci::TweenRef<ci::vec3>					mInternalSizeCinderTweenRef;
-	ci::TweenRef<ci::vec3>					mInternalRotationCinderTweenRef;
-	ci::TweenRef<ci::Color>					mInternalColorCinderTweenRef;
-	ci::TweenRef<float>						mInternalOpacityCinderTweenRef;
-	ci::TweenRef<float>						mInternalNormalizedCinderTweenRef;
+	// The built-in tweens live in the SpriteTweens, which keeps this sprite's slot here
+	friend class SpriteTweens;
+	uint32_t								mTweenRecord;
 
 	// Store a CueRef from the cinder timeline to clear the callAfterDelay() function
 	// Cleared automatically on destruction
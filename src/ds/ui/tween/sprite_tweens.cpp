@@ -0,0 +1,384 @@
+#include "stdafx.h"
+
+#include "ds/ui/tween/sprite_tweens.h"
+
+#include <algorithm>
+#include "ds/ui/sprite/sprite.h"
+
+namespace ds {
+namespace ui {
+
+namespace {
+typedef float				(*EaseFnPtr)(float);
+
+class Polynomial {
+public:
+	Polynomial(const float power, const bool out, const bool inOut) : mPower(power), mOut(out ? 1.0f : 0.0f), mInOut(inOut ? 1.0f : 0.0f) {}
+	float					mPower, mOut, mInOut;
+};
+
+template <typename FN>
+bool						matches(const ci::EaseFn& fn, EaseFnPtr ptr) {
+	if(fn.target<FN>()) return true;
+	const EaseFnPtr*		p = fn.target<EaseFnPtr>();
+	return p && *p == ptr;
+}
+
+// Spot the cinder easings that are just t^n, flipped for out and mirrored for in-out
+bool						as_polynomial(const ci::EaseFn& fn, Polynomial& out) {
+	if(!fn || matches<ci::EaseNone>(fn, &ci::easeNone)) { out = Polynomial(1.0f, false, false); return true; }
+
+	if(matches<ci::EaseInQuad>(fn, &ci::easeInQuad)) { out = Polynomial(2.0f, false, false); return true; }
+	if(matches<ci::EaseOutQuad>(fn, &ci::easeOutQuad)) { out = Polynomial(2.0f, true, false); return true; }
+	if(matches<ci::EaseInOutQuad>(fn, &ci::easeInOutQuad)) { out = Polynomial(2.0f, false, true); return true; }
+
+	if(matches<ci::EaseInCubic>(fn, &ci::easeInCubic)) { out = Polynomial(3.0f, false, false); return true; }
+	if(matches<ci::EaseOutCubic>(fn, &ci::easeOutCubic)) { out = Polynomial(3.0f, true, false); return true; }
+	if(matches<ci::EaseInOutCubic>(fn, &ci::easeInOutCubic)) { out = Polynomial(3.0f, false, true); return true; }
+
+	if(matches<ci::EaseInQuart>(fn, &ci::easeInQuart)) { out = Polynomial(4.0f, false, false); return true; }
+	if(matches<ci::EaseOutQuart>(fn, &ci::easeOutQuart)) { out = Polynomial(4.0f, true, false); return true; }
+	if(matches<ci::EaseInOutQuart>(fn, &ci::easeInOutQuart)) { out = Polynomial(4.0f, false, true); return true; }
+
+	if(matches<ci::EaseInQuint>(fn, &ci::easeInQuint)) { out = Polynomial(5.0f, false, false); return true; }
+	if(matches<ci::EaseOutQuint>(fn, &ci::easeOutQuint)) { out = Polynomial(5.0f, true, false); return true; }
+	if(matches<ci::EaseInOutQuint>(fn, &ci::easeInOutQuint)) { out = Polynomial(5.0f, false, true); return true; }
+	return false;
+}
+
+// Where a tween on the channel starts from, read when its delay runs out
+ci::vec3					current_value(const Sprite& s, const SpriteTweens::Channel c) {
+	switch(c) {
+	case SpriteTweens::POSITION:	return s.getPosition();
+	case SpriteTweens::SCALE:		return s.getScale();
+	case SpriteTweens::SIZE:		return ci::vec3(s.getWidth(), s.getHeight(), s.getDepth());
+	case SpriteTweens::ROTATION:	return s.getRotation();
+	case SpriteTweens::COLOR:		{ const ci::Color color = s.getColor(); return ci::vec3(color.r, color.g, color.b); }
+	case SpriteTweens::OPACITY:		return ci::vec3(s.getOpacity(), 0.0f, 0.0f);
+	// Always 0 to 1
+	default:						return ci::vec3(0.0f);
+	}
+}
+}
+
+/**
+ * \class ds::ui::SpriteTweens::Record
+ */
+SpriteTweens::Record::Record()
+		: mSprite(nullptr)
+		, mChannels(0)
+		, mFrame(0)
+		, mReleasing(false) {
+	for(int c = 0; c < NUM_CHANNELS; ++c) mTween[c] = NONE;
+}
+
+/**
+ * \class ds::ui::SpriteTweens
+ */
+SpriteTweens::SpriteTweens()
+		: mDeadCount(0)
+		, mPendingCount(0)
+		, mFrame(0)
+		, mUpdating(false) {
+}
+
+SpriteTweens::~SpriteTweens() {
+	for(Record& r : mRecords) {
+		if(r.mSprite) r.mSprite->mTweenRecord = NONE;
+	}
+}
+
+void SpriteTweens::start(Sprite& s, const Channel c, const ci::vec3& to,
+						 const double startTime, const float duration, const float delay,
+						 const ci::EaseFn& ease, const std::function<void(void)>& finishFn,
+						 const std::function<void(void)>& updateFn) {
+	stop(s, c);
+
+	const uint32_t			record = recordFor(s);
+	const uint32_t			index = static_cast<uint32_t>(mStart.size());
+	mRecords[record].mTween[c] = index;
+
+	Polynomial				poly(1.0f, false, false);
+	const bool				isPoly = as_polynomial(ease, poly);
+
+	mStart.push_back(startTime + delay);
+	mDuration.push_back(duration);
+	mFromX.push_back(0.0f);
+	mFromY.push_back(0.0f);
+	mFromZ.push_back(0.0f);
+	mFromPending.push_back(1);
+	++mPendingCount;
+	mToX.push_back(to.x);
+	mToY.push_back(to.y);
+	mToZ.push_back(to.z);
+	mEasePower.push_back(poly.mPower);
+	mEaseOut.push_back(poly.mOut);
+	mEaseInOut.push_back(poly.mInOut);
+	mEaseFn.push_back(isPoly ? ci::EaseFn() : ease);
+	mChannel.push_back(static_cast<uint8_t>(c));
+	mAlive.push_back(1);
+	mRecord.push_back(record);
+	mFinishFn.push_back(finishFn);
+	mUpdateFn.push_back(updateFn);
+}
+
+void SpriteTweens::stop(SpriteAnimatable& s, const Channel c) {
+	if(s.mTweenRecord == NONE) return;
+	const uint32_t			tween = mRecords[s.mTweenRecord].mTween[c];
+	if(tween != NONE) kill(tween);
+}
+
+void SpriteTweens::stopAll(SpriteAnimatable& s) {
+	if(s.mTweenRecord == NONE) return;
+	const uint32_t			record = s.mTweenRecord;
+	for(int c = 0; c < NUM_CHANNELS; ++c) {
+		const uint32_t		tween = mRecords[record].mTween[c];
+		if(tween != NONE) kill(tween);
+	}
+	// The sprite is usually going away, so nothing can be written to it from here on
+	mRecords[record].mSprite = nullptr;
+	s.mTweenRecord = NONE;
+	releaseIfEmpty(record);
+}
+
+bool SpriteTweens::stopAtEnd(SpriteAnimatable& s, const Channel c, ci::vec3& end, std::function<void(void)>& finishFn) {
+	if(s.mTweenRecord == NONE) return false;
+	const uint32_t			tween = mRecords[s.mTweenRecord].mTween[c];
+	if(tween == NONE) return false;
+	end = ci::vec3(mToX[tween], mToY[tween], mToZ[tween]);
+	finishFn = mFinishFn[tween];
+	kill(tween);
+	return true;
+}
+
+bool SpriteTweens::isRunning(const SpriteAnimatable& s, const Channel c) const {
+	return s.mTweenRecord != NONE && mRecords[s.mTweenRecord].mTween[c] != NONE;
+}
+
+void SpriteTweens::update(const double now) {
+	// Callbacks can start and stop tweens, but never re-enter the update
+	if(mUpdating) return;
+	mUpdating = true;
+	++mFrame;
+
+	if(mDeadCount > 0) compact();
+
+	const size_t			n = mStart.size();
+	mT.resize(n);
+	mX.resize(n);
+	mY.resize(n);
+	mZ.resize(n);
+
+	// Normalized time. Anything still in its delay is negative.
+	for(size_t i = 0; i < n; ++i) {
+		const double		elapsed = now - mStart[i];
+		const float			d = mDuration[i];
+		const float			t = elapsed < 0.0 ? -1.0f : (d > 0.0f ? static_cast<float>(elapsed / d) : 1.0f);
+		mT[i] = std::min(t, 1.0f);
+	}
+
+	// Tweens starting this frame begin from wherever their sprite is now
+	for(size_t i = 0; mPendingCount > 0 && i < n; ++i) {
+		if(!mFromPending[i] || mT[i] < 0.0f) continue;
+		const Sprite*		s = mRecords[mRecord[i]].mSprite;
+		if(s) {
+			const ci::vec3	from = current_value(*s, static_cast<Channel>(mChannel[i]));
+			mFromX[i] = from.x;
+			mFromY[i] = from.y;
+			mFromZ[i] = from.z;
+		}
+		mFromPending[i] = 0;
+		--mPendingCount;
+	}
+
+	// Polynomial easing with selects instead of branches, so it vectorizes:
+	// in is x^p, out is 1 - (1 - x)^p, in-out runs each at double speed for half the time
+	float*					e = mX.data();
+	for(size_t i = 0; i < n; ++i) {
+		const float			t = std::max(mT[i], 0.0f);
+		const float			inOut = mEaseInOut[i];
+		const float			flip = std::max(mEaseOut[i], inOut * (t >= 0.5f ? 1.0f : 0.0f));
+		float				x = flip > 0.0f ? 1.0f - t : t;
+		x *= 1.0f + inOut;
+		const float			p = mEasePower[i];
+		float				y = x;
+		y *= p >= 2.0f ? x : 1.0f;
+		y *= p >= 3.0f ? x : 1.0f;
+		y *= p >= 4.0f ? x : 1.0f;
+		y *= p >= 5.0f ? x : 1.0f;
+		y *= 1.0f - 0.5f * inOut;
+		e[i] = flip > 0.0f ? 1.0f - y : y;
+	}
+	for(size_t i = 0; i < n; ++i) {
+		if(mEaseFn[i] && mT[i] >= 0.0f) e[i] = mEaseFn[i](mT[i]);
+	}
+
+	// Interpolate. Z goes first since Y and X are still holding the eased time.
+	for(size_t i = 0; i < n; ++i) mZ[i] = mFromZ[i] + (mToZ[i] - mFromZ[i]) * e[i];
+	for(size_t i = 0; i < n; ++i) mY[i] = mFromY[i] + (mToY[i] - mFromY[i]) * e[i];
+	for(size_t i = 0; i < n; ++i) mX[i] = mFromX[i] + (mToX[i] - mFromX[i]) * e[i];
+
+	// Gather per sprite
+	mTouched.clear();
+	for(size_t i = 0; i < n; ++i) {
+		if(!mAlive[i] || mT[i] < 0.0f) continue;
+		Record&				r = mRecords[mRecord[i]];
+		if(!r.mSprite) continue;
+		if(r.mFrame != mFrame) {
+			r.mFrame = mFrame;
+			r.mChannels = 0;
+			mTouched.push_back(mRecord[i]);
+		}
+		r.mChannels |= (1 << mChannel[i]);
+		r.mValues.mValue[mChannel[i]] = ci::vec3(mX[i], mY[i], mZ[i]);
+	}
+
+	// One write per sprite. Sprites can react to this by starting or stopping tweens, or
+	// deleting sprites, so look everything up again each time round.
+	for(size_t k = 0; k < mTouched.size(); ++k) {
+		const uint32_t		record = mTouched[k];
+		Sprite*				s = mRecords[record].mSprite;
+		if(!s) continue;
+		const Values		values = mRecords[record].mValues;
+		const int			channels = mRecords[record].mChannels;
+		if(channels & (1 << NORMALIZED)) static_cast<SpriteAnimatable*>(s)->mNormalizedTweenValue = values.mValue[NORMALIZED].x;
+		s->applyTweenedValues(channels, values);
+	}
+
+	// Nothing is removed from the arrays until the next compact(), so indices stay put,
+	// but callbacks can grow the arrays, so functions are moved out before they're called.
+	std::function<void(void)>	fn;
+	for(size_t i = 0; i < n; ++i) {
+		if(!mAlive[i] || mT[i] < 0.0f || !mUpdateFn[i]) continue;
+		fn.swap(mUpdateFn[i]);
+		fn();
+		fn.swap(mUpdateFn[i]);
+	}
+	for(size_t i = 0; i < n; ++i) {
+		if(!mAlive[i] || mT[i] < 1.0f) continue;
+		fn.swap(mFinishFn[i]);
+		kill(static_cast<uint32_t>(i));
+		if(fn) fn();
+		fn = nullptr;
+	}
+
+	mUpdating = false;
+}
+
+uint32_t SpriteTweens::recordFor(Sprite& s) {
+	if(s.mTweenRecord != NONE) {
+		mRecords[s.mTweenRecord].mReleasing = false;
+		return s.mTweenRecord;
+	}
+	uint32_t				record;
+	if(!mFreeRecords.empty()) {
+		record = mFreeRecords.back();
+		mFreeRecords.pop_back();
+		mRecords[record] = Record();
+	} else {
+		record = static_cast<uint32_t>(mRecords.size());
+		mRecords.push_back(Record());
+	}
+	mRecords[record].mSprite = &s;
+	s.mTweenRecord = record;
+	return record;
+}
+
+void SpriteTweens::kill(const uint32_t tween) {
+	if(!mAlive[tween]) return;
+	mAlive[tween] = 0;
+	++mDeadCount;
+	if(mFromPending[tween]) {
+		mFromPending[tween] = 0;
+		--mPendingCount;
+	}
+
+	const uint32_t			record = mRecord[tween];
+	Record&					r = mRecords[record];
+	if(r.mTween[mChannel[tween]] == tween) r.mTween[mChannel[tween]] = NONE;
+	releaseIfEmpty(record);
+}
+
+void SpriteTweens::releaseIfEmpty(const uint32_t record) {
+	Record&					r = mRecords[record];
+	if(r.mReleasing) return;
+	for(int c = 0; c < NUM_CHANNELS; ++c) {
+		if(r.mTween[c] != NONE) return;
+	}
+	// Held until compact(), in case the sprite is still waiting for this frame's values
+	r.mReleasing = true;
+	mReleasing.push_back(record);
+}
+
+void SpriteTweens::compact() {
+	for(uint32_t i = 0; i < mAlive.size();) {
+		if(mAlive[i]) {
+			++i;
+			continue;
+		}
+		moveTween(static_cast<uint32_t>(mAlive.size() - 1), i);
+		popTween();
+	}
+	mDeadCount = 0;
+
+	for(const uint32_t record : mReleasing) {
+		Record&				r = mRecords[record];
+		// A new tween might have claimed it since
+		if(!r.mReleasing) continue;
+		if(r.mSprite) r.mSprite->mTweenRecord = NONE;
+		r = Record();
+		mFreeRecords.push_back(record);
+	}
+	mReleasing.clear();
+}
+
+void SpriteTweens::moveTween(const uint32_t from, const uint32_t to) {
+	if(from == to) return;
+	mStart[to] = mStart[from];
+	mDuration[to] = mDuration[from];
+	mFromX[to] = mFromX[from];
+	mFromY[to] = mFromY[from];
+	mFromZ[to] = mFromZ[from];
+	mFromPending[to] = mFromPending[from];
+	mToX[to] = mToX[from];
+	mToY[to] = mToY[from];
+	mToZ[to] = mToZ[from];
+	mEasePower[to] = mEasePower[from];
+	mEaseOut[to] = mEaseOut[from];
+	mEaseInOut[to] = mEaseInOut[from];
+	mEaseFn[to].swap(mEaseFn[from]);
+	mChannel[to] = mChannel[from];
+	mAlive[to] = mAlive[from];
+	mRecord[to] = mRecord[from];
+	mFinishFn[to].swap(mFinishFn[from]);
+	mUpdateFn[to].swap(mUpdateFn[from]);
+
+	if(mAlive[to]) {
+		Record&				r = mRecords[mRecord[to]];
+		if(r.mTween[mChannel[to]] == from) r.mTween[mChannel[to]] = to;
+	}
+}
+
+void SpriteTweens::popTween() {
+	mStart.pop_back();
+	mDuration.pop_back();
+	mFromX.pop_back();
+	mFromY.pop_back();
+	mFromZ.pop_back();
+	mFromPending.pop_back();
+	mToX.pop_back();
+	mToY.pop_back();
+	mToZ.pop_back();
+	mEasePower.pop_back();
+	mEaseOut.pop_back();
+	mEaseInOut.pop_back();
+	mEaseFn.pop_back();
+	mChannel.pop_back();
+	mAlive.pop_back();
+	mRecord.pop_back();
+	mFinishFn.pop_back();
+	mUpdateFn.pop_back();
+}
+
+} // namespace ui
+} // namespace ds
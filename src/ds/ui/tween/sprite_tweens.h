@@ -0,0 +1,114 @@
+#pragma once
+#ifndef DS_UI_TWEEN_SPRITETWEENS_H_
+#define DS_UI_TWEEN_SPRITETWEENS_H_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <cinder/Color.h>
+#include <cinder/Easing.h>
+#include <cinder/Vector.h>
+
+namespace ds {
+namespace ui {
+class Sprite;
+class SpriteAnimatable;
+
+/**
+ * \class ds::ui::SpriteTweens
+ * \brief Runs the built-in sprite tweens (tweenPosition(), tweenOpacity() and friends).
+ * Tweens are stored as parallel arrays instead of one timeline item and update function each.
+ * Each frame evaluates every tween in a few flat loops. The common polynomial easings run
+ * branch-free, and any other ci::EaseFn is called per tween. Then each sprite gets all of
+ * its new values in a single call, so its dirty flags and dimensional state update once
+ * no matter how many of its properties are animating. Owned by the Tweenline.
+ */
+class SpriteTweens {
+public:
+	enum Channel { POSITION, SCALE, SIZE, ROTATION, COLOR, OPACITY, NORMALIZED, NUM_CHANNELS };
+
+	/// The latest tweened value for each channel. Single values use x, colors use xyz as rgb.
+	class Values {
+	public:
+		ci::vec3				mValue[NUM_CHANNELS];
+	};
+
+	SpriteTweens();
+	/// Sprites can outlive the engine's tweenline at shutdown, so they're let go of here
+	~SpriteTweens();
+
+	/// Start a tween on one channel of the sprite, replacing any tween already on that channel.
+	/// Times are in the same timebase as update(). It runs from whatever the sprite's value is
+	/// on the first update after the delay, like a cinder timeline tween.
+	void						start(	Sprite&, const Channel, const ci::vec3& to,
+										const double startTime, const float duration, const float delay,
+										const ci::EaseFn&, const std::function<void(void)>& finishFn,
+										const std::function<void(void)>& updateFn);
+	/// Stop without setting the end value or calling the finish function
+	void						stop(SpriteAnimatable&, const Channel);
+	void						stopAll(SpriteAnimatable&);
+	/// Stop a running tween and answer its end value and finish function. Answers false if nothing was running.
+	bool						stopAtEnd(SpriteAnimatable&, const Channel, ci::vec3& end, std::function<void(void)>& finishFn);
+
+	/// Running includes waiting out a delay
+	bool						isRunning(const SpriteAnimatable&, const Channel) const;
+	size_t						size() const { return mStart.size() - mDeadCount; }
+
+	/// Evaluate everything, write the values to the sprites, then call update and finish functions.
+	void						update(const double now);
+
+private:
+	static const uint32_t		NONE = 0xFFFFFFFF;
+
+	class Record {
+	public:
+		Record();
+		Sprite*					mSprite;
+		uint32_t				mTween[NUM_CHANNELS];
+		Values					mValues;
+		int						mChannels;
+		uint64_t				mFrame;
+		bool					mReleasing;
+	};
+
+	uint32_t					recordFor(Sprite&);
+	void						kill(const uint32_t tween);
+	void						releaseIfEmpty(const uint32_t record);
+	void						compact();
+	void						moveTween(const uint32_t from, const uint32_t to);
+	void						popTween();
+
+	// One entry per tween
+	std::vector<double>			mStart;
+	std::vector<float>			mDuration;
+	std::vector<float>			mFromX, mFromY, mFromZ;
+	// Set until the from values have been read off the sprite
+	std::vector<uint8_t>		mFromPending;
+	std::vector<float>			mToX, mToY, mToZ;
+	// Polynomial easing: power, 1 to ease out, 1 to ease in and out
+	std::vector<float>			mEasePower, mEaseOut, mEaseInOut;
+	// Set for easings that aren't polynomial
+	std::vector<ci::EaseFn>		mEaseFn;
+	std::vector<uint8_t>		mChannel;
+	std::vector<uint8_t>		mAlive;
+	std::vector<uint32_t>		mRecord;
+	std::vector<std::function<void(void)>>
+								mFinishFn, mUpdateFn;
+	size_t						mDeadCount;
+	size_t						mPendingCount;
+
+	// Scratch, reused every frame
+	std::vector<float>			mT, mX, mY, mZ;
+	std::vector<uint32_t>		mTouched;
+
+	std::vector<Record>			mRecords;
+	std::vector<uint32_t>		mFreeRecords;
+	std::vector<uint32_t>		mReleasing;
+	uint64_t					mFrame;
+	bool						mUpdating;
+};
+
+} // namespace ui
+} // namespace ds
+
+#endif // DS_UI_TWEEN_SPRITETWEENS_H_
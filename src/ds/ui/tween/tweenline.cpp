@@ -21,5 +21,23 @@ cinder::Timeline& Tweenline::getTimeline()
   return mTimeline;
 }
 
+SpriteTweens& Tweenline::getSpriteTweens()
+{
+  return mSpriteTweens;
+}
+
+void Tweenline::tween(Sprite& s, const SpriteTweens::Channel c, const ci::vec3& end,
+					  const float duration, const float delay, const ci::EaseFn& easeFunction,
+					  const std::function<void(void)>& finishFn,
+					  const std::function<void(void)>& updateFn)
+{
+  mSpriteTweens.start(s, c, end, mTimeline.getCurrentTime(), duration, delay, easeFunction, finishFn, updateFn);
+}
+
+void Tweenline::update()
+{
+  mSpriteTweens.update(mTimeline.getCurrentTime());
+}
+
 } // namespace ui
 } // namespace ds
@@ -4,6 +4,7 @@
 
 #include <cinder/Timeline.h>
 #include "ds/ui/tween/sprite_anim.h"
+#include "ds/ui/tween/sprite_tweens.h"
 
 namespace ds {
 namespace ui {
@@ -23,12 +24,23 @@ public:
 										  const float delay = 0,
 										  const std::function<void(void)>& updateFn = nullptr);
 
+	/// Start one of the built-in sprite tweens (position, scale, etc.), timed against the cinder timeline
+	void							tween(Sprite&, const SpriteTweens::Channel, const ci::vec3& end,
+										  const float duration, const float delay, const ci::EaseFn& easeFunction,
+										  const std::function<void(void)>& finishFn = nullptr,
+										  const std::function<void(void)>& updateFn = nullptr);
+
+	/// Advance the built-in sprite tweens to the current timeline time. Called by the engine each update.
+	void							update();
+
 	// Clients can go nuts with full access to the cinder timeline
 	cinder::Timeline&     getTimeline();
+	SpriteTweens&         getSpriteTweens();
 
 private:
 	Tweenline();
 	cinder::Timeline&     mTimeline;
+	SpriteTweens          mSpriteTweens;
 };
 
 template <typename T>
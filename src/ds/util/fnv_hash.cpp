@@ -0,0 +1,24 @@
+#include "stdafx.h"
+
+#include "ds/util/fnv_hash.h"
+
+namespace ds {
+
+std::string fnv_to_hex(const uint64_t hash) {
+	static const char*		HEX = "0123456789abcdef";
+	std::string				ans(16, '0');
+	uint64_t				h = hash;
+	for(int k = 15; k >= 0; --k) {
+		ans[k] = HEX[h & 0xf];
+		h >>= 4;
+	}
+	return ans;
+}
+
+std::string fnv_hash_string(const std::string& s) {
+	uint64_t				h = FNV_OFFSET;
+	fnv_hash(h, s);
+	return fnv_to_hex(h);
+}
+
+} // namespace ds
@@ -0,0 +1,45 @@
+#pragma once
+#ifndef DS_UTIL_FNVHASH_H_
+#define DS_UTIL_FNVHASH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ds {
+
+/**
+ * FNV-1a, 64 bit. Quick and well spread, for cache keys, file names and checksums, but
+ * not for anything that has to stand up to someone picking inputs. Start from FNV_OFFSET
+ * and feed each part in turn.
+ */
+const uint64_t				FNV_OFFSET = 14695981039346656037ULL;
+const uint64_t				FNV_PRIME = 1099511628211ULL;
+
+inline void					fnv_hash(uint64_t& h, const void* data, const size_t size) {
+	const unsigned char*	b = static_cast<const unsigned char*>(data);
+	for(size_t k = 0; k < size; ++k) {
+		h ^= b[k];
+		h *= FNV_PRIME;
+	}
+}
+
+inline void					fnv_hash(uint64_t& h, const std::string& s) {
+	fnv_hash(h, s.data(), s.size());
+}
+
+/// The bytes of a plain value, as they are in memory
+template <typename T>
+inline void					fnv_hash_value(uint64_t& h, const T& v) {
+	fnv_hash(h, &v, sizeof(T));
+}
+
+/// 16 lowercase hex digits
+std::string					fnv_to_hex(const uint64_t);
+
+/// The hash of one string, as hex
+std::string					fnv_hash_string(const std::string&);
+
+} // namespace ds
+
+#endif
@@ -2,15 +2,20 @@
 
 #include "image_meta_data.h"
 
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <sstream>
 #include <unordered_map>
 #include <cinder/ImageIo.h>
 #include <cinder/Surface.h>
+#include <Poco/DirectoryIterator.h>
 #include <Poco/File.h>
 #include <Poco/Path.h>
 #include <Poco/String.h>
+#include <Poco/Timespan.h>
 #include "ds/app/environment.h"
 #include "ds/debug/logger.h"
-#include "ds/storage/persistent_cache.h"
 #include "ds/util/file_meta_data.h"
 #include "ds/debug/debug_defines.h"
 
@@ -23,18 +28,44 @@ namespace {
 // Should have universal formats somewhere
 const int					FORMAT_UNKNOWN = 0;
 const int					FORMAT_PNG = 1;
-
-// Storage object
-const std::string			PATH_SZ("q");
-const std::string			WIDTH_SZ("w");
-const std::string			HEIGHT_SZ("h");
-const std::string			TIMESTAMP_SZ("ts");
+const int					FORMAT_JPEG = 2;
+const int					FORMAT_GIF = 3;
+const int					FORMAT_BMP = 4;
+const int					FORMAT_TIFF = 5;
+const int					FORMAT_WEBP = 6;
+
+// Enough of the file to identify the format and read the size for everything but JPEG and TIFF
+const size_t				HEADER_SIZE = 32;
+
+// Persistent index
+const std::string			INDEX_HEADER_SZ("ds_image_meta_data 2");
+const std::string			INDEX_HEADER_V1_SZ("ds_image_meta_data 1");
+// Rows nothing has asked for in this long are dropped on save
+const Poco::Timestamp::TimeDiff	INDEX_MAX_UNUSED = Poco::Timespan::DAYS * 30;
+// Files per prescan request
+const size_t				PRESCAN_BATCH = 16;
 
 int							get_format(const std::string& filename) {
 	const Poco::Path		path(filename);
 	std::string				ext = path.getExtension();
 	Poco::toLowerInPlace(ext);
 	if (ext == "png") return FORMAT_PNG;
+	if (ext == "jpg" || ext == "jpeg" || ext == "jpe") return FORMAT_JPEG;
+	if (ext == "gif") return FORMAT_GIF;
+	if (ext == "bmp") return FORMAT_BMP;
+	if (ext == "tif" || ext == "tiff") return FORMAT_TIFF;
+	if (ext == "webp") return FORMAT_WEBP;
+	return FORMAT_UNKNOWN;
+}
+
+// Identify the format from the file signature, since extensions lie.
+int							get_format(const unsigned char* h, const size_t len) {
+	if (len >= 8 && h[0] == 0x89 && h[1] == 'P' && h[2] == 'N' && h[3] == 'G') return FORMAT_PNG;
+	if (len >= 3 && h[0] == 0xFF && h[1] == 0xD8 && h[2] == 0xFF) return FORMAT_JPEG;
+	if (len >= 6 && h[0] == 'G' && h[1] == 'I' && h[2] == 'F' && h[3] == '8') return FORMAT_GIF;
+	if (len >= 2 && h[0] == 'B' && h[1] == 'M') return FORMAT_BMP;
+	if (len >= 4 && ((h[0] == 'I' && h[1] == 'I' && h[2] == 42 && h[3] == 0) || (h[0] == 'M' && h[1] == 'M' && h[2] == 0 && h[3] == 42))) return FORMAT_TIFF;
+	if (len >= 12 && h[0] == 'R' && h[1] == 'I' && h[2] == 'F' && h[3] == 'F' && h[8] == 'W' && h[9] == 'E' && h[10] == 'B' && h[11] == 'P') return FORMAT_WEBP;
 	return FORMAT_UNKNOWN;
 }
 
@@ -43,36 +74,168 @@ uint32_t					big_endian_bytes_to_native( const char* bytes ) {
 	return (data[3]<<0) | (data[2]<<8) | (data[1]<<16) | (data[0]<<24);
 }
 
-bool						get_format_png(const std::string& filename, ci::vec2& outSize) {
-	std::ifstream file(filename, std::ios_base::binary | std::ios_base::in);
-	if (!file.is_open() || !file) return false;
+uint32_t					read_u16(const unsigned char* d, const bool bigEndian) {
+	return bigEndian ? ((d[0] << 8) | d[1]) : (d[0] | (d[1] << 8));
+}
 
-	// Skip PNG file signature
-	file.seekg(8, std::ios_base::cur);
+uint32_t					read_u32(const unsigned char* d, const bool bigEndian) {
+	return bigEndian	? ((uint32_t)d[0] << 24) | ((uint32_t)d[1] << 16) | ((uint32_t)d[2] << 8) | (uint32_t)d[3]
+						: (uint32_t)d[0] | ((uint32_t)d[1] << 8) | ((uint32_t)d[2] << 16) | ((uint32_t)d[3] << 24);
+}
 
-	// First chunk: IHDR image header
-	// Skip Chunk Length
-	file.seekg(4, std::ios_base::cur);
-	// Skip Chunk Type
-	file.seekg(4, std::ios_base::cur);
+bool						set_size(const uint32_t width, const uint32_t height, const uint32_t maxSize, ci::vec2& outSize) {
+	if(width < 1 || width > maxSize || height < 1 || height > maxSize){
+		return false;
+	}
 
-	char widthBytes[4];
-	char heightBytes[4];
-	file.read(widthBytes, 4);
-	file.read(heightBytes, 4);
+	outSize.x = static_cast<float>(width);
+	outSize.y = static_cast<float>(height);
+	return true;
+}
+
+bool						get_format_png(const unsigned char* h, const size_t len, ci::vec2& outSize) {
+	// 8 byte signature, then the IHDR chunk: 4 bytes length, 4 bytes type, width, height
+	if (len < 24) return false;
 
 	// PNG format stores as big endian, convert to native endianness
-	uint32_t width = big_endian_bytes_to_native(widthBytes);
-	uint32_t height = big_endian_bytes_to_native(heightBytes);
+	const uint32_t width = big_endian_bytes_to_native(reinterpret_cast<const char*>(h + 16));
+	const uint32_t height = big_endian_bytes_to_native(reinterpret_cast<const char*>(h + 20));
 
 	// check to make sure we correctly read the size. There's some bad png's out there
-	if(width < 1 || width > 20000 || height < 1 || height > 20000){
-		return false;
+	return set_size(width, height, 20000, outSize);
+}
+
+bool						get_format_gif(const unsigned char* h, const size_t len, ci::vec2& outSize) {
+	// Logical screen descriptor follows the 6 byte signature
+	if (len < 10) return false;
+	return set_size(read_u16(h + 6, false), read_u16(h + 8, false), 65535, outSize);
+}
+
+bool						get_format_bmp(const unsigned char* h, const size_t len, ci::vec2& outSize) {
+	// 14 byte file header, then the DIB header which starts with its own size
+	if (len < 26) return false;
+	const uint32_t			dibSize = read_u32(h + 14, false);
+	if (dibSize == 12) {
+		// OS/2 BITMAPCOREHEADER
+		return set_size(read_u16(h + 18, false), read_u16(h + 20, false), 65535, outSize);
 	}
+	// BITMAPINFOHEADER and later. Height is negative for top-down bitmaps.
+	const int32_t			width = static_cast<int32_t>(read_u32(h + 18, false));
+	const int32_t			height = static_cast<int32_t>(read_u32(h + 22, false));
+	return set_size(static_cast<uint32_t>(std::abs(width)), static_cast<uint32_t>(std::abs(height)), 65535, outSize);
+}
 
-	outSize.x = static_cast<float>(width);
-	outSize.y = static_cast<float>(height);
-	return true;
+bool						get_format_webp(const unsigned char* h, const size_t len, ci::vec2& outSize) {
+	if (len < 30) return false;
+	const unsigned char*	chunk = h + 12;
+	if (chunk[0] == 'V' && chunk[1] == 'P' && chunk[2] == '8' && chunk[3] == ' ') {
+		// Lossy: frame tag (3 bytes) then start code 9d 01 2a, then 14 bit width and height
+		if (h[23] != 0x9d || h[24] != 0x01 || h[25] != 0x2a) return false;
+		return set_size(read_u16(h + 26, false) & 0x3fff, read_u16(h + 28, false) & 0x3fff, 16383, outSize);
+	} else if (chunk[0] == 'V' && chunk[1] == 'P' && chunk[2] == '8' && chunk[3] == 'L') {
+		// Lossless: signature byte then 14 bits each of width-1 and height-1
+		if (h[20] != 0x2f) return false;
+		const uint32_t		bits = read_u32(h + 21, false);
+		return set_size((bits & 0x3fff) + 1, ((bits >> 14) & 0x3fff) + 1, 16384, outSize);
+	} else if (chunk[0] == 'V' && chunk[1] == 'P' && chunk[2] == '8' && chunk[3] == 'X') {
+		// Extended: 24 bit canvas width-1 and height-1 after 4 bytes of flags
+		const uint32_t		width = (h[24] | (h[25] << 8) | (h[26] << 16)) + 1;
+		const uint32_t		height = (h[27] | (h[28] << 8) | (h[29] << 16)) + 1;
+		return set_size(width, height, 16777216, outSize);
+	}
+	return false;
+}
+
+// Walk the marker segments until we hit a start-of-frame, which holds the size.
+bool						get_format_jpeg(std::ifstream& file, ci::vec2& outSize) {
+	file.clear();
+	file.seekg(2, std::ios_base::beg);
+
+	unsigned char			seg[7];
+	while (file) {
+		int					c = file.get();
+		if (c != 0xFF) return false;
+		// Markers may be preceded by any number of fill bytes
+		while ((c = file.get()) == 0xFF) { }
+		if (c == EOF) return false;
+
+		const unsigned char	marker = static_cast<unsigned char>(c);
+		// Standalone markers have no length
+		if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) continue;
+		// End of image or start of scan without a frame header means this isn't a file we can read
+		if (marker == 0xD9 || marker == 0xDA) return false;
+
+		if (!file.read(reinterpret_cast<char*>(seg), 2)) return false;
+		const uint32_t		segLength = read_u16(seg, true);
+		if (segLength < 2) return false;
+
+		// SOF0-SOF15, except DHT (C4), JPG (C8) and DAC (CC)
+		if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+			// precision, height, width
+			if (!file.read(reinterpret_cast<char*>(seg), 5)) return false;
+			return set_size(read_u16(seg + 3, true), read_u16(seg + 1, true), 65535, outSize);
+		}
+
+		file.seekg(segLength - 2, std::ios_base::cur);
+	}
+	return false;
+}
+
+// Read the first image file directory and look for the width and height tags.
+bool						get_format_tiff(std::ifstream& file, const unsigned char* h, const size_t len, ci::vec2& outSize) {
+	if (len < 8) return false;
+	const bool				bigEndian = (h[0] == 'M');
+	const uint32_t			ifdOffset = read_u32(h + 4, bigEndian);
+
+	file.clear();
+	file.seekg(ifdOffset, std::ios_base::beg);
+	unsigned char			buf[12];
+	if (!file.read(reinterpret_cast<char*>(buf), 2)) return false;
+	const uint32_t			entries = read_u16(buf, bigEndian);
+
+	uint32_t				width = 0,
+							height = 0;
+	for (uint32_t i = 0; i < entries && (width == 0 || height == 0); ++i) {
+		if (!file.read(reinterpret_cast<char*>(buf), 12)) return false;
+		const uint32_t		tag = read_u16(buf, bigEndian);
+		if (tag != 256 && tag != 257) continue;
+
+		// SHORT values are left-justified in the value field, LONG fills it
+		const uint32_t		type = read_u16(buf + 2, bigEndian);
+		uint32_t			value = 0;
+		if (type == 3) value = read_u16(buf + 8, bigEndian);
+		else if (type == 4) value = read_u32(buf + 8, bigEndian);
+		else continue;
+
+		if (tag == 256) width = value;
+		else height = value;
+	}
+	return set_size(width, height, 1000000, outSize);
+}
+
+// Answer the size of the image from its header only, without decoding anything.
+// outFormat is the format by signature, or by extension if the signature isn't known.
+bool						probe_header(const std::string& filename, ci::vec2& outSize, int& outFormat) {
+	outFormat = get_format(filename);
+	std::ifstream file(filename, std::ios_base::binary | std::ios_base::in);
+	if (!file.is_open() || !file) return false;
+
+	unsigned char			header[HEADER_SIZE];
+	file.read(reinterpret_cast<char*>(header), HEADER_SIZE);
+	const size_t			len = static_cast<size_t>(file.gcount());
+
+	const int				format = get_format(header, len);
+	if (format != FORMAT_UNKNOWN) outFormat = format;
+
+	switch (outFormat) {
+	case FORMAT_PNG:	return get_format_png(header, len, outSize);
+	case FORMAT_JPEG:	return get_format_jpeg(file, outSize);
+	case FORMAT_GIF:	return get_format_gif(header, len, outSize);
+	case FORMAT_BMP:	return get_format_bmp(header, len, outSize);
+	case FORMAT_TIFF:	return get_format_tiff(file, header, len, outSize);
+	case FORMAT_WEBP:	return get_format_webp(header, len, outSize);
+	default:			return false;
+	}
 }
 
 // A horrible fallback when no meta info has been supplied about the image size.
@@ -134,34 +297,51 @@ void						super_slow_image_atts(const std::string& filename, ci::vec2& outSize)
 
 }
 
-// Store a cache of parsed files.  We should have this cache to a database, but for now, just have
-// it generate at each run.
+// Store a cache of parsed files, keyed by the expanded path and validated against the modified
+// time and file size. Local files are persisted to an index in the downstream cache folder.
 namespace {
 class ImageAtts {
 public:
-	ImageAtts() {
+	ImageAtts() : mFileSize(0), mLastUsed(0), mUsed(false) {
 	}
 
-	ImageAtts(const ci::vec2& size) : mSize(size) {
+	ImageAtts(const ci::vec2& size) : mSize(size), mFileSize(0), mLastUsed(0), mUsed(false) {
 	}
 
 	Poco::Timestamp		mLastModified;
+	Poco::File::FileSize
+						mFileSize;
 	ci::vec2			mSize;
+	// When the entry was last asked for, as of the index it came from
+	Poco::Timestamp::TimeVal
+						mLastUsed;
+	// Added or asked for this run
+	bool				mUsed;
 };
 
 class ImageAttsCache {
 public:
-	ImageAttsCache() {
+	ImageAttsCache()
+			: mIndexEnabled(true)
+			, mIndexLoaded(false)
+			, mIndexDirty(false) {
 	}
 
 	void				add(const std::string& filePath, const ci::vec2 size){
 		if(size.x> 0 && size.y > 0){
+			// Load first, so the index can't replace this later and save() knows where to write
+			loadOnce();
 			try{
 				ImageAtts atts(size);
-				if(ds::safeFileExistsCheck(filePath, false)) {
-					const auto file = Poco::File(filePath);
+				const std::string expanded_fn = ds::Environment::expand(filePath);
+				if(ds::safeFileExistsCheck(expanded_fn, false)) {
+					const auto file = Poco::File(expanded_fn);
 					atts.mLastModified = file.getLastModified();
-					mCache[filePath] = atts;
+					atts.mFileSize = file.getSize();
+					atts.mUsed = true;
+					std::lock_guard<std::mutex> lock(mMutex);
+					mCache[expanded_fn] = atts;
+					mIndexDirty = true;
 				} else {
 					DS_LOG_WARNING_M("ImageAttsCache::add : File does not exist when finding metadata: " << filePath, GENERAL_LOG);
 				}
@@ -172,7 +352,7 @@ public:
 	}
 
 	ci::vec2			getSize(const std::string& fn) {
-		// If I've got a cached item and the modified dates match, use that.
+		// If I've got a cached item and the modified dates and sizes match, use that.
 		// Note: for the actual path, use the expanded fn.
 
 		std::string	expanded_fn;
@@ -184,14 +364,29 @@ public:
 			expanded_fn = ds::Environment::expand(fn);
 		}
 
+		loadOnce();
+
+		Poco::Timestamp			lastModified;
+		Poco::File::FileSize	fileSize = 0;
 		try {
-			auto f = mCache.find(fn);
-			
+			if(!webMode) {
+				const Poco::File file(expanded_fn);
+				lastModified = file.getLastModified();
+				fileSize = file.getSize();
+			}
+
+			std::lock_guard<std::mutex> lock(mMutex);
+			auto f = mCache.find(expanded_fn);
 			if(f != mCache.end()){
 				// we hope that the remote image hasn't changed since we grabbed it's size.
 				if(webMode){
 					return f->second.mSize;
-				} else if(f->second.mLastModified == Poco::File(expanded_fn).getLastModified()) {
+				} else if(f->second.mLastModified == lastModified && f->second.mFileSize == fileSize) {
+					// The first use this run moves its last used time forward
+					if(!f->second.mUsed) {
+						f->second.mUsed = true;
+						mIndexDirty = true;
+					}
 					return f->second.mSize;
 				}
 			}
@@ -203,8 +398,12 @@ public:
 			ImageAtts		atts = generate(expanded_fn);
 			if (atts.mSize.x > 0.0f && atts.mSize.y > 0.0f) {
 				// calling anything on an invalid file throws an exception, and web stuff is invalid
-				if(!webMode) atts.mLastModified = Poco::File(expanded_fn).getLastModified();
-				mCache[fn] = atts;
+				atts.mLastModified = lastModified;
+				atts.mFileSize = fileSize;
+				atts.mUsed = true;
+				std::lock_guard<std::mutex> lock(mMutex);
+				mCache[expanded_fn] = atts;
+				if(!webMode) mIndexDirty = true;
 				return atts.mSize;
 			}
 		} catch (std::exception const&) {
@@ -212,7 +411,135 @@ public:
 		return ci::vec2(0.0f, 0.0f);
 	}
 
+	void				setIndexEnabled(const bool enabled) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		mIndexEnabled = enabled;
+	}
+
+	void				setIndexFolder(const std::string& folder) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		mIndexFolder = folder;
+		mIndexPath.clear();
+		mIndexLoaded = false;
+		mIndexDirty = false;
+		mCache.clear();
+	}
+
+	void				save() {
+		// Copy the rows under the lock and write them outside it, since checking on the
+		// files nothing asked for this run can take a while
+		std::vector<std::pair<std::string, ImageAtts>>	rows;
+		std::string		indexPath;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if(!mIndexEnabled || !mIndexDirty || mIndexPath.empty()) return;
+			rows.assign(mCache.begin(), mCache.end());
+			indexPath = mIndexPath;
+			mIndexDirty = false;
+		}
+
+		// Write to a temp file and swap it in, so a crash mid-write doesn't lose the index
+		const Poco::Timestamp::TimeVal	now = Poco::Timestamp().epochMicroseconds();
+		const std::string	tempPath = indexPath + ".tmp";
+		std::vector<std::string>		pruned;
+		bool				written = false;
+		{
+			std::ofstream	out(tempPath, std::ios_base::out | std::ios_base::trunc);
+			if(out) {
+				out << INDEX_HEADER_SZ << "\n";
+				for(auto it = rows.begin(), end = rows.end(); it != end; ++it) {
+					// Web images don't have a modified date, so they aren't worth keeping around
+					if(it->first.find("http") == 0) continue;
+					// Rows nothing asked for go once they've sat long enough or the file is gone
+					if(!it->second.mUsed && (now - it->second.mLastUsed > INDEX_MAX_UNUSED || !ds::safeFileExistsCheck(it->first, false))) {
+						pruned.push_back(it->first);
+						continue;
+					}
+					out << it->second.mLastModified.epochMicroseconds() << "\t" << it->second.mFileSize << "\t"
+						<< static_cast<int>(it->second.mSize.x) << "\t" << static_cast<int>(it->second.mSize.y) << "\t"
+						<< (it->second.mUsed ? now : it->second.mLastUsed) << "\t" << it->first << "\n";
+				}
+				written = static_cast<bool>(out);
+			}
+		}
+
+		try {
+			if(!written) {
+				DS_LOG_WARNING_M("ImageAttsCache::save could not write index to " << tempPath, GENERAL_LOG);
+			} else {
+				Poco::File(tempPath).renameTo(indexPath);
+			}
+		} catch (std::exception const& ex) {
+			DS_LOG_WARNING_M("ImageAttsCache::save error=" << ex.what(), GENERAL_LOG);
+			written = false;
+		}
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		if(!written) {
+			mIndexDirty = true;
+			return;
+		}
+		for(auto& it : pruned) {
+			auto	f = mCache.find(it);
+			if(f != mCache.end() && !f->second.mUsed) mCache.erase(f);
+		}
+	}
+
 private:
+	void				loadOnce() {
+		std::lock_guard<std::mutex> lock(mMutex);
+		if(mIndexLoaded || !mIndexEnabled) return;
+		mIndexLoaded = true;
+
+		try {
+			Poco::Path		p(mIndexFolder.empty() ? ds::Environment::getDownstreamDocumentsFolder() : mIndexFolder);
+			if(mIndexFolder.empty()) p.append("cache").append("image_meta_data");
+			Poco::File		dir(p.toString());
+			if(!dir.exists()) dir.createDirectories();
+			p.append("index.txt");
+			mIndexPath = p.toString();
+		} catch (std::exception const& ex) {
+			DS_LOG_WARNING_M("ImageAttsCache could not create the index folder error=" << ex.what(), GENERAL_LOG);
+			return;
+		}
+
+		std::ifstream		in(mIndexPath);
+		if(!in) return;
+
+		// The first version didn't have a last used column, count those rows as used when they're loaded
+		std::string			line;
+		if(!std::getline(in, line)) return;
+		const bool			hasLastUsed = (line == INDEX_HEADER_SZ);
+		if(!hasLastUsed && line != INDEX_HEADER_V1_SZ) {
+			DS_LOG_WARNING_M("ImageAttsCache ignoring out of date index at " << mIndexPath, GENERAL_LOG);
+			return;
+		}
+		const Poco::Timestamp::TimeVal	now = Poco::Timestamp().epochMicroseconds();
+
+		while(std::getline(in, line)) {
+			std::istringstream	ss(line);
+			Poco::Timestamp::TimeVal	modified = 0,
+										lastUsed = now;
+			Poco::File::FileSize		fileSize = 0;
+			int							w = 0,
+										h = 0;
+			if(!(ss >> modified >> fileSize >> w >> h)) continue;
+			if(hasLastUsed && !(ss >> lastUsed)) continue;
+
+			std::string			path;
+			ss.get();
+			std::getline(ss, path);
+			if(path.empty() || w < 1 || h < 1) continue;
+
+			ImageAtts			atts(ci::vec2(static_cast<float>(w), static_cast<float>(h)));
+			atts.mLastModified = Poco::Timestamp(modified);
+			atts.mFileSize = fileSize;
+			atts.mLastUsed = lastUsed;
+			// insert() leaves an entry that's already here alone, anything added this run is newer than what's on disk
+			mCache.insert(std::make_pair(path, atts));
+		}
+	}
+
 	ImageAtts			generate(const std::string& fn) const {
 		// 1. Look for meta data encoded in file name
 		try {
@@ -226,21 +553,23 @@ private:
 		}
 
 		// 2. Probe known file formats
+		int						format = get_format(fn);
 		try {
 			ImageAtts			atts;
-			const int			format = get_format(fn);
-			if (format == FORMAT_PNG && get_format_png(fn, atts.mSize)) {
+			if (probe_header(fn, atts.mSize, format)) {
 				return atts;
 			}
 		} catch (std::exception const& e) {
 			DS_LOG_WARNING_M("ImageFileAtts() error=" << e.what(), GENERAL_LOG);
 		}
 
-		// 3. let's see if there's exif data
-		int outW = 0;
-		int outH = 0;
-		if(ds::ExifHelper::getImageSize(fn, outW, outH)){
-			return ImageAtts(ci::vec2(static_cast<float>(outW), static_cast<float>(outH)));
+		// 3. let's see if there's exif data. Any JPEG, whether it's .jpg, .jpeg, .jpe or only has the signature
+		if(format == FORMAT_JPEG) {
+			int outW = 0;
+			int outH = 0;
+			if(ds::ExifHelper::getImageSize(fn, outW, outH)){
+				return ImageAtts(ci::vec2(static_cast<float>(outW), static_cast<float>(outH)));
+			}
 		}
 
 		// 4. Load the whole damn image in and get that.
@@ -249,10 +578,35 @@ private:
 		return atts;
 	}
 
+	std::mutex			mMutex;
 	std::unordered_map<std::string, ImageAtts>	mCache;
+	std::string			mIndexFolder;
+	std::string			mIndexPath;
+	bool				mIndexEnabled;
+	bool				mIndexLoaded;
+	bool				mIndexDirty;
 };
 
 ImageAttsCache			CACHE;
+
+void					collect_image_files(const Poco::Path& directory, const bool recursive, std::vector<std::string>& out) {
+	try {
+		Poco::DirectoryIterator		end;
+		for(Poco::DirectoryIterator it(directory); it != end; ++it) {
+			try {
+				if(it->isDirectory()) {
+					if(recursive) collect_image_files(it.path(), recursive, out);
+				} else if(get_format(it.path().toString()) != FORMAT_UNKNOWN) {
+					out.push_back(it.path().toString());
+				}
+			} catch(std::exception const&) {
+			}
+		}
+	} catch(std::exception const& ex) {
+		DS_LOG_WARNING_M("ImageMetaData::prescanDirectory could not read directory " << directory.toString() << " error=" << ex.what(), GENERAL_LOG);
+	}
+}
+
 }
 
 /**
@@ -275,5 +629,78 @@ void ImageMetaData::add( const std::string& filePath, const ci::vec2 size ){
 	CACHE.add(filePath, size);
 }
 
+void ImageMetaData::saveIndex() {
+	CACHE.save();
+}
+
+void ImageMetaData::setIndexEnabled(const bool enabled) {
+	CACHE.setIndexEnabled(enabled);
+}
+
+void ImageMetaData::setIndexFolder(const std::string& folder) {
+	CACHE.setIndexFolder(folder);
+}
+
+/**
+ * \class ds::ImagePrescan
+ */
+ImagePrescan::ImagePrescan(ds::ui::SpriteEngine& eng)
+		: mProbes(eng)
+		, mPending(0)
+		, mFound(0) {
+	mProbes.setReplyHandler([this](Probe& p){ onProbed(p); });
+}
+
+size_t ImagePrescan::start(const std::string& directory, const bool recursive, const DoneCallback& callback) {
+	std::vector<std::string>	files;
+	collect_image_files(Poco::Path(ds::Environment::expand(directory)), recursive, files);
+	if(callback) mDoneCallback = callback;
+	if(files.empty()) {
+		if(mPending == 0) finish();
+		return 0;
+	}
+
+	// A few files to a request, so a big folder doesn't flood the work queue
+	for(size_t i = 0; i < files.size(); i += PRESCAN_BATCH) {
+		const size_t			end = std::min(files.size(), i + PRESCAN_BATCH);
+		++mPending;
+		const bool				started = mProbes.start([&files, i, end](Probe& p) {
+			p.mFiles.assign(files.begin() + i, files.begin() + end);
+			p.mFound = 0;
+		});
+		if(!started) {
+			DS_LOG_WARNING_M("ImagePrescan couldn't queue " << (end - i) << " files from " << directory, GENERAL_LOG);
+			--mPending;
+		}
+	}
+	if(mPending == 0) finish();
+	return files.size();
+}
+
+void ImagePrescan::onProbed(Probe& p) {
+	mFound += p.mFound;
+	p.mFiles.clear();
+	if(mPending > 0 && --mPending == 0) finish();
+}
+
+void ImagePrescan::finish() {
+	CACHE.save();
+	const size_t				found = mFound;
+	mFound = 0;
+	DoneCallback				callback;
+	callback.swap(mDoneCallback);
+	if(callback) callback(found);
+}
+
+ImagePrescan::Probe::Probe()
+		: mFound(0) {
+}
+
+void ImagePrescan::Probe::run() {
+	for(auto& it : mFiles) {
+		const ci::vec2			size = CACHE.getSize(it);
+		if(size.x > 0.0f && size.y > 0.0f) ++mFound;
+	}
+}
 
 } // namespace ds
@@ -2,15 +2,25 @@
 #ifndef DS_UTIL_IMAGEMETADATA_H_
 #define DS_UTIL_IMAGEMETADATA_H_
 
+#include <functional>
 #include <string>
+#include <vector>
 #include <cinder/Vector.h>
+#include <Poco/Runnable.h>
+#include "ds/thread/parallel_runnable.h"
 
 namespace ds {
+namespace ui {
+class SpriteEngine;
+}
 
 /**
  * \class ds::ImageMetaData
  * \brief Read meta data for image files.
- * NOTE: This can be VERY slow, if the image needs to be loaded.
+ * Sizes are probed from the file header for PNG, JPEG, GIF, BMP, TIFF and WebP.
+ * Results are cached by path, modified time and file size, and the cache is
+ * persisted to disk so subsequent runs don't need to touch the files at all.
+ * NOTE: This can be VERY slow for other formats, if the image needs to be loaded.
  */
 class ImageMetaData {
 public:
@@ -21,6 +31,55 @@ public:
 	void						add(const std::string& filePath, const ci::vec2 size );
 
 	ci::vec2					mSize;
+
+	/// Write the cache to disk. The engine does this when it shuts down, and a prescan does it when it's done.
+	/// Rows for files that are gone, or that nothing has asked for in 30 days, are dropped.
+	static void					saveIndex();
+
+	/// Turn the on-disk index on or off. Defaults to on. Turning it off doesn't clear the in-memory cache.
+	static void					setIndexEnabled(const bool enabled);
+	/// Keep the index in this folder instead of the downstream documents cache folder.
+	/// Clears the in-memory cache, the next lookup loads from the new folder.
+	static void					setIndexFolder(const std::string& folder);
+};
+
+/**
+ * \class ds::ImagePrescan
+ * \brief Probe every image file in a directory on the engine's WorkManager and add them to the
+ * ImageMetaData cache. The index is saved and the callback called from the engine's update once
+ * the last file is done.
+ */
+class ImagePrescan {
+public:
+	/// Gets the number of images that had a size
+	typedef std::function<void(const size_t found)>	DoneCallback;
+
+	ImagePrescan(ds::ui::SpriteEngine&);
+
+	/// Queue every image file in the directory. Answers the number of files queued. Starting again
+	/// while a scan is running adds to it, and the callback waits for all of it. With nothing to
+	/// wait for the callback is called right away.
+	size_t						start(const std::string& directory, const bool recursive = true, const DoneCallback& = nullptr);
+	bool						isRunning() const { return mPending > 0; }
+
+private:
+	class Probe : public Poco::Runnable {
+	public:
+		Probe();
+
+		std::vector<std::string>	mFiles;
+		size_t					mFound;
+
+		virtual void			run();
+	};
+
+	void						onProbed(Probe&);
+	void						finish();
+
+	ds::ParallelRunnable<Probe>	mProbes;
+	size_t						mPending;
+	size_t						mFound;
+	DoneCallback				mDoneCallback;
 };
 
 } // namespace ds
@@ -0,0 +1,94 @@
+#include "stdafx.h"
+
+#include "ds/util/scaled_jpeg.h"
+
+#ifdef DS_CINDER_HAVE_LIBJPEG
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+extern "C" {
+#include <jpeglib.h>
+}
+#endif
+
+namespace ds {
+
+#ifdef DS_CINDER_HAVE_LIBJPEG
+namespace {
+// libjpeg's own error handler ends the process
+struct jump_error {
+	jpeg_error_mgr		mMgr;
+	std::jmp_buf		mJump;
+};
+
+void					jump_on_error(j_common_ptr cinfo) {
+	std::longjmp(reinterpret_cast<jump_error*>(cinfo->err)->mJump, 1);
+}
+
+void					no_message(j_common_ptr) {
+}
+
+// Nothing in here needs destroying, an error jumps straight back to the setjmp
+bool					decode(std::FILE* file, const int minEdge, ci::Surface8u& out, ci::ivec2& fullSize) {
+	jpeg_decompress_struct	cinfo;
+	jump_error			err;
+	cinfo.err = jpeg_std_error(&err.mMgr);
+	err.mMgr.error_exit = jump_on_error;
+	err.mMgr.output_message = no_message;
+	if(setjmp(err.mJump)) {
+		jpeg_destroy_decompress(&cinfo);
+		return false;
+	}
+
+	jpeg_create_decompress(&cinfo);
+	jpeg_stdio_src(&cinfo, file);
+	jpeg_read_header(&cinfo, TRUE);
+	fullSize = ci::ivec2(static_cast<int>(cinfo.image_width), static_cast<int>(cinfo.image_height));
+
+	const int			edge = std::max(fullSize.x, fullSize.y);
+	unsigned int		denom = 1;
+	while(denom < 8 && edge / static_cast<int>(denom * 2) >= minEdge) denom *= 2;
+	cinfo.scale_num = 1;
+	cinfo.scale_denom = denom;
+	cinfo.out_color_space = JCS_RGB;
+
+	jpeg_start_decompress(&cinfo);
+	if(cinfo.output_components != 3) {
+		jpeg_destroy_decompress(&cinfo);
+		return false;
+	}
+	out = ci::Surface8u(static_cast<int32_t>(cinfo.output_width), static_cast<int32_t>(cinfo.output_height), false, ci::SurfaceChannelOrder::RGB);
+	while(cinfo.output_scanline < cinfo.output_height) {
+		JSAMPROW		row = out.getData() + static_cast<size_t>(cinfo.output_scanline) * out.getRowBytes();
+		jpeg_read_scanlines(&cinfo, &row, 1);
+	}
+	jpeg_finish_decompress(&cinfo);
+	jpeg_destroy_decompress(&cinfo);
+	return true;
+}
+}
+
+bool load_scaled_jpeg(const std::string& path, const int minEdge, ci::Surface8u& out, ci::ivec2* fullSize) {
+	std::FILE*			file = std::fopen(path.c_str(), "rb");
+	if(!file) return false;
+
+	// Anything else goes to ci::loadImage() without libjpeg looking at it
+	unsigned char		magic[2] = { 0, 0 };
+	ci::ivec2			size;
+	const bool			decoded = std::fread(magic, 1, 2, file) == 2 && magic[0] == 0xFF && magic[1] == 0xD8
+								&& std::fseek(file, 0, SEEK_SET) == 0 && decode(file, minEdge, out, size);
+	std::fclose(file);
+	if(!decoded) {
+		out = ci::Surface8u();
+		return false;
+	}
+	if(fullSize) *fullSize = size;
+	return true;
+}
+#else
+bool load_scaled_jpeg(const std::string&, const int, ci::Surface8u&, ci::ivec2*) {
+	return false;
+}
+#endif
+
+} // namespace ds
@@ -0,0 +1,23 @@
+#pragma once
+#ifndef DS_UTIL_SCALEDJPEG_H_
+#define DS_UTIL_SCALEDJPEG_H_
+
+#include <string>
+#include <cinder/Surface.h>
+
+namespace ds {
+
+/**
+ * Decode a JPEG at 1/2, 1/4 or 1/8 of its size, whichever is smallest with a long edge still
+ * at least minEdge pixels. The decoder drops the DCT coefficients it doesn't need, so a big
+ * photo meant for a thumbnail decodes several times faster and in a fraction of the memory.
+ * fullSize, if given, gets the size of the image at 1/1.
+ *
+ * Answers false if the file isn't a JPEG libjpeg can turn into RGB (CMYK, for one), or if
+ * libjpeg isn't built in (DS_CINDER_HAVE_LIBJPEG). Load those with ci::loadImage().
+ */
+bool	load_scaled_jpeg(const std::string& path, const int minEdge, ci::Surface8u& out, ci::ivec2* fullSize = nullptr);
+
+} // namespace ds
+
+#endif // DS_UTIL_SCALEDJPEG_H_
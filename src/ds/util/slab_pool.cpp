@@ -0,0 +1,102 @@
+#include "stdafx.h"
+
+#include "ds/util/slab_pool.h"
+
+#include <algorithm>
+#include <new>
+
+namespace ds {
+
+namespace {
+// Every block has to be able to hold the free list link, and is aligned like operator new would
+const size_t				MIN_GRANULARITY = 16;
+// Never carve fewer blocks than this from a slab, however big they are
+const size_t				MIN_BLOCKS_PER_SLAB = 8;
+}
+
+/**
+ * \class ds::SlabPool::Stats
+ */
+SlabPool::Stats::Stats()
+		: mSlabs(0)
+		, mSlabBytes(0)
+		, mLiveBlocks(0)
+		, mLiveLarge(0)
+		, mAllocations(0) {
+}
+
+/**
+ * \class ds::SlabPool
+ */
+SlabPool::SlabPool(const size_t granularity, const size_t maxBlockSize, const size_t slabSize)
+		: mGranularity((std::max(granularity, MIN_GRANULARITY) + MIN_GRANULARITY - 1) / MIN_GRANULARITY * MIN_GRANULARITY)
+		, mMaxBlockSize(maxBlockSize)
+		, mSlabSize(slabSize) {
+	mFree.resize(mMaxBlockSize / mGranularity + 1, nullptr);
+}
+
+SlabPool::~SlabPool() {
+	for(auto it = mSlabs.begin(), end = mSlabs.end(); it != end; ++it) {
+		::operator delete(*it);
+	}
+}
+
+void* SlabPool::allocate(const size_t size) {
+	if(size == 0 || size > mMaxBlockSize) {
+		void*					p = ::operator new(size);
+		std::lock_guard<std::mutex>	lock(mMutex);
+		++mStats.mLiveLarge;
+		++mStats.mAllocations;
+		return p;
+	}
+
+	const size_t				sizeClass = (size + mGranularity - 1) / mGranularity;
+	std::lock_guard<std::mutex>	lock(mMutex);
+	if(!mFree[sizeClass]) addSlab(sizeClass);
+	FreeBlock*					block = mFree[sizeClass];
+	mFree[sizeClass] = block->mNext;
+	++mStats.mLiveBlocks;
+	++mStats.mAllocations;
+	return block;
+}
+
+void SlabPool::deallocate(void* p, const size_t size) {
+	if(!p) return;
+	if(size == 0 || size > mMaxBlockSize) {
+		::operator delete(p);
+		std::lock_guard<std::mutex>	lock(mMutex);
+		--mStats.mLiveLarge;
+		return;
+	}
+
+	const size_t				sizeClass = (size + mGranularity - 1) / mGranularity;
+	FreeBlock*					block = static_cast<FreeBlock*>(p);
+	std::lock_guard<std::mutex>	lock(mMutex);
+	block->mNext = mFree[sizeClass];
+	mFree[sizeClass] = block;
+	--mStats.mLiveBlocks;
+}
+
+SlabPool::Stats SlabPool::getStats() const {
+	std::lock_guard<std::mutex>	lock(mMutex);
+	return mStats;
+}
+
+void SlabPool::addSlab(const size_t sizeClass) {
+	const size_t				blockSize = sizeClass * mGranularity;
+	const size_t				count = std::max(MIN_BLOCKS_PER_SLAB, mSlabSize / blockSize);
+	const size_t				bytes = count * blockSize;
+	char*						slab = static_cast<char*>(::operator new(bytes));
+	mSlabs.push_back(slab);
+	++mStats.mSlabs;
+	mStats.mSlabBytes += bytes;
+
+	// Link back to front, so blocks are handed out in address order
+	for(size_t k = count; k > 0; --k) {
+		FreeBlock*				block = reinterpret_cast<FreeBlock*>(slab + (k - 1) * blockSize);
+		block->mNext = mFree[sizeClass];
+		mFree[sizeClass] = block;
+	}
+}
+
+} // namespace ds
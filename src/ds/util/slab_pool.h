@@ -0,0 +1,66 @@
+#pragma once
+#ifndef DS_UTIL_SLABPOOL_H_
+#define DS_UTIL_SLABPOOL_H_
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace ds {
+
+/**
+ * \class ds::SlabPool
+ * \brief Fixed-size blocks carved out of large slabs, one free list per size class.
+ * Meant for objects that are made and thrown away constantly, where going to the
+ * general heap each time fragments it. Freed blocks go back on their class's free
+ * list and are never returned to the heap. Anything bigger than the largest class
+ * goes straight to the heap. Thread safe.
+ */
+class SlabPool {
+public:
+	/// Classes are granularity bytes apart up to maxBlockSize. Each slab is at least slabSize bytes.
+	SlabPool(const size_t granularity, const size_t maxBlockSize, const size_t slabSize);
+	~SlabPool();
+
+	void*						allocate(const size_t);
+	/// size must be the size that was passed to allocate()
+	void						deallocate(void*, const size_t);
+
+	class Stats {
+	public:
+		Stats();
+		size_t					mSlabs;
+		size_t					mSlabBytes;
+		// Blocks handed out from slabs and not yet returned
+		size_t					mLiveBlocks;
+		// Allocations too big for any class
+		size_t					mLiveLarge;
+		// Every allocate() so far
+		size_t					mAllocations;
+	};
+	Stats						getStats() const;
+
+private:
+	SlabPool(const SlabPool&);
+	SlabPool&					operator=(const SlabPool&);
+
+	class FreeBlock {
+	public:
+		FreeBlock*				mNext;
+	};
+
+	void						addSlab(const size_t sizeClass);
+
+	const size_t				mGranularity;
+	const size_t				mMaxBlockSize;
+	const size_t				mSlabSize;
+
+	mutable std::mutex			mMutex;
+	std::vector<FreeBlock*>		mFree;
+	std::vector<char*>			mSlabs;
+	Stats						mStats;
+};
+
+} // namespace ds
+
+#endif // DS_UTIL_SLABPOOL_H_
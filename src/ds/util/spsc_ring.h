@@ -0,0 +1,65 @@
+#pragma once
+#ifndef DS_UTIL_SPSCRING_H_
+#define DS_UTIL_SPSCRING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace ds {
+
+/**
+ * \class ds::SpscRing
+ * \brief Fixed-size, lock-free queue between exactly one producer thread and one consumer thread.
+ * Slots are allocated once up front, and both sides work on them in place, so nothing is
+ * allocated or copied per item. N must be a power of two.
+ */
+template <typename T, size_t N>
+class SpscRing {
+public:
+	static_assert(N > 1 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+	SpscRing() : mSlots(new T[N]), mHead(0), mTail(0) {}
+
+	/// Producer. Answers the next free slot to fill in, or nullptr if the ring is full.
+	T*						beginPush() {
+		const size_t		head = mHead.load(std::memory_order_relaxed);
+		if(head - mTail.load(std::memory_order_acquire) >= N) return nullptr;
+		return &mSlots[head & (N - 1)];
+	}
+	/// Producer. Publishes the slot from beginPush() to the consumer.
+	void					commitPush() {
+		mHead.store(mHead.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	/// Consumer. Answers the oldest item, or nullptr if the ring is empty.
+	T*						front() {
+		const size_t		tail = mTail.load(std::memory_order_relaxed);
+		if(tail == mHead.load(std::memory_order_acquire)) return nullptr;
+		return &mSlots[tail & (N - 1)];
+	}
+	/// Consumer. Hands the slot from front() back to the producer.
+	void					pop() {
+		mTail.store(mTail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	/// Approximate when called from neither side
+	size_t					size() const {
+		return mHead.load(std::memory_order_acquire) - mTail.load(std::memory_order_acquire);
+	}
+
+private:
+	SpscRing(const SpscRing&);
+	SpscRing&				operator=(const SpscRing&);
+
+	std::unique_ptr<T[]>	mSlots;
+	// Keep the two sides on separate cache lines
+	alignas(64) std::atomic<size_t>
+							mHead;
+	alignas(64) std::atomic<size_t>
+							mTail;
+};
+
+} // namespace ds
+
+#endif // DS_UTIL_SPSCRING_H_
@@ -0,0 +1,161 @@
+#include "ds_test.h"
+
+#include <cinder/DataSource.h>
+#include <cinder/Surface.h>
+#include <cinder/Xml.h>
+#include <ds/arc/arc_input.h>
+#include <ds/arc/arc_io.h>
+#include <ds/arc/arc_render_circle.h>
+#include <ds/math/math_func.h>
+
+namespace {
+
+// Arcs as they'd be written in an arc file
+const char*					PLAIN_LAYER = "<layer><color rgb=\"255,0,0,200\"/></layer>";
+const char*					LAYER_CHAIN =
+	"<arc type=\"chain\">"
+		"<layer input=\"degree\">"
+			"<color rgb=\"10,200,30\"/><scale mode=\"fit\" amount=\"0.8\"/><offset x=\"7\" y=\"-3\"/>"
+			"<arc type=\"chain\">"
+				"<arc type=\"map\"><from_min value=\"0.2\"/><to_max value=\"0.7\"/></arc>"
+				"<arc type=\"pow\"><exp value=\"2.3\"/></arc>"
+			"</arc>"
+		"</layer>"
+		"<layer><color rgb=\"0,0,255,128\"/><arc type=\"map\"><to_min value=\"-0.3\"/><to_max value=\"1.4\"/></arc></layer>"
+		"<layer><scale amount=\"1.7\"/><arc type=\"pow\"><exp value=\"0.5\"/></arc></layer>"
+	"</arc>";
+
+std::unique_ptr<ds::arc::Arc> parse(const std::string& str){
+	const ci::XmlTree		xml(ci::DataSourceBuffer::create(ci::Buffer::create(const_cast<char*>(str.data()), str.size())));
+	for(auto it = xml.begin(), end = xml.end(); it != end; ++it){
+		std::unique_ptr<ds::arc::Arc>	a(ds::arc::create(*it));
+		if(a) return a;
+	}
+	return nullptr;
+}
+
+float un_premult(const float v, const float a){
+	if(a < 1.0f && a > 0.0f) return v / a;
+	return v;
+}
+
+uint8_t to_color(const float v){
+	if(v <= 0.0f) return 0;
+	if(v >= 1.0f) return 255;
+	return static_cast<uint8_t>(v*255.0f);
+}
+
+// The golden image: the arc evaluated one pixel at a time through renderCircle(), the way
+// every arc was rendered before they were compiled.
+void render_reference(const ds::arc::Input& input, ci::Surface8u& s, ds::arc::Arc& a){
+	ds::arc::RenderCircleParams	params;
+	params.mW = s.getWidth();
+	params.mH = s.getHeight();
+	params.mCenX = (s.getWidth() - 1) / 2.0;
+	params.mCenY = (s.getHeight() - 1) / 2.0;
+	params.mMaxDist = ds::math::dist(params.mCenX, params.mCenY, params.mCenX, 0.0);
+
+	auto					pix = s.getIter();
+	params.mY = 0.0;
+	while(pix.line()){
+		params.mX = 0.0;
+		while(pix.pixel()){
+			params.mOutput = ci::ColorA(0.0f, 0.0f, 0.0f, 0.0f);
+			a.renderCircle(input, params);
+			pix.r() = to_color(un_premult(params.mOutput.r, params.mOutput.a));
+			pix.g() = to_color(un_premult(params.mOutput.g, params.mOutput.a));
+			pix.b() = to_color(un_premult(params.mOutput.b, params.mOutput.a));
+			pix.a() = to_color(params.mOutput.a);
+			++params.mX;
+		}
+		++params.mY;
+	}
+}
+
+// Pixels that differ, by channel value, so row padding doesn't count
+int count_differences(ci::Surface8u& a, ci::Surface8u& b){
+	int						diffs = 0;
+	auto					ia = a.getIter(), ib = b.getIter();
+	while(ia.line() && ib.line()){
+		while(ia.pixel() && ib.pixel()){
+			if(ia.r() != ib.r() || ia.g() != ib.g() || ia.b() != ib.b() || ia.a() != ib.a()) ++diffs;
+		}
+	}
+	return diffs;
+}
+
+void check_matches_golden(const char* arcXml, const int w, const int h, const int threads, const ci::SurfaceChannelOrder& order){
+	std::unique_ptr<ds::arc::Arc>	a(parse(arcXml));
+	DS_CHECK(a != nullptr);
+
+	ds::arc::Input			input;
+	ci::Surface8u			golden(w, h, true, order), out(w, h, true, order);
+	render_reference(input, golden, *a);
+
+	ds::arc::RenderCircle	render;
+	render.setNumThreads(threads);
+	render.on(input, out, *a);
+	DS_CHECK_EQ(count_differences(golden, out), 0);
+}
+
+}
+
+DS_TEST(plain_layer_matches_golden){
+	const int				sizes[][2] = { { 1, 1 }, { 3, 5 }, { 64, 64 }, { 257, 131 }, { 1000, 300 } };
+	for(auto& it : sizes){
+		check_matches_golden(PLAIN_LAYER, it[0], it[1], 1, ci::SurfaceChannelOrder::RGBA);
+		check_matches_golden(PLAIN_LAYER, it[0], it[1], 0, ci::SurfaceChannelOrder::RGBA);
+	}
+}
+
+DS_TEST(layer_chain_matches_golden){
+	const int				sizes[][2] = { { 1, 1 }, { 3, 5 }, { 64, 64 }, { 257, 131 }, { 1024, 1024 } };
+	for(auto& it : sizes){
+		check_matches_golden(LAYER_CHAIN, it[0], it[1], 1, ci::SurfaceChannelOrder::RGBA);
+		check_matches_golden(LAYER_CHAIN, it[0], it[1], 0, ci::SurfaceChannelOrder::RGBA);
+	}
+}
+
+DS_TEST(other_channel_orders_match_golden){
+	check_matches_golden(LAYER_CHAIN, 300, 200, 0, ci::SurfaceChannelOrder::BGRA);
+	check_matches_golden(LAYER_CHAIN, 300, 200, 0, ci::SurfaceChannelOrder::ARGB);
+}
+
+DS_TEST(repeated_renders_are_stable){
+	// The pool is reused across calls, every call has to see its own rows only
+	std::unique_ptr<ds::arc::Arc>	a(parse(LAYER_CHAIN));
+	ds::arc::Input			input;
+	ci::Surface8u			first(512, 512, true), again(512, 512, true);
+	ds::arc::RenderCircle	render;
+	render.on(input, first, *a);
+	for(int i = 0; i < 20; ++i){
+		render.on(input, again, *a);
+		DS_CHECK_EQ(count_differences(first, again), 0);
+	}
+}
+
+DS_BENCH(render_circle){
+	std::unique_ptr<ds::arc::Arc>	a(parse(LAYER_CHAIN));
+	ds::arc::Input			input;
+
+	const int				sizes[] = { 128, 512, 2048 };
+	for(const int size : sizes){
+		ci::Surface8u		s(size, size, true);
+		const int			reps = std::max(1, (2048 * 2048 * 4) / (size * size));
+
+		ds::test::Timer		timer;
+		render_reference(input, s, *a);
+		ds::test::report(std::to_string(size) + "px per-pixel reference", timer.seconds() * 1000.0, "ms");
+
+		ds::arc::RenderCircle	render;
+		render.setNumThreads(1);
+		timer.restart();
+		for(int i = 0; i < reps; ++i) render.on(input, s, *a);
+		ds::test::report(std::to_string(size) + "px compiled, calling thread", timer.seconds() * 1000.0 / reps, "ms");
+
+		render.setNumThreads(0);
+		timer.restart();
+		for(int i = 0; i < reps; ++i) render.on(input, s, *a);
+		ds::test::report(std::to_string(size) + "px compiled, shared pool", timer.seconds() * 1000.0 / reps, "ms");
+	}
+}
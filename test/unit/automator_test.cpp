@@ -0,0 +1,197 @@
+#include "ds_test.h"
+#include "test_sprite_engine.h"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include <ds/debug/automator/automator.h>
+#include <ds/debug/automator/scenario.h>
+#include <ds/debug/automator/soak_test.h>
+
+namespace {
+
+typedef ds::test::TestSpriteEngine::Touch	Touch;
+typedef ds::ui::TouchInfo					Info;
+
+bool						same_touches(const std::vector<Touch>& a, const std::vector<Touch>& b) {
+	if(a.size() != b.size()) return false;
+	for(size_t i = 0; i < a.size(); ++i) {
+		if(a[i].mPhase != b[i].mPhase || a[i].mId != b[i].mId || a[i].mPos != b[i].mPos) return false;
+	}
+	return true;
+}
+
+// What an automator injects over frames, each frame stepping the engine by step seconds
+std::vector<Touch>			automate(const uint32_t seed, const float step, const int frames) {
+	ds::test::TestSpriteEngine	engine;
+	ds::debug::Automator	automator(engine);
+	automator.setFrame(ci::Rectf(0.0f, 0.0f, 1920.0f, 1080.0f));
+	automator.setSeed(seed);
+	automator.setFixedStep(1.0f / 60.0f);
+	// Only what the run does, not the release of every finger when it's made
+	engine.mTouches.clear();
+	automator.activate();
+	for(int i = 0; i < frames; ++i) engine.step(step);
+	return engine.mTouches;
+}
+
+std::string					read_file(const std::string& path) {
+	std::ifstream			in(path.c_str());
+	std::stringstream		ss;
+	ss << in.rdbuf();
+	return ss.str();
+}
+
+}
+
+// With a seed and a fixed step, a run is the same touches whatever the frame times were
+DS_TEST(a_seeded_automator_repeats){
+	const std::vector<Touch>	first = automate(42, 1.0f / 60.0f, 600);
+	DS_CHECK(first.size() > 100);
+	DS_CHECK(same_touches(automate(42, 1.0f / 24.0f, 600), first));
+	DS_CHECK(!same_touches(automate(43, 1.0f / 60.0f, 600), first));
+}
+
+// Frames of 1/16s, so every step ends on a frame
+DS_TEST(a_scenario_runs_its_steps_in_order){
+	ds::test::TestSpriteEngine	engine;
+	int						calls = 0;
+	ds::debug::Scenario		s;
+	s.call([&calls]() { ++calls; })
+	 .tap(ci::vec2(100.0f, 100.0f), 0.125f)
+	 .drag(ci::vec2(200.0f, 300.0f), ci::vec2(600.0f, 300.0f), 0.25f)
+	 .multiTap(ci::vec2(800.0f, 500.0f), 3, 0.125f)
+	 .wait(0.5f)
+	 .call([&calls]() { calls += 10; });
+	DS_CHECK_EQ(s.getStepCount(), size_t(6));
+
+	// The call and the start of the tap come in the first frame
+	const float				dt = 0.0625f;
+	DS_CHECK(!s.update(engine, dt));
+	DS_CHECK_EQ(calls, 1);
+	DS_CHECK_EQ(engine.mTouches.size(), size_t(1));
+	int						frames = 1;
+	while(!s.update(engine, dt) && frames < 100) ++frames;
+	++frames;
+	DS_CHECK(s.isDone());
+	DS_CHECK_EQ(calls, 11);
+	// Each step starts in the frame the one before it finished: the tap is down for 2 frames,
+	// the drag moves for 4, the multi tap is down for 2 and the wait is 8
+	DS_CHECK_EQ(frames, 17);
+
+	// Down and up, down, 4 moves and up, 3 down and 3 up
+	const std::vector<Touch>&	t = engine.mTouches;
+	DS_CHECK_EQ(t.size(), size_t(14));
+	if(t.size() != 14) return;
+	// The tap
+	DS_CHECK(t[0].mPhase == Info::Added && t[0].mId == 1000 && t[0].mPos == ci::vec2(100.0f, 100.0f));
+	DS_CHECK(t[1].mPhase == Info::Removed && t[1].mId == 1000);
+	// The drag moves in a line from one end to the other
+	DS_CHECK(t[2].mPhase == Info::Added && t[2].mPos == ci::vec2(200.0f, 300.0f));
+	for(size_t i = 3; i < 7; ++i) {
+		DS_CHECK(t[i].mPhase == Info::Moved && t[i].mId == 1000);
+		DS_CHECK_NEAR(t[i].mPos.x, 200.0f + 100.0f * (i - 2), 1e-3);
+		DS_CHECK_EQ(t[i].mPos.y, 300.0f);
+	}
+	DS_CHECK(t[7].mPhase == Info::Removed && t[7].mPos == ci::vec2(600.0f, 300.0f));
+	// Three fingers around the center, with their own ids, all let go together
+	for(int k = 0; k < 3; ++k) {
+		const Touch&		down = t[8 + k];
+		DS_CHECK(down.mPhase == Info::Added && down.mId == 1000 + k);
+		DS_CHECK_NEAR(std::sqrt(std::pow(down.mPos.x - 800.0f, 2.0f) + std::pow(down.mPos.y - 500.0f, 2.0f)), 20.0f, 1e-3);
+		DS_CHECK(t[11 + k].mPhase == Info::Removed && t[11 + k].mId == 1000 + k);
+	}
+}
+
+DS_TEST(a_restarted_scenario_lets_go_and_repeats){
+	ds::test::TestSpriteEngine	engine;
+	ds::debug::Scenario		tap;
+	tap.tap(ci::vec2(10.0f, 20.0f), 1.0f);
+	ds::debug::Scenario		s;
+	s.repeat(3, tap);
+	s.setFirstTouchId(50);
+	DS_CHECK_EQ(s.getStepCount(), size_t(3));
+
+	s.update(engine, 0.1f);
+	DS_CHECK_EQ(engine.mTouches.size(), size_t(1));
+	s.restart(engine);
+	DS_CHECK_EQ(engine.mTouches.size(), size_t(2));
+	DS_CHECK(engine.mTouches.back().mPhase == Info::Removed && engine.mTouches.back().mId == 50);
+	DS_CHECK(!s.isDone());
+
+	int						frames = 0;
+	while(!s.update(engine, 0.25f) && frames < 100) ++frames;
+	// Three taps, down and up
+	DS_CHECK_EQ(engine.mTouches.size(), size_t(2 + 6));
+}
+
+// Limits are looked at every sample after the warmup. Each one is reported the first time
+// it's crossed, and the report says what happened.
+DS_TEST(soak_limits_fail_after_the_warmup){
+	Poco::Path				path(Poco::Path::temp());
+	path.setFileName("ds_automator_test_soak.csv");
+	if(Poco::File(path).exists()) Poco::File(path).remove();
+
+	ds::test::TestSpriteEngine	engine;
+	ds::debug::SoakTest		soak(engine);
+	ds::debug::SoakTest::Limits	limits;
+	limits.mMaxFrameMs = 20.0f;
+	limits.mMaxFrameSpikeMs = 50.0f;
+	soak.setLimits(limits);
+	soak.setWarmup(2.0f);
+	soak.setSampleInterval(1.0f);
+	soak.setDuration(8.0f);
+	soak.setReportPath(path.toString());
+
+	int						loops = 0;
+	ds::debug::Scenario		s;
+	s.call([&loops]() { ++loops; }).wait(0.5f);
+	soak.addScenario(s);
+	soak.setFixedStep(0.1f);
+	soak.start();
+
+	double					elapsed = 0.0;
+	auto					run_until = [&engine, &soak, &elapsed](const double until, const float dt) {
+		while(soak.isRunning() && elapsed < until) {
+			engine.step(dt);
+			elapsed += dt;
+		}
+	};
+
+	// A slow frame in the warmup doesn't count
+	engine.step(0.3f);
+	elapsed += 0.3f;
+	run_until(3.0, 0.01f);
+	DS_CHECK(!soak.hasFailed());
+
+	// One slow frame in a sample is a spike, not a slow average
+	engine.step(0.1f);
+	elapsed += 0.1f;
+	run_until(4.5, 0.01f);
+	DS_CHECK_EQ(soak.getFailures().size(), size_t(1));
+	if(!soak.getFailures().empty()) DS_CHECK(soak.getFailures().front().find("a frame took ") != std::string::npos);
+
+	// Every frame slow is a slow average, reported once however many samples it's in. The
+	// spike was already reported.
+	run_until(20.0, 0.03f);
+	DS_CHECK(!soak.isRunning());
+	DS_CHECK(elapsed >= 8.0 && elapsed < 8.1);
+	DS_CHECK_EQ(soak.getFailures().size(), size_t(2));
+	if(soak.getFailures().size() == 2) DS_CHECK(soak.getFailures().back().find("average frame time ") != std::string::npos);
+
+	const std::vector<ds::debug::SoakTest::Sample>&	samples = soak.getSamples();
+	DS_CHECK(samples.size() >= 7 && samples.size() <= 8);
+	if(!samples.empty()) DS_CHECK_NEAR(samples.back().mFrameAvgMs, 30.0f, 0.01f);
+	// The scenario steps by the fixed step, not the frame time, and starts over when it's done
+	DS_CHECK(loops > 1);
+
+	const std::string		report = read_file(path.toString());
+	DS_CHECK(report.compare(0, 13, "seconds,frame") == 0);
+	DS_CHECK(report.find("# result,failed") != std::string::npos);
+	DS_CHECK(report.find("# failure,") != report.rfind("# failure,"));
+	Poco::File(path).remove();
+}
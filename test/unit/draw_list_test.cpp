@@ -0,0 +1,247 @@
+#include "ds_test.h"
+
+#include <random>
+#include <ds/gl/draw_list.h>
+
+namespace {
+
+typedef ds::gl::DrawList	DrawList;
+
+// Stand-ins for shaders and textures, only their addresses matter
+const int					SHADER_BASE = 0, SHADER_OTHER = 0;
+const int					TEX_A = 0, TEX_B = 0, TEX_C = 0;
+
+// Remembers the order quads reach the screen. Each quad's id rides in its red channel.
+class OrderBackend : public ds::gl::CountingDrawBackend {
+public:
+	virtual void			begin(const std::vector<DrawList::Vertex>& v) override {
+		CountingDrawBackend::begin(v);
+		mVertices = &v;
+	}
+	virtual void			drawQuads(const DrawList::Command& cmd) override {
+		CountingDrawBackend::drawQuads(cmd);
+		for(uint32_t i = cmd.mFirst; i < cmd.mFirst + cmd.mCount; i += 4) {
+			mOrder.push_back(static_cast<int>((*mVertices)[i].mColor.r));
+		}
+	}
+	virtual void			drawCustom(const uint32_t payload) override {
+		CountingDrawBackend::drawCustom(payload);
+		// Customs go in as negative so they can be told apart
+		mOrder.push_back(-1 - static_cast<int>(payload));
+	}
+
+	const std::vector<DrawList::Vertex>*	mVertices = nullptr;
+	std::vector<int>		mOrder;
+};
+
+DrawList::Quad				quad(const int id, const float x, const float y, const float w, const float h, const void* texture, const void* shader = &SHADER_BASE) {
+	DrawList::Quad			q;
+	q.mCorner[0] = ci::vec3(x, y, 0.0f);
+	q.mCorner[1] = ci::vec3(x + w, y, 0.0f);
+	q.mCorner[2] = ci::vec3(x + w, y + h, 0.0f);
+	q.mCorner[3] = ci::vec3(x, y + h, 0.0f);
+	q.mColor = ci::ColorA(static_cast<float>(id), 1.0f, 1.0f, 1.0f);
+	q.mShader = shader;
+	q.mTexture = texture;
+	return q;
+}
+
+OrderBackend				run(DrawList& list) {
+	list.compile();
+	OrderBackend			backend;
+	list.execute(backend);
+	return backend;
+}
+
+bool						overlap(const DrawList::Quad& a, const DrawList::Quad& b) {
+	return a.mCorner[0].x < b.mCorner[2].x && b.mCorner[0].x < a.mCorner[2].x
+		&& a.mCorner[0].y < b.mCorner[2].y && b.mCorner[0].y < a.mCorner[2].y;
+}
+
+}
+
+DS_TEST(separate_tiles_batch_by_texture){
+	// A 10x10 wall of tiles alternating between two textures
+	DrawList				list;
+	for(int i = 0; i < 100; ++i) list.addQuad(quad(i, i % 10 * 100.0f, i / 10 * 100.0f, 90.0f, 90.0f, i % 2 ? &TEX_A : &TEX_B));
+
+	const OrderBackend		b = run(list);
+	DS_CHECK_EQ(b.mQuads, size_t(100));
+	DS_CHECK_EQ(b.mDrawCalls, size_t(2));
+	DS_CHECK_EQ(b.mTextureChanges, size_t(2));
+	DS_CHECK_EQ(b.mShaderChanges, size_t(1));
+	DS_CHECK_EQ(list.getStats().mBatches, size_t(2));
+}
+
+DS_TEST(touching_edges_dont_count_as_overlap){
+	DrawList				list;
+	list.addQuad(quad(0, 0.0f, 0.0f, 100.0f, 100.0f, &TEX_A));
+	list.addQuad(quad(1, 100.0f, 0.0f, 100.0f, 100.0f, &TEX_B));
+	list.addQuad(quad(2, 200.0f, 0.0f, 100.0f, 100.0f, &TEX_A));
+
+	const OrderBackend		b = run(list);
+	DS_CHECK_EQ(b.mDrawCalls, size_t(2));
+	DS_CHECK(b.mOrder == std::vector<int>({ 0, 2, 1 }));
+}
+
+DS_TEST(overlapping_sprites_keep_tree_order){
+	// B covers part of A, and C covers part of B, so C can't join A's batch
+	DrawList				list;
+	list.addQuad(quad(0, 0.0f, 0.0f, 100.0f, 100.0f, &TEX_A));
+	list.addQuad(quad(1, 50.0f, 50.0f, 100.0f, 100.0f, &TEX_B));
+	list.addQuad(quad(2, 120.0f, 120.0f, 100.0f, 100.0f, &TEX_A));
+
+	const OrderBackend		b = run(list);
+	DS_CHECK_EQ(b.mDrawCalls, size_t(3));
+	DS_CHECK(b.mOrder == std::vector<int>({ 0, 1, 2 }));
+}
+
+DS_TEST(overlap_with_a_batch_further_back_still_joins){
+	// C overlaps A, which is in its own batch, but not B in between, so it joins A
+	DrawList				list;
+	list.addQuad(quad(0, 0.0f, 0.0f, 100.0f, 100.0f, &TEX_A));
+	list.addQuad(quad(1, 300.0f, 0.0f, 100.0f, 100.0f, &TEX_B));
+	list.addQuad(quad(2, 50.0f, 50.0f, 100.0f, 100.0f, &TEX_A));
+
+	const OrderBackend		b = run(list);
+	DS_CHECK_EQ(b.mDrawCalls, size_t(2));
+	DS_CHECK(b.mOrder == std::vector<int>({ 0, 2, 1 }));
+}
+
+DS_TEST(shader_and_blend_split_batches){
+	DrawList				list;
+	DrawList::Quad			additive = quad(2, 400.0f, 0.0f, 10.0f, 10.0f, &TEX_A);
+	additive.mBlend = 1;
+	list.addQuad(quad(0, 0.0f, 0.0f, 10.0f, 10.0f, &TEX_A));
+	list.addQuad(quad(1, 200.0f, 0.0f, 10.0f, 10.0f, &TEX_A, &SHADER_OTHER));
+	list.addQuad(additive);
+	list.addQuad(quad(3, 600.0f, 0.0f, 10.0f, 10.0f, &TEX_A));
+
+	const OrderBackend		b = run(list);
+	DS_CHECK_EQ(b.mDrawCalls, size_t(3));
+	DS_CHECK_EQ(b.mShaderChanges, size_t(3));
+	DS_CHECK_EQ(b.mBlendChanges, size_t(2));
+	DS_CHECK(b.mOrder == std::vector<int>({ 0, 3, 1, 2 }));
+}
+
+DS_TEST(custom_draws_are_barriers){
+	// Quads after a custom draw never join a batch from before it, even with no overlap
+	DrawList				list;
+	list.addQuad(quad(0, 0.0f, 0.0f, 10.0f, 10.0f, &TEX_A));
+	list.addQuad(quad(1, 20.0f, 0.0f, 10.0f, 10.0f, &TEX_B));
+	list.addCustom(7);
+	list.addQuad(quad(2, 40.0f, 0.0f, 10.0f, 10.0f, &TEX_A));
+	list.addQuad(quad(3, 60.0f, 0.0f, 10.0f, 10.0f, &TEX_A));
+	list.addCustom(8);
+
+	const OrderBackend		b = run(list);
+	DS_CHECK(b.mOrder == std::vector<int>({ 0, 1, -8, 2, 3, -9 }));
+	DS_CHECK_EQ(b.mDrawCalls, size_t(5));
+	DS_CHECK_EQ(b.mCustom, size_t(2));
+	DS_CHECK(b.mCustomOrder == std::vector<uint32_t>({ 7, 8 }));
+	// The custom draw leaves the state unknown, so the next batch binds everything again
+	DS_CHECK_EQ(b.mTextureChanges, size_t(3));
+	DS_CHECK_EQ(list.getStats().mDrawCalls, b.mDrawCalls);
+}
+
+DS_TEST(clips_nest_and_split_runs){
+	DrawList				list;
+	list.addQuad(quad(0, 0.0f, 0.0f, 10.0f, 10.0f, &TEX_A));
+	list.pushClip(ci::Rectf(0.0f, 0.0f, 500.0f, 500.0f));
+	list.addQuad(quad(1, 20.0f, 0.0f, 10.0f, 10.0f, &TEX_A));
+	list.pushClip(ci::Rectf(0.0f, 0.0f, 100.0f, 100.0f));
+	list.addQuad(quad(2, 40.0f, 0.0f, 10.0f, 10.0f, &TEX_A));
+	list.popClip();
+	list.popClip();
+	list.addQuad(quad(3, 60.0f, 0.0f, 10.0f, 10.0f, &TEX_A));
+
+	const OrderBackend		b = run(list);
+	DS_CHECK(b.mOrder == std::vector<int>({ 0, 1, 2, 3 }));
+	DS_CHECK_EQ(b.mDrawCalls, size_t(4));
+	DS_CHECK_EQ(b.mClipChanges, size_t(4));
+	DS_CHECK_EQ(b.mMaxClipDepth, size_t(2));
+	DS_CHECK_EQ(list.getStats().mClips, size_t(2));
+}
+
+DS_TEST(look_back_limits_the_search){
+	// Six textures round robin, with no overlap. Looking back 6 finds every batch, 2 finds none.
+	DrawList				list;
+	int						textures[6];
+	for(int i = 0; i < 60; ++i) list.addQuad(quad(i, i * 20.0f, 0.0f, 10.0f, 10.0f, &textures[i % 6]));
+
+	DS_CHECK_EQ(run(list).mDrawCalls, size_t(6));
+	list.setLookBack(2);
+	DS_CHECK_EQ(run(list).mDrawCalls, size_t(60));
+}
+
+DS_TEST(vertices_match_the_quads){
+	DrawList				list;
+	DrawList::Quad			q = quad(5, 10.0f, 20.0f, 30.0f, 40.0f, &TEX_C);
+	q.mTexCoord[2] = ci::vec2(1.0f, 1.0f);
+	list.addQuad(q);
+	list.compile();
+
+	const auto&				v = list.getVertices();
+	DS_CHECK_EQ(v.size(), size_t(4));
+	DS_CHECK_EQ(v[2].mPosition.x, 40.0f);
+	DS_CHECK_EQ(v[2].mPosition.y, 60.0f);
+	DS_CHECK_EQ(v[2].mTexCoord.x, 1.0f);
+	DS_CHECK_EQ(v[3].mColor.r, 5.0f);
+}
+
+DS_TEST(random_scenes_draw_overlaps_in_order){
+	// Whatever gets reordered, any two quads that overlap are drawn in the order they were added
+	std::mt19937			rng(34);
+	std::uniform_real_distribution<float>	pos(0.0f, 1000.0f), size(5.0f, 200.0f);
+	int						textures[5];
+
+	for(int scene = 0; scene < 50; ++scene){
+		DrawList			list;
+		std::vector<DrawList::Quad>	quads;
+		for(int i = 0; i < 300; ++i){
+			quads.push_back(quad(i, pos(rng), pos(rng), size(rng), size(rng), &textures[rng() % 5], rng() % 4 ? &SHADER_BASE : &SHADER_OTHER));
+			list.addQuad(quads.back());
+		}
+
+		const OrderBackend	b = run(list);
+		DS_CHECK_EQ(b.mOrder.size(), quads.size());
+		DS_CHECK(b.mDrawCalls <= quads.size());
+
+		std::vector<int>	drawnAt(quads.size());
+		for(size_t k = 0; k < b.mOrder.size(); ++k) drawnAt[b.mOrder[k]] = static_cast<int>(k);
+		for(size_t i = 0; i < quads.size(); ++i){
+			for(size_t j = i + 1; j < quads.size(); ++j){
+				if(overlap(quads[i], quads[j])) DS_CHECK(drawnAt[i] < drawnAt[j]);
+			}
+		}
+	}
+}
+
+// A 2,000 tile image wall on four textures, with a few overlapping labels on top
+DS_BENCH(image_wall_2000){
+	int						textures[4];
+	const int				label = 0;
+	DrawList				list;
+	std::mt19937			rng(2000);
+	const int				FRAMES = 200;
+	ds::test::Timer			timer;
+	size_t					drawCalls = 0;
+
+	for(int f = 0; f < FRAMES; ++f){
+		list.clear();
+		for(int i = 0; i < 2000; ++i){
+			const float		x = i % 50 * 40.0f, y = i / 50 * 40.0f;
+			list.addQuad(quad(i, x, y, 38.0f, 38.0f, &textures[rng() % 4]));
+			if(i % 100 == 0) list.addQuad(quad(i, x + 10.0f, y + 10.0f, 60.0f, 20.0f, &label));
+		}
+		list.compile();
+		ds::gl::CountingDrawBackend	backend;
+		list.execute(backend);
+		drawCalls = backend.mDrawCalls;
+	}
+
+	const double			seconds = timer.seconds();
+	ds::test::report("build + compile 2,020 quads", seconds * 1e6 / FRAMES, "us/frame");
+	ds::test::report("draw calls, was 2,020", static_cast<double>(drawCalls), "");
+	ds::test::keep(&drawCalls);
+}
@@ -0,0 +1,87 @@
+#pragma once
+#ifndef DS_TEST_UNIT_DS_TEST_H_
+#define DS_TEST_UNIT_DS_TEST_H_
+
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ds {
+namespace test {
+
+/**
+* A very small test runner. Each DS_TEST and DS_BENCH registers itself, ds_test_main.cpp runs
+* them. Tests run by default, benchmarks only with --bench. A failed check ends its test and
+* the run exits with an error, so ctest picks it up.
+*/
+typedef void(*Function)();
+
+struct Case {
+	const char*				mName;
+	Function				mFunction;
+	bool					mBench;
+};
+
+std::vector<Case>&			getCases();
+
+struct Register {
+	Register(const char* name, Function f, const bool bench){ getCases().push_back(Case{ name, f, bench }); }
+};
+
+/// Thrown by the checks, caught by the runner
+struct Failure {
+	std::string				mWhat;
+};
+
+void						fail(const char* file, const int line, const std::string& what);
+
+/// Benchmarks print their numbers through this so they line up
+void						report(const std::string& what, const double value, const std::string& unit);
+
+class Timer {
+public:
+	Timer() : mStart(std::chrono::steady_clock::now()) {}
+	void					restart(){ mStart = std::chrono::steady_clock::now(); }
+	double					seconds() const { return std::chrono::duration<double>(std::chrono::steady_clock::now() - mStart).count(); }
+private:
+	std::chrono::steady_clock::time_point	mStart;
+};
+
+/// Keeps the optimizer from throwing out a value a benchmark computed
+void						keep(const void*);
+
+} // namespace test
+} // namespace ds
+
+#define DS_TEST_CASE_(name, bench) \
+	static void ds_test_##name(); \
+	static ds::test::Register ds_test_register_##name(#name, &ds_test_##name, bench); \
+	static void ds_test_##name()
+
+#define DS_TEST(name)				DS_TEST_CASE_(name, false)
+#define DS_BENCH(name)				DS_TEST_CASE_(name, true)
+
+#define DS_CHECK(c) \
+	do { if(!(c)) ds::test::fail(__FILE__, __LINE__, #c); } while(0)
+
+#define DS_CHECK_EQ(a, b) \
+	do { \
+		const auto& ds_a_ = (a); const auto& ds_b_ = (b); \
+		if(!(ds_a_ == ds_b_)){ \
+			std::ostringstream ds_os_; ds_os_ << #a " == " #b " (" << ds_a_ << " vs " << ds_b_ << ")"; \
+			ds::test::fail(__FILE__, __LINE__, ds_os_.str()); \
+		} \
+	} while(0)
+
+#define DS_CHECK_NEAR(a, b, epsilon) \
+	do { \
+		const double ds_a_ = static_cast<double>(a); const double ds_b_ = static_cast<double>(b); \
+		if(!(std::abs(ds_a_ - ds_b_) <= (epsilon))){ \
+			std::ostringstream ds_os_; ds_os_ << #a " ~= " #b " (" << ds_a_ << " vs " << ds_b_ << ")"; \
+			ds::test::fail(__FILE__, __LINE__, ds_os_.str()); \
+		} \
+	} while(0)
+
+#endif
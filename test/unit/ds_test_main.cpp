@@ -0,0 +1,65 @@
+#include "ds_test.h"
+
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+namespace ds {
+namespace test {
+
+std::vector<Case>& getCases(){
+	static std::vector<Case>	cases;
+	return cases;
+}
+
+void fail(const char* file, const int line, const std::string& what){
+	std::ostringstream			os;
+	os << file << ":" << line << ": " << what;
+	throw Failure{ os.str() };
+}
+
+void report(const std::string& what, const double value, const std::string& unit){
+	std::cout << "    " << std::left << std::setw(48) << what << " " << std::right << std::setw(14) << std::fixed << std::setprecision(3) << value << " " << unit << std::endl;
+}
+
+namespace {
+const void* volatile			sink = nullptr;
+}
+
+void keep(const void* p){
+	sink = p;
+}
+
+} // namespace test
+} // namespace ds
+
+/// Usage: <test> [--bench] [name filter]
+int main(int argc, char** argv){
+	bool						bench = false;
+	const char*					filter = nullptr;
+	for(int i = 1; i < argc; ++i){
+		if(strcmp(argv[i], "--bench") == 0) bench = true;
+		else filter = argv[i];
+	}
+
+	int							ran = 0, failed = 0;
+	for(auto& it : ds::test::getCases()){
+		if(it.mBench != bench) continue;
+		if(filter && !strstr(it.mName, filter)) continue;
+
+		++ran;
+		std::cout << (bench ? "[bench] " : "[test] ") << it.mName << std::endl;
+		try {
+			it.mFunction();
+		} catch(ds::test::Failure& f){
+			++failed;
+			std::cout << "  FAILED " << f.mWhat << std::endl;
+		} catch(std::exception& e){
+			++failed;
+			std::cout << "  FAILED exception: " << e.what() << std::endl;
+		}
+	}
+
+	std::cout << ran - failed << "/" << ran << " passed" << std::endl;
+	return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+#include "ds_test.h"
+
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Poco/Path.h>
+#include <ds/debug/frame_profiler.h>
+
+namespace {
+
+typedef ds::debug::FrameProfiler	Profiler;
+
+const Profiler::ZoneStats*	find_stats(const std::vector<Profiler::ZoneStats>& stats, const std::string& name) {
+	for(auto& it : stats) {
+		if(it.mName == name) return &it;
+	}
+	return nullptr;
+}
+
+// Each zone has its own duration, in whole microseconds so it comes through the trace exactly
+int64_t						duration_of(const int zone) {
+	return (zone + 1) * 7000;
+}
+
+class TraceEvent {
+public:
+	std::string				mName;
+	std::string				mDuration;
+};
+
+std::vector<TraceEvent>		read_trace(const std::string& path) {
+	std::vector<TraceEvent>	ans;
+	std::ifstream			in(path.c_str());
+	std::string				line;
+	while(std::getline(in, line)) {
+		if(line.find("\"ph\":\"X\"") == std::string::npos) continue;
+		const size_t		name = line.find("\"name\":\"") + 8;
+		const size_t		dur = line.find("\"dur\":") + 6;
+		TraceEvent			e;
+		e.mName = line.substr(name, line.find('"', name) - name);
+		e.mDuration = line.substr(dur, line.find('}', dur) - dur);
+		ans.push_back(e);
+	}
+	return ans;
+}
+
+}
+
+DS_TEST(stats_sum_each_zone_across_threads){
+	Profiler&				p = Profiler::get();
+	const Profiler::ZoneId	zone = Profiler::registerZone("summed");
+	DS_CHECK_EQ(Profiler::registerZone("summed"), zone);
+
+	p.endFrame();
+	p.record(zone, 0, 2000000);
+	std::thread([&p, zone]() { p.record(zone, 0, 3000000); }).join();
+	p.endFrame();
+
+	const std::vector<Profiler::ZoneStats>	all = p.getStats();
+	const Profiler::ZoneStats*	stats = find_stats(all, "summed");
+	DS_CHECK(stats != nullptr);
+	if(stats) DS_CHECK_NEAR(stats->mLastMs, 5.0, 1e-6);
+}
+
+// Threads keep recording while the main thread folds frames and writes traces. Each event's zone
+// and duration go together, so a slot read while it was half written would show up as a mismatch.
+DS_TEST(slots_written_during_a_read_are_skipped){
+	Profiler&				p = Profiler::get();
+	const int				threads = 3;
+	std::vector<Profiler::ZoneId>	zones;
+	for(int z = 0; z < threads * 2; ++z) zones.push_back(Profiler::registerZone(("torn_" + std::to_string(z)).c_str()));
+
+	std::atomic<bool>		stop(false);
+	std::vector<std::thread>	writers;
+	for(int t = 0; t < threads; ++t) {
+		writers.push_back(std::thread([&p, &zones, &stop, t]() {
+			for(int64_t k = 0; !stop; ++k) {
+				const int	z = t * 2 + static_cast<int>(k % 2);
+				const int64_t	start = k * 1000000;
+				p.record(zones[z], start, start + duration_of(z));
+			}
+		}));
+	}
+
+	Poco::Path				path(Poco::Path::temp());
+	path.setFileName("ds_frame_profiler_test.json");
+	size_t					checked = 0;
+	for(int i = 0; i < 20; ++i) {
+		p.endFrame();
+		DS_CHECK(p.writeChromeTrace(path.toString()));
+		for(auto& e : read_trace(path.toString())) {
+			if(e.mName.compare(0, 5, "torn_") != 0) continue;
+			const int		z = std::stoi(e.mName.substr(5));
+			DS_CHECK_EQ(e.mDuration, std::to_string(duration_of(z) / 1000) + ".0");
+			++checked;
+		}
+	}
+	stop = true;
+	for(auto& it : writers) it.join();
+	DS_CHECK(checked > 0);
+	ds::test::report("events checked", static_cast<double>(checked), "");
+}
+
+// What a zone costs the thread that records it, and what folding a full ring costs the main thread
+DS_BENCH(record_and_fold){
+	Profiler&				p = Profiler::get();
+	const Profiler::ZoneId	zone = Profiler::registerZone("bench");
+	const int				count = 1000000;
+
+	p.endFrame();
+	ds::test::Timer			timer;
+	for(int i = 0; i < count; ++i) {
+		p.record(zone, i, i + 1);
+	}
+	ds::test::report("record", timer.seconds() * 1e9 / count, "ns/zone");
+
+	for(size_t i = 0; i < Profiler::EVENTS_PER_THREAD; ++i) p.record(zone, 0, 1);
+	timer.restart();
+	p.endFrame();
+	ds::test::report("endFrame over a full ring", timer.seconds() * 1e6, "us");
+}
@@ -0,0 +1,249 @@
+#include "ds_test.h"
+#include "test_sprite_engine.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Poco/Exception.h>
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include <Poco/Net/ServerSocket.h>
+#include <Poco/Net/StreamSocket.h>
+#include <ds/network/http_service.h>
+
+namespace {
+
+typedef ds::net::HttpService	Http;
+
+// Just enough of an HTTP/1.1 server on this machine, keep-alive and Content-Length only.
+//   /etag       an ETag, and a 304 when it's asked for with that ETag
+//   /no-store   the same, with Cache-Control: no-store
+//   /private    the same, with Cache-Control: private
+//   /by-header  a body and ETag that depend on the X-User header
+class Server {
+public:
+	// One line for each request: the path, then the If-None-Match it came with, if any
+	struct Seen {
+		std::string				mPath;
+		std::string				mIfNoneMatch;
+	};
+
+	Server() : mListener(Poco::Net::SocketAddress("127.0.0.1", 0)), mRunning(true) {
+		mAccepting = std::thread([this]() { accept(); });
+	}
+	~Server() {
+		mRunning = false;
+		mAccepting.join();
+		for(auto& it : mConnections) it.join();
+	}
+
+	int							port() const { return mListener.address().port(); }
+	std::string					url(const std::string& path) const { return "http://127.0.0.1:" + std::to_string(port()) + path; }
+
+	std::vector<Seen>			seen() {
+		std::lock_guard<std::mutex>	lock(mMutex);
+		return mSeen;
+	}
+
+private:
+	void						accept() {
+		while(mRunning) {
+			if(!mListener.poll(Poco::Timespan(0, 10000), Poco::Net::Socket::SELECT_READ)) continue;
+			Poco::Net::StreamSocket	s = mListener.acceptConnection();
+			mConnections.push_back(std::thread([this, s]() { serve(s); }));
+		}
+	}
+
+	void						serve(Poco::Net::StreamSocket s) {
+		s.setReceiveTimeout(Poco::Timespan(0, 10000));
+		std::string				in;
+		char					buf[4096];
+		while(mRunning) {
+			const size_t		end = in.find("\r\n\r\n");
+			if(end != std::string::npos) {
+				const std::string	reply = answer(in.substr(0, end + 2));
+				in.erase(0, end + 4);
+				s.sendBytes(reply.data(), static_cast<int>(reply.size()));
+				continue;
+			}
+			int					n = 0;
+			try {
+				n = s.receiveBytes(buf, sizeof(buf));
+			} catch(Poco::TimeoutException const&) {
+				continue;
+			} catch(Poco::Exception const&) {
+				return;
+			}
+			if(n <= 0) return;
+			in.append(buf, n);
+		}
+	}
+
+	// The head is the request line and each header line, each ending in \r\n
+	std::string					answer(const std::string& head) {
+		std::istringstream		lines(head);
+		std::string				line, method, path;
+		std::getline(lines, line);
+		std::istringstream(line) >> method >> path;
+		std::string				ifNoneMatch, user;
+		while(std::getline(lines, line)) {
+			if(!line.empty() && line.back() == '\r') line.pop_back();
+			if(line.compare(0, 15, "If-None-Match: ") == 0) ifNoneMatch = line.substr(15);
+			else if(line.compare(0, 8, "X-User: ") == 0) user = line.substr(8);
+		}
+		{
+			std::lock_guard<std::mutex>	lock(mMutex);
+			mSeen.push_back(Seen{ path, ifNoneMatch });
+		}
+
+		std::string				etag = "\"v1\"", body = "body of " + path, extra;
+		if(path == "/no-store") extra = "Cache-Control: no-store\r\n";
+		else if(path == "/private") extra = "Cache-Control: private, max-age=60\r\n";
+		else if(path == "/by-header") {
+			etag = "\"" + user + "\"";
+			body = "for " + user;
+		}
+		if(ifNoneMatch == etag) return "HTTP/1.1 304 Not Modified\r\nETag: " + etag + "\r\n" + extra + "Content-Length: 0\r\n\r\n";
+		return "HTTP/1.1 200 OK\r\nETag: " + etag + "\r\n" + extra + "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+	}
+
+	Poco::Net::ServerSocket		mListener;
+	std::atomic<bool>			mRunning;
+	std::thread					mAccepting;
+	std::vector<std::thread>	mConnections;
+	std::mutex					mMutex;
+	std::vector<Seen>			mSeen;
+};
+
+// Empty every time. Named for the server, so runs at once don't share one.
+std::string						fresh_cache_folder(const Server& server) {
+	Poco::Path					p(Poco::Path::temp());
+	p.pushDirectory("ds_http_service_test_" + std::to_string(server.port()));
+	Poco::File					dir(p);
+	if(dir.exists()) dir.remove(true);
+	dir.createDirectories();
+	return p.toString();
+}
+
+// An engine whose HttpService keeps its cache in folder
+struct Fixture {
+	Fixture(const std::string& folder) {
+		engine.getSettings("engine").setRawValue("http:cache_folder", 0, folder);
+		http.reset(new Http(engine));
+	}
+
+	// Through the callback, which comes from engine.update()
+	Http::Reply					fetch(const Http::Request& r) {
+		Http::Reply				ans;
+		bool					done = false;
+		if(!http->request(r, [&ans, &done](const Http::Reply& reply) { ans = reply; done = true; })) return ans;
+		ds::test::Timer			timer;
+		while(!done && timer.seconds() < 5.0) {
+			engine.update();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return ans;
+	}
+	Http::Reply					fetch(const std::string& url) { return fetch(Http::Request(url)); }
+
+	ds::test::TestSpriteEngine	engine;
+	std::unique_ptr<Http>		http;
+};
+
+Http::Request					as_user(const std::string& url, const std::string& user) {
+	Http::Request				r(url);
+	r.mHeaders.push_back("X-User: " + user);
+	return r;
+}
+
+}
+
+DS_TEST(an_unchanged_reply_comes_from_disk){
+	Server						server;
+	const std::string			folder = fresh_cache_folder(server);
+	{
+		Fixture					f(folder);
+		const Http::Reply		first = f.fetch(server.url("/etag"));
+		DS_CHECK_EQ(first.mHttpCode, 200L);
+		DS_CHECK(!first.mFromCache);
+		DS_CHECK_EQ(first.mBody, std::string("body of /etag"));
+
+		const Http::Reply		second = f.fetch(server.url("/etag"));
+		DS_CHECK_EQ(second.mHttpCode, 200L);
+		DS_CHECK(second.mFromCache);
+		DS_CHECK_EQ(second.mBody, first.mBody);
+		DS_CHECK_EQ(f.http->getStats().mCacheHits, 1u);
+	}
+
+	// Still there for the next run of the app
+	Fixture						f(folder);
+	DS_CHECK(f.fetch(server.url("/etag")).mFromCache);
+
+	const std::vector<Server::Seen>	seen = server.seen();
+	DS_CHECK_EQ(seen.size(), size_t(3));
+	DS_CHECK(seen[0].mIfNoneMatch.empty());
+	DS_CHECK_EQ(seen[1].mIfNoneMatch, std::string("\"v1\""));
+	DS_CHECK_EQ(seen[2].mIfNoneMatch, std::string("\"v1\""));
+}
+
+DS_TEST(no_store_and_private_replies_are_never_kept){
+	Server						server;
+	Fixture						f(fresh_cache_folder(server));
+	for(const char* path : { "/no-store", "/private" }) {
+		for(int i = 0; i < 2; ++i) {
+			const Http::Reply	reply = f.fetch(server.url(path));
+			DS_CHECK_EQ(reply.mHttpCode, 200L);
+			DS_CHECK(!reply.mFromCache);
+			DS_CHECK_EQ(reply.mBody, std::string("body of ") + path);
+		}
+	}
+	// Each one asked for in full, never conditionally
+	const std::vector<Server::Seen>	seen = server.seen();
+	DS_CHECK_EQ(seen.size(), size_t(4));
+	for(auto& it : seen) DS_CHECK(it.mIfNoneMatch.empty());
+	DS_CHECK_EQ(f.http->getStats().mCacheHits, 0u);
+}
+
+// One user's reply is never handed to another
+DS_TEST(the_headers_a_request_adds_are_part_of_its_key){
+	Server						server;
+	Fixture						f(fresh_cache_folder(server));
+	const std::string			url = server.url("/by-header");
+	DS_CHECK_EQ(f.fetch(as_user(url, "a")).mBody, std::string("for a"));
+
+	const Http::Reply			b = f.fetch(as_user(url, "b"));
+	DS_CHECK(!b.mFromCache);
+	DS_CHECK_EQ(b.mBody, std::string("for b"));
+
+	const Http::Reply			again = f.fetch(as_user(url, "a"));
+	DS_CHECK(again.mFromCache);
+	DS_CHECK_EQ(again.mBody, std::string("for a"));
+	// And none at all is a key of its own
+	DS_CHECK(!f.fetch(url).mFromCache);
+
+	const std::vector<Server::Seen>	seen = server.seen();
+	DS_CHECK_EQ(seen.size(), size_t(4));
+	DS_CHECK(seen[1].mIfNoneMatch.empty());
+	DS_CHECK_EQ(seen[2].mIfNoneMatch, std::string("\"a\""));
+	DS_CHECK(seen[3].mIfNoneMatch.empty());
+}
+
+DS_TEST(a_request_that_asks_for_no_store_skips_the_cache){
+	Server						server;
+	Fixture						f(fresh_cache_folder(server));
+	Http::Request				r(server.url("/etag"));
+	r.mHeaders.push_back("Cache-Control: no-store");
+	DS_CHECK(!f.fetch(r).mFromCache);
+	DS_CHECK(!f.fetch(r).mFromCache);
+	// Nor did it leave anything for a request that would use it
+	DS_CHECK(!f.fetch(server.url("/etag")).mFromCache);
+
+	const std::vector<Server::Seen>	seen = server.seen();
+	DS_CHECK_EQ(seen.size(), size_t(3));
+	for(auto& it : seen) DS_CHECK(it.mIfNoneMatch.empty());
+}
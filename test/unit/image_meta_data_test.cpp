@@ -0,0 +1,308 @@
+#include "ds_test.h"
+#include "test_sprite_engine.h"
+
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include <Poco/Timespan.h>
+#include <Poco/Timestamp.h>
+#include <ds/util/image_meta_data.h>
+
+namespace {
+
+typedef std::vector<unsigned char> Bytes;
+
+std::string temp_folder(){
+	static std::string		folder;
+	if(folder.empty()){
+		Poco::Path			p(Poco::Path::temp());
+		p.pushDirectory("ds_image_meta_data_test");
+		Poco::File(p).createDirectories();
+		folder = p.toString();
+		// Keep the tests away from the real index
+		ds::ImageMetaData::setIndexEnabled(false);
+	}
+	return folder;
+}
+
+std::string write_file(const std::string& name, const Bytes& b){
+	const std::string		path = temp_folder() + name;
+	std::ofstream			out(path.c_str(), std::ios::binary | std::ios::trunc);
+	out.write(reinterpret_cast<const char*>(b.data()), b.size());
+	return path;
+}
+
+void put_u16_be(Bytes& b, const unsigned v){ b.push_back((v >> 8) & 0xff); b.push_back(v & 0xff); }
+void put_u16_le(Bytes& b, const unsigned v){ b.push_back(v & 0xff); b.push_back((v >> 8) & 0xff); }
+void put_u32_be(Bytes& b, const unsigned v){ put_u16_be(b, v >> 16); put_u16_be(b, v & 0xffff); }
+void put_u32_le(Bytes& b, const unsigned v){ put_u16_le(b, v & 0xffff); put_u16_le(b, v >> 16); }
+
+Bytes png(const unsigned w, const unsigned h){
+	Bytes					b = { 0x89, 'P', 'N', 'G', 0x0d, 0x0a, 0x1a, 0x0a };
+	put_u32_be(b, 13);
+	b.insert(b.end(), { 'I', 'H', 'D', 'R' });
+	put_u32_be(b, w);
+	put_u32_be(b, h);
+	b.insert(b.end(), { 8, 6, 0, 0, 0, 0, 0, 0, 0 });
+	return b;
+}
+
+Bytes gif(const unsigned w, const unsigned h){
+	Bytes					b = { 'G', 'I', 'F', '8', '9', 'a' };
+	put_u16_le(b, w);
+	put_u16_le(b, h);
+	b.insert(b.end(), 8, 0);
+	return b;
+}
+
+Bytes bmp(const unsigned w, const int h){
+	Bytes					b = { 'B', 'M' };
+	b.insert(b.end(), 12, 0);
+	put_u32_le(b, 40);
+	put_u32_le(b, w);
+	put_u32_le(b, static_cast<unsigned>(h));
+	b.insert(b.end(), 8, 0);
+	return b;
+}
+
+// APP0, then a baseline frame header
+Bytes jpeg_sof(const unsigned w, const unsigned h){
+	Bytes					b = { 0xff, 0xd8, 0xff, 0xe0 };
+	put_u16_be(b, 16);
+	b.insert(b.end(), { 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0 });
+	b.insert(b.end(), { 0xff, 0xc0 });
+	put_u16_be(b, 11);
+	b.push_back(8);
+	put_u16_be(b, h);
+	put_u16_be(b, w);
+	b.insert(b.end(), { 1, 1, 0x11, 0 });
+	b.insert(b.end(), { 0xff, 0xd9 });
+	return b;
+}
+
+// Only an EXIF block with the size in the Exif sub-IFD, and a scan with no frame header before
+// it, so the header probe gives up and the EXIF fallback has to answer.
+Bytes jpeg_exif(const unsigned w, const unsigned h){
+	Bytes					tiff = { 'I', 'I', 0x2a, 0 };
+	put_u32_le(tiff, 8);
+	// IFD0: one entry pointing at the sub-IFD at 26
+	put_u16_le(tiff, 1);
+	put_u16_le(tiff, 0x8769); put_u16_le(tiff, 4); put_u32_le(tiff, 1); put_u32_le(tiff, 26);
+	put_u32_le(tiff, 0);
+	// Exif sub-IFD: pixel x and y dimension
+	put_u16_le(tiff, 2);
+	put_u16_le(tiff, 0xa002); put_u16_le(tiff, 4); put_u32_le(tiff, 1); put_u32_le(tiff, w);
+	put_u16_le(tiff, 0xa003); put_u16_le(tiff, 4); put_u32_le(tiff, 1); put_u32_le(tiff, h);
+	put_u32_le(tiff, 0);
+
+	Bytes					b = { 0xff, 0xd8, 0xff, 0xe1 };
+	put_u16_be(b, static_cast<unsigned>(2 + 6 + tiff.size()));
+	b.insert(b.end(), { 'E', 'x', 'i', 'f', 0, 0 });
+	b.insert(b.end(), tiff.begin(), tiff.end());
+	b.insert(b.end(), { 0xff, 0xda, 0, 2, 0xff, 0xd9 });
+	return b;
+}
+
+void check_size(const std::string& path, const float w, const float h){
+	const ds::ImageMetaData	meta(path);
+	DS_CHECK_EQ(meta.mSize.x, w);
+	DS_CHECK_EQ(meta.mSize.y, h);
+}
+
+// Empty every time, with the index turned on and kept in it
+std::string index_folder(const std::string& name){
+	Poco::Path				p(Poco::Path::temp());
+	p.pushDirectory("ds_image_meta_data_index_" + name);
+	Poco::File				dir(p);
+	if(dir.exists()) dir.remove(true);
+	dir.createDirectories();
+	ds::ImageMetaData::setIndexFolder(p.toString());
+	ds::ImageMetaData::setIndexEnabled(true);
+	return p.toString();
+}
+
+// Back to no index, and an empty cache
+void drop_index(){
+	ds::ImageMetaData::setIndexEnabled(false);
+	ds::ImageMetaData::setIndexFolder("");
+}
+
+// An index row for the file as it is now
+std::string index_row(const std::string& path, const int w, const int h, const Poco::Timestamp::TimeVal lastUsed){
+	const Poco::File		file(path);
+	return std::to_string(file.getLastModified().epochMicroseconds()) + "\t" + std::to_string(file.getSize()) + "\t"
+		+ std::to_string(w) + "\t" + std::to_string(h) + "\t" + std::to_string(lastUsed) + "\t" + path;
+}
+
+void write_index(const std::string& folder, const std::vector<std::string>& rows){
+	std::ofstream			out((folder + "index.txt").c_str(), std::ios::trunc);
+	out << "ds_image_meta_data 2\n";
+	for(auto& it : rows) out << it << "\n";
+}
+
+std::vector<std::string> read_index(const std::string& folder){
+	std::vector<std::string>	rows;
+	std::ifstream			in((folder + "index.txt").c_str());
+	std::string				line;
+	if(!std::getline(in, line)) return rows;
+	while(std::getline(in, line)) rows.push_back(line);
+	return rows;
+}
+
+bool has_row(const std::vector<std::string>& rows, const std::string& path){
+	for(auto& it : rows){
+		if(it.size() > path.size() && it.compare(it.size() - path.size() - 1, std::string::npos, "\t" + path) == 0) return true;
+	}
+	return false;
+}
+
+}
+
+DS_TEST(probes_sizes_from_headers){
+	check_size(write_file("a.png", png(640, 480)), 640.0f, 480.0f);
+	check_size(write_file("a.gif", gif(31, 17)), 31.0f, 17.0f);
+	check_size(write_file("a.bmp", bmp(300, -200)), 300.0f, 200.0f);
+	check_size(write_file("a.jpg", jpeg_sof(1920, 1080)), 1920.0f, 1080.0f);
+}
+
+DS_TEST(signature_beats_extension){
+	// A png named like a jpeg
+	check_size(write_file("really_png.jpg", png(12, 34)), 12.0f, 34.0f);
+}
+
+DS_TEST(exif_fallback_takes_every_jpeg_name){
+	check_size(write_file("exif.jpg", jpeg_exif(4000, 3000)), 4000.0f, 3000.0f);
+	check_size(write_file("exif.jpeg", jpeg_exif(4001, 3001)), 4001.0f, 3001.0f);
+	check_size(write_file("exif.JPEG", jpeg_exif(4002, 3002)), 4002.0f, 3002.0f);
+	check_size(write_file("exif.jpe", jpeg_exif(4003, 3003)), 4003.0f, 3003.0f);
+	// No extension at all, only the signature
+	check_size(write_file("exif_no_extension", jpeg_exif(4004, 3004)), 4004.0f, 3004.0f);
+}
+
+DS_TEST(changed_file_is_probed_again){
+	const std::string		path = write_file("changes.png", png(10, 10));
+	check_size(path, 10.0f, 10.0f);
+	// A different file size invalidates the cached entry
+	Bytes					b = png(20, 30);
+	b.push_back(0);
+	write_file("changes.png", b);
+	check_size(path, 20.0f, 30.0f);
+}
+
+DS_TEST(added_sizes_are_saved){
+	const std::string		folder = index_folder("add");
+	const std::string		path = write_file("added.png", png(5, 5));
+	// Nothing looked up first, so add() is what finds the index
+	ds::ImageMetaData().add(path, ci::vec2(64.0f, 48.0f));
+	ds::ImageMetaData::saveIndex();
+
+	const std::vector<std::string>	rows = read_index(folder);
+	DS_CHECK_EQ(rows.size(), size_t(1));
+	DS_CHECK(has_row(rows, path));
+	DS_CHECK(rows.front().find("\t64\t48\t") != std::string::npos);
+	drop_index();
+}
+
+DS_TEST(index_rows_dont_replace_newer_sizes){
+	const std::string		folder = index_folder("stale");
+	const std::string		before = write_file("stale_before.png", png(5, 5));
+	const std::string		added = write_file("stale_added.png", png(5, 5));
+	const std::string		looked_up = write_file("stale_looked_up.png", png(5, 5));
+	const std::string		indexed = write_file("stale_indexed.png", png(5, 5));
+	const Poco::Timestamp::TimeVal	now = Poco::Timestamp().epochMicroseconds();
+	write_index(folder, { index_row(before, 1, 1, now), index_row(added, 1, 1, now), index_row(looked_up, 2, 2, now), index_row(indexed, 3, 4, now) });
+
+	// Added while the index was off, then the index is loaded under it
+	ds::ImageMetaData::setIndexEnabled(false);
+	ds::ImageMetaData().add(before, ci::vec2(16.0f, 12.0f));
+	ds::ImageMetaData::setIndexEnabled(true);
+	check_size(before, 16.0f, 12.0f);
+	// add() before anything is loaded, then a lookup loads nothing over it
+	ds::ImageMetaData().add(added, ci::vec2(64.0f, 48.0f));
+	check_size(added, 64.0f, 48.0f);
+	ds::ImageMetaData().add(looked_up, ci::vec2(32.0f, 24.0f));
+	check_size(looked_up, 32.0f, 24.0f);
+	// The index is in use, the file itself says 5x5
+	check_size(indexed, 3.0f, 4.0f);
+	drop_index();
+}
+
+DS_TEST(save_prunes_missing_and_unused_rows){
+	const std::string		folder = index_folder("prune");
+	const std::string		recent = write_file("prune_recent.png", png(5, 5));
+	const std::string		old = write_file("prune_old.png", png(5, 5));
+	const std::string		gone = write_file("prune_gone.png", png(5, 5));
+	const std::string		used = write_file("prune_used.png", png(7, 7));
+	const Poco::Timestamp::TimeVal	now = Poco::Timestamp().epochMicroseconds();
+	write_index(folder, {
+		index_row(recent, 5, 5, now - Poco::Timespan::DAYS),
+		index_row(old, 5, 5, now - Poco::Timespan::DAYS * 60),
+		index_row(gone, 5, 5, now),
+		index_row(used, 7, 7, now - Poco::Timespan::DAYS * 60) });
+	Poco::File(gone).remove();
+
+	// Looking one up keeps it however old its row was, and gives save() something to do
+	check_size(used, 7.0f, 7.0f);
+	ds::ImageMetaData::saveIndex();
+
+	const std::vector<std::string>	rows = read_index(folder);
+	DS_CHECK_EQ(rows.size(), size_t(2));
+	DS_CHECK(has_row(rows, recent));
+	DS_CHECK(has_row(rows, used));
+	DS_CHECK(!has_row(rows, old));
+	DS_CHECK(!has_row(rows, gone));
+	drop_index();
+}
+
+DS_TEST(prescan_runs_on_the_work_manager){
+	const std::string		folder = index_folder("prescan");
+	const std::string		images = folder + "images/";
+	Poco::File(images + "nested/").createDirectories();
+	const size_t			count = 40;
+	for(size_t i = 0; i < count; ++i){
+		const std::string	path = (i % 4 ? images : images + "nested/") + "scan_" + std::to_string(i) + (i % 2 ? ".png" : ".gif");
+		std::ofstream		out(path.c_str(), std::ios::binary | std::ios::trunc);
+		const Bytes			b = i % 2 ? png(10 + i, 20) : gif(10 + i, 20);
+		out.write(reinterpret_cast<const char*>(b.data()), b.size());
+	}
+	std::ofstream(images + "notes.txt") << "not an image";
+
+	ds::test::TestSpriteEngine	engine;
+	ds::ImagePrescan		prescan(engine);
+	size_t					found = 0;
+	bool					done = false;
+	DS_CHECK_EQ(prescan.start(images, true, [&found, &done](const size_t f){ found = f; done = true; }), count);
+	// Answers come back through the engine's update
+	DS_CHECK(prescan.isRunning());
+	DS_CHECK(!done);
+
+	ds::test::Timer			timer;
+	while(!done && timer.seconds() < 5.0){
+		engine.update();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	DS_CHECK(done);
+	DS_CHECK_EQ(found, count);
+	DS_CHECK(!prescan.isRunning());
+	DS_CHECK_EQ(read_index(folder).size(), count);
+	check_size(images + "scan_5.png", 15.0f, 20.0f);
+	drop_index();
+}
+
+DS_BENCH(probe_cold_and_cached){
+	const int				count = 2000;
+	std::vector<std::string>	paths;
+	for(int i = 0; i < count; ++i){
+		paths.push_back(write_file("bench_" + std::to_string(i) + (i % 2 ? ".png" : ".jpg"), i % 2 ? png(100 + i, 100) : jpeg_sof(100 + i, 100)));
+	}
+
+	ds::test::Timer			timer;
+	for(auto& it : paths) ds::ImageMetaData meta(it);
+	ds::test::report("first lookup (header probe)", timer.seconds() * 1e6 / count, "us/image");
+
+	timer.restart();
+	for(auto& it : paths) ds::ImageMetaData meta(it);
+	ds::test::report("second lookup (cached, stat only)", timer.seconds() * 1e6 / count, "us/image");
+}
@@ -0,0 +1,306 @@
+#include "ds_test.h"
+#include "test_sprite_engine.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Poco/Exception.h>
+#include <Poco/Net/DatagramSocket.h>
+#include <Poco/Net/ServerSocket.h>
+#include <Poco/Net/StreamSocket.h>
+#include <ds/network/io_reactor.h>
+#include <ds/network/tcp_server.h>
+
+namespace {
+
+typedef ds::net::IoReactor	Reactor;
+
+// Wait on another thread, up to a few seconds
+template <typename T>
+bool						wait_for(const T& done) {
+	ds::test::Timer			timer;
+	while(!done() && timer.seconds() < 5.0) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return done();
+}
+
+Poco::Net::DatagramSocket	bound_datagram_socket() {
+	Poco::Net::DatagramSocket	s;
+	s.bind(Poco::Net::SocketAddress("127.0.0.1", 0));
+	s.setBlocking(false);
+	return s;
+}
+
+// Fill the socket until it won't take any more. Answers the bytes it took.
+size_t						fill(Poco::Net::StreamSocket& s) {
+	const std::string		block(64 * 1024, 'x');
+	size_t					total = 0;
+	while(true) {
+		int					n = 0;
+		try {
+			n = s.sendBytes(block.data(), static_cast<int>(block.size()));
+		} catch(Poco::Exception const&) {
+			break;
+		}
+		if(n <= 0) break;
+		total += n;
+	}
+	return total;
+}
+
+// Everything there is, until the other end closes or nothing comes for a while
+size_t						drain(Poco::Net::StreamSocket& s, const double idleSeconds) {
+	char					buf[64 * 1024];
+	size_t					total = 0;
+	s.setReceiveTimeout(Poco::Timespan(0, static_cast<long>(idleSeconds * 1000000.0)));
+	while(true) {
+		int					n = 0;
+		try {
+			n = s.receiveBytes(buf, sizeof(buf));
+		} catch(Poco::Exception const&) {
+			break;
+		}
+		if(n <= 0) break;
+		total += n;
+	}
+	return total;
+}
+
+const int					LATENCY_MESSAGES = 200;
+
+double						now_micros() {
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+DS_TEST(timers_repeat_and_one_shots_fire_once){
+	Reactor					reactor;
+	std::atomic<int>		repeats(0), once(0);
+	const Reactor::HandlerId	repeating = reactor.addTimer(0.01, [&repeats]() { ++repeats; });
+	reactor.addTimer(0.01, [&once]() { ++once; }, false);
+	DS_CHECK(repeating > 0);
+
+	DS_CHECK(wait_for([&repeats]() { return repeats >= 5; }));
+	DS_CHECK_EQ(once.load(), 1);
+	reactor.remove(repeating);
+	const int				stopped = repeats;
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	DS_CHECK_EQ(repeats.load(), stopped);
+}
+
+DS_TEST(posts_run_on_the_reactor_thread){
+	Reactor					reactor;
+	std::atomic<int>		ran(0);
+	std::atomic<bool>		onReactor(false);
+	DS_CHECK(!reactor.isReactorThread());
+	for(int i = 0; i < 100; ++i) {
+		reactor.post([&reactor, &ran, &onReactor]() { onReactor = reactor.isReactorThread(); ++ran; });
+	}
+	DS_CHECK(wait_for([&ran]() { return ran == 100; }));
+	DS_CHECK(onReactor.load());
+
+	reactor.stop();
+	DS_CHECK(!reactor.isRunning());
+	// Anything new starts it again
+	reactor.post([&ran]() { ++ran; });
+	DS_CHECK(wait_for([&ran]() { return ran == 101; }));
+}
+
+DS_TEST(datagrams_reach_their_handler_and_remove_waits_for_it){
+	Reactor					reactor;
+	Poco::Net::DatagramSocket	receiver = bound_datagram_socket();
+	Poco::Net::DatagramSocket	sender;
+	std::atomic<int>		received(0);
+	const Reactor::HandlerId	id = reactor.addSocket(receiver, [&receiver, &received]() {
+		char				buf[64];
+		while(receiver.available() > 0 && receiver.receiveBytes(buf, sizeof(buf)) > 0) ++received;
+	});
+	DS_CHECK(id > 0);
+	for(int i = 0; i < 100; ++i) sender.sendTo("hello", 5, receiver.address());
+	DS_CHECK(wait_for([&received]() { return received == 100; }));
+	reactor.remove(id);
+
+	// A handler that takes its time is finished before remove() answers
+	std::atomic<bool>		inside(false);
+	const Reactor::HandlerId	slow = reactor.addSocket(receiver, [&receiver, &inside]() {
+		char				buf[64];
+		inside = true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		while(receiver.available() > 0) receiver.receiveBytes(buf, sizeof(buf));
+		inside = false;
+	});
+	sender.sendTo("slow", 4, receiver.address());
+	DS_CHECK(wait_for([&inside]() { return inside.load(); }));
+	reactor.remove(slow);
+	DS_CHECK(!inside.load());
+}
+
+DS_TEST(a_full_socket_is_called_once_it_has_room){
+	Reactor					reactor;
+	Poco::Net::ServerSocket	listener(Poco::Net::SocketAddress("127.0.0.1", 0));
+	Poco::Net::StreamSocket	client(listener.address());
+	Poco::Net::StreamSocket	accepted = listener.acceptConnection();
+	accepted.setBlocking(false);
+	DS_CHECK(fill(accepted) > 0);
+
+	std::atomic<int>		writable(0);
+	Reactor::HandlerId		id = 0;
+	id = reactor.addSocket(accepted, []() {}, [&reactor, &id, &writable]() {
+		++writable;
+		reactor.setWritable(id, false);
+	});
+	reactor.setWritable(id, true);
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	DS_CHECK_EQ(writable.load(), 0);
+
+	drain(client, 0.2);
+	DS_CHECK(wait_for([&writable]() { return writable > 0; }));
+	// Turned off from the handler, so called once however much room there is
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	DS_CHECK_EQ(writable.load(), 1);
+	reactor.remove(id);
+}
+
+namespace {
+// One nothing was listening on a moment ago, TcpServer doesn't say which it was given
+Poco::Net::SocketAddress	free_address() {
+	Poco::Net::ServerSocket	probe(Poco::Net::SocketAddress("127.0.0.1", 0));
+	const Poco::Net::SocketAddress	ans = probe.address();
+	probe.close();
+	return ans;
+}
+}
+
+DS_TEST(the_tcp_server_splits_messages_and_greets_clients){
+	ds::test::TestSpriteEngine	engine;
+	const Poco::Net::SocketAddress	address = free_address();
+	ds::net::TcpServer		server(engine, address, "hello", "\n");
+	std::vector<std::string>	received;
+	server.add([&received](const std::string& s) { received.push_back(s); });
+
+	Poco::Net::StreamSocket	client(address);
+	char					buf[16];
+	client.setReceiveTimeout(Poco::Timespan(2, 0));
+	const int				n = client.receiveBytes(buf, sizeof(buf));
+	DS_CHECK_EQ(std::string(buf, std::max(n, 0)), std::string("hello\n"));
+
+	client.sendBytes("a\nb\npar", 7);
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	client.sendBytes("tial\n", 5);
+	DS_CHECK(wait_for([&engine, &received]() { engine.update(); return received.size() >= 3; }));
+	DS_CHECK_EQ(received.size(), size_t(3));
+	if(received.size() == 3) DS_CHECK_EQ(received[2], std::string("partial"));
+
+	client.close();
+	DS_CHECK(wait_for([&server]() { return server.getClientCount() == 0; }));
+}
+
+// A client that stops reading is closed once it's the limit behind, and never holds up the
+// caller or the clients that keep up
+DS_TEST(a_client_that_stops_reading_is_closed_and_the_rest_get_everything){
+	ds::test::TestSpriteEngine	engine;
+	const Poco::Net::SocketAddress	address = free_address();
+	ds::net::TcpServer		server(engine, address);
+	server.setSendLimit(256 * 1024);
+
+	Poco::Net::StreamSocket	reader(address);
+	Poco::Net::StreamSocket	stalled(address);
+	DS_CHECK(wait_for([&server]() { return server.getClientCount() == 2; }));
+
+	std::atomic<size_t>		read(0);
+	std::thread				reading([&reader, &read]() { read = drain(reader, 1.0); });
+
+	const std::string		msg(1024, 'm');
+	const int				MESSAGES = 8 * 1024;
+	double					slowest = 0.0;
+	for(int i = 0; i < MESSAGES; ++i) {
+		ds::test::Timer		one;
+		server.sendToClients(msg);
+		slowest = std::max(slowest, one.seconds());
+	}
+	const bool				closed = wait_for([&server]() { return server.getClientCount() == 1; });
+	reading.join();
+	// Waiting on the stalled client at all would be seconds
+	DS_CHECK(slowest < 0.5);
+	DS_CHECK(closed);
+	DS_CHECK_EQ(read.load(), msg.size() * MESSAGES);
+
+	// Some of it got through before it was closed
+	const size_t			got = drain(stalled, 1.0);
+	DS_CHECK(got < msg.size() * MESSAGES);
+}
+
+// How long a datagram waits between arriving and being handled: on the reactor, next to a
+// thread polling a non-blocking socket and sleeping between polls, the way NodeWatcher did at
+// node:refresh_rate's default of 100ms, and at 1ms
+DS_BENCH(arrival_to_handler_latency){
+	struct Latency {
+		std::vector<double>	mMicros;
+
+		void				add(const char* buf, const int size) {
+			double			sent = 0.0;
+			if(size != sizeof(sent)) return;
+			memcpy(&sent, buf, sizeof(sent));
+			mMicros.push_back(now_micros() - sent);
+		}
+		void				report(const std::string& what) {
+			if(mMicros.empty()) return;
+			std::sort(mMicros.begin(), mMicros.end());
+			ds::test::report(what + ", median", mMicros[mMicros.size() / 2], "us");
+			ds::test::report(what + ", 99th percentile", mMicros[mMicros.size() * 99 / 100], "us");
+		}
+	};
+	// Spaced out a little, so they don't arrive in step with the polls
+	auto					send_all = [](const Poco::Net::SocketAddress& to) {
+		Poco::Net::DatagramSocket	sender;
+		for(int i = 0; i < LATENCY_MESSAGES; ++i) {
+			std::this_thread::sleep_for(std::chrono::microseconds(2000 + (i * 7919) % 3000));
+			const double	t = now_micros();
+			sender.sendTo(&t, sizeof(t), to);
+		}
+	};
+
+	for(const int sleepMs : { 100, 1 }) {
+		Poco::Net::DatagramSocket	receiver = bound_datagram_socket();
+		Latency				latency;
+		std::atomic<bool>	running(true);
+		std::thread			poller([&receiver, &latency, &running, sleepMs]() {
+			char			buf[64];
+			while(running) {
+				while(receiver.available() > 0) {
+					const int	n = receiver.receiveBytes(buf, sizeof(buf));
+					latency.add(buf, n);
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(sleepMs));
+			}
+		});
+		send_all(receiver.address());
+		std::this_thread::sleep_for(std::chrono::milliseconds(sleepMs + 10));
+		running = false;
+		poller.join();
+		latency.report("polling every " + std::to_string(sleepMs) + "ms");
+	}
+
+	Reactor					reactor;
+	Poco::Net::DatagramSocket	receiver = bound_datagram_socket();
+	Latency					latency;
+	std::atomic<int>		handled(0);
+	const Reactor::HandlerId	id = reactor.addSocket(receiver, [&receiver, &latency, &handled]() {
+		char				buf[64];
+		while(receiver.available() > 0) {
+			const int		n = receiver.receiveBytes(buf, sizeof(buf));
+			latency.add(buf, n);
+			++handled;
+		}
+	});
+	send_all(receiver.address());
+	wait_for([&handled]() { return handled == LATENCY_MESSAGES; });
+	reactor.remove(id);
+	latency.report("IoReactor");
+}
@@ -0,0 +1,372 @@
+#include "ds_test.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cinder/Surface.h>
+#include <ds/ui/ip/ip_kernel.h>
+#include <ds/ui/ip/functions/ip_circle_mask.h>
+#include <ds/ui/ip/functions/ip_kernels.h>
+#include <ds/util/string_util.h>
+
+namespace {
+
+namespace ip = ds::ui::ip;
+
+// Every order with an alpha channel, so the SSE2 paths see the alpha in each lane
+const ci::SurfaceChannelOrder	ALPHA_ORDERS[] = { ci::SurfaceChannelOrder::RGBA, ci::SurfaceChannelOrder::BGRA, ci::SurfaceChannelOrder::ARGB, ci::SurfaceChannelOrder::ABGR };
+
+ci::Surface8u				random_surface(const int w, const int h, const ci::SurfaceChannelOrder& order, uint32_t seed) {
+	ci::Surface8u			s(w, h, order.hasAlpha(), order);
+	for(int y = 0; y < h; ++y) {
+		uint8_t*			row = s.getData() + y * s.getRowBytes();
+		for(int x = 0; x < w * static_cast<int>(s.getPixelInc()); ++x) {
+			seed = seed * 1664525u + 1013904223u;
+			row[x] = static_cast<uint8_t>(seed >> 24);
+		}
+	}
+	return s;
+}
+
+ci::Surface8u				filled_surface(const int w, const int h, const uint8_t r, const uint8_t g, const uint8_t b, const uint8_t a) {
+	ci::Surface8u			s(w, h, true, ci::SurfaceChannelOrder::RGBA);
+	for(int y = 0; y < h; ++y) {
+		uint8_t*			row = s.getData() + y * s.getRowBytes();
+		for(int x = 0; x < w; ++x) {
+			row[x * 4 + 0] = r;
+			row[x * 4 + 1] = g;
+			row[x * 4 + 2] = b;
+			row[x * 4 + 3] = a;
+		}
+	}
+	return s;
+}
+
+uint8_t*					pixel(ci::Surface8u& s, const int x, const int y) {
+	return s.getData() + y * s.getRowBytes() + x * s.getPixelInc();
+}
+
+bool						same_pixels(const ci::Surface8u& a, const ci::Surface8u& b) {
+	if(a.getWidth() != b.getWidth() || a.getHeight() != b.getHeight() || a.getPixelInc() != b.getPixelInc()) return false;
+	const size_t			bytes = static_cast<size_t>(a.getWidth() * a.getPixelInc());
+	for(int y = 0; y < a.getHeight(); ++y) {
+		if(std::memcmp(a.getData() + y * a.getRowBytes(), b.getData() + y * b.getRowBytes(), bytes) != 0) return false;
+	}
+	return true;
+}
+
+// CircleMask::on() as it was before it ran through MaskKernel
+void						old_circle_mask(const std::string& parameters, ci::Surface8u& s) {
+	if(!s.getData()) return;
+	int32_t					w = s.getWidth(), h = s.getHeight();
+	if(w < 1 || h < 1) return;
+
+	const glm::vec2			cen(static_cast<float>(w) / 2.0f, static_cast<float>(h) / 2.0f);
+	float				max = (cen.x <= cen.y ? cen.x : cen.y);
+
+	if(!parameters.empty()){
+		if(parameters.find("pad:") != std::string::npos){
+			float pad = ds::string_to_float(parameters.substr(4));
+			if(pad > max){
+				max = 0.0f;
+			} else {
+				max = max - pad;
+			}
+		}
+	}
+
+	max = max * max; // compare the squared distance for speed
+
+	ci::Surface8u::Iter		iter = s.getIter();
+	int32_t					y = 0;
+	while(iter.line()) {
+		int32_t				x = 0;
+		while(iter.pixel()) {
+			const float		d = glm::distance2(cen, glm::vec2(static_cast<float>(x), static_cast<float>(y)));
+			float			alpha_f = 1.0f;
+			if(d > max) {
+				alpha_f = 0.0f;
+			} else if(d > max - 1.0f) {
+				alpha_f = 1.0f - (d - (max - 1.0f));
+			}
+			int32_t			a = static_cast<int32_t>(static_cast<float>(iter.a()) * alpha_f);
+			if(a < 0) a = 0;
+			else if(a > 255) a = 255;
+			iter.a() = static_cast<uint8_t>(a);
+			++x;
+		}
+		++y;
+	}
+}
+
+void						run_kernel(const std::string& name, const std::string& parameters, ci::Surface8u& s) {
+	ip::KernelFunction(name).on(parameters, s);
+}
+
+}
+
+DS_TEST(circle_mask_matches_the_old_loop){
+	const int				sizes[][2] = { { 1, 1 }, { 2, 3 }, { 17, 17 }, { 37, 53 }, { 64, 48 }, { 301, 200 }, { 640, 641 } };
+	const char*				params[] = { "", "pad:0", "pad:2.5", "pad:10", "pad:100000" };
+	uint32_t				seed = 1;
+	for(auto& size : sizes) {
+		for(auto& order : ALPHA_ORDERS) {
+			for(auto p : params) {
+				const ci::Surface8u	source = random_surface(size[0], size[1], order, seed++);
+				ci::Surface8u	expected = source.clone();
+				ci::Surface8u	actual = source.clone();
+				old_circle_mask(p, expected);
+				ip::CircleMask().on(p, actual);
+				DS_CHECK(same_pixels(expected, actual));
+			}
+		}
+	}
+}
+
+// The SSE2 loops do four pixels at a time, a single pixel always takes the scalar loop
+DS_TEST(premultiply_and_alpha_sse2_match_scalar){
+	const int				count = 1027;
+	for(auto& order : ALPHA_ORDERS) {
+		ci::Surface8u		source = random_surface(count, 1, order, 99);
+		const ip::PixelLayout	layout(source);
+
+		ci::Surface8u		wide = source.clone(), single = source.clone();
+		ip::premultiplyRow(layout, wide.getData(), count);
+		for(int x = 0; x < count; ++x) ip::premultiplyRow(layout, pixel(single, x, 0), 1);
+		DS_CHECK(same_pixels(wide, single));
+
+		// And both are c * a / 255, rounded
+		bool				rounded = true;
+		for(int x = 0; x < count; ++x) {
+			const uint8_t*	in = pixel(source, x, 0);
+			const uint8_t*	out = pixel(wide, x, 0);
+			const int		a = in[layout.mA];
+			for(const int c : { layout.mR, layout.mG, layout.mB }) {
+				if(out[c] != (in[c] * a + 127) / 255) rounded = false;
+			}
+			if(out[layout.mA] != a) rounded = false;
+		}
+		DS_CHECK(rounded);
+
+		std::vector<float>	coverage(count);
+		for(int x = 0; x < count; ++x) coverage[x] = static_cast<float>(x % 37) / 36.0f;
+		wide = source.clone();
+		single = source.clone();
+		ip::multiplyAlphaRow(layout, wide.getData(), coverage.data(), count);
+		for(int x = 0; x < count; ++x) ip::multiplyAlphaRow(layout, pixel(single, x, 0), coverage.data() + x, 1);
+		DS_CHECK(same_pixels(wide, single));
+	}
+}
+
+DS_TEST(unpremultiply_undoes_premultiply){
+	ci::Surface8u			s = random_surface(256, 1, ci::SurfaceChannelOrder::RGBA, 7);
+	for(int x = 0; x < 256; ++x) pixel(s, x, 0)[3] = static_cast<uint8_t>(x);
+	const ci::Surface8u		source = s.clone();
+	const ip::PixelLayout	layout(s);
+	ip::premultiplyRow(layout, s.getData(), 256);
+	ip::unpremultiplyRow(layout, s.getData(), 256);
+
+	int						worst = 0;
+	for(int x = 1; x < 256; ++x) {
+		const uint8_t*		in = source.getData() + x * 4;
+		const uint8_t*		out = s.getData() + x * 4;
+		for(int c = 0; c < 3; ++c) {
+			// Premultiplying keeps about a step of 255 / a
+			const int		err = std::abs(in[c] - out[c]);
+			if(err * x > 255) worst = std::max(worst, err);
+		}
+		if(x == 255) DS_CHECK(std::memcmp(in, out, 4) == 0);
+	}
+	DS_CHECK_EQ(worst, 0);
+}
+
+DS_TEST(desaturate_blends_toward_luma){
+	ci::Surface8u			s = filled_surface(19, 3, 255, 0, 0, 200);
+	run_kernel("desaturate", "", s);
+	// Rec. 601 red is 77 / 256 of full
+	const uint8_t*			p = pixel(s, 5, 1);
+	DS_CHECK_EQ(int(p[0]), 77);
+	DS_CHECK_EQ(int(p[1]), 77);
+	DS_CHECK_EQ(int(p[2]), 77);
+	DS_CHECK_EQ(int(p[3]), 200);
+
+	s = filled_surface(19, 3, 255, 0, 0, 200);
+	run_kernel("desaturate", "amount:0.5", s);
+	p = pixel(s, 5, 1);
+	DS_CHECK_EQ(int(p[0]), (255 * 128 + 77 * 128 + 128) >> 8);
+	DS_CHECK_EQ(int(p[1]), (77 * 128 + 128) >> 8);
+
+	// Greys stay put at any amount, and amount 0 does nothing
+	s = filled_surface(19, 3, 90, 90, 90, 255);
+	run_kernel("desaturate", "amount:0.3", s);
+	DS_CHECK(same_pixels(s, filled_surface(19, 3, 90, 90, 90, 255)));
+	const ci::Surface8u		source = random_surface(33, 21, ci::SurfaceChannelOrder::BGRA, 5);
+	s = source.clone();
+	run_kernel("desaturate", "amount:0", s);
+	DS_CHECK(same_pixels(s, source));
+}
+
+DS_TEST(blur_keeps_flat_colour_and_spreads_evenly){
+	// Weights sum to exactly one, so a flat image doesn't move
+	ci::Surface8u			s = filled_surface(70, 40, 10, 128, 250, 255);
+	run_kernel("blur", "sigma:3", s);
+	DS_CHECK(same_pixels(s, filled_surface(70, 40, 10, 128, 250, 255)));
+
+	// A dot spreads out symmetrically and keeps about its energy
+	s = filled_surface(41, 41, 0, 0, 0, 255);
+	pixel(s, 20, 20)[0] = 255;
+	run_kernel("blur", "sigma:2", s);
+	int						total = 0;
+	bool					symmetric = true;
+	for(int y = 0; y < 41; ++y) {
+		for(int x = 0; x < 41; ++x) {
+			const int		v = pixel(s, x, y)[0];
+			total += v;
+			if(v != pixel(s, 40 - x, y)[0] || v != pixel(s, x, 40 - y)[0] || v != pixel(s, y, x)[0]) symmetric = false;
+		}
+	}
+	DS_CHECK(symmetric);
+	DS_CHECK(pixel(s, 20, 20)[0] < 255 && pixel(s, 20, 20)[0] > 0);
+	DS_CHECK(std::abs(total - 255) < 40);
+
+	// Opaque red next to transparent black. Done premultiplied, the edge fades out but stays red.
+	s = filled_surface(40, 8, 255, 0, 0, 255);
+	for(int y = 0; y < 8; ++y) for(int x = 0; x < 20; ++x) std::memset(pixel(s, x, y), 0, 4);
+	run_kernel("blur", "sigma:2", s);
+	const uint8_t*			edge = pixel(s, 19, 4);
+	DS_CHECK(edge[3] > 0 && edge[3] < 255);
+	DS_CHECK(edge[0] >= 250);
+}
+
+DS_TEST(resize_fits_the_box_and_averages){
+	// Never enlarges
+	ci::Surface8u			s = random_surface(50, 30, ci::SurfaceChannelOrder::RGBA, 3);
+	const ci::Surface8u		small = s.clone();
+	run_kernel("resize_to_fit", "width:100,height:100", s);
+	DS_CHECK(same_pixels(s, small));
+
+	// Keeps the aspect ratio, and a box filter over a 2x2 checker is its average
+	s = ci::Surface8u(400, 300, true, ci::SurfaceChannelOrder::RGBA);
+	for(int y = 0; y < 300; ++y) {
+		for(int x = 0; x < 400; ++x) {
+			uint8_t*		p = pixel(s, x, y);
+			const uint8_t	v = ((x + y) % 2) ? 200 : 100;
+			p[0] = p[1] = p[2] = v;
+			p[3] = 255;
+		}
+	}
+	run_kernel("resize_to_fit", "width:100,height:100", s);
+	DS_CHECK_EQ(s.getWidth(), 100);
+	DS_CHECK_EQ(s.getHeight(), 75);
+	bool					average = true;
+	for(int y = 0; y < 75; ++y) {
+		for(int x = 0; x < 100; ++x) {
+			if(std::abs(pixel(s, x, y)[0] - 150) > 1 || pixel(s, x, y)[3] != 255) average = false;
+		}
+	}
+	DS_CHECK(average);
+
+	// Lanczos leaves a flat image flat, and the pipeline runs it with the other kernels
+	s = filled_surface(333, 222, 40, 80, 160, 255);
+	ip::PipelineFunction().on("resize_to_fit(width:111,height:111,filter:lanczos)|desaturate(amount:0)|circle_mask", s);
+	DS_CHECK_EQ(s.getWidth(), 111);
+	DS_CHECK_EQ(s.getHeight(), 74);
+	const uint8_t*			centre = pixel(s, 55, 37);
+	DS_CHECK(std::abs(centre[0] - 40) <= 1 && std::abs(centre[1] - 80) <= 1 && std::abs(centre[2] - 160) <= 1);
+	DS_CHECK_EQ(int(centre[3]), 255);
+	DS_CHECK_EQ(int(pixel(s, 0, 0)[3]), 0);
+}
+
+// Each row is handed out exactly once
+DS_TEST(for_each_row_covers_every_row_once){
+	for(const int rows : { 1, 15, 16, 17, 1000, 4097 }) {
+		std::vector<std::atomic<int>>	seen(rows);
+		for(auto& it : seen) it = 0;
+		ip::forEachRow(rows, [&seen](const int begin, const int end) {
+			for(int y = begin; y < end; ++y) ++seen[y];
+		});
+		bool				once = true;
+		for(auto& it : seen) once = once && it == 1;
+		DS_CHECK(once);
+	}
+}
+
+// While one image has the pool, another caller runs everything on its own thread instead of waiting
+DS_TEST(busy_pool_runs_on_the_calling_thread){
+	std::mutex				mutex;
+	std::atomic<bool>		holding(false),
+							release(false);
+	std::atomic<int>		holderRows(0);
+	std::thread				holder([&]() {
+		ip::forEachRow(1000, [&](const int begin, const int end) {
+			holding = true;
+			// Gives up after a while, so a pool that makes callers wait fails instead of hanging
+			ds::test::Timer	waiting;
+			while(!release && waiting.seconds() < 2.0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			release = true;
+			holderRows += end - begin;
+		});
+	});
+
+	ds::test::Timer			timer;
+	while(!holding && timer.seconds() < 5.0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	const bool				held = holding;
+
+	const std::thread::id	caller = std::this_thread::get_id();
+	std::vector<std::pair<int, int>>	chunks;
+	bool					onCaller = true;
+	ip::forEachRow(1000, [&](const int begin, const int end) {
+		std::lock_guard<std::mutex>	lock(mutex);
+		chunks.push_back(std::make_pair(begin, end));
+		if(std::this_thread::get_id() != caller) onCaller = false;
+	});
+	// Checks throw, so let the holder go first
+	const bool				waited = release;
+	release = true;
+	holder.join();
+
+	DS_CHECK(held);
+	DS_CHECK(!waited);
+	DS_CHECK(onCaller);
+	DS_CHECK_EQ(chunks.size(), size_t(1));
+	if(!chunks.empty()) {
+		DS_CHECK_EQ(chunks.front().first, 0);
+		DS_CHECK_EQ(chunks.front().second, 1000);
+	}
+	DS_CHECK_EQ(holderRows.load(), 1000);
+}
+
+// Milliseconds per 1920x1080 image for each kernel, and the old circle mask loop next to the new one
+DS_BENCH(kernels_per_image){
+	const ci::Surface8u		source = random_surface(1920, 1080, ci::SurfaceChannelOrder::RGBA, 11);
+	const int				runs = 5;
+
+	auto					time = [&source, runs](const std::string& what, const std::function<void(ci::Surface8u&)>& fn) {
+		double				best = 1e9;
+		for(int i = 0; i < runs; ++i) {
+			ci::Surface8u	s = source.clone();
+			ds::test::Timer	timer;
+			fn(s);
+			best = std::min(best, timer.seconds());
+			ds::test::keep(s.getData());
+		}
+		ds::test::report(what, best * 1000.0, "ms/image");
+	};
+
+	time("circle_mask, old loop", [](ci::Surface8u& s) { old_circle_mask("pad:2", s); });
+	time("circle_mask", [](ci::Surface8u& s) { ip::CircleMask().on("pad:2", s); });
+	time("rounded_mask", [](ci::Surface8u& s) { run_kernel("rounded_mask", "radius:40", s); });
+	time("desaturate", [](ci::Surface8u& s) { run_kernel("desaturate", "amount:0.8", s); });
+	time("blur sigma 2", [](ci::Surface8u& s) { run_kernel("blur", "sigma:2", s); });
+	time("resize_to_fit box 512", [](ci::Surface8u& s) { run_kernel("resize_to_fit", "width:512,height:512", s); });
+	time("resize_to_fit lanczos 512", [](ci::Surface8u& s) { run_kernel("resize_to_fit", "width:512,height:512,filter:lanczos", s); });
+	time("pipeline desaturate|circle_mask, fused", [](ci::Surface8u& s) { ip::PipelineFunction().on("desaturate|circle_mask", s); });
+}
@@ -0,0 +1,256 @@
+#include "ds_test.h"
+#include "test_sprite_engine.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Poco/Exception.h>
+#include <Poco/Net/DatagramSocket.h>
+#include <ds/metrics/metrics_service.h>
+
+namespace {
+
+typedef ds::MetricsService	Metrics;
+
+// Stands in for telegraf
+Poco::Net::DatagramSocket	bound_datagram_socket() {
+	Poco::Net::DatagramSocket	s;
+	s.bind(Poco::Net::SocketAddress("127.0.0.1", 0));
+	s.setReceiveTimeout(Poco::Timespan(0, 200 * 1000));
+	return s;
+}
+
+void						configure(ds::test::TestSpriteEngine& engine, const Poco::Net::DatagramSocket& sink, const double flushInterval, const int maxPacketSize) {
+	ds::cfg::Settings&		settings = engine.getSettings("engine");
+	settings.setRawValue("metrics:active", 0, "true");
+	settings.setRawValue("metrics:send_base_info", 0, "false");
+	settings.setRawValue("metrics:send_touch_info", 0, "false");
+	settings.setRawValue("metrics:flush_interval", 0, std::to_string(flushInterval));
+	settings.setRawValue("metrics:max_packet_size", 0, std::to_string(maxPacketSize));
+	settings.setRawValue("metrics:udp_host", 0, "127.0.0.1");
+	settings.setRawValue("metrics:udp_port", 0, std::to_string(sink.address().port()));
+}
+
+struct Packet {
+	std::string				mData;
+	double					mArrived;
+};
+
+// Every datagram until nothing comes for a moment, stamped with when it came
+std::vector<Packet>			receive(Poco::Net::DatagramSocket& sink, const ds::test::Timer& clock) {
+	std::vector<Packet>		ans;
+	char					buf[64 * 1024];
+	while(true) {
+		int					n = 0;
+		try {
+			n = sink.receiveBytes(buf, sizeof(buf));
+		} catch(Poco::TimeoutException const&) {
+			break;
+		}
+		if(n <= 0) break;
+		ans.push_back(Packet{ std::string(buf, n), clock.seconds() });
+	}
+	return ans;
+}
+
+std::vector<std::string>	lines_of(const std::string& s) {
+	std::vector<std::string>	ans;
+	size_t					start = 0;
+	for(size_t end = s.find('\n'); end != std::string::npos; start = end + 1, end = s.find('\n', start)) {
+		ans.push_back(s.substr(start, end - start));
+	}
+	if(start < s.size()) ans.push_back(s.substr(start));
+	return ans;
+}
+
+// The fields of a line, without its timestamp
+std::string					fields_of(const std::string& line, const std::string& series) {
+	if(line.compare(0, series.size() + 1, series + " ") != 0) return "";
+	const std::string		rest = line.substr(series.size() + 1);
+	return rest.substr(0, rest.rfind(' '));
+}
+
+std::string					find_fields(const std::vector<std::string>& lines, const std::string& series) {
+	for(auto& it : lines) {
+		const std::string	f = fields_of(it, series);
+		if(!f.empty()) return f;
+	}
+	return "";
+}
+
+}
+
+// Whole lines go into each datagram up to the packet size, and one that's too big on its own
+DS_TEST(packs_whole_lines_up_to_the_packet_size){
+	Poco::Net::DatagramSocket	sink = bound_datagram_socket();
+	ds::test::TestSpriteEngine	engine;
+	configure(engine, sink, 60.0, 200);
+	Metrics					metrics(engine);
+
+	const int				count = 60;
+	for(int i = 0; i < count; ++i) {
+		metrics.recordMetric("packing", "value", i);
+		if(i == count / 2) metrics.recordMetricString("packing", "big", std::string(300, 'x'));
+	}
+	metrics.flush();
+
+	ds::test::Timer			clock;
+	const std::vector<Packet>	packets = receive(sink, clock);
+	DS_CHECK(packets.size() > 2);
+
+	std::vector<std::string>	lines;
+	for(size_t p = 0; p < packets.size(); ++p) {
+		const std::string&	data = packets[p].mData;
+		DS_CHECK(!data.empty() && data.back() == '\n');
+		const std::vector<std::string>	in = lines_of(data);
+		if(data.size() > 200) {
+			// Only the big line is allowed past the limit, and it goes alone
+			DS_CHECK_EQ(in.size(), size_t(1));
+			DS_CHECK(in.front().find("big=") != std::string::npos);
+		}
+		// Full, the next line wouldn't have fit
+		if(p + 1 < packets.size()) {
+			const std::string	next = lines_of(packets[p + 1].mData).front() + "\n";
+			DS_CHECK(data.size() + next.size() > 200);
+		}
+		lines.insert(lines.end(), in.begin(), in.end());
+	}
+
+	// Everything arrived, in order
+	DS_CHECK_EQ(lines.size(), size_t(count + 1));
+	int						next = 0;
+	for(auto& it : lines) {
+		if(it.find("big=") != std::string::npos) continue;
+		DS_CHECK(it.find(" value=" + std::to_string(next) + " ") != std::string::npos);
+		++next;
+	}
+	DS_CHECK_EQ(next, count);
+}
+
+DS_TEST(aggregates_counters_gauges_and_latencies){
+	Poco::Net::DatagramSocket	sink = bound_datagram_socket();
+	ds::test::TestSpriteEngine	engine;
+	configure(engine, sink, 60.0, 1400);
+	Metrics					metrics(engine);
+	const std::string		app = ",app=" + engine.getAppInstanceName();
+
+	const Metrics::MetricId	counter = metrics.getMetricId("events", "taps");
+	const Metrics::MetricId	gauge = metrics.getMetricId("state", "level", "zone=lobby");
+	const Metrics::MetricId	latency = metrics.getMetricId("load", "image");
+	DS_CHECK_EQ(metrics.getMetricId("events", "taps"), counter);
+
+	for(int i = 1; i <= 10; ++i) metrics.incrementCounter(counter, i);
+	metrics.setGauge(gauge, 1.0);
+	metrics.setGauge(gauge, 7.5);
+	// 90 in the 2ms bucket, 9 in the 20ms bucket and one in the 500ms bucket
+	for(int i = 0; i < 90; ++i) metrics.recordLatency(latency, 1.5);
+	for(int i = 0; i < 9; ++i) metrics.recordLatency(latency, 15.0);
+	metrics.recordLatency(latency, 300.0);
+	metrics.flush();
+
+	ds::test::Timer			clock;
+	std::vector<std::string>	lines;
+	for(auto& it : receive(sink, clock)) {
+		const std::vector<std::string>	in = lines_of(it.mData);
+		lines.insert(lines.end(), in.begin(), in.end());
+	}
+	DS_CHECK_EQ(lines.size(), size_t(3));
+	DS_CHECK_EQ(find_fields(lines, "events" + app), std::string("taps=55"));
+	DS_CHECK_EQ(find_fields(lines, "state" + app + ",zone=lobby"), std::string("level=7.500000"));
+	// Percentiles are the bucket's upper bound, the last one clamped to the max
+	DS_CHECK_EQ(find_fields(lines, "load" + app), std::string("image_count=100,image_mean=5.700000,image_max=300.000000,image_p50=2.000000,image_p90=2.000000,image_p99=20.000000"));
+
+	// Sent values are cleared, a quiet interval sends nothing
+	metrics.flush();
+	DS_CHECK(receive(sink, clock).empty());
+	metrics.incrementCounter(counter);
+	metrics.flush();
+	const std::vector<Packet>	again = receive(sink, clock);
+	DS_CHECK_EQ(again.size(), size_t(1));
+	if(!again.empty()) DS_CHECK_EQ(find_fields(lines_of(again.front().mData), "events" + app), std::string("taps=1"));
+}
+
+// The flush thread sends about once an interval, and nothing is sent from the recording thread
+DS_TEST(flushes_on_the_interval){
+	Poco::Net::DatagramSocket	sink = bound_datagram_socket();
+	ds::test::TestSpriteEngine	engine;
+	const double			interval = 0.1;
+	configure(engine, sink, interval, 1400);
+
+	ds::test::Timer			clock;
+	std::vector<Packet>		packets;
+	{
+		Metrics				metrics(engine);
+		const Metrics::MetricId	counter = metrics.getMetricId("ticks", "count");
+		std::atomic<bool>	stop(false);
+		std::thread			sink_thread([&sink, &clock, &packets, &stop]() {
+			while(!stop) {
+				const std::vector<Packet>	in = receive(sink, clock);
+				packets.insert(packets.end(), in.begin(), in.end());
+			}
+		});
+
+		int					recorded = 0;
+		while(clock.seconds() < 1.0) {
+			metrics.incrementCounter(counter);
+			++recorded;
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+		stop = true;
+		sink_thread.join();
+
+		int64_t				total = 0;
+		for(auto& it : packets) {
+			const std::string	f = find_fields(lines_of(it.mData), "ticks,app=" + engine.getAppInstanceName());
+			if(f.size() > 6) total += std::stoll(f.substr(6));
+		}
+		// Whatever wasn't flushed yet is still waiting in the service
+		DS_CHECK(total <= recorded);
+		DS_CHECK(total >= recorded - static_cast<int>(interval / 0.005) * 2);
+	}
+
+	// About ten flushes in the second, each about an interval after the last
+	DS_CHECK(packets.size() >= 6 && packets.size() <= 12);
+	for(size_t i = 1; i < packets.size(); ++i) {
+		const double		gap = packets[i].mArrived - packets[i - 1].mArrived;
+		DS_CHECK(gap > interval * 0.5 && gap < interval * 2.0);
+	}
+	ds::test::report("flushes in a second at a 0.1s interval", static_cast<double>(packets.size()), "");
+}
+
+// What recording costs the calling thread, per sample, alone and with other threads recording
+DS_BENCH(record_per_sample){
+	Poco::Net::DatagramSocket	sink = bound_datagram_socket();
+	ds::test::TestSpriteEngine	engine;
+	configure(engine, sink, 0.1, 1400);
+	Metrics					metrics(engine);
+	const Metrics::MetricId	counter = metrics.getMetricId("bench", "counter");
+	const Metrics::MetricId	latency = metrics.getMetricId("bench", "latency");
+
+	const int				samples = 200000;
+	const char*				names[] = { "incrementCounter", "recordLatency", "recordMetric" };
+	for(int kind = 0; kind < 3; ++kind) {
+		for(const int threads : { 1, 4 }) {
+			auto			record = [&metrics, counter, latency, kind](const int count) {
+				for(int i = 0; i < count; ++i) {
+					if(kind == 0) metrics.incrementCounter(counter);
+					else if(kind == 1) metrics.recordLatency(latency, static_cast<double>(i % 700));
+					else metrics.recordMetric("bench", "raw", i);
+				}
+			};
+
+			ds::test::Timer	timer;
+			std::vector<std::thread>	others;
+			for(int t = 1; t < threads; ++t) others.push_back(std::thread(record, samples));
+			record(samples);
+			for(auto& it : others) it.join();
+			const double	seconds = timer.seconds();
+
+			ds::test::report(std::string(names[kind]) + ", " + std::to_string(threads) + (threads == 1 ? " thread" : " threads"), seconds * 1e9 / (static_cast<double>(samples) * threads), "ns/sample");
+			metrics.flush();
+		}
+	}
+}
@@ -0,0 +1,354 @@
+#include "ds_test.h"
+#include "test_sprite_engine.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Poco/Exception.h>
+#include <Poco/Net/ServerSocket.h>
+#include <Poco/Net/StreamSocket.h>
+#include <ds/network/mqtt/mqtt_watcher.h>
+
+namespace {
+
+typedef ds::net::MqttWatcher	Watcher;
+
+// Wait on another thread, up to a few seconds
+template <typename T>
+bool						wait_for(const T& done) {
+	ds::test::Timer			timer;
+	while(!done() && timer.seconds() < 5.0) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return done();
+}
+
+// Just enough of an MQTT 3.1.1 broker on this machine for one client. Everything the client
+// publishes is kept, publish() sends to it at QoS 0 once it has subscribed.
+class Broker {
+public:
+	struct Message {
+		std::string			mTopic;
+		std::string			mPayload;
+		int					mQos;
+		bool				mRetain;
+	};
+
+	Broker() : mListener(Poco::Net::SocketAddress("127.0.0.1", 0)), mRunning(true), mSubscribedQos(-1) {
+		mAccepting = std::thread([this]() { accept(); });
+	}
+	~Broker() {
+		mRunning = false;
+		mAccepting.join();
+		for(auto& it : mConnections) it.join();
+	}
+
+	int						port() const { return mListener.address().port(); }
+
+	bool					isSubscribed() {
+		std::lock_guard<std::mutex>	lock(mMutex);
+		return mSubscribedQos >= 0;
+	}
+	std::string				getSubscription() {
+		std::lock_guard<std::mutex>	lock(mMutex);
+		return mSubscription;
+	}
+	int						getSubscribedQos() {
+		std::lock_guard<std::mutex>	lock(mMutex);
+		return mSubscribedQos;
+	}
+	std::vector<Message>	getReceived() {
+		std::lock_guard<std::mutex>	lock(mMutex);
+		return mReceived;
+	}
+
+	void					publish(const std::string& topic, const std::string& payload) {
+		std::lock_guard<std::mutex>	lock(mMutex);
+		if(mSubscribedQos < 0) return;
+		send(mSubscriber, 0x30, length_prefixed(topic) + payload);
+	}
+
+private:
+	static std::string		length_prefixed(const std::string& s) {
+		std::string			ans;
+		ans += static_cast<char>(s.size() >> 8);
+		ans += static_cast<char>(s.size() & 0xff);
+		return ans + s;
+	}
+
+	// Under mMutex, replies from the connection thread and publish() share the socket
+	static void				send(Poco::Net::StreamSocket& s, const unsigned char header, const std::string& body) {
+		std::string			packet(1, static_cast<char>(header));
+		size_t				remaining = body.size();
+		do {
+			unsigned char	digit = remaining % 128;
+			remaining /= 128;
+			if(remaining > 0) digit |= 0x80;
+			packet += static_cast<char>(digit);
+		} while(remaining > 0);
+		packet += body;
+		for(size_t sent = 0; sent < packet.size();) {
+			sent += s.sendBytes(packet.data() + sent, static_cast<int>(packet.size() - sent));
+		}
+	}
+
+	void					accept() {
+		while(mRunning) {
+			if(!mListener.poll(Poco::Timespan(0, 10000), Poco::Net::Socket::SELECT_READ)) continue;
+			Poco::Net::StreamSocket	s = mListener.acceptConnection();
+			mConnections.push_back(std::thread([this, s]() { serve(s); }));
+		}
+	}
+
+	void					serve(Poco::Net::StreamSocket s) {
+		s.setReceiveTimeout(Poco::Timespan(0, 10000));
+		std::string			in;
+		char				buf[4096];
+		while(mRunning) {
+			// Fixed header, then the remaining length, a byte at a time
+			size_t			length = 0, used = 1, multiplier = 1;
+			bool			whole = false;
+			while(used < in.size() && used < 5) {
+				const unsigned char	digit = static_cast<unsigned char>(in[used++]);
+				length += (digit & 0x7f) * multiplier;
+				multiplier *= 128;
+				if(!(digit & 0x80)) {
+					whole = in.size() >= used + length;
+					break;
+				}
+			}
+			if(whole) {
+				const unsigned char	header = static_cast<unsigned char>(in[0]);
+				const std::string	body = in.substr(used, length);
+				in.erase(0, used + length);
+				if(!handle(s, header, body)) return;
+				continue;
+			}
+
+			int				n = 0;
+			try {
+				n = s.receiveBytes(buf, sizeof(buf));
+			} catch(Poco::TimeoutException const&) {
+				continue;
+			} catch(Poco::Exception const&) {
+				return;
+			}
+			if(n <= 0) return;
+			in.append(buf, n);
+		}
+	}
+
+	// False once the client has disconnected
+	bool					handle(Poco::Net::StreamSocket& s, const unsigned char header, const std::string& body) {
+		std::lock_guard<std::mutex>	lock(mMutex);
+		const std::string	packetId = body.substr(0, 2);
+		switch(header >> 4) {
+		case 1:		// CONNECT
+			send(s, 0x20, std::string(2, '\0'));
+			break;
+		case 3: {	// PUBLISH
+			Message			m;
+			m.mQos = (header >> 1) & 3;
+			m.mRetain = (header & 1) != 0;
+			const size_t	topicSize = (static_cast<unsigned char>(body[0]) << 8) | static_cast<unsigned char>(body[1]);
+			m.mTopic = body.substr(2, topicSize);
+			const size_t	payload = 2 + topicSize + (m.mQos > 0 ? 2 : 0);
+			m.mPayload = body.substr(payload);
+			mReceived.push_back(m);
+			if(m.mQos == 1) send(s, 0x40, body.substr(2 + topicSize, 2));
+			if(m.mQos == 2) send(s, 0x50, body.substr(2 + topicSize, 2));
+			break;
+		}
+		case 6:		// PUBREL
+			send(s, 0x70, packetId);
+			break;
+		case 8: {	// SUBSCRIBE, just the first filter
+			const size_t	topicSize = (static_cast<unsigned char>(body[2]) << 8) | static_cast<unsigned char>(body[3]);
+			mSubscription = body.substr(4, topicSize);
+			mSubscribedQos = body[4 + topicSize];
+			mSubscriber = s;
+			send(s, 0x90, packetId + std::string(1, static_cast<char>(mSubscribedQos > 1 ? 1 : mSubscribedQos)));
+			break;
+		}
+		case 10:	// UNSUBSCRIBE
+			send(s, 0xb0, packetId);
+			break;
+		case 12:	// PINGREQ
+			send(s, 0xd0, "");
+			break;
+		case 14:	// DISCONNECT
+			return false;
+		}
+		return true;
+	}
+
+	Poco::Net::ServerSocket	mListener;
+	std::atomic<bool>		mRunning;
+	std::thread				mAccepting;
+	std::vector<std::thread>	mConnections;
+	std::mutex				mMutex;
+	Poco::Net::StreamSocket	mSubscriber;
+	std::string				mSubscription;
+	int						mSubscribedQos;
+	std::vector<Message>	mReceived;
+};
+
+// A watcher connected to the broker, and everything its listeners were handed
+struct Fixture {
+	Fixture(Broker& broker)
+			: mBroker(broker)
+			, mWatcher(mEngine, "127.0.0.1", "in/#", "out", 0.01f, broker.port())
+	{
+		mWatcher.setDeliveryBudget(0.0f);
+		mWatcher.addInboundListener([this](const Watcher::MessageQueue& q) {
+			for(auto& it : q) mGot[it.topic].push_back(it.message);
+		});
+	}
+	~Fixture() {
+		mWatcher.stopListening();
+	}
+
+	bool					start() {
+		mWatcher.startListening();
+		return wait_for([this]() { return mBroker.isSubscribed(); });
+	}
+
+	// Frames until the condition is met
+	template <typename T>
+	bool					update_until(const T& done) {
+		ds::test::Timer		timer;
+		while(!done() && timer.seconds() < 5.0) {
+			mEngine.update();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return done();
+	}
+
+	// Long enough for whatever the broker sent to be read, but not handed to the listeners
+	void					settle() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	}
+
+	Broker&					mBroker;
+	ds::test::TestSpriteEngine	mEngine;
+	Watcher					mWatcher;
+	std::map<std::string, std::vector<std::string>>
+							mGot;
+};
+
+}
+
+DS_TEST(outbound_messages_are_published_in_order){
+	Broker					broker;
+	Fixture					f(broker);
+	f.mWatcher.setInboundQos(1);
+	DS_CHECK(f.start());
+	DS_CHECK_EQ(broker.getSubscription(), std::string("in/#"));
+	DS_CHECK_EQ(broker.getSubscribedQos(), 1);
+
+	const int				COUNT = 500;
+	for(int i = 0; i < COUNT; ++i) f.mWatcher.sendOutboundMessage("m" + std::to_string(i));
+	f.mWatcher.sendOutboundMessage("other", "r", 0, true);
+	DS_CHECK(f.update_until([&broker]() { return broker.getReceived().size() >= size_t(COUNT + 1); }));
+
+	const std::vector<Broker::Message>	got = broker.getReceived();
+	DS_CHECK_EQ(got.size(), size_t(COUNT + 1));
+	for(int i = 0; i < COUNT; ++i) {
+		DS_CHECK_EQ(got[i].mTopic, std::string("out"));
+		DS_CHECK_EQ(got[i].mPayload, "m" + std::to_string(i));
+		DS_CHECK_EQ(got[i].mQos, 1);
+	}
+	DS_CHECK_EQ(got[COUNT].mTopic, std::string("other"));
+	DS_CHECK(got[COUNT].mRetain);
+	DS_CHECK_EQ(got[COUNT].mQos, 0);
+	DS_CHECK_EQ(f.mWatcher.getStats().mPublished, unsigned(COUNT + 1));
+}
+
+DS_TEST(only_coalesced_topics_lose_messages){
+	Broker					broker;
+	Fixture					f(broker);
+	f.mWatcher.setTopicPolicy("in/pos/+", Watcher::COALESCE_LATEST);
+	DS_CHECK(f.start());
+
+	for(int i = 0; i < 100; ++i) {
+		broker.publish("in/all", std::to_string(i));
+		broker.publish("in/pos/a", std::to_string(i));
+		broker.publish("in/pos/b", std::to_string(i));
+	}
+	f.settle();
+	DS_CHECK(f.update_until([&f]() { return f.mGot["in/all"].size() == 100 && !f.mGot["in/pos/b"].empty() && f.mGot["in/pos/b"].back() == "99"; }));
+
+	std::vector<std::string>&	all = f.mGot["in/all"];
+	for(int i = 0; i < 100; ++i) DS_CHECK_EQ(all[i], std::to_string(i));
+	DS_CHECK_EQ(f.mGot["in/pos/a"].back(), std::string("99"));
+	DS_CHECK(f.mGot["in/pos/a"].size() < 100);
+	DS_CHECK(f.mWatcher.getStats().mCoalesced > 0);
+}
+
+DS_TEST(rate_limited_topics_wait_out_their_interval){
+	Broker					broker;
+	Fixture					f(broker);
+	f.mWatcher.setTopicPolicy("in/slow", Watcher::COALESCE_RATE_LIMITED, 0.5f);
+	ds::test::Timer			timer;
+	std::vector<double>		deliveredAt;
+	f.mWatcher.addInboundListener([&timer, &deliveredAt](const Watcher::MessageQueue&) { deliveredAt.push_back(timer.seconds()); });
+	DS_CHECK(f.start());
+
+	broker.publish("in/slow", "1");
+	DS_CHECK(f.update_until([&f]() { return !f.mGot["in/slow"].empty(); }));
+	broker.publish("in/slow", "2");
+	broker.publish("in/slow", "3");
+	f.settle();
+	f.mEngine.update();
+	DS_CHECK_EQ(f.mGot["in/slow"].size(), size_t(1));
+
+	DS_CHECK(f.update_until([&f]() { return f.mGot["in/slow"].size() == 2; }));
+	DS_CHECK_EQ(f.mGot["in/slow"].back(), std::string("3"));
+	// The interval is from the start of the frame that delivered, a little before the listener
+	DS_CHECK_EQ(deliveredAt.size(), size_t(2));
+	DS_CHECK(deliveredAt[1] - deliveredAt[0] >= 0.45);
+}
+
+DS_TEST(a_slow_listener_gets_the_rest_next_frame){
+	Broker					broker;
+	Fixture					f(broker);
+	f.mWatcher.setDeliveryBudget(0.001f);
+	f.mWatcher.addInboundListener([](const Watcher::MessageQueue&) { std::this_thread::sleep_for(std::chrono::milliseconds(2)); });
+	DS_CHECK(f.start());
+
+	for(int i = 0; i < 200; ++i) broker.publish("in/all", std::to_string(i));
+	f.settle();
+	f.mEngine.update();
+	// One batch, then the budget is gone
+	DS_CHECK_EQ(f.mGot["in/all"].size(), size_t(32));
+	DS_CHECK(f.update_until([&f]() { return f.mGot["in/all"].size() == 200; }));
+}
+
+// Topics with ids in them come and go, what's kept for them has to go too
+DS_TEST(quiet_topics_are_forgotten){
+	Broker					broker;
+	Fixture					f(broker);
+	f.mWatcher.setTopicPolicy("in/id/+", Watcher::COALESCE_LATEST);
+	f.mWatcher.setTopicPolicy("in/slow", Watcher::COALESCE_RATE_LIMITED, 1.0f);
+	DS_CHECK(f.start());
+
+	const size_t			IDS = 5000;
+	for(size_t i = 0; i < IDS; ++i) broker.publish("in/id/" + std::to_string(i), "x");
+	DS_CHECK(f.update_until([&f, IDS]() { return f.mGot.size() == IDS; }));
+	f.mEngine.update();
+	DS_CHECK_EQ(f.mWatcher.getStats().mTopics, 0u);
+
+	// A rate limit is kept until it runs out
+	broker.publish("in/slow", "x");
+	DS_CHECK(f.update_until([&f, IDS]() { return f.mGot.size() == IDS + 1; }));
+	f.mEngine.update();
+	DS_CHECK_EQ(f.mWatcher.getStats().mTopics, 1u);
+	std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+	f.mEngine.update();
+	DS_CHECK_EQ(f.mWatcher.getStats().mTopics, 0u);
+	DS_CHECK_EQ(f.mWatcher.getStats().mDelivered, unsigned(IDS + 1));
+}
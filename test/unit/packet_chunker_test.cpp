@@ -0,0 +1,266 @@
+#include "ds_test.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ds/network/packet_chunker.h>
+#include <ds/network/udp_connection.h>
+
+namespace {
+
+// Random bytes barely compress, so a group of any size is about that many bytes of chunks
+std::string					random_group(std::mt19937& rng, const size_t size) {
+	std::string				ans(size, '\0');
+	for(auto& c : ans) c = static_cast<char>(rng() & 0xff);
+	return ans;
+}
+
+std::vector<std::string>	datagrams_of(const ds::net::Chunker& chunker, const unsigned count) {
+	std::vector<std::string>	ans;
+	for(unsigned i = 0; i < count; ++i) {
+		ans.push_back(std::string(chunker.getDatagrams()[i], chunker.getDatagramSizes()[i]));
+	}
+	return ans;
+}
+
+}
+
+DS_TEST(reordered_and_duplicated_chunks_make_each_group_once){
+	std::mt19937			rng(1);
+	ds::net::Chunker		chunker;
+	ds::net::DeChunker		dechunker;
+	std::string				out;
+
+	for(unsigned group = 1; group < 300; ++group) {
+		const std::string	src = random_group(rng, rng() % 20000 + 1);
+		std::vector<std::string>	datagrams = datagrams_of(chunker, chunker.chunkify(src.data(), static_cast<unsigned>(src.size()), group));
+		std::shuffle(datagrams.begin(), datagrams.end(), rng);
+
+		int					completed = 0;
+		for(auto& it : datagrams) {
+			if(dechunker.addChunk(it)) ++completed;
+			// Every chunk twice, straight after itself
+			if(dechunker.addChunk(it)) ++completed;
+		}
+		DS_CHECK_EQ(completed, 1);
+		DS_CHECK_EQ(dechunker.getAvailable(), 1u);
+		DS_CHECK(dechunker.getNextGroup(out));
+		DS_CHECK(out == src);
+		DS_CHECK(!dechunker.getNextGroup(out));
+
+		// The whole group again, after it was handed out
+		for(auto& it : datagrams) DS_CHECK(!dechunker.addChunk(it));
+		DS_CHECK_EQ(dechunker.getAvailable(), 0u);
+	}
+	DS_CHECK_EQ(dechunker.getStats().mCompleted, 299u);
+	DS_CHECK_EQ(dechunker.getStats().mDropped, 0u);
+}
+
+// Groups interleaved with each other, complete ones still come out oldest first
+DS_TEST(interleaved_groups_come_out_in_order){
+	std::mt19937			rng(2);
+	ds::net::Chunker		chunker;
+	ds::net::DeChunker		dechunker;
+	std::vector<std::string>	sources, datagrams;
+	for(unsigned group = 1; group <= 10; ++group) {
+		sources.push_back(random_group(rng, 5000 + group * 100));
+		const auto			g = datagrams_of(chunker, chunker.chunkify(sources.back().data(), static_cast<unsigned>(sources.back().size()), group));
+		datagrams.insert(datagrams.end(), g.begin(), g.end());
+	}
+	std::shuffle(datagrams.begin(), datagrams.end(), rng);
+	for(auto& it : datagrams) dechunker.addChunk(it);
+
+	DS_CHECK_EQ(dechunker.getAvailable(), 10u);
+	std::string				out;
+	for(auto& it : sources) {
+		DS_CHECK(dechunker.getNextGroup(out));
+		DS_CHECK(out == it);
+	}
+}
+
+DS_TEST(lost_chunks_drop_their_group_and_the_rest_go_on){
+	std::mt19937			rng(3);
+	ds::net::Chunker		chunker;
+	ds::net::DeChunker		dechunker;
+	std::string				out;
+	std::set<unsigned>		lossy;
+	unsigned				delivered = 0;
+
+	const unsigned			GROUPS = 400;
+	for(unsigned group = 1; group <= GROUPS; ++group) {
+		const std::string	src = random_group(rng, 8000);
+		const unsigned		count = chunker.chunkify(src.data(), static_cast<unsigned>(src.size()), group);
+		bool				lost = false;
+		for(unsigned i = 0; i < count; ++i) {
+			// About 1 datagram in 50
+			if(rng() % 50 == 0) {
+				lost = true;
+				continue;
+			}
+			dechunker.addChunk(chunker.getDatagrams()[i], chunker.getDatagramSizes()[i]);
+		}
+		if(lost) lossy.insert(group);
+		while(dechunker.getNextGroup(out)) {
+			DS_CHECK(out.size() == src.size());
+			++delivered;
+		}
+	}
+	DS_CHECK(!lossy.empty());
+	DS_CHECK_EQ(delivered, GROUPS - static_cast<unsigned>(lossy.size()));
+	// Everything that fell out of the window behind the newest group is counted
+	DS_CHECK(dechunker.getStats().mDropped <= lossy.size());
+	DS_CHECK(dechunker.getStats().mDropped + ds::net::DeChunker::DEFAULT_WINDOW >= lossy.size());
+}
+
+DS_TEST(malformed_stale_and_restarted_groups){
+	ds::net::Chunker		chunker;
+	ds::net::DeChunker		dechunker;
+	std::vector<std::string>	v;
+	std::string				out;
+
+	chunker.Chunkify("hello", 2000, v);
+	DS_CHECK(dechunker.addChunk(v[0]));
+	DS_CHECK(dechunker.getNextGroup(out) && out == "hello");
+
+	// Short a byte
+	chunker.Chunkify("short", 2001, v);
+	std::string				bad = v[0];
+	bad.resize(bad.size() - 1);
+	DS_CHECK(!dechunker.addChunk(bad));
+	DS_CHECK(!dechunker.addChunk(bad.substr(0, 3)));
+	DS_CHECK(dechunker.addChunk(v[0]));
+	DS_CHECK(dechunker.getNextGroup(out) && out == "short");
+
+	// Behind the window is late, far behind is the sender starting over
+	chunker.Chunkify("late", 2001 - ds::net::DeChunker::DEFAULT_WINDOW - 1, v);
+	DS_CHECK(!dechunker.addChunk(v[0]));
+	chunker.Chunkify("restart", 3, v);
+	DS_CHECK(dechunker.addChunk(v[0]));
+	DS_CHECK(dechunker.getNextGroup(out) && out == "restart");
+}
+
+DS_TEST(a_group_bigger_than_the_ring_grows_it){
+	std::mt19937			rng(4);
+	ds::net::Chunker		chunker(ds::net::Chunker::DEFAULT_DATAGRAM_SIZE, 16);
+	ds::net::DeChunker		dechunker;
+	const std::string		huge = random_group(rng, 1400 * 600);
+	const unsigned			count = chunker.chunkify(huge.data(), static_cast<unsigned>(huge.size()), 20);
+	DS_CHECK(count > 16);
+	for(unsigned i = 0; i < count; ++i) {
+		DS_CHECK(static_cast<unsigned>(chunker.getDatagramSizes()[i]) <= ds::net::Chunker::DEFAULT_DATAGRAM_SIZE);
+		dechunker.addChunk(chunker.getDatagrams()[i], chunker.getDatagramSizes()[i]);
+	}
+	std::string				out;
+	DS_CHECK(dechunker.getNextGroup(out));
+	DS_CHECK(out == huge);
+}
+
+namespace {
+
+// Multicast on this machine, sender and receiver. False if there's no route for it here.
+bool						open_loopback(ds::UdpConnection& server, ds::UdpConnection& client) {
+	const std::string		ip = "239.255.42.77";
+	const std::string		port = "38977";
+	return client.initialize(false, ip, port) && server.initialize(true, ip, port);
+}
+
+// Send groups as the engine does, read them back on the other socket
+unsigned					send_and_receive(ds::UdpConnection& server, ds::UdpConnection& client, const std::vector<std::string>& groups, const bool batched, double& outSeconds) {
+	ds::net::Chunker		chunker;
+	ds::net::DeChunker		dechunker;
+	std::string				msg, out;
+	unsigned				received = 0;
+	static unsigned			groupId = 0;
+
+	ds::test::Timer			timer;
+	for(auto& it : groups) {
+		const unsigned		count = chunker.chunkify(it.data(), static_cast<unsigned>(it.size()), ++groupId);
+		if(batched) {
+			server.sendMessages(chunker.getDatagrams().data(), chunker.getDatagramSizes().data(), static_cast<int>(count));
+		} else {
+			for(unsigned i = 0; i < count; ++i) server.sendMessage(chunker.getDatagrams()[i], chunker.getDatagramSizes()[i]);
+		}
+		while(client.recvMessage(msg) > 0) {
+			dechunker.addChunk(msg);
+			while(dechunker.getNextGroup(out)) ++received;
+		}
+	}
+	// Whatever is still in flight
+	ds::test::Timer			idle;
+	while(received < groups.size() && idle.seconds() < 0.5) {
+		if(client.recvMessage(msg) > 0) {
+			dechunker.addChunk(msg);
+			while(dechunker.getNextGroup(out)) ++received;
+			idle.restart();
+		} else {
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+	}
+	outSeconds = timer.seconds() - idle.seconds();
+	return received;
+}
+
+}
+
+DS_TEST(groups_cross_loopback_multicast){
+	ds::UdpConnection		server, client;
+	if(!open_loopback(server, client)) {
+		ds::test::report("skipped, no multicast here", 0.0, "");
+		return;
+	}
+
+	std::mt19937			rng(5);
+	std::vector<std::string>	groups;
+	for(int i = 0; i < 20; ++i) groups.push_back(random_group(rng, 2000 + i * 1000));
+	double					seconds = 0.0;
+	const unsigned			received = send_and_receive(server, client, groups, true, seconds);
+	if(received == 0) {
+		ds::test::report("skipped, multicast doesn't loop back here", 0.0, "");
+		return;
+	}
+	// A slow reader can lose some to its receive buffer, but never get one wrong
+	DS_CHECK(received >= groups.size() / 2);
+}
+
+// Big frames, the way a scene with a lot changing goes out, one syscall per datagram
+// next to sendmmsg()
+DS_BENCH(loopback_throughput){
+	ds::UdpConnection		server, client;
+	if(!open_loopback(server, client)) {
+		ds::test::report("skipped, no multicast here", 0.0, "");
+		return;
+	}
+
+	std::mt19937			rng(6);
+	std::vector<std::string>	groups;
+	size_t					bytes = 0;
+	for(int i = 0; i < 200; ++i) {
+		groups.push_back(random_group(rng, 64 * 1024));
+		bytes += groups.back().size();
+	}
+
+	for(const bool batched : { false, true }) {
+		double				seconds = 0.0;
+		const unsigned		received = send_and_receive(server, client, groups, batched, seconds);
+		const std::string	what = batched ? "sendMessages" : "sendMessage each";
+		ds::test::report(what + ", MB/s", bytes / (1024.0 * 1024.0) / std::max(seconds, 1e-9), "MB/s");
+		ds::test::report(what + ", groups received", received * 100.0 / groups.size(), "%");
+	}
+
+	// Without the network, what chunking and putting back together costs
+	ds::net::Chunker		chunker;
+	ds::net::DeChunker		dechunker;
+	std::string				out;
+	ds::test::Timer			timer;
+	unsigned				groupId = 0;
+	for(auto& it : groups) {
+		const unsigned		count = chunker.chunkify(it.data(), static_cast<unsigned>(it.size()), ++groupId);
+		for(unsigned i = 0; i < count; ++i) dechunker.addChunk(chunker.getDatagrams()[i], chunker.getDatagramSizes()[i]);
+		dechunker.getNextGroup(out);
+	}
+	ds::test::report("chunk and reassemble in memory", bytes / (1024.0 * 1024.0) / timer.seconds(), "MB/s");
+}
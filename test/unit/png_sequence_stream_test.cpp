@@ -0,0 +1,219 @@
+#include "ds_test.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include <cinder/ImageIo.h>
+#include <cinder/Surface.h>
+#include <ds/ui/sprite/png_sequence_pack.h>
+#include <ds/ui/sprite/png_sequence_stream.h>
+
+namespace {
+
+typedef ds::ui::PngSequenceStream	Stream;
+typedef ds::ui::PngSequencePack		Pack;
+
+// Empty every time
+std::string					fresh_folder(const std::string& name) {
+	Poco::Path				p(Poco::Path::temp());
+	p.pushDirectory("ds_png_sequence_stream_test_" + name);
+	Poco::File				dir(p);
+	if(dir.exists()) dir.remove(true);
+	dir.createDirectories();
+	return p.toString();
+}
+
+// A gradient that moves with the frame, with some noise so it doesn't compress to nothing
+ci::Surface8u				make_frame(const int width, const int height, const int frame) {
+	ci::Surface8u			s(width, height, true, ci::SurfaceChannelOrder::RGBA);
+	uint32_t				noise = 2166136261u + frame;
+	for(int y = 0; y < height; ++y) {
+		uint8_t*			px = s.getData() + y * s.getRowBytes();
+		for(int x = 0; x < width; ++x, px += 4) {
+			noise = noise * 1664525u + 1013904223u;
+			px[0] = static_cast<uint8_t>(x + frame * 8);
+			px[1] = static_cast<uint8_t>(y + frame * 4);
+			px[2] = static_cast<uint8_t>(frame * 16 + (noise >> 29));
+			px[3] = 255;
+		}
+	}
+	return s;
+}
+
+std::vector<std::string>	write_frames(const std::string& folder, const int width, const int height, const int count) {
+	std::vector<std::string>	ans;
+	for(int i = 0; i < count; ++i) {
+		ans.push_back(folder + "frame_" + std::to_string(i) + ".png");
+		ci::writeImage(ans.back(), make_frame(width, height, i));
+	}
+	return ans;
+}
+
+// Wait on the decoding threads, up to a few seconds
+bool						wait_ready(const Stream& stream, const int frameIndex) {
+	ds::test::Timer			timer;
+	while(!stream.isReady(frameIndex) && timer.seconds() < 5.0) {
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+	return stream.isReady(frameIndex);
+}
+
+bool						same_pixels(const ci::Surface8u& a, const ci::Surface8u& b) {
+	if(a.getWidth() != b.getWidth() || a.getHeight() != b.getHeight()) return false;
+	for(int y = 0; y < a.getHeight(); ++y) {
+		for(int x = 0; x < a.getWidth(); ++x) {
+			if(!(a.getPixel(ci::ivec2(x, y)) == b.getPixel(ci::ivec2(x, y)))) return false;
+		}
+	}
+	return true;
+}
+
+size_t						frame_bytes(const ci::Surface8u& s) {
+	return static_cast<size_t>(s.getRowBytes()) * s.getHeight();
+}
+
+struct Held {
+	Held() : mLeast(SIZE_MAX), mMost(0) {}
+
+	size_t					mLeast;
+	size_t					mMost;
+};
+
+// Play every frame twice around, moving on once the whole buffer is decoded. What's held is
+// looked at the whole time the threads decode the frame that came into the buffer.
+Held						play_through(Stream& stream, const int frames, const int buffer) {
+	Held					ans;
+	for(int i = 0; i < frames * 2; ++i) {
+		stream.setPlayhead(i % frames);
+		const int			newest = (i + buffer - 1) % frames;
+		ds::test::Timer		timer;
+		do {
+			const size_t	held = stream.getStats().mResidentBytes;
+			ans.mLeast = std::min(ans.mLeast, held);
+			ans.mMost = std::max(ans.mMost, held);
+		} while(!stream.isReady(newest) && timer.seconds() < 5.0);
+		if(!stream.isReady(newest)) return Held();
+	}
+	return ans;
+}
+
+// Big enough that a frame takes a while to decode, so it's caught decoding
+const int					WIDTH = 640;
+const int					HEIGHT = 360;
+const int					FRAMES = 24;
+const int					BUFFER = 6;
+const int					THREADS = 3;
+
+}
+
+DS_TEST(frames_from_files_and_packs_match_their_source){
+	const std::string		folder = fresh_folder("match");
+	const std::vector<std::string>	files = write_frames(folder, WIDTH, HEIGHT, FRAMES);
+	DS_CHECK(Pack::write(files, folder + "raw.pack", Pack::COMPRESS_NONE));
+	DS_CHECK(Pack::write(files, folder + "snappy.pack", Pack::COMPRESS_SNAPPY));
+
+	for(int source = 0; source < 3; ++source) {
+		Stream				stream;
+		stream.setBuffer(BUFFER, THREADS);
+		if(source == 0) stream.setImages(files);
+		else DS_CHECK(stream.setPack(folder + (source == 1 ? "raw.pack" : "snappy.pack")));
+		DS_CHECK_EQ(stream.getNumFrames(), FRAMES);
+
+		for(int i = 0; i < FRAMES; i += 5) {
+			stream.setPlayhead(i);
+			DS_CHECK(wait_ready(stream, i));
+			const ci::Surface8u*	frame = stream.getFrame(i);
+			DS_CHECK(frame != nullptr);
+			DS_CHECK(same_pixels(*frame, make_frame(WIDTH, HEIGHT, i)));
+		}
+	}
+}
+
+// A pack is decoded into the frame it replaces, so once the buffer is full it holds exactly
+// that many frames, decoding or not
+DS_TEST(a_pack_holds_the_buffer_and_no_more){
+	const std::string		folder = fresh_folder("pack");
+	DS_CHECK(Pack::write(write_frames(folder, WIDTH, HEIGHT, FRAMES), folder + "frames.pack"));
+
+	Stream					stream;
+	stream.setBuffer(BUFFER, THREADS);
+	DS_CHECK(stream.setPack(folder + "frames.pack"));
+	for(int i = 0; i < BUFFER; ++i) DS_CHECK(wait_ready(stream, i));
+	const size_t			one = frame_bytes(*stream.getFrame(0));
+	DS_CHECK_EQ(stream.getStats().mResidentBytes, one * BUFFER);
+
+	const Held				held = play_through(stream, FRAMES, BUFFER);
+	DS_CHECK_EQ(held.mLeast, one * BUFFER);
+	DS_CHECK_EQ(held.mMost, one * BUFFER);
+}
+
+// Loading a file makes a new frame, the one it replaces is let go first
+DS_TEST(image_files_never_hold_more_than_the_buffer){
+	const std::string		folder = fresh_folder("files");
+	const std::vector<std::string>	files = write_frames(folder, WIDTH, HEIGHT, FRAMES);
+
+	Stream					stream;
+	stream.setBuffer(BUFFER, THREADS);
+	stream.setImages(files);
+	DS_CHECK(wait_ready(stream, 0));
+	const size_t			one = frame_bytes(*stream.getFrame(0));
+
+	const Held				held = play_through(stream, FRAMES, BUFFER);
+	DS_CHECK(held.mMost > 0);
+	DS_CHECK(held.mMost <= one * BUFFER);
+	DS_CHECK_EQ(stream.getStats().mFailed, 0u);
+}
+
+DS_TEST(a_smaller_buffer_or_clear_lets_go){
+	const std::string		folder = fresh_folder("clear");
+	DS_CHECK(Pack::write(write_frames(folder, WIDTH, HEIGHT, FRAMES), folder + "frames.pack"));
+
+	Stream					stream;
+	stream.setBuffer(BUFFER, THREADS);
+	DS_CHECK(stream.setPack(folder + "frames.pack"));
+	DS_CHECK(wait_ready(stream, BUFFER - 1));
+	const size_t			one = frame_bytes(*stream.getFrame(0));
+
+	stream.setBuffer(2, 1);
+	DS_CHECK(wait_ready(stream, 1));
+	DS_CHECK_EQ(play_through(stream, FRAMES, 2).mMost, one * 2);
+
+	stream.clear();
+	DS_CHECK_EQ(stream.getStats().mResidentBytes, size_t(0));
+	DS_CHECK(stream.getFrame(0) == nullptr);
+}
+
+// Frames per second through the stream, playing as fast as the buffer fills, from png files
+// next to raw and snappy packs, on one thread and on several
+DS_BENCH(decode_throughput){
+	const int				frames = 30;
+	const std::string		folder = fresh_folder("bench");
+	const std::vector<std::string>	files = write_frames(folder, 1280, 720, frames);
+	DS_CHECK(Pack::write(files, folder + "raw.pack", Pack::COMPRESS_NONE));
+	DS_CHECK(Pack::write(files, folder + "snappy.pack", Pack::COMPRESS_SNAPPY));
+
+	const char*				names[] = { "png files", "raw pack", "snappy pack" };
+	for(int source = 0; source < 3; ++source) {
+		for(const int threads : { 1, 4 }) {
+			Stream			stream;
+			stream.setBuffer(8, threads);
+			if(source == 0) stream.setImages(files);
+			else stream.setPack(folder + (source == 1 ? "raw.pack" : "snappy.pack"));
+
+			ds::test::Timer	timer;
+			const Held		held = play_through(stream, frames, 8);
+			const double	seconds = timer.seconds();
+			const Stream::Stats	stats = stream.getStats();
+
+			const std::string	what = std::string(names[source]) + ", " + std::to_string(threads) + (threads == 1 ? " thread" : " threads");
+			ds::test::report(what + ", played", frames * 2 / seconds, "frames/s");
+			ds::test::report(what + ", decoded per thread", stats.mDecoded / std::max(stats.mDecodeSeconds, 1e-9), "frames/s");
+			ds::test::report(what + ", most held", held.mMost / (1024.0 * 1024.0), "MB");
+		}
+	}
+}
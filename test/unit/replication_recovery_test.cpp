@@ -0,0 +1,179 @@
+#include "ds_test.h"
+
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+#include <ds/app/engine/engine_io.h>
+#include <ds/network/net_connection.h>
+
+namespace {
+
+// Stands in for the multicast link between EngineServer and EngineClient: in order, but losing
+// datagrams the way a busy network does, now and then and in bursts
+class LossyLink : public ds::NetConnection {
+public:
+	LossyLink(const unsigned seed) : mRng(seed), mRate(0.0), mBurst(1.0), mInBurst(false) {}
+
+	// Lose this fraction of datagrams, in runs averaging burst datagrams
+	void					setLoss(const double rate, const double burst) {
+		mRate = rate;
+		mBurst = burst;
+		mInBurst = false;
+	}
+
+	virtual bool			initialize(bool, const std::string&, const std::string&) { return true; }
+	virtual bool			sendMessage(const std::string& data) { return sendMessage(data.data(), static_cast<int>(data.size())); }
+	virtual bool			sendMessage(const char* data, int size) {
+		// Gone on the wire, the sender never knows
+		if(lose()) return true;
+		mQueue.push_back(std::string(data, size));
+		return true;
+	}
+	virtual int				recvMessage(std::string& msg) {
+		if(mQueue.empty()) return 0;
+		msg.swap(mQueue.front());
+		mQueue.pop_front();
+		return static_cast<int>(msg.size());
+	}
+	virtual bool			isServer() const { return true; }
+	virtual bool			initialized() const { return true; }
+
+private:
+	// Two state burst loss: bursts end with probability 1/length, and start often enough to
+	// lose mRate overall
+	bool					lose() {
+		if(mRate <= 0.0) return false;
+		std::uniform_real_distribution<double>	uniform(0.0, 1.0);
+		if(mInBurst) {
+			if(uniform(mRng) < 1.0 / mBurst) mInBurst = false;
+		} else {
+			if(uniform(mRng) < mRate / (mBurst * (1.0 - mRate))) mInBurst = true;
+		}
+		return mInBurst;
+	}
+
+	std::deque<std::string>	mQueue;
+	std::mt19937			mRng;
+	double					mRate;
+	double					mBurst;
+	bool					mInBurst;
+};
+
+struct Result {
+	Result() : mFrames(0), mDelivered(0), mRepaired(0), mNacks(0), mOverhead(0.0) {}
+
+	unsigned				mFrames;
+	unsigned				mDelivered;
+	unsigned				mRepaired;
+	unsigned				mNacks;
+	// Parity and resent bytes over data bytes
+	double					mOverhead;
+};
+
+// Frames from a server to a client over the link, NACKs going back a frame later the way
+// EngineClient::sendNacks() and EngineServer answer them. The last frames go out without
+// loss, so every group has had its chance by the end.
+Result						run_link(const unsigned frames, const double rate, const double burst, const unsigned nackDelay, const unsigned paritySpan) {
+	const unsigned			FLUSH = 40;
+	LossyLink				link(frames * 7 + nackDelay + paritySpan);
+	ds::EngineSender		sender(link, true);
+	ds::EngineReceiver		receiver(link, true);
+	sender.setParitySpan(paritySpan);
+	receiver.setRecovery(nackDelay, 3);
+
+	std::mt19937			rng(frames);
+	std::string				payload;
+	std::vector<ds::net::ChunkRange>	nacks, pending;
+	Result					ans;
+	for(unsigned frame = 0; frame < frames + FLUSH; ++frame) {
+		link.setLoss(frame < frames ? rate : 0.0, burst);
+		for(auto& it : pending) sender.resend(it.mGroupId, it.mFirst, it.mCount);
+		{
+			// Random bytes get nothing from compression, so this is a frame of 1 to 12 chunks
+			payload.resize(500 + rng() % 16000);
+			for(auto& c : payload) c = static_cast<char>(rng() & 0xff);
+			ds::EngineSender::AutoSend	send(sender);
+			send.mData.addRaw(payload.data(), static_cast<unsigned>(payload.size()));
+		}
+		receiver.receiveBlob();
+		nacks.clear();
+		receiver.getMissing(nacks);
+		ans.mNacks += static_cast<unsigned>(nacks.size());
+		pending.swap(nacks);
+	}
+
+	const ds::net::DeChunker::Stats&	stats = receiver.getChunkStats();
+	const ds::EngineSender::Stats		sent = sender.getStats();
+	ans.mFrames = frames;
+	ans.mDelivered = stats.mCompleted > FLUSH ? stats.mCompleted - FLUSH : 0;
+	ans.mRepaired = stats.mRepaired;
+	ans.mOverhead = static_cast<double>(sent.mParityBytes + sent.mResentBytes) / static_cast<double>(sent.mDataBytes);
+	return ans;
+}
+
+double						delivered_rate(const Result& r) {
+	return r.mDelivered * 100.0 / r.mFrames;
+}
+
+}
+
+DS_TEST(a_clean_link_costs_nothing_extra){
+	const Result			r = run_link(300, 0.0, 1.0, 10, 0);
+	DS_CHECK_EQ(r.mDelivered, 300u);
+	DS_CHECK_EQ(r.mNacks, 0u);
+	DS_CHECK_EQ(r.mOverhead, 0.0);
+}
+
+// client:nack_delay is 0 unless a project turns it on: nothing is asked for or held back
+DS_TEST(the_default_never_asks_and_loses_what_the_link_loses){
+	const Result			r = run_link(1000, 0.02, 1.0, 0, 0);
+	DS_CHECK_EQ(r.mNacks, 0u);
+	DS_CHECK_EQ(r.mOverhead, 0.0);
+	DS_CHECK(r.mDelivered < r.mFrames);
+	DS_CHECK_EQ(r.mRepaired, 0u);
+}
+
+DS_TEST(nacks_recover_nearly_everything_a_lossy_link_drops){
+	const Result			off = run_link(1000, 0.02, 1.0, 0, 0);
+	const Result			on = run_link(1000, 0.02, 1.0, 10, 0);
+	DS_CHECK(on.mNacks > 0);
+	DS_CHECK(on.mRepaired > 0);
+	DS_CHECK(on.mDelivered > off.mDelivered);
+	DS_CHECK(delivered_rate(on) >= 99.5);
+	// Only what was asked for is sent again
+	DS_CHECK(on.mOverhead < 0.1);
+}
+
+DS_TEST(parity_repairs_single_losses_without_asking){
+	const Result			off = run_link(1000, 0.01, 1.0, 0, 0);
+	const Result			parity = run_link(1000, 0.01, 1.0, 0, 8);
+	DS_CHECK_EQ(parity.mNacks, 0u);
+	DS_CHECK(parity.mRepaired > 0);
+	DS_CHECK(parity.mDelivered > off.mDelivered);
+}
+
+// What each way of recovering gets back, and what it costs in extra bytes sent, over
+// random and bursty loss
+DS_BENCH(recovery_over_a_lossy_link){
+	struct Loss {
+		const char*			mName;
+		double				mRate;
+		double				mBurst;
+	};
+	struct Mode {
+		const char*			mName;
+		unsigned			mDelay;
+		unsigned			mParity;
+	};
+	const Loss				losses[] = { { "1% loss", 0.01, 1.0 }, { "5% loss", 0.05, 1.0 }, { "5% loss in bursts of 4", 0.05, 4.0 } };
+	const Mode				modes[] = { { "none", 0, 0 }, { "parity 8", 0, 8 }, { "nack 10", 10, 0 }, { "nack 10 and parity 8", 10, 8 } };
+	for(auto& loss : losses) {
+		for(auto& mode : modes) {
+			const Result	r = run_link(3000, loss.mRate, loss.mBurst, mode.mDelay, mode.mParity);
+			const std::string	what = std::string(loss.mName) + ", " + mode.mName;
+			ds::test::report(what + ", frames delivered", delivered_rate(r), "%");
+			ds::test::report(what + ", overhead", r.mOverhead * 100.0, "%");
+		}
+	}
+}
@@ -0,0 +1,257 @@
+#include "ds_test.h"
+#include "test_sprite_engine.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <ds/app/blob_reader.h>
+#include <ds/app/blob_registry.h>
+#include <ds/app/engine/engine_io.h>
+#include <ds/app/engine/engine_replay.h>
+#include <ds/network/udp_connection.h>
+#include <ds/ui/sprite/sprite.h>
+
+namespace {
+
+const char* const			FIXTURE = "replication_replay_test.dsrr";
+const ds::sprite_id_t		ROOT_ID = -1;
+
+// Only allocations on a thread that turned counting on
+thread_local bool			COUNT_ALLOCATIONS = false;
+std::atomic<uint64_t>		ALLOCATIONS(0);
+
+// A server's sender and encoder, built from a tree on its own engine, recording what they
+// send. The connection is never opened, so nothing goes out but the recording.
+class Recording {
+public:
+	Recording(ds::test::TestSpriteEngine& engine)
+			: mEngine(engine)
+			, mSender(mConnection, true)
+			, mFrame(0) {
+		const auto			ignore = [](ds::BlobReader&) {};
+		mEncoder.install(mRegistry, ignore, ignore, ignore, ignore, ignore);
+		ds::ui::Sprite::installAsServer(mRegistry);
+
+		std::vector<ds::RootList::Root>	roots(1);
+		roots[0].mRootId = ROOT_ID;
+		roots[0].mType = ds::RootList::Root::kOrtho;
+		mSender.startRecording(FIXTURE, roots);
+	}
+
+	// EngineServer::SendWorldState
+	void					sendWorld(ds::ui::Sprite& root) {
+		{
+			ds::EngineSender::AutoSend	send(mSender);
+			mEncoder.addWorld(send.mData);
+			mEncoder.addRoot(send.mData, root, true);
+		}
+		mEngine.mDeleted.clear();
+	}
+
+	// EngineServer::RunningState
+	void					sendFrame(ds::ui::Sprite& root) {
+		{
+			ds::EngineSender::AutoSend	send(mSender);
+			mEncoder.addHeader(send.mData, mFrame++);
+			mEncoder.addRoot(send.mData, root, false);
+			mEncoder.addDeletedSprites(send.mData, mEngine.mDeleted);
+		}
+		mEngine.mDeleted.clear();
+	}
+
+	void					close() { mSender.stopRecording(); }
+	int32_t					getLastFrame() const { return mFrame - 1; }
+
+private:
+	ds::test::TestSpriteEngine&	mEngine;
+	ds::BlobRegistry		mRegistry;
+	ds::UdpConnection		mConnection;
+	ds::EngineSender		mSender;
+	ds::ServerEncoder		mEncoder;
+	int32_t					mFrame;
+};
+
+ds::ui::Sprite*				add_tile(ds::ui::Sprite& parent, const int i) {
+	ds::ui::Sprite*			s = parent.addChildPtr(new ds::ui::Sprite(parent.getEngine(), 80.0f + i, 40.0f));
+	s->setPosition(i * 90.0f, (i % 3) * 50.0f);
+	s->setColor(ci::Color(i * 0.1f, 0.5f, 1.0f - i * 0.05f));
+	s->setOpacity(0.5f + (i % 5) * 0.1f);
+	s->setTransparent(false);
+	return s;
+}
+
+}
+
+void* operator new(std::size_t size) {
+	if(COUNT_ALLOCATIONS) ++ALLOCATIONS;
+	if(void* p = std::malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+	std::free(p);
+}
+
+DS_TEST(replays_a_session_into_the_same_tree){
+	ds::test::TestSpriteEngine	server;
+	Recording				recording(server);
+	ds::ui::Sprite*			root = new ds::ui::Sprite(server, ROOT_ID);
+	std::vector<ds::ui::Sprite*>	groups;
+	for(int g = 0; g < 3; ++g) {
+		ds::ui::Sprite*		group = root->addChildPtr(new ds::ui::Sprite(server));
+		group->setPosition(0.0f, g * 200.0f);
+		for(int i = 0; i < 10; ++i) add_tile(*group, i);
+		groups.push_back(group);
+	}
+	recording.sendWorld(*root);
+
+	// Scroll, restyle, hide, delete and add, a few things a frame
+	ds::sprite_id_t			deletedId = ds::EMPTY_SPRITE_ID;
+	ds::sprite_id_t			addedId = ds::EMPTY_SPRITE_ID;
+	for(int f = 0; f < 30; ++f) {
+		groups[0]->setPosition(-f * 12.0f, 0.0f);
+		groups[1]->getChildren()[f % 10]->setScale(1.0f + f * 0.01f);
+		groups[2]->getChildren()[f % 9]->setRotation(f * 3.0f);
+		if(f == 5) groups[1]->getChildren()[3]->hide();
+		if(f == 10) {
+			deletedId = groups[2]->getChildren()[7]->getId();
+			groups[2]->getChildren()[7]->release();
+		}
+		if(f == 20) addedId = add_tile(*groups[0], 42)->getId();
+		recording.sendFrame(*root);
+	}
+	recording.close();
+
+	ds::test::TestSpriteEngine	client(ds::ui::SpriteEngine::CLIENT_MODE);
+	ds::ReplicationPlayer	player(client);
+	ds::ui::Sprite::installAsClient(player.getRegistry());
+	DS_CHECK(player.open(FIXTURE));
+	DS_CHECK_EQ(player.getRootCount(), size_t(1));
+	DS_CHECK_EQ(player.playAll(), size_t(31));
+	DS_CHECK(player.isDone());
+	DS_CHECK_EQ(player.getServerFrame(), recording.getLastFrame());
+
+	// Same ids, geometry, color and visibility, in the same order
+	DS_CHECK_EQ(player.checksum(), ds::ReplicationReplayer::checksum(*root));
+	DS_CHECK_EQ(client.getNumberOfSprites(), server.getNumberOfSprites());
+	DS_CHECK(client.findSprite(deletedId) == nullptr);
+	ds::ui::Sprite*			added = client.findSprite(addedId);
+	DS_CHECK(added != nullptr);
+	if(added) {
+		DS_CHECK(added->getParent() && added->getParent()->getId() == groups[0]->getId());
+		DS_CHECK_EQ(added->getPosition().x, 42 * 90.0f);
+	}
+	ds::ui::Sprite*			hidden = client.findSprite(groups[1]->getChildren()[3]->getId());
+	DS_CHECK(hidden && !hidden->visible());
+
+	root->release();
+	std::remove(FIXTURE);
+}
+
+DS_TEST(sprites_wait_for_the_world){
+	ds::test::TestSpriteEngine	server;
+	Recording				recording(server);
+	ds::ui::Sprite*			root = new ds::ui::Sprite(server, ROOT_ID);
+	add_tile(*root, 1);
+	// A client that starts listening partway through sees changes before any world
+	recording.sendFrame(*root);
+	add_tile(*root, 2);
+	recording.sendWorld(*root);
+	recording.close();
+
+	ds::test::TestSpriteEngine	client(ds::ui::SpriteEngine::CLIENT_MODE);
+	ds::ReplicationPlayer	player(client);
+	ds::ui::Sprite::installAsClient(player.getRegistry());
+	DS_CHECK(player.open(FIXTURE));
+	DS_CHECK_EQ(player.play(-1.0), size_t(2));
+	DS_CHECK_EQ(player.getRoot(0).getChildren().size(), size_t(2));
+	DS_CHECK_EQ(player.checksum(), ds::ReplicationReplayer::checksum(*root));
+
+	// Opening it again starts over from a fresh root
+	DS_CHECK(player.open(FIXTURE));
+	DS_CHECK_EQ(player.getRoot(0).getChildren().size(), size_t(0));
+	player.playAll();
+	DS_CHECK_EQ(player.checksum(), ds::ReplicationReplayer::checksum(*root));
+
+	root->release();
+	std::remove(FIXTURE);
+}
+
+DS_TEST(only_recordings_open){
+	{
+		std::ofstream		junk(FIXTURE, std::ios::binary);
+		junk << "not a recording";
+	}
+	ds::test::TestSpriteEngine	client(ds::ui::SpriteEngine::CLIENT_MODE);
+	ds::ReplicationPlayer	player(client);
+	DS_CHECK(!player.open(FIXTURE));
+	DS_CHECK(!player.open("no_such_recording.dsrr"));
+	DS_CHECK_EQ(player.getRootCount(), size_t(0));
+	DS_CHECK_EQ(player.playAll(), size_t(0));
+	std::remove(FIXTURE);
+}
+
+// What decoding a frame costs a client: time, bytes, and allocations from the heap and
+// from the sprite slabs, over a longer session with a bigger tree
+DS_BENCH(decode_per_frame){
+	const int				frames = 600;
+	ds::test::TestSpriteEngine	server;
+	Recording				recording(server);
+	ds::ui::Sprite*			root = new ds::ui::Sprite(server, ROOT_ID);
+	std::vector<ds::ui::Sprite*>	groups;
+	for(int g = 0; g < 20; ++g) {
+		ds::ui::Sprite*		group = root->addChildPtr(new ds::ui::Sprite(server));
+		group->setPosition(0.0f, g * 60.0f);
+		for(int i = 0; i < 50; ++i) add_tile(*group, i);
+		groups.push_back(group);
+	}
+	recording.sendWorld(*root);
+
+	// A scroll, a few restyles, and a tile swapped out every tenth frame
+	for(int f = 0; f < frames; ++f) {
+		groups[f % groups.size()]->setPosition(-f * 2.0f, (f % groups.size()) * 60.0f);
+		for(int k = 0; k < 8; ++k) {
+			ds::ui::Sprite*	s = groups[(f + k) % groups.size()]->getChildren()[(f * 7 + k) % 40];
+			s->setOpacity(0.25f + ((f + k) % 4) * 0.25f);
+		}
+		if(f % 10 == 0) {
+			ds::ui::Sprite&	group = *groups[(f / 10) % groups.size()];
+			group.getChildren().back()->release();
+			add_tile(group, 49);
+		}
+		recording.sendFrame(*root);
+	}
+	recording.close();
+
+	ds::test::TestSpriteEngine	client(ds::ui::SpriteEngine::CLIENT_MODE);
+	ds::ReplicationPlayer	player(client);
+	ds::ui::Sprite::installAsClient(player.getRegistry());
+	DS_CHECK(player.open(FIXTURE));
+
+	const size_t			slabAllocations = ds::ui::Sprite::getAllocationStats().mAllocations;
+	const uint64_t			allocated = ALLOCATIONS;
+	COUNT_ALLOCATIONS = true;
+	const size_t			played = player.playAll();
+	COUNT_ALLOCATIONS = false;
+	const uint64_t			allocations = ALLOCATIONS - allocated;
+	const size_t			sprites = ds::ui::Sprite::getAllocationStats().mAllocations - slabAllocations;
+
+	DS_CHECK_EQ(played, size_t(frames + 1));
+	DS_CHECK_EQ(player.checksum(), ds::ReplicationReplayer::checksum(*root));
+
+	const ds::ReplicationReplayer::Stats&	stats = player.getStats();
+	ds::test::report("decode", stats.mDecodeSeconds * 1e6 / stats.mFrames, "us/frame");
+	ds::test::report("recorded", static_cast<double>(stats.mBytes) / stats.mFrames, "bytes/frame");
+	ds::test::report("heap allocations", static_cast<double>(allocations) / stats.mFrames, "per frame");
+	ds::test::report("sprite allocations", static_cast<double>(sprites) / stats.mFrames, "per frame");
+
+	root->release();
+	std::remove(FIXTURE);
+}
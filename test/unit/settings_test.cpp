@@ -0,0 +1,130 @@
+#include "ds_test.h"
+
+#include <atomic>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <ds/cfg/settings.h>
+#include <ds/util/string_util.h>
+
+namespace {
+
+const int					COUNT = 50;
+
+std::string					name_of(const char* what, const int i) {
+	std::stringstream		ss;
+	ss << what << "_" << i;
+	return ss.str();
+}
+
+// A number and a list for each i
+void						fill(ds::cfg::Settings& settings) {
+	for(int i = 0; i < COUNT; ++i) {
+		std::stringstream	ss;
+		ss << i << ", " << i * 2 << ", " << i * 3 << ", " << i * 4;
+		settings.setRawValue(name_of("number", i), 0, std::to_string(i));
+		settings.setRawValue(name_of("list", i), 0, ss.str());
+	}
+}
+
+// Every typed getter, checked against what was written
+bool						reads_back(ds::cfg::Settings& settings, const int i) {
+	const ds::cfg::Settings::Setting&	n = settings.getSetting(name_of("number", i), 0);
+	const ds::cfg::Settings::Setting&	l = settings.getSetting(name_of("list", i), 0);
+	const ci::vec3			v = l.getVec3();
+	const ci::Rectf			r = l.getRect();
+	return n.getInt() == i && n.getFloat() == static_cast<float>(i) && n.getDouble() == static_cast<double>(i)
+		&& v == ci::vec3(i, i * 2, i * 3)
+		&& r.x1 == i && r.y1 == i * 2 && r.x2 == i * 4 && r.y2 == i * 6;
+}
+
+}
+
+DS_TEST(parsed_values_follow_the_raw_value){
+	ds::cfg::Settings		settings;
+	settings.setRawValue("number", 0, "12");
+	DS_CHECK_EQ(settings.getInt("number"), 12);
+	DS_CHECK_EQ(settings.getFloat("number"), 12.0f);
+
+	// Written straight to the field, the way editors do
+	settings.getSetting("number", 0).mRawValue = "3.5";
+	DS_CHECK_EQ(settings.getFloat("number"), 3.5f);
+	DS_CHECK_EQ(settings.getInt("number"), 3);
+	DS_CHECK_EQ(settings.getDouble("number"), 3.5);
+
+	settings.setRawValue("flag", 0, "true");
+	DS_CHECK(settings.getBool("flag"));
+	settings.setRawValue("flag", 0, "false");
+	DS_CHECK(!settings.getBool("flag"));
+}
+
+// Nothing is parsed before the threads start, so they all race to fill the same values
+DS_TEST(threads_read_the_same_values){
+	for(int round = 0; round < 20; ++round) {
+		ds::cfg::Settings	settings;
+		fill(settings);
+		std::atomic<int>	wrong(0);
+		std::vector<std::thread>	threads;
+		for(int t = 0; t < 8; ++t) {
+			threads.push_back(std::thread([&settings, &wrong, t]() {
+				for(int n = 0; n < 2000; ++n) {
+					const int	i = (n * 7 + t) % COUNT;
+					if(!reads_back(settings, i)) ++wrong;
+				}
+			}));
+		}
+		for(auto& t : threads) t.join();
+		DS_CHECK_EQ(wrong.load(), 0);
+	}
+}
+
+// What a getter costs once its value is parsed, next to parsing it every time,
+// then with several threads reading at once
+DS_BENCH(typed_getters){
+	ds::cfg::Settings		settings;
+	fill(settings);
+	const int				ROUNDS = 20000;
+
+	ds::test::Timer			timer;
+	int						ints = 0;
+	for(int r = 0; r < ROUNDS; ++r) ints += settings.getInt(name_of("number", r % COUNT));
+	ds::test::report("getInt by name, name made each time", timer.seconds() * 1e9 / ROUNDS, "ns");
+
+	// The name lookup is the same for everything, so the rest use the Setting
+	std::vector<ds::cfg::Settings::Setting*>	all, lists;
+	for(int i = 0; i < COUNT; ++i) {
+		all.push_back(&settings.getSetting(name_of("number", i), 0));
+		lists.push_back(&settings.getSetting(name_of("list", i), 0));
+	}
+	timer.restart();
+	float					floats = 0.0f;
+	for(int r = 0; r < ROUNDS; ++r) floats += all[r % COUNT]->getFloat();
+	ds::test::report("getFloat", timer.seconds() * 1e9 / ROUNDS, "ns");
+	timer.restart();
+	for(int r = 0; r < ROUNDS; ++r) floats += ds::string_to_float(all[r % COUNT]->mRawValue);
+	ds::test::report("string_to_float every time", timer.seconds() * 1e9 / ROUNDS, "ns");
+
+	timer.restart();
+	for(int r = 0; r < ROUNDS; ++r) floats += lists[r % COUNT]->getRect().x2;
+	ds::test::report("getRect", timer.seconds() * 1e9 / ROUNDS, "ns");
+	timer.restart();
+	for(int r = 0; r < ROUNDS; ++r) floats += ds::parseRect(lists[r % COUNT]->mRawValue).x2;
+	ds::test::report("parseRect every time", timer.seconds() * 1e9 / ROUNDS, "ns");
+	ds::test::keep(&ints);
+	ds::test::keep(&floats);
+
+	const int				THREADS = 4;
+	std::vector<std::thread>	threads;
+	std::atomic<int>		sum(0);
+	timer.restart();
+	for(int t = 0; t < THREADS; ++t) {
+		threads.push_back(std::thread([&all, &sum, ROUNDS]() {
+			int				local = 0;
+			for(int r = 0; r < ROUNDS; ++r) local += all[r % COUNT]->getInt();
+			sum += local;
+		}));
+	}
+	for(auto& t : threads) t.join();
+	ds::test::report("getInt, 4 threads at once", timer.seconds() * 1e9 / ROUNDS, "ns per round");
+	ds::test::keep(&sum);
+}
@@ -0,0 +1,112 @@
+#include "ds_test.h"
+
+#include <fstream>
+#include <set>
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include <ds/ui/service/shader_service.h>
+#include <ds/ui/sprite/shader/shader_source.h>
+
+namespace {
+
+const std::string			VERT = "#version 150\nin vec4 ciPosition;\nvoid main(){ gl_Position = ciPosition; }\n";
+const std::string			FRAG = "#version 150\nout vec4 oColor;\nvoid main(){ oColor = vec4(1.0); }\n";
+
+// Empty every time
+std::string					fresh_folder() {
+	Poco::Path				p(Poco::Path::temp());
+	p.pushDirectory("ds_shader_source_test");
+	Poco::File				dir(p);
+	if(dir.exists()) dir.remove(true);
+	dir.createDirectories();
+	return p.toString();
+}
+
+void						write_file(const std::string& path, const std::string& text) {
+	std::ofstream			out(path.c_str(), std::ios::binary | std::ios::trunc);
+	out << text;
+}
+
+}
+
+DS_TEST(keys_cover_all_the_text_and_nothing_else){
+	const ds::ui::ShaderSource	a(VERT, FRAG);
+	ds::ui::ShaderSource	same(VERT, FRAG);
+	same.setName("another name");
+	DS_CHECK_EQ(a.getKey(), same.getKey());
+	DS_CHECK_EQ(a.getKey().size(), size_t(16));
+
+	std::set<std::string>	keys;
+	keys.insert(a.getKey());
+	keys.insert(ds::ui::ShaderSource(VERT + " ", FRAG).getKey());
+	keys.insert(ds::ui::ShaderSource(VERT, FRAG + " ").getKey());
+	// The same text split differently between the two stages
+	keys.insert(ds::ui::ShaderSource(VERT + FRAG.substr(0, 5), FRAG.substr(5)).getKey());
+	keys.insert(ds::ui::ShaderSource(VERT, FRAG, { "HIGH_QUALITY" }).getKey());
+	keys.insert(ds::ui::ShaderSource(VERT, FRAG, { "RADIUS 8" }).getKey());
+	keys.insert(ds::ui::ShaderSource(VERT, FRAG, { "RADIUS 8", "HIGH_QUALITY" }).getKey());
+	keys.insert(ds::ui::ShaderSource(VERT, FRAG, { "HIGH_QUALITY", "RADIUS 8" }).getKey());
+	DS_CHECK_EQ(keys.size(), size_t(8));
+
+	// setDefines() rekeys, and back again
+	const std::string		highQuality = ds::ui::ShaderSource(VERT, FRAG, { "HIGH_QUALITY" }).getKey();
+	ds::ui::ShaderSource	defined(VERT, FRAG);
+	defined.setDefines({ "HIGH_QUALITY" });
+	DS_CHECK_EQ(defined.getKey(), highQuality);
+	defined.setDefines(std::vector<std::string>());
+	DS_CHECK_EQ(defined.getKey(), a.getKey());
+
+	DS_CHECK(ds::ui::ShaderSource().empty());
+	DS_CHECK(ds::ui::ShaderSource(VERT, "").empty());
+	DS_CHECK(!a.empty());
+}
+
+// Every sprite using a file shader gets the same source and key from one read, and so one program
+DS_TEST(file_shaders_are_read_once_and_share_a_key){
+	ds::ui::ShaderService::clearCache();
+	const std::string		folder = fresh_folder();
+	write_file(folder + "blur.vert", VERT);
+	write_file(folder + "blur.frag", FRAG);
+
+	std::set<std::string>	keys;
+	for(int i = 0; i < 100; ++i){
+		ds::ui::ShaderSource	src;
+		DS_CHECK(ds::ui::ShaderService::getFileSource(folder, "blur", src));
+		keys.insert(src.getKey());
+		if(i == 0) DS_CHECK_EQ(src.getName(), std::string("blur"));
+	}
+	DS_CHECK_EQ(keys.size(), size_t(1));
+	const std::string		key = ds::ui::ShaderSource(VERT, FRAG).getKey();
+	DS_CHECK_EQ(*keys.begin(), key);
+
+	// An edit isn't seen until the cache is cleared, then it gets a key of its own
+	write_file(folder + "blur.frag", FRAG + "// edited\n");
+	ds::ui::ShaderSource	src;
+	ds::ui::ShaderService::getFileSource(folder, "blur", src);
+	DS_CHECK_EQ(src.getKey(), *keys.begin());
+	ds::ui::ShaderService::clearCache();
+	ds::ui::ShaderService::getFileSource(folder, "blur", src);
+	DS_CHECK(src.getKey() != *keys.begin());
+
+	DS_CHECK(!ds::ui::ShaderService::getFileSource(folder, "missing", src));
+	ds::ui::ShaderService::clearCache();
+}
+
+DS_TEST(manifests_list_each_shader_with_its_defines){
+	const auto				entries = ds::ui::ShaderManifest::parse(
+		"# blur, in two qualities\n"
+		"%APP%/data/shaders/blur\n"
+		"\n"
+		"  %APP%/data/shaders/blur HIGH_QUALITY RADIUS=8  \r\n"
+		"plain\n");
+	DS_CHECK_EQ(entries.size(), size_t(3));
+	if(entries.size() != 3) return;
+	DS_CHECK_EQ(entries[0].mLocation, std::string("%APP%/data/shaders"));
+	DS_CHECK_EQ(entries[0].mName, std::string("blur"));
+	DS_CHECK(entries[0].mDefines.empty());
+	DS_CHECK_EQ(entries[1].mDefines.size(), size_t(2));
+	if(entries[1].mDefines.size() == 2) DS_CHECK_EQ(entries[1].mDefines[1], std::string("RADIUS 8"));
+	DS_CHECK_EQ(entries[2].mLocation, std::string(""));
+	DS_CHECK_EQ(entries[2].mName, std::string("plain"));
+	DS_CHECK(ds::ui::ShaderManifest::load("no_such_manifest.txt").empty());
+}
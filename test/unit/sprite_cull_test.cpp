@@ -0,0 +1,248 @@
+#include "ds_test.h"
+#include "test_sprite_engine.h"
+
+#include <ds/params/draw_params.h>
+#include <ds/ui/sprite/sprite.h>
+
+namespace {
+
+// Walks a tree the way Sprite::drawClient() does with culling on, without drawing.
+// Every sprite in a test tree is a Probe, so the walk can reach the protected cull calls.
+class Probe : public ds::ui::Sprite {
+public:
+	Probe(ds::ui::SpriteEngine& e, const float w = 0.0f, const float h = 0.0f) : ds::ui::Sprite(e, w, h) {}
+
+	Probe&					add(Probe* child) { addChildPtr(child); return *child; }
+
+	// Answers how many sprites were visited, culled ones included
+	int						walk(const ci::mat4& parent, const ds::DrawParams& params) {
+		if(!visible()) return 0;
+		const ci::mat4		total = parent * getTransform();
+		if(params.mCull && cullSubtree(total, params)) return 1;
+
+		ds::DrawParams		childParams = params;
+		if(childParams.mCull) cullChildParams(childParams);
+		int					visited = 1;
+		for(auto child : getChildren()) visited += static_cast<Probe*>(child)->walk(total, childParams);
+		return visited;
+	}
+};
+
+// A 1920x1080 window
+ds::DrawParams				window() {
+	ds::DrawParams			p;
+	p.mCull = true;
+	p.mCullRect = ci::Rectf(0.0f, 0.0f, 1920.0f, 1080.0f);
+	return p;
+}
+
+int							walk(ds::test::TestSpriteEngine& engine, Probe& root) {
+	engine.update();
+	return root.walk(ci::mat4(), window());
+}
+
+}
+
+DS_TEST(on_and_off_screen){
+	ds::test::TestSpriteEngine	engine;
+	Probe*					root = new Probe(engine);
+	Probe&					on = root->add(new Probe(engine, 100.0f, 100.0f));
+	Probe&					off = root->add(new Probe(engine, 100.0f, 100.0f));
+	Probe&					edge = root->add(new Probe(engine, 100.0f, 100.0f));
+	on.setPosition(500.0f, 500.0f);
+	off.setPosition(2500.0f, 500.0f);
+	edge.setPosition(1870.0f, -50.0f);
+
+	DS_CHECK_EQ(walk(engine, *root), 4);
+	DS_CHECK(!on.isCulled());
+	DS_CHECK(off.isCulled());
+	DS_CHECK(!edge.isCulled());
+	DS_CHECK(!root->isCulled());
+
+	// Just touching the right edge still counts
+	off.setPosition(1920.0f, 500.0f);
+	walk(engine, *root);
+	DS_CHECK(!off.isCulled());
+	off.setPosition(1920.5f, 500.0f);
+	walk(engine, *root);
+	DS_CHECK(off.isCulled());
+	root->release();
+}
+
+DS_TEST(whole_subtrees_are_skipped){
+	// A long timeline scrolled so only the first tiles are on screen
+	ds::test::TestSpriteEngine	engine;
+	Probe*					root = new Probe(engine);
+	Probe&					strip = root->add(new Probe(engine));
+	std::vector<Probe*>		groups;
+	for(int g = 0; g < 20; ++g){
+		Probe&				group = strip.add(new Probe(engine));
+		group.setPosition(g * 1000.0f, 0.0f);
+		for(int i = 0; i < 10; ++i) group.add(new Probe(engine, 90.0f, 90.0f)).setPosition(i * 100.0f, 100.0f);
+		groups.push_back(&group);
+	}
+
+	// root, strip, two groups with 10 children each, 18 culled groups
+	DS_CHECK_EQ(walk(engine, *root), 2 + 2 * 11 + 18);
+	DS_CHECK(!groups[1]->isCulled());
+	DS_CHECK(groups[2]->isCulled());
+	DS_CHECK(groups[2]->getChildren().front()->isCulled());
+
+	// The group ending at x = -10 is culled too
+	strip.setPosition(-5000.0f, 0.0f);
+	DS_CHECK_EQ(walk(engine, *root), 2 + 2 * 11 + 18);
+	DS_CHECK(groups[4]->isCulled());
+	DS_CHECK(!groups[5]->isCulled());
+	DS_CHECK(!groups[6]->isCulled());
+	root->release();
+}
+
+DS_TEST(rotation_and_scale){
+	ds::test::TestSpriteEngine	engine;
+	Probe*					root = new Probe(engine);
+	Probe&					parent = root->add(new Probe(engine));
+	Probe&					bar = parent.add(new Probe(engine, 400.0f, 10.0f));
+
+	// Anchored at its right end just off the left edge, then swung round onto the screen
+	bar.setCenter(1.0f, 0.0f);
+	bar.setPosition(-1.0f, 500.0f);
+	walk(engine, *root);
+	DS_CHECK(bar.isCulled());
+	bar.setRotation(180.0f);
+	walk(engine, *root);
+	DS_CHECK(!bar.isCulled());
+
+	// Scaled down by the parent it covers -200.5 to -0.5, so it's only on screen once the parent moves
+	bar.setRotation(0.0f);
+	parent.setScale(0.5f);
+	walk(engine, *root);
+	DS_CHECK(bar.isCulled());
+	parent.setPosition(300.0f, 0.0f);
+	walk(engine, *root);
+	DS_CHECK(!bar.isCulled());
+	root->release();
+}
+
+DS_TEST(clipping_parents_narrow_the_cull_rect){
+	ds::test::TestSpriteEngine	engine;
+	Probe*					root = new Probe(engine);
+	Probe&					clip = root->add(new Probe(engine, 200.0f, 200.0f));
+	clip.setPosition(100.0f, 100.0f);
+	clip.setClipping(true);
+	Probe&					inside = clip.add(new Probe(engine, 50.0f, 50.0f));
+	Probe&					outside = clip.add(new Probe(engine, 50.0f, 50.0f));
+	Probe&					partly = clip.add(new Probe(engine, 50.0f, 50.0f));
+	inside.setPosition(20.0f, 20.0f);
+	// On screen, but outside the clip
+	outside.setPosition(400.0f, 20.0f);
+	partly.setPosition(180.0f, 180.0f);
+
+	walk(engine, *root);
+	DS_CHECK(!clip.isCulled());
+	DS_CHECK(!inside.isCulled());
+	DS_CHECK(outside.isCulled());
+	DS_CHECK(!partly.isCulled());
+
+	// A clipping sprite only covers its own size, however far its children reach
+	DS_CHECK(clip.getSubtreeBounds().x2 == 200.0f);
+	clip.setPosition(2000.0f, 100.0f);
+	walk(engine, *root);
+	DS_CHECK(clip.isCulled());
+	DS_CHECK(inside.isCulled());
+	root->release();
+}
+
+DS_TEST(zero_size_sprites_that_draw_are_never_culled){
+	ds::test::TestSpriteEngine	engine;
+	Probe*					root = new Probe(engine);
+
+	// A plain container takes its children's bounds
+	Probe&					container = root->add(new Probe(engine));
+	container.add(new Probe(engine, 50.0f, 50.0f)).setPosition(3000.0f, 0.0f);
+	walk(engine, *root);
+	DS_CHECK(container.isCulled());
+	DS_CHECK(!container.getSubtreeUnbounded());
+
+	// One with no size that draws itself could draw anywhere, whatever its children do
+	Probe&					drawer = root->add(new Probe(engine));
+	drawer.setTransparent(false);
+	drawer.add(new Probe(engine, 50.0f, 50.0f)).setPosition(3000.0f, 0.0f);
+	walk(engine, *root);
+	DS_CHECK(drawer.getSubtreeUnbounded());
+	DS_CHECK(!drawer.isCulled());
+	DS_CHECK(drawer.getChildren().front()->isCulled());
+
+	// And so could anything holding one
+	Probe&					holder = root->add(new Probe(engine, 10.0f, 10.0f));
+	holder.setPosition(3000.0f, 0.0f);
+	Probe&					inner = holder.add(new Probe(engine));
+	walk(engine, *root);
+	DS_CHECK(holder.isCulled());
+	inner.setTransparent(false);
+	walk(engine, *root);
+	DS_CHECK(!holder.isCulled());
+	DS_CHECK(!inner.isCulled());
+
+	// Until it's hidden
+	inner.hide();
+	walk(engine, *root);
+	DS_CHECK(holder.isCulled());
+	root->release();
+}
+
+DS_TEST(bounds_follow_changes){
+	ds::test::TestSpriteEngine	engine;
+	Probe*					root = new Probe(engine);
+	Probe&					group = root->add(new Probe(engine));
+	Probe&					a = group.add(new Probe(engine, 10.0f, 10.0f));
+	Probe&					b = group.add(new Probe(engine, 10.0f, 10.0f));
+	b.setPosition(100.0f, 0.0f);
+	DS_CHECK_EQ(group.getSubtreeBounds().x2, 110.0f);
+
+	b.setSize(40.0f, 10.0f);
+	DS_CHECK_EQ(group.getSubtreeBounds().x2, 140.0f);
+	b.hide();
+	DS_CHECK_EQ(group.getSubtreeBounds().x2, 10.0f);
+	b.show();
+	a.setPosition(-20.0f, 0.0f);
+	DS_CHECK_EQ(group.getSubtreeBounds().x1, -20.0f);
+	b.release();
+	DS_CHECK_EQ(group.getSubtreeBounds().x2, -10.0f);
+	root->release();
+}
+
+// 20 screens of 500 tiles in a scrolling strip. Culling visits one screen's worth plus a
+// node per off-screen group, where a full walk visits all 10k.
+DS_BENCH(scrolling_strip_10k){
+	ds::test::TestSpriteEngine	engine;
+	Probe*					root = new Probe(engine);
+	Probe&					strip = root->add(new Probe(engine));
+	for(int g = 0; g < 20; ++g){
+		Probe&				group = strip.add(new Probe(engine));
+		group.setPosition(g * 1920.0f, 0.0f);
+		for(int i = 0; i < 500; ++i) group.add(new Probe(engine, 70.0f, 40.0f)).setPosition(i % 25 * 76.0f, i / 25 * 50.0f);
+	}
+	engine.update();
+
+	ds::DrawParams			all = window();
+	all.mCull = false;
+	all.mCullRect = ci::Rectf(-1e9f, -1e9f, 1e9f, 1e9f);
+	const int				FRAMES = 100;
+	int						visited = 0;
+
+	ds::test::Timer			timer;
+	for(int f = 0; f < FRAMES; ++f) visited = root->walk(ci::mat4(), all);
+	ds::test::report("no culling", timer.seconds() * 1e6 / FRAMES, "us/frame");
+	ds::test::report("sprites visited", visited, "");
+
+	// Scroll every frame, so the world transforms and cull tests are redone
+	timer.restart();
+	for(int f = 0; f < FRAMES; ++f){
+		strip.setPosition(-f * 100.0f, 0.0f);
+		engine.update();
+		visited = root->walk(ci::mat4(), window());
+	}
+	ds::test::report("culled, scrolling", timer.seconds() * 1e6 / FRAMES, "us/frame");
+	ds::test::report("sprites visited", visited, "");
+	root->release();
+}
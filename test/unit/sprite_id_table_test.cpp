@@ -0,0 +1,266 @@
+#include "ds_test.h"
+#include "test_sprite_engine.h"
+
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <unordered_map>
+#include <ds/app/engine/sprite_id_table.h>
+#include <ds/ui/sprite/sprite.h>
+#include <ds/util/slab_pool.h>
+
+namespace {
+
+typedef ds::SpriteIdTable	Table;
+
+// The table never touches the sprites, so any distinct pointer will do
+ds::ui::Sprite*				fake(const size_t n) {
+	return reinterpret_cast<ds::ui::Sprite*>((n + 1) * 16);
+}
+
+ds::sprite_id_t				make_id(const uint32_t generation, const uint32_t index) {
+	return static_cast<ds::sprite_id_t>((generation << Table::INDEX_BITS) | index);
+}
+
+// Sets its id by hand, the way replicated sprites and some apps do
+class Named : public ds::ui::Sprite {
+public:
+	Named(ds::ui::SpriteEngine& e) : ds::ui::Sprite(e) {}
+	void					rename(const ds::sprite_id_t id) { setSpriteId(id); }
+};
+
+}
+
+DS_TEST(stale_ids_miss_after_their_slot_is_reused){
+	Table					table;
+	const ds::sprite_id_t	first = table.allocate();
+	table.insert(first, fake(0));
+	table.erase(first);
+
+	// Churn until the slot comes round again
+	ds::sprite_id_t			reused = ds::EMPTY_SPRITE_ID;
+	for(size_t i = 1; i < 5000 && reused == ds::EMPTY_SPRITE_ID; ++i) {
+		const ds::sprite_id_t	id = table.allocate();
+		table.insert(id, fake(i));
+		if(Table::indexOf(id) == Table::indexOf(first)) reused = id;
+		else table.erase(id);
+	}
+	DS_CHECK(reused != ds::EMPTY_SPRITE_ID);
+	DS_CHECK(reused != first);
+	DS_CHECK(Table::generationOf(reused) != Table::generationOf(first));
+	DS_CHECK(table.find(first) == nullptr);
+	DS_CHECK(table.find(reused) != nullptr);
+}
+
+DS_TEST(hand_set_ids_give_their_slots_back){
+	Table					table;
+	// Set by hand far past the end, then gone
+	const ds::sprite_id_t	handSet = 3000;
+	table.insert(handSet, fake(0));
+	DS_CHECK(table.find(handSet) == fake(0));
+	table.erase(handSet);
+	DS_CHECK(table.empty());
+
+	// Every slot up to it is free, so churn never has to grow the table past it
+	uint32_t				highest = 0;
+	for(size_t i = 0; i < 20000; ++i) {
+		const ds::sprite_id_t	id = table.allocate();
+		highest = std::max(highest, Table::indexOf(id));
+		table.insert(id, fake(i));
+		table.erase(id);
+	}
+	DS_CHECK(highest <= 3000u);
+}
+
+DS_TEST(a_slot_held_by_a_hand_set_id_isnt_handed_out){
+	Table					table;
+	std::vector<ds::sprite_id_t>	ids;
+	for(size_t i = 0; i < 2000; ++i) {
+		ids.push_back(table.allocate());
+		table.insert(ids.back(), fake(i));
+	}
+
+	// What Sprite::setSpriteId() does: the made id is erased, then the new one inserted,
+	// here on the same slot with a generation allocate() never uses
+	const uint32_t			index = Table::indexOf(ids[10]);
+	const ds::sprite_id_t	handSet = make_id(0, index);
+	table.erase(ids[10]);
+	table.insert(handSet, fake(10));
+	for(size_t i = 0; i < 2000; ++i) {
+		if(i != 10) table.erase(ids[i]);
+	}
+
+	for(size_t i = 0; i < 10000; ++i) {
+		const ds::sprite_id_t	id = table.allocate();
+		DS_CHECK(Table::indexOf(id) != index);
+		table.insert(id, fake(i));
+		table.erase(id);
+	}
+	DS_CHECK(table.find(handSet) == fake(10));
+	DS_CHECK_EQ(table.size(), size_t(1));
+
+	// Once it's gone the slot is reused like any other
+	table.erase(handSet);
+	bool					reused = false;
+	for(size_t i = 0; i < 10000 && !reused; ++i) {
+		const ds::sprite_id_t	id = table.allocate();
+		reused = (Table::indexOf(id) == index);
+		table.insert(id, fake(i));
+		table.erase(id);
+	}
+	DS_CHECK(reused);
+}
+
+// A server makes and deletes sprites while a client mirrors it, getting each delete a few
+// frames late. Both tables have to answer every lookup exactly the way the maps they
+// replaced did, for live ids, deleted ones, ones whose slot has been reused, and made-up ones.
+DS_TEST(replication_matches_plain_maps){
+	std::mt19937			rng(37);
+	Table					server, client;
+	std::unordered_map<ds::sprite_id_t, ds::ui::Sprite*>	serverMap, clientMap;
+	std::vector<ds::sprite_id_t>	live, seen;
+	std::deque<std::pair<int, ds::sprite_id_t>>	deletes;
+	size_t					made = 0;
+
+	// Negative root ids, like the engine's
+	for(int r = 1; r <= 4; ++r) {
+		server.insert(-r, fake(made));
+		client.insert(-r, fake(made));
+		serverMap[-r] = fake(made);
+		clientMap[-r] = fake(made);
+		++made;
+	}
+
+	for(int frame = 0; frame < 3000; ++frame) {
+		// Bursts of churn, big enough that slots come back while deletes are still on their way
+		const int			creates = std::uniform_int_distribution<int>(0, 40)(rng);
+		for(int i = 0; i < creates; ++i) {
+			ds::sprite_id_t	id;
+			if(std::uniform_int_distribution<int>(0, 50)(rng) == 0) {
+				// Now and then one is set by hand, the way apps sometimes do
+				id = make_id(0, std::uniform_int_distribution<uint32_t>(0, 4000)(rng));
+				if(serverMap.count(id)) continue;
+			} else {
+				id = server.allocate();
+			}
+			server.insert(id, fake(made));
+			serverMap[id] = fake(made);
+			client.insert(id, fake(made));
+			clientMap[id] = fake(made);
+			live.push_back(id);
+			seen.push_back(id);
+			++made;
+		}
+
+		const int			removes = std::min<int>(std::uniform_int_distribution<int>(0, 40)(rng), static_cast<int>(live.size()));
+		for(int i = 0; i < removes; ++i) {
+			const size_t	at = std::uniform_int_distribution<size_t>(0, live.size() - 1)(rng);
+			const ds::sprite_id_t	id = live[at];
+			live[at] = live.back();
+			live.pop_back();
+			server.erase(id);
+			serverMap.erase(id);
+			deletes.push_back(std::make_pair(frame + std::uniform_int_distribution<int>(0, 3)(rng), id));
+		}
+		while(!deletes.empty() && deletes.front().first <= frame) {
+			const ds::sprite_id_t	id = deletes.front().second;
+			deletes.pop_front();
+			client.erase(id);
+			clientMap.erase(id);
+		}
+
+		for(int q = 0; q < 50; ++q) {
+			ds::sprite_id_t	id;
+			const int		kind = std::uniform_int_distribution<int>(0, 2)(rng);
+			if(kind == 0 && !seen.empty()) id = seen[std::uniform_int_distribution<size_t>(0, seen.size() - 1)(rng)];
+			else if(kind == 1) id = -std::uniform_int_distribution<int>(0, 6)(rng);
+			else id = make_id(std::uniform_int_distribution<uint32_t>(0, 5)(rng), std::uniform_int_distribution<uint32_t>(0, 5000)(rng));
+
+			auto			s = serverMap.find(id);
+			auto			c = clientMap.find(id);
+			DS_CHECK(server.find(id) == (s == serverMap.end() ? nullptr : s->second));
+			DS_CHECK(client.find(id) == (c == clientMap.end() ? nullptr : c->second));
+		}
+		DS_CHECK_EQ(server.size(), serverMap.size());
+		DS_CHECK_EQ(client.size(), clientMap.size());
+	}
+}
+
+DS_TEST(engine_ids_follow_sprites){
+	ds::test::TestSpriteEngine	engine;
+	ds::ui::Sprite*			root = new ds::ui::Sprite(engine);
+	Named*					child = root->addChildPtr(new Named(engine));
+	const ds::sprite_id_t	made = child->getId();
+	DS_CHECK(engine.findSprite(made) == child);
+
+	child->rename(make_id(0, 12345));
+	DS_CHECK(engine.findSprite(made) == nullptr);
+	DS_CHECK(engine.findSprite(make_id(0, 12345)) == child);
+
+	root->release();
+	DS_CHECK(engine.findSprite(make_id(0, 12345)) == nullptr);
+	DS_CHECK_EQ(engine.getNumberOfSprites(), size_t(0));
+}
+
+// Lookups the way EngineClient does them for every sprite in every frame, against the map
+// the table replaced, then sprites made and released the way a scrolling list churns them.
+DS_BENCH(churn_and_lookup){
+	const size_t			LIVE = 20000;
+	std::mt19937			rng(1);
+	Table					table;
+	std::unordered_map<ds::sprite_id_t, ds::ui::Sprite*>	map;
+	std::vector<ds::sprite_id_t>	ids;
+	for(size_t i = 0; i < LIVE; ++i) {
+		ids.push_back(table.allocate());
+		table.insert(ids.back(), fake(i));
+		map[ids.back()] = fake(i);
+	}
+	std::vector<ds::sprite_id_t>	order = ids;
+	std::shuffle(order.begin(), order.end(), rng);
+
+	const int				ROUNDS = 100;
+	size_t					hits = 0;
+	ds::test::Timer			timer;
+	for(int r = 0; r < ROUNDS; ++r) {
+		for(auto id : order) hits += (table.find(id) != nullptr);
+	}
+	ds::test::report("table lookups", timer.seconds() * 1e9 / (ROUNDS * LIVE), "ns/lookup");
+	timer.restart();
+	for(int r = 0; r < ROUNDS; ++r) {
+		for(auto id : order) hits += (map.find(id) != map.end());
+	}
+	ds::test::report("unordered_map lookups", timer.seconds() * 1e9 / (ROUNDS * LIVE), "ns/lookup");
+	ds::test::keep(&hits);
+
+	// Replace 5% of the ids every round
+	timer.restart();
+	size_t					churned = 0;
+	for(int r = 0; r < ROUNDS; ++r) {
+		for(size_t i = 0; i < LIVE / 20; ++i, ++churned) {
+			const size_t	at = std::uniform_int_distribution<size_t>(0, LIVE - 1)(rng);
+			table.erase(ids[at]);
+			ids[at] = table.allocate();
+			table.insert(ids[at], fake(at));
+		}
+	}
+	ds::test::report("table erase + allocate + insert", timer.seconds() * 1e9 / churned, "ns/sprite");
+
+	// Whole sprites, pooled, made and released in a parent
+	ds::test::TestSpriteEngine	engine;
+	ds::ui::Sprite*			root = new ds::ui::Sprite(engine);
+	std::vector<ds::ui::Sprite*>	rows;
+	for(int i = 0; i < 1000; ++i) rows.push_back(root->addChildPtr(new ds::ui::Sprite(engine, 100.0f, 20.0f)));
+	const ds::SlabPool::Stats	before = ds::ui::Sprite::getAllocationStats();
+	timer.restart();
+	for(int r = 0; r < ROUNDS; ++r) {
+		for(int i = 0; i < 50; ++i) {
+			const size_t	at = std::uniform_int_distribution<size_t>(0, rows.size() - 1)(rng);
+			rows[at]->release();
+			rows[at] = root->addChildPtr(new ds::ui::Sprite(engine, 100.0f, 20.0f));
+		}
+	}
+	ds::test::report("sprite release + new", timer.seconds() * 1e9 / (ROUNDS * 50), "ns/sprite");
+	const ds::SlabPool::Stats	after = ds::ui::Sprite::getAllocationStats();
+	ds::test::report("slabs added while churning", static_cast<double>(after.mSlabs - before.mSlabs), "");
+	root->release();
+}
@@ -0,0 +1,185 @@
+#include "ds_test.h"
+#include "test_sprite_engine.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+#include <ds/ui/sprite/sprite.h>
+
+namespace {
+
+// Composed from the root down, the way drawing multiplies trans * mTransformation at each level
+ci::mat4					root_down(const ds::ui::Sprite& s) {
+	std::vector<const ds::ui::Sprite*>	path;
+	for(const ds::ui::Sprite* at = &s; at; at = at->getParent()) path.push_back(at);
+	ci::mat4				global = path.back()->getTransform();
+	for(auto it = path.rbegin() + 1, end = path.rend(); it != end; ++it) {
+		global = global * (*it)->getTransform();
+	}
+	return global;
+}
+
+bool						identical(const ci::mat4& a, const ci::mat4& b) {
+	return memcmp(&a, &b, sizeof(ci::mat4)) == 0;
+}
+
+void						collect(ds::ui::Sprite& s, std::vector<ds::ui::Sprite*>& out) {
+	out.push_back(&s);
+	for(auto child : s.getChildren()) collect(*child, out);
+}
+
+bool						is_under(ds::ui::Sprite* s, ds::ui::Sprite* ancestor) {
+	for(; s; s = s->getParent()) {
+		if(s == ancestor) return true;
+	}
+	return false;
+}
+
+void						randomize(ds::ui::Sprite& s, std::mt19937& rng) {
+	std::uniform_real_distribution<float>	pos(-2000.0f, 2000.0f), angle(-180.0f, 180.0f), scale(0.25f, 3.0f), unit(0.0f, 1.0f);
+	s.setPosition(pos(rng), pos(rng), pos(rng) * 0.1f);
+	s.setRotation(angle(rng) * 0.1f, angle(rng) * 0.1f, angle(rng));
+	s.setScale(scale(rng), scale(rng), scale(rng));
+	s.setCenter(unit(rng), unit(rng));
+	s.setSize(unit(rng) * 300.0f, unit(rng) * 300.0f);
+}
+
+// Answers how many sprites didn't match root down composition bit for bit
+int							mismatches(ds::ui::Sprite& root) {
+	std::vector<ds::ui::Sprite*>	all;
+	collect(root, all);
+	int						bad = 0;
+	for(auto s : all) {
+		const ci::mat4		global = root_down(*s);
+		if(!identical(s->getGlobalTransform(), global)) ++bad;
+		if(!identical(s->getInverseGlobalTransform(), glm::inverse(global))) ++bad;
+	}
+	return bad;
+}
+
+}
+
+DS_TEST(matches_root_down_composition_on_random_trees){
+	std::mt19937			rng(36);
+	for(int round = 0; round < 20; ++round) {
+		ds::test::TestSpriteEngine	engine;
+		ds::ui::Sprite*		root = new ds::ui::Sprite(engine);
+		std::vector<ds::ui::Sprite*>	all(1, root);
+		for(int i = 0; i < 300; ++i) {
+			ds::ui::Sprite*	parent = all[std::uniform_int_distribution<size_t>(0, all.size() - 1)(rng)];
+			ds::ui::Sprite*	s = parent->addChildPtr(new ds::ui::Sprite(engine));
+			randomize(*s, rng);
+			all.push_back(s);
+		}
+
+		// Asked for before any update, then after
+		DS_CHECK_EQ(mismatches(*root), 0);
+		engine.update();
+		DS_CHECK_EQ(mismatches(*root), 0);
+
+		for(int edit = 0; edit < 50; ++edit) {
+			ds::ui::Sprite*	s = all[std::uniform_int_distribution<size_t>(1, all.size() - 1)(rng)];
+			const int		what = std::uniform_int_distribution<int>(0, 3)(rng);
+			if(what == 0) {
+				randomize(*s, rng);
+			} else if(what == 1) {
+				// Move it under something that isn't its own descendant
+				ds::ui::Sprite*	to = all[std::uniform_int_distribution<size_t>(0, all.size() - 1)(rng)];
+				if(!is_under(to, s)) {
+					s->removeParent();
+					to->addChildPtr(s);
+				}
+			} else if(what == 2) {
+				s->release();
+				all.clear();
+				collect(*root, all);
+				if(all.size() < 2) break;
+			} else {
+				randomize(*root, rng);
+			}
+
+			// Half the time a whole pass runs between edits, half the time only lookups do
+			if(edit % 2) engine.update();
+			DS_CHECK_EQ(mismatches(*root), 0);
+		}
+		root->release();
+	}
+}
+
+DS_TEST(deep_chains_match){
+	// Long chains are where a different multiply order drifts the most
+	ds::test::TestSpriteEngine	engine;
+	std::mt19937			rng(7);
+	ds::ui::Sprite*			root = new ds::ui::Sprite(engine);
+	ds::ui::Sprite*			at = root;
+	for(int i = 0; i < 200; ++i) {
+		at = at->addChildPtr(new ds::ui::Sprite(engine));
+		randomize(*at, rng);
+	}
+	engine.update();
+	DS_CHECK(identical(at->getGlobalTransform(), root_down(*at)));
+	randomize(*root->getChildren().front(), rng);
+	DS_CHECK(identical(at->getGlobalTransform(), root_down(*at)));
+	root->release();
+}
+
+// 20k sprites, 20 groups of 50 rows of 20. A pass after the root moves redoes everything, a pass
+// after 1% of the leaves move should only touch those, and composing per sprite is per call.
+DS_BENCH(world_transforms_20k){
+	ds::test::TestSpriteEngine	engine;
+	std::mt19937			rng(20);
+	ds::ui::Sprite*			root = new ds::ui::Sprite(engine);
+	std::vector<ds::ui::Sprite*>	leaves;
+	for(int g = 0; g < 20; ++g) {
+		ds::ui::Sprite*		group = root->addChildPtr(new ds::ui::Sprite(engine));
+		group->setPosition(g * 1920.0f, 0.0f);
+		for(int r = 0; r < 50; ++r) {
+			ds::ui::Sprite*	row = group->addChildPtr(new ds::ui::Sprite(engine));
+			row->setPosition(0.0f, r * 50.0f);
+			row->setRotation(r * 0.5f);
+			for(int i = 0; i < 20; ++i) {
+				ds::ui::Sprite*	leaf = row->addChildPtr(new ds::ui::Sprite(engine, 90.0f, 40.0f));
+				leaf->setPosition(i * 96.0f, 0.0f);
+				leaves.push_back(leaf);
+			}
+		}
+	}
+	engine.update();
+	std::vector<ds::ui::Sprite*>	all;
+	collect(*root, all);
+	ds::test::report("sprites", static_cast<double>(all.size()), "");
+
+	const int				FRAMES = 50;
+	ds::test::Timer			timer;
+	for(int f = 0; f < FRAMES; ++f) {
+		root->setPosition(-f * 10.0f, 0.0f);
+		engine.update();
+	}
+	ds::test::report("root moved, full pass", timer.seconds() * 1e6 / FRAMES, "us/frame");
+
+	std::uniform_int_distribution<size_t>	pick(0, leaves.size() - 1);
+	timer.restart();
+	for(int f = 0; f < FRAMES; ++f) {
+		for(size_t i = 0; i < leaves.size() / 100; ++i) leaves[pick(rng)]->setPosition(f * 1.0f, 0.0f);
+		engine.update();
+	}
+	ds::test::report("1% of leaves moved", timer.seconds() * 1e6 / FRAMES, "us/frame");
+
+	// Every sprite asks for its world transform, the way hit testing and culling do
+	timer.restart();
+	float					sum = 0.0f;
+	for(int f = 0; f < FRAMES; ++f) {
+		for(auto s : all) sum += s->getGlobalTransform()[3][0];
+	}
+	ds::test::keep(&sum);
+	ds::test::report("lookups, all sprites", timer.seconds() * 1e6 / FRAMES, "us/frame");
+
+	timer.restart();
+	ci::mat4				last;
+	for(int f = 0; f < FRAMES; ++f) {
+		for(auto s : all) last = root_down(*s);
+	}
+	ds::test::keep(&last);
+	ds::test::report("composed per sprite, all sprites", timer.seconds() * 1e6 / FRAMES, "us/frame");
+	root->release();
+}
@@ -0,0 +1,190 @@
+#include "ds_test.h"
+#include "test_sprite_engine.h"
+
+#include <cinder/Easing.h>
+#include <ds/ui/sprite/sprite.h>
+
+namespace {
+
+// Counts what reaches the virtual setters
+class Watched : public ds::ui::Sprite {
+public:
+	Watched(ds::ui::SpriteEngine& e) : ds::ui::Sprite(e, 10.0f, 10.0f), mPositionSets(0), mScaleSets(0), mRotationSets(0), mSizeChanges(0) {}
+
+	int						mPositionSets, mScaleSets, mRotationSets, mSizeChanges;
+	ci::vec3				mLastPosition;
+
+protected:
+	virtual void			doSetPosition(const ci::vec3& p){ ++mPositionSets; mLastPosition = p; ds::ui::Sprite::doSetPosition(p); }
+	virtual void			doSetScale(const ci::vec3& s){ ++mScaleSets; ds::ui::Sprite::doSetScale(s); }
+	virtual void			doSetRotation(const ci::vec3& r){ ++mRotationSets; ds::ui::Sprite::doSetRotation(r); }
+	virtual void			onSizeChanged(){ ++mSizeChanges; }
+};
+
+}
+
+DS_TEST(from_is_read_when_the_delay_runs_out){
+	ds::test::TestSpriteEngine	engine;
+	ds::ui::Sprite*				s = new ds::ui::Sprite(engine);
+	s->tweenPosition(ci::vec3(100.0f, 0.0f, 0.0f), 1.0f, 1.0f, ci::easeNone);
+
+	// Moved while the tween is still waiting, so that's where it starts
+	engine.step(0.5f);
+	DS_CHECK_NEAR(s->getPosition().x, 0.0f, 1e-5f);
+	s->setPosition(50.0f, 0.0f);
+
+	engine.step(0.5f);
+	DS_CHECK_NEAR(s->getPosition().x, 50.0f, 1e-4f);
+	engine.step(0.5f);
+	DS_CHECK_NEAR(s->getPosition().x, 75.0f, 1e-4f);
+	engine.step(0.5f);
+	DS_CHECK_NEAR(s->getPosition().x, 100.0f, 1e-5f);
+	DS_CHECK(!s->getPositionTweenIsRunning());
+	s->release();
+}
+
+DS_TEST(each_channel_reads_its_own_from){
+	ds::test::TestSpriteEngine	engine;
+	ds::ui::Sprite*				s = new ds::ui::Sprite(engine, 20.0f, 40.0f);
+	s->setOpacity(0.2f);
+	s->setScale(2.0f);
+	s->setColor(ci::Color(1.0f, 0.0f, 0.0f));
+
+	s->tweenOpacity(1.0f, 1.0f, 0.0f, ci::easeNone);
+	s->tweenScale(ci::vec3(4.0f), 1.0f, 0.0f, ci::easeNone);
+	s->tweenSize(ci::vec3(40.0f, 80.0f, 1.0f), 1.0f, 0.0f, ci::easeNone);
+	s->tweenColor(ci::Color(0.0f, 0.0f, 1.0f), 1.0f, 0.0f, ci::easeNone);
+
+	engine.step(0.5f);
+	DS_CHECK_NEAR(s->getOpacity(), 0.6f, 1e-5f);
+	DS_CHECK_NEAR(s->getScale().x, 3.0f, 1e-5f);
+	DS_CHECK_NEAR(s->getWidth(), 30.0f, 1e-4f);
+	DS_CHECK_NEAR(s->getHeight(), 60.0f, 1e-4f);
+	DS_CHECK_NEAR(s->getColor().r, 0.5f, 1e-5f);
+	DS_CHECK_NEAR(s->getColor().b, 0.5f, 1e-5f);
+	s->release();
+}
+
+DS_TEST(restarting_a_delayed_tween_reads_from_again){
+	ds::test::TestSpriteEngine	engine;
+	ds::ui::Sprite*				s = new ds::ui::Sprite(engine);
+	s->tweenOpacity(0.0f, 1.0f, 0.5f, ci::easeNone);
+	s->setOpacity(0.5f);
+	s->tweenOpacity(0.0f, 1.0f, 0.5f, ci::easeNone);
+
+	engine.step(1.0f);
+	DS_CHECK_NEAR(s->getOpacity(), 0.25f, 1e-5f);
+	s->release();
+}
+
+DS_TEST(tweens_go_through_the_virtual_setters){
+	ds::test::TestSpriteEngine	engine;
+	Watched*					s = new Watched(engine);
+	s->tweenPosition(ci::vec3(10.0f, 20.0f, 0.0f), 1.0f, 0.0f, ci::easeNone);
+	s->tweenScale(ci::vec3(2.0f), 1.0f, 0.0f, ci::easeNone);
+	s->tweenRotation(ci::vec3(0.0f, 0.0f, 90.0f), 1.0f, 0.0f, ci::easeNone);
+
+	engine.step(0.25f);
+	DS_CHECK_EQ(s->mPositionSets, 1);
+	DS_CHECK_EQ(s->mScaleSets, 1);
+	DS_CHECK_EQ(s->mRotationSets, 1);
+	DS_CHECK_NEAR(s->mLastPosition.y, 5.0f, 1e-5f);
+
+	engine.step(1.0f);
+	DS_CHECK_EQ(s->mPositionSets, 2);
+	DS_CHECK_NEAR(s->getPosition().x, 10.0f, 1e-5f);
+	DS_CHECK_NEAR(s->getRotation().z, 90.0f, 1e-4f);
+	s->release();
+}
+
+DS_TEST(size_changes_once_per_frame){
+	ds::test::TestSpriteEngine	engine;
+	Watched*					s = new Watched(engine);
+	s->mSizeChanges = 0;
+	s->tweenSize(ci::vec3(20.0f, 20.0f, 1.0f), 1.0f, 0.0f, ci::easeNone);
+	s->tweenPosition(ci::vec3(10.0f, 0.0f, 0.0f), 1.0f, 0.0f, ci::easeNone);
+	s->tweenScale(ci::vec3(2.0f), 1.0f, 0.0f, ci::easeNone);
+
+	for(int i = 1; i <= 4; ++i){
+		engine.step(0.25f);
+		DS_CHECK_EQ(s->mSizeChanges, i);
+	}
+	s->release();
+}
+
+DS_TEST(finish_runs_once_with_the_end_value){
+	ds::test::TestSpriteEngine	engine;
+	ds::ui::Sprite*				s = new ds::ui::Sprite(engine);
+	int							finished = 0;
+	float						atFinish = -1.0f;
+	s->tweenOpacity(0.0f, 0.3f, 0.2f, ci::EaseOutCubic(), [&]{ ++finished; atFinish = s->getOpacity(); });
+
+	for(int i = 0; i < 10; ++i) engine.step(0.1f);
+	DS_CHECK_EQ(finished, 1);
+	DS_CHECK_EQ(atFinish, 0.0f);
+	s->release();
+}
+
+DS_TEST(complete_before_the_delay_uses_the_end_value){
+	ds::test::TestSpriteEngine	engine;
+	ds::ui::Sprite*				s = new ds::ui::Sprite(engine);
+	int							finished = 0;
+	s->tweenPosition(ci::vec3(5.0f, 6.0f, 7.0f), 1.0f, 2.0f, ci::easeNone, [&finished]{ ++finished; });
+	s->completeTweenPosition(true);
+
+	DS_CHECK(s->getPosition() == ci::vec3(5.0f, 6.0f, 7.0f));
+	DS_CHECK_EQ(finished, 1);
+	engine.step(5.0f);
+	DS_CHECK(s->getPosition() == ci::vec3(5.0f, 6.0f, 7.0f));
+	s->release();
+}
+
+DS_TEST(released_mid_tween){
+	ds::test::TestSpriteEngine	engine;
+	ds::ui::Sprite*				parent = new ds::ui::Sprite(engine);
+	ds::ui::Sprite*				child = new ds::ui::Sprite(engine);
+	parent->addChild(*child);
+	child->tweenOpacity(0.0f, 1.0f, 0.0f, ci::easeNone, nullptr, [&]{ child->release(); });
+	parent->tweenPosition(ci::vec3(1.0f), 1.0f, 0.5f);
+
+	engine.step(0.25f);
+	DS_CHECK(parent->getChildren().empty());
+	parent->release();
+	engine.step(1.0f);
+	DS_CHECK_EQ(engine.getTweenline().getSpriteTweens().size(), size_t(0));
+}
+
+// 5k tweens over 1k sprites, five channels each, staggered like a grid animating on
+DS_BENCH(five_thousand_tweens){
+	const int					SPRITES = 1000;
+	ds::test::TestSpriteEngine	engine;
+	ds::ui::Sprite*				root = new ds::ui::Sprite(engine);
+	std::vector<ds::ui::Sprite*>	tiles;
+	for(int i = 0; i < SPRITES; ++i){
+		ds::ui::Sprite*			s = new ds::ui::Sprite(engine, 50.0f, 50.0f);
+		root->addChild(*s);
+		tiles.push_back(s);
+	}
+
+	ds::test::Timer				timer;
+	for(int i = 0; i < SPRITES; ++i){
+		const float				delay = 0.001f * i;
+		ds::ui::Sprite*			s = tiles[i];
+		s->tweenPosition(ci::vec3(i % 40 * 50.0f, i / 40 * 50.0f, 0.0f), 1.0f, delay, ci::EaseOutCubic());
+		s->tweenScale(ci::vec3(1.5f), 1.0f, delay, ci::EaseInOutQuad());
+		s->tweenOpacity(0.5f, 1.0f, delay, ci::EaseOutQuint());
+		s->tweenRotation(ci::vec3(0.0f, 0.0f, 45.0f), 1.0f, delay, ci::EaseInOutCubic());
+		s->tweenColor(ci::Color(0.2f, 0.4f, 0.8f), 1.0f, delay, ci::EaseOutBack());
+	}
+	ds::test::report("start 5k tweens", timer.seconds() * 1e6, "us");
+
+	const int					FRAMES = 60;
+	timer.restart();
+	for(int f = 0; f < FRAMES; ++f){
+		engine.step(1.0f / 60.0f);
+	}
+	ds::test::report("update, 5k tweens running", timer.seconds() * 1e6 / FRAMES, "us/frame");
+	ds::test::report("tweens still running", static_cast<double>(engine.getTweenline().getSpriteTweens().size()), "");
+
+	root->release();
+}
@@ -0,0 +1,144 @@
+#include "test_sprite_engine.h"
+
+#include <stdexcept>
+#include <cinder/Camera.h>
+#include <ds/params/camera_params.h>
+#include <ds/ui/sprite/sprite.h>
+#include <ds/ui/touch/touch_event.h>
+
+namespace ds {
+namespace test {
+
+namespace {
+// For the parts of the engine a headless test has no business touching
+template <typename T>
+T& not_in_tests(const char* what){
+	throw std::logic_error(std::string("TestSpriteEngine::") + what + "() isn't available in tests");
+}
+}
+
+/**
+ * \class ds::test::TestSpriteEngine
+ */
+TestSpriteEngine::TestSpriteEngine(const int mode)
+	: ds::ui::SpriteEngine(mEngineData)
+	, mMode(mode)
+	, mTimeline(ci::Timeline::create())
+	, mClockMicros(ds::time::TimerWheel::now())
+	, mTweenline(*mTimeline)
+	, mShaderService(*this)
+	, mUniqueColor(0, 0, 0)
+{
+	mEngineData.mWorldSize = ci::vec2(1920.0f, 1080.0f);
+	mEngineData.mSrcRect = ci::Rectf(0.0f, 0.0f, 1920.0f, 1080.0f);
+	mEngineData.mDstRect = mEngineData.mSrcRect;
+}
+
+TestSpriteEngine::~TestSpriteEngine(){
+}
+
+void TestSpriteEngine::update(){
+	if(mWorkManager) mWorkManager->update();
+	mAutoUpdate.update(mUpdateParams);
+	mTweenline.update();
+	mTimerWheel.advance(mClockMicros);
+	mSpriteTransforms.update();
+}
+
+void TestSpriteEngine::step(const float seconds){
+	mTimeline->stepTo(mTimeline->getCurrentTime() + seconds);
+	mClockMicros += static_cast<int64_t>(seconds * 1000000.0);
+	mUpdateParams.setDeltaTime(seconds);
+	mUpdateParams.setElapsedTime(mUpdateParams.getElapsedTime() + seconds);
+	update();
+	// A plain update() takes no time
+	mUpdateParams.setDeltaTime(0.0f);
+}
+
+ds::EventNotifier& TestSpriteEngine::getChannel(const std::string&){ return not_in_tests<ds::EventNotifier>("getChannel"); }
+ds::ResourceList& TestSpriteEngine::getResources(){ return not_in_tests<ds::ResourceList>("getResources"); }
+const ds::ColorList& TestSpriteEngine::getColors() const { return not_in_tests<const ds::ColorList>("getColors"); }
+const ds::FontList& TestSpriteEngine::getFonts() const { return not_in_tests<const ds::FontList>("getFonts"); }
+ds::ui::ThumbnailService& TestSpriteEngine::getThumbnailService(){ return not_in_tests<ds::ui::ThumbnailService>("getThumbnailService"); }
+ds::ui::PangoFontService& TestSpriteEngine::getPangoFontService(){ return not_in_tests<ds::ui::PangoFontService>("getPangoFontService"); }
+ds::ImageRegistry& TestSpriteEngine::getImageRegistry(){ return not_in_tests<ds::ImageRegistry>("getImageRegistry"); }
+
+ds::WorkManager& TestSpriteEngine::getWorkManager(){
+	if(!mWorkManager) mWorkManager.reset(new ds::WorkManager());
+	return *mWorkManager;
+}
+
+ds::net::IoReactor& TestSpriteEngine::getIoReactor(){
+	if(!mIoReactor) mIoReactor.reset(new ds::net::IoReactor());
+	return *mIoReactor;
+}
+
+ds::ui::LoadImageService& TestSpriteEngine::getLoadImageService(){
+	if(!mLoadImageService) mLoadImageService.reset(new ds::ui::LoadImageService(*this, mIpFunctions));
+	return *mLoadImageService;
+}
+
+ds::AutoUpdateList& TestSpriteEngine::getAutoUpdateList(const int){
+	return mAutoUpdate;
+}
+
+ds::sprite_id_t TestSpriteEngine::nextSpriteId(){
+	return mSprites.allocate();
+}
+
+void TestSpriteEngine::registerSprite(ds::ui::Sprite& s){
+	if(s.getId() != ds::EMPTY_SPRITE_ID) mSprites.insert(s.getId(), &s);
+}
+
+void TestSpriteEngine::unregisterSprite(ds::ui::Sprite& s){
+	if(s.getId() != ds::EMPTY_SPRITE_ID) mSprites.erase(s.getId());
+}
+
+ds::ui::Sprite* TestSpriteEngine::findSprite(const ds::sprite_id_t id){
+	return mSprites.find(id);
+}
+
+void TestSpriteEngine::spriteDeleted(const ds::sprite_id_t& id){
+	mDeleted.push_back(id);
+}
+
+void TestSpriteEngine::addTouches(const ds::ui::TouchInfo::Phase phase, const ds::ui::TouchEvent& e){
+	for(auto& it : e.getTouches()){
+		mTouches.push_back(Touch{ phase, static_cast<int>(it.getId()), it.getPos() });
+	}
+}
+
+ci::Color8u TestSpriteEngine::getUniqueColor(){
+	int32_t							i = (mUniqueColor.r << 16) | (mUniqueColor.g << 8) | mUniqueColor.b;
+	++i;
+	mUniqueColor = ci::Color8u((i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff);
+	return mUniqueColor;
+}
+
+ds::PerspCameraParams TestSpriteEngine::getPerspectiveCamera(const size_t) const { return not_in_tests<ds::PerspCameraParams>("getPerspectiveCamera"); }
+const ci::CameraPersp& TestSpriteEngine::getPerspectiveCameraRef(const size_t) const { return not_in_tests<const ci::CameraPersp>("getPerspectiveCameraRef"); }
+void TestSpriteEngine::setPerspectiveCamera(const size_t, const ds::PerspCameraParams&){ not_in_tests<int>("setPerspectiveCamera"); }
+void TestSpriteEngine::setPerspectiveCameraRef(const size_t, const ci::CameraPersp&){ not_in_tests<int>("setPerspectiveCameraRef"); }
+float TestSpriteEngine::getOrthoFarPlane(const size_t) const { return 1000.0f; }
+float TestSpriteEngine::getOrthoNearPlane(const size_t) const { return -1000.0f; }
+void TestSpriteEngine::setOrthoViewPlanes(const size_t, const float, const float){}
+
+void TestSpriteEngine::setSpriteForFinger(const int fingerId, ds::ui::Sprite* s){
+	if(s) mFingers[fingerId] = s;
+	else mFingers.erase(fingerId);
+}
+
+ds::ui::Sprite* TestSpriteEngine::getSpriteForFinger(const int fingerId){
+	auto							found = mFingers.find(fingerId);
+	return found == mFingers.end() ? nullptr : found->second;
+}
+
+void TestSpriteEngine::injectTouchesBegin(const ds::ui::TouchEvent& e){ addTouches(ds::ui::TouchInfo::Added, e); }
+void TestSpriteEngine::injectTouchesMoved(const ds::ui::TouchEvent& e){ addTouches(ds::ui::TouchInfo::Moved, e); }
+void TestSpriteEngine::injectTouchesEnded(const ds::ui::TouchEvent& e){ addTouches(ds::ui::TouchInfo::Removed, e); }
+void TestSpriteEngine::injectObjectsBegin(const ds::TuioObject&){ not_in_tests<int>("injectObjectsBegin"); }
+void TestSpriteEngine::injectObjectsMoved(const ds::TuioObject&){ not_in_tests<int>("injectObjectsMoved"); }
+void TestSpriteEngine::injectObjectsEnded(const ds::TuioObject&){ not_in_tests<int>("injectObjectsEnded"); }
+
+} // namespace test
+} // namespace ds
@@ -0,0 +1,141 @@
+#pragma once
+#ifndef DS_TEST_UNIT_TEST_SPRITE_ENGINE_H_
+#define DS_TEST_UNIT_TEST_SPRITE_ENGINE_H_
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <cinder/Timeline.h>
+#include <ds/app/auto_update_list.h>
+#include <ds/app/engine/engine_data.h>
+#include <ds/app/engine/sprite_id_table.h>
+#include <ds/cfg/settings.h>
+#include <ds/network/io_reactor.h>
+#include <ds/params/update_params.h>
+#include <ds/thread/work_manager.h>
+#include <ds/ui/ip/ip_function_list.h>
+#include <ds/ui/service/load_image_service.h>
+#include <ds/ui/service/shader_service.h>
+#include <ds/ui/sprite/sprite_engine.h>
+#include <ds/ui/sprite/util/sprite_transforms.h>
+#include <ds/ui/touch/touch_info.h>
+#include <ds/ui/tween/tweenline.h>
+
+namespace ds {
+namespace test {
+
+// Constructed before the SpriteEngine base, which keeps a reference to the data
+class TestEngineData {
+protected:
+	TestEngineData() : mEngineData(mEngineSettings) {}
+
+	ds::cfg::Settings				mEngineSettings;
+	ds::EngineData					mEngineData;
+};
+
+/**
+ * \class ds::test::TestSpriteEngine
+ * \brief Just enough of an engine to make, parent, tween and release sprites with no app,
+ * window or GL. Ids come from a SpriteIdTable like the real engine's. The WorkManager,
+ * IoReactor and LoadImageService are real, and started the first time something asks for them.
+ * Every AutoUpdate is in one list, run by update(). Injected touches are kept in mTouches
+ * instead of going to a touch manager. Services that need an app throw if a test reaches them.
+ */
+class TestSpriteEngine : private TestEngineData, public ds::ui::SpriteEngine {
+public:
+	TestSpriteEngine(const int mode = STANDALONE_MODE);
+	~TestSpriteEngine();
+
+	/// What the engine does each update: finished work, auto updates, tweens, then world transforms
+	void							update();
+	/// Move the tween timeline and the timer clock by seconds, then update with seconds as
+	/// the delta time
+	void							step(const float seconds);
+
+	size_t							getNumberOfSprites() const { return mSprites.size(); }
+	/// Every id handed to spriteDeleted(), in order, like a server's delete list
+	std::vector<ds::sprite_id_t>	mDeleted;
+
+	class Touch {
+	public:
+		ds::ui::TouchInfo::Phase	mPhase;
+		int							mId;
+		ci::vec2					mPos;
+	};
+	/// Every touch injected, in order
+	std::vector<Touch>				mTouches;
+
+	virtual ds::EventNotifier&		getChannel(const std::string&);
+	virtual ds::WorkManager&		getWorkManager();
+	virtual ds::ResourceList&		getResources();
+	virtual const ds::ColorList&	getColors() const;
+	virtual const ds::FontList&		getFonts() const;
+	virtual ds::AutoUpdateList&		getAutoUpdateList(const int = AutoUpdateType::SERVER);
+	virtual ds::ui::LoadImageService&	getLoadImageService();
+	virtual ds::ui::ThumbnailService&	getThumbnailService();
+	virtual ds::ui::PangoFontService&	getPangoFontService();
+	virtual ds::ui::ShaderService&	getShaderService() { return mShaderService; }
+	virtual ds::net::IoReactor&		getIoReactor();
+	virtual ds::ImageRegistry&		getImageRegistry();
+	virtual ds::ui::Tweenline&		getTweenline() { return mTweenline; }
+	virtual ds::ui::SpriteTransforms&	getSpriteTransforms() { return mSpriteTransforms; }
+	virtual ci::app::WindowRef		getWindow() { return nullptr; }
+
+	virtual ds::sprite_id_t			nextSpriteId();
+	virtual void					registerSprite(ds::ui::Sprite&);
+	virtual void					unregisterSprite(ds::ui::Sprite&);
+	virtual ds::ui::Sprite*			findSprite(const ds::sprite_id_t);
+	virtual void					spriteDeleted(const ds::sprite_id_t&);
+	virtual ci::Color8u				getUniqueColor();
+
+	virtual ds::PerspCameraParams	getPerspectiveCamera(const size_t index) const;
+	virtual const ci::CameraPersp&	getPerspectiveCameraRef(const size_t index) const;
+	virtual void					setPerspectiveCamera(const size_t index, const ds::PerspCameraParams&);
+	virtual void					setPerspectiveCameraRef(const size_t index, const ci::CameraPersp&);
+	virtual float					getOrthoFarPlane(const size_t index) const;
+	virtual float					getOrthoNearPlane(const size_t index) const;
+	virtual void					setOrthoViewPlanes(const size_t index, const float nearPlane, const float farPlane);
+
+	virtual void					setSpriteForFinger(const int fingerId, ds::ui::Sprite*);
+	virtual ds::ui::Sprite*			getSpriteForFinger(const int fingerId);
+
+	virtual void					injectTouchesBegin(const ds::ui::TouchEvent&);
+	virtual void					injectTouchesMoved(const ds::ui::TouchEvent&);
+	virtual void					injectTouchesEnded(const ds::ui::TouchEvent&);
+	virtual void					injectObjectsBegin(const ds::TuioObject&);
+	virtual void					injectObjectsMoved(const ds::TuioObject&);
+	virtual void					injectObjectsEnded(const ds::TuioObject&);
+
+	virtual bool					getRotateTouchesDefault() { return false; }
+	virtual ds::ui::Sprite*			getHit(const ci::vec3&) { return nullptr; }
+	virtual int						getBytesRecieved() { return 0; }
+	virtual int						getBytesSent() { return 0; }
+	virtual int						getMode() const { return mMode; }
+
+private:
+	void							addTouches(const ds::ui::TouchInfo::Phase, const ds::ui::TouchEvent&);
+
+	const int						mMode;
+	ci::TimelineRef					mTimeline;
+	// The timer wheel runs on this instead of the real clock, so step() is deterministic
+	int64_t							mClockMicros;
+	ds::ui::Tweenline				mTweenline;
+	ds::ui::SpriteTransforms		mSpriteTransforms;
+	ds::ui::ShaderService			mShaderService;
+	ds::SpriteIdTable				mSprites;
+	std::unique_ptr<ds::WorkManager>	mWorkManager;
+	std::unique_ptr<ds::net::IoReactor>	mIoReactor;
+	// After the WorkManager, its load threads are run there
+	ds::ui::ip::FunctionList		mIpFunctions;
+	std::unique_ptr<ds::ui::LoadImageService>	mLoadImageService;
+	ds::AutoUpdateList				mAutoUpdate;
+	ds::UpdateParams				mUpdateParams;
+	std::unordered_map<int, ds::ui::Sprite*>
+									mFingers;
+	ci::Color8u						mUniqueColor;
+};
+
+} // namespace test
+} // namespace ds
+
+#endif
@@ -0,0 +1,169 @@
+#include "ds_test.h"
+#include "test_sprite_engine.h"
+
+#include <chrono>
+#include <thread>
+#include <cinder/ImageIo.h>
+#include <Poco/DirectoryIterator.h>
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include <ds/ui/service/thumbnail_service.h>
+#include <ds/util/image_meta_data.h>
+#include <ds/util/scaled_jpeg.h>
+
+namespace {
+
+// Empty every time, with the cache in a folder of its own
+std::string					fresh_folder() {
+	Poco::Path				p(Poco::Path::temp());
+	p.pushDirectory("ds_thumbnail_service_test");
+	Poco::File				dir(p);
+	if(dir.exists()) dir.remove(true);
+	dir.createDirectories();
+	// Keep the tests away from the real index
+	ds::ImageMetaData::setIndexEnabled(false);
+	return p.toString();
+}
+
+void						configure(ds::test::TestSpriteEngine& engine, const std::string& folder, const std::string& levels) {
+	ds::cfg::Settings&		settings = engine.getSettings("engine");
+	settings.setRawValue("thumbnail:generate", 0, "true");
+	settings.setRawValue("thumbnail:levels", 0, levels);
+	settings.setRawValue("thumbnail:cache_folder", 0, folder + "cache");
+	settings.setRawValue("thumbnail:cache_budget_mb", 0, "0");
+}
+
+// Smooth, with some grain, so it compresses about like a photo
+std::string					write_jpeg(const std::string& path, const int w, const int h) {
+	ci::Surface8u			s(w, h, false, ci::SurfaceChannelOrder::RGB);
+	uint32_t				grain = 12345;
+	for(int y = 0; y < h; ++y) {
+		uint8_t*			row = s.getData() + y * s.getRowBytes();
+		for(int x = 0; x < w; ++x) {
+			grain = grain * 1664525u + 1013904223u;
+			const int		n = static_cast<int>(grain >> 28);
+			row[x * 3 + 0] = static_cast<uint8_t>((x * 255 / w + n) & 0xff);
+			row[x * 3 + 1] = static_cast<uint8_t>((y * 255 / h + n) & 0xff);
+			row[x * 3 + 2] = static_cast<uint8_t>(((x + y) * 127 / (w + h) + n) & 0xff);
+		}
+	}
+	ci::writeImage(path, s, ci::ImageTarget::Options().quality(0.9f), "jpg");
+	return path;
+}
+
+uint64_t					folder_bytes(const std::string& folder) {
+	uint64_t				bytes = 0;
+	Poco::DirectoryIterator	end;
+	for(Poco::DirectoryIterator it(folder); it != end; ++it) {
+		if(it->isFile()) bytes += static_cast<uint64_t>(it->getSize());
+	}
+	return bytes;
+}
+
+// Run the engine until a callback answers, like the app would
+std::string					wait_for(ds::test::TestSpriteEngine& engine, ds::ui::ThumbnailService& thumbs, const std::string& source, const float size) {
+	std::string				answer;
+	bool					answered = false;
+	thumbs.request(source, size, [&answer, &answered](const std::string& path) {
+		answer = path;
+		answered = true;
+	});
+	ds::test::Timer			timer;
+	while(!answered && timer.seconds() < 30.0) {
+		engine.update();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return answer;
+}
+
+}
+
+DS_TEST(makes_levels_and_answers_them_right_away_after){
+	const std::string		folder = fresh_folder();
+	const std::string		source = write_jpeg(folder + "photo.jpg", 2000, 1500);
+	ds::test::TestSpriteEngine	engine;
+	configure(engine, folder, "128, 512");
+	ds::ui::ThumbnailService	thumbs(engine);
+
+	const std::string		small = wait_for(engine, thumbs, source, 100.0f);
+	DS_CHECK(!small.empty() && small != source);
+	DS_CHECK_EQ(ds::ImageMetaData(small).mSize.x, 128.0f);
+	DS_CHECK_EQ(thumbs.getCacheBytes(), folder_bytes(folder + "cache"));
+
+	// Both levels came from the one decode, and are known without another look at the source
+	DS_CHECK(!thumbs.find(source, 400.0f).empty());
+	bool					immediate = false;
+	DS_CHECK_EQ(thumbs.request(source, 400.0f, [&immediate](const std::string&) { immediate = true; }), 0);
+	DS_CHECK(immediate);
+	// Bigger than every level
+	DS_CHECK_EQ(thumbs.find(source, 4000.0f), source);
+}
+
+DS_TEST(small_and_missing_sources_answer_themselves){
+	const std::string		folder = fresh_folder();
+	const std::string		source = write_jpeg(folder + "small.jpg", 300, 200);
+	ds::test::TestSpriteEngine	engine;
+	configure(engine, folder, "128, 512");
+	ds::ui::ThumbnailService	thumbs(engine);
+
+	DS_CHECK_EQ(wait_for(engine, thumbs, source, 400.0f), source);
+	DS_CHECK_EQ(wait_for(engine, thumbs, folder + "missing.jpg", 100.0f), folder + "missing.jpg");
+	DS_CHECK_EQ(thumbs.getCacheBytes(), uint64_t(0));
+}
+
+DS_TEST(a_level_made_again_is_counted_once){
+	const std::string		folder = fresh_folder();
+	const std::string		source = write_jpeg(folder + "photo.jpg", 2000, 1500);
+	std::string				small;
+	{
+		ds::test::TestSpriteEngine	engine;
+		configure(engine, folder, "128, 512");
+		ds::ui::ThumbnailService	thumbs(engine);
+		small = wait_for(engine, thumbs, source, 100.0f);
+	}
+
+	// The next run finds only the bigger level, so asking for the smaller one makes both again
+	Poco::File(small).remove();
+	ds::test::TestSpriteEngine	engine;
+	configure(engine, folder, "128, 512");
+	ds::ui::ThumbnailService	thumbs(engine);
+	const uint64_t			scanned = thumbs.getCacheBytes();
+	DS_CHECK(scanned > 0);
+	DS_CHECK_EQ(wait_for(engine, thumbs, source, 100.0f), small);
+	DS_CHECK_EQ(thumbs.getCacheBytes(), folder_bytes(folder + "cache"));
+}
+
+// A 12 megapixel photo, decoded whole and at the fraction the 1024 and 128 levels need,
+// then the time from asking for a level to having all of them on disk.
+DS_BENCH(jpeg_decode_for_levels){
+	const std::string		folder = fresh_folder();
+	const std::string		source = write_jpeg(folder + "photo.jpg", 4000, 3000);
+	const int				ROUNDS = 5;
+
+	ds::test::Timer			timer;
+	for(int i = 0; i < ROUNDS; ++i) {
+		ci::Surface8u		s(ci::loadImage(source));
+		ds::test::keep(s.getData());
+	}
+	ds::test::report("ci::loadImage", timer.seconds() * 1000.0 / ROUNDS, "ms");
+
+	ci::Surface8u			scaled;
+	if(!ds::load_scaled_jpeg(source, 1024, scaled)) {
+		ds::test::report("scaled decode unavailable, no libjpeg", 0.0, "");
+	} else {
+		timer.restart();
+		for(int i = 0; i < ROUNDS; ++i) ds::load_scaled_jpeg(source, 1024, scaled);
+		ds::test::report("scaled to cover 1024", timer.seconds() * 1000.0 / ROUNDS, "ms");
+		timer.restart();
+		for(int i = 0; i < ROUNDS; ++i) ds::load_scaled_jpeg(source, 128, scaled);
+		ds::test::report("scaled to cover 128", timer.seconds() * 1000.0 / ROUNDS, "ms");
+	}
+
+	ds::test::TestSpriteEngine	engine;
+	configure(engine, folder, "128, 256, 512, 1024");
+	ds::ui::ThumbnailService	thumbs(engine);
+	timer.restart();
+	const std::string		level = wait_for(engine, thumbs, source, 100.0f);
+	ds::test::keep(&level);
+	ds::test::report("look up, decode and write 4 levels", timer.seconds() * 1000.0, "ms");
+}
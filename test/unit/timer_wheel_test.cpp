@@ -0,0 +1,167 @@
+#include "ds_test.h"
+#include "test_sprite_engine.h"
+
+#include <random>
+#include <ds/time/timer_wheel.h>
+#include <ds/ui/sprite/sprite.h>
+
+namespace {
+
+typedef ds::time::TimerWheel	Wheel;
+
+const int64_t					START = 1000000;
+const int64_t					MS = 1000;
+
+}
+
+DS_TEST(fires_when_due_and_not_before){
+	Wheel						wheel(START);
+	int							fired = 0;
+	wheel.schedule(START + 50 * MS, [&fired]{ ++fired; });
+
+	DS_CHECK_EQ(wheel.advance(START + 49 * MS), size_t(0));
+	DS_CHECK_EQ(wheel.advance(START + 50 * MS), size_t(1));
+	DS_CHECK_EQ(fired, 1);
+	DS_CHECK_EQ(wheel.size(), size_t(0));
+}
+
+DS_TEST(far_timers_cascade_down){
+	Wheel						wheel(START);
+	std::vector<int64_t>		due = { 3 * MS, 70 * MS, 5000 * MS, 300000 * MS, 20000000 * MS };
+	std::vector<int64_t>		firedAt;
+	int64_t						now = START;
+	for(auto d : due) wheel.schedule(START + d, [&firedAt, &now]{ firedAt.push_back(now); });
+
+	while(firedAt.size() < due.size() && now < START + due.back() + MS){
+		// Big uneven steps, the wheel has to catch up through the levels
+		now += 997 * MS;
+		wheel.advance(now);
+	}
+	DS_CHECK_EQ(firedAt.size(), due.size());
+	for(size_t i = 0; i < due.size(); ++i){
+		DS_CHECK(firedAt[i] >= START + due[i]);
+		DS_CHECK(firedAt[i] < START + due[i] + 997 * MS);
+	}
+}
+
+DS_TEST(repeats_until_cancelled_from_inside){
+	Wheel						wheel(START);
+	int							fired = 0;
+	Wheel::Handle				h = 0;
+	h = wheel.schedule(START + 10 * MS, [&]{ if(++fired == 3) wheel.cancel(h); }, 10 * MS);
+
+	for(int64_t t = START; t <= START + 100 * MS; t += MS) wheel.advance(t);
+	DS_CHECK_EQ(fired, 3);
+	DS_CHECK(!wheel.isPending(h));
+}
+
+DS_TEST(stale_handles_dont_cancel_reused_nodes){
+	Wheel						wheel(START);
+	const Wheel::Handle			first = wheel.schedule(START + MS, []{});
+	wheel.advance(START + MS);
+
+	int							fired = 0;
+	const Wheel::Handle			second = wheel.schedule(START + 2 * MS, [&fired]{ ++fired; });
+	DS_CHECK(first != second);
+	DS_CHECK(!wheel.cancel(first));
+	wheel.advance(START + 2 * MS);
+	DS_CHECK_EQ(fired, 1);
+}
+
+DS_TEST(sprite_release_cancels_its_timers){
+	ds::test::TestSpriteEngine	engine;
+	ds::ui::Sprite*				s = new ds::ui::Sprite(engine);
+	int							once = 0, repeated = 0;
+	s->timedCallback([&once]{ ++once; }, 0.5);
+	s->repeatedCallback([&repeated]{ ++repeated; }, 0.1);
+	DS_CHECK_EQ(engine.getTimerWheel().size(), size_t(2));
+
+	engine.step(0.25f);
+	DS_CHECK_EQ(repeated, 2);
+	s->release();
+	DS_CHECK_EQ(engine.getTimerWheel().size(), size_t(0));
+
+	engine.step(1.0f);
+	DS_CHECK_EQ(once, 0);
+	DS_CHECK_EQ(repeated, 2);
+}
+
+DS_TEST(sprite_released_from_its_own_timer){
+	ds::test::TestSpriteEngine	engine;
+	ds::ui::Sprite*				parent = new ds::ui::Sprite(engine);
+	ds::ui::Sprite*				child = new ds::ui::Sprite(engine);
+	parent->addChild(*child);
+
+	int							fired = 0;
+	child->repeatedCallback([&]{ ++fired; child->release(); }, 0.1);
+	child->timedCallback([&fired]{ fired += 100; }, 0.1);
+
+	engine.step(0.1f);
+	DS_CHECK_EQ(fired, 1);
+	DS_CHECK(parent->getChildren().empty());
+	DS_CHECK_EQ(engine.getTimerWheel().size(), size_t(0));
+
+	engine.step(1.0f);
+	DS_CHECK_EQ(fired, 1);
+	parent->release();
+	DS_CHECK_EQ(engine.getNumberOfSprites(), size_t(0));
+}
+
+DS_TEST(cancelling_one_sprite_timer_keeps_the_rest){
+	ds::test::TestSpriteEngine	engine;
+	ds::ui::Sprite*				s = new ds::ui::Sprite(engine);
+	int							a = 0, b = 0;
+	const size_t				id = s->timedCallback([&a]{ ++a; }, 0.2);
+	s->timedCallback([&b]{ ++b; }, 0.2);
+	s->cancelTimedCallback(id);
+
+	engine.step(0.3f);
+	DS_CHECK_EQ(a, 0);
+	DS_CHECK_EQ(b, 1);
+
+	s->repeatedCallback([&b]{ ++b; }, 0.1);
+	s->cancelAllTimedCallbacks();
+	engine.step(0.3f);
+	DS_CHECK_EQ(b, 1);
+	s->release();
+}
+
+// 10k idle timers spread over ten minutes, advanced a frame at a time. The per-frame cost
+// should stay flat however many are pending, unlike polling each one.
+DS_BENCH(ten_thousand_pending_timers){
+	const int					COUNT = 10000;
+	const int64_t				FRAME = 16667;
+	std::mt19937				rng(32);
+	std::uniform_int_distribution<int64_t>
+								due(MS, 600000 * MS);
+
+	Wheel						wheel(START);
+	std::vector<Wheel::Handle>	handles(COUNT);
+	size_t						fired = 0;
+
+	ds::test::Timer				timer;
+	for(int i = 0; i < COUNT; ++i){
+		handles[i] = wheel.schedule(START + due(rng), [&fired]{ ++fired; });
+	}
+	ds::test::report("schedule 10k", timer.seconds() * 1e9 / COUNT, "ns/timer");
+
+	// Idle frames with nothing due
+	Wheel						idle(START);
+	for(int i = 0; i < COUNT; ++i) idle.schedule(START + 3600000 * MS + due(rng), []{});
+	const int					FRAMES = 3600;
+	timer.restart();
+	for(int f = 1; f <= FRAMES; ++f) idle.advance(START + f * FRAME);
+	ds::test::report("advance, 10k pending, none due", timer.seconds() * 1e9 / FRAMES, "ns/frame");
+
+	// A minute of frames, firing whatever's due
+	timer.restart();
+	for(int f = 1; f <= FRAMES; ++f) wheel.advance(START + f * FRAME);
+	ds::test::report("advance, 10k pending, firing", timer.seconds() * 1e9 / FRAMES, "ns/frame");
+
+	timer.restart();
+	for(int i = 0; i < COUNT; ++i) wheel.cancel(handles[i]);
+	ds::test::report("cancel 10k", timer.seconds() * 1e9 / COUNT, "ns/timer");
+
+	DS_CHECK_EQ(wheel.size(), size_t(0));
+	ds::test::keep(&fired);
+}
@@ -0,0 +1,208 @@
+#include "ds_test.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+#include <osc/OscOutboundPacketStream.h>
+#include <ds/ui/touch/tuio_ingest.h>
+
+namespace {
+
+typedef ds::ui::TuioIngest	Ingest;
+
+// Only allocations on a thread that turned counting on
+thread_local bool			COUNT_ALLOCATIONS = false;
+std::atomic<uint64_t>		ALLOCATIONS(0);
+
+// A TUIO 1.1 bundle the way trackers send them: alive, the sets, then fseq
+class Packet {
+public:
+	struct Set {
+		int32_t				mId;
+		float				mX, mY;
+	};
+
+	size_t					build(const std::vector<int32_t>& alive, const std::vector<Set>& sets, const int32_t fseq){
+		::osc::OutboundPacketStream	p(mBuffer, sizeof(mBuffer));
+		p << ::osc::BeginBundleImmediate;
+		p << ::osc::BeginMessage("/tuio/2Dcur") << "alive";
+		for(auto id : alive) p << static_cast<::osc::int32>(id);
+		p << ::osc::EndMessage;
+		for(auto& s : sets){
+			p << ::osc::BeginMessage("/tuio/2Dcur") << "set" << static_cast<::osc::int32>(s.mId) << s.mX << s.mY << 0.0f << 0.0f << 0.0f << ::osc::EndMessage;
+		}
+		p << ::osc::BeginMessage("/tuio/2Dcur") << "fseq" << static_cast<::osc::int32>(fseq) << ::osc::EndMessage;
+		p << ::osc::EndBundle;
+		return p.Size();
+	}
+
+	void					send(Ingest& ingest, const uint32_t source, const std::vector<int32_t>& alive, const std::vector<Set>& sets, const int32_t fseq){
+		const size_t		size = build(alive, sets, fseq);
+		ingest.ingest(mBuffer, size, source, Ingest::now());
+	}
+
+	char					mBuffer[Ingest::MAX_DATAGRAM];
+};
+
+const uint32_t				SOURCE_A = 0x0100007f;
+const uint32_t				SOURCE_B = 0x0200007f;
+
+std::vector<Ingest::Cursor> drain_cursors(Ingest& ingest){
+	std::vector<Ingest::Cursor>	out;
+	ingest.drain([&out](const Ingest::Frame& f){
+		for(int i = 0; i < f.mNumCursors; ++i) out.push_back(f.mCursors[i]);
+	});
+	return out;
+}
+
+}
+
+void* operator new(std::size_t size) {
+	if(COUNT_ALLOCATIONS) ++ALLOCATIONS;
+	if(void* p = std::malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+	std::free(p);
+}
+
+DS_TEST(first_source_keeps_session_ids){
+	Ingest					ingest;
+	Packet					p;
+	p.send(ingest, SOURCE_A, { 7 }, { { 7, 0.25f, 0.5f } }, 1);
+
+	const auto				cursors = drain_cursors(ingest);
+	DS_CHECK_EQ(cursors.size(), size_t(1));
+	DS_CHECK_EQ(cursors[0].mPhase, Ingest::Cursor::BEGAN);
+	DS_CHECK_EQ(cursors[0].mTouchId, 7u);
+	DS_CHECK_NEAR(cursors[0].mX, 0.25f, 1e-6);
+}
+
+DS_TEST(same_session_id_on_two_sources_is_two_touches){
+	Ingest					ingest;
+	Packet					p;
+	p.send(ingest, SOURCE_A, { 1 }, { { 1, 0.1f, 0.1f } }, 1);
+	p.send(ingest, SOURCE_B, { 1 }, { { 1, 0.9f, 0.9f } }, 1);
+
+	auto					cursors = drain_cursors(ingest);
+	DS_CHECK_EQ(cursors.size(), size_t(2));
+	DS_CHECK_EQ(cursors[0].mSessionId, cursors[1].mSessionId);
+	DS_CHECK(cursors[0].mTouchId != cursors[1].mTouchId);
+	const uint32_t			touchA = cursors[0].mTouchId, touchB = cursors[1].mTouchId;
+
+	// Moving one doesn't move the other, lifting one doesn't lift the other
+	p.send(ingest, SOURCE_A, { 1 }, { { 1, 0.2f, 0.2f } }, 2);
+	p.send(ingest, SOURCE_B, {}, {}, 2);
+	cursors = drain_cursors(ingest);
+	DS_CHECK_EQ(cursors.size(), size_t(2));
+	DS_CHECK_EQ(cursors[0].mTouchId, touchA);
+	DS_CHECK_EQ(cursors[0].mPhase, Ingest::Cursor::MOVED);
+	DS_CHECK_NEAR(cursors[0].mPrevX, 0.1f, 1e-6);
+	DS_CHECK_EQ(cursors[1].mTouchId, touchB);
+	DS_CHECK_EQ(cursors[1].mPhase, Ingest::Cursor::ENDED);
+
+	p.send(ingest, SOURCE_A, {}, {}, 3);
+	cursors = drain_cursors(ingest);
+	DS_CHECK_EQ(cursors.size(), size_t(1));
+	DS_CHECK_EQ(cursors[0].mTouchId, touchA);
+	DS_CHECK_EQ(cursors[0].mPhase, Ingest::Cursor::ENDED);
+}
+
+DS_TEST(touch_ids_stay_apart_for_large_session_ids){
+	// The session id is masked into the low bits, the source still has to tell them apart
+	DS_CHECK(Ingest::touchIdOf(0, 5) != Ingest::touchIdOf(1, 5));
+	DS_CHECK(Ingest::touchIdOf(0, 0x01000005) != Ingest::touchIdOf(1, 5));
+	DS_CHECK_EQ(Ingest::touchIdOf(0, 123456), 123456u);
+}
+
+DS_TEST(stale_frames_are_dropped_and_restarts_accepted){
+	Ingest					ingest;
+	Packet					p;
+	p.send(ingest, SOURCE_A, { 1 }, { { 1, 0.1f, 0.1f } }, 100);
+	p.send(ingest, SOURCE_A, { 1 }, { { 1, 0.5f, 0.5f } }, 99);
+	auto					cursors = drain_cursors(ingest);
+	DS_CHECK_EQ(cursors.size(), size_t(1));
+
+	// Far enough back to be a tracker that restarted
+	p.send(ingest, SOURCE_A, { 1 }, { { 1, 0.6f, 0.6f } }, 1);
+	cursors = drain_cursors(ingest);
+	DS_CHECK_EQ(cursors.size(), size_t(1));
+	DS_CHECK_EQ(cursors[0].mPhase, Ingest::Cursor::MOVED);
+	DS_CHECK_NEAR(cursors[0].mX, 0.6f, 1e-6);
+}
+
+DS_TEST(garbage_is_ignored){
+	Ingest					ingest;
+	ingest.ingest("not osc at all", 14, SOURCE_A, 0);
+	DS_CHECK_EQ(ingest.drain(nullptr), size_t(0));
+	DS_CHECK_EQ(ingest.getDatagramCount(), uint64_t(1));
+}
+
+DS_BENCH(replay_ten_finger_session){
+	// A recorded-style session: ten fingers down on two trackers, moving every frame
+	const int				frames = 20000;
+	const int				fingers = 10;
+	Packet					p;
+	std::vector<std::string>	datagrams;
+	std::vector<uint32_t>	sources;
+	for(int f = 0; f < frames; ++f){
+		for(const uint32_t source : { SOURCE_A, SOURCE_B }){
+			std::vector<int32_t>	alive;
+			std::vector<Packet::Set>	sets;
+			for(int i = 0; i < fingers; ++i){
+				alive.push_back(1000 + i);
+				sets.push_back(Packet::Set{ 1000 + i, (i + 0.5f) / fingers, static_cast<float>(f % 1000) / 1000.0f });
+			}
+			datagrams.push_back(std::string(p.mBuffer, p.build(alive, sets, f + 1)));
+			sources.push_back(source);
+		}
+	}
+
+	Ingest					ingest;
+	size_t					cursors = 0;
+	// From the datagram being handed to the ingest to its frame coming off the ring
+	std::vector<int64_t>	latencies;
+	latencies.reserve(datagrams.size());
+	const std::function<void(const Ingest::Frame&)>	onFrame = [&cursors, &latencies](const Ingest::Frame& f){
+		cursors += static_cast<size_t>(f.mNumCursors);
+		latencies.push_back(Ingest::now() - f.mReceivedNs);
+	};
+
+	const uint64_t			allocated = ALLOCATIONS;
+	COUNT_ALLOCATIONS = true;
+	ds::test::Timer			timer;
+	for(size_t i = 0; i < datagrams.size(); ++i){
+		ingest.ingest(datagrams[i].data(), datagrams[i].size(), sources[i], Ingest::now());
+		// Drain like the main thread would, about once a frame
+		if(i % 16 == 15) ingest.drain(onFrame);
+	}
+	ingest.drain(onFrame);
+	const double			seconds = timer.seconds();
+	COUNT_ALLOCATIONS = false;
+	const uint64_t			allocations = ALLOCATIONS - allocated;
+
+	DS_CHECK_EQ(ingest.getDroppedFrames(), uint64_t(0));
+	DS_CHECK_EQ(cursors, datagrams.size() * fingers);
+	DS_CHECK_EQ(latencies.size(), datagrams.size());
+	DS_CHECK_EQ(allocations, uint64_t(0));
+
+	std::sort(latencies.begin(), latencies.end());
+	ds::test::report("parse + publish, per datagram", seconds * 1e9 / datagrams.size(), "ns");
+	ds::test::report("per cursor", seconds * 1e9 / cursors, "ns");
+	ds::test::report("datagrams per second", datagrams.size() / seconds, "/s");
+	ds::test::report("allocations during the replay", static_cast<double>(allocations), "");
+	ds::test::report("arrival to ring pop, median", latencies[latencies.size() / 2] / 1000.0, "us");
+	ds::test::report("arrival to ring pop, p99", latencies[latencies.size() * 99 / 100] / 1000.0, "us");
+	ds::test::report("arrival to ring pop, max", latencies.back() / 1000.0, "us");
+}
@@ -0,0 +1,214 @@
+#include "ds_test.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include <gstreamer/video_meta_cache.h>
+
+namespace {
+
+typedef ds::ui::VideoMetaCache	Cache;
+
+// Each test gets its own sqlite file, so nothing is cached from a run before
+const std::string			CACHE_NAME = "video_meta_cache_test";
+
+// Empty every time
+std::string					fresh_folder() {
+	Poco::Path				p(Poco::Path::temp());
+	p.pushDirectory("ds_video_meta_cache_test");
+	Poco::File				dir(p);
+	if(dir.exists()) dir.remove(true);
+	dir.createDirectories();
+
+	Poco::Path				db(Poco::Path::home());
+	db.append("documents").append("downstream").append("cache").append("video").append(CACHE_NAME + ".sqlite");
+	Poco::File				dbFile(db);
+	if(dbFile.exists()) dbFile.remove();
+	return p.toString();
+}
+
+// A clip from videotestsrc. False if gst-launch-1.0 isn't on the path.
+bool						make_clip(const std::string& path, const int width, const int height, const int frames) {
+	std::stringstream		ss;
+	ss << "gst-launch-1.0 -q videotestsrc num-buffers=" << frames
+		<< " ! video/x-raw,width=" << width << ",height=" << height << ",framerate=30/1"
+		<< " ! jpegenc ! avimux ! filesink location=\"" << path << "\"";
+	return std::system(ss.str().c_str()) == 0 && Poco::File(path).exists();
+}
+
+bool						make_tone(const std::string& path) {
+	const std::string		cmd = "gst-launch-1.0 -q audiotestsrc num-buffers=50 ! wavenc ! filesink location=\"" + path + "\"";
+	return std::system(cmd.c_str()) == 0 && Poco::File(path).exists();
+}
+
+// Run the cache the way GstVideo does, an update each frame, until the condition is met
+template <typename T>
+bool						run_until(Cache& cache, const T& done) {
+	ds::test::Timer			timer;
+	while(!done() && timer.seconds() < 30.0) {
+		cache.update();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return done();
+}
+
+}
+
+DS_TEST(probes_answer_from_update_then_right_away){
+	const std::string		folder = fresh_folder();
+	const std::string		clip = folder + "bars.avi";
+	if(!make_clip(clip, 320, 240, 60)) {
+		ds::test::report("skipped, no gst-launch-1.0", 0.0, "");
+		return;
+	}
+
+	Cache					cache(CACHE_NAME);
+	DS_CHECK(!cache.hasValues(clip));
+	Cache::Entry			answer;
+	int						calls = 0;
+	const Cache::RequestId	id = cache.probeAsync(clip, [&answer, &calls](const Cache::Entry& e) { answer = e; ++calls; });
+	// Never from probeAsync() itself when the file isn't cached
+	DS_CHECK(id > 0);
+	DS_CHECK_EQ(calls, 0);
+	DS_CHECK_EQ(cache.getPendingCount(), size_t(1));
+
+	DS_CHECK(run_until(cache, [&calls]() { return calls > 0; }));
+	DS_CHECK_EQ(answer.mType, Cache::VIDEO_ONLY_TYPE);
+	DS_CHECK_EQ(answer.mWidth, 320);
+	DS_CHECK_EQ(answer.mHeight, 240);
+	DS_CHECK_NEAR(answer.mDuration, 2.0, 0.1);
+	DS_CHECK_EQ(cache.getPendingCount(), size_t(0));
+	DS_CHECK(cache.hasValues(clip));
+
+	// Cached now, so the answer comes before probeAsync() returns
+	DS_CHECK_EQ(cache.probeAsync(clip, [&calls](const Cache::Entry&) { ++calls; }), 0);
+	DS_CHECK_EQ(calls, 2);
+
+	const std::string		tone = folder + "tone.wav";
+	if(make_tone(tone)) {
+		Cache::Entry		audio;
+		cache.probeAsync(tone, [&audio](const Cache::Entry& e) { audio = e; });
+		DS_CHECK(run_until(cache, [&audio]() { return !audio.mPath.empty(); }));
+		DS_CHECK_EQ(audio.mType, Cache::AUDIO_ONLY_TYPE);
+	}
+
+	Cache::Entry			missing;
+	cache.probeAsync(folder + "missing.avi", [&missing](const Cache::Entry& e) { missing = e; });
+	DS_CHECK(run_until(cache, [&missing]() { return !missing.mPath.empty(); }));
+	DS_CHECK_EQ(missing.mType, Cache::ERROR_TYPE);
+	DS_CHECK(!cache.hasValues(folder + "missing.avi"));
+}
+
+// What a GstVideo that's destroyed or given another file before its probe is done relies on
+DS_TEST(requests_for_one_file_share_a_probe_and_can_be_cancelled){
+	const std::string		folder = fresh_folder();
+	const std::string		clip = folder + "bars.avi";
+	if(!make_clip(clip, 320, 240, 30)) {
+		ds::test::report("skipped, no gst-launch-1.0", 0.0, "");
+		return;
+	}
+
+	Cache					cache(CACHE_NAME);
+	int						first = 0, second = 0, third = 0;
+	const Cache::RequestId	a = cache.probeAsync(clip, [&first](const Cache::Entry&) { ++first; });
+	const Cache::RequestId	b = cache.probeAsync(clip, [&second](const Cache::Entry&) { ++second; });
+	cache.probeAsync(clip, [&third](const Cache::Entry&) { ++third; });
+	DS_CHECK(a != b);
+	DS_CHECK_EQ(cache.getPendingCount(), size_t(1));
+	cache.cancelProbe(b);
+
+	DS_CHECK(run_until(cache, [&first, &third]() { return first > 0 && third > 0; }));
+	DS_CHECK_EQ(first, 1);
+	DS_CHECK_EQ(second, 0);
+	DS_CHECK_EQ(third, 1);
+	// The cancelled request's probe was still cached
+	DS_CHECK(cache.hasValues(clip));
+}
+
+DS_TEST(a_replaced_file_is_probed_again_and_a_new_cache_loads_the_answers){
+	const std::string		folder = fresh_folder();
+	const std::string		clip = folder + "bars.avi";
+	if(!make_clip(clip, 320, 240, 30)) {
+		ds::test::report("skipped, no gst-launch-1.0", 0.0, "");
+		return;
+	}
+
+	{
+		Cache				cache(CACHE_NAME);
+		bool				done = false;
+		cache.probeAsync(clip, [&done](const Cache::Entry&) { done = true; });
+		DS_CHECK(run_until(cache, [&done]() { return done; }));
+	}
+
+	// Written back when the first cache went away
+	Cache					cache(CACHE_NAME);
+	DS_CHECK(cache.hasValues(clip));
+
+	DS_CHECK(make_clip(clip, 640, 360, 45));
+	DS_CHECK(!cache.hasValues(clip));
+	Cache::Entry			answer;
+	cache.probeAsync(clip, [&answer](const Cache::Entry& e) { answer = e; });
+	DS_CHECK(run_until(cache, [&answer]() { return !answer.mPath.empty(); }));
+	DS_CHECK_EQ(answer.mWidth, 640);
+	DS_CHECK_EQ(answer.mHeight, 360);
+}
+
+// How long the main thread is held up loading a playlist of clips the cache hasn't seen,
+// probing each one in place the way GstVideo used to, next to queueing them all and
+// taking the answers from update()
+DS_BENCH(main_thread_cost_of_new_clips){
+	const std::string		folder = fresh_folder();
+	const int				CLIPS = 8;
+	std::vector<std::string>	clips;
+	for(int i = 0; i < CLIPS * 2; ++i) {
+		std::stringstream	ss;
+		ss << folder << "clip_" << i << ".avi";
+		if(!make_clip(ss.str(), 640, 360, 30)) {
+			ds::test::report("skipped, no gst-launch-1.0", 0.0, "");
+			return;
+		}
+		clips.push_back(ss.str());
+	}
+
+	Cache					cache(CACHE_NAME);
+	ds::test::Timer			timer;
+	double					worst = 0.0;
+	for(int i = 0; i < CLIPS; ++i) {
+		Cache::Type			type;
+		int					w = 0, h = 0;
+		double				duration = 0.0;
+		std::string			colorSpace;
+		ds::test::Timer		one;
+		cache.getValues(clips[i], type, w, h, duration, colorSpace);
+		worst = std::max(worst, one.seconds());
+	}
+	ds::test::report("getValues, all 8 clips", timer.seconds() * 1000.0, "ms");
+	ds::test::report("getValues, longest frame", worst * 1000.0, "ms");
+
+	int						answered = 0;
+	double					blocked = 0.0;
+	worst = 0.0;
+	timer.restart();
+	for(int i = CLIPS; i < CLIPS * 2; ++i) {
+		ds::test::Timer		one;
+		cache.probeAsync(clips[i], [&answered](const Cache::Entry&) { ++answered; });
+		blocked += one.seconds();
+		worst = std::max(worst, one.seconds());
+	}
+	while(answered < CLIPS && timer.seconds() < 60.0) {
+		ds::test::Timer		one;
+		cache.update();
+		blocked += one.seconds();
+		worst = std::max(worst, one.seconds());
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	ds::test::report("probeAsync, all 8 answered", timer.seconds() * 1000.0, "ms");
+	ds::test::report("probeAsync, main thread time", blocked * 1000.0, "ms");
+	ds::test::report("probeAsync, longest frame", worst * 1000.0, "ms");
+}
@@ -0,0 +1,245 @@
+#include "ds_test.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <private/web_paint_buffer.h>
+
+namespace {
+
+typedef ds::web::WebPaintBuffer	PaintBuffer;
+
+// Stands in for CEF: the whole page, with areas of it redrawn a paint at a time
+class Page {
+public:
+	Page(const int w, const int h) : mWidth(w), mHeight(h), mPixels(static_cast<size_t>(w) * h * 4, 0), mSeed(12345) {}
+
+	void					fill(const ci::Area& a, const uint8_t value) {
+		for(int y = a.y1; y < a.y2; ++y) {
+			memset(mPixels.data() + (static_cast<size_t>(y) * mWidth + a.x1) * 4, value, static_cast<size_t>(a.getWidth()) * 4);
+		}
+	}
+
+	// Somewhere inside the page, sometimes hanging off the edge
+	ci::Area				randomArea() {
+		const int			x = next() % (mWidth + 20) - 10;
+		const int			y = next() % (mHeight + 20) - 10;
+		return ci::Area(x, y, x + 1 + next() % (mWidth / 2), y + 1 + next() % (mHeight / 2));
+	}
+
+	int						next() {
+		mSeed = mSeed * 1664525u + 1013904223u;
+		return static_cast<int>(mSeed >> 8);
+	}
+
+	const int				mWidth;
+	const int				mHeight;
+	std::vector<uint8_t>	mPixels;
+	uint32_t				mSeed;
+};
+
+// Stands in for the texture: only the areas swap() answers are uploaded to it
+class Texture {
+public:
+	Texture(const int w, const int h) : mWidth(w), mPixels(static_cast<size_t>(w) * h * 4, 0) {}
+
+	bool					update(PaintBuffer& buffer) {
+		std::vector<ci::Area>	dirty;
+		if(!buffer.swap(dirty)) return false;
+		mLastDirty = dirty;
+		for(auto& it : dirty) {
+			PaintBuffer::copyArea(buffer.getFront(), mPixels.data(), mWidth, it);
+		}
+		return true;
+	}
+
+	const int				mWidth;
+	std::vector<uint8_t>	mPixels;
+	std::vector<ci::Area>	mLastDirty;
+};
+
+bool						any_overlap(const std::vector<ci::Area>& list) {
+	for(size_t i = 0; i < list.size(); ++i) {
+		for(size_t k = i + 1; k < list.size(); ++k) {
+			const ci::Area&	a = list[i];
+			const ci::Area&	b = list[k];
+			if(a.x1 < b.x2 && b.x1 < a.x2 && a.y1 < b.y2 && b.y1 < a.y2) return true;
+		}
+	}
+	return false;
+}
+
+}
+
+DS_TEST(the_first_paint_after_a_resize_is_copied_whole){
+	PaintBuffer				buffer;
+	DS_CHECK(!buffer.hasSize());
+	buffer.resize(64, 48);
+	Page					page(64, 48);
+	Texture					texture(64, 48);
+	page.fill(ci::Area(0, 0, 64, 48), 7);
+	page.fill(ci::Area(10, 10, 20, 20), 200);
+
+	// CEF only says a corner changed, but nothing has been copied yet
+	buffer.paint(page.mPixels.data(), 64, 48, { ci::Area(10, 10, 20, 20) });
+	DS_CHECK(texture.update(buffer));
+	DS_CHECK_EQ(texture.mLastDirty.size(), size_t(1));
+	DS_CHECK(texture.mLastDirty[0] == ci::Area(0, 0, 64, 48));
+	DS_CHECK(texture.mPixels == page.mPixels);
+	DS_CHECK(!texture.update(buffer));
+
+	// No rects means the whole page too
+	page.fill(ci::Area(0, 0, 64, 48), 9);
+	buffer.paint(page.mPixels.data(), 64, 48, std::vector<ci::Area>());
+	DS_CHECK(texture.update(buffer));
+	DS_CHECK(texture.mPixels == page.mPixels);
+}
+
+DS_TEST(overlapping_rects_are_merged_and_nothing_is_missed){
+	PaintBuffer				buffer;
+	buffer.resize(100, 80);
+	Page					page(100, 80);
+	Texture					texture(100, 80);
+	buffer.paint(page.mPixels.data(), 100, 80, std::vector<ci::Area>());
+	texture.update(buffer);
+
+	// Two overlapping in one paint, a third overlapping the second in the next, one apart
+	page.fill(ci::Area(10, 10, 40, 30), 1);
+	page.fill(ci::Area(30, 20, 60, 50), 2);
+	buffer.paint(page.mPixels.data(), 100, 80, { ci::Area(10, 10, 40, 30), ci::Area(30, 20, 60, 50) });
+	page.fill(ci::Area(55, 45, 70, 60), 3);
+	page.fill(ci::Area(80, 0, 90, 5), 4);
+	buffer.paint(page.mPixels.data(), 100, 80, { ci::Area(55, 45, 70, 60), ci::Area(80, 0, 90, 5) });
+	DS_CHECK(texture.update(buffer));
+	DS_CHECK_EQ(texture.mLastDirty.size(), size_t(2));
+	DS_CHECK(!any_overlap(texture.mLastDirty));
+	DS_CHECK(texture.mPixels == page.mPixels);
+
+	// Past the edges is clipped, wholly outside is nothing
+	page.fill(ci::Area(90, 70, 100, 80), 5);
+	buffer.paint(page.mPixels.data(), 100, 80, { ci::Area(90, 70, 140, 120), ci::Area(200, 200, 210, 210) });
+	DS_CHECK(texture.update(buffer));
+	DS_CHECK_EQ(texture.mLastDirty.size(), size_t(1));
+	DS_CHECK(texture.mLastDirty[0] == ci::Area(90, 70, 100, 80));
+	buffer.paint(page.mPixels.data(), 100, 80, { ci::Area(200, 200, 210, 210) });
+	DS_CHECK(!texture.update(buffer));
+}
+
+// Each of the three frames falls behind in turn, skipped swaps and all
+DS_TEST(random_paints_and_swaps_keep_the_texture_right){
+	PaintBuffer				buffer;
+	buffer.resize(120, 90);
+	Page					page(120, 90);
+	Texture					texture(120, 90);
+	buffer.paint(page.mPixels.data(), 120, 90, std::vector<ci::Area>());
+
+	for(int round = 0; round < 2000; ++round) {
+		std::vector<ci::Area>	dirty;
+		const int			count = 1 + page.next() % 4;
+		for(int i = 0; i < count; ++i) {
+			ci::Area		a = page.randomArea();
+			dirty.push_back(a);
+			a.clipBy(ci::Area(0, 0, 120, 90));
+			if(a.getWidth() > 0 && a.getHeight() > 0) page.fill(a, static_cast<uint8_t>(round));
+		}
+		buffer.paint(page.mPixels.data(), 120, 90, dirty);
+
+		if(page.next() % 3 == 0) {
+			texture.update(buffer);
+			DS_CHECK(!any_overlap(texture.mLastDirty));
+			DS_CHECK(texture.mLastDirty.size() <= PaintBuffer::MAX_DIRTY_RECTS);
+			DS_CHECK(texture.mPixels == page.mPixels);
+		}
+	}
+	texture.update(buffer);
+	DS_CHECK(texture.mPixels == page.mPixels);
+}
+
+DS_TEST(a_resize_between_paints_drops_the_old_size){
+	PaintBuffer				buffer;
+	buffer.resize(64, 48);
+	Page					small(64, 48);
+	small.fill(ci::Area(0, 0, 64, 48), 3);
+	buffer.paint(small.mPixels.data(), 64, 48, std::vector<ci::Area>());
+
+	// Painted, but resized before the swap
+	buffer.resize(80, 60);
+	DS_CHECK_EQ(buffer.getWidth(), 80);
+	std::vector<ci::Area>	dirty;
+	DS_CHECK(!buffer.swap(dirty));
+	// CEF still painting at the old size
+	buffer.paint(small.mPixels.data(), 64, 48, { ci::Area(0, 0, 8, 8) });
+	DS_CHECK(!buffer.swap(dirty));
+
+	Page					big(80, 60);
+	Texture					texture(80, 60);
+	big.fill(ci::Area(0, 0, 80, 60), 11);
+	big.fill(ci::Area(5, 5, 9, 9), 12);
+	buffer.paint(big.mPixels.data(), 80, 60, { ci::Area(5, 5, 9, 9) });
+	DS_CHECK(texture.update(buffer));
+	DS_CHECK(texture.mPixels == big.mPixels);
+
+	buffer.resize(0, 0);
+	DS_CHECK(buffer.getFront() == nullptr);
+	buffer.paint(big.mPixels.data(), 80, 60, std::vector<ci::Area>());
+	DS_CHECK(!buffer.swap(dirty));
+}
+
+// CEF painting on its own thread while the main thread swaps and uploads
+DS_TEST(painting_and_swapping_at_once){
+	PaintBuffer				buffer;
+	buffer.resize(160, 120);
+	Page					page(160, 120);
+	Texture					texture(160, 120);
+	std::atomic<bool>		painting(true);
+
+	std::thread				cef([&buffer, &page, &painting]() {
+		buffer.paint(page.mPixels.data(), 160, 120, std::vector<ci::Area>());
+		for(int round = 0; round < 3000; ++round) {
+			ci::Area		a = page.randomArea();
+			const ci::Area	painted(a);
+			a.clipBy(ci::Area(0, 0, 160, 120));
+			if(a.getWidth() > 0 && a.getHeight() > 0) page.fill(a, static_cast<uint8_t>(round));
+			buffer.paint(page.mPixels.data(), 160, 120, { painted });
+		}
+		painting = false;
+	});
+	while(painting) {
+		texture.update(buffer);
+	}
+	cef.join();
+
+	texture.update(buffer);
+	DS_CHECK(texture.mPixels == page.mPixels);
+}
+
+// A 1080p page with a cursor blinking, a small area, and with a whole page scrolling.
+// The main thread's share is only the swap, the copies are all on the painting thread.
+DS_BENCH(paint_and_swap_1080p){
+	const int				W = 1920, H = 1080, ROUNDS = 200;
+	PaintBuffer				buffer;
+	buffer.resize(W, H);
+	Page					page(W, H);
+	buffer.paint(page.mPixels.data(), W, H, std::vector<ci::Area>());
+	std::vector<ci::Area>	dirty;
+	buffer.swap(dirty);
+
+	const std::vector<ci::Area>	cursor = { ci::Area(400, 300, 402, 320) };
+	const std::vector<ci::Area>	whole = { ci::Area(0, 0, W, H) };
+	for(auto* rects : { &cursor, &whole }) {
+		const std::string	what = (rects == &cursor ? "small area" : "whole page");
+		double				swapping = 0.0;
+		ds::test::Timer		timer;
+		for(int r = 0; r < ROUNDS; ++r) {
+			buffer.paint(page.mPixels.data(), W, H, *rects);
+			ds::test::Timer	one;
+			buffer.swap(dirty);
+			swapping += one.seconds();
+		}
+		ds::test::report("paint, " + what, (timer.seconds() - swapping) * 1e6 / ROUNDS, "us");
+		ds::test::report("swap, " + what, swapping * 1e6 / ROUNDS, "us");
+	}
+	ds::test::keep(buffer.getFront());
+}